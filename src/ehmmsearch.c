@@ -53,6 +53,7 @@ typedef struct {
   P7_OPROFILE      *om;                         /* optimized query profile                        */
   P7_HMM           *hmm;                        /* the hmm                                        */
   P7_RATE          *R;                          /* the hmm rate                                   */
+  P7_EVOCACHE      *ec;                         /* evolved profiles of the query (shared)         */
   float             evparam_star[p7_NEVPARAM];  /* to store calibration parameters of the HMMstar */
   EVOPIPE_OPT       evopipe_opt;
 } WORKER_INFO;
@@ -500,6 +501,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	  info[i].gm  = NULL;
 	  info[i].om  = NULL;
 	  info[i].R   = NULL;
+	  info[i].ec  = NULL;
 	  info[i].hmm = NULL;
 	  info[i].bg  = p7_bg_Create(abc);
 	  info[i].evopipe_opt.fixtime     = hmmrate->fixtime;
@@ -567,6 +569,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     {
       float        evparam_star[p7_NEVPARAM];  /* to store calibration parameters of the HMMstar */
       P7_RATE     *R       = NULL;
+      P7_EVOCACHE *ec      = NULL;            /* evolved profiles, shared by all threads  */
       P7_PROFILE  *gm      = NULL;
       P7_OPROFILE *om      = NULL;            /* optimized query profile                  */
       
@@ -625,10 +628,22 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       p7_ProfileConfig(hmm, info->bg, gm, 100, p7_LOCAL); /* 100 is a dummy length for now; and MSVFilter requires local mode */
       p7_oprofile_Convert(gm, om);                  /* <om> is now p7_LOCAL, multihit */
 
+      /* Evolve the query once over the time grid; the pipelines then select
+       * from these profiles instead of rebuilding one per target.
+       * Recalibration is done here too, at a few grid times, and
+       * interpolated for the rest.
+       */
+      if (R != NULL) {
+	if (p7_EvoCacheCreate(hmm, R, info[0].bg, &ec, errbuf) != eslOK) esl_fatal("%s", errbuf);
+	if (esl_opt_GetBoolean(go, "--recalibrate") &&
+	    p7_EvoCacheCalibrate(ec, hmm, R, info[0].bg, cfg->r, NDTCAL, errbuf) != eslOK) esl_fatal("failed to calibrate evolved profiles of %s", hmm->name);
+      }
+
       for (i = 0; i < infocnt; ++i)
       {
 	if (!esl_opt_IsOn(go, "--noevo")) {
 	  info[i].R = p7_RateClone(R);
+	  info[i].ec = ec;
 	  
 	  info[i].evparam_star[p7_MLAMBDA] = evparam_star[p7_MLAMBDA];
 	  info[i].evparam_star[p7_VLAMBDA] = evparam_star[p7_MLAMBDA];
@@ -643,7 +658,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	info[i].hmm     = p7_hmm_Clone(hmm);
 	info[i].gm      = p7_profile_Clone(gm);
 	//info[i].om    = p7_oprofile_Clone(om); does not work here, need to use _Copy that is really a _Clone function
-	info[i].om      = p7_oprofile_Copy(om);
+	info[i].om      = (ec)? p7_oprofile_Clone(ec->om_star) : p7_oprofile_Copy(om);
         info[i].pli     = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
 	status = p7_pli_NewModel(info[i].pli, info[i].om, info[i].bg);
 	if (status == eslEINVAL) p7_Fail(info->pli->errbuf);
@@ -723,6 +738,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       for (i = 0; i < infocnt; ++i) {
 	if (info[i].R)   p7_RateDestroy(info[i].R);
+	info[i].ec = NULL;
 	if (info[i].hmm) p7_hmm_Destroy(info[i].hmm);
 	if (info[i].gm)  p7_profile_Destroy(info[i].gm);
       }
@@ -733,6 +749,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       p7_oprofile_Destroy(om);
       p7_profile_Destroy(gm);
       p7_hmm_Destroy(hmm);
+      if (ec)  p7_EvoCacheDestroy(ec);
       if (R)   p7_RateDestroy(R);
  
       hstatus = p7_hmmfile_Read(hfp, &abc, &hmm);
@@ -1439,7 +1456,7 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
 	      p7_bg_SetLength(bg, dbsq->n);
 	      p7_oprofile_ReconfigLength(om, dbsq->n);
       
-	      p7_EvoPipeline(pli, cfg->r, evparam_star, evopipe_opt, R, hmm, gm, om, bg, dbsq, NULL, th, &hmm_restore);
+	      p7_EvoPipeline(pli, cfg->r, evparam_star, evopipe_opt, R, NULL, hmm, gm, om, bg, dbsq, NULL, th, &hmm_restore);
 
 	      esl_sq_Reuse(dbsq);
 	      p7_pipeline_Reuse(pli);
@@ -1524,7 +1541,7 @@ serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs)
       p7_ReconfigLength(info->gm, dbsq->n);
       p7_oprofile_ReconfigLength(info->om, dbsq->n);
 
-      p7_EvoPipeline(info->pli, info->r, info->evparam_star, info->evopipe_opt, info->R, info->hmm, info->gm, info->om, info->bg,
+      p7_EvoPipeline(info->pli, info->r, info->evparam_star, info->evopipe_opt, info->R, info->ec, info->hmm, info->gm, info->om, info->bg,
 		     dbsq, NULL, info->th, &hmm_restore);
 
       seq_cnt++;
@@ -1633,7 +1650,7 @@ pipeline_thread(void *arg)
 	  p7_ReconfigLength(info->gm, dbsq->n);
 	  p7_oprofile_ReconfigLength(info->om, dbsq->n);
 	  
-	  p7_EvoPipeline(info->pli, info->r, info->evparam_star, info->evopipe_opt, info->R, info->hmm, info->gm, info->om, info->bg,
+	  p7_EvoPipeline(info->pli, info->r, info->evparam_star, info->evopipe_opt, info->R, info->ec, info->hmm, info->gm, info->om, info->bg,
 			 dbsq, NULL, info->th, &hmm_restore);
 
 	  esl_sq_Reuse(dbsq);
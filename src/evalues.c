@@ -3,8 +3,9 @@
  * Contents:
  *   1. p7_Calibrate():  model calibration wrapper 
  *   2. Determination of individual E-value parameters
- *   3. Statistics and specific experiment drivers
- *   4. Benchmark driver
+ *   3. Threaded calibration simulations
+ *   4. Statistics and specific experiment drivers
+ *   5. Benchmark driver
  * 
  * SRE, Mon Aug  6 13:00:06 2007
  */
@@ -15,9 +16,20 @@
 #include "esl_random.h"
 #include "esl_randomseq.h"
 #include "esl_vectorops.h"
+#ifdef HMMER_THREADS
+#include "esl_threads.h"
+#endif
 
 #include "hmmer.h"
 
+enum calibrate_filter_e { calMSV = 0, calVITERBI = 1, calFORWARD = 2 };
+
+static int sample_scores(ESL_RANDOMNESS *r, enum calibrate_filter_e which, P7_OPROFILE *om, P7_BG *bg, P7_OMX *ox, ESL_DSQ *dsq, int L, int N, double *xv);
+#ifdef HMMER_THREADS
+static int calibrate_threaded(P7_OPROFILE *om, P7_BG *bg, ESL_RANDOMNESS *r, int ncpu, int EmL, int EmN, int EvL, int EvN, int EfL, int EfN,
+                              double lambda, double Eft, double *ret_mmu, double *ret_vmu, double *ret_tau);
+#endif
+
 /*****************************************************************
  * 1. p7_Calibrate():  model calibration wrapper 
  *****************************************************************/ 
@@ -47,6 +59,15 @@
  *                      pass <*byp_om == NULL> if <om> return desired;
  *                      pass <NULL> to use and discard internal default.          
  *
+ *            If <cfg_b->cal_ncpu> is nonzero (and HMMER is built with
+ *            threads), the three simulations are split into fixed
+ *            blocks of sequences, each generated from its own RNG
+ *            stream seeded in order from <rng>, and the blocks are
+ *            scored by <cal_ncpu> threads. Results then depend on
+ *            the seed but not on the number of threads; they differ
+ *            from those of the serial path (<cal_ncpu> = 0), which
+ *            draws every sequence from <rng> itself.
+ *
  * Returns:   <eslOK> on success.
  *
  * Throws:    <eslEMEM> on allocation failure.
@@ -102,9 +123,19 @@ p7_Calibrate(P7_HMM *hmm, P7_BUILDER *cfg_b, ESL_RANDOMNESS **byp_rng, P7_BG **b
 
   /* The calibration steps themselves */
   if ((status = p7_Lambda(hmm, bg, &lambda))                          != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine lambda");
-  if ((status = p7_MSVMu    (r, om, bg, EmL, EmN, lambda, &mmu))      != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine msv mu");
-  if ((status = p7_ViterbiMu(r, om, bg, EvL, EvN, lambda, &vmu))      != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine vit mu");
-  if ((status = p7_Tau      (r, om, bg, EfL, EfN, lambda, Eft, &tau)) != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine fwd tau");
+#ifdef HMMER_THREADS
+  if (cfg_b != NULL && cfg_b->cal_ncpu > 0)
+    {
+      if ((status = calibrate_threaded(om, bg, r, cfg_b->cal_ncpu, EmL, EmN, EvL, EvN, EfL, EfN, lambda, Eft, &mmu, &vmu, &tau)) != eslOK)
+        ESL_XFAIL(status, errbuf, "threaded calibration simulations failed");
+    }
+  else
+#endif
+    {
+      if ((status = p7_MSVMu    (r, om, bg, EmL, EmN, lambda, &mmu))      != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine msv mu");
+      if ((status = p7_ViterbiMu(r, om, bg, EvL, EvN, lambda, &vmu))      != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine vit mu");
+      if ((status = p7_Tau      (r, om, bg, EfL, EfN, lambda, Eft, &tau)) != eslOK) ESL_XFAIL(status,  errbuf, "failed to determine fwd tau");
+    }
 
   /* Store results */
   hmm->evparam[p7_MLAMBDA] = om->evparam[p7_MLAMBDA] = lambda;
@@ -240,9 +271,6 @@ p7_MSVMu(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lam
   P7_OMX  *ox      = p7_omx_Create(om->M, 0, 0); /* DP matrix: 1 row version */
   ESL_DSQ *dsq     = NULL;
   double  *xv      = NULL;
-  int      i;
-  float    sc, nullsc;
-  float    maxsc   = (255 - om->base_b) / om->scale_b; /* if score overflows, use this */
   int      status;
 
   if (ox == NULL) { status = eslEMEM; goto ERROR; }
@@ -252,18 +280,7 @@ p7_MSVMu(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lam
   p7_oprofile_ReconfigLength(om, L);
   p7_bg_SetLength(bg, L);
 
-  for (i = 0; i < N; i++)
-    {
-      if ((status = esl_rsq_xfIID(r, bg->f, om->abc->K, L, dsq)) != eslOK) goto ERROR;
-      if ((status = p7_bg_NullOne(bg, dsq, L, &nullsc))          != eslOK) goto ERROR;   
-
-      status = p7_MSVFilter(dsq, L, om, ox, &sc); 
-      if (status == eslERANGE) { sc = maxsc; status = eslOK; }
-      if (status != eslOK)     goto ERROR;
-
-      xv[i] = (sc - nullsc) / eslCONST_LOG2;
-    }
-
+  if ((status = sample_scores(r, calMSV, om, bg, ox, dsq, L, N, xv)) != eslOK) goto ERROR;
   if ((status = esl_gumbel_FitCompleteLoc(xv, N, lambda, ret_mmu))  != eslOK) goto ERROR;
   p7_omx_Destroy(ox);
   free(xv);
@@ -309,9 +326,6 @@ p7_ViterbiMu(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double
   P7_OMX  *ox      = p7_omx_Create(om->M, 0, 0); /* DP matrix: 1 row version */
   ESL_DSQ *dsq     = NULL;
   double  *xv      = NULL;
-  int      i;
-  float    sc, nullsc;
-  float    maxsc   = (32767.0 - om->base_w) / om->scale_w; /* if score overflows, use this [J4/139] */
   int      status;
 
   if (ox == NULL) { status = eslEMEM; goto ERROR; }
@@ -321,18 +335,7 @@ p7_ViterbiMu(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double
   p7_oprofile_ReconfigLength(om, L);
   p7_bg_SetLength(bg, L);
 
-  for (i = 0; i < N; i++)
-    {
-      if ((status = esl_rsq_xfIID(r, bg->f, om->abc->K, L, dsq)) != eslOK) goto ERROR;
-      if ((status = p7_bg_NullOne(bg, dsq, L, &nullsc))          != eslOK) goto ERROR;   
-
-      status = p7_ViterbiFilter(dsq, L, om, ox, &sc); 
-      if (status == eslERANGE) { sc = maxsc; status = eslOK; }
-      if (status != eslOK)     goto ERROR;
-
-      xv[i] = (sc - nullsc) / eslCONST_LOG2;
-    }
-
+  if ((status = sample_scores(r, calVITERBI, om, bg, ox, dsq, L, N, xv)) != eslOK) goto ERROR;
   if ((status = esl_gumbel_FitCompleteLoc(xv, N, lambda, ret_vmu))  != eslOK) goto ERROR;
   p7_omx_Destroy(ox);
   free(xv);
@@ -414,10 +417,8 @@ p7_Tau(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambd
   P7_OMX  *ox      = p7_omx_Create(om->M, 0, L);     /* DP matrix: for ForwardParser,  L rows */
   ESL_DSQ *dsq     = NULL;
   double  *xv      = NULL;
-  float    fsc, nullsc;		                  
   double   gmu, glam;
   int      status;
-  int      i;
 
   ESL_ALLOC(xv,  sizeof(double)  * N);
   ESL_ALLOC(dsq, sizeof(ESL_DSQ) * (L+2));
@@ -426,13 +427,7 @@ p7_Tau(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambd
   p7_oprofile_ReconfigLength(om, L);
   p7_bg_SetLength(bg, L);
 
-  for (i = 0; i < N; i++)
-    {
-      if ((status = esl_rsq_xfIID(r, bg->f, om->abc->K, L, dsq)) != eslOK) goto ERROR;
-      if ((status = p7_ForwardParser(dsq, L, om, ox, &fsc))      != eslOK) goto ERROR;
-      if ((status = p7_bg_NullOne(bg, dsq, L, &nullsc))          != eslOK) goto ERROR;   
-      xv[i] = (fsc - nullsc) / eslCONST_LOG2;
-    }
+  if ((status = sample_scores(r, calFORWARD, om, bg, ox, dsq, L, N, xv)) != eslOK) goto ERROR;
   if ((status = esl_gumbel_FitComplete(xv, N, &gmu, &glam)) != eslOK) goto ERROR;
 
   /* Explanation of the eqn below: first find the x at which the Gumbel tail
@@ -454,13 +449,223 @@ p7_Tau(ESL_RANDOMNESS *r, P7_OPROFILE *om, P7_BG *bg, int L, int N, double lambd
   if (ox  != NULL) p7_omx_Destroy(ox);
   return status;
 }
+
+/* sample_scores()
+ *
+ * Generate <N> iid sequences of length <L> from <r> and the residue
+ * frequencies of <bg>, score each with the filter <which>, and store
+ * the bit scores in <xv[0..N-1]>. <om> and <bg> must already be
+ * configured for length <L>; they are only read, so threads may share
+ * them. <ox> is a DP matrix big enough for <om> (and with <L> rows,
+ * for Forward); <dsq> has room for <L+2> residues.
+ *
+ * Overflowing MSV and Viterbi scores are set to the highest score
+ * their filter can represent [J4/139].
+ */
+static int
+sample_scores(ESL_RANDOMNESS *r, enum calibrate_filter_e which, P7_OPROFILE *om, P7_BG *bg, P7_OMX *ox, ESL_DSQ *dsq, int L, int N, double *xv)
+{
+  float maxsc = 0.;
+  float sc, nullsc;
+  int   i;
+  int   status;
+
+  if      (which == calMSV)     maxsc = (255 - om->base_b) / om->scale_b;
+  else if (which == calVITERBI) maxsc = (32767.0 - om->base_w) / om->scale_w;
+
+  for (i = 0; i < N; i++)
+    {
+      if ((status = esl_rsq_xfIID(r, bg->f, om->abc->K, L, dsq)) != eslOK) return status;
+      if ((status = p7_bg_NullOne(bg, dsq, L, &nullsc))          != eslOK) return status;
+
+      switch (which) {
+      case calMSV:     status = p7_MSVFilter    (dsq, L, om, ox, &sc); break;
+      case calVITERBI: status = p7_ViterbiFilter(dsq, L, om, ox, &sc); break;
+      case calFORWARD: status = p7_ForwardParser(dsq, L, om, ox, &sc); break;
+      }
+      if (status == eslERANGE && which != calFORWARD) { sc = maxsc; status = eslOK; }
+      if (status != eslOK) return status;
+
+      xv[i] = (sc - nullsc) / eslCONST_LOG2;
+    }
+  return eslOK;
+}
 /*-------------- end, determining individual parameters ---------*/
 
 
 
+/*****************************************************************
+ * 3. Threaded calibration simulations
+ *****************************************************************/
+#ifdef HMMER_THREADS
+
+/* Each simulation is cut into blocks of this many sequences. A block
+ * is generated from its own RNG stream, so the scores don't depend on
+ * which thread does it, or when.
+ */
+#define p7_CALIBRATE_BLOCK 16
+
+typedef struct {
+  enum calibrate_filter_e which;
+  P7_OPROFILE    *om;           /* shared, read-only; configured for length <L> */
+  P7_BG          *bg;           /* shared, read-only; configured for length <L> */
+  int             L;            /* length of simulated sequences                */
+  int             N;            /* number of simulated sequences                */
+  int             nblocks;      /* N split into blocks of p7_CALIBRATE_BLOCK    */
+  int             nworkers;     /* worker w does blocks w, w+nworkers, ...      */
+  uint32_t       *seed;         /* [0..nblocks-1] RNG seed of each block        */
+  double         *xv;           /* [0..N-1] scores; block b fills its own slice */
+} CALIBRATE_JOB;
+
+typedef struct {
+  CALIBRATE_JOB  *job;
+  int             first;        /* first block this worker does                 */
+  ESL_RANDOMNESS *r;            /* reseeded at the start of each block          */
+  P7_OMX         *ox;           /* own DP matrix, with rows for Forward         */
+  ESL_DSQ        *dsq;          /* own sequence buffer                          */
+  int             status;
+} CALIBRATE_WORKER;
+
+static void
+calibrate_thread(void *arg)
+{
+  ESL_THREADS      *obj = (ESL_THREADS *) arg;
+  CALIBRATE_WORKER *w;
+  CALIBRATE_JOB    *job;
+  int               workeridx;
+  int               b, n;
+
+  impl_Init();
+  esl_threads_Started(obj, &workeridx);
+  w   = (CALIBRATE_WORKER *) esl_threads_GetData(obj, workeridx);
+  job = w->job;
+
+  w->status = eslOK;
+  for (b = w->first; b < job->nblocks && w->status == eslOK; b += job->nworkers)
+    {
+      n = ESL_MIN(p7_CALIBRATE_BLOCK, job->N - b * p7_CALIBRATE_BLOCK);
+      esl_randomness_Init(w->r, job->seed[b]);
+      w->status = sample_scores(w->r, job->which, job->om, job->bg, w->ox, w->dsq, job->L, n, job->xv + b * p7_CALIBRATE_BLOCK);
+    }
+
+  esl_threads_Finished(obj, workeridx);
+}
+
+/* run_simulation()
+ *
+ * Score <job->N> simulated sequences into <job->xv> with <nworkers>
+ * threads of <obj>. The block seeds are drawn from <r> in block order
+ * before any thread starts.
+ */
+static int
+run_simulation(ESL_THREADS *obj, CALIBRATE_WORKER *wrk, int nworkers, CALIBRATE_JOB *job, ESL_RANDOMNESS *r)
+{
+  int b, i;
+
+  job->nblocks  = (job->N + p7_CALIBRATE_BLOCK - 1) / p7_CALIBRATE_BLOCK;
+  job->nworkers = ESL_MIN(nworkers, job->nblocks);
+  for (b = 0; b < job->nblocks; b++)
+    job->seed[b] = 1 + esl_rnd_Roll(r, 2147483646);   /* nonzero: seed 0 would ask for an arbitrary seed */
+
+  p7_oprofile_ReconfigLength(job->om, job->L);
+  p7_bg_SetLength(job->bg, job->L);
+
+  for (i = 0; i < job->nworkers; i++)
+    {
+      wrk[i].job   = job;
+      wrk[i].first = i;
+      esl_threads_AddThread(obj, &wrk[i]);
+    }
+  esl_threads_WaitForStart(obj);
+  esl_threads_WaitForFinish(obj);
+
+  for (i = 0; i < job->nworkers; i++)
+    if (wrk[i].status != eslOK) return wrk[i].status;
+  return eslOK;
+}
+
+/* calibrate_threaded()
+ *
+ * The MSV, Viterbi and Forward simulations of p7_Calibrate(), run
+ * with <ncpu> threads. Fits are the same as in p7_MSVMu(),
+ * p7_ViterbiMu() and p7_Tau(). Like them, this leaves <om> and <bg>
+ * configured for the last simulated length, <EfL>.
+ */
+static int
+calibrate_threaded(P7_OPROFILE *om, P7_BG *bg, ESL_RANDOMNESS *r, int ncpu, int EmL, int EmN, int EvL, int EvN, int EfL, int EfN,
+                   double lambda, double Eft, double *ret_mmu, double *ret_vmu, double *ret_tau)
+{
+  ESL_THREADS      *obj     = NULL;
+  CALIBRATE_WORKER *wrk     = NULL;
+  CALIBRATE_JOB     job;
+  int               maxL    = ESL_MAX(EmL, ESL_MAX(EvL, EfL));
+  int               maxN    = ESL_MAX(EmN, ESL_MAX(EvN, EfN));
+  int               nworkers;
+  double            gmu, glam;
+  int               i;
+  int               status;
+
+  job.seed = NULL;
+  job.xv   = NULL;
+  job.om   = om;
+  job.bg   = bg;
+  nworkers = ESL_MIN(ncpu, (maxN + p7_CALIBRATE_BLOCK - 1) / p7_CALIBRATE_BLOCK);
+
+  ESL_ALLOC(job.seed, sizeof(uint32_t) * ((maxN + p7_CALIBRATE_BLOCK - 1) / p7_CALIBRATE_BLOCK));
+  ESL_ALLOC(job.xv,   sizeof(double)   * maxN);
+  ESL_ALLOC(wrk,      sizeof(CALIBRATE_WORKER) * nworkers);
+  for (i = 0; i < nworkers; i++) { wrk[i].r = NULL; wrk[i].ox = NULL; wrk[i].dsq = NULL; }
+  for (i = 0; i < nworkers; i++)
+    {
+      if ((wrk[i].r  = esl_randomness_CreateFast(42))      == NULL) { status = eslEMEM; goto ERROR; }
+      if ((wrk[i].ox = p7_omx_Create(om->M, 0, maxL))      == NULL) { status = eslEMEM; goto ERROR; }
+      ESL_ALLOC(wrk[i].dsq, sizeof(ESL_DSQ) * (maxL+2));
+    }
+  if ((obj = esl_threads_Create(&calibrate_thread)) == NULL) { status = eslEMEM; goto ERROR; }
+
+  job.which = calMSV;     job.L = EmL; job.N = EmN;
+  if ((status = run_simulation(obj, wrk, nworkers, &job, r))          != eslOK) goto ERROR;
+  if ((status = esl_gumbel_FitCompleteLoc(job.xv, EmN, lambda, ret_mmu)) != eslOK) goto ERROR;
+
+  job.which = calVITERBI; job.L = EvL; job.N = EvN;
+  if ((status = run_simulation(obj, wrk, nworkers, &job, r))          != eslOK) goto ERROR;
+  if ((status = esl_gumbel_FitCompleteLoc(job.xv, EvN, lambda, ret_vmu)) != eslOK) goto ERROR;
+
+  job.which = calFORWARD; job.L = EfL; job.N = EfN;
+  if ((status = run_simulation(obj, wrk, nworkers, &job, r))          != eslOK) goto ERROR;
+  if ((status = esl_gumbel_FitComplete(job.xv, EfN, &gmu, &glam))        != eslOK) goto ERROR;
+  *ret_tau = esl_gumbel_invcdf(1.0-Eft, gmu, glam) + (log(Eft) / lambda);   /* as in p7_Tau() */
+
+  for (i = 0; i < nworkers; i++) { esl_randomness_Destroy(wrk[i].r); p7_omx_Destroy(wrk[i].ox); free(wrk[i].dsq); }
+  esl_threads_Destroy(obj);
+  free(wrk);
+  free(job.seed);
+  free(job.xv);
+  return eslOK;
+
+ ERROR:
+  if (wrk) {
+    for (i = 0; i < nworkers; i++) {
+      if (wrk[i].r)   esl_randomness_Destroy(wrk[i].r);
+      if (wrk[i].ox)  p7_omx_Destroy(wrk[i].ox);
+      if (wrk[i].dsq) free(wrk[i].dsq);
+    }
+    free(wrk);
+  }
+  if (obj)      esl_threads_Destroy(obj);
+  if (job.seed) free(job.seed);
+  if (job.xv)   free(job.xv);
+  *ret_mmu = *ret_vmu = *ret_tau = 0.;
+  return status;
+}
+#endif /*HMMER_THREADS*/
+/*------------------ end, threaded calibration ------------------*/
+
+
+
 
 /*****************************************************************
- * 3. Statistics and specific experiment drivers
+ * 4. Statistics and specific experiment drivers
  *****************************************************************/
 #ifdef p7EVALUES_STATS
 /* gcc -o evalues_stats -g -O2 -msse2 -I. -L. -I../easel -L../easel -Dp7EVALUES_STATS evalues.c -lhmmer -leasel -lm
@@ -572,7 +777,7 @@ main(int argc, char **argv)
 
 
 /*****************************************************************
- * 4. Benchmark driver
+ * 5. Benchmark driver
  *****************************************************************/
 
 #ifdef p7EVALUES_BENCHMARK
@@ -602,6 +807,7 @@ static ESL_OPTIONS options[] = {
   /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
   { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",             0 },
   { "-N",        eslARG_INT,    "100", NULL, "n>0", NULL,  NULL, NULL, "number of calibrations to do",                     0 },
+  { "--cpu",     eslARG_INT,      "0", NULL,"n>=0", NULL,  NULL, NULL, "number of calibration threads (0: serial)",         0 },
    {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 static char usage[]  = "[-options] <hmmfile>";
@@ -617,19 +823,24 @@ main(int argc, char **argv)
   ESL_ALPHABET   *abc     = NULL;
   P7_HMMFILE     *hfp     = NULL;
   P7_HMM         *hmm     = NULL;
+  P7_BUILDER     *bld     = NULL;
 
   if (p7_hmmfile_Open(hmmfile, NULL, &hfp, NULL) != eslOK) p7_Fail("Failed to open HMM file %s", hmmfile);
   if (p7_hmmfile_Read(hfp, &abc, &hmm)           != eslOK) p7_Fail("Failed to read HMM");
   p7_hmmfile_Close(hfp);
 
+  if ((bld = p7_builder_Create(NULL, abc)) == NULL) p7_Fail("Failed to create builder");
+  bld->cal_ncpu = esl_opt_GetInteger(go, "--cpu");
+
   esl_stopwatch_Start(w);
   while (N--)
-    { /*                cfg   rng   bg    gm    om  */
-      p7_Calibrate(hmm, NULL, NULL, NULL, NULL, NULL);
+    { /*                cfg   rng       bg    gm    om  */
+      p7_Calibrate(hmm, bld, &bld->r, NULL, NULL, NULL);
     }
   esl_stopwatch_Stop(w);
   esl_stopwatch_Display(stdout, w, "# CPU time: ");
 
+  p7_builder_Destroy(bld);
   p7_hmm_Destroy(hmm);
   esl_alphabet_Destroy(abc);
   esl_stopwatch_Destroy(w);
@@ -2,9 +2,10 @@
  * 
  * Contents:
  *   1. Miscellaneous functions for evoH3
- *   2. Unit tests
- *   3. Test driver
- *   4. License and copyright 
+ *   2. P7_EVOCACHE: evolved optimized profiles over the time grid
+ *   3. Unit tests
+ *   4. Test driver
+ *   5. License and copyright 
  *
  * ER, Tue Sep 27 13:19:30 2011 [Janelia] 
  * SVN $Id:$
@@ -34,6 +35,7 @@
 static int    er_entropy_target_f(double weight, void *params, double *ret_fx);
 static double er_MeanEntropy(float **vec, int M, int K);
 static double er_MeanRelativeEntropy(float **vec, int M, float *f, int K);
+static int    evocache_build(P7_HMM *ehmm, const P7_RATE *R, const P7_BG *bg, double time, P7_PROFILE *gm, P7_OPROFILE **ret_om, char *errbuf);
 
 /*****************************************************************
  * 1. Miscellaneous functions for evoH3
@@ -1248,7 +1250,345 @@ er_MeanRelativeEntropy(float **vec, int M, float *f, int K)
 }
 
 /*****************************************************************
- * 2. Unit tests
+ * 2. P7_EVOCACHE: evolved optimized profiles over the time grid
+ *****************************************************************/
+
+/* Function:  p7_EvoCacheCreate()
+ * Synopsis:  Build the evolved-profile cache of a query.
+ *
+ * Purpose:   Evolve <hmm> with rate <R> to every time of the
+ *            divergence-time grid <R->dtval[]>, and to t* = 1.0, and
+ *            convert each evolved model to an optimized profile in
+ *            local multihit mode. This replaces the per-target
+ *            <p7_EvolveFromRate()> + <p7_ProfileConfig()> +
+ *            <p7_oprofile_Convert()> of the evolutionary pipeline by a
+ *            one-time cost per query.
+ *
+ *            The emissions of an evolved model already come from the
+ *            discrete <R->pdt[]> grid; the cached profiles use the
+ *            grid time for the transitions too, so a time
+ *            optimization run on the cache sees the evolved models
+ *            at grid resolution.
+ *
+ *            <hmm> and <R> are not modified. <R> must have been
+ *            calculated (<p7_RateCalculate()>).
+ *
+ * Returns:   <eslOK> on success, and <*ret_ec> points to the new cache.
+ *            <eslEINVAL> if <R> is missing, not calculated, or has a
+ *            different model length than <hmm>; <errbuf> has a message.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_EvoCacheCreate(const P7_HMM *hmm, const P7_RATE *R, const P7_BG *bg, P7_EVOCACHE **ret_ec, char *errbuf)
+{
+  P7_EVOCACHE *ec   = NULL;
+  P7_HMM      *ehmm = NULL;
+  P7_PROFILE  *gm   = NULL;
+  int          t;
+  int          status;
+
+  if (R == NULL || ! R->done) ESL_XFAIL(eslEINVAL, errbuf, "evolved-profile cache needs a calculated rate");
+  if (R->M != hmm->M)         ESL_XFAIL(eslEINVAL, errbuf, "Rate dim (%d) does not correspond to HMM dim (%d)", R->M, hmm->M);
+
+  ESL_ALLOC(ec, sizeof(P7_EVOCACHE));
+  ec->M       = hmm->M;
+  ec->ndt     = R->ndt;
+  ec->dtval   = NULL;
+  ec->om      = NULL;
+  ec->om_star = NULL;
+  ec->ncal     = 0;
+  ec->caltime  = NULL;
+  ec->calparam = NULL;
+
+  ESL_ALLOC(ec->dtval, sizeof(float)         * ESL_MAX(1, ec->ndt));
+  ESL_ALLOC(ec->om,    sizeof(P7_OPROFILE *) * ESL_MAX(1, ec->ndt));
+  for (t = 0; t < ec->ndt; t++) ec->om[t] = NULL;
+
+  if ((ehmm = p7_hmm_Clone(hmm))                   == NULL) { status = eslEMEM; goto ERROR; }
+  if ((gm   = p7_profile_Create(hmm->M, hmm->abc)) == NULL) { status = eslEMEM; goto ERROR; }
+
+  for (t = 0; t < ec->ndt; t++) {
+    ec->dtval[t] = R->dtval[t];
+    if ((status = evocache_build(ehmm, R, bg, (double) R->dtval[t], gm, &(ec->om[t]), errbuf)) != eslOK) goto ERROR;
+  }
+  if ((status = evocache_build(ehmm, R, bg, 1.0, gm, &(ec->om_star), errbuf)) != eslOK) goto ERROR;
+
+  p7_profile_Destroy(gm);
+  p7_hmm_Destroy(ehmm);
+  *ret_ec = ec;
+  return eslOK;
+
+ ERROR:
+  if (gm)   p7_profile_Destroy(gm);
+  if (ehmm) p7_hmm_Destroy(ehmm);
+  p7_EvoCacheDestroy(ec);
+  *ret_ec = NULL;
+  return status;
+}
+
+/* Function:  p7_EvoCacheCalibrate()
+ * Synopsis:  Calibrate the evolved-profile cache at a few grid times.
+ *
+ * Purpose:   Fit E-value parameters for the profiles of <ec> without
+ *            calibrating each of them. <ncal> grid times, evenly
+ *            spaced in log time over the grid, are calibrated with
+ *            <p7_Calibrate()>; t* is anchored on the parameters of
+ *            <hmm> itself if it has them. Every cached profile then
+ *            gets parameters interpolated from that table (see
+ *            <p7_EvoCacheEvparams()>).
+ *
+ *            This replaces running <p7_Calibrate()> inside the search
+ *            loop for recalibrated evolutionary searches: the
+ *            simulations are done once per query, at query setup.
+ *
+ *            <r> is the random number generator for the simulations;
+ *            pass <NULL> to use <p7_Calibrate()>'s default seed.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure; errors from
+ *            <p7_EvolveFromRate()> or <p7_Calibrate()> are passed up.
+ */
+int
+p7_EvoCacheCalibrate(P7_EVOCACHE *ec, const P7_HMM *hmm, const P7_RATE *R, const P7_BG *bg, ESL_RANDOMNESS *r, int ncal, char *errbuf)
+{
+  P7_HMM *ehmm   = NULL;
+  int    *calidx = NULL;   /* grid index of each calibrated time; -1 for t* */
+  double  lt0, lt1, lt;
+  double  d, dbest;
+  int     n      = 0;
+  int     c, t, tbest;
+  int     status;
+
+  if (ec->ndt < 1) ncal = 0;
+  ESL_ALLOC(calidx, sizeof(int) * (ncal+1));
+
+  /* the grid times closest to <ncal> times evenly spaced in log time, with t* inserted in order */
+  lt0 = log(ec->dtval[0]);
+  lt1 = log(ec->dtval[ec->ndt-1]);
+  for (c = 0; c < ncal; c++) {
+    lt    = (ncal > 1)? lt0 + (lt1 - lt0) * (double) c / (double) (ncal-1) : 0.5 * (lt0 + lt1);
+    tbest = 0;
+    dbest = eslINFINITY;
+    for (t = 0; t < ec->ndt; t++) {
+      d = fabs(log(ec->dtval[t]) - lt);
+      if (d < dbest) { dbest = d; tbest = t; }
+    }
+    if (fabs(ec->dtval[tbest] - 1.0) < 1e-4)                continue; /* t* is anchored separately */
+    if (n > 0 && calidx[n-1] >= 0 && calidx[n-1] == tbest) continue;
+    if (ec->dtval[tbest] > 1.0 && (n == 0 || (calidx[n-1] >= 0 && ec->dtval[calidx[n-1]] < 1.0))) calidx[n++] = -1;
+    calidx[n++] = tbest;
+  }
+  if (n == 0 || (calidx[n-1] >= 0 && ec->dtval[calidx[n-1]] < 1.0)) calidx[n++] = -1;
+
+  if (ec->caltime) free(ec->caltime);
+  if (ec->calparam) {
+    if (ec->calparam[0]) free(ec->calparam[0]);
+    free(ec->calparam);
+  }
+  ec->ncal     = 0;
+  ec->calparam = NULL;
+  ESL_ALLOC(ec->caltime,     sizeof(float)   * n);
+  ESL_ALLOC(ec->calparam,    sizeof(float *) * n);
+  ec->calparam[0] = NULL;
+  ESL_ALLOC(ec->calparam[0], sizeof(float)   * n * p7_NEVPARAM);
+  for (c = 1; c < n; c++) ec->calparam[c] = ec->calparam[0] + c * p7_NEVPARAM;
+
+  if ((ehmm = p7_hmm_Clone(hmm)) == NULL) { status = eslEMEM; goto ERROR; }
+
+  for (c = 0; c < n; c++) {
+    ec->caltime[c] = (calidx[c] >= 0)? ec->dtval[calidx[c]] : 1.0;
+
+    if (calidx[c] < 0 && (hmm->flags & p7H_STATS)) 
+      esl_vec_FCopy(hmm->evparam, p7_NEVPARAM, ec->calparam[c]);
+    else {
+      if ((status = p7_EvolveFromRate(NULL, ehmm, R, bg, (double) ec->caltime[c], errbuf, FALSE)) != eslOK) goto ERROR;
+      if ((status = p7_Calibrate(ehmm, NULL, (r)? &r : NULL, NULL, NULL, NULL))                   != eslOK) goto ERROR;
+      esl_vec_FCopy(ehmm->evparam, p7_NEVPARAM, ec->calparam[c]);
+    }
+  }
+  ec->ncal = n;
+
+  /* interpolate the parameters of every cached profile */
+  for (t = 0; t < ec->ndt; t++)
+    p7_EvoCacheEvparams(ec, ec->dtval[t], ec->om[t]->evparam);
+  p7_EvoCacheEvparams(ec, 1.0, ec->om_star->evparam);
+
+  p7_hmm_Destroy(ehmm);
+  free(calidx);
+  return eslOK;
+
+ ERROR:
+  if (ehmm)   p7_hmm_Destroy(ehmm);
+  if (calidx) free(calidx);
+  return status;
+}
+
+/* Function:  p7_EvoCacheEvparams()
+ * Synopsis:  Interpolate E-value parameters at a divergence time.
+ *
+ * Purpose:   Set <evparam[0..p7_NEVPARAM-1]> to the E-value parameters
+ *            of the calibration table of <ec> at <time>, linearly
+ *            interpolated in log time between the two calibrated times
+ *            that bracket it, and held constant beyond the ends of
+ *            the table. Does nothing if <ec> is not calibrated.
+ */
+void
+p7_EvoCacheEvparams(const P7_EVOCACHE *ec, float time, float *evparam)
+{
+  double w;
+  int    c, x;
+
+  if (ec->ncal == 0) return;
+
+  if (time <= ec->caltime[0])          { esl_vec_FCopy(ec->calparam[0],          p7_NEVPARAM, evparam); return; }
+  if (time >= ec->caltime[ec->ncal-1]) { esl_vec_FCopy(ec->calparam[ec->ncal-1], p7_NEVPARAM, evparam); return; }
+
+  for (c = 1; c < ec->ncal-1; c++)
+    if (time <= ec->caltime[c]) break;
+
+  w = (log(time) - log(ec->caltime[c-1])) / (log(ec->caltime[c]) - log(ec->caltime[c-1]));
+  for (x = 0; x < p7_NEVPARAM; x++)
+    evparam[x] = (1.0 - w) * ec->calparam[c-1][x] + w * ec->calparam[c][x];
+}
+
+/* Function:  p7_EvoCacheIndex()
+ * Synopsis:  Map a divergence time to a cache entry.
+ *
+ * Purpose:   Return the index of the grid time that <p7_EvolveFromRate()>
+ *            would take the match emissions from for <time>: the first
+ *            grid time $\geq$ <time> for <time> $< 1$, the last grid
+ *            time $\leq$ <time> otherwise.
+ *
+ * Returns:   the grid index <0..ndt-1>, or -1 if <time> is t* = 1.0 or
+ *            falls outside the grid; -1 means <ec->om_star>.
+ */
+int
+p7_EvoCacheIndex(const P7_EVOCACHE *ec, float time)
+{
+  int t;
+
+  if (time == 1.0) return -1;
+
+  if (time < 1.0) {
+    for (t = 0; t < ec->ndt; t++)
+      if (ec->dtval[t] >= time) return t;
+  }
+  else {
+    for (t = ec->ndt-1; t >= 0; t--)
+      if (ec->dtval[t] <= time) return t;
+  }
+  return -1;
+}
+
+/* Function:  p7_EvoCacheSelect()
+ * Synopsis:  Point a profile view at the cached profile for <time>.
+ *
+ * Purpose:   Make <om> a shallow view of the cached profile for
+ *            <time>, configured for target length <L>. The vector
+ *            blocks are shared with the cache; the length-dependent
+ *            N/C/J costs, the E-value parameters and the uni/multihit
+ *            configuration live in <om> itself, so each thread can
+ *            reconfigure its own view without touching the cache.
+ *
+ *            <om> must be a clone (<p7_oprofile_Clone()>) that owns
+ *            none of its memory; typically made once per thread from
+ *            <ec->om_star>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <om> owns its own memory.
+ */
+int
+p7_EvoCacheSelect(const P7_EVOCACHE *ec, float time, int L, P7_OPROFILE *om)
+{
+  int t = p7_EvoCacheIndex(ec, time);
+
+  if (! om->clone) ESL_EXCEPTION(eslEINVAL, "evolved-profile cache can only select into a cloned profile");
+
+  memcpy(om, (t >= 0)? ec->om[t] : ec->om_star, sizeof(P7_OPROFILE));
+  om->clone = 1;
+  return p7_oprofile_ReconfigLength(om, L);
+}
+
+/* Function:  p7_EvoCacheSizeof()
+ * Synopsis:  Return the allocated size of a <P7_EVOCACHE>, in bytes.
+ */
+size_t
+p7_EvoCacheSizeof(const P7_EVOCACHE *ec)
+{
+  size_t n = 0;
+  int    t;
+
+  if (ec == NULL) return 0;
+
+  n += sizeof(P7_EVOCACHE);
+  n += sizeof(float)         * ESL_MAX(1, ec->ndt);  /* ec->dtval */
+  n += sizeof(P7_OPROFILE *) * ESL_MAX(1, ec->ndt);  /* ec->om    */
+  for (t = 0; t < ec->ndt; t++)
+    if (ec->om[t]) n += p7_oprofile_Sizeof(ec->om[t]);
+  if (ec->om_star) n += p7_oprofile_Sizeof(ec->om_star);
+  n += sizeof(float)   * ec->ncal;                     /* ec->caltime  */
+  n += sizeof(float *) * ec->ncal;                     /* ec->calparam */
+  n += sizeof(float)   * ec->ncal * p7_NEVPARAM;
+  return n;
+}
+
+/* Function:  p7_EvoCacheDestroy()
+ * Synopsis:  Free a <P7_EVOCACHE>.
+ *
+ * Purpose:   Free the cache and its profiles. Any profile views made
+ *            with <p7_EvoCacheSelect()> become invalid.
+ */
+void
+p7_EvoCacheDestroy(P7_EVOCACHE *ec)
+{
+  int t;
+
+  if (ec == NULL) return;
+
+  if (ec->om) {
+    for (t = 0; t < ec->ndt; t++)
+      if (ec->om[t]) p7_oprofile_Destroy(ec->om[t]);
+    free(ec->om);
+  }
+  if (ec->om_star) p7_oprofile_Destroy(ec->om_star);
+  if (ec->dtval)   free(ec->dtval);
+  if (ec->caltime) free(ec->caltime);
+  if (ec->calparam) {
+    if (ec->calparam[0]) free(ec->calparam[0]);
+    free(ec->calparam);
+  }
+  free(ec);
+}
+
+/* evocache_build()
+ * Evolve <ehmm> to <time>, and convert it to a new optimized
+ * profile in <*ret_om>, local multihit, using <gm> as workspace.
+ */
+static int
+evocache_build(P7_HMM *ehmm, const P7_RATE *R, const P7_BG *bg, double time, P7_PROFILE *gm, P7_OPROFILE **ret_om, char *errbuf)
+{
+  P7_OPROFILE *om = NULL;
+  int          status;
+
+  if ((status = p7_EvolveFromRate(NULL, ehmm, R, bg, time, errbuf, FALSE)) != eslOK) goto ERROR;
+  if ((status = p7_ProfileConfig(ehmm, bg, gm, 100, p7_LOCAL))             != eslOK) goto ERROR; /* 100 is a dummy length; views reset it */
+  if ((om = p7_oprofile_Create(ehmm->M, ehmm->abc)) == NULL) { status = eslEMEM; goto ERROR; }
+  if ((status = p7_oprofile_Convert(gm, om))                               != eslOK) goto ERROR;
+
+  *ret_om = om;
+  return eslOK;
+
+ ERROR:
+  if (om) p7_oprofile_Destroy(om);
+  *ret_om = NULL;
+  return status;
+}
+
+/*****************************************************************
+ * 3. Unit tests
  *****************************************************************/
 #ifdef evoHMMER_TESTDRIVE
 
@@ -1282,7 +1622,7 @@ utest_hmmevolve(FILE *hmmfp, P7_HMM *hmm, double etaz, double etainf, int N, dou
   
 
 /*****************************************************************
- * 3. Test driver
+ * 4. Test driver
  *****************************************************************/
 #ifdef evoHMMER_TESTDRIVE
 
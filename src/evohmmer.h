@@ -26,6 +26,7 @@
 #define DTMAX 5.50
 #define DTPRE 0.05
 #define DTPOS 5.00
+#define NDTCAL 5    /* grid times calibrated by p7_EvoCacheCalibrate(), besides t* */
 
 
 enum emevol_e  { emNONE = 0, emBYRATE = 1, emBYSCMX = 2 };
@@ -79,6 +80,25 @@ typedef struct p7_rate_s {
   const ESL_ALPHABET *abc_r;	/* reference to the alphabet: includes K, Kp, and sym order */
 } P7_RATE;
 
+/* P7_EVOCACHE: the optimized profiles of one query, evolved to each
+ * time of the rate's divergence-time grid <R->dtval[]>. It is built
+ * once per query and is read-only afterwards, so all worker threads
+ * share one copy; each thread runs its filters on a shallow view of
+ * one entry (see p7_EvoCacheSelect()).
+ */
+typedef struct p7_evocache_s {
+  int            M;             /* model length                                              */
+  int            ndt;           /* number of grid times                                      */
+  float         *dtval;         /* grid times [0..ndt-1], as in <R->dtval[]>                 */
+  P7_OPROFILE  **om;            /* evolved profiles at each grid time [0..ndt-1]             */
+  P7_OPROFILE   *om_star;       /* profile evolved to t* = 1.0                               */
+
+  /* optional calibration table; ncal = 0 if the cache is not calibrated */
+  int            ncal;          /* number of calibrated times                                */
+  float         *caltime;       /* calibrated times [0..ncal-1], increasing                  */
+  float        **calparam;      /* E-value parameters [0..ncal-1][0..p7_NEVPARAM-1]          */
+} P7_EVOCACHE;
+
 struct entropy_param_s {
   float      **pref;
   float      **prob;
@@ -105,6 +125,14 @@ extern int      p7_RestoreHMMmat(P7_HMM *hmm, P7_RATE *R, char *errbuf, int verb
 extern int      p7_CalculatePzero(P7_RATE *R, const P7_HMM *hmm, char *errbuf, int verbose);
 extern int      p7_CalculatePinfy(P7_RATE *R, const P7_HMM *hmm, const P7_BG *bg, char *errbuf, int verbose);
 extern int      er_EntropyWeight(float **prob, int M, int K, float **pref, double etarget, double *ret_cut);
+
+extern int      p7_EvoCacheCreate(const P7_HMM *hmm, const P7_RATE *R, const P7_BG *bg, P7_EVOCACHE **ret_ec, char *errbuf);
+extern int      p7_EvoCacheCalibrate(P7_EVOCACHE *ec, const P7_HMM *hmm, const P7_RATE *R, const P7_BG *bg, ESL_RANDOMNESS *r, int ncal, char *errbuf);
+extern void     p7_EvoCacheEvparams(const P7_EVOCACHE *ec, float time, float *evparam);
+extern int      p7_EvoCacheIndex(const P7_EVOCACHE *ec, float time);
+extern int      p7_EvoCacheSelect(const P7_EVOCACHE *ec, float time, int L, P7_OPROFILE *om);
+extern size_t   p7_EvoCacheSizeof(const P7_EVOCACHE *ec);
+extern void     p7_EvoCacheDestroy(P7_EVOCACHE *ec);
 #endif /*EVOHMMER_INCLUDED*/
 
 /************************************************************
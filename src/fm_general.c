@@ -9,6 +9,13 @@
  */
 #include <p7_config.h>
 
+#include <string.h>
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "easel.h"
 #include "esl_getopts.h"
 #include "hmmer.h"
@@ -473,8 +480,10 @@ void
 fm_FM_destroy ( FM_DATA *fm, int isMainFM)
 {
 
-  free (fm->BWT_mem);
   free (fm->C);
+  if (fm->is_mapped) return;  // the rest belongs to the mapped file
+
+  free (fm->BWT_mem);
   free (fm->occCnts_b);
   free (fm->occCnts_sb);
 
@@ -484,11 +493,71 @@ fm_FM_destroy ( FM_DATA *fm, int isMainFM)
   }
 }
 
+/* fm_read()
+ *
+ * Read <n> bytes from the current position of the open FM-index file
+ * into <buf>; from the mapping, if the file is mapped.
+ *
+ * Returns <eslOK> on success, <eslEFORMAT> if the file ends first.
+ */
+static int
+fm_read(FM_METADATA *meta, void *buf, size_t n)
+{
+  if (meta->map) {
+    if (meta->map_pos + n > meta->map_size) return eslEFORMAT;
+    memcpy(buf, meta->map + meta->map_pos, n);
+    meta->map_pos += n;
+    return eslOK;
+  }
+  return (fread(buf, sizeof(uint8_t), n, meta->fp) == n ? eslOK : eslEFORMAT);
+}
+
+/* fm_skipPad()
+ *
+ * In an aligned FM-index file, move past the padding that puts the
+ * next block or array on a multiple of FM_ALIGN bytes. Does nothing
+ * for files in the older, unpadded layout.
+ */
+static int
+fm_skipPad(FM_METADATA *meta)
+{
+  off_t pos;
+
+  if (! meta->is_aligned) return eslOK;
+
+  if (meta->map) {
+    meta->map_pos = ((meta->map_pos + FM_ALIGN - 1) / FM_ALIGN) * FM_ALIGN;
+    return eslOK;
+  }
+  if ((pos = ftello(meta->fp)) < 0) return eslEFORMAT;
+  if (pos % FM_ALIGN && fseeko(meta->fp, FM_ALIGN - pos % FM_ALIGN, SEEK_CUR) != 0) return eslEFORMAT;
+  return eslOK;
+}
+
+/* fm_mapArray()
+ *
+ * Point <*ret_p> at the next array of <n> bytes in the mapped FM-index
+ * file, after any padding, and move past it.
+ */
+static int
+fm_mapArray(FM_METADATA *meta, size_t n, void **ret_p)
+{
+  fm_skipPad(meta);
+  if (meta->map_pos + n > meta->map_size) return eslEFORMAT;
+  *ret_p = meta->map + meta->map_pos;
+  meta->map_pos += n;
+  return eslOK;
+}
+
 /* Function:  fm_FM_read()
  * Synopsis:  Read the FM index off disk
  * Purpose:   Read the FM-index as written by fmbuild.
  *            First read the metadata header, then allocate space for the full index,
  *            then read it in.
+ *
+ *            If the file has been mapped by <fm_FM_load()>, the BWT, T,
+ *            SA and occurrence count arrays aren't read; <fm> points
+ *            into the mapping instead, and only <fm->C> is allocated.
  */
 int
 fm_FM_read( FM_DATA *fm, FM_METADATA *meta, int getAll )
@@ -507,14 +576,23 @@ fm_FM_read( FM_DATA *fm, FM_METADATA *meta, int getAll )
   int chars_per_byte = 8/meta->charBits;
   int status;
 
-
-  if(fread(&(fm->N), sizeof(uint64_t), 1, meta->fp) !=  1            ||
-     fread(&(fm->term_loc), sizeof(uint32_t), 1, meta->fp) !=  1     ||
-     fread(&(fm->seq_offset), sizeof(uint32_t), 1, meta->fp) !=  1   ||
-     fread(&(fm->ambig_offset), sizeof(uint32_t), 1, meta->fp) !=  1 ||
-     fread(&(fm->overlap), sizeof(uint32_t), 1, meta->fp) !=  1      ||
-     fread(&(fm->seq_cnt), sizeof(uint32_t), 1, meta->fp) !=  1      ||
-     fread(&(fm->ambig_cnt), sizeof(uint32_t), 1, meta->fp) !=  1
+  fm->T          = NULL;
+  fm->BWT_mem    = NULL;
+  fm->BWT        = NULL;
+  fm->SA         = NULL;
+  fm->C          = NULL;
+  fm->occCnts_b  = NULL;
+  fm->occCnts_sb = NULL;
+  fm->is_mapped  = (meta->map != NULL);
+
+  if(fm_skipPad(meta) != eslOK                                         ||
+     fm_read(meta, &(fm->N),            sizeof(uint64_t)) != eslOK     ||
+     fm_read(meta, &(fm->term_loc),     sizeof(uint32_t)) != eslOK     ||
+     fm_read(meta, &(fm->seq_offset),   sizeof(uint32_t)) != eslOK     ||
+     fm_read(meta, &(fm->ambig_offset), sizeof(uint32_t)) != eslOK     ||
+     fm_read(meta, &(fm->overlap),      sizeof(uint32_t)) != eslOK     ||
+     fm_read(meta, &(fm->seq_cnt),      sizeof(uint32_t)) != eslOK     ||
+     fm_read(meta, &(fm->ambig_cnt),    sizeof(uint32_t)) != eslOK
      )
        {status=eslEFORMAT; goto ERROR;}
 
@@ -523,24 +601,43 @@ fm_FM_read( FM_DATA *fm, FM_METADATA *meta, int getAll )
   num_freq_cnts_sb = 1+ceil((double)fm->N/meta->freq_cnt_sb);
   num_SA_samples   = 1+floor((double)fm->N/meta->freq_SA);
 
-  // allocate space, then read the data
-  if (getAll) ESL_ALLOC (fm->T, sizeof(uint8_t) * compressed_bytes );
-  ESL_ALLOC (fm->BWT_mem,  sizeof(uint8_t) * (compressed_bytes + 31) ); // +31 for manual 16-byte alignment  ( typically only need +15, but this allows offset in memory, plus offset in case of <16 bytes of characters at the end)
-     fm->BWT =   (uint8_t *) (((unsigned long int)fm->BWT_mem + 15) & (~0xf));   // align vector memory on 16-byte boundaries
-  if (getAll) ESL_ALLOC (fm->SA, num_SA_samples * sizeof(uint32_t));
   ESL_ALLOC (fm->C, (1+meta->alph_size) * sizeof(int64_t));
-  ESL_ALLOC (fm->occCnts_b,  num_freq_cnts_b *  (meta->alph_size ) * sizeof(uint16_t)); // every freq_cnt positions, store an array of ints
-  ESL_ALLOC (fm->occCnts_sb,  num_freq_cnts_sb *  (meta->alph_size ) * sizeof(uint32_t)); // every freq_cnt positions, store an array of ints
-
 
-  if(
-     (getAll && fread(fm->T, sizeof(uint8_t), compressed_bytes, meta->fp) != compressed_bytes) ||
-     (fread(fm->BWT, sizeof(uint8_t), compressed_bytes, meta->fp)  != compressed_bytes) ||
-     (getAll && fread(fm->SA, sizeof(uint32_t), (size_t)num_SA_samples, meta->fp) != (size_t)num_SA_samples)  ||
-     (fread(fm->occCnts_b, sizeof(uint16_t)*(meta->alph_size), (size_t)num_freq_cnts_b, meta->fp) != (size_t)num_freq_cnts_b)  ||
-     (fread(fm->occCnts_sb, sizeof(uint32_t)*(meta->alph_size), (size_t)num_freq_cnts_sb, meta->fp) != (size_t)num_freq_cnts_sb)
-    )
-    {status=eslEFORMAT; goto ERROR;}
+  if (fm->is_mapped)
+    {
+      /* Arrays start on FM_ALIGN boundaries of a page-aligned mapping,
+       * so the BWT is aligned for vector loads; vector reads past its
+       * end land in the arrays that follow it.
+       */
+      if(
+         (getAll && fm_mapArray(meta, compressed_bytes,                                     (void **) &(fm->T))          != eslOK) ||
+         (fm_mapArray(meta, compressed_bytes,                                               (void **) &(fm->BWT))        != eslOK) ||
+         (getAll && fm_mapArray(meta, num_SA_samples * sizeof(uint32_t),                    (void **) &(fm->SA))         != eslOK) ||
+         (fm_mapArray(meta, num_freq_cnts_b  * meta->alph_size * sizeof(uint16_t),          (void **) &(fm->occCnts_b))  != eslOK) ||
+         (fm_mapArray(meta, num_freq_cnts_sb * meta->alph_size * sizeof(uint32_t),          (void **) &(fm->occCnts_sb)) != eslOK)
+        )
+        {status=eslEFORMAT; goto ERROR;}
+    }
+  else
+    {
+      // allocate space, then read the data
+      if (getAll) ESL_ALLOC (fm->T, sizeof(uint8_t) * compressed_bytes );
+      ESL_ALLOC (fm->BWT_mem,  sizeof(uint8_t) * (compressed_bytes + 31) ); // +31 for manual 16-byte alignment  ( typically only need +15, but this allows offset in memory, plus offset in case of <16 bytes of characters at the end)
+         fm->BWT =   (uint8_t *) (((unsigned long int)fm->BWT_mem + 15) & (~0xf));   // align vector memory on 16-byte boundaries
+      if (getAll) ESL_ALLOC (fm->SA, num_SA_samples * sizeof(uint32_t));
+      ESL_ALLOC (fm->occCnts_b,  num_freq_cnts_b *  (meta->alph_size ) * sizeof(uint16_t)); // every freq_cnt positions, store an array of ints
+      ESL_ALLOC (fm->occCnts_sb,  num_freq_cnts_sb *  (meta->alph_size ) * sizeof(uint32_t)); // every freq_cnt positions, store an array of ints
+
+
+      if(
+         (getAll && (fm_skipPad(meta) != eslOK || fread(fm->T, sizeof(uint8_t), compressed_bytes, meta->fp) != compressed_bytes)) ||
+         (fm_skipPad(meta) != eslOK || fread(fm->BWT, sizeof(uint8_t), compressed_bytes, meta->fp)  != compressed_bytes) ||
+         (getAll && (fm_skipPad(meta) != eslOK || fread(fm->SA, sizeof(uint32_t), (size_t)num_SA_samples, meta->fp) != (size_t)num_SA_samples))  ||
+         (fm_skipPad(meta) != eslOK || fread(fm->occCnts_b, sizeof(uint16_t)*(meta->alph_size), (size_t)num_freq_cnts_b, meta->fp) != (size_t)num_freq_cnts_b)  ||
+         (fm_skipPad(meta) != eslOK || fread(fm->occCnts_sb, sizeof(uint32_t)*(meta->alph_size), (size_t)num_freq_cnts_sb, meta->fp) != (size_t)num_freq_cnts_sb)
+        )
+        {status=eslEFORMAT; goto ERROR;}
+    }
 
   //shortcut variables
   C          = fm->C;
@@ -574,6 +671,125 @@ ERROR:
 }
 
 
+/* load_blocks()
+ * Read (or, with <meta->map> set, point into the map for) the forward
+ * and backward index of every block into <meta->fmf>, <meta->fmb>.
+ * On failure, leaves nothing loaded.
+ */
+static int
+load_blocks( FM_METADATA *meta )
+{
+  int i = 0;
+  int status;
+
+  ESL_ALLOC(meta->fmf, meta->block_count * sizeof(FM_DATA));
+  if (!meta->fwd_only) ESL_ALLOC(meta->fmb, meta->block_count * sizeof(FM_DATA));
+
+  for (i=0; i<meta->block_count; i++) {
+    if ((status = fm_FM_read(meta->fmf+i, meta, TRUE)) != eslOK) goto ERROR;
+
+    if (!meta->fwd_only) {
+      if ((status = fm_FM_read(meta->fmb+i, meta, FALSE)) != eslOK) { fm_FM_destroy(meta->fmf+i, TRUE); goto ERROR; }
+      meta->fmb[i].SA = meta->fmf[i].SA;
+      meta->fmb[i].T  = meta->fmf[i].T;
+    }
+  }
+
+  return eslOK;
+
+ERROR:
+  while (--i >= 0) {
+    fm_FM_destroy(meta->fmf+i, TRUE);
+    if (meta->fmb) fm_FM_destroy(meta->fmb+i, FALSE);
+  }
+  if (meta->fmf) free(meta->fmf);
+  if (meta->fmb) free(meta->fmb);
+  meta->fmf = meta->fmb = NULL;
+  return status;
+}
+
+
+/* Function:  fm_FM_map()
+ * Synopsis:  Map every block of an FM-index, to be shared.
+ * Purpose:   If the open FM-index file <meta->fp> is in the aligned
+ *            layout and the system supports mmap(), map it read-only
+ *            and shared, and set up the forward index and (unless
+ *            <meta->fwd_only>) the backward index of each of the
+ *            <meta->block_count> blocks in <meta->fmf> and <meta->fmb>,
+ *            with their arrays pointing into the mapping. <meta->fp>
+ *            must be positioned just after the metadata read by
+ *            <fm_readFMmeta()>.
+ *
+ *            This costs almost nothing, and the OS keeps one copy of
+ *            the index for every process searching it. Nothing
+ *            modifies a mapped block, so any number of threads may
+ *            search the same blocks at once. <fm_metaDestroy()>
+ *            releases them.
+ *
+ *            If the file can't be mapped, nothing is loaded and
+ *            <meta->fp> is left where it was; the caller reads the
+ *            blocks one at a time with <fm_FM_read()>, as before, so
+ *            that only one block is in memory at once.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslENORESULT> if the file can't be mapped (old unaligned
+ *            layout, no mmap(), or mmap() failed).
+ *            <eslEFORMAT> if the mapped file can't be read as an FM-index.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+fm_FM_map( FM_METADATA *meta )
+{
+#ifdef HAVE_MMAP
+  struct stat st;
+  void       *map;
+  int         status;
+
+  if (! meta->is_aligned || fstat(fileno(meta->fp), &st) != 0 || st.st_size == 0) return eslENORESULT;
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fileno(meta->fp), 0);
+  if (map == MAP_FAILED) return eslENORESULT;
+
+  meta->map      = (char *) map;
+  meta->map_size = st.st_size;
+  meta->map_pos  = ftello(meta->fp);
+
+  if ((status = load_blocks(meta)) != eslOK) {
+    munmap(meta->map, meta->map_size);
+    meta->map = NULL;
+  }
+  return status;
+#else
+  return eslENORESULT;
+#endif
+}
+
+
+/* Function:  fm_FM_load()
+ * Synopsis:  Load every block of an FM-index at once.
+ * Purpose:   As <fm_FM_map()>, but if the file can't be mapped, read
+ *            every block into memory instead. For tools that need
+ *            random access to all blocks at once (hmmerfm-exactmatch);
+ *            a search that goes through the blocks in order should use
+ *            <fm_FM_map()>, and stream the blocks if that fails.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslEFORMAT> if the file can't be read as an FM-index.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+fm_FM_load( FM_METADATA *meta )
+{
+  int status;
+
+  status = fm_FM_map(meta);
+  if (status == eslENORESULT) status = load_blocks(meta);
+  return status;
+}
+
+
 /* Function:  readFMmeta()
  * Synopsis:  Read metadata from disk for the set of FM-indexes stored in a HMMER binary file
  *
@@ -583,12 +799,20 @@ ERROR:
 int
 fm_readFMmeta( FM_METADATA *meta)
 {
+  uint32_t magic;
   int status;
   int i;
 
 
   fm_initAmbiguityList(meta->ambig_list);
 
+  /* Files in the aligned layout start with a magic number; older
+   * files start straight in with the metadata.
+   */
+  if (fread(&magic, sizeof(magic), 1, meta->fp) != 1) {status=eslEFORMAT; goto ERROR;}
+  meta->is_aligned = (magic == FM_MAGIC);
+  if (! meta->is_aligned && fseek(meta->fp, -(long) sizeof(magic), SEEK_CUR) != 0) {status=eslEFORMAT; goto ERROR;}
+
   if( fread(&(meta->fwd_only),     sizeof(meta->fwd_only),     1, meta->fp) != 1 ||
       fread(&(meta->alph_type),    sizeof(meta->alph_type),    1, meta->fp) != 1 ||
       fread(&(meta->alph_size),    sizeof(meta->alph_size),    1, meta->fp) != 1 ||
@@ -683,6 +907,10 @@ fm_configAlloc(FM_CFG **cfg)
 
   ESL_ALLOC(*cfg, sizeof(FM_CFG) );
   ESL_ALLOC((*cfg)->meta, sizeof(FM_METADATA));
+  (*cfg)->meta->seq_data = NULL;
+  (*cfg)->meta->fmf = NULL;
+  (*cfg)->meta->fmb = NULL;
+  (*cfg)->meta->map = NULL;
   ESL_ALLOC ((*cfg)->meta->ambig_list, sizeof(FM_AMBIGLIST));
 
   return eslOK;
@@ -733,6 +961,18 @@ fm_metaDestroy(FM_METADATA *meta ) {
     }
     free(meta->seq_data);
 
+    if (meta->fmf) {
+      for (i=0; i<meta->block_count; i++) {
+        fm_FM_destroy(meta->fmf+i, TRUE);
+        if (meta->fmb) fm_FM_destroy(meta->fmb+i, FALSE);
+      }
+      free(meta->fmf);
+      if (meta->fmb) free(meta->fmb);
+    }
+#ifdef HAVE_MMAP
+    if (meta->map) munmap(meta->map, meta->map_size);
+#endif
+
     if (meta->ambig_list) {
       if (meta->ambig_list->ranges) free(meta->ambig_list->ranges);
       free(meta->ambig_list);
@@ -0,0 +1,619 @@
+/* Portable occurrence counting for the FM-index.
+ *
+ * fm_getOccCount() and fm_getOccCountLT() answer the core FM-index
+ * query - how many times does c (or a character <c) occur in
+ * BWT[0..pos] - from the checkpointed counts in occCnts_sb/occCnts_b,
+ * plus a count over the stretch of BWT between pos and the nearest
+ * checkpoint. That last count is done by one of several engines,
+ * chosen once per FM_CFG by fm_occ_Select():
+ *
+ *    fm_OCC_SSE     the original 16-byte SSE code in fm_sse.c
+ *    fm_OCC_AVX2    32-byte AVX2 code in fm_occ_avx.c
+ *    fm_OCC_SCALAR  64-bit popcounts, below; works anywhere, and
+ *                   is what ARM builds use
+ *
+ * fm_configInit() selects fm_occ_Best(), the fastest engine that was
+ * compiled in and that the processor runs. All engines give the same
+ * counts; the unit tests hold them to it.
+ *
+ * Contents:
+ *   1. Choosing an engine
+ *   2. Occurrence counts
+ *   3. Scalar range counting
+ *   4. Unit tests
+ *   5. Test driver
+ */
+#include <p7_config.h>
+
+#include <string.h>
+
+#include "easel.h"
+#include "hmmer.h"
+
+
+/*****************************************************************
+ * 1. Choosing an engine
+ *****************************************************************/
+
+/* Function:  fm_occ_Available()
+ * Synopsis:  Can this build, on this processor, count with <impl>?
+ *
+ * Returns:   TRUE or FALSE.
+ */
+int
+fm_occ_Available(int impl)
+{
+  switch (impl) {
+  case fm_OCC_SCALAR: return TRUE;
+#if defined eslENABLE_SSE
+  case fm_OCC_SSE:    return TRUE;
+#endif
+#ifdef p7ENABLE_AVX
+  case fm_OCC_AVX2:   return (__builtin_cpu_supports("avx2") ? TRUE : FALSE);
+#endif
+  default:            return FALSE;
+  }
+}
+
+/* Function:  fm_occ_Best()
+ * Synopsis:  Fastest occurrence counting engine available.
+ *
+ * Purpose:   Returns the engine <fm_configInit()> uses: SSE or AVX2,
+ *            the first this build and processor have, else scalar. SSE comes before AVX2 because the stretch counted
+ *            is at most half a bin (32 bytes of DNA BWT at the default
+ *            bin of 256), too short for wider vectors to pay off; SSE
+ *            was as fast or faster at every bin size we timed.
+ */
+int
+fm_occ_Best(void)
+{
+  if (fm_occ_Available(fm_OCC_SSE))  return fm_OCC_SSE;
+  if (fm_occ_Available(fm_OCC_AVX2)) return fm_OCC_AVX2;
+  return fm_OCC_SCALAR;
+}
+
+/* Function:  fm_occ_Select()
+ * Synopsis:  Set the occurrence counting engine used with <cfg>.
+ *
+ * Purpose:   Make <fm_getOccCount()> and <fm_getOccCountLT()> count
+ *            with <impl> when given <cfg>. The SSE engine needs the
+ *            vectors set up by <fm_configInit()>, so select it only
+ *            on a <cfg> that has been through that.
+ *
+ * Returns:   <eslOK> on success; <eslEINVAL> if <impl> isn't
+ *            available, in which case <cfg> is unchanged.
+ */
+int
+fm_occ_Select(FM_CFG *cfg, int impl)
+{
+  if (! fm_occ_Available(impl)) return eslEINVAL;
+  cfg->occ_impl = impl;
+  return eslOK;
+}
+
+/* Function:  fm_occ_Name()
+ * Synopsis:  Name of an occurrence counting engine, for output.
+ */
+const char *
+fm_occ_Name(int impl)
+{
+  switch (impl) {
+  case fm_OCC_SCALAR: return "scalar";
+  case fm_OCC_SSE:    return "SSE";
+  case fm_OCC_AVX2:   return "AVX2";
+  default:            return "unknown";
+  }
+}
+
+
+/*****************************************************************
+ * 2. Occurrence counts
+ *****************************************************************/
+
+/* occ_range()
+ *
+ * Count the characters ==c, and (if <ret_lt> isn't NULL) <c, in
+ * BWT positions lo..hi, with the selected engine.
+ */
+static void
+occ_range(const FM_CFG *cfg, const uint8_t *BWT, int lo, int hi, uint8_t c, uint32_t *ret_eq, uint32_t *ret_lt)
+{
+  switch (cfg->occ_impl) {
+#ifdef p7ENABLE_AVX
+  case fm_OCC_AVX2: fm_occRange_avx2  (BWT, cfg->meta->alph_type, lo, hi, c, ret_eq, ret_lt); return;
+#endif
+  default:          fm_occRange_scalar(BWT, cfg->meta->alph_type, lo, hi, c, ret_eq, ret_lt); return;
+  }
+}
+
+
+/* Function:  fm_getOccCount()
+ * Synopsis:  Compute number of occurrences of c in BWT[1..pos]
+ *
+ * Purpose:   Start from the checkpointed occurrence counts in occCnts_sb
+ *            and occCnts_b, using the checkpoint closest to pos, then
+ *            count (or subtract, if the checkpoint follows pos) the
+ *            occurrences of c between the checkpoint and pos, using the
+ *            engine selected in <cfg>.
+ */
+int
+fm_getOccCount (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c)
+{
+  FM_METADATA *meta = cfg->meta;
+  const uint16_t * occCnts_b  = fm->occCnts_b;
+  const uint32_t * occCnts_sb = fm->occCnts_sb;
+  const int b_pos          = (pos+1) / meta->freq_cnt_b;  //floor(pos/b_size)   : the b count element preceding pos
+  const int sb_pos         = (pos+1) / meta->freq_cnt_sb; //floor(pos/sb_size) : the sb count element preceding pos
+  const int b_rel_pos      = (pos+1) & (meta->freq_cnt_b - 1); // pos % b_size   : how close is pos to the boundary corresponding to b_pos
+  int       up_b           = 2*b_rel_pos/meta->freq_cnt_b;      //1 if pos is expected to be closer to the boundary of b_pos+1, 0 otherwise
+  int       landmark       = ((b_pos+up_b)*meta->freq_cnt_b) - 1 ;
+  uint32_t  n;
+  int       cnt;
+
+#if defined eslENABLE_SSE
+  if (cfg->occ_impl == fm_OCC_SSE) return fm_getOccCount_sse(fm, cfg, pos, c);
+#endif
+
+  if (landmark >= fm->N) { // special case: for a count in the final block, just count from the bottom
+    up_b      = 0;
+    landmark  = (b_pos*(meta->freq_cnt_b)) - 1 ;
+  }
+
+  // get the cnt stored at the nearest checkpoint
+  cnt = FM_OCC_CNT(sb, sb_pos, c );
+  if (up_b)
+    cnt += FM_OCC_CNT(b, b_pos + 1, c ) ;
+  else if ( b_pos !=  sb_pos * (meta->freq_cnt_sb / meta->freq_cnt_b) )
+    cnt += FM_OCC_CNT(b, b_pos, c )  ;// b_pos has cumulative counts since the prior sb_pos - if sb_pos references the same count as b_pos, it'll doublecount
+
+  if (!up_b && pos > landmark) { // count forward, adding
+    occ_range(cfg, fm->BWT, landmark+1, pos, c, &n, NULL);
+    cnt += n;
+  } else if (up_b && landmark > pos) { // count backwards, subtracting
+    occ_range(cfg, fm->BWT, pos+1, landmark, c, &n, NULL);
+    cnt -= n;
+  }
+
+  if (c==0 && pos >= fm->term_loc) // I overcounted 'A' by one, because '$' was replaced with an 'A'
+    cnt--;
+
+  return cnt;
+}
+
+
+/* Function:  fm_getOccCountLT()
+ * Synopsis:  Compute number of occurrences of characters with value <c in BWT[1..pos]
+ *
+ * Purpose:   As <fm_getOccCount()>, returning the count of c in <*cnteq>
+ *            and the count of characters less than c in <*cntlt>.
+ */
+int
+fm_getOccCountLT (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c, uint32_t *cnteq, uint32_t *cntlt)
+{
+  FM_METADATA *meta = cfg->meta;
+  const uint16_t * occCnts_b  = fm->occCnts_b;
+  const uint32_t * occCnts_sb = fm->occCnts_sb;
+  const int b_pos          = (pos+1) / meta->freq_cnt_b;  //floor(pos/b_size)   : the b count element preceding pos
+  const int sb_pos         = (pos+1) / meta->freq_cnt_sb; //floor(pos/sb_size) : the sb count element preceding pos
+  const int b_rel_pos      = (pos+1) % meta->freq_cnt_b;  //  how close is pos to the boundary corresponding to b_pos
+  int       up_b           = 2*b_rel_pos/meta->freq_cnt_b; //1 if pos is expected to be closer to the boundary of b_pos+1, 0 otherwise
+  int       landmark       = ((b_pos+up_b)*(meta->freq_cnt_b)) - 1 ;
+  uint32_t  n_eq, n_lt;
+  int       i;
+
+#if defined eslENABLE_SSE
+  if (cfg->occ_impl == fm_OCC_SSE) return fm_getOccCountLT_sse(fm, cfg, pos, c, cnteq, cntlt);
+#endif
+
+  if (landmark >= fm->N) { // special case: for a count in the final block, just count from the bottom
+    up_b      = 0;
+    landmark  = (b_pos*(meta->freq_cnt_b)) - 1 ;
+  }
+
+  // get the cnt stored at the nearest checkpoint
+  *cntlt = 0;
+  *cnteq = FM_OCC_CNT(sb, sb_pos, c );
+  for (i=0; i<c; i++)
+    *cntlt += FM_OCC_CNT(sb, sb_pos, i );
+
+  if (up_b) {
+    *cnteq += FM_OCC_CNT(b, b_pos + 1, c ) ;
+    for (i=0; i<c; i++)
+      *cntlt += FM_OCC_CNT(b, b_pos + 1, i ) ;
+  } else if ( b_pos !=  sb_pos * (meta->freq_cnt_sb / meta->freq_cnt_b))  {
+    *cnteq += FM_OCC_CNT(b, b_pos, c )  ;// b_pos has cumulative counts since the prior sb_pos - if sb_pos references the same count as b_pos, it'll doublecount
+    for (i=0; i<c; i++)
+      *cntlt += FM_OCC_CNT(b, b_pos, i ) ;
+  }
+
+  if (!up_b && pos > landmark) { // count forward, adding
+    occ_range(cfg, fm->BWT, landmark+1, pos, c, &n_eq, &n_lt);
+    *cnteq += n_eq;
+    *cntlt += n_lt;
+  } else if (up_b && landmark > pos) { // count backwards, subtracting
+    occ_range(cfg, fm->BWT, pos+1, landmark, c, &n_eq, &n_lt);
+    *cnteq -= n_eq;
+    *cntlt -= n_lt;
+  }
+
+  if ( pos >= fm->term_loc && c == 0) { // deal with the fact that '$' was replaced with an 'A'
+    (*cnteq)--;   // I overcounted 'A' by one
+    (*cntlt) = 1; // '$' is lexicographically lower than 'A', but I didn't count it in the method above
+  }
+
+  return eslOK;
+}
+
+
+/*****************************************************************
+ * 3. Scalar range counting
+ *****************************************************************/
+
+/* The DNA BWT is packed 4 characters per byte, the first in the two
+ * high bits. To find matches to c, xor each byte with c copied into
+ * all four 2-bit fields (c * 0x55): a field is 00 only where the
+ * character matches. (x | x>>1) & 0x55 then has one bit set for each
+ * mismatching field, and its complement one bit for each match, ready
+ * for a popcount.
+ *
+ * Characters less than c are found in the same pass, from the BWT
+ * itself: with h = x>>1 (each field's high bit moved onto its low
+ * bit), a field is <1 where ~(x|h), <2 where ~h and <3 where ~(x&h)
+ * has its low bit set. Shifting a whole word also moves the next
+ * byte's low bit into a high bit, which the 0x55 mask drops.
+ */
+#define FM_DNA_MATCHES8(v, pat)   ((uint8_t) (~(((v)^(pat)) | (((v)^(pat)) >> 1)) & 0x55))
+
+static inline uint64_t
+occ_dna_lt64(uint64_t w, uint8_t c)
+{
+  switch (c) {
+  case 1:  return ~(w | (w >> 1)) & 0x5555555555555555ULL;
+  case 2:  return ~(w >> 1)       & 0x5555555555555555ULL;
+  case 3:  return ~(w & (w >> 1)) & 0x5555555555555555ULL;
+  default: return 0;
+  }
+}
+
+static inline int
+occ_popcount64(uint64_t v)
+{
+#if defined __GNUC__
+  return __builtin_popcountll(v);
+#else
+  v = v - ((v >> 1) & 0x5555555555555555ULL);
+  v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+  v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (int) ((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/* occ_dna_scalar()
+ *
+ * Number of occurrences of 2-bit character <c> in positions lo..hi of
+ * a packed DNA BWT, in <*ret_eq>; and if <ret_lt> isn't NULL, the
+ * number of characters less than c in <*ret_lt>.
+ */
+static void
+occ_dna_scalar(const uint8_t *BWT, int lo, int hi, uint8_t c, uint32_t *ret_eq, uint32_t *ret_lt)
+{
+  const uint8_t  pat8   = c * 0x55;
+  const uint64_t pat64  = c * 0x5555555555555555ULL;
+  const uint8_t  lomask = 0xff >> (2 * (lo & 0x3));                // fields at or after lo, in lo's byte
+  const uint8_t  himask = (uint8_t) (0xff << (6 - 2 * (hi & 0x3))); // fields at or before hi, in hi's byte
+  const int      do_lt  = (ret_lt != NULL && c > 0);
+  int            b      = lo >> 2;
+  int            bhi    = hi >> 2;
+  uint64_t       w, x;
+  uint32_t       n_eq, n_lt;
+
+  if (b == bhi) {
+    n_eq = occ_popcount64(FM_DNA_MATCHES8(BWT[b], pat8) & lomask & himask);
+    n_lt = do_lt ? occ_popcount64(occ_dna_lt64(BWT[b], c) & lomask & himask & 0x55) : 0;
+  } else {
+    n_eq = occ_popcount64(FM_DNA_MATCHES8(BWT[b], pat8) & lomask);
+    n_lt = do_lt ? occ_popcount64(occ_dna_lt64(BWT[b], c) & lomask & 0x55) : 0;
+    for (b++; b + 8 <= bhi; b += 8) {
+      memcpy(&w, BWT + b, sizeof(uint64_t));
+      x     = w ^ pat64;
+      n_eq += occ_popcount64(~(x | (x >> 1)) & 0x5555555555555555ULL);
+      if (do_lt) n_lt += occ_popcount64(occ_dna_lt64(w, c));
+    }
+    for ( ; b < bhi; b++) {
+      n_eq += occ_popcount64(FM_DNA_MATCHES8(BWT[b], pat8));
+      if (do_lt) n_lt += occ_popcount64(occ_dna_lt64(BWT[b], c) & 0x55);
+    }
+    n_eq += occ_popcount64(FM_DNA_MATCHES8(BWT[bhi], pat8) & himask);
+    if (do_lt) n_lt += occ_popcount64(occ_dna_lt64(BWT[bhi], c) & himask & 0x55);
+  }
+
+  *ret_eq = n_eq;
+  if (ret_lt) *ret_lt = n_lt;
+}
+
+/* Function:  fm_occRange_scalar()
+ * Synopsis:  Count characters ==c and <c in part of a BWT.
+ *
+ * Purpose:   Count the characters equal to <c> in positions <lo..hi>
+ *            (inclusive) of <BWT>, packed as for <alph_type>, and
+ *            return the count in <*ret_eq>. If <ret_lt> is non-NULL,
+ *            also return the number of characters less than <c> in
+ *            <*ret_lt>. This is the engine-specific part of
+ *            <fm_getOccCount()>; the AVX2 version has the
+ *            same interface, and use this one for the ends of a range
+ *            that don't fill a vector.
+ */
+void
+fm_occRange_scalar(const uint8_t *BWT, int alph_type, int lo, int hi, uint8_t c, uint32_t *ret_eq, uint32_t *ret_lt)
+{
+  uint32_t n_eq = 0;
+  uint32_t n_lt = 0;
+  int      i;
+
+  if (lo > hi) ;
+  else if (alph_type == fm_DNA) {
+    occ_dna_scalar(BWT, lo, hi, c, &n_eq, &n_lt);
+  } else { //amino: one character per byte
+    for (i=lo; i<=hi; i++) {
+      n_eq += (BWT[i] == c);
+      n_lt += (BWT[i] <  c);
+    }
+  }
+
+  *ret_eq = n_eq;
+  if (ret_lt) *ret_lt = n_lt;
+}
+
+
+/*****************************************************************
+ * 4. Unit tests
+ *****************************************************************/
+#ifdef p7FM_OCC_TESTDRIVE
+#include "esl_random.h"
+
+/* Build a random FM_DATA of length <N>: the occurrence count
+ * functions only look at the BWT and its checkpoints, which are
+ * made exactly as hmmer-makefmdb makes them. <ret_text> gets the
+ * unpacked BWT.
+ */
+static void
+create_random_fm(ESL_RANDOMNESS *rng, FM_METADATA *meta, int N, FM_DATA *fm, uint8_t **ret_text)
+{
+  char      msg[]          = "fm_occ test FM-index creation failed";
+  int       num_freq_cnts_b  = 1+ceil((double)N/meta->freq_cnt_b);
+  int       num_freq_cnts_sb = 1+ceil((double)N/meta->freq_cnt_sb);
+  uint16_t *occCnts_b      = NULL;
+  uint32_t *occCnts_sb     = NULL;
+  uint32_t  cnts_sb[32];
+  uint16_t  cnts_b[32];
+  uint8_t  *text           = NULL;
+  int       j, c, status;
+
+  ESL_ALLOC(text,       N);
+  ESL_ALLOC(fm->BWT_mem, N + 16);
+  ESL_ALLOC(occCnts_b,  num_freq_cnts_b  * meta->alph_size * sizeof(uint16_t));
+  ESL_ALLOC(occCnts_sb, num_freq_cnts_sb * meta->alph_size * sizeof(uint32_t));
+  fm->BWT        = (uint8_t *) (((unsigned long int)(fm->BWT_mem) + 15) & (~0xf));  // the SSE engine needs 16-byte alignment
+  fm->N          = N;
+  fm->term_loc   = esl_rnd_Roll(rng, N);
+  fm->occCnts_b  = occCnts_b;
+  fm->occCnts_sb = occCnts_sb;
+
+  for (j=0; j<N; j++) {
+    text[j] = esl_rnd_Roll(rng, meta->alph_size);
+    if (j%97 > 80) text[j] = text[j-1];         // runs, as real BWTs have
+  }
+  text[fm->term_loc] = 0;                       // '$' is stored as 'A'
+
+  for (c=0; c<meta->alph_size; c++) {
+    cnts_sb[c] = cnts_b[c] = 0;
+    FM_OCC_CNT(sb, 0, c ) = 0;
+    FM_OCC_CNT(b, 0, c )  = 0;
+  }
+  for (j=0; j<N; j++) {
+    cnts_sb[text[j]]++;
+    cnts_b[text[j]]++;
+    if ( !((j+1) % meta->freq_cnt_b) ) {
+      for (c=0; c<meta->alph_size; c++)
+        FM_OCC_CNT(b, ((j+1)/meta->freq_cnt_b), c ) = cnts_b[c];
+      if ( !((j+1) % meta->freq_cnt_sb) )
+        for (c=0; c<meta->alph_size; c++) {
+          FM_OCC_CNT(sb, ((j+1)/meta->freq_cnt_sb), c ) = cnts_sb[c];
+          cnts_b[c] = 0;
+        }
+    }
+  }
+  for (c=0; c<meta->alph_size; c++) {
+    if (N % meta->freq_cnt_b)
+      FM_OCC_CNT(b,  num_freq_cnts_b-1,  c ) = cnts_b[c];
+    FM_OCC_CNT(sb, num_freq_cnts_sb-1, c ) = cnts_sb[c];
+  }
+
+  memset(fm->BWT_mem, 0, N + 16);
+  for (j=0; j<N; j++) {
+    if (meta->alph_type == fm_DNA) fm->BWT[j/4] |= text[j] << (6 - 2*(j%4));
+    else                           fm->BWT[j]    = text[j];
+  }
+
+  *ret_text = text;
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
+
+/* utest_counts()
+ *
+ * Every available engine must agree with a naive count of the
+ * unpacked BWT, at every position of random BWTs of both alphabets,
+ * for each bin size, including lengths that end exactly on a
+ * checkpoint.
+ */
+static void
+utest_counts(ESL_RANDOMNESS *rng, int be_verbose)
+{
+  char         msg[]       = "fm_occ counts unit test failed";
+  int          alph_types[2] = { fm_DNA, fm_AMINO };
+  int          bins[3]     = { 64, 256, 4096 };
+  FM_METADATA  meta;
+  FM_CFG      *cfg         = NULL;
+  FM_DATA      fm;
+  uint8_t     *text        = NULL;
+  uint32_t    *true_eq     = NULL;
+  uint32_t     cnteq, cntlt, true_lt;
+  int          a, b, k, impl, N, pos, c, status;
+
+  ESL_ALLOC(cfg, sizeof(FM_CFG));
+  cfg->meta = &meta;
+
+  for (a=0; a<2; a++)
+    for (b=0; b<3; b++)
+      {
+        meta.alph_type   = alph_types[a];
+        meta.alph_size   = (alph_types[a] == fm_DNA ? 4 : 20);
+        meta.freq_cnt_b  = bins[b];
+        meta.freq_cnt_sb = 65536;
+        N = (b == 1 ? 3*65536 : 1 + esl_rnd_Roll(rng, 20000));
+        if (esl_rnd_Roll(rng, 2)) N -= N % meta.freq_cnt_b;  // end on a checkpoint
+        if (N < 1) N = meta.freq_cnt_b;
+
+        create_random_fm(rng, &meta, N, &fm, &text);
+        ESL_ALLOC(true_eq, meta.alph_size * sizeof(uint32_t));
+
+        for (impl=fm_OCC_SCALAR; impl<=fm_OCC_AVX2; impl++)
+          {
+            if (! fm_occ_Available(impl)) continue;
+            if (impl == fm_OCC_SSE) continue;  // needs fm_configInit()'s vectors; checked in utest_sse()
+            if (fm_occ_Select(cfg, impl) != eslOK) esl_fatal(msg);
+            if (be_verbose) printf("  %-6s  alph_type %d  bin %4d  N %6d\n", fm_occ_Name(impl), meta.alph_type, meta.freq_cnt_b, N);
+
+            for (c=0; c<meta.alph_size; c++) true_eq[c] = 0;
+            for (pos=0; pos<N; pos++) {
+              if (pos != fm.term_loc) true_eq[text[pos]]++;
+              for (c=0; c<meta.alph_size; c++) {
+                if (fm_getOccCount(&fm, cfg, pos, c) != true_eq[c]) esl_fatal("%s: %s count of %d at %d", msg, fm_occ_Name(impl), c, pos);
+
+                true_lt = (pos >= fm.term_loc ? 1 : 0);  // '$' is less than everything
+                for (k=0; k<c; k++) true_lt += true_eq[k];
+                fm_getOccCountLT(&fm, cfg, pos, c, &cnteq, &cntlt);
+                if (cnteq != true_eq[c] || cntlt != true_lt) esl_fatal("%s: %s LT count of %d at %d", msg, fm_occ_Name(impl), c, pos);
+              }
+            }
+          }
+
+        free(true_eq);
+        free(text);
+        free(fm.BWT_mem);
+        free(fm.occCnts_b);
+        free(fm.occCnts_sb);
+      }
+
+  free(cfg);
+  return;
+
+ ERROR:
+  esl_fatal(msg);
+}
+
+#if defined eslENABLE_SSE
+/* utest_sse()
+ *
+ * The SSE engine, with the vectors fm_configInit() sets up for a
+ * DNA index, must agree with the scalar engine everywhere, including
+ * on a BWT that ends on a checkpoint.
+ */
+static void
+utest_sse(ESL_RANDOMNESS *rng)
+{
+  char         msg[] = "fm_occ SSE unit test failed";
+  FM_CFG      *cfg   = NULL;
+  FM_DATA      fm;
+  uint8_t     *text  = NULL;
+  uint32_t     eq1, lt1, eq2, lt2;
+  int          k, N, pos, c, x1, x2;
+
+  if (fm_configAlloc(&cfg)  != eslOK) esl_fatal(msg);
+  cfg->meta->alph_type   = fm_DNA;
+  if (fm_alphabetCreate(cfg->meta, NULL) != eslOK) esl_fatal(msg);
+  cfg->meta->freq_cnt_b  = 256;
+  cfg->meta->freq_cnt_sb = 65536;
+  cfg->meta->seq_count   = 0;
+  cfg->meta->block_count = 0;
+  cfg->meta->ambig_list->ranges = NULL;
+  if (fm_configInit(cfg, NULL) != eslOK) esl_fatal(msg);
+
+  for (k=0; k<2; k++)
+    {
+      N = 65536 + 1 + esl_rnd_Roll(rng, 65536);
+      if (k == 1) N -= N % cfg->meta->freq_cnt_b;  // end on a checkpoint
+      create_random_fm(rng, cfg->meta, N, &fm, &text);
+
+      for (pos=0; pos<N; pos++)
+        for (c=0; c<4; c++) {
+          fm_occ_Select(cfg, fm_OCC_SCALAR);
+          x1 = fm_getOccCount(&fm, cfg, pos, c);
+          fm_getOccCountLT(&fm, cfg, pos, c, &eq1, &lt1);
+          fm_occ_Select(cfg, fm_OCC_SSE);
+          x2 = fm_getOccCount(&fm, cfg, pos, c);
+          fm_getOccCountLT(&fm, cfg, pos, c, &eq2, &lt2);
+          if (x1 != x2 || eq1 != eq2 || lt1 != lt2) esl_fatal("%s: count of %d at %d", msg, c, pos);
+        }
+
+      free(text);
+      free(fm.BWT_mem);
+      free(fm.occCnts_b);
+      free(fm.occCnts_sb);
+    }
+
+  fm_configDestroy(cfg);
+}
+#endif /*eslENABLE_SSE*/
+
+#endif /*p7FM_OCC_TESTDRIVE*/
+
+
+
+/*****************************************************************
+ * 5. Test driver
+ *****************************************************************/
+#ifdef p7FM_OCC_TESTDRIVE
+#include <p7_config.h>
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "easel.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+#include "hmmer.h"
+
+static ESL_OPTIONS options[] = {
+   /* name  type         default  env   range togs  reqs  incomp  help                docgrp */
+  {"-h",  eslARG_NONE,    FALSE, NULL, NULL, NULL, NULL, NULL, "show help and usage",                            0},
+  {"-s",  eslARG_INT,       "0", NULL, NULL, NULL, NULL, NULL, "set random number seed to <n>",                  0},
+  {"-v",  eslARG_NONE,    FALSE, NULL, NULL, NULL, NULL, NULL, "show verbose commentary/output",                 0},
+  { 0,0,0,0,0,0,0,0,0,0},
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for FM-index occurrence counting";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go          = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng         = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  int             be_verbose  = esl_opt_GetBoolean(go, "-v");
+
+  if (be_verbose) printf("fm_occ unit test: rng seed %" PRIu32 "; best engine %s\n", esl_randomness_GetSeed(rng), fm_occ_Name(fm_occ_Best()));
+
+  utest_counts(rng, be_verbose);
+#if defined eslENABLE_SSE
+  utest_sse(rng);
+#endif
+
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /* p7FM_OCC_TESTDRIVE */
@@ -0,0 +1,150 @@
+/* AVX2 occurrence counting for the FM-index.
+ *
+ * Compiled with AVX_CFLAGS, in addition to the SSE code; only called
+ * when fm_occ_Available() finds the processor has AVX2. See fm_occ.c.
+ */
+#include <p7_config.h>
+
+#ifdef p7ENABLE_AVX
+#include <immintrin.h>
+
+#include "easel.h"
+#include "hmmer.h"
+
+
+/* occ_dna_avx2()
+ *
+ * Number of occurrences of <c>, and of characters less than <c>, in
+ * the <ndw> 4-byte words of a packed DNA BWT starting at <BWT>. Whole
+ * 32-byte vectors are loaded where they fit, and the last part with
+ * _mm256_maskload_epi32(), which reads nothing past the range.
+ *
+ * The field tests are those of the scalar code in fm_occ.c; the
+ * 16-bit shift only moves high bits of a field into its own low bit,
+ * or into a high bit that is masked off. Per-byte counts (0..4) come
+ * from adding the 2-bit fields pairwise, and _mm256_sad_epu8() sums
+ * them into 64-bit lanes on every vector.
+ */
+static const int32_t occ_dword_mask[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+static inline __m256i
+occ_dna_bytecounts(__m256i x_v)
+{
+  const __m256i m33 = _mm256_set1_epi8(0x33);
+  const __m256i m0f = _mm256_set1_epi8(0x0f);
+
+  x_v = _mm256_add_epi8(_mm256_and_si256(x_v, m33), _mm256_and_si256(_mm256_srli_epi16(x_v, 2), m33)); // 0..2 in each half-byte
+  x_v = _mm256_add_epi8(_mm256_and_si256(x_v, m0f), _mm256_and_si256(_mm256_srli_epi16(x_v, 4), m0f)); // 0..4 in each byte
+  return _mm256_sad_epu8(x_v, _mm256_setzero_si256());
+}
+
+static void
+occ_dna_avx2(const uint8_t *BWT, int ndw, uint8_t c, uint32_t *ret_eq, uint32_t *ret_lt)
+{
+  const __m256i m01  = _mm256_set1_epi8(0x55);
+  const __m256i c_v  = _mm256_set1_epi8((int8_t) (c * 0x55));
+  __m256i       eq_v = _mm256_setzero_si256();
+  __m256i       lt_v = _mm256_setzero_si256();
+  __m256i       ok_v = m01;   // fields to count: all, but for the masked-off end of the last vector
+  __m256i       w_v, x_v, h_v;
+  int           i;
+
+  for (i=0; i<ndw; i+=8) {
+    if (ndw - i >= 8)
+      w_v  = _mm256_loadu_si256((const __m256i *) (BWT + 4*i));
+    else {
+      ok_v = _mm256_and_si256(m01, _mm256_loadu_si256((const __m256i *) (occ_dword_mask + 8 - (ndw - i))));
+      w_v  = _mm256_maskload_epi32((const int *) (BWT + 4*i), _mm256_loadu_si256((const __m256i *) (occ_dword_mask + 8 - (ndw - i))));
+    }
+
+    x_v  = _mm256_xor_si256(w_v, c_v);
+    x_v  = _mm256_andnot_si256(_mm256_or_si256(x_v, _mm256_srli_epi16(x_v, 1)), ok_v);  // 01 in each matching field
+    eq_v = _mm256_add_epi64(eq_v, occ_dna_bytecounts(x_v));
+
+    h_v  = _mm256_srli_epi16(w_v, 1);
+    switch (c) {
+    case 1: x_v = _mm256_andnot_si256(_mm256_or_si256(w_v, h_v),  ok_v); break;  // 01 in each field <c
+    case 2: x_v = _mm256_andnot_si256(h_v, ok_v);                         break;
+    case 3: x_v = _mm256_andnot_si256(_mm256_and_si256(w_v, h_v), ok_v); break;
+    default: continue;
+    }
+    lt_v = _mm256_add_epi64(lt_v, occ_dna_bytecounts(x_v));
+  }
+
+  *ret_eq = (uint32_t) (_mm256_extract_epi64(eq_v, 0) + _mm256_extract_epi64(eq_v, 1) +
+                        _mm256_extract_epi64(eq_v, 2) + _mm256_extract_epi64(eq_v, 3));
+  *ret_lt = (uint32_t) (_mm256_extract_epi64(lt_v, 0) + _mm256_extract_epi64(lt_v, 1) +
+                        _mm256_extract_epi64(lt_v, 2) + _mm256_extract_epi64(lt_v, 3));
+}
+
+
+/* occ_amino_avx2()
+ *
+ * Number of bytes ==c, and <c, in the <ndw> 4-byte words of an
+ * unpacked BWT starting at <BWT>: a popcount of the compare masks,
+ * loading as occ_dna_avx2() does.
+ */
+static void
+occ_amino_avx2(const uint8_t *BWT, int ndw, uint8_t c, uint32_t *ret_eq, uint32_t *ret_lt)
+{
+  const __m256i c_v  = _mm256_set1_epi8((int8_t) c);
+  uint32_t      ok   = 0xffffffff;  // bytes to count
+  uint32_t      n_eq = 0;
+  uint32_t      n_lt = 0;
+  __m256i       x_v, m_v;
+  int           i;
+
+  for (i=0; i<ndw; i+=8) {  // characters are <128, so signed compares are fine
+    if (ndw - i >= 8)
+      x_v = _mm256_loadu_si256((const __m256i *) (BWT + 4*i));
+    else {
+      m_v = _mm256_loadu_si256((const __m256i *) (occ_dword_mask + 8 - (ndw - i)));
+      ok  = (uint32_t) _mm256_movemask_epi8(m_v);
+      x_v = _mm256_maskload_epi32((const int *) (BWT + 4*i), m_v);
+    }
+    n_eq += __builtin_popcount(ok & (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x_v, c_v)));
+    n_lt += __builtin_popcount(ok & (uint32_t) _mm256_movemask_epi8(_mm256_cmpgt_epi8(c_v, x_v)));
+  }
+  *ret_eq = n_eq;
+  *ret_lt = n_lt;
+}
+
+
+/* Function:  fm_occRange_avx2()
+ * Synopsis:  AVX2 version of <fm_occRange_scalar()>.
+ *
+ * Purpose:   Count the whole 4-byte words inside <lo..hi> with AVX2,
+ *            and the few characters at either end with
+ *            <fm_occRange_scalar()>; nothing outside <lo..hi> is read.
+ */
+void
+fm_occRange_avx2(const uint8_t *BWT, int alph_type, int lo, int hi, uint8_t c, uint32_t *ret_eq, uint32_t *ret_lt)
+{
+  int      per_byte = (alph_type == fm_DNA ? 4 : 1);
+  int      b0       = (lo + per_byte - 1) / per_byte;  // first byte wholly in lo..hi
+  int      ndw      = ((hi + 1) / per_byte - b0) / 4;   // 4-byte words wholly in lo..hi
+  int      vlo      = b0 * per_byte;                     // first position they cover ...
+  int      vhi      = (b0 + 4*ndw) * per_byte - 1;       // ... and last
+  uint32_t n_eq, n_lt, tmp_eq, tmp_lt;
+
+  if (ndw <= 0) { fm_occRange_scalar(BWT, alph_type, lo, hi, c, ret_eq, ret_lt); return; }
+
+  if (alph_type == fm_DNA) occ_dna_avx2  (BWT + b0, ndw, c, &n_eq, &n_lt);
+  else                     occ_amino_avx2(BWT + b0, ndw, c, &n_eq, &n_lt);
+
+  if (lo < vlo) {
+    fm_occRange_scalar(BWT, alph_type, lo, vlo-1, c, &tmp_eq, &tmp_lt);
+    n_eq += tmp_eq;
+    n_lt += tmp_lt;
+  }
+  if (vhi < hi) {
+    fm_occRange_scalar(BWT, alph_type, vhi+1, hi, c, &tmp_eq, &tmp_lt);
+    n_eq += tmp_eq;
+    n_lt += tmp_lt;
+  }
+
+  *ret_eq = n_eq;
+  if (ret_lt) *ret_lt = n_lt;
+}
+
+#endif /*p7ENABLE_AVX*/
@@ -148,6 +148,8 @@ fm_configInit( FM_CFG *cfg, ESL_GETOPTS *go )
   }
 #endif // eslENABLE_SSE
 
+  fm_occ_Select(cfg, fm_occ_Best());
+
 /*
   if (cfg->meta->alph_type == fm_DNA_full) {
     cfg->fm_masks_v[16]          = cfg->fm_allones_v;
@@ -169,8 +171,8 @@ ERROR:
 
 
 
-/* Function:  fm_getOccCount()
- * Synopsis:  Compute number of occurrences of c in BWT[1..pos]
+/* Function:  fm_getOccCount_sse()
+ * Synopsis:  SSE engine for <fm_getOccCount()>.
  *
  * Purpose:   Scan through the BWT to compute number of occurrence of c in BWT[0..pos],
  *            using SSE to scan 16 bytes-at-a-time.
@@ -188,7 +190,7 @@ ERROR:
  *            and certainly better space-utilization.
  */
 int
-fm_getOccCount (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c)
+fm_getOccCount_sse (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c)
 {
   FM_METADATA *meta = cfg->meta;
   int cnt = 0;
@@ -352,8 +354,8 @@ fm_getOccCount (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c)
 
 
 
-/* Function:  fm_getOccCountLT()
- * Synopsis:  Compute number of occurrences of characters with value <c in BWT[1..pos]
+/* Function:  fm_getOccCountLT_sse()
+ * Synopsis:  SSE engine for <fm_getOccCountLT()>.
  *
  * Purpose:   Scan through the BWT to compute number of occurrences of characters with value <c
  *            in BWT[0..pos], using SSE to scan 16 bytes-at-a-time.
@@ -372,7 +374,7 @@ fm_getOccCount (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c)
  *
  */
 int
-fm_getOccCountLT (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c, uint32_t *cnteq, uint32_t *cntlt)
+fm_getOccCountLT_sse (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c, uint32_t *cnteq, uint32_t *cntlt)
 {
   FM_METADATA *meta = cfg->meta;
   int i;
@@ -410,7 +412,7 @@ fm_getOccCountLT (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c, uint
 #if   defined (eslENABLE_SSE)
   int j;
 
-  if ( landmark < fm->N - 1 || landmark == -1 ) {
+  if ( landmark < fm->N || landmark == -1 ) {
 
     const uint8_t * BWT = fm->BWT;
 
@@ -9,6 +9,22 @@
 
 #include "hmmer.h"
 
+/* FM_SEEDQUERY:  one query profile's share of a batched seed search.
+ *
+ * FM_getSeeds() walks the trie of target strings once for a whole
+ * batch of queries. Each query keeps its own surviving diagonals and
+ * its own seed list; the BWT intervals of the trie are shared.
+ */
+typedef struct {
+  const P7_SCOREDATA *ssvdata;       // compact data required for computing SSV scores
+  uint8_t            *consensus;     // consensus residues, 1..M, for runs of identity to the consensus
+  float               sc_threshFM;   // score that a short diagonal must pass to warrant extension
+  FM_DP_PAIR         *dp_pairs_fwd;  // surviving diagonals, for the pass on <fmf>; M * max_depth
+  FM_DP_PAIR         *dp_pairs_rev;  //   ... and for the pass on <fmb>
+  FM_DIAGLIST        *seeds;         // RETURN: threshold-passing seeds of this query
+} FM_SEEDQUERY;
+
+
 
 /* hit_sorter(): qsort's pawn, below */
 static int
@@ -206,32 +222,69 @@ FM_getPassingDiags(const FM_DATA *fmf, const FM_CFG *fm_cfg,
   return eslOK;
 }
 
+/* Function:  FM_extendInterval()
+ *
+ * Synopsis:  Find the FM-index interval(s) of a path on the string trie, extended by one character
+ *
+ * Details:   For the pass along <fmf> (<fm_direction> == fm_forward), the
+ *            path's interval is <interval_1>; for the pass along <fmb>,
+ *            <interval_1> and <interval_2> are its intervals in the
+ *            backward and forward sense. Return the intervals of the
+ *            path extended by <c> in <ret_1> (and <ret_2>). An empty
+ *            interval stays empty.
+ */
+static void
+FM_extendInterval(const FM_DATA *fmf, const FM_DATA *fmb, const FM_CFG *fm_cfg, int fm_direction, int c,
+                  const FM_INTERVAL *interval_1, const FM_INTERVAL *interval_2,
+                  FM_INTERVAL *ret_1, FM_INTERVAL *ret_2)
+{
+  ret_1->lower = interval_1->lower;
+  ret_1->upper = interval_1->upper;
+
+  if (fm_direction == fm_forward) {
+    if ( ret_1->lower >= 0 && ret_1->lower <= ret_1->upper  )  //no use extending a non-existent string
+      fm_updateIntervalReverse( fmf, fm_cfg, c, ret_1);
+  } else { // fm_direction == fm_reverse
+    ret_2->lower = interval_2->lower;
+    ret_2->upper = interval_2->upper;
+
+    if ( ret_1->lower >= 0 && ret_1->lower <= ret_1->upper  )  //no use extending a non-existent string
+      fm_updateIntervalForward( fmb, fm_cfg, c, ret_1, ret_2);
+  }
+}
+
 /* Function:  FM_Recurse()
  *
- * Synopsis:  Recursively traverse/prune a string trie, testing all strings vs the model
+ * Synopsis:  Recursively traverse/prune a string trie, testing all strings vs the models
  *
  * Details:   This is the heart of the FM SSV method. Given a path P on the
  *            trie, we keep track of a compact list of all not-yet-pruned
  *            diagonals in the DP table of the string S corresponding to
- *            P against the model. The preserved diagonals might be for
+ *            P against each model. The preserved diagonals might be for
  *            either a forward or backwards pass over the model and a pass
  *            over either the top or bottom (reverse complemented) strand
  *            of the target sequences.
  *
+ *            The trie is shared by a batch of queries: each extension
+ *            of P by a character is looked up in the FM-index once,
+ *            however many queries still have diagonals on P. Only the
+ *            <nactive> queries listed in <active> do; the rest have
+ *            been pruned from this subtree, and cost nothing here.
+ *
  * Args:      depth       - how long is the current path
  *            Kp          - alphabet size (including ambiguity)
  *            fmf         - FM index for finding matches to the input sequence
  *            fmb         - FM index for finding matches to the reverse of the input sequence
  *            fm_cfg      - FM-index meta data
- *            ssvdata     - compact data required for computing SSV scores
- *            sc_threshFM - Score that a short diagonal must pass to warrant extension to a full diagonal
- *            dp_pairs    - Compact representation of the surviving diagonals in the DP table
- *            first       - The index of the first entry in dp_pairs for the current column of the DP table
- *            last        - The index of the last entry in dp_pairs for the current column of the DP table
+ *            qry         - the batch of queries
+ *            active      - indices of queries with surviving diagonals on this path
+ *            nactive     - number of entries in <active>
+ *            first       - first[q]: index of the first entry in query q's dp_pairs for the current column of its DP table
+ *            last        - last[q]:  index of the last entry in query q's dp_pairs for the current column of its DP table
+ *            nq          - number of queries in the batch
+ *            ws          - workspace for the <active>, <first>, <last> of deeper paths; 3 * nq * (max_depth+1) ints
  *            interval_1  - FM-index interval - used for the standard backwards pass along the BWT (fmf)
  *            interval_2  - FM-index interval - used for the forward pass along the BWT (fmb)
- *            seeds       - RETURN: collection of threshold-passing windows
- *            seq         - preallocated char* used to capture and print the string for the current path - for debugging only
  *
  * Returns:   <eslOK> on success.
  */
@@ -239,30 +292,40 @@ static int
 FM_Recurse( int depth, int Kp, int fm_direction,
             const FM_DATA *fmf, const FM_DATA *fmb,
             const FM_CFG *fm_cfg,
-            const P7_SCOREDATA *ssvdata, uint8_t *consensus,
-            float sc_threshFM,
-            FM_DP_PAIR *dp_pairs, int first, int last,
-            FM_INTERVAL *interval_1, FM_INTERVAL *interval_2,
-            FM_DIAGLIST *seeds
-//            , char *seq
+            FM_SEEDQUERY *qry, const int *active, int nactive,
+            const int *first, const int *last, int nq, int *ws,
+            FM_INTERVAL *interval_1, FM_INTERVAL *interval_2
           )
 {
-
-
+  FM_SEEDQUERY       *q;
+  const P7_SCOREDATA *ssvdata;
+  FM_DP_PAIR         *dp_pairs;
   float sc, next_score;
 
-  int c, i, k;
+  int c, i, k, a, qi;
+  int dppos;
+  int have_new;
+  int nchild;
+  int *child_active = ws + 3 * nq * depth;  // the next path down keeps its lists here
+  int *child_first  = child_active + nq;
+  int *child_last   = child_first  + nq;
   FM_INTERVAL interval_1_new, interval_2_new;
   uint8_t positive_run = 0;
   uint8_t consec_consensus = 0;
   uint8_t cons_c = 0;
 
   for (c=0; c< fm_cfg->meta->alph_size; c++) {//acgt
-    int dppos = last;
-    //seq[depth-1] = fm_cfg->meta->alph[c];
-    //seq[depth] = '\0';
+    have_new = FALSE;
+    nchild   = 0;
 
-    for (i=first; i<=last; i++) { // for each surviving diagonal from the previous round
+    for (a=0; a<nactive; a++) {
+      qi       = active[a];
+      q        = qry + qi;
+      ssvdata  = q->ssvdata;
+      dp_pairs = (fm_direction == fm_forward ? q->dp_pairs_fwd : q->dp_pairs_rev);
+      dppos    = last[qi];
+
+      for (i=first[qi]; i<=last[qi]; i++) { // for each surviving diagonal from the previous round
 
         if (dp_pairs[i].model_direction == fm_forward)
           k = dp_pairs[i].pos + 1;
@@ -271,45 +334,36 @@ FM_Recurse( int depth, int Kp, int fm_direction,
 
         if (dp_pairs[i].complementarity == p7_COMPLEMENT) {
           next_score = ssvdata->ssv_scores_f[k*Kp + fm_cfg->meta->compl_alph[c]];
-          cons_c = fm_cfg->meta->compl_alph[consensus[k]];
+          cons_c = fm_cfg->meta->compl_alph[q->consensus[k]];
         } else {
           next_score = ssvdata->ssv_scores_f[k*Kp + c];
-          cons_c = consensus[k];
+          cons_c = q->consensus[k];
         }
 
         sc = dp_pairs[i].score + next_score;
         positive_run =  (next_score > 0 ? dp_pairs[i].consec_pos + 1 : 0);
         consec_consensus = (c == cons_c ? dp_pairs[i].consec_consensus+1 : 0);
 
-        if ( sc >= sc_threshFM
+        if ( sc >= q->sc_threshFM
             || (fm_cfg->consensus_match_req > 0 && consec_consensus == fm_cfg->consensus_match_req)
             ) { // this is a seed I want to extend
 
-          interval_1_new.lower = interval_1->lower;
-          interval_1_new.upper = interval_1->upper;
+          if (! have_new) {
+            FM_extendInterval(fmf, fmb, fm_cfg, fm_direction, c, interval_1, interval_2, &interval_1_new, &interval_2_new);
+            have_new = TRUE;
+          }
 
           if (fm_direction == fm_forward) {
-            if ( interval_1_new.lower >= 0 && interval_1_new.lower <= interval_1_new.upper  )  //no use extending a non-existent string
-            fm_updateIntervalReverse( fmf, fm_cfg, c, &interval_1_new);
-
             if ( interval_1_new.lower >= 0 && interval_1_new.lower <= interval_1_new.upper  ) {  //no use passing a non-existent string
               FM_getPassingDiags(fmf, fm_cfg, k, ssvdata->M, sc, depth, fm_forward,
                                  dp_pairs[i].model_direction, dp_pairs[i].complementarity,
-                                 &interval_1_new, seeds);
+                                 &interval_1_new, q->seeds);
             }
           } else { // fm_direction == fm_reverse
-            //searching for forward matches on the FM-index
-            interval_2_new.lower = interval_2->lower;
-            interval_2_new.upper = interval_2->upper;
-
-            //searching for reverse matches on the FM-index
-            if ( interval_1_new.lower >= 0 && interval_1_new.lower <= interval_1_new.upper  )  //no use extending a non-existent string
-              fm_updateIntervalForward( fmb, fm_cfg, c, &interval_1_new, &interval_2_new);
-
             if ( interval_2_new.lower >= 0 && interval_2_new.lower <= interval_2_new.upper  ) { //no use passing a non-existent string
               FM_getPassingDiags(fmf, fm_cfg, k, ssvdata->M, sc, depth, fm_backward,
                                  dp_pairs[i].model_direction, dp_pairs[i].complementarity,
-                                 &interval_2_new, seeds);
+                                 &interval_2_new, q->seeds);
             }
           }
 
@@ -323,10 +377,10 @@ FM_Recurse( int depth, int Kp, int fm_direction,
                 (fm_cfg->consec_pos_req - positive_run) ==  (fm_cfg->max_depth - depth + 1)                 // if we're close to the end of the sequence, abort -- if that end does have sufficiently long all-positive run, I'll find it on the reverse sweep
                )
             || (dp_pairs[i].model_direction == fm_forward  &&
-                   ( (depth > (fm_cfg->max_depth - 10)) &&  sc + ssvdata->opt_ext_fwd[k][fm_cfg->max_depth-depth-1] < sc_threshFM)   //can't hit threshold, even with best possible forward extension up to length ssv_req
+                   ( (depth > (fm_cfg->max_depth - 10)) &&  sc + ssvdata->opt_ext_fwd[k][fm_cfg->max_depth-depth-1] < q->sc_threshFM)   //can't hit threshold, even with best possible forward extension up to length ssv_req
                   )
             || (dp_pairs[i].model_direction == fm_backward &&
-                   ( (depth > (fm_cfg->max_depth - 10)) &&  sc + ssvdata->opt_ext_rev[k-1][fm_cfg->max_depth-depth-1] < sc_threshFM )  //can't hit threshold, even with best possible extension up to length ssv_req
+                   ( (depth > (fm_cfg->max_depth - 10)) &&  sc + ssvdata->opt_ext_rev[k-1][fm_cfg->max_depth-depth-1] < q->sc_threshFM )  //can't hit threshold, even with best possible extension up to length ssv_req
                   )
 
          )
@@ -358,52 +412,28 @@ FM_Recurse( int depth, int Kp, int fm_direction,
             dp_pairs[dppos].max_consec_pos = ESL_MAX( positive_run, dp_pairs[i].max_consec_pos);
             dp_pairs[dppos].consec_consensus = consec_consensus;
         }
-    }
-
-    if ( dppos > last ){  // at least one diagonal that might reach threshold score, but hasn't yet, so extend
-
-      interval_1_new.lower = interval_1->lower;
-      interval_1_new.upper = interval_1->upper;
-
-      if (fm_direction == fm_forward) {
-
-        if ( interval_1_new.lower >= 0 && interval_1_new.lower <= interval_1_new.upper  )  //no use extending a non-existent string
-          fm_updateIntervalReverse( fmf, fm_cfg, c, &interval_1_new);
-
-        if (  interval_1_new.lower < 0 || interval_1_new.lower > interval_1_new.upper ) { //that string doesn't exist in fwd index
-          continue;
-        }
-        FM_Recurse(depth+1, Kp, fm_direction,
-                  fmf, fmb, fm_cfg, ssvdata, consensus,
-                  sc_threshFM, dp_pairs, last+1, dppos,
-                  &interval_1_new, NULL,
-                  seeds
-                  //, seq
-                  );
-
-
-      } else { // fm_direction == fm_reverse
+      }
 
-        interval_2_new.lower = interval_2->lower;
-        interval_2_new.upper = interval_2->upper;
+      if ( dppos > last[qi] ) { // at least one diagonal that might reach threshold score, but hasn't yet; this query goes down the path
+        child_active[nchild++] = qi;
+        child_first[qi]        = last[qi]+1;
+        child_last[qi]         = dppos;
+      }
+    }
 
-        if ( interval_1_new.lower >= 0 && interval_1_new.lower <= interval_1_new.upper  )  //no use extending a non-existent string
-          fm_updateIntervalForward( fmb, fm_cfg, c, &interval_1_new, &interval_2_new);
+    if ( nchild > 0 ){  // some query has a diagonal to extend
 
+      if (! have_new)
+        FM_extendInterval(fmf, fmb, fm_cfg, fm_direction, c, interval_1, interval_2, &interval_1_new, &interval_2_new);
 
-        if (  interval_1_new.lower < 0 || interval_1_new.lower > interval_1_new.upper ) { //that string doesn't exist in reverse index
-          continue;
-        }
-        FM_Recurse(depth+1, Kp, fm_direction,
-                  fmf, fmb, fm_cfg, ssvdata, consensus,
-                  sc_threshFM, dp_pairs, last+1, dppos,
-                  &interval_1_new, &interval_2_new,
-                  seeds
-                  //, seq
-                  );
-
+      if (  interval_1_new.lower < 0 || interval_1_new.lower > interval_1_new.upper ) { //that string doesn't exist in the index
+        continue;
       }
-
+      FM_Recurse(depth+1, Kp, fm_direction,
+                 fmf, fmb, fm_cfg,
+                 qry, child_active, nchild, child_first, child_last, nq, ws,
+                 &interval_1_new, (fm_direction == fm_forward ? NULL : &interval_2_new)
+                );
     }
 
   }
@@ -415,11 +445,12 @@ FM_Recurse( int depth, int Kp, int fm_direction,
  *
  * Synopsis:  Find short diagonal seeds with score above a modest threshold.
  *
- * Details:   Given FM configuration <fm_cfg>, model scoring data <ssvdata>,
- *            both forward and backward FM indexes (<fmf>, <fmb>), and
- *            a score threshold <sc_threshFM>, find all seeds in the FMs
- *            that meet the threshold, and place them in the container
- *            <seeds>.
+ * Details:   Given FM configuration <fm_cfg>, both forward and backward
+ *            FM indexes (<fmf>, <fmb>), and a batch of <nq> queries
+ *            <qry>, each with its model scoring data and score
+ *            threshold, find all seeds in the FMs that meet each
+ *            query's threshold, and place them in that query's
+ *            <seeds> container.
  *
  *            This involves building diagonals in both forward and reverse
  *            orientation relative to the model, because the pruning method
@@ -427,157 +458,182 @@ FM_Recurse( int depth, int Kp, int fm_direction,
  *            is only found on one end of the hit. This function merely
  *            kickstarts the task of traversing over a trie of all strings
  *            up to some fixed length looking for threshold-passing
- *            diagonals - FM_Recurse() does the hard work.
+ *            diagonals - FM_Recurse() does the hard work, for all
+ *            queries in one traversal.
  *
  * Args:      fmf         - FM index for finding matches to the input sequence
  *            fmb         - FM index for finding matches to the reverse of the input sequence
  *            fm_cfg      - FM-index meta data
- *            ssvdata     - compact data required for computing SSV scores
+ *            qry         - the queries; <ssvdata>, <consensus>, <sc_threshFM> and <seeds> must be set
+ *            nq          - number of queries
  *            Kp          - Alphabet size (including ambiguity chars)
- *            sc_threshFM - Score that a short diagonal must pass to warrant extension to a full diagonal
  *            strands     - p7_STRAND_TOPONLY  | p7_STRAND_BOTTOMONLY |  p7_STRAND_BOTH
- *            seeds       - RETURN: collection of threshold-passing windows
  *
  * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
  */
 static int FM_getSeeds ( const FM_DATA *fmf, const FM_DATA *fmb,
-                         const FM_CFG *fm_cfg, const P7_SCOREDATA *ssvdata,
-                         uint8_t  *consensus, int Kp, float sc_threshFM,
-                         int strands, FM_DIAGLIST *seeds
+                         const FM_CFG *fm_cfg, FM_SEEDQUERY *qry, int nq,
+                         int Kp, int strands
                  )
 {
   FM_INTERVAL interval_f1, interval_f2, interval_bk;
-  int i, k;
-  int status;
+  const P7_SCOREDATA *ssvdata;
+  uint8_t            *consensus;
+  FM_DP_PAIR         *dp_pairs_fwd;
+  FM_DP_PAIR         *dp_pairs_rev;
+  int  *ws = NULL;
+  int  *active, *first, *last;
+  int  *fwd_cnt = NULL;
+  int  *rev_cnt = NULL;
+  int  nactive;
+  int  i, k, q;
+  int  status;
   float sc;
-  //char         *seq;
-
-  FM_DP_PAIR *dp_pairs_fwd;
-  FM_DP_PAIR *dp_pairs_rev;
 
-  ESL_ALLOC(dp_pairs_fwd, ssvdata->M * fm_cfg->max_depth * sizeof(FM_DP_PAIR)); // guaranteed to be enough to hold all diagonals
-  ESL_ALLOC(dp_pairs_rev, ssvdata->M * fm_cfg->max_depth * sizeof(FM_DP_PAIR));
+  for (q=0; q<nq; q++) qry[q].dp_pairs_fwd = qry[q].dp_pairs_rev = NULL;
+  for (q=0; q<nq; q++) {
+    ESL_ALLOC(qry[q].dp_pairs_fwd, qry[q].ssvdata->M * fm_cfg->max_depth * sizeof(FM_DP_PAIR)); // guaranteed to be enough to hold all diagonals
+    ESL_ALLOC(qry[q].dp_pairs_rev, qry[q].ssvdata->M * fm_cfg->max_depth * sizeof(FM_DP_PAIR));
+  }
+  ESL_ALLOC(ws,      3 * nq * (fm_cfg->max_depth+1) * sizeof(int));
+  ESL_ALLOC(fwd_cnt, nq * sizeof(int));
+  ESL_ALLOC(rev_cnt, nq * sizeof(int));
 
-  //ESL_ALLOC(seq, 50*sizeof(char));
+  /* lists for the paths of length 1 */
+  active = ws + 3 * nq;
+  first  = active + nq;
+  last   = first  + nq;
 
   for (i=0; i<fm_cfg->meta->alph_size; i++) {
-    int fwd_cnt=0;
-    int rev_cnt=0;
     interval_f1.lower = interval_f2.lower = interval_bk.lower = fmf->C[i];
     interval_f1.upper = interval_f2.upper = interval_bk.upper = abs((int)(fmf->C[i+1]))-1;
 
     if (interval_f1.lower<0 ) //none of that character found
       continue;
 
-    // This is here for debugging purposes only. Feel free to comment out.
-    //seq[0] = fm_cfg->meta->alph[i];
-    //seq[1] = '\0';
-
     // Fill in a DP column for the character c, (compressed so that only positive-scoring entries are kept)
     // There will be 4 DP columns for each character, (1) fwd-std, (2) fwd-complement, (3) rev-std, (4) rev-complement
-    for (k = 1; k <= ssvdata->M; k++) // there's no need to bother keeping an entry starting at the last position (gm->M)
+    for (q=0; q<nq; q++)
     {
+      ssvdata      = qry[q].ssvdata;
+      consensus    = qry[q].consensus;
+      dp_pairs_fwd = qry[q].dp_pairs_fwd;
+      dp_pairs_rev = qry[q].dp_pairs_rev;
+      fwd_cnt[q]   = 0;
+      rev_cnt[q]   = 0;
+
+      for (k = 1; k <= ssvdata->M; k++) // there's no need to bother keeping an entry starting at the last position (gm->M)
+      {
+
+        if (strands != p7_STRAND_BOTTOMONLY) {
+          sc = ssvdata->ssv_scores_f[k*Kp + i];
+          if (sc>0) { // we'll extend any positive-scoring diagonal
+            /* fwd on model, fwd on FM (really, reverse on FM, but the FM is on a reversed string, so its fwd*/
+            if (k < ssvdata->M-3) { // don't bother starting a forward diagonal so close to the end of the model
+              //Forward pass on the FM-index
+              dp_pairs_fwd[fwd_cnt[q]].pos =             k;
+              dp_pairs_fwd[fwd_cnt[q]].score =           sc;
+              dp_pairs_fwd[fwd_cnt[q]].max_score =       sc;
+              dp_pairs_fwd[fwd_cnt[q]].score_peak_len =  1;
+              dp_pairs_fwd[fwd_cnt[q]].consec_pos =      1;
+              dp_pairs_fwd[fwd_cnt[q]].max_consec_pos =  1;
+              dp_pairs_fwd[fwd_cnt[q]].consec_consensus = (i==consensus[k] ? 1 : 0);
+              dp_pairs_fwd[fwd_cnt[q]].complementarity = p7_NOCOMPLEMENT;
+              dp_pairs_fwd[fwd_cnt[q]].model_direction = fm_forward;
+              fwd_cnt[q]++;
+            }
 
-      if (strands != p7_STRAND_BOTTOMONLY) {
-        sc = ssvdata->ssv_scores_f[k*Kp + i];
-        if (sc>0) { // we'll extend any positive-scoring diagonal
-          /* fwd on model, fwd on FM (really, reverse on FM, but the FM is on a reversed string, so its fwd*/
-          if (k < ssvdata->M-3) { // don't bother starting a forward diagonal so close to the end of the model
-            //Forward pass on the FM-index
-            dp_pairs_fwd[fwd_cnt].pos =             k;
-            dp_pairs_fwd[fwd_cnt].score =           sc;
-            dp_pairs_fwd[fwd_cnt].max_score =       sc;
-            dp_pairs_fwd[fwd_cnt].score_peak_len =  1;
-            dp_pairs_fwd[fwd_cnt].consec_pos =      1;
-            dp_pairs_fwd[fwd_cnt].max_consec_pos =  1;
-            dp_pairs_fwd[fwd_cnt].consec_consensus = (i==consensus[k] ? 1 : 0);
-            dp_pairs_fwd[fwd_cnt].complementarity = p7_NOCOMPLEMENT;
-            dp_pairs_fwd[fwd_cnt].model_direction = fm_forward;
-            fwd_cnt++;
-          }
-
-          /* rev on model, rev on FM (the FM is on the unreversed string)*/
-          if (k > 4) { // don't bother starting a reverse diagonal so close to the start of the model
-            dp_pairs_rev[rev_cnt].pos =             k;
-            dp_pairs_rev[rev_cnt].score =           sc;
-            dp_pairs_rev[rev_cnt].max_score =       sc;
-            dp_pairs_rev[rev_cnt].score_peak_len =  1;
-            dp_pairs_rev[rev_cnt].consec_pos =      1;
-            dp_pairs_rev[rev_cnt].max_consec_pos =  1;
-            dp_pairs_rev[rev_cnt].consec_consensus = (i==consensus[k] ? 1: 0);
-            dp_pairs_rev[rev_cnt].complementarity = p7_NOCOMPLEMENT;
-            dp_pairs_rev[rev_cnt].model_direction = fm_backward;
-            rev_cnt++;
+            /* rev on model, rev on FM (the FM is on the unreversed string)*/
+            if (k > 4) { // don't bother starting a reverse diagonal so close to the start of the model
+              dp_pairs_rev[rev_cnt[q]].pos =             k;
+              dp_pairs_rev[rev_cnt[q]].score =           sc;
+              dp_pairs_rev[rev_cnt[q]].max_score =       sc;
+              dp_pairs_rev[rev_cnt[q]].score_peak_len =  1;
+              dp_pairs_rev[rev_cnt[q]].consec_pos =      1;
+              dp_pairs_rev[rev_cnt[q]].max_consec_pos =  1;
+              dp_pairs_rev[rev_cnt[q]].consec_consensus = (i==consensus[k] ? 1: 0);
+              dp_pairs_rev[rev_cnt[q]].complementarity = p7_NOCOMPLEMENT;
+              dp_pairs_rev[rev_cnt[q]].model_direction = fm_backward;
+              rev_cnt[q]++;
+            }
           }
         }
-      }
 
 
-      // Now do the reverse complement
-      if (strands != p7_STRAND_TOPONLY) {
-        sc = ssvdata->ssv_scores_f[k*Kp + fm_cfg->meta->compl_alph[i]];
-        if (sc>0) { // we'll extend any positive-scoring diagonal
-          /* rev on model, fwd on FM (really, reverse on FM, but the FM is on a reversed string, so its fwd*/
-          if (k > 4) { // don't bother starting a reverse diagonal so close to the start of the model
-            dp_pairs_fwd[fwd_cnt].pos =             k;
-            dp_pairs_fwd[fwd_cnt].score =           sc;
-            dp_pairs_fwd[fwd_cnt].max_score =       sc;
-            dp_pairs_fwd[fwd_cnt].score_peak_len =  1;
-            dp_pairs_fwd[fwd_cnt].consec_pos =      1;
-            dp_pairs_fwd[fwd_cnt].max_consec_pos =  1;
-            dp_pairs_fwd[fwd_cnt].consec_consensus = (i==consensus[k] ? 1: 0);
-            dp_pairs_fwd[fwd_cnt].complementarity = p7_COMPLEMENT;
-            dp_pairs_fwd[fwd_cnt].model_direction = fm_backward;
-            fwd_cnt++;
-          }
+        // Now do the reverse complement
+        if (strands != p7_STRAND_TOPONLY) {
+          sc = ssvdata->ssv_scores_f[k*Kp + fm_cfg->meta->compl_alph[i]];
+          if (sc>0) { // we'll extend any positive-scoring diagonal
+            /* rev on model, fwd on FM (really, reverse on FM, but the FM is on a reversed string, so its fwd*/
+            if (k > 4) { // don't bother starting a reverse diagonal so close to the start of the model
+              dp_pairs_fwd[fwd_cnt[q]].pos =             k;
+              dp_pairs_fwd[fwd_cnt[q]].score =           sc;
+              dp_pairs_fwd[fwd_cnt[q]].max_score =       sc;
+              dp_pairs_fwd[fwd_cnt[q]].score_peak_len =  1;
+              dp_pairs_fwd[fwd_cnt[q]].consec_pos =      1;
+              dp_pairs_fwd[fwd_cnt[q]].max_consec_pos =  1;
+              dp_pairs_fwd[fwd_cnt[q]].consec_consensus = (i==consensus[k] ? 1: 0);
+              dp_pairs_fwd[fwd_cnt[q]].complementarity = p7_COMPLEMENT;
+              dp_pairs_fwd[fwd_cnt[q]].model_direction = fm_backward;
+              fwd_cnt[q]++;
+            }
 
-          /* fwd on model, rev on FM (the FM is on the unreversed string - complemented)*/
-          if (k < ssvdata->M-3) { // don't bother starting a forward diagonal so close to the end of the model
-            dp_pairs_rev[rev_cnt].pos =             k;
-            dp_pairs_rev[rev_cnt].score =           sc;
-            dp_pairs_rev[rev_cnt].max_score =       sc;
-            dp_pairs_rev[rev_cnt].score_peak_len =  1;
-            dp_pairs_rev[rev_cnt].consec_pos =      1;
-            dp_pairs_rev[rev_cnt].max_consec_pos =  1;
-            dp_pairs_rev[rev_cnt].consec_consensus = (i==consensus[k] ? 1: 0);
-            dp_pairs_rev[rev_cnt].complementarity = p7_COMPLEMENT;
-            dp_pairs_rev[rev_cnt].model_direction = fm_forward;
-            rev_cnt++;
-          }
+            /* fwd on model, rev on FM (the FM is on the unreversed string - complemented)*/
+            if (k < ssvdata->M-3) { // don't bother starting a forward diagonal so close to the end of the model
+              dp_pairs_rev[rev_cnt[q]].pos =             k;
+              dp_pairs_rev[rev_cnt[q]].score =           sc;
+              dp_pairs_rev[rev_cnt[q]].max_score =       sc;
+              dp_pairs_rev[rev_cnt[q]].score_peak_len =  1;
+              dp_pairs_rev[rev_cnt[q]].consec_pos =      1;
+              dp_pairs_rev[rev_cnt[q]].max_consec_pos =  1;
+              dp_pairs_rev[rev_cnt[q]].consec_consensus = (i==consensus[k] ? 1: 0);
+              dp_pairs_rev[rev_cnt[q]].complementarity = p7_COMPLEMENT;
+              dp_pairs_rev[rev_cnt[q]].model_direction = fm_forward;
+              rev_cnt[q]++;
+            }
 
+          }
         }
       }
     }
 
-
-    FM_Recurse ( 2, Kp, fm_forward,
-                 fmf, fmb, fm_cfg, ssvdata, consensus,
-                 sc_threshFM, dp_pairs_fwd, 0, fwd_cnt-1,
-                 &interval_f1, NULL,
-                 seeds
-                 //, seq
-            );
-
-    FM_Recurse ( 2, Kp, fm_backward,
-                 fmf, fmb, fm_cfg, ssvdata, consensus,
-                 sc_threshFM, dp_pairs_rev, 0, rev_cnt-1,
-                 &interval_bk, &interval_f2,
-                 seeds
-                 //, seq
-            );
+    for (nactive=0, q=0; q<nq; q++)
+      if (fwd_cnt[q] > 0) { active[nactive++] = q; first[q] = 0; last[q] = fwd_cnt[q]-1; }
+    if (nactive > 0)
+      FM_Recurse ( 2, Kp, fm_forward,
+                   fmf, fmb, fm_cfg,
+                   qry, active, nactive, first, last, nq, ws,
+                   &interval_f1, NULL
+              );
+
+    for (nactive=0, q=0; q<nq; q++)
+      if (rev_cnt[q] > 0) { active[nactive++] = q; first[q] = 0; last[q] = rev_cnt[q]-1; }
+    if (nactive > 0)
+      FM_Recurse ( 2, Kp, fm_backward,
+                   fmf, fmb, fm_cfg,
+                   qry, active, nactive, first, last, nq, ws,
+                   &interval_bk, &interval_f2
+              );
   }
 
 
   //merge duplicates
-  FM_mergeSeeds(seeds, fmf->N, fm_cfg->ssv_length);
-
-  free (dp_pairs_fwd);
-  free (dp_pairs_rev);
-  //if (seq) free(seq);
-  return eslOK;
+  for (q=0; q<nq; q++)
+    FM_mergeSeeds(qry[q].seeds, fmf->N, fm_cfg->ssv_length);
 
+  status = eslOK;
+  /* fall through */
 ERROR:
-  return eslEMEM;
+  for (q=0; q<nq; q++) {
+    if (qry[q].dp_pairs_fwd) free (qry[q].dp_pairs_fwd);
+    if (qry[q].dp_pairs_rev) free (qry[q].dp_pairs_rev);
+  }
+  if (ws)      free(ws);
+  if (fwd_cnt) free(fwd_cnt);
+  if (rev_cnt) free(rev_cnt);
+  return status;
 }
 
 
@@ -708,6 +764,10 @@ FM_extendSeed(FM_DIAG *diag, const FM_DATA *fm, const P7_SCOREDATA *ssvdata, FM_
  *            scoring threshold (usually score s.t. p=0.02) are captured, and passed
  *            on to the Viterbi and Forward stages of the pipeline.
  *
+ *            This is <p7_SSVFM_longlarget_batch()> for a single query,
+ *            whose seed score threshold is scaled by
+ *            <fm_cfg->sc_thresh_ratio>.
+ *
  * Args:      om      - optimized profile
  *            nu      - configuration: expected number of hits (use 2.0 as a default)
  *            bg      - the background model, required for translating a P-value threshold into a score threshold
@@ -728,103 +788,371 @@ p7_SSVFM_longlarget( P7_OPROFILE *om, float nu, P7_BG *bg, double F1,
          const FM_DATA *fmf, const FM_DATA *fmb, FM_CFG *fm_cfg, const P7_SCOREDATA *ssvdata,
          int strands, ESL_RANDOMNESS *r, P7_HMM_WINDOWLIST *windowlist)
 {
-  float sc_thresh, sc_threshFM;
-  float invP;
-  //, invP_FM;
-  float nullsc;
-
-  int i;
-
-  float      tloop = logf((float) om->max_length / (float) (om->max_length+3));
-  float      tloop_total = tloop * om->max_length;
-  float      tmove = logf(     3.0f / (float) (om->max_length+3));
-  float      tbmk  = logf(     2.0f / ((float) om->M * (float) (om->M+1)));
-  float      tec   = logf(1.0f / nu);
-  FM_DIAG   *diag;
-
-  ESL_SQ   *tmp_sq;
-  uint8_t  *consensus;
+  return p7_SSVFM_longlarget_batch(&om, &ssvdata, &(fm_cfg->sc_thresh_ratio), 1, nu, bg, F1,
+                                   fmf, fmb, fm_cfg, strands, r, windowlist);
+}
 
 
-  FM_DIAGLIST seeds;
-  int         status;
-  status = fm_initSeeds(&seeds);
-  if (status != eslOK)
-    ESL_EXCEPTION(eslEMEM, "Error allocating memory for seed list\n");
-
-  /* convert the consensus to a collection of ints, so I can test for runs of identity to the consensus */
-  ESL_ALLOC(consensus, (om->M+1)*sizeof(uint8_t) );
-  for (i=1; i<=om->M; i++) {
-    consensus[i] = om->abc->inmap[(int)(om->consensus[i])];
-    if (consensus[i] > om->abc->K)
-          consensus[i] = esl_rnd_Roll(r,om->abc->K);
-  }
+/* Function:  p7_SSVFM_longlarget_batch()
+ * Synopsis:  Finds SSV-passing windows for a batch of queries, in one FM-index traversal
+ *
+ * Details:   Does what <p7_SSVFM_longlarget()> does, for each of the
+ *            <nq> profiles <om[0..nq-1]>, with their scoring data
+ *            <ssvdata[0..nq-1]>. Query <q>'s seed score threshold
+ *            is scaled by <sc_thresh_ratio[q]>, and its windows are
+ *            added to <windowlist[q]>.
+ *
+ *            The seed search, which dominates the cost of FM-index
+ *            SSV, walks the trie of target strings once for the
+ *            whole batch: the occurrence counts for a short string
+ *            are computed once however many queries have diagonals
+ *            on it, and a subtree is only entered by the queries
+ *            whose diagonals survive there. Screening many families
+ *            (e.g. Dfam) against a genome then costs much less than
+ *            one search per family. Seed extension, which is cheap,
+ *            is still done one query at a time.
+ *
+ *            Each profile's MSV length model is reconfigured, and
+ *            <bg>'s length is set, as in <p7_SSVFM_longlarget()>.
+ *
+ *            nhmmer --qbatch calls this through
+ *            <p7_Pipeline_LongTargetBatch()>, once per FM-index block
+ *            for each batch of queries.
+ *
+ * Args:      om              - optimized profiles [0..nq-1]
+ *            ssvdata         - compact data required for computing SSV scores, one per profile
+ *            sc_thresh_ratio - per-profile seed threshold ratios (see <FM_CFG>)
+ *            nq              - number of profiles in the batch
+ *            nu              - configuration: expected number of hits (use 2.0 as a default)
+ *            bg              - the background model, required for translating a P-value threshold into a score threshold
+ *            F1              - p-value below which a window is captured as being above threshold
+ *            fmf             - data for forward traversal of the FM-index
+ *            fmb             - data for backward traversal of the FM-index
+ *            fm_cfg          - FM-index meta data
+ *            strands         - p7_STRAND_TOPONLY  | p7_STRAND_BOTTOMONLY |  p7_STRAND_BOTH
+ *            r               - random number generator, for unresolved consensus residues
+ *            windowlist      - RETURN: windowlist[q] collects profile q's SSV-passing windows
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> if trouble allocating memory for seeds
+ */
+int
+p7_SSVFM_longlarget_batch( P7_OPROFILE **om, const P7_SCOREDATA **ssvdata, const float *sc_thresh_ratio, int nq,
+         float nu, P7_BG *bg, double F1,
+         const FM_DATA *fmf, const FM_DATA *fmb, FM_CFG *fm_cfg,
+         int strands, ESL_RANDOMNESS *r, P7_HMM_WINDOWLIST *windowlist)
+{
+  float        *sc_thresh = NULL;
+  float         invP;
+  float         nullsc;
+  float         tloop, tloop_total, tmove, tbmk, tec;
+  FM_SEEDQUERY *qry       = NULL;
+  FM_DIAGLIST  *seeds     = NULL;
+  FM_DIAG      *diag;
+  ESL_SQ       *tmp_sq    = NULL;
+  int           i, q;
+  int           status;
+
+  ESL_ALLOC(qry,       nq * sizeof(FM_SEEDQUERY));
+  for (q=0; q<nq; q++) qry[q].consensus = NULL;
+  ESL_ALLOC(seeds,     nq * sizeof(FM_DIAGLIST));
+  for (q=0; q<nq; q++) seeds[q].diags = NULL;
+  ESL_ALLOC(sc_thresh, nq * sizeof(float));
+
+  for (q=0; q<nq; q++)
+    {
+      tloop       = logf((float) om[q]->max_length / (float) (om[q]->max_length+3));
+      tloop_total = tloop * om[q]->max_length;
+      tmove       = logf(     3.0f / (float) (om[q]->max_length+3));
+      tbmk        = logf(     2.0f / ((float) om[q]->M * (float) (om[q]->M+1)));
+      tec         = logf(1.0f / nu);
+
+      if (fm_initSeeds(&(seeds[q])) != eslOK)
+        ESL_XEXCEPTION(eslEMEM, "Error allocating memory for seed list\n");
+
+      /* convert the consensus to a collection of ints, so I can test for runs of identity to the consensus */
+      ESL_ALLOC(qry[q].consensus, (om[q]->M+1)*sizeof(uint8_t) );
+      for (i=1; i<=om[q]->M; i++) {
+        qry[q].consensus[i] = om[q]->abc->inmap[(int)(om[q]->consensus[i])];
+        if (qry[q].consensus[i] > om[q]->abc->K)
+          qry[q].consensus[i] = esl_rnd_Roll(r,om[q]->abc->K);
+      }
 
+      /* Set false target length. This is a conservative estimate of the length of window that'll
+       * soon be passed on to later phases of the pipeline;  used to recover some bits of the score
+       * that we would miss if we left length parameters set to the full target length */
+      p7_oprofile_ReconfigMSVLength(om[q], om[q]->max_length);
+      p7_bg_SetLength(bg, om[q]->max_length);
+      p7_bg_NullOne  (bg, NULL, om[q]->max_length, &nullsc);
+
+      /*
+       * Computing the score required to let P meet the F1 prob threshold
+       * In original code, converting from an SSV score S (the score getting
+       * to state C) to a probability goes like this:
+       *  S = XMX(L,p7G_C)
+       *  usc = S + tmove + tloop_total
+       *  P = f ( (usc - nullsc) / eslCONST_LOG2 , mu, lambda)
+       *  and XMX(C) was the diagonal score + tmove + tbmk + tec
+       * and we're computing the threshold score S, so reverse it:
+       *  (usc - nullsc) /  eslCONST_LOG2 = inv_f( P, mu, lambda)
+       *  usc = nullsc + eslCONST_LOG2 * inv_f( P, mu, lambda)
+       *  S = usc - tmove - tloop_total - tmove - tbmk - tec
+       *
+       *
+       *  Here, I compute threshold with length model based on max_length.  Usually, the
+       *  length of a window returned by this scan will be 2*max_length-1 or longer.  Doesn't
+       *  really matter - in any case, both the bg and om models will change with roughly
+       *  1 bit for each doubling of the length model, so they offset.
+       */
+      invP = esl_gumbel_invsurv(F1, om[q]->evparam[p7_MMU],  om[q]->evparam[p7_MLAMBDA]);
+      sc_thresh[q] =   (invP * eslCONST_LOG2) + nullsc - (tmove + tloop_total + tmove + tbmk + tec);
+
+      qry[q].ssvdata     = ssvdata[q];
+      qry[q].sc_threshFM = fm_cfg->scthreshFM * sc_thresh_ratio[q];
+      qry[q].seeds       = &(seeds[q]);
+    }
 
-  /* Set false target length. This is a conservative estimate of the length of window that'll
-   * soon be passed on to later phases of the pipeline;  used to recover some bits of the score
-   * that we would miss if we left length parameters set to the full target length */
-  p7_oprofile_ReconfigMSVLength(om, om->max_length);
-  p7_bg_SetLength(bg, om->max_length);
-  p7_bg_NullOne  (bg, NULL, om->max_length, &nullsc);
-
-  tmp_sq   =  esl_sq_CreateDigital(om->abc);
-
-  /*
-   * Computing the score required to let P meet the F1 prob threshold
-   * In original code, converting from an SSV score S (the score getting
-   * to state C) to a probability goes like this:
-   *  S = XMX(L,p7G_C)
-   *  usc = S + tmove + tloop_total
-   *  P = f ( (usc - nullsc) / eslCONST_LOG2 , mu, lambda)
-   *  and XMX(C) was the diagonal score + tmove + tbmk + tec
-   * and we're computing the threshold score S, so reverse it:
-   *  (usc - nullsc) /  eslCONST_LOG2 = inv_f( P, mu, lambda)
-   *  usc = nullsc + eslCONST_LOG2 * inv_f( P, mu, lambda)
-   *  S = usc - tmove - tloop_total - tmove - tbmk - tec
-   *
-   *
-   *  Here, I compute threshold with length model based on max_length.  Usually, the
-   *  length of a window returned by this scan will be 2*max_length-1 or longer.  Doesn't
-   *  really matter - in any case, both the bg and om models will change with roughly
-   *  1 bit for each doubling of the length model, so they offset.
-   */
-
-  invP = esl_gumbel_invsurv(F1, om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
-  sc_thresh =   (invP * eslCONST_LOG2) + nullsc - (tmove + tloop_total + tmove + tbmk + tec);
-
-
-//  invP_FM = esl_gumbel_invsurv(0.5, om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
-//  sc_threshFM = ESL_MAX(fm_cfg->scthreshFM,  (invP_FM * eslCONST_LOG2) + nullsc - (tmove + tloop_total + tmove + tbmk + tec) ) ;
-  sc_threshFM = fm_cfg->scthreshFM * fm_cfg->sc_thresh_ratio;
-
-  //get diagonals that score above sc_threshFM
-  status = FM_getSeeds(fmf, fmb, fm_cfg, ssvdata, consensus, om->abc->Kp, sc_threshFM, strands, &seeds );
+  //get diagonals that score above each query's sc_threshFM, in one pass over the FM-index
+  status = FM_getSeeds(fmf, fmb, fm_cfg, qry, nq, om[0]->abc->Kp, strands);
   if (status != eslOK)
-    ESL_EXCEPTION(eslEMEM, "Error allocating memory for seed computation\n");
+    ESL_XEXCEPTION(eslEMEM, "Error allocating memory for seed computation\n");
 
-  //now extend those diagonals to find ones scoring above sc_thresh
-  for(i=0; i<seeds.count; i++) {
-    FM_extendSeed( seeds.diags+i, fmf, ssvdata, fm_cfg, tmp_sq);
-  }
+  tmp_sq   =  esl_sq_CreateDigital(om[0]->abc);
 
-  for(i=0; i<seeds.count; i++) {
-    diag = seeds.diags+i;
-    if (diag->score >= sc_thresh)
-      FM_window_from_diag(diag, fmf, fm_cfg->meta, windowlist );
+  for (q=0; q<nq; q++)
+    {
+      //now extend those diagonals to find ones scoring above sc_thresh
+      for(i=0; i<seeds[q].count; i++) {
+        FM_extendSeed( seeds[q].diags+i, fmf, ssvdata[q], fm_cfg, tmp_sq);
+      }
 
-  }
+      for(i=0; i<seeds[q].count; i++) {
+        diag = seeds[q].diags+i;
+        if (diag->score >= sc_thresh[q])
+          FM_window_from_diag(diag, fmf, fm_cfg->meta, windowlist+q );
+      }
+    }
 
   esl_sq_Destroy(tmp_sq);
-
-  free(seeds.diags);
-  free(consensus);
+  for (q=0; q<nq; q++) { free(seeds[q].diags); free(qry[q].consensus); }
+  free(seeds);
+  free(qry);
+  free(sc_thresh);
   return eslEOF;
 
 ERROR:
-  ESL_EXCEPTION(eslEMEM, "Error allocating memory for SSVFM longtarget\n");
-
+  if (seeds) for (q=0; q<nq; q++) if (seeds[q].diags)   free(seeds[q].diags);
+  if (qry)   for (q=0; q<nq; q++) if (qry[q].consensus) free(qry[q].consensus);
+  if (seeds)     free(seeds);
+  if (qry)       free(qry);
+  if (sc_thresh) free(sc_thresh);
+  return status;
 }
 /*------------------ end, FM_MSV() ------------------------*/
 
 
+
+
+
+/*****************************************************************
+ * Unit tests
+ *****************************************************************/
+#ifdef p7FM_SSV_TESTDRIVE
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+/* utest_batch()
+ *
+ * Search block <b> of the FM-index for the <nq> queries <om>, once
+ * with <p7_SSVFM_longlarget_batch()> and once with one
+ * <p7_SSVFM_longlarget()> call per query, each starting from an rng
+ * seeded with <seed>; the two must find the same windows. F1 is
+ * nhmmer's FM-index default, 0.03.
+ * Adds the number of windows found to <*nwin>.
+ */
+static void
+utest_batch(FM_CFG *cfg, int b, P7_OPROFILE **om, P7_SCOREDATA **ssvdata, float *sc_thresh_ratio, int nq,
+            P7_BG *bg, int strands, uint32_t seed, int be_verbose, int *nwin)
+{
+  char               msg[] = "fm_ssv batch unit test failed";
+  const FM_DATA     *fmf   = cfg->meta->fmf + b;
+  const FM_DATA     *fmb   = cfg->meta->fmb + b;
+  ESL_RANDOMNESS    *r1    = esl_randomness_Create(seed);
+  ESL_RANDOMNESS    *r2    = esl_randomness_Create(seed);
+  P7_HMM_WINDOWLIST *wl1   = malloc(sizeof(P7_HMM_WINDOWLIST) * nq);
+  P7_HMM_WINDOWLIST *wl2   = malloc(sizeof(P7_HMM_WINDOWLIST) * nq);
+  P7_HMM_WINDOW     *w1, *w2;
+  int                q, i;
+
+  if (r1 == NULL || r2 == NULL || wl1 == NULL || wl2 == NULL) esl_fatal(msg);
+  for (q = 0; q < nq; q++)
+    if (p7_hmmwindow_init(&wl1[q]) != eslOK || p7_hmmwindow_init(&wl2[q]) != eslOK) esl_fatal(msg);
+
+  if (p7_SSVFM_longlarget_batch(om, (const P7_SCOREDATA **) ssvdata, sc_thresh_ratio, nq, 2.0, bg, 0.03,
+                                fmf, fmb, cfg, strands, r1, wl1) != eslEOF) esl_fatal(msg);
+
+  for (q = 0; q < nq; q++)
+    {
+      cfg->sc_thresh_ratio = sc_thresh_ratio[q];
+      if (p7_SSVFM_longlarget(om[q], 2.0, bg, 0.03, fmf, fmb, cfg, ssvdata[q],
+                              strands, r2, &wl2[q]) != eslEOF) esl_fatal(msg);
+    }
+
+  for (q = 0; q < nq; q++)
+    {
+      if (be_verbose) printf("  block %d strands %d query %d: %d windows\n", b, strands, q, wl1[q].count);
+      if (wl1[q].count != wl2[q].count) esl_fatal("%s: query %d, %d windows batched vs %d alone", msg, q, wl1[q].count, wl2[q].count);
+      for (i = 0; i < wl1[q].count; i++)
+        {
+          w1 = wl1[q].windows + i;
+          w2 = wl2[q].windows + i;
+          if (w1->id != w2->id || w1->n != w2->n || w1->fm_n != w2->fm_n || w1->length != w2->length ||
+              w1->k  != w2->k  || w1->target_len != w2->target_len || w1->complementarity != w2->complementarity ||
+              w1->score != w2->score)
+            esl_fatal("%s: query %d, window %d differs", msg, q, i);
+        }
+      *nwin += wl1[q].count;
+    }
+
+  for (q = 0; q < nq; q++) { free(wl1[q].windows); free(wl2[q].windows); }
+  free(wl1);
+  free(wl2);
+  esl_randomness_Destroy(r1);
+  esl_randomness_Destroy(r2);
+}
+#endif /*p7FM_SSV_TESTDRIVE*/
+/*---------------------- end, unit tests ------------------------*/
+
+
+
+/*****************************************************************
+ * Test driver
+ *****************************************************************/
+#ifdef p7FM_SSV_TESTDRIVE
+#include <p7_config.h>
+
+#include <stdio.h>
+#include <math.h>
+#include <inttypes.h>
+
+#include "easel.h"
+#include "esl_getopts.h"
+
+#include "hmmer.h"
+
+static ESL_OPTIONS options[] = {
+   /* name  type         default  env   range togs  reqs  incomp  help                docgrp */
+  {"-h",                  eslARG_NONE,  FALSE, NULL, NULL, NULL, NULL, NULL, "show help and usage",                                 0},
+  {"-s",                  eslARG_INT,     "42", NULL, NULL, NULL, NULL, NULL, "set random number seed to <n>",                       0},
+  {"-v",                  eslARG_NONE,  FALSE, NULL, NULL, NULL, NULL, NULL, "show verbose commentary/output",                      0},
+  /* the FM seed options, with nhmmer's defaults */
+  {"--seed_max_depth",    eslARG_INT,     "15", NULL, NULL, NULL, NULL, NULL, "seed length at which bit threshold must be met",      0},
+  {"--seed_sc_thresh",    eslARG_REAL,    "14", NULL, NULL, NULL, NULL, NULL, "req. score for FM seed (bits)",                       0},
+  {"--seed_sc_density",   eslARG_REAL,  "0.75", NULL, NULL, NULL, NULL, NULL, "seed must maintain this bit density from one end",    0},
+  {"--seed_drop_max_len", eslARG_INT,      "4", NULL, NULL, NULL, NULL, NULL, "maximum run length with score under (max - drop_lim)", 0},
+  {"--seed_drop_lim",     eslARG_REAL,   "0.3", NULL, NULL, NULL, NULL, NULL, "in seed, max drop in a run of length drop_max_len",   0},
+  {"--seed_req_pos",      eslARG_INT,      "5", NULL, NULL, NULL, NULL, NULL, "minimum number consecutive positive scores in seed",  0},
+  {"--seed_consens_match",eslARG_INT,     "11", NULL, NULL, NULL, NULL, NULL, "<n> consecutive consensus matches override threshold", 0},
+  {"--seed_ssv_length",   eslARG_INT,    "100", NULL, NULL, NULL, NULL, NULL, "length of window around FM seed for SSV diagonal",    0},
+  { 0,0,0,0,0,0,0,0,0,0},
+};
+static char usage[]  = "[-options] <DNA hmmfile> <FM-index file>";
+static char banner[] = "test driver for batched FM-index SSV seed search";
+
+/* The seed threshold ratio nhmmer sets for each query */
+static float
+sc_thresh_ratio_for(P7_PROFILE *gm)
+{
+  float best_sc_avg = 0.;
+  float max_score;
+  int   i,x;
+
+  for (i = 1; i <= gm->M; i++)
+    {
+      max_score = 0.;
+      for (x = 0; x < gm->abc->K; x++)
+        if (gm->rsc[x][(i) * p7P_NR + p7P_MSC] > max_score) max_score = gm->rsc[x][(i) * p7P_NR + p7P_MSC];
+      best_sc_avg += max_score;
+    }
+  best_sc_avg /= sqrt((double) gm->M);
+  best_sc_avg  = ESL_MAX(5.0,best_sc_avg);
+  return ESL_MIN(best_sc_avg/7.0, 1.0);
+}
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go         = esl_getopts_CreateDefaultApp(options, 2, argc, argv, banner, usage);
+  char           *hmmfile    = esl_opt_GetArg(go, 1);
+  char           *fmfile     = esl_opt_GetArg(go, 2);
+  uint32_t        seed       = esl_opt_GetInteger(go, "-s");
+  int             be_verbose = esl_opt_GetBoolean(go, "-v");
+  ESL_ALPHABET   *abc        = esl_alphabet_Create(eslDNA);
+  P7_HMMFILE     *hfp        = NULL;
+  P7_HMM         *hmm        = NULL;
+  P7_BG          *bg         = p7_bg_Create(abc);
+  P7_PROFILE    **gm         = NULL;
+  P7_OPROFILE   **om         = NULL;
+  P7_SCOREDATA  **ssvdata    = NULL;
+  float          *ratio      = NULL;
+  FM_CFG         *cfg        = NULL;
+  int             nq         = 0;
+  int             nwin       = 0;
+  int             b, q, strands;
+
+  /* the FM-index, set up as nhmmer does */
+  if (fm_configAlloc(&cfg)                                != eslOK) esl_fatal("failed to allocate FM config");
+  if ((cfg->meta->fp = fopen(fmfile, "rb"))               == NULL)  esl_fatal("failed to open FM-index %s", fmfile);
+  if (fm_readFMmeta(cfg->meta)                            != eslOK) esl_fatal("failed to read FM-index metadata");
+  if (cfg->meta->alph_type != fm_DNA)                               esl_fatal("%s is not a DNA FM-index", fmfile);
+  if (fm_configInit(cfg, go)                              != eslOK) esl_fatal("failed to initialize FM config");
+  if (fm_alphabetCreate(cfg->meta, NULL)                  != eslOK) esl_fatal("failed to create FM alphabet");
+  if (fm_FM_load(cfg->meta)                               != eslOK) esl_fatal("failed to load FM-index blocks");
+
+  /* each query, configured as nhmmer configures it */
+  if (p7_hmmfile_Open(hmmfile, NULL, &hfp, NULL)          != eslOK) esl_fatal("failed to open %s", hmmfile);
+  while (p7_hmmfile_Read(hfp, &abc, &hmm) == eslOK)
+    {
+      gm      = realloc(gm,      sizeof(P7_PROFILE *)   * (nq+1));
+      om      = realloc(om,      sizeof(P7_OPROFILE *)  * (nq+1));
+      ssvdata = realloc(ssvdata, sizeof(P7_SCOREDATA *) * (nq+1));
+      ratio   = realloc(ratio,   sizeof(float)          * (nq+1));
+      if (gm == NULL || om == NULL || ssvdata == NULL || ratio == NULL) esl_fatal("allocation failed");
+
+      if (hmm->max_length == -1) p7_Builder_MaxLength(hmm, p7_DEFAULT_WINDOW_BETA);
+      gm[nq] = p7_profile_Create (hmm->M, abc);
+      om[nq] = p7_oprofile_Create(hmm->M, abc);
+      p7_ProfileConfig(hmm, bg, gm[nq], 100, p7_LOCAL);
+      p7_oprofile_Convert(gm[nq], om[nq]);
+      ratio[nq]   = sc_thresh_ratio_for(gm[nq]);
+      ssvdata[nq] = p7_hmm_ScoreDataCreate(om[nq], gm[nq]);
+      nq++;
+      p7_hmm_Destroy(hmm);
+    }
+  if (nq < 2) esl_fatal("need at least two query models in %s", hmmfile);
+
+  if (be_verbose) printf("fm_ssv unit test: %d queries, %d FM-index blocks, seed %" PRIu32 "\n", nq, (int) cfg->meta->block_count, seed);
+
+  for (b = 0; b < cfg->meta->block_count; b++)
+    for (strands = p7_STRAND_TOPONLY; strands <= p7_STRAND_BOTH; strands++)
+      utest_batch(cfg, b, om, ssvdata, ratio, nq, bg, strands, seed, be_verbose, &nwin);
+
+  if (nwin == 0) esl_fatal("fm_ssv unit test found no windows; nothing was compared");
+
+  for (q = 0; q < nq; q++)
+    {
+      p7_hmm_ScoreDataDestroy(ssvdata[q]);
+      p7_oprofile_Destroy(om[q]);
+      p7_profile_Destroy(gm[q]);
+    }
+  free(ssvdata); free(om); free(gm); free(ratio);
+  fclose(cfg->meta->fp);
+  fm_configDestroy(cfg);
+  p7_hmmfile_Close(hfp);
+  p7_bg_Destroy(bg);
+  esl_alphabet_Destroy(abc);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /* p7FM_SSV_TESTDRIVE */
@@ -15,9 +15,29 @@
 #include "esl_sqio.h"
 #include "esl_vectorops.h"
 
+#ifdef HMMER_THREADS
+#include "esl_threads.h"
+#endif
+
 #include "hmmer.h"
 
+/* Each worker thread computes the traces for an interleaved share of
+ * the sequences: worker i of n takes sequences i, i+n, i+2n...,
+ * gathered into its own arrays so that one call to
+ * p7_tracealign_computeTraces() (and one set of DP matrices) does
+ * them all.
+ */
+typedef struct {
+  P7_HMM      *hmm;
+  ESL_SQ     **sq;
+  P7_TRACE   **tr;
+  int          N;
+} WORKER_INFO;
+
 static int map_alignment(const char *msafile, const P7_HMM *hmm, ESL_SQ ***ret_sq, P7_TRACE ***ret_tr, int *ret_ntot);
+#ifdef HMMER_THREADS
+static void trace_thread(void *arg);
+#endif
 
 
 #define ALPHOPTS "--amino,--dna,--rna"                         /* Exclusive options for alphabet choice */
@@ -34,6 +54,10 @@ static ESL_OPTIONS options[] = {
   { "--rna",       eslARG_NONE,     FALSE,     NULL, NULL, ALPHOPTS,  NULL,  NULL, "assert <seqfile>, <hmmfile> both RNA: no autodetection",      2 },
   { "--informat",  eslARG_STRING,    NULL,     NULL, NULL,   NULL,    NULL,  NULL, "assert <seqfile> is in format <s>: no autodetection",            2 },
   { "--outformat", eslARG_STRING, "Stockholm", NULL, NULL,   NULL,    NULL,  NULL, "output alignment in format <s>",                                    2 },
+  { "--batch",     eslARG_INT,        "0",     NULL, "n>=0", NULL,    NULL, "--mapali", "align and output <n> seqs at a time (0: all at once)",   2 },
+#ifdef HMMER_THREADS 
+  { "--cpu",       eslARG_INT,    p7_NCPU, "HMMER_NCPU", "n>=0", NULL, NULL, NULL, "number of parallel CPU workers to use for multithreads",      2 },
+#endif
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 
@@ -87,7 +111,10 @@ main(int argc, char **argv)
   FILE         *ofp     = stdout; /* output stream                 */
   ESL_SQ      **sq      = NULL;	/* array of sequences              */
   void         *p       = NULL;	/* tmp ptr for reallocation        */
-  int           nseq    = 0;	/* # of sequences in <seqfile>     */
+  int           nalloc  = 0;    /* # of seqs, traces allocated     */
+  int           batchsize = 0;  /* max # of seqs per output ali    */
+  int           nbatch  = 0;    /* # of alignments output          */
+  int           nseq    = 0;	/* # of sequences in this batch    */
   int           mapseq  = 0;	/* # of sequences in mapped MSA    */
   int           totseq  = 0;	/* # of seqs in all sources        */
   ESL_ALPHABET *abc     = NULL;	/* alphabet (set from the HMM file)*/
@@ -98,6 +125,12 @@ main(int argc, char **argv)
   int           idx;		/* counter over seqs, traces       */
   int           status;		/* easel/hmmer return code         */
   char          errbuf[eslERRBUFSIZE];
+#ifdef HMMER_THREADS
+  int           ncpus   = 0;
+  ESL_THREADS  *threadObj = NULL;
+  WORKER_INFO  *info    = NULL;
+  int           i;
+#endif
 
   /* Parse the command line
    */
@@ -127,6 +160,15 @@ main(int argc, char **argv)
   outfmt = esl_msafile_EncodeFormat(esl_opt_GetString(go, "--outformat"));
   if (outfmt == eslMSAFILE_UNKNOWN)    cmdline_failure(argv[0], "%s is not a recognized output MSA file format\n", esl_opt_GetString(go, "--outformat"));
 
+  /* Batched output is a series of alignments, which is only well-formed
+   * in formats that allow several alignments per file (Stockholm, Pfam),
+   * or that don't pad insert columns (A2M, where the batches concatenate
+   * to a single alignment).
+   */
+  batchsize = esl_opt_GetInteger(go, "--batch");
+  if (batchsize > 0 && outfmt != eslMSAFILE_STOCKHOLM && outfmt != eslMSAFILE_PFAM && outfmt != eslMSAFILE_A2M)
+    cmdline_failure(argv[0], "--batch only works with Stockholm, Pfam or A2M output\n");
+
   /* Open output stream */
   if ( (outfile = esl_opt_GetString(go, "-o")) != NULL) 
   {
@@ -168,46 +210,100 @@ main(int argc, char **argv)
   }
   totseq = mapseq;
 
-  /* Read digital sequences into an array (possibly concat'ed onto mapped seqs)
-   */
   status = esl_sqfile_OpenDigital(abc, seqfile, infmt, NULL, &sqfp);
   if      (status == eslENOTFOUND) p7_Fail("Failed to open sequence file %s for reading\n",          seqfile);
   else if (status == eslEFORMAT)   p7_Fail("Sequence file %s is empty or misformatted\n",            seqfile);
   else if (status != eslOK)        p7_Fail("Unexpected error %d opening sequence file %s\n", status, seqfile);
 
-  ESL_RALLOC(sq, p, sizeof(ESL_SQ *) * (totseq + 1));
-  sq[totseq] = esl_sq_CreateDigital(abc);
-  nseq = 0;
-  while ((status = esl_sqio_Read(sqfp, sq[totseq+nseq])) == eslOK)
-  {
-    nseq++;
-    ESL_RALLOC(sq, p, sizeof(ESL_SQ *) * (totseq+nseq+1));
-    sq[totseq+nseq] = esl_sq_CreateDigital(abc);
-  }
-  if      (status == eslEFORMAT) esl_fatal("Parse failed (sequence file %s):\n%s\n", 
-					   sqfp->filename, esl_sqfile_GetErrorBuf(sqfp));
-  else if (status != eslEOF)     esl_fatal("Unexpected error %d reading sequence file %s", status, sqfp->filename);
-  esl_sqfile_Close(sqfp);
-  totseq += nseq;
-
-
-  /* Remaining initializations, including trace array allocation
+#ifdef HMMER_THREADS
+  ncpus = ESL_MIN(esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
+  if (ncpus > 0)
+    {
+      p7_FLogsumInit();   /* init the shared logsum table before the workers need it */
+      threadObj = esl_threads_Create(&trace_thread);
+      ESL_ALLOC(info, sizeof(WORKER_INFO) * ncpus);
+      for (i = 0; i < ncpus; i++) { info[i].hmm = hmm; info[i].sq = NULL; info[i].tr = NULL; info[i].N = 0; }
+    }
+#endif
+
+  /* Align the sequences a batch at a time (one batch of all of them,
+   * if --batch isn't set), writing each batch's alignment before
+   * reading the next, so memory use is bounded by the batch size.
+   * Sequence and trace structures are reused from batch to batch.
    */
-  ESL_RALLOC(tr, p, sizeof(P7_TRACE *) * totseq);
-  for (idx = mapseq; idx < totseq; idx++)
-    tr[idx] = p7_trace_CreateWithPP();
-
-  p7_tracealign_computeTraces(hmm, sq, mapseq, totseq - mapseq, tr);
-
-  p7_tracealign_Seqs(sq, tr, totseq, hmm->M, msaopts, hmm, &msa);
-
-  esl_msafile_Write(ofp, msa, outfmt);
+  nalloc = mapseq;
+  do {
+    /* Read digital sequences into an array (possibly concat'ed onto mapped seqs) */
+    nseq = 0;
+    while (batchsize == 0 || nseq < batchsize)
+      {
+	if (mapseq + nseq == nalloc)
+	  {
+	    nalloc = (nalloc < 128 ? 256 : nalloc * 2);
+	    if (batchsize > 0) nalloc = ESL_MIN(nalloc, mapseq + batchsize + 1);
+	    ESL_RALLOC(sq, p, sizeof(ESL_SQ *)   * nalloc);
+	    ESL_RALLOC(tr, p, sizeof(P7_TRACE *) * nalloc);
+	    for (idx = mapseq + nseq; idx < nalloc; idx++) {
+	      sq[idx] = esl_sq_CreateDigital(abc);
+	      tr[idx] = p7_trace_CreateWithPP();
+	    }
+	  }
+	if ((status = esl_sqio_Read(sqfp, sq[mapseq + nseq])) != eslOK) break;
+	nseq++;
+      }
+    if      (status == eslEFORMAT) esl_fatal("Parse failed (sequence file %s):\n%s\n", 
+					     sqfp->filename, esl_sqfile_GetErrorBuf(sqfp));
+    else if (status != eslOK && status != eslEOF) esl_fatal("Unexpected error %d reading sequence file %s", status, sqfp->filename);
+    if (nseq == 0 && nbatch > 0) break;
+    totseq = mapseq + nseq;
+
+#ifdef HMMER_THREADS
+    if (ncpus > 0)
+      {
+	for (i = 0; i < ncpus; i++) {
+	  ESL_RALLOC(info[i].sq, p, sizeof(ESL_SQ *)   * (nseq / ncpus + 1));
+	  ESL_RALLOC(info[i].tr, p, sizeof(P7_TRACE *) * (nseq / ncpus + 1));
+	  info[i].N = 0;
+	}
+	for (idx = mapseq; idx < totseq; idx++) {
+	  i = (idx - mapseq) % ncpus;
+	  info[i].sq[info[i].N] = sq[idx];
+	  info[i].tr[info[i].N] = tr[idx];
+	  info[i].N++;
+	}
+	for (i = 0; i < ncpus; i++) esl_threads_AddThread(threadObj, &info[i]);
+	esl_threads_WaitForStart(threadObj);
+	esl_threads_WaitForFinish(threadObj);
+      }
+    else
+#endif
+      p7_tracealign_computeTraces(hmm, sq, mapseq, nseq, tr);
+
+    p7_tracealign_Seqs(sq, tr, totseq, hmm->M, msaopts, hmm, &msa);
+
+    esl_msafile_Write(ofp, msa, outfmt);
+    esl_msa_Destroy(msa);
+    msa = NULL;
+    nbatch++;
+
+    for (idx = mapseq; idx < totseq; idx++) {
+      esl_sq_Reuse(sq[idx]);
+      p7_trace_Reuse(tr[idx]);
+    }
+  } while (status == eslOK);
+  esl_sqfile_Close(sqfp);
 
-  for (idx = 0; idx <= totseq; idx++) esl_sq_Destroy(sq[idx]);    /* including sq[nseq] because we overallocated */
-  for (idx = 0; idx <  totseq; idx++) p7_trace_Destroy(tr[idx]); 
+  for (idx = 0; idx < nalloc; idx++) esl_sq_Destroy(sq[idx]);
+  for (idx = 0; idx < nalloc; idx++) p7_trace_Destroy(tr[idx]); 
   free(sq);
   free(tr);
-  esl_msa_Destroy(msa);
+#ifdef HMMER_THREADS
+  if (ncpus > 0) {
+    for (i = 0; i < ncpus; i++) { free(info[i].sq); free(info[i].tr); }
+    free(info);
+    esl_threads_Destroy(threadObj);
+  }
+#endif
   p7_hmm_Destroy(hmm);
   if (ofp != stdout) fclose(ofp);
   esl_alphabet_Destroy(abc);
@@ -224,6 +320,27 @@ main(int argc, char **argv)
  * Internal functions used by main and API
  *****************************************************************/
 
+#ifdef HMMER_THREADS
+static void
+trace_thread(void *arg)
+{
+  ESL_THREADS *obj = (ESL_THREADS *) arg;
+  WORKER_INFO *info;
+  int          workeridx;
+
+  impl_Init();
+
+  esl_threads_Started(obj, &workeridx);
+  info = (WORKER_INFO *) esl_threads_GetData(obj, workeridx);
+
+  if (info->N > 0)
+    p7_tracealign_computeTraces(info->hmm, info->sq, 0, info->N, info->tr);
+
+  esl_threads_Finished(obj, workeridx);
+  return;
+}
+#endif /*HMMER_THREADS*/
+
 static int
 map_alignment(const char *msafile, const P7_HMM *hmm, ESL_SQ ***ret_sq, P7_TRACE ***ret_tr, int *ret_ntot)
 {
@@ -118,6 +118,9 @@ static ESL_OPTIONS options[] = {
   { "--EfL",     eslARG_INT,    "100", NULL,"n>0",       NULL,    NULL,      NULL, "length of sequences for Forward exp tail tau fit",     6 },   
   { "--EfN",     eslARG_INT,    "200", NULL,"n>0",       NULL,    NULL,      NULL, "number of sequences for Forward exp tail tau fit",     6 },   
   { "--Eft",     eslARG_REAL,  "0.04", NULL,"0<x<1",     NULL,    NULL,      NULL, "tail mass for Forward exponential tail tau fit",       6 },   
+#ifdef HMMER_THREADS
+  { "--calcpu",  eslARG_INT,      "0", NULL,"n>=0",      NULL,    NULL,      NULL, "number of threads for each model's calibration (0=serial)", 6 },
+#endif
 
   /* Other options */
 #ifdef HMMER_THREADS 
@@ -341,6 +344,7 @@ output_header(const ESL_GETOPTS *go, const struct cfg_s *cfg)
 
 #ifdef HMMER_THREADS
   if (esl_opt_IsUsed(go, "--cpu")        && fprintf(cfg->ofp, "# number of worker threads:         %d\n",        esl_opt_GetInteger(go, "--cpu"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");  
+  if (esl_opt_IsUsed(go, "--calcpu")     && fprintf(cfg->ofp, "# threads for each calibration:     %d\n",        esl_opt_GetInteger(go, "--calcpu"))  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #endif
 #ifdef HMMER_MPI
   if (esl_opt_IsUsed(go, "--mpi")        && fprintf(cfg->ofp, "# parallelization mode:             MPI\n")                                            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -606,6 +610,8 @@ usual_master(const ESL_GETOPTS *go, struct cfg_s *cfg)
       if ( info[i].bld->w_beta < 0 || info[i].bld->w_beta > 1  ) esl_fatal("Invalid window-length beta value\n");
 
 #ifdef HMMER_THREADS
+      /* calibration stays serial unless asked: threaded simulations draw different random sequences */
+      info[i].bld->cal_ncpu = esl_opt_GetInteger(go, "--calcpu");
       info[i].queue = queue;
       if (ncpus > 0) esl_threads_AddThread(threadObj, &info[i]);
 #endif
@@ -6,6 +6,12 @@
 #include "esl_mem.h"
 
 #include <string.h>
+#include <inttypes.h>
+
+#ifdef HMMER_THREADS
+#include "esl_threads.h"
+#include "esl_workqueue.h"
+#endif
 
 #include "hmmer.h"
 #include "divsufsort.h"
@@ -31,6 +37,10 @@ static ESL_OPTIONS options[] = {
   { "--bin_length", eslARG_INT,        "256", NULL, NULL,    NULL,  NULL,  NULL,        "bin length (power of 2;  32<=b<=4096)",                     3 },
   { "--sa_freq",    eslARG_INT,        "8",   NULL, NULL,    NULL,  NULL,  NULL,        "suffix array sample rate (power of 2)",                     3 },
   { "--block_size", eslARG_INT,        "50",  NULL, NULL,    NULL,  NULL,  NULL,        "input sequence broken into blocks this size (Mbases)",      3 },
+  { "--max_mem",    eslARG_INT,        NULL,  NULL, "n>0",   NULL,  NULL,  NULL,        "limit block construction buffers to <n> Mbytes in total",   3 },
+#ifdef HMMER_THREADS 
+  { "--cpu",        eslARG_INT,     p7_NCPU,"HMMER_NCPU","n>=0",NULL, NULL,  NULL,        "number of parallel CPU workers to use for multithreads",    3 },
+#endif
 
   /* hidden*/
   { "--fwd_only",   eslARG_NONE,       FALSE, NULL, NULL,    NULL,  NULL,  NULL,        "build FM-index only for forward search (not for HMMER)",    9 },
@@ -41,6 +51,49 @@ static char usage[]  = "[options] <seqfile_in> <fmdb_out>";
 static char banner[] = "build an nhmmer FM-index database from an input sequence file";
 
 
+/* FM_BUILD_SLOT: one set of block construction buffers.
+ *
+ * The reader fills T and the block description, and a worker builds
+ * the block's forward and reverse FM-indexes from it.  The number of
+ * slots (not the number of workers) bounds how much memory a build
+ * uses: each costs roughly max_block_size * (1+1+4) bytes.
+ */
+typedef struct {
+  int        active;          // FALSE: no block to build; the worker exits
+  FM_DATA   *fm_data;         // T, BWT, SA and occurrence-count buffers
+  uint32_t  *SAsamp;
+  uint32_t  *cnts_sb;
+  uint16_t  *cnts_b;
+  uint8_t   *Tcompressed;
+
+  int        block_idx;       // position of this block in the output file
+  uint64_t   block_length;
+  uint32_t   seq_offset;
+  uint32_t   ambig_offset;
+  uint32_t   seq_cnt;
+  uint32_t   ambig_cnt;
+  uint32_t   overlap;
+} FM_BUILD_SLOT;
+
+/* FM_BUILD_WORKER: per-thread state.
+ *
+ * Each worker writes the blocks it builds to its own temporary file,
+ * and keeps a list of where each one starts, so that main() can copy
+ * them to the output in input order once all are built.
+ */
+typedef struct {
+  FM_METADATA    *meta;
+  FILE           *fptmp;
+  int            *block_idx;  // blocks written to fptmp, in the order written ...
+  off_t          *block_pos;  // ... and the offset of each in fptmp
+  int             nblocks;
+  int             nalloc;
+#ifdef HMMER_THREADS
+  ESL_WORK_QUEUE *queue;
+#endif
+} FM_BUILD_WORKER;
+
+
 static int
 process_commandline(int argc, char **argv, ESL_GETOPTS **ret_go, char **ret_seqfile, char **ret_fmfile)
 {
@@ -105,6 +158,10 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *seqfile, char *fmfile)
   if (fprintf(ofp, "# output binary-formatted HMMER database:  %s\n", fmfile)                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (fprintf(ofp, "# bin_length:                              %d\n", esl_opt_GetInteger(go, "--bin_length")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (fprintf(ofp, "# suffix array sample rate:                %d\n", esl_opt_GetInteger(go, "--sa_freq"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--max_mem")    && fprintf(ofp, "# max memory for block construction:       %d Mb\n", esl_opt_GetInteger(go, "--max_mem"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+#ifdef HMMER_THREADS
+  if (                                     fprintf(ofp, "# number of worker threads:                %d\n", esl_opt_GetInteger(go, "--cpu"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+#endif
   if (esl_opt_IsUsed(go, "--amino")      && fprintf(ofp, "# input is asserted to be:                 protein\n")                                        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--dna")        && fprintf(ofp, "# input is asserted to be:                 DNA\n")                                            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--rna")        && fprintf(ofp, "# input is asserted to be:                 RNA\n")                                            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
@@ -158,6 +215,24 @@ ERROR:
 }
 
 
+/* Function:  pad_to_align()
+ * Synopsis:  Write zeros to <fp> until its position is a multiple of
+ *            FM_ALIGN, so that the next block or array of the FM-index
+ *            is aligned when nhmmer maps the file.
+ */
+static int
+pad_to_align(FILE *fp)
+{
+  static const uint8_t zeros[FM_ALIGN] = { 0 };
+  off_t  pos = ftello(fp);
+  size_t n;
+
+  if (pos < 0) return eslFAIL;
+  n = (FM_ALIGN - pos % FM_ALIGN) % FM_ALIGN;
+  if (n > 0 && fwrite(zeros, sizeof(uint8_t), n, fp) != n) return eslFAIL;
+  return eslOK;
+}
+
 /* Function:  buildAndWriteFMIndex()
  * Synopsis:  Take text as input, along with several pre-allocated variables,
  *            and produce BWT and corresponding FM-index, then write it all
@@ -260,9 +335,10 @@ int buildAndWriteFMIndex (FM_METADATA *meta, uint32_t seq_offset, uint32_t ambig
     }
   }
 
-  //wrap up the counting;
+  //wrap up the counting; if N ends on a b checkpoint it's already stored, and cnts_b may have been reset by an sb checkpoint
   for (c=0; c<meta->alph_size; c++) {
-    FM_OCC_CNT(b, num_freq_cnts_b-1, c ) = cnts_b[c];
+    if (N % meta->freq_cnt_b)
+      FM_OCC_CNT(b, num_freq_cnts_b-1, c ) = cnts_b[c];
     FM_OCC_CNT(sb, num_freq_cnts_sb-1, c ) = cnts_sb[c];
   }
 
@@ -349,6 +425,155 @@ ERROR:
 }
 
 
+/* Function:  slot_Destroy()
+ */
+static void
+slot_Destroy(FM_BUILD_SLOT *slot)
+{
+  if (slot == NULL) return;
+  if (slot->fm_data != NULL) fm_FM_destroy(slot->fm_data, TRUE);
+  free(slot->fm_data);
+  free(slot->SAsamp);
+  free(slot->cnts_sb);
+  free(slot->cnts_b);
+  free(slot->Tcompressed);
+  free(slot);
+}
+
+/* Function:  slot_Create()
+ * Synopsis:  Allocate one set of block construction buffers, large
+ *            enough for a block of <max_block_size> characters.
+ */
+static int
+slot_Create(FM_METADATA *meta, uint32_t max_block_size, FM_BUILD_SLOT **ret_slot)
+{
+  FM_BUILD_SLOT *slot = NULL;
+  int            status;
+
+  ESL_ALLOC(slot, sizeof(FM_BUILD_SLOT));
+  slot->active      = FALSE;
+  slot->fm_data     = NULL;
+  slot->SAsamp      = NULL;
+  slot->cnts_sb     = NULL;
+  slot->cnts_b      = NULL;
+  slot->Tcompressed = NULL;
+
+  ESL_ALLOC(slot->fm_data, sizeof(FM_DATA) );
+  slot->fm_data->T          = NULL;
+  slot->fm_data->BWT_mem    = NULL;
+  slot->fm_data->BWT        = NULL;
+  slot->fm_data->SA         = NULL;
+  slot->fm_data->C          = NULL;
+  slot->fm_data->occCnts_sb = NULL;
+  slot->fm_data->occCnts_b  = NULL;
+  slot->fm_data->is_mapped  = FALSE;
+
+  ESL_ALLOC (slot->fm_data->T, max_block_size * sizeof(uint8_t));
+  ESL_ALLOC (slot->fm_data->BWT_mem, max_block_size * sizeof(uint8_t));
+  slot->fm_data->BWT = slot->fm_data->BWT_mem;  // in SSE code, used to align memory. Here, doesn't matter
+  ESL_ALLOC (slot->fm_data->SA, max_block_size * sizeof(int));
+  ESL_ALLOC (slot->SAsamp,     (1 + floor((double)max_block_size/meta->freq_SA) ) * sizeof(uint32_t));
+  ESL_ALLOC (slot->fm_data->occCnts_sb, (1+ceil((double)max_block_size/meta->freq_cnt_sb)) *  meta->alph_size * sizeof(uint32_t)); // every freq_cnt_sb positions, store an array of ints
+  ESL_ALLOC (slot->fm_data->occCnts_b,  ( 1+ceil((double)max_block_size/meta->freq_cnt_b)) *  meta->alph_size * sizeof(uint16_t)); // every freq_cnt_b positions, store an array of 8-byte ints
+  ESL_ALLOC (slot->cnts_sb,    meta->alph_size * sizeof(uint32_t));
+  ESL_ALLOC (slot->cnts_b,     meta->alph_size * sizeof(uint16_t));
+
+  *ret_slot = slot;
+  return eslOK;
+
+ ERROR:
+  *ret_slot = NULL;
+  slot_Destroy(slot);
+  return status;
+}
+
+/* Function:  slot_Size()
+ * Synopsis:  Bytes of memory used by one FM_BUILD_SLOT, for
+ *            checking the number of slots against --max_mem.
+ */
+static uint64_t
+slot_Size(FM_METADATA *meta, uint32_t max_block_size)
+{
+  uint64_t n = (uint64_t) max_block_size * (sizeof(uint8_t) + sizeof(uint8_t) + sizeof(int)); // T, BWT, SA
+  n += (1 + max_block_size/meta->freq_SA) * sizeof(uint32_t);                                // SAsamp
+  n += (2 + max_block_size/meta->freq_cnt_sb) * meta->alph_size * sizeof(uint32_t);          // occCnts_sb
+  n += (2 + max_block_size/meta->freq_cnt_b)  * meta->alph_size * sizeof(uint16_t);          // occCnts_b
+  n += max_block_size / (8/meta->charBits) + 1;                                              // Tcompressed
+  return n;
+}
+
+
+/* Function:  build_block()
+ * Synopsis:  Build the forward and (unless fwd_only) reverse FM-index
+ *            for the block held in <slot>, appending both to the
+ *            worker's temporary file, and note where they start.
+ */
+static int
+build_block(FM_BUILD_WORKER *w, FM_BUILD_SLOT *slot)
+{
+  FM_METADATA *meta = w->meta;
+  int          status;
+
+  if (w->nblocks == w->nalloc) {
+    w->nalloc = (w->nalloc == 0 ? 16 : w->nalloc * 2);
+    ESL_REALLOC(w->block_idx, w->nalloc * sizeof(int));
+    ESL_REALLOC(w->block_pos, w->nalloc * sizeof(off_t));
+  }
+  w->block_idx[w->nblocks] = slot->block_idx;
+  if ((w->block_pos[w->nblocks] = ftello(w->fptmp)) < 0)
+    esl_fatal("build_block: Error finding position in fm-index tmpfile.\n");
+  w->nblocks++;
+
+  //build and write FM-index for T.  This will be a BWT on the reverse of the sequence, required for reverse-traversal of the BWT
+  buildAndWriteFMIndex(meta, slot->seq_offset, slot->ambig_offset, slot->seq_cnt, slot->ambig_cnt, slot->overlap, slot->fm_data,
+                       slot->SAsamp, slot->cnts_sb, slot->cnts_b, slot->block_length, &(slot->Tcompressed), w->fptmp);
+
+  if ( ! meta->fwd_only ) {
+    //build and write FM-index for un-reversed T  (used to find reverse hits using forward traversal of the BWT
+    buildAndWriteFMIndex(meta, slot->seq_offset, slot->ambig_offset, slot->seq_cnt, slot->ambig_cnt, 0, slot->fm_data,
+                         NULL, slot->cnts_sb, slot->cnts_b, slot->block_length, &(slot->Tcompressed), w->fptmp);
+  }
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+#ifdef HMMER_THREADS
+/* Function:  thread_worker()
+ * Synopsis:  Build each block handed over by main(), until handed
+ *            an inactive slot.
+ */
+static void
+thread_worker(void *arg)
+{
+  ESL_THREADS     *obj = (ESL_THREADS *) arg;
+  FM_BUILD_WORKER *w;
+  FM_BUILD_SLOT   *slot;
+  void            *workpacket;
+  int              workeridx;
+
+  esl_threads_Started(obj, &workeridx);
+  w = (FM_BUILD_WORKER *) esl_threads_GetData(obj, workeridx);
+
+  if (esl_workqueue_WorkerUpdate(w->queue, NULL, &workpacket) != eslOK) esl_fatal("workqueue worker update failed");
+  slot = (FM_BUILD_SLOT *) workpacket;
+
+  while (slot->active)
+    {
+      if (build_block(w, slot) != eslOK) esl_fatal("failed to build FM-index block %d", slot->block_idx);
+
+      if (esl_workqueue_WorkerUpdate(w->queue, slot, &workpacket) != eslOK) esl_fatal("workqueue worker update failed");
+      slot = (FM_BUILD_SLOT *) workpacket;
+    }
+
+  if (esl_workqueue_WorkerUpdate(w->queue, slot, NULL) != eslOK) esl_fatal("workqueue worker update failed");
+  esl_threads_Finished(obj, workeridx);
+}
+#endif /*HMMER_THREADS*/
+
+
 
 /* Function:  main()
  * Synopsis:  break input sequence set into chunks, for each one building the
@@ -361,7 +586,7 @@ int
 main(int argc, char **argv) 
 {
   int status           = eslOK;
-  char tmp_filename[16] = "fmtmpXXXXXX";
+  char tmp_filename[16];
   FILE *fptmp          = NULL;
   FILE *fp             = NULL;
 
@@ -370,10 +595,21 @@ main(int argc, char **argv)
   FM_METADATA *meta    = NULL;
   FM_DATA *fm_data     = NULL;
   uint32_t *SAsamp     = NULL;
-  uint32_t *cnts_sb    = NULL;
-  uint16_t *cnts_b     = NULL;
-  uint8_t *Tcompressed = NULL;
 
+  FM_BUILD_SLOT   **slots   = NULL;  // block construction buffers; nslots of them
+  FM_BUILD_WORKER  *workers = NULL;  // one per worker thread, or one for a serial build
+  FM_BUILD_SLOT    *slot    = NULL;  // the slot main() is currently filling
+  int               nslots  = 0;
+  int               nworkers;
+  int               ncpus;
+  uint64_t          max_mem = 0;
+  int              *blk_worker = NULL; // for each block: the worker that built it ...
+  off_t            *blk_pos    = NULL; // ... and its offset in that worker's tmpfile
+#ifdef HMMER_THREADS
+  ESL_THREADS      *threadObj = NULL;
+  ESL_WORK_QUEUE   *queue     = NULL;
+  void             *workpacket;
+#endif
 
 
   clock_t t1, t2;
@@ -402,6 +638,7 @@ main(int argc, char **argv)
   int use_tmpsq = 0;
   uint64_t block_length;
   uint64_t total_char_count = 0;
+  uint32_t magic;
 
   uint32_t max_block_size;
 
@@ -426,14 +663,13 @@ main(int argc, char **argv)
   ESL_RANDOMNESS *r   = esl_randomness_Create(42);
 
 
-#if !defined (eslENABLE_SSE)
-    p7_Fail("The hmmerfm sequence database file format is valid only on systems supporting SSE vector instructions\n");
-#endif
-
   ESL_ALLOC (meta, sizeof(FM_METADATA));
   if (meta == NULL)
     esl_fatal("unable to allocate memory to store FM meta data\n");
   meta->alph = NULL;
+  meta->fmf  = NULL;
+  meta->fmb  = NULL;
+  meta->map  = NULL;
 
 
   ESL_ALLOC (meta->ambig_list, sizeof(FM_AMBIGLIST));
@@ -470,6 +706,14 @@ main(int argc, char **argv)
   if ( block_size > 3500000000  )
     esl_fatal ("block_size must less than 3500M\n");
 
+  if (esl_opt_IsOn(go, "--max_mem")) max_mem = (uint64_t) 1000000 * esl_opt_GetInteger(go, "--max_mem");
+
+#ifdef HMMER_THREADS
+  ncpus = ESL_MIN(esl_opt_GetInteger(go, "--cpu"), esl_threads_GetCPUCount());
+#else
+  ncpus = 0; // 0 = not multithreaded
+#endif
+
 
   //start timer
   t1 = times(&ts1);
@@ -537,28 +781,58 @@ main(int argc, char **argv)
   block->complete = FALSE;
   max_block_size = FM_BLOCK_OVERLAP+block_size+1  + ceil(block_size*.05); // first +1 for the '$',  +5% of block size because that's the slop allowed by readwindow
 
-  /* Allocate BWT, Text, SA, and FM-index data structures, allowing storage of maximally large sequence*/
-  ESL_ALLOC(fm_data, sizeof(FM_DATA) );
-  fm_data->T          = NULL;
-  fm_data->BWT_mem    = NULL;
-  fm_data->BWT        = NULL;
-  fm_data->SA         = NULL;
-  fm_data->C          = NULL;
-  fm_data->occCnts_sb = NULL;
-  fm_data->occCnts_b  = NULL;
-
-  ESL_ALLOC (fm_data->T, max_block_size * sizeof(uint8_t));
-  ESL_ALLOC (fm_data->BWT_mem, max_block_size * sizeof(uint8_t));
-  fm_data->BWT = fm_data->BWT_mem;  // in SSE code, used to align memory. Here, doesn't matter
-  ESL_ALLOC (fm_data->SA, max_block_size * sizeof(int));
-  ESL_ALLOC (SAsamp,     (1 + floor((double)max_block_size/meta->freq_SA) ) * sizeof(uint32_t));
-  ESL_ALLOC (fm_data->occCnts_sb, (1+ceil((double)max_block_size/meta->freq_cnt_sb)) *  meta->alph_size * sizeof(uint32_t)); // every freq_cnt_sb positions, store an array of ints
-  ESL_ALLOC (fm_data->occCnts_b,  ( 1+ceil((double)max_block_size/meta->freq_cnt_b)) *  meta->alph_size * sizeof(uint16_t)); // every freq_cnt_b positions, store an array of 8-byte ints
-  ESL_ALLOC (cnts_sb,    meta->alph_size * sizeof(uint32_t));
-  ESL_ALLOC (cnts_b,     meta->alph_size * sizeof(uint16_t));
-
-  // Open a temporary file, to which FM-index data will be written
-  if (esl_tmpfile(tmp_filename, &fptmp) != eslOK) esl_fatal("unable to open fm-index tmpfile");
+  /* Allocate BWT, Text, SA, and FM-index data structures, allowing storage of maximally large sequence.
+   * A threaded build needs one set per worker, plus one for the reader to fill while all workers are
+   * busy; --max_mem may cut that down (and the number of workers with it), at the cost of parallelism.
+   */
+  nslots = (ncpus > 0 ? ncpus + 1 : 1);
+  if (max_mem > 0) {
+    nslots = ESL_MIN(nslots, max_mem / slot_Size(meta, max_block_size));
+    if (nslots < 1)
+      esl_fatal("--max_mem %d is too small to build a single block of the FM-index; need %" PRIu64 " Mbytes for --block_size %d\n",
+                esl_opt_GetInteger(go, "--max_mem"), 1 + slot_Size(meta, max_block_size)/1000000, (int) (block_size/1000000));
+  }
+  if (nslots < 2) ncpus = 0;  // no room to fill one block while another is built
+  else            ncpus = ESL_MIN(ncpus, nslots-1);
+  nworkers = (ncpus > 0 ? ncpus : 1);
+
+  ESL_ALLOC(slots, nslots * sizeof(FM_BUILD_SLOT *));
+  for (i=0; i<nslots; i++) slots[i] = NULL;
+  for (i=0; i<nslots; i++)
+    if (slot_Create(meta, max_block_size, &(slots[i])) != eslOK) goto ERROR;
+
+  // Open a temporary file for each worker, to which it will write the FM-index data it builds
+  ESL_ALLOC(workers, nworkers * sizeof(FM_BUILD_WORKER));
+  for (i=0; i<nworkers; i++) {
+    workers[i].meta      = meta;
+    workers[i].block_idx = NULL;
+    workers[i].block_pos = NULL;
+    workers[i].nblocks   = 0;
+    workers[i].nalloc    = 0;
+    strcpy(tmp_filename, "fmtmpXXXXXX");
+    if (esl_tmpfile(tmp_filename, &(workers[i].fptmp)) != eslOK) esl_fatal("unable to open fm-index tmpfile");
+  }
+
+#ifdef HMMER_THREADS
+  if (ncpus > 0)
+    {
+      threadObj = esl_threads_Create(&thread_worker);
+      queue     = esl_workqueue_Create(nslots);
+      for (i=0; i<nslots; i++)
+        if (esl_workqueue_Init(queue, slots[i]) != eslOK) esl_fatal("Failed to add FM block buffers to work queue");
+      for (i=0; i<nworkers; i++) {
+        workers[i].queue = queue;
+        esl_threads_AddThread(threadObj, &workers[i]);
+      }
+
+      esl_workqueue_Reset(queue);
+      esl_threads_WaitForStart(threadObj);
+      if (esl_workqueue_ReaderUpdate(queue, NULL, &workpacket) != eslOK) esl_fatal("work queue reader update failure");
+      slot = (FM_BUILD_SLOT *) workpacket;
+    }
+  else
+#endif
+    slot = slots[0];
 
   /* Main loop: */
   while (status == eslOK ) {
@@ -673,7 +947,7 @@ main(int argc, char **argv)
           esl_fatal("requested alphabet doesn't match input text\n");
         }
 
-        fm_data->T[block_length] = meta->inv_alph[c];
+        slot->fm_data->T[block_length] = meta->inv_alph[c];
 
         block_length++;
         if (j>block->list[i].C) total_char_count++; // add to total count, only if it's not redundant with earlier read
@@ -683,25 +957,61 @@ main(int argc, char **argv)
       in_ambig_run = 0;
     }
 
-    fm_data->T[block_length] = 0; // last character 0 is effectively '$' for suffix array
+    slot->fm_data->T[block_length] = 0; // last character 0 is effectively '$' for suffix array
     block_length++;
 
-    seq_cnt = numseqs-seq_offset;
-    ambig_cnt = meta->ambig_list->count - ambig_offset;
+    slot->active       = TRUE;
+    slot->block_idx    = numblocks;
+    slot->block_length = block_length;
+    slot->seq_offset   = seq_offset;
+    slot->ambig_offset = ambig_offset;
+    slot->seq_cnt      = numseqs-seq_offset;
+    slot->ambig_cnt    = meta->ambig_list->count - ambig_offset;
+    slot->overlap      = (uint32_t)block->list[0].C;
+
+    // build the FM-indexes for this block; in a threaded build, hand it to a worker and take a free slot to fill next
+#ifdef HMMER_THREADS
+    if (ncpus > 0)
+      {
+        if (esl_workqueue_ReaderUpdate(queue, slot, &workpacket) != eslOK) esl_fatal("work queue reader update failure");
+        slot = (FM_BUILD_SLOT *) workpacket;
+      }
+    else
+#endif
+      if (build_block(&(workers[0]), slot) != eslOK) esl_fatal("failed to build FM-index block %d", numblocks);
 
+    numblocks++;
+  }
 
-    //build and write FM-index for T.  This will be a BWT on the reverse of the sequence, required for reverse-traversal of the BWT
-    buildAndWriteFMIndex(meta, seq_offset, ambig_offset, seq_cnt, ambig_cnt, (uint32_t)block->list[0].C, fm_data,
-                         SAsamp, cnts_sb, cnts_b, block_length, &Tcompressed, fptmp);
+#ifdef HMMER_THREADS
+  if (ncpus > 0)
+    {
+      /* Hand each worker an inactive slot to tell it to stop, taking back the slots they finish with */
+      for (i=0; i<nworkers-1; i++) {
+        slot->active = FALSE;
+        if (esl_workqueue_ReaderUpdate(queue, slot, &workpacket) != eslOK) esl_fatal("work queue reader update failure");
+        slot = (FM_BUILD_SLOT *) workpacket;
+      }
+      slot->active = FALSE;
+      if (esl_workqueue_ReaderUpdate(queue, slot, NULL) != eslOK) esl_fatal("work queue reader update failure");
 
+      esl_threads_WaitForFinish(threadObj);
+      esl_workqueue_Complete(queue);
+    }
+#endif
 
-    if ( ! meta->fwd_only ) {
-      //build and write FM-index for un-reversed T  (used to find reverse hits using forward traversal of the BWT
-      buildAndWriteFMIndex(meta, seq_offset, ambig_offset, seq_cnt, ambig_cnt, 0, fm_data,
-                         NULL, cnts_sb, cnts_b, block_length, &Tcompressed, fptmp);
+  /* Gather where each block was written; they are copied to the output in order below */
+  ESL_ALLOC(blk_worker, ESL_MAX(numblocks,1) * sizeof(int));
+  ESL_ALLOC(blk_pos,    ESL_MAX(numblocks,1) * sizeof(off_t));
+  for (i=0; i<nworkers; i++)
+    for (j=0; j<workers[i].nblocks; j++) {
+      blk_worker[workers[i].block_idx[j]] = i;
+      blk_pos[workers[i].block_idx[j]]    = workers[i].block_pos[j];
     }
-    numblocks++;
-  }
+
+  // the copy below reuses the first slot's buffers
+  fm_data = slots[0]->fm_data;
+  SAsamp  = slots[0]->SAsamp;
 
 
   esl_sqfile_Close(sqfp);
@@ -722,8 +1032,10 @@ main(int argc, char **argv)
     esl_fatal( "%s: Cannot open file `%s': ", argv[0], fname_out);
 
 
-    //write out meta data
-  if( fwrite(&(meta->fwd_only),     sizeof(meta->fwd_only),     1, fp) != 1 ||
+    //write out meta data, after the magic number that marks the aligned layout
+  magic = FM_MAGIC;
+  if( fwrite(&magic,                sizeof(magic),              1, fp) != 1 ||
+      fwrite(&(meta->fwd_only),     sizeof(meta->fwd_only),     1, fp) != 1 ||
       fwrite(&(meta->alph_type),    sizeof(meta->alph_type),    1, fp) != 1 ||
       fwrite(&(meta->alph_size),    sizeof(meta->alph_size),    1, fp) != 1 ||
       fwrite(&(meta->charBits),     sizeof(meta->charBits),     1, fp) != 1 ||
@@ -763,9 +1075,11 @@ main(int argc, char **argv)
   }
 
 
-  /* now append the FM-index data in fptmp to the desired output file, fp */
-  rewind(fptmp);
+  /* now append the FM-index data in the workers' tmpfiles to the desired output file, fp */
   for (i=0; i<numblocks; i++) {
+    fptmp = workers[blk_worker[i]].fptmp;
+    if (fseeko(fptmp, blk_pos[i], SEEK_SET) != 0)
+      esl_fatal( "%s: Error seeking in fm-index tmpfile.\n", argv[0]);
 
     for(j=0; j< (meta->fwd_only?1:2); j++ ) { //do this once or twice, once for forward-T index, and possibly once for reversed
     //first, read
@@ -805,7 +1119,9 @@ main(int argc, char **argv)
 
 
 
-    //then, write
+    //then, write, starting the block and each of its arrays on an FM_ALIGN boundary
+    if(pad_to_align(fp) != eslOK)
+      esl_fatal( "%s: Error writing padding in FM index.\n", argv[0]);
     if(fwrite(&block_length, sizeof(block_length), 1, fp) !=  1)
       esl_fatal( "%s: Error writing block_length in FM index.\n", argv[0]);
     if(fwrite(&term_loc, sizeof(term_loc), 1, fp) !=  1)
@@ -822,33 +1138,39 @@ main(int argc, char **argv)
       esl_fatal( "%s: Error writing ambig_cnt in FM index.\n", argv[0]);
 
 
-    if(j==0 && fwrite(fm_data->T, sizeof(uint8_t), compressed_bytes, fp) != compressed_bytes)
+    if(j==0 && (pad_to_align(fp) != eslOK || fwrite(fm_data->T, sizeof(uint8_t), compressed_bytes, fp) != compressed_bytes))
       esl_fatal( "%s: Error writing T in FM index.\n", argv[0]);
-    if(fwrite(fm_data->BWT, sizeof(uint8_t), compressed_bytes, fp) != compressed_bytes)
+    if(pad_to_align(fp) != eslOK || fwrite(fm_data->BWT, sizeof(uint8_t), compressed_bytes, fp) != compressed_bytes)
       esl_fatal( "%s: Error writing BWT in FM index.\n", argv[0]);
-    if(j==0 && fwrite(SAsamp, sizeof(uint32_t), (size_t)num_SA_samples, fp) != (size_t)num_SA_samples)
+    if(j==0 && (pad_to_align(fp) != eslOK || fwrite(SAsamp, sizeof(uint32_t), (size_t)num_SA_samples, fp) != (size_t)num_SA_samples))
       esl_fatal( "%s: Error writing SA in FM index.\n", argv[0]);
-    if(fwrite(fm_data->occCnts_b, sizeof(uint16_t)*(meta->alph_size), (size_t)num_freq_cnts_b, fp) != (size_t)num_freq_cnts_b)
+    if(pad_to_align(fp) != eslOK || fwrite(fm_data->occCnts_b, sizeof(uint16_t)*(meta->alph_size), (size_t)num_freq_cnts_b, fp) != (size_t)num_freq_cnts_b)
       esl_fatal( "%s: Error writing occCnts_b in FM index.\n", argv[0]);
-    if(fwrite(fm_data->occCnts_sb, sizeof(uint32_t)*(meta->alph_size), (size_t)num_freq_cnts_sb, fp) != (size_t)num_freq_cnts_sb)
+    if(pad_to_align(fp) != eslOK || fwrite(fm_data->occCnts_sb, sizeof(uint32_t)*(meta->alph_size), (size_t)num_freq_cnts_sb, fp) != (size_t)num_freq_cnts_sb)
       esl_fatal( "%s: Error writing occCnts_sb in FM index.\n", argv[0]);
 
     }
   }
 
   fclose(fp);
-  fclose(fptmp);
-
-
-  if (fm_data != NULL)
-    fm_FM_destroy(fm_data, TRUE);
-  free(fm_data);
-  free(SAsamp);
 
-  free(cnts_b);
-  free(cnts_sb);
-
-  free(Tcompressed);
+  for (i=0; i<nworkers; i++) {
+    fclose(workers[i].fptmp);
+    free(workers[i].block_idx);
+    free(workers[i].block_pos);
+  }
+  free(workers);
+  for (i=0; i<nslots; i++) slot_Destroy(slots[i]);
+  free(slots);
+  free(blk_worker);
+  free(blk_pos);
+
+#ifdef HMMER_THREADS
+  if (ncpus > 0) {
+    esl_workqueue_Destroy(queue);
+    esl_threads_Destroy(threadObj);
+  }
+#endif
 
   fm_metaDestroy(meta);
   esl_getopts_Destroy(go);
@@ -870,12 +1192,12 @@ main(int argc, char **argv)
 ERROR:
   /* Deallocate memory. */
   if (fp)         fclose(fp);
-  if (fm_data)    fm_FM_destroy(fm_data, TRUE);
-  free(fm_data);
-
-  free(SAsamp);
-  free(cnts_b);
-  free(cnts_sb);
+  if (slots)
+    for (i=0; i<nslots; i++) slot_Destroy(slots[i]);
+  free(slots);
+  free(workers);
+  free(blk_worker);
+  free(blk_pos);
 
   fm_metaDestroy(meta);
   esl_getopts_Destroy(go);
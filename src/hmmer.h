@@ -51,9 +51,12 @@
 #include "esl_random.h"		/* ESL_RANDOMNESS        */
 #include "esl_rand64.h" /* ESL_RAND64 */
 #include "esl_sq.h"		/* ESL_SQ                */
+#include "esl_sqio.h"		/* ESL_SQFILE            */
 #include "esl_scorematrix.h"    /* ESL_SCOREMATRIX       */
 #include "esl_stopwatch.h"      /* ESL_STOPWATCH         */
 
+#include "p7_gbands.h"		/* P7_GBANDS             */
+
 
 
 /* Search modes. */
@@ -411,6 +414,20 @@ enum p7_hmmfile_formats_e {
   p7_HMMFILE_3f = 6,
 };
 
+/* P7_PRESSMAP: the binary parts (.h3f, .h3p) of a pressed HMM database,
+ * mapped into memory. Optimized profiles read from a mapped database
+ * point straight into the mapping instead of copying their vector
+ * blocks, so each profile holds a reference; the mapping goes away
+ * when the last profile and the HMM file that made it are gone.
+ */
+typedef struct p7_pressmap_s {
+  char         *fmap;           /* .h3f, mapped copy-on-write         */
+  off_t         fsize;          /* size of .h3f in bytes              */
+  char         *pmap;           /* .h3p, mapped copy-on-write         */
+  off_t         psize;          /* size of .h3p in bytes              */
+  int           nref;           /* # of HMM files and profiles using it; updated atomically */
+} P7_PRESSMAP;
+
 typedef struct p7_hmmfile_s {
   FILE         *f;		 /* pointer to stream for reading models                 */
   char         *fname;	         /* (fully qualified) name of the HMM file; [STDIN] if - */
@@ -428,6 +445,7 @@ typedef struct p7_hmmfile_s {
   /* If <is_pressed>, we can read optimized profiles directly, via:  */
   FILE         *ffp;		/* MSV part of the optimized profile */
   FILE         *pfp;		/* rest of the optimized profile     */
+  P7_PRESSMAP  *map;            /* <ffp>,<pfp> mapped into memory, or NULL */
 
 #ifdef HMMER_THREADS
   int              syncRead;
@@ -659,6 +677,10 @@ typedef struct p7_domaindef_s {
   P7_SPENSEMBLE  *sp;		/* an ensemble of sampled segment pairs (domain endpoints) */
   P7_TRACE       *tr;		/* reusable space for a trace of a domain                  */
   P7_TRACE       *gtr;		/* reusable space for a traceback of the entire target seq */
+  P7_TRACE      **trs;		/* ensemble of <nsamples> traces, for checkpointed sampling */
+  int             ntrs;		/* number of traces allocated in <trs>                     */
+  P7_GBANDS      *bnd;		/* posterior bands of a domain, for banded OA alignment     */
+  int             do_oaband;	/* TRUE to limit OA alignment to <bnd> (opt-in; may differ) */
 
   /* Heuristic thresholds that control the region definition process */
   /* "rt" = "region threshold", for lack of better term  */
@@ -763,6 +785,72 @@ typedef struct p7_tophits_s {
 } P7_TOPHITS;
 
 
+/* Structure: P7_HITBLOCK
+ *
+ * A list of hits in flat, serialized form, as the server's workers send
+ * them to the master: a header, then each hit in p7_hit_Serialize()
+ * format, back to back and best first, in one buffer. The buffer is
+ * written in one pass and sent as one message. Inflating it on the
+ * receiving side builds P7_HITs whose strings point into the buffer and
+ * whose domains and alignment displays live in arrays owned by the
+ * block, so no memory is allocated per hit. Each block is a sorted run;
+ * the master merges a search's runs k ways. See p7_hitblock.c.
+ */
+typedef struct p7_hitblock_s {
+  uint8_t       *data;      /* header + serialized hits                          */
+  uint32_t       n;         /* bytes used in <data>                              */
+  uint32_t       nalloc;    /* bytes allocated for <data>                        */
+
+  uint64_t       N;         /* number of hits                                    */
+  uint64_t       nreported; /* as in the P7_TOPHITS the block was written from   */
+  uint64_t       nincluded;
+  uint64_t       ndom;      /* total number of domains over all hits             */
+  uint64_t       nspp;      /* total length of the domains' scores_per_pos       */
+
+  /* Set by p7_hitblock_Inflate(); all point into <data> or into each other */
+  P7_HIT        *unsrt;     /* [0..N-1] hits, in the (sorted) order written      */
+  P7_HIT       **hit;       /* [0..N-1] pointers to them, for sorting            */
+  P7_DOMAIN     *dcl;       /* [0..ndom-1] domains of all hits                   */
+  P7_ALIDISPLAY *ad;        /* [0..ndom-1] their alignment displays              */
+  float         *spp;       /* [0..nspp-1] their scores_per_pos arrays           */
+  uint64_t       Nalloc;    /* allocated sizes of the arrays above, for reuse    */
+  uint64_t       domalloc;
+  uint64_t       sppalloc;
+} P7_HITBLOCK;
+
+
+/* Structure: P7_TARGETCACHE
+ *
+ * A target sequence database read and digitized once, for searching
+ * with many queries (hmmsearch --tcache). All residues are packed back
+ * to back in one buffer, each sequence with its own leading and
+ * trailing sentinel, and all names, accessions and descriptions in
+ * another; the per-sequence records hold offsets into them, so the
+ * buffers can grow while the cache is loaded. See p7_targetcache.c.
+ */
+typedef struct {
+  int64_t  roff;     /* offset of seq's leading sentinel in <residues>   */
+  int64_t  n;        /* length; residues are <residues>[roff+1..roff+n]  */
+  int64_t  toff;     /* offset of name in <text>; acc, desc follow it    */
+} P7_TARGETCACHE_SEQ;
+
+typedef struct p7_targetcache_s {
+  const ESL_ALPHABET *abc;       /* digital alphabet of the residues      */
+
+  ESL_DSQ            *residues;  /* digital seqs, each dsq[0..n+1]        */
+  int64_t             nres;      /* bytes used in <residues>              */
+  int64_t             ralloc;    /* bytes allocated for <residues>        */
+
+  char               *text;      /* name\0acc\0desc\0 of each seq        */
+  int64_t             ntext;     /* bytes used in <text>                  */
+  int64_t             talloc;    /* bytes allocated for <text>            */
+
+  P7_TARGETCACHE_SEQ *seq;       /* [0..nseq-1] sequences, in file order  */
+  int64_t             nseq;
+  int64_t             salloc;
+} P7_TARGETCACHE;
+
+
 
 
 
@@ -849,6 +937,15 @@ typedef struct p7_hmm_window_list_s {
  */
 #define FM_OCC_CNT( type, i, c)  ( occCnts_##type[(meta->alph_size)*(i) + (c)])
 
+/* An FM-index file that begins with FM_MAGIC pads each block, and each
+ * array within a block, to start on a multiple of FM_ALIGN bytes, so the
+ * file can be mapped into memory and used in place. The first byte of the
+ * magic is >1 on either byte order, so older readers, which expect the
+ * <fwd_only> flag there, reject these files instead of misreading them.
+ */
+#define FM_MAGIC  0xe6ede6b3
+#define FM_ALIGN  64
+
 enum fm_alphabettypes_e {
   fm_DNA        = 0,  //acgt,  2 bit
   //fm_DNA_full   = 1,  //includes ambiguity codes, 4 bit.
@@ -859,6 +956,15 @@ enum fm_alphabettypes_e {
  * See wheelert/notebook/2013/12-11-FM-alphabet-speed notes on 12/12.
  */
 
+/* Engines for the occurrence counts at the core of FM-index search;
+ * see fm_occ.c. fm_configInit() picks the fastest with fm_occ_Best().
+ */
+enum fm_occimpl_e {
+  fm_OCC_SCALAR = 0,
+  fm_OCC_SSE    = 1,
+  fm_OCC_AVX2   = 2,
+};
+
 enum fm_direction_e {
   fm_forward    = 0,
   fm_backward   = 1,
@@ -924,6 +1030,12 @@ typedef struct fm_metadata_s {
   FILE         *fp;
   FM_SEQDATA   *seq_data;
   FM_AMBIGLIST *ambig_list;
+  int           is_aligned; // TRUE if the file starts with FM_MAGIC, and its blocks are FM_ALIGN-padded
+  struct fm_data_s *fmf;    // after fm_FM_map()/fm_FM_load(): forward index of each block, [0..block_count-1]; else NULL
+  struct fm_data_s *fmb;    //    ... and backward index of each block; NULL if <fwd_only>
+  char         *map;        // the whole file, mapped read-only by fm_FM_map(); or NULL
+  off_t         map_size;   // size of <map> in bytes
+  off_t         map_pos;    // offset in <map> of the next unread byte
 } FM_METADATA;
 
 
@@ -942,6 +1054,7 @@ typedef struct fm_data_s {
   int64_t  *C; //the first position of each letter of the alphabet if all of T is sorted.  (signed, as I use that to keep tract of presence/absence)
   uint32_t *occCnts_sb;
   uint16_t *occCnts_b;
+  int       is_mapped;  // TRUE if T, BWT, SA and occCnts_* point into the FM_METADATA's <map>
 } FM_DATA;
 
 typedef struct fm_dp_pair_s {
@@ -1001,6 +1114,9 @@ typedef struct {
   /* no non-__m128i- elements above this line */
 #endif //#if   defined (eslENABLE_SSE)
 
+  /*occurrence counting engine, fm_OCC_*; set by fm_occ_Select()*/
+  int occ_impl;
+
   /*counter, to compute FM-index speed*/
   int occCallCnt;
 
@@ -1187,6 +1303,7 @@ typedef struct p7_pipeline_s {
   P7_OMX     *oxb;		/* one-row Backward matrix, accel pipe      */
   P7_OMX     *fwd;		/* full Fwd matrix for domain envelopes     */
   P7_OMX     *bck;		/* full Bck matrix for domain envelopes     */
+  P7_OMXCHK  *chk;		/* checkpointed Fwd matrix for long regions */
 
   /* Domain postprocessing                                                  */
   ESL_RANDOMNESS *r;		/* random number generator                  */
@@ -1298,6 +1415,7 @@ typedef struct p7_builder_s {
   int                  EfL;	         /* length of sequences generated for Forward fitting      */
   int                  EfN;	         /* # of sequences generated for Forward fitting           */
   double               Eft;	         /* tail mass used for Forward fitting                     */
+  int                  cal_ncpu;         /* threads for calibration simulations; 0 = serial        */
 
   /* Choice of prior                                                                               */
   P7_PRIOR            *prior;	         /* choice of prior when parameterizing from counts        */
@@ -1460,6 +1578,8 @@ extern int p7_pipeline_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, i
 
 extern int p7_tophits_MPISend(P7_TOPHITS *th, int dest, int tag, MPI_Comm comm, char **buf, int *nalloc);
 extern int p7_tophits_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, int *nalloc, P7_TOPHITS **ret_th);
+extern int p7_hitblock_MPISend(const P7_HITBLOCK *blk, int dest, int tag, MPI_Comm comm);
+extern int p7_hitblock_MPIRecv(int source, int tag, MPI_Comm comm, P7_HITBLOCK *blk);
 
 extern int p7_oprofile_MPISend(P7_OPROFILE *om, int dest, int tag, MPI_Comm comm, char **buf, int *nalloc);
 extern int p7_oprofile_MPIPackSize(P7_OPROFILE *om, MPI_Comm comm, int *ret_n);
@@ -1479,8 +1599,10 @@ extern P7_ALIDISPLAY *p7_alidisplay_Create(const P7_TRACE *tr, int which, const
 extern P7_ALIDISPLAY *p7_alidisplay_Create_empty();
 extern P7_ALIDISPLAY *p7_alidisplay_Clone(const P7_ALIDISPLAY *ad);
 extern size_t         p7_alidisplay_Sizeof(const P7_ALIDISPLAY *ad);
+extern uint32_t       p7_alidisplay_SerializedSize(const P7_ALIDISPLAY *obj);
 extern int            p7_alidisplay_Serialize(const P7_ALIDISPLAY *obj, uint8_t **buf, uint32_t *n, uint32_t *nalloc);
 extern int            p7_alidisplay_Deserialize(const uint8_t *buf, uint32_t *n, P7_ALIDISPLAY *ret_obj);
+extern int            p7_alidisplay_DeserializeShared(uint8_t *buf, uint32_t *n, P7_ALIDISPLAY *ret_obj);
 extern int            p7_alidisplay_Serialize_old(P7_ALIDISPLAY *ad);
 extern int            p7_alidisplay_Deserialize_old(P7_ALIDISPLAY *ad);
 extern void           p7_alidisplay_Destroy(P7_ALIDISPLAY *ad);
@@ -1527,8 +1649,10 @@ extern int p7_Builder_MaxLength      (P7_HMM *hmm, double emit_thresh);
 extern P7_DOMAIN *p7_domain_Create_empty();
 extern void p7_domain_Destroy(P7_DOMAIN *obj);
 extern int p7_domain_Copy(const P7_DOMAIN *src, P7_DOMAIN *dst);
+extern uint32_t p7_domain_SerializedSize(const P7_DOMAIN *obj);
 extern int p7_domain_Serialize(const P7_DOMAIN *obj, uint8_t **buf, uint32_t *n, uint32_t *nalloc);
 extern int p7_domain_Deserialize(const uint8_t *buf, uint32_t *n, P7_DOMAIN *ret_obj);
+extern int p7_domain_DeserializeShared(uint8_t *buf, uint32_t *n, P7_DOMAIN *ret_obj, P7_ALIDISPLAY *ad, float **spp, uint64_t *nspp);
 extern int p7_domain_TestSample(ESL_RAND64 *rng, P7_DOMAIN **ret_obj);
 extern int p7_domain_Compare(P7_DOMAIN *first, P7_DOMAIN *second, double atol, double rtol);
 
@@ -1541,7 +1665,7 @@ extern int           p7_domaindef_DumpPosteriors(FILE *ofp, P7_DOMAINDEF *ddef);
 extern void          p7_domaindef_Destroy(P7_DOMAINDEF *ddef);
 
 extern int p7_domaindef_ByViterbi            (P7_PROFILE *gm, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_GMX *gx1, P7_GMX *gx2, P7_DOMAINDEF *ddef);
-extern int p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPROFILE *om, P7_OMX *oxf, P7_OMX *oxb, P7_OMX *fwd, P7_OMX *bck,
+extern int p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPROFILE *om, P7_OMX *oxf, P7_OMX *oxb, P7_OMX *fwd, P7_OMX *bck, P7_OMXCHK *chk,
 				                                  P7_DOMAINDEF *ddef, P7_BG *bg, int long_target,
 				                                  P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr);
 
@@ -1560,11 +1684,21 @@ extern int     p7_gmx_DumpWindow(FILE *fp, P7_GMX *gx, int istart, int iend, int
 extern P7_HIT *p7_hit_Create_empty();
 extern void p7_hit_Destroy(P7_HIT *the_hit);
 extern int p7_hit_Copy(const P7_HIT *src, P7_HIT *dst);
+extern uint32_t p7_hit_SerializedSize(const P7_HIT *obj);
 extern int p7_hit_Serialize(const P7_HIT *obj, uint8_t **buf, uint32_t *n, uint32_t *nalloc);
 extern int p7_hit_Deserialize(const uint8_t *buf, uint32_t *n, P7_HIT *ret_obj);
+extern int p7_hit_DeserializeShared(uint8_t *buf, uint32_t *n, P7_HIT *ret_obj);
 extern int p7_hit_TestSample(ESL_RAND64 *rng, P7_HIT **ret_obj);
 extern int p7_hit_Compare(P7_HIT *first, P7_HIT *second, double atol, double rtol);
 
+/* p7_hitblock.c */
+extern P7_HITBLOCK *p7_hitblock_Create(void);
+extern int          p7_hitblock_Write(P7_HITBLOCK *blk, P7_TOPHITS *th);
+extern int          p7_hitblock_Inflate(P7_HITBLOCK *blk);
+extern void         p7_hitblock_Truncate(P7_HITBLOCK *blk, double min_sortkey);
+extern void         p7_hitblock_Destroy(P7_HITBLOCK *blk);
+extern int          p7_hitblock_MergeRuns(P7_HITBLOCK **run, int nrun, double min_sortkey, P7_HIT **hit, uint64_t *ret_N);
+
 /* p7_hmm.c */
 /*      1. The P7_HMM object: allocation, initialization, destruction. */
 extern P7_HMM *p7_hmm_Create(int M, const ESL_ALPHABET *abc);
@@ -1607,6 +1741,7 @@ extern int  p7_hmmfile_Open      (const char *filename, char *env, P7_HMMFILE **
 extern int  p7_hmmfile_OpenNoDB  (const char *filename, char *env, P7_HMMFILE **ret_hfp, char *errbuf);
 extern int  p7_hmmfile_OpenBuffer(const char *buffer, int size, P7_HMMFILE **ret_hfp);
 extern void p7_hmmfile_Close(P7_HMMFILE *hfp);
+extern void p7_hmmfile_ReleaseMap(P7_PRESSMAP *map);
 #ifdef HMMER_THREADS
 extern int  p7_hmmfile_CreateLock(P7_HMMFILE *hfp);
 #endif
@@ -1659,6 +1794,9 @@ extern int p7_Pipeline_LongTarget   (P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCORE
                                      const ESL_SQ *sq, int complementarity,
                                      const FM_DATA *fmf, const FM_DATA *fmb, FM_CFG *fm_cfg
                                      );
+extern int p7_Pipeline_LongTargetBatch(P7_PIPELINE **pli, P7_OPROFILE **om, P7_SCOREDATA **data,
+                                       P7_BG **bg, P7_TOPHITS **hitlist, const float *sc_thresh_ratio, int nq,
+                                       const FM_DATA *fmf, const FM_DATA *fmb, FM_CFG *fm_cfg);
 extern int p7_Pipeline_Mainstage(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist, float fwdsc, float nullsc);
 extern int p7_Pipeline_Overthruster(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, float *ret_fwdsc, float *ret_nullsc);
 extern int p7_pli_Statistics(FILE *ofp, P7_PIPELINE *pli, ESL_STOPWATCH *w);
@@ -1698,6 +1836,13 @@ extern int     p7_spensemble_GetClusterCoords(P7_SPENSEMBLE *sp, int which,
 					      int *ret_i, int *ret_j, int *ret_k, int *ret_m, float *ret_p);
 extern void    p7_spensemble_Destroy(P7_SPENSEMBLE *sp);
 
+/* p7_targetcache.c */
+extern int     p7_targetcache_Read(ESL_SQFILE *sqfp, int64_t max_nseq, P7_TARGETCACHE **ret_cache);
+extern int     p7_targetcache_GetSeq(const P7_TARGETCACHE *cache, int64_t idx, ESL_SQ *sq);
+extern int     p7_targetcache_GetBlock(const P7_TARGETCACHE *cache, int64_t *pos, ESL_SQ_BLOCK *block);
+extern size_t  p7_targetcache_Sizeof(const P7_TARGETCACHE *cache);
+extern void    p7_targetcache_Destroy(P7_TARGETCACHE *cache);
+
 /* p7_tophits.c */
 extern P7_TOPHITS *p7_tophits_Create(void);
 extern int         p7_tophits_Grow(P7_TOPHITS *h);
@@ -1712,6 +1857,7 @@ extern int         p7_tophits_Add(P7_TOPHITS *h,
 				  int hmmfrom, int hmmto, int hmmlen, 
 				  int domidx, int ndom,
 				  P7_ALIDISPLAY *ali);
+extern int         p7_tophits_CompareBySortkey(const P7_HIT *h1, const P7_HIT *h2);
 extern int         p7_tophits_SortBySortkey(P7_TOPHITS *h);
 extern int         p7_tophits_SortBySeqidxAndAlipos(P7_TOPHITS *h);
 extern int         p7_tophits_SortByModelnameAndAlipos(P7_TOPHITS *h);
@@ -1793,6 +1939,8 @@ extern int fm_getOriginalPosition (const FM_DATA *fms, const FM_METADATA *meta,
                                     uint32_t *segment_id, uint64_t *seg_pos);
 extern int fm_readFMmeta( FM_METADATA *meta);
 extern int fm_FM_read( FM_DATA *fm, FM_METADATA *meta, int getAll );
+extern int fm_FM_load( FM_METADATA *meta );
+extern int fm_FM_map ( FM_METADATA *meta );
 extern void fm_FM_destroy ( FM_DATA *fm, int isMainFM);
 extern uint8_t fm_getChar(uint8_t alph_type, int j, const uint8_t *B );
 extern int fm_getSARangeReverse( const FM_DATA *fm, FM_CFG *cfg, char *query, char *inv_alph, FM_INTERVAL *interval);
@@ -1813,12 +1961,30 @@ extern int fm_initConfigGeneric( FM_CFG *cfg, ESL_GETOPTS *go);
 extern int p7_SSVFM_longlarget( P7_OPROFILE *om, float nu, P7_BG *bg, double F1,
                       const FM_DATA *fmf, const FM_DATA *fmb, FM_CFG *fm_cfg, const P7_SCOREDATA *ssvdata,
                       int strands, ESL_RANDOMNESS *r, P7_HMM_WINDOWLIST *windowlist);
+extern int p7_SSVFM_longlarget_batch( P7_OPROFILE **om, const P7_SCOREDATA **ssvdata, const float *sc_thresh_ratio, int nq,
+                      float nu, P7_BG *bg, double F1,
+                      const FM_DATA *fmf, const FM_DATA *fmb, FM_CFG *fm_cfg,
+                      int strands, ESL_RANDOMNESS *r, P7_HMM_WINDOWLIST *windowlist);
 
 
+/* fm_occ.c */
+extern int         fm_occ_Available  (int impl);
+extern int         fm_occ_Best       (void);
+extern int         fm_occ_Select     (FM_CFG *cfg, int impl);
+extern const char *fm_occ_Name       (int impl);
+extern int         fm_getOccCount    (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c);
+extern int         fm_getOccCountLT  (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c, uint32_t *cnteq, uint32_t *cntlt);
+extern void        fm_occRange_scalar(const uint8_t *BWT, int alph_type, int lo, int hi, uint8_t c, uint32_t *ret_eq, uint32_t *ret_lt);
+
+/* fm_occ_avx.c */
+#ifdef p7ENABLE_AVX
+extern void        fm_occRange_avx2  (const uint8_t *BWT, int alph_type, int lo, int hi, uint8_t c, uint32_t *ret_eq, uint32_t *ret_lt);
+#endif
+
 /* fm_sse.c */
 extern int fm_configInit      (FM_CFG *cfg, ESL_GETOPTS *go);
-extern int fm_getOccCount     (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c);
-extern int fm_getOccCountLT   (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c, uint32_t *cnteq, uint32_t *cntlt);
+extern int fm_getOccCount_sse   (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c);
+extern int fm_getOccCountLT_sse (const FM_DATA *fm, const FM_CFG *cfg, int pos, uint8_t c, uint32_t *cnteq, uint32_t *cntlt);
 
 #endif /*P7_HMMERH_INCLUDED*/
 
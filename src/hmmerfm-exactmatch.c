@@ -284,20 +284,11 @@ main(int argc,  char *argv[])
 
 
 
-  //read in FM-index blocks
-  ESL_ALLOC(fmsf, meta->block_count * sizeof(FM_DATA) );
-  if (!meta->fwd_only )
-    ESL_ALLOC(fmsb, meta->block_count * sizeof(FM_DATA) );
-
-  for (i=0; i<meta->block_count; i++) {
-    fm_FM_read( fmsf+i,meta, TRUE );
-
-    if (!meta->fwd_only) {  // whether or not we're going to search forward, need to read it in
-      fm_FM_read(fmsb+i, meta, FALSE );
-      fmsb[i].SA = fmsf[i].SA;
-      fmsb[i].T = fmsf[i].T;
-    }
-  }
+  //read in (or map) FM-index blocks; fm_configDestroy() releases them
+  if (fm_FM_load(meta) != eslOK)
+    esl_fatal("Failed to read FM-index blocks from `%s'", fname_fm);
+  fmsf = meta->fmf;
+  fmsb = meta->fmb;
   fclose(fp_fm);
 
   output_header(meta, stdout, go, fname_fm, fname_queries);
@@ -477,12 +468,6 @@ main(int argc,  char *argv[])
 
   }
 
-  for (i=0; i<meta->block_count; i++) {
-    fm_FM_destroy( fmsf+i, 1 );
-    if (!meta->fwd_only)
-      fm_FM_destroy( fmsb+i, 0 );
-  }
-
 
   free (hits);
   free (line);
@@ -35,10 +35,11 @@ typedef struct {
 #ifdef HMMER_THREADS
   ESL_WORK_QUEUE   *queue;
 #endif
-  ESL_SQ           *qsq;
+  int               nqsq;        /* number of query sequences in current batch */
+  ESL_SQ          **qsq;         /* query sequences [0..nqsq-1]             */
   P7_BG            *bg;	         /* null model                              */
-  P7_PIPELINE      *pli;         /* work pipeline                           */
-  P7_TOPHITS       *th;          /* top hit results                         */
+  P7_PIPELINE     **pli;         /* work pipelines, one per query           */
+  P7_TOPHITS      **th;          /* top hit results, one per query          */
 } WORKER_INFO;
 
 #define REPOPTS     "-E,-T,--cut_ga,--cut_nc,--cut_tc"
@@ -55,6 +56,12 @@ typedef struct {
 #define MPIOPTS     NULL
 #endif
 
+#ifdef HMMER_MPI
+#define QBATCHOPTS  "--mpi"
+#else
+#define QBATCHOPTS  NULL
+#endif
+
 static ESL_OPTIONS options[] = {
   /* name           type          default  env  range toggles  reqs   incomp                         help                                           docgroup*/
   { "-h",           eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "show brief help on version and usage",                          1 },
@@ -89,10 +96,12 @@ static ESL_OPTIONS options[] = {
   { "--nobias",     eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL, "--max",          "turn off composition bias filter",                              7 },
   /* Other options */
   { "--nonull2",    eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL,  NULL,            "turn off biased composition score corrections",                12 },
+  { "--oaband",     eslARG_NONE,    NULL, NULL, NULL,    NULL,  NULL,  NULL,            "band OA alignment by posterior (may differ)",                12 },
   { "-Z",           eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of comparisons done, for E-value calculation",           12 },
   { "--domZ",       eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of significant seqs, for domain E-value calculation",    12 },
   { "--seed",       eslARG_INT,    "42",  NULL, "n>=0",  NULL,  NULL,  NULL,            "set RNG seed to <n> (if 0: one-time arbitrary seed)",          12 },
   { "--qformat",    eslARG_STRING,  NULL, NULL, NULL,    NULL,  NULL,  NULL,            "assert input <seqfile> is in format <s>: no autodetection",    12 },
+  { "--qbatch",     eslARG_INT,     "1",  NULL, "n>0",   NULL,  NULL, QBATCHOPTS,       "search <n> query seqs per pass through the HMM database",      12 },
 #ifdef HMMER_THREADS
   { "--cpu",        eslARG_INT,"0","HMMER_NCPU","n>=0",NULL,  NULL, CPUOPTS,            "number of parallel CPU workers to use for multithreads",       12 },  // multithread parallelization off by default. hmmscan is i/o bound on almost all systems.
 #endif
@@ -237,6 +246,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "--F3")        && fprintf(ofp, "# Fwd filter P threshold:       <= %g\n",            esl_opt_GetReal(go, "--F3"))          < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--nobias")    && fprintf(ofp, "# biased composition HMM filter:   off\n")                                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--nonull2")   && fprintf(ofp, "# null2 bias corrections:          off\n")                                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--oaband")    && fprintf(ofp, "# OA alignments:                   banded by posterior\n")                                 < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "-Z")          && fprintf(ofp, "# sequence search space set to:    %.0f\n",          esl_opt_GetReal(go, "-Z"))            < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domZ")      && fprintf(ofp, "# domain search space set to:      %.0f\n",          esl_opt_GetReal(go, "--domZ"))        < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--seed"))  {
@@ -244,6 +254,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *hmmfile, char *seqfile)
     else if (                                  fprintf(ofp, "# random number seed set to:       %d\n",        esl_opt_GetInteger(go, "--seed"))     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   }
   if (esl_opt_IsUsed(go, "--qformat")   && fprintf(ofp, "# input seqfile format asserted:   %s\n",            esl_opt_GetString(go, "--qformat"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--qbatch")    && fprintf(ofp, "# query seqs per database pass:    %d\n",            esl_opt_GetInteger(go, "--qbatch"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
                                            
 #ifdef HMMER_THREADS
   if (esl_opt_IsUsed(go, "--cpu")) {
@@ -331,13 +342,15 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   ESL_ALPHABET    *abc      = NULL;              /* sequence alphabet                               */
   P7_OPROFILE     *om       = NULL;		 /* target profile                                  */
   ESL_STOPWATCH   *w        = NULL;              /* timing                                          */
-  ESL_SQ          *qsq      = NULL;		 /* query sequence                                  */
+  ESL_SQ         **qsq      = NULL;		 /* batch of query sequences                        */
+  int              qbatch   = esl_opt_GetInteger(go, "--qbatch"); /* max # of queries per database pass  */
+  int              nqsq     = 0;                 /* # of queries in the current batch               */
   int              nquery   = 0;
   int              textw;
   int              status   = eslOK;
   int              hstatus  = eslOK;
   int              sstatus  = eslOK;
-  int              i;
+  int              i, q;
 
   int              ncpus    = 0;
 
@@ -382,7 +395,8 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   else if (status == eslEFORMAT)   p7_Fail("Sequence file %s is empty or misformatted\n",        cfg->seqfile);
   else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
   else if (status != eslOK)        p7_Fail("Unexpected error %d opening sequence file %s\n", status, cfg->seqfile);
-  qsq = esl_sq_CreateDigital(abc);
+  ESL_ALLOC(qsq, sizeof(ESL_SQ *) * qbatch);
+  for (q = 0; q < qbatch; q++) qsq[q] = esl_sq_CreateDigital(abc);
 
   /* Open the results output files */
   if (esl_opt_IsOn(go, "-o"))          { if ((ofp      = fopen(esl_opt_GetString(go, "-o"),          "w")) == NULL)  esl_fatal("Failed to open output file %s for writing\n",                 esl_opt_GetString(go, "-o")); }
@@ -408,6 +422,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   for (i = 0; i < infocnt; ++i)
     {
       info[i].bg    = p7_bg_Create(abc);
+      info[i].nqsq  = 0;
+      info[i].qsq   = qsq;
+      ESL_ALLOC(info[i].pli, sizeof(P7_PIPELINE *) * qbatch);
+      ESL_ALLOC(info[i].th,  sizeof(P7_TOPHITS *)  * qbatch);
 #ifdef HMMER_THREADS
       info[i].queue = queue;
 #endif
@@ -424,10 +442,17 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
     }
 #endif
 
-  /* Outside loop: over each query sequence in <seqfile>. */
-  while ((sstatus = esl_sqio_Read(sqfp, qsq)) == eslOK)
+  /* Outside loop: over each batch of up to <qbatch> query sequences in <seqfile>.
+   * Each profile read from the database is compared to every query in the
+   * batch before the next one is read; each query keeps its own pipeline
+   * and hit list, so its results are the same as if it were searched alone.
+   */
+  do
     {
-      nquery++;
+      for (nqsq = 0; nqsq < qbatch; nqsq++)
+	if ((sstatus = esl_sqio_Read(sqfp, qsq[nqsq])) != eslOK) break;
+      if (nqsq == 0) break;
+
       esl_stopwatch_Start(w);	                          
 
       /* Open the target profile database */
@@ -443,19 +468,19 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	}
 #endif
 
-      if (fprintf(ofp, "Query:       %s  [L=%ld]\n", qsq->name, (long) qsq->n) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      if (qsq->acc[0]  != 0 && fprintf(ofp, "Accession:   %s\n", qsq->acc)     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      if (qsq->desc[0] != 0 && fprintf(ofp, "Description: %s\n", qsq->desc)    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-
       for (i = 0; i < infocnt; ++i)
 	{
-	  /* Create processing pipeline and hit list */
-	  info[i].th  = p7_tophits_Create(); 
-	  info[i].pli = p7_pipeline_Create(go, 100, 100, FALSE, p7_SCAN_MODELS); /* M_hint = 100, L_hint = 100 are just dummies for now */
-	  info[i].pli->hfp = hfp;  /* for two-stage input, pipeline needs <hfp> */
+	  info[i].nqsq = nqsq;
+	  for (q = 0; q < nqsq; q++)
+	    {
+	      /* Create processing pipeline and hit list */
+	      info[i].th[q]  = p7_tophits_Create(); 
+	      info[i].pli[q] = p7_pipeline_Create(go, 100, 100, FALSE, p7_SCAN_MODELS); /* M_hint = 100, L_hint = 100 are just dummies for now */
+	      info[i].pli[q]->hfp = hfp;  /* for two-stage input, pipeline needs <hfp> */
+	      info[i].pli[q]->ddef->do_oaband = esl_opt_GetBoolean(go, "--oaband");
 
-	  p7_pli_NewSeq(info[i].pli, qsq);
-	  info[i].qsq = qsq;
+	      p7_pli_NewSeq(info[i].pli[q], qsq[q]);
+	    }
 
 #ifdef HMMER_THREADS
 	  if (ncpus > 0) esl_threads_AddThread(threadObj, &info[i]);
@@ -476,37 +501,49 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	default: 	   p7_Fail("Unexpected error in reading HMMs from %s",   cfg->hmmfile); 
 	}
 
-      /* merge the results of the search results */
-      for (i = 1; i < infocnt; ++i)
+      for (q = 0; q < nqsq; q++)
 	{
-	  p7_tophits_Merge(info[0].th, info[i].th);
-	  p7_pipeline_Merge(info[0].pli, info[i].pli);
+	  nquery++;
 
-	  p7_pipeline_Destroy(info[i].pli);
-	  p7_tophits_Destroy(info[i].th);
-	}
+	  /* merge the results of the search results */
+	  for (i = 1; i < infocnt; ++i)
+	    {
+	      p7_tophits_Merge(info[0].th[q], info[i].th[q]);
+	      p7_pipeline_Merge(info[0].pli[q], info[i].pli[q]);
 
-      /* Print results */
-      p7_tophits_SortBySortkey(info->th);
-      p7_tophits_Threshold(info->th, info->pli);
+	      p7_pipeline_Destroy(info[i].pli[q]);
+	      p7_tophits_Destroy(info[i].th[q]);
+	    }
 
-      p7_tophits_Targets(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      p7_tophits_Domains(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  if (fprintf(ofp, "Query:       %s  [L=%ld]\n", qsq[q]->name, (long) qsq[q]->n) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  if (qsq[q]->acc[0]  != 0 && fprintf(ofp, "Accession:   %s\n", qsq[q]->acc)     < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  if (qsq[q]->desc[0] != 0 && fprintf(ofp, "Description: %s\n", qsq[q]->desc)    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
-      if (tblfp)     p7_tophits_TabularTargets(tblfp,    qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
-      if (domtblfp)  p7_tophits_TabularDomains(domtblfp, qsq->name, qsq->acc, info->th, info->pli, (nquery == 1));
-      if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, qsq->name, qsq->acc, info->th, info->pli);
+	  /* Print results */
+	  p7_tophits_SortBySortkey(info->th[q]);
+	  p7_tophits_Threshold(info->th[q], info->pli[q]);
 
-      esl_stopwatch_Stop(w);
-      p7_pli_Statistics(ofp, info->pli, w);
-      if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      fflush(ofp);
+	  p7_tophits_Targets(ofp, info->th[q], info->pli[q], textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  p7_tophits_Domains(ofp, info->th[q], info->pli[q], textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+
+	  if (tblfp)     p7_tophits_TabularTargets(tblfp,    qsq[q]->name, qsq[q]->acc, info->th[q], info->pli[q], (nquery == 1));
+	  if (domtblfp)  p7_tophits_TabularDomains(domtblfp, qsq[q]->name, qsq[q]->acc, info->th[q], info->pli[q], (nquery == 1));
+	  if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, qsq[q]->name, qsq[q]->acc, info->th[q], info->pli[q]);
+
+	  esl_stopwatch_Stop(w);  /* in a batch, times are cumulative from the start of the batch */
+	  p7_pli_Statistics(ofp, info->pli[q], w);
+	  if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+	  fflush(ofp);
+
+	  p7_pipeline_Destroy(info->pli[q]);
+	  p7_tophits_Destroy(info->th[q]);
+	  esl_sq_Reuse(qsq[q]);
+	}
 
       p7_hmmfile_Close(hfp);
-      p7_pipeline_Destroy(info->pli);
-      p7_tophits_Destroy(info->th);
-      esl_sq_Reuse(qsq);
     }
+  while (sstatus == eslOK);
+
   if      (sstatus == eslEFORMAT) esl_fatal("Parse failed (sequence file %s):\n%s\n",
 					    sqfp->filename, esl_sqfile_GetErrorBuf(sqfp));
   else if (sstatus != eslEOF)     esl_fatal("Unexpected error %d reading sequence file %s",
@@ -522,7 +559,11 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   /* Cleanup - prepare for successful exit
    */
   for (i = 0; i < infocnt; ++i)
-    p7_bg_Destroy(info[i].bg);
+    {
+      p7_bg_Destroy(info[i].bg);
+      free(info[i].pli);
+      free(info[i].th);
+    }
 
 #ifdef HMMER_THREADS
   if (ncpus > 0)
@@ -537,7 +578,8 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   free(info);
 
-  esl_sq_Destroy(qsq);
+  for (q = 0; q < qbatch; q++) esl_sq_Destroy(qsq[q]);
+  free(qsq);
   esl_stopwatch_Destroy(w);
   esl_alphabet_Destroy(abc);
   esl_sqfile_Close(sqfp);
@@ -828,6 +870,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       th  = p7_tophits_Create(); 
       pli = p7_pipeline_Create(go, 100, 100, FALSE, p7_SCAN_MODELS); /* M_hint = 100, L_hint = 100 are just dummies for now */
       pli->hfp = hfp;  /* for two-stage input, pipeline needs <hfp> */
+      pli->ddef->do_oaband = esl_opt_GetBoolean(go, "--oaband");
 
       p7_pli_NewSeq(pli, qsq);
 
@@ -1063,6 +1106,7 @@ mpi_worker(ESL_GETOPTS *go, struct cfg_s *cfg)
       th  = p7_tophits_Create(); 
       pli = p7_pipeline_Create(go, 100, 100, FALSE, p7_SCAN_MODELS); /* M_hint = 100, L_hint = 100 are just dummies for now */
       pli->hfp = hfp;  /* for two-stage input, pipeline needs <hfp> */
+      pli->ddef->do_oaband = esl_opt_GetBoolean(go, "--oaband");
 
       p7_pli_NewSeq(pli, qsq);
 
@@ -1163,18 +1207,22 @@ serial_loop(WORKER_INFO *info, P7_HMMFILE *hfp)
 
   P7_OPROFILE   *om;
   ESL_ALPHABET  *abc = NULL;
+  int            q;
   /* Main loop: */
   while ((status = p7_oprofile_ReadMSV(hfp, &abc, &om)) == eslOK)
     {
-      p7_pli_NewModel(info->pli, om, info->bg);
-      p7_bg_SetLength(info->bg, info->qsq->n);
-      p7_oprofile_ReconfigLength(om, info->qsq->n);
+      for (q = 0; q < info->nqsq; q++)
+	{
+	  p7_pli_NewModel(info->pli[q], om, info->bg);
+	  p7_bg_SetLength(info->bg, info->qsq[q]->n);
+	  p7_oprofile_ReconfigLength(om, info->qsq[q]->n);
 
-      status = p7_Pipeline(info->pli, om, info->bg, info->qsq, NULL, info->th);
-      if (status == eslEINVAL) p7_Fail(info->pli->errbuf);
+	  status = p7_Pipeline(info->pli[q], om, info->bg, info->qsq[q], NULL, info->th[q]);
+	  if (status == eslEINVAL) p7_Fail(info->pli[q]->errbuf);
 
+	  p7_pipeline_Reuse(info->pli[q]);
+	}
       p7_oprofile_Destroy(om);
-      p7_pipeline_Reuse(info->pli);
     }
 
   esl_alphabet_Destroy(abc);
@@ -1234,7 +1282,7 @@ thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, P7_HMMFILE *hfp)
 static void 
 pipeline_thread(void *arg)
 {
-  int i;
+  int i, q;
   int status;
   int workeridx;
   WORKER_INFO   *info;
@@ -1261,16 +1309,19 @@ pipeline_thread(void *arg)
     {
       P7_OPROFILE *om = block->list[i];
 
-      p7_pli_NewModel(info->pli, om, info->bg);
-      p7_bg_SetLength(info->bg, info->qsq->n);
-      p7_oprofile_ReconfigLength(om, info->qsq->n);
+      for (q = 0; q < info->nqsq; q++)
+      {
+	p7_pli_NewModel(info->pli[q], om, info->bg);
+	p7_bg_SetLength(info->bg, info->qsq[q]->n);
+	p7_oprofile_ReconfigLength(om, info->qsq[q]->n);
 
-      status = p7_Pipeline(info->pli, om, info->bg, info->qsq, NULL, info->th);
-      if (status == eslEINVAL) p7_Fail(info->pli->errbuf);
+	status = p7_Pipeline(info->pli[q], om, info->bg, info->qsq[q], NULL, info->th[q]);
+	if (status == eslEINVAL) p7_Fail(info->pli[q]->errbuf);
 
-      p7_oprofile_Destroy(om);
-      p7_pipeline_Reuse(info->pli);
+	p7_pipeline_Reuse(info->pli[q]);
+      }
 
+      p7_oprofile_Destroy(om);
       block->list[i] = NULL;
     }
 
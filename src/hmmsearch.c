@@ -38,10 +38,11 @@ typedef struct {
 #ifdef HMMER_THREADS
   ESL_WORK_QUEUE   *queue;
 #endif 
-  P7_BG            *bg;	         /* null model                              */
-  P7_PIPELINE      *pli;         /* work pipeline                           */
-  P7_TOPHITS       *th;          /* top hit results                         */
-  P7_OPROFILE      *om;          /* optimized query profile                 */
+  int               nq;          /* number of queries in current batch      */
+  P7_BG           **bg;	         /* null models, [0..nq-1]                  */
+  P7_PIPELINE     **pli;         /* work pipelines, [0..nq-1]               */
+  P7_TOPHITS      **th;          /* top hit results, [0..nq-1]              */
+  P7_OPROFILE     **om;          /* optimized query profiles, [0..nq-1]     */
 } WORKER_INFO;
 
 #define REPOPTS     "-E,-T,--cut_ga,--cut_nc,--cut_tc"
@@ -52,7 +53,7 @@ typedef struct {
 
 #if defined (HMMER_THREADS) && defined (HMMER_MPI)
 #define CPUOPTS     "--mpi"
-#define MPIOPTS     "--cpu"
+#define MPIOPTS     "--cpu,--tcache,--qbatch"
 #else
 #define CPUOPTS     NULL
 #define MPIOPTS     NULL
@@ -94,10 +95,13 @@ static ESL_OPTIONS options[] = {
 
 /* Other options */
   { "--nonull2",    eslARG_NONE,   NULL,  NULL, NULL,    NULL,  NULL,  NULL,            "turn off biased composition score corrections",               12 },
+  { "--oaband",     eslARG_NONE,   NULL,  NULL, NULL,    NULL,  NULL,  NULL,            "band OA alignment by posterior (may differ)",               12 },
   { "-Z",           eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of comparisons done, for E-value calculation",          12 },
   { "--domZ",       eslARG_REAL,   FALSE, NULL, "x>0",   NULL,  NULL,  NULL,            "set # of significant seqs, for domain E-value calculation",   12 },
   { "--seed",       eslARG_INT,    "42",  NULL, "n>=0",  NULL,  NULL,  NULL,            "set RNG seed to <n> (if 0: one-time arbitrary seed)",         12 },
   { "--tformat",    eslARG_STRING,  NULL, NULL, NULL,    NULL,  NULL,  NULL,            "assert target <seqfile> is in format <s>: no autodetection",  12 },
+  { "--tcache",     eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,            "read <seqdb> into memory once, and search all queries there", 12 },
+  { "--qbatch",     eslARG_INT,      "1", NULL, "n>=1",  NULL,  NULL,  NULL,            "search <n> queries at a time in each pass over <seqdb>",      12 },
 
 #ifdef HMMER_THREADS 
   { "--cpu",        eslARG_INT, p7_NCPU,"HMMER_NCPU","n>=0",NULL,  NULL,  CPUOPTS,      "number of parallel CPU workers to use for multithreads",      12 },
@@ -140,12 +144,13 @@ struct cfg_s {
 };
 
 static int  serial_master(ESL_GETOPTS *go, struct cfg_s *cfg);
-static int  serial_loop  (WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs);
+static int  serial_loop  (WORKER_INFO *info, ESL_SQFILE *dbfp, P7_TARGETCACHE *tcache, int n_targetseqs);
+static void search_seq   (WORKER_INFO *info, ESL_SQ *dbsq);
 
 #ifdef HMMER_THREADS
 #define BLOCK_SIZE 1000
 
-static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs);
+static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, P7_TARGETCACHE *tcache, int n_targetseqs);
 static void pipeline_thread(void *arg);
 #endif 
 
@@ -254,6 +259,7 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *hmmfile, char *seqfile)
   if (esl_opt_IsUsed(go, "--ssifile")          && fprintf(ofp, "# Override ssi file to:            %s\n",            esl_opt_GetString(go, "--ssifile"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
   if (esl_opt_IsUsed(go, "--nonull2")    && fprintf(ofp, "# null2 bias corrections:          off\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--oaband")     && fprintf(ofp, "# OA alignments:                   banded by posterior\n")                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "-Z")           && fprintf(ofp, "# sequence search space set to:    %.0f\n",           esl_opt_GetReal(go, "-Z"))             < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--domZ")       && fprintf(ofp, "# domain search space set to:      %.0f\n",           esl_opt_GetReal(go, "--domZ"))         < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--seed"))  {
@@ -261,6 +267,8 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, char *hmmfile, char *seqfile)
     else if (                               fprintf(ofp, "# random number seed set to:       %d\n",             esl_opt_GetInteger(go, "--seed"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   }
   if (esl_opt_IsUsed(go, "--tformat")    && fprintf(ofp, "# targ <seqfile> format asserted:  %s\n",             esl_opt_GetString(go, "--tformat"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--tcache")     && fprintf(ofp, "# target seqs cached in memory:    yes\n")                                                   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--qbatch")     && fprintf(ofp, "# queries searched per db pass:    %d\n",             esl_opt_GetInteger(go, "--qbatch"))    < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #ifdef HMMER_THREADS
   if (esl_opt_IsUsed(go, "--cpu")        && fprintf(ofp, "# number of worker threads:        %d\n",             esl_opt_GetInteger(go, "--cpu"))       < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");  
 #endif
@@ -357,7 +365,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   FILE            *pfamtblfp= NULL;              /* output stream for pfam tabular output (--pfamtblout)    */
   P7_HMMFILE      *hfp      = NULL;              /* open input HMM file                             */
   ESL_SQFILE      *dbfp     = NULL;              /* open input sequence file                        */
-  P7_HMM          *hmm      = NULL;              /* one HMM query                                   */
+  P7_TARGETCACHE  *tcache   = NULL;              /* target seqs held in memory (--tcache)           */
+  P7_HMM         **hmm      = NULL;              /* batch of HMM queries, [0..nbatch-1]             */
+  P7_OPROFILE    **om       = NULL;              /* their optimized profiles, cloned to workers     */
   ESL_ALPHABET    *abc      = NULL;              /* digital alphabet                                */
   int              dbfmt    = eslSQFILE_UNKNOWN; /* format code for sequence database file          */
   ESL_STOPWATCH   *w;
@@ -366,7 +376,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   int              status   = eslOK;
   int              hstatus  = eslOK;
   int              sstatus  = eslOK;
-  int              i;
+  int              qbatch   = 1;                 /* max # of queries per pass over the db (--qbatch) */
+  int              nbatch   = 0;                 /* # of queries in the current batch               */
+  int              i, q;
 
   int              ncpus    = 0;
 
@@ -383,6 +395,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   if (esl_opt_GetBoolean(go, "--notextw")) textw = 0;
   else                                     textw = esl_opt_GetInteger(go, "--textw");
+  qbatch = esl_opt_GetInteger(go, "--qbatch");
 
   if (esl_opt_IsOn(go, "--tformat")) {
     dbfmt = esl_sqio_EncodeFormat(esl_opt_GetString(go, "--tformat"));
@@ -431,9 +444,16 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
   infocnt = (ncpus == 0) ? 1 : ncpus;
   ESL_ALLOC(info, (ptrdiff_t) sizeof(*info) * infocnt);
+  for (i = 0; i < infocnt; ++i) 
+    {
+      info[i].nq = 0;
+      info[i].bg = NULL; info[i].pli = NULL; info[i].th = NULL; info[i].om = NULL;
+    }
+  ESL_ALLOC(hmm, sizeof(P7_HMM *)      * qbatch);
+  ESL_ALLOC(om,  sizeof(P7_OPROFILE *) * qbatch);
 
   /* <abc> is not known 'til first HMM is read. */
-  hstatus = p7_hmmfile_Read(hfp, &abc, &hmm);
+  hstatus = p7_hmmfile_Read(hfp, &abc, &(hmm[0]));
   if (hstatus == eslOK)
     {
       /* One-time initializations after alphabet <abc> becomes known */
@@ -442,7 +462,12 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       for (i = 0; i < infocnt; ++i)
 	{
-	  info[i].bg    = p7_bg_Create(abc);
+	  ESL_ALLOC(info[i].bg,  sizeof(P7_BG *)       * qbatch);
+	  ESL_ALLOC(info[i].pli, sizeof(P7_PIPELINE *) * qbatch);
+	  ESL_ALLOC(info[i].th,  sizeof(P7_TOPHITS *)  * qbatch);
+	  ESL_ALLOC(info[i].om,  sizeof(P7_OPROFILE *) * qbatch);
+	  for (q = 0; q < qbatch; q++)
+	    info[i].bg[q] = p7_bg_Create(abc);
 #ifdef HMMER_THREADS
 	  info[i].queue = queue;
 #endif
@@ -460,17 +485,23 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #endif
     }
 
-  /* Outer loop: over each query HMM in <hmmfile>. */
+  /* Outer loop: over batches of up to <qbatch> query HMMs in <hmmfile>.
+   * Each pass over the target db runs every query in the batch on a
+   * target seq before moving on to the next one, so the db is pulled
+   * through memory once per batch instead of once per query (--qbatch).
+   */
   while (hstatus == eslOK) 
     {
       P7_PROFILE      *gm      = NULL;
-      P7_OPROFILE     *om      = NULL;       /* optimized query profile                  */
 
-      nquery++;
+      /* <hmm[0]> is already read; fill the rest of the batch */
+      nbatch = 1;
+      while (nbatch < qbatch && (hstatus = p7_hmmfile_Read(hfp, &abc, &(hmm[nbatch]))) == eslOK) nbatch++;
+
       esl_stopwatch_Start(w);
 
-      /* seqfile may need to be rewound (multiquery mode) */
-      if (nquery > 1)
+      /* seqfile may need to be rewound (multiquery mode), unless it's cached */
+      if (nquery > 0 && tcache == NULL)
       {
         if (! esl_sqfile_IsRewindable(dbfp))
           esl_fatal("Target sequence file %s isn't rewindable; can't search it with multiple queries", cfg->dbfile);
@@ -479,40 +510,54 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
           esl_sqfile_Position(dbfp, 0); //only re-set current position to 0 if we're not planning to set it in a moment
       }
 
-      if ( cfg->firstseq_key != NULL ) { //it's tempting to want to do this once and capture the offset position for future passes, but ncbi files make this non-trivial, so this keeps it general
+      if ( cfg->firstseq_key != NULL && tcache == NULL ) { //it's tempting to want to do this once and capture the offset position for future passes, but ncbi files make this non-trivial, so this keeps it general
         sstatus = esl_sqfile_PositionByKey(dbfp, cfg->firstseq_key);
         if (sstatus != eslOK)
           p7_Fail("Failure setting restrictdb_stkey to %d\n", cfg->firstseq_key);
       }
 
-      if (fprintf(ofp, "Query:       %s  [M=%d]\n", hmm->name, hmm->M)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      if (hmm->acc)  { if (fprintf(ofp, "Accession:   %s\n", hmm->acc)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
-      if (hmm->desc) { if (fprintf(ofp, "Description: %s\n", hmm->desc) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+      /* --tcache: read and digitize the (restricted) target db once, with the first query */
+      if (esl_opt_GetBoolean(go, "--tcache") && tcache == NULL)
+      {
+        sstatus = p7_targetcache_Read(dbfp, cfg->n_targetseq, &tcache);
+        if      (sstatus == eslEFORMAT) esl_fatal("Parse failed (sequence file %s):\n%s\n", dbfp->filename, esl_sqfile_GetErrorBuf(dbfp));
+        else if (sstatus != eslOK)      esl_fatal("Unexpected error %d caching sequence file %s", sstatus, dbfp->filename);
+      }
 
-      /* Convert to an optimized model */
-      gm = p7_profile_Create (hmm->M, abc);
-      om = p7_oprofile_Create(hmm->M, abc);
-      p7_ProfileConfig(hmm, info->bg, gm,100, p7_LOCAL); /* 100 is a dummy length for now; and MSVFilter requires local mode */
-      p7_oprofile_Convert(gm, om);                  /* <om> is now p7_LOCAL, multihit */
-      for (i = 0; i < infocnt; ++i)
+      /* Convert each query to an optimized model; each worker gets its own pipeline and hit list per query */
+      for (q = 0; q < nbatch; q++)
       {
-        /* Create processing pipeline and hit list */
-        info[i].th  = p7_tophits_Create();
-        info[i].om  = p7_oprofile_Clone(om);
-        info[i].pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
-        status = p7_pli_NewModel(info[i].pli, info[i].om, info[i].bg);
-        if (status == eslEINVAL) p7_Fail(info->pli->errbuf);
+        gm    = p7_profile_Create (hmm[q]->M, abc);
+        om[q] = p7_oprofile_Create(hmm[q]->M, abc);
+        p7_ProfileConfig(hmm[q], info->bg[q], gm, 100, p7_LOCAL); /* 100 is a dummy length for now; and MSVFilter requires local mode */
+        p7_oprofile_Convert(gm, om[q]);                           /* <om> is now p7_LOCAL, multihit */
+        p7_profile_Destroy(gm);
+
+        for (i = 0; i < infocnt; ++i)
+        {
+          /* Create processing pipeline and hit list */
+          info[i].th[q]  = p7_tophits_Create();
+          info[i].om[q]  = p7_oprofile_Clone(om[q]);
+          info[i].pli[q] = p7_pipeline_Create(go, om[q]->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+          info[i].pli[q]->ddef->do_oaband = esl_opt_GetBoolean(go, "--oaband");
+          status = p7_pli_NewModel(info[i].pli[q], info[i].om[q], info[i].bg[q]);
+          if (status == eslEINVAL) p7_Fail(info[i].pli[q]->errbuf);
+        }
+      }
 
+      for (i = 0; i < infocnt; ++i)
+      {
+        info[i].nq = nbatch;
 #ifdef HMMER_THREADS
         if (ncpus > 0) esl_threads_AddThread(threadObj, &info[i]);
 #endif
       }
 
 #ifdef HMMER_THREADS
-      if (ncpus > 0)  sstatus = thread_loop(threadObj, queue, dbfp, cfg->n_targetseq);
-      else            sstatus = serial_loop(info, dbfp, cfg->n_targetseq);
+      if (ncpus > 0)  sstatus = thread_loop(threadObj, queue, dbfp, tcache, cfg->n_targetseq);
+      else            sstatus = serial_loop(info, dbfp, tcache, cfg->n_targetseq);
 #else
-      sstatus = serial_loop(info, dbfp, cfg->n_targetseq);
+      sstatus = serial_loop(info, dbfp, tcache, cfg->n_targetseq);
 #endif
       switch(sstatus)
       {
@@ -527,60 +572,71 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
         esl_fatal("Unexpected error %d reading sequence file %s", sstatus, dbfp->filename);
       }
 
-      /* merge the results of the search results */
-      for (i = 1; i < infocnt; ++i)
+      esl_stopwatch_Stop(w);
+
+      /* Output results for each query in the batch, in the order they were read */
+      for (q = 0; q < nbatch; q++)
       {
-        p7_tophits_Merge(info[0].th, info[i].th);
-        p7_pipeline_Merge(info[0].pli, info[i].pli);
+        nquery++;
 
-        p7_pipeline_Destroy(info[i].pli);
-        p7_tophits_Destroy(info[i].th);
-        p7_oprofile_Destroy(info[i].om);
-      }
+        /* merge the results of the search results */
+        for (i = 1; i < infocnt; ++i)
+        {
+          p7_tophits_Merge(info[0].th[q], info[i].th[q]);
+          p7_pipeline_Merge(info[0].pli[q], info[i].pli[q]);
 
-      /* Print the results.  */
-      p7_tophits_SortBySortkey(info->th);
-      p7_tophits_Threshold(info->th, info->pli);
-      p7_tophits_Targets(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-      p7_tophits_Domains(ofp, info->th, info->pli, textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-
-      if (tblfp)     p7_tophits_TabularTargets(tblfp,    hmm->name, hmm->acc, info->th, info->pli, (nquery == 1));
-      if (domtblfp)  p7_tophits_TabularDomains(domtblfp, hmm->name, hmm->acc, info->th, info->pli, (nquery == 1));
-      if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, hmm->name, hmm->acc, info->th, info->pli);
-  
-      esl_stopwatch_Stop(w);
-      p7_pli_Statistics(ofp, info->pli, w);
-      if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+          p7_pipeline_Destroy(info[i].pli[q]);
+          p7_tophits_Destroy(info[i].th[q]);
+          p7_oprofile_Destroy(info[i].om[q]);
+        }
 
-      /* Output the results in an MSA (-A option) */
-      if (afp) {
-	ESL_MSA *msa = NULL;
+        if (fprintf(ofp, "Query:       %s  [M=%d]\n", hmm[q]->name, hmm[q]->M)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+        if (hmm[q]->acc)  { if (fprintf(ofp, "Accession:   %s\n", hmm[q]->acc)  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+        if (hmm[q]->desc) { if (fprintf(ofp, "Description: %s\n", hmm[q]->desc) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
-	if (p7_tophits_Alignment(info->th, abc, NULL, NULL, 0, p7_ALL_CONSENSUS_COLS, &msa) == eslOK)
-	  {
-	    esl_msa_SetName     (msa, hmm->name, -1);
-	    esl_msa_SetAccession(msa, hmm->acc,  -1);
-	    esl_msa_SetDesc     (msa, hmm->desc, -1);
-	    esl_msa_FormatAuthor(msa, "hmmsearch (HMMER %s)", HMMER_VERSION);
+        /* Print the results.  */
+        p7_tophits_SortBySortkey(info->th[q]);
+        p7_tophits_Threshold(info->th[q], info->pli[q]);
+        p7_tophits_Targets(ofp, info->th[q], info->pli[q], textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+        p7_tophits_Domains(ofp, info->th[q], info->pli[q], textw); if (fprintf(ofp, "\n\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
-	    if (textw > 0) esl_msafile_Write(afp, msa, eslMSAFILE_STOCKHOLM);
-	    else           esl_msafile_Write(afp, msa, eslMSAFILE_PFAM);
-	  
-	    if (fprintf(ofp, "# Alignment of %d hits satisfying inclusion thresholds saved to: %s\n", msa->nseq, esl_opt_GetString(go, "-A")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
-	  } 
-	else { if (fprintf(ofp, "# No hits satisfy inclusion thresholds; no alignment saved\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
-	  
-	esl_msa_Destroy(msa);
-      }
+        if (tblfp)     p7_tophits_TabularTargets(tblfp,    hmm[q]->name, hmm[q]->acc, info->th[q], info->pli[q], (nquery == 1));
+        if (domtblfp)  p7_tophits_TabularDomains(domtblfp, hmm[q]->name, hmm[q]->acc, info->th[q], info->pli[q], (nquery == 1));
+        if (pfamtblfp) p7_tophits_TabularXfam(pfamtblfp, hmm[q]->name, hmm[q]->acc, info->th[q], info->pli[q]);
 
-      p7_pipeline_Destroy(info->pli);
-      p7_tophits_Destroy(info->th);
-      p7_oprofile_Destroy(info->om);
-      p7_oprofile_Destroy(om);
-      p7_profile_Destroy(gm);
-      p7_hmm_Destroy(hmm);
+        p7_pli_Statistics(ofp, info->pli[q], w);  /* elapsed time is for the whole batch */
+        if (fprintf(ofp, "//\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 
-      hstatus = p7_hmmfile_Read(hfp, &abc, &hmm);
+        /* Output the results in an MSA (-A option) */
+        if (afp) {
+          ESL_MSA *msa = NULL;
+
+          if (p7_tophits_Alignment(info->th[q], abc, NULL, NULL, 0, p7_ALL_CONSENSUS_COLS, &msa) == eslOK)
+            {
+              esl_msa_SetName     (msa, hmm[q]->name, -1);
+              esl_msa_SetAccession(msa, hmm[q]->acc,  -1);
+              esl_msa_SetDesc     (msa, hmm[q]->desc, -1);
+              esl_msa_FormatAuthor(msa, "hmmsearch (HMMER %s)", HMMER_VERSION);
+
+              if (textw > 0) esl_msafile_Write(afp, msa, eslMSAFILE_STOCKHOLM);
+              else           esl_msafile_Write(afp, msa, eslMSAFILE_PFAM);
+
+              if (fprintf(ofp, "# Alignment of %d hits satisfying inclusion thresholds saved to: %s\n", msa->nseq, esl_opt_GetString(go, "-A")) < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+            } 
+          else { if (fprintf(ofp, "# No hits satisfy inclusion thresholds; no alignment saved\n") < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
+
+          esl_msa_Destroy(msa);
+        }
+
+        p7_pipeline_Destroy(info->pli[q]);
+        p7_tophits_Destroy(info->th[q]);
+        p7_oprofile_Destroy(info->om[q]);
+        p7_oprofile_Destroy(om[q]);
+        p7_hmm_Destroy(hmm[q]);
+      }
+
+      /* if filling the batch hit a read error, we've reported the queries we got; the error is reported below */
+      if (hstatus == eslOK) hstatus = p7_hmmfile_Read(hfp, &abc, &(hmm[0]));
     } /* end outer loop over query HMMs */
 
   switch(hstatus) {
@@ -602,7 +658,14 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   /* Cleanup - prepare for exit
    */
   for (i = 0; i < infocnt; ++i)
-    p7_bg_Destroy(info[i].bg);
+    {
+      if (info[i].bg) 
+	for (q = 0; q < qbatch; q++) p7_bg_Destroy(info[i].bg[q]);
+      free(info[i].bg);
+      free(info[i].pli);
+      free(info[i].th);
+      free(info[i].om);
+    }
 
 #ifdef HMMER_THREADS
   if (ncpus > 0)
@@ -616,6 +679,9 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 #endif
 
   free(info);
+  free(hmm);
+  free(om);
+  p7_targetcache_Destroy(tcache);
   p7_hmmfile_Close(hfp);
   esl_sqfile_Close(dbfp);
   esl_alphabet_Destroy(abc);
@@ -935,6 +1001,7 @@ mpi_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       /* Create processing pipeline and hit list */
       th  = p7_tophits_Create(); 
       pli = p7_pipeline_Create(go, hmm->M, 100, FALSE, p7_SEARCH_SEQS);
+      pli->ddef->do_oaband = esl_opt_GetBoolean(go, "--oaband");
       p7_pli_NewModel(pli, om, bg);
 
       /* Main loop: */
@@ -1199,6 +1266,7 @@ printf("Starting mpi_worker on node %d\n",cfg->my_rank);
 
       th  = p7_tophits_Create(); 
       pli = p7_pipeline_Create(go, om->M, 100, FALSE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+      pli->ddef->do_oaband = esl_opt_GetBoolean(go, "--oaband");
       p7_pli_NewModel(pli, om, bg);
 
       /* receive a sequence block from the master */
@@ -1285,27 +1353,53 @@ printf("Starting mpi_worker on node %d\n",cfg->my_rank);
 }
 #endif /*HMMER_MPI*/
 
+/* search_seq()
+ * Run one target seq through the pipeline of each query in the
+ * worker's current batch. The seq stays hot in cache across the whole
+ * batch, so the target db is streamed from memory once per batch
+ * rather than once per query.
+ */
+static void
+search_seq(WORKER_INFO *info, ESL_SQ *dbsq)
+{
+  int q;
+
+  for (q = 0; q < info->nq; q++)
+    {
+      p7_pli_NewSeq(info->pli[q], dbsq);
+      p7_bg_SetLength(info->bg[q], dbsq->n);
+      p7_oprofile_ReconfigLength(info->om[q], dbsq->n);
+
+      p7_Pipeline(info->pli[q], info->om[q], info->bg[q], dbsq, NULL, info->th[q]);
+
+      p7_pipeline_Reuse(info->pli[q]);
+    }
+}
+
+/* serial_loop()
+ * Search the target seqs, read from <dbfp> or, if <tcache> isn't NULL,
+ * copied out of the cache.
+ */
 static int
-serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs)
+serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, P7_TARGETCACHE *tcache, int n_targetseqs)
 {
   int      sstatus;
   ESL_SQ   *dbsq     = NULL;   /* one target sequence (digital)  */
   int seq_cnt = 0;
 
-  dbsq = esl_sq_CreateDigital(info->om->abc);
+  dbsq = esl_sq_CreateDigital(info->om[0]->abc);
 
   /* Main loop: */
-  while ( (n_targetseqs==-1 || seq_cnt<n_targetseqs) &&  (sstatus = esl_sqio_Read(dbfp, dbsq)) == eslOK)
+  while (n_targetseqs==-1 || seq_cnt<n_targetseqs)
   {
-      p7_pli_NewSeq(info->pli, dbsq);
-      p7_bg_SetLength(info->bg, dbsq->n);
-      p7_oprofile_ReconfigLength(info->om, dbsq->n);
-      
-      p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
+      if (tcache) sstatus = (seq_cnt < tcache->nseq) ? p7_targetcache_GetSeq(tcache, seq_cnt, dbsq) : eslEOF;
+      else        sstatus = esl_sqio_Read(dbfp, dbsq);
+      if (sstatus != eslOK) break;
+
+      search_seq(info, dbsq);
 
       seq_cnt++;
       esl_sq_Reuse(dbsq);
-      p7_pipeline_Reuse(info->pli);
   }
 
   if (n_targetseqs!=-1 && seq_cnt==n_targetseqs)
@@ -1318,11 +1412,12 @@ serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, int n_targetseqs)
 
 #ifdef HMMER_THREADS
 static int
-thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_targetseqs)
+thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, P7_TARGETCACHE *tcache, int n_targetseqs)
 {
   int  status  = eslOK;
   int  sstatus = eslOK;
   int  eofCount = 0;
+  int64_t       tpos = 0;      /* next cached target seq, with <tcache> */
   ESL_SQ_BLOCK *block;
   void         *newBlock;
 
@@ -1341,6 +1436,9 @@ thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, int n_tar
       {
         block->count = 0;
         sstatus = eslEOF;
+      } else if (tcache) {
+        sstatus = p7_targetcache_GetBlock(tcache, &tpos, block);
+        n_targetseqs -= block->count;
       } else {
         sstatus = esl_sqio_ReadBlock(dbfp, block, -1, n_targetseqs, /*max_init_window=*/FALSE, FALSE);
         n_targetseqs -= block->count;
@@ -1403,14 +1501,8 @@ pipeline_thread(void *arg)
 	{
 	  ESL_SQ *dbsq = block->list + i;
 
-	  p7_pli_NewSeq(info->pli, dbsq);
-	  p7_bg_SetLength(info->bg, dbsq->n);
-	  p7_oprofile_ReconfigLength(info->om, dbsq->n);
-	  
-	  p7_Pipeline(info->pli, info->om, info->bg, dbsq, NULL, info->th);
-	  
+	  search_seq(info, dbsq);
 	  esl_sq_Reuse(dbsq);
-	  p7_pipeline_Reuse(info->pli);
 	}
 
       status = esl_workqueue_WorkerUpdate(info->queue, block, &newBlock);
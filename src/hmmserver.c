@@ -30,6 +30,7 @@ static ESL_OPTIONS options[] = {
  { "--cpu",       eslARG_INT,    "0",  NULL, "n>=0",  NULL,  NULL,  NULL,            "# of compute threads per worker. 0 = max possible (default)",         12 },
  { "--stall", 			eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL,      "Stall after start (debugging option)", 12}, 
  { "--password",    eslARG_STRING,  "", NULL, NULL,    NULL,  NULL,  NULL,            "Specify password required to shut down server",  12 },
+ { "--cache_mb",    eslARG_INT,    "256",  NULL, "n>=0",  NULL,  NULL,  NULL,        "MB of memory for caching search results. 0 = no caching",  12 },
   {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 static char usage[]  = "[-options] <sequence database>";
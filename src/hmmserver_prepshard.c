@@ -0,0 +1,44 @@
+//! \file hmmserver_prepshard: writes a sequence database out as a prepared shard file that hmmserver can map into memory at startup
+#include "p7_config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "easel.h"
+#include "esl_getopts.h"
+#include "esl_sq.h"
+
+#include "hmmer.h"
+#include "shard.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range     toggles   reqs   incomp              help                                                      docgroup*/
+  { "-h",           eslARG_NONE,   FALSE, NULL, NULL,    NULL,  NULL,  NULL, "show brief help on version and usage",                         1 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options] <sequence database> <prepared shard file>";
+static char banner[] = "prepare a sequence database for fast loading by hmmserver";
+
+//! Main function for the hmmserver_prepshard program
+/*! Reads the entire database into one shard, exactly as an hmmserver worker node would, and writes it out with p7_shard_Write_prepared().
+ *  Passing the prepared file to hmmserver in place of the original database lets each worker node map its shard into memory
+ *  instead of parsing the database.
+ */
+int main(int argc, char **argv){
+  ESL_GETOPTS *go = p7_CreateDefaultApp(options, 2, argc, argv, banner, usage);
+  char *dbfile  = esl_opt_GetArg(go, 1);
+  char *outfile = esl_opt_GetArg(go, 2);
+
+  // Load the whole database as a single shard; the server divides it into shards when it maps the prepared file
+  P7_SHARD *the_shard = p7_shard_Create_sqdata(dbfile, 1, 0, 0);
+  if(the_shard == NULL){
+    p7_Fail("Unable to read sequence database %s\n", dbfile);
+  }
+
+  p7_shard_Write_prepared(the_shard, outfile);
+  printf("Wrote %lu sequences (%lu residues) from %s to prepared shard file %s\n", the_shard->num_objects, the_shard->total_length, dbfile, outfile);
+
+  p7_shard_Destroy(the_shard);
+  esl_getopts_Destroy(go);
+  return 0;
+}
@@ -14,6 +14,7 @@
 
 #include <arm_neon.h>   /* NEON */
 #include "hmmer.h"
+#include "p7_gbands.h"
 
 /* In calculating Q, the number of vectors we need in a row, we have
  * to make sure there's at least 2, or a striped implementation fails.
@@ -22,6 +23,8 @@
 #define p7O_NQW(M)   ( ESL_MAX(2, ((((M)-1) / 8)  + 1)))   /*  8 words   */
 #define p7O_NQF(M)   ( ESL_MAX(2, ((((M)-1) / 4)  + 1)))   /*  4 floats  */
 
+#define p7O_MSVMAXT  16   /* max # of profiles p7_MSVFilter_multitime() sweeps together */
+
 #define p7O_EXTRA_SB 17    /* see ssvfilter.c for explanation */
 
 
@@ -245,6 +248,46 @@ p7_omx_FSetMDI(const P7_OMX *ox, int s, int i, int k, float val)
 }
 
 
+/* P7_OMXCHK: checkpointed Forward/Backward matrix.
+ *
+ * The SIMD counterpart of <P7_GMXCHK> (see p7_gmxchk.h for the
+ * exegesis of the row layout). Rows dpf[0..R0-1] are reserved: two
+ * Backward rows (also used as temporary Forward rows) and the
+ * Forward row 0. Rows dpf[R0..R0+R-1] are the saved Forward rows of
+ * the "a", "b" and "c" regions. Each row is a striped P7_OMX float
+ * row, [0..Q-1][MDI].
+ *
+ * The specials are kept for every row 0..L in <xmx>, as in a full
+ * P7_OMX, so Forward rows can be recomputed from any saved row.
+ */
+typedef struct p7_omxchk_s {
+  int       M;		/* actual model dimension of current comparison                     */
+  int       L;		/* actual sequence dimension of current comparison                  */
+  int       R;		/* # of saved Forward rows currently in use, excluding R0           */
+
+  int       R0;		/* # of reserved rows: fwd[0], bck[prv,cur]                         */
+  int       Ra;		/* # of rows in "all" region (uncheckpointed)                       */
+  int       Rb;		/* # of rows in "between" region (one incomplete checkpoint block)  */
+  int       Rc;		/* # of rows in "checkpointed" region                               */
+  int       La;		/* residues 1..La are in "all" region                               */
+  int       Lb;		/* residues La+1..La+Lb are in "between" region                     */
+  int       Lc;		/* residues La+Lb+1..L are in "checkpointed" region                 */
+
+  float32x4_t **dpf;	/* row pointers, dpf[0..validR-1]                                  */
+  void     *dp_mem;	/* DP memory that <dpf> rows point into                             */
+  int       allocQ4;	/* row width in float quads: allocQ4*4 >= M                         */
+  int       allocR;	/* allocated size of <dpf>; allocR >= validR                        */
+  int       validR;	/* # of rows pointing at DP memory                                  */
+  int64_t   ncells;	/* allocation size of <dp_mem>, in cells (1 cell = MDI at one k)    */
+  int64_t   ncell_limit;/* recommended limit on <ncells>; may be exceeded ("redlined")      */
+
+  float    *xmx;	/* logically [0.1..L][ENJBCS]; indexed [i*p7X_NXCELLS+s]            */
+  void     *x_mem;	/* X memory before 16-byte alignment                                */
+  int       allocXR;	/* # of rows allocated in <xmx>; allocXR >= L+1                     */
+  float     totscale;	/* log of the product of all Forward scale factors                  */
+} P7_OMXCHK;
+
+
 
 
 /*****************************************************************
@@ -265,6 +308,14 @@ extern int          p7_omx_DumpFBRow(P7_OMX *ox, int logify, int rowi, int width
 
 
 
+/* p7_omxchk.c */
+extern P7_OMXCHK   *p7_omxchk_Create (int allocM, int allocL, int64_t ramlimit);
+extern int          p7_omxchk_GrowTo (P7_OMXCHK *ox, int M, int L);
+extern int          p7_omxchk_FitsFull(const P7_OMXCHK *ox, int M, int L);
+extern size_t       p7_omxchk_Sizeof (const P7_OMXCHK *ox);
+extern int          p7_omxchk_Reuse  (P7_OMXCHK *ox);
+extern void         p7_omxchk_Destroy(P7_OMXCHK *ox);
+
 /* p7_oprofile.c */
 extern P7_OPROFILE *p7_oprofile_Create(int M, const ESL_ALPHABET *abc);
 extern int          p7_oprofile_IsLocal(const P7_OPROFILE *om);
@@ -306,6 +357,12 @@ extern int p7_ForwardParser (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om,
 extern int p7_Backward      (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
 extern int p7_BackwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
 
+/* fwdback_chk.c */
+extern int p7_ForwardCheckpointed        (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMXCHK *ox, float *opt_sc);
+extern int p7_BackwardCheckpointed       (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMXCHK *ox, P7_OMX *pp, P7_GBANDS *bnd, float *opt_sc);
+extern int p7_StochasticTraceCheckpointed(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMXCHK *ox,
+					  P7_TRACE **tr, int ntr);
+
 /* io.c */
 extern int p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om);
 extern int p7_oprofile_ReadMSV (P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_om);
@@ -322,6 +379,7 @@ extern int p7_SSVFilter    (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, fl
 
 /* msvfilter.c */
 extern int p7_MSVFilter           (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+extern int p7_MSVFilter_multitime (const ESL_DSQ *dsq, int L, P7_OPROFILE **oma, int nt, P7_OMX *ox, float *ret_sc);
 extern int p7_SSVFilter_longtarget(const ESL_DSQ *dsq, int L, P7_OPROFILE *om, P7_OMX *ox, const P7_SCOREDATA *msvdata, P7_BG *bg, double P, P7_HMM_WINDOWLIST *windowlist);
 
 
@@ -330,8 +388,9 @@ extern int p7_Null2_ByExpectation(const P7_OPROFILE *om, const P7_OMX *pp, float
 extern int p7_Null2_ByTrace      (const P7_OPROFILE *om, const P7_TRACE *tr, int zstart, int zend, P7_OMX *wrk, float *null2);
 
 /* optacc.c */
-extern int p7_OptimalAccuracy(const P7_OPROFILE *om, const P7_OMX *pp,       P7_OMX *ox, float *ret_e);
-extern int p7_OATrace        (const P7_OPROFILE *om, const P7_OMX *pp, const P7_OMX *ox, P7_TRACE *tr);
+extern int p7_OptimalAccuracy      (const P7_OPROFILE *om, const P7_OMX *pp,                             P7_OMX *ox, float *ret_e);
+extern int p7_OptimalAccuracyBanded(const P7_OPROFILE *om, const P7_OMX *pp, const P7_GBANDS *bnd,       P7_OMX *ox, float *ret_e);
+extern int p7_OATrace              (const P7_OPROFILE *om, const P7_OMX *pp, const P7_OMX *ox,           P7_TRACE *tr);
 
 /* stotrace.c */
 extern int p7_StochasticTrace(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *ox, P7_TRACE *tr);
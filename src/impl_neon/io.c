@@ -465,7 +465,9 @@ p7_oprofile_ReadBlockMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OM_BLOCK *h
  *            This is the second part of a two-part calling sequence.
  *            The <om> here must be the result of a previous
  *            successful <p7_oprofile_ReadMSV()> call on the same
- *            open <hfp>.
+ *            open <hfp>. The pipeline calls it only once per <om>, for the
+ *            first query of a batched hmmscan that passes the MSV
+ *            filter; <om->base_w> is 0 until it has been called.
  *
  * Args:      hfp - open HMM file, from which we've previously
  *                  called <p7_oprofile_ReadMSV()>.
@@ -530,12 +532,12 @@ p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
 
   if (! fread((char *) &n,               sizeof(int),      1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read accession length");
   if (n > 0) {
-    ESL_ALLOC(om->acc, sizeof(char) * (n+1));
+    ESL_REALLOC(om->acc, sizeof(char) * (n+1));
     if (! fread( (char *) om->acc,       sizeof(char),     n+1,         hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read accession");
   }
   if (! fread((char *) &n,               sizeof(int),      1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read description length");
   if (n > 0) {
-    ESL_ALLOC(om->desc, sizeof(char) * (n+1));
+    ESL_REALLOC(om->desc, sizeof(char) * (n+1));
     if (! fread( (char *) om->desc,      sizeof(char),     n+1,         hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read description");
   }
 
@@ -205,6 +205,154 @@ p7_MSVFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float
 
 
 
+/* Function:  p7_MSVFilter_multitime()
+ * Synopsis:  MSV scores of one target for several profiles, in one sweep.
+ *
+ * Purpose:   Calculates MSV filter scores for sequence <dsq> of length
+ *            <L> against each of <nt> optimized profiles <oma[0..nt-1]>,
+ *            streaming the sequence once rather than once per profile.
+ *            The profiles are typically the same query evolved to
+ *            different divergence times; they must all have the same
+ *            length <M>, and must each already be configured for
+ *            length <L>. Scores (in nats) are returned in
+ *            <ret_sc[0..nt-1]>; each is the score <p7_MSVFilter()>
+ *            returns for that profile.
+ *
+ *            Each profile needs its own <Q> vectors of DP row. As many
+ *            profiles as fit in the first row of <ox> (and at most
+ *            <p7O_MSVMAXT>) are swept together; larger sets take more
+ *            than one sweep.
+ *
+ * Args:      dsq     - digital target sequence, 1..L
+ *            L       - length of dsq in residues
+ *            oma     - optimized profiles, 0..nt-1
+ *            nt      - number of profiles
+ *            ox      - DP matrix
+ *            ret_sc  - RETURN: MSV scores (in nats), 0..nt-1
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score of at least one profile overflows
+ *            the limited range; that profile's score is <eslINFINITY>,
+ *            and the others are still valid.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, or if the
+ *            profiles differ in length.
+ */
+int
+p7_MSVFilter_multitime(const ESL_DSQ *dsq, int L, P7_OPROFILE **oma, int nt, P7_OMX *ox, float *ret_sc)
+{
+  uint8x16_t mpv;                    /* previous row values                                       */
+  uint8x16_t xEv;		           /* E state: keeps max for Mk->E as we go                     */
+  uint8x16_t sv;		           /* temp storage of 1 curr row value in progress              */
+  uint8x16_t ceilingv;               /* saturated simd value used to test for overflow            */
+  uint8x16_t zerov;                  /* zero vector, shifted in by vextq_u8()                     */
+  uint8x16_t tempv;                  /* work vector                                               */
+  uint8x16_t biasv[p7O_MSVMAXT];     /* emission bias, per profile                                */
+  uint8x16_t basev[p7O_MSVMAXT];     /* offset for scores, per profile                            */
+  uint8x16_t tjbmv[p7O_MSVMAXT];     /* J/N->B->Mk cost, per profile                              */
+  uint8x16_t tecv[p7O_MSVMAXT];      /* E->C cost, per profile                                    */
+  uint8x16_t xJv[p7O_MSVMAXT];       /* J state, per profile                                      */
+  uint8x16_t xBv[p7O_MSVMAXT];       /* B state, per profile                                      */
+  int      live[p7O_MSVMAXT];      /* TRUE until a profile's score overflows                    */
+  const P7_OPROFILE *om;
+  uint8x16_t *dp;			   /* DP row of the current profile                             */
+  uint8x16_t *rsc;			   /* will point at om->rbv[x] for residue x[i]                 */
+  uint8_t  xJ;
+  int      Q = p7O_NQB(oma[0]->M); /* segment length: # of vectors                              */
+  int      ntb;                    /* # of profiles per sweep                                   */
+  int      nb, nlive;
+  int      t0, t, i, q;
+  int      status = eslOK;
+
+  /* Check that the DP matrix is ok for us; we use its first row, Q vectors per profile. */
+  if (Q > ox->allocQ16)  ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small");
+  for (t = 1; t < nt; t++)
+    if (oma[t]->M != oma[0]->M) ESL_EXCEPTION(eslEINVAL, "profiles of different lengths");
+  ox->M = oma[0]->M;
+  ntb   = ESL_MIN(p7O_MSVMAXT, (ox->allocQ4 * p7X_NSCELLS) / Q);
+
+  zerov    = vmovq_n_u8(0);
+  ceilingv = vceqq_u8(zerov, zerov);
+
+  for (t0 = 0; t0 < nt; t0 += ntb)
+    {
+      nb = nlive = ESL_MIN(ntb, nt - t0);
+
+      /* Initialization, as in p7_MSVFilter(), once per profile. */
+      for (t = 0; t < nb; t++)
+	{
+	  om       = oma[t0+t];
+	  dp       = ox->dpb[0] + t * Q;
+	  for (q = 0; q < Q; q++) dp[q] = vmovq_n_u8(0);
+
+	  biasv[t] = vmovq_n_u8(om->bias_b);
+	  basev[t] = vmovq_n_u8(om->base_b);
+	  tjbmv[t] = vmovq_n_u8(om->tjb_b + om->tbm_b);
+	  tecv[t]  = vmovq_n_u8(om->tec_b);
+	  xJv[t]   = vmovq_n_u8(0);
+	  xBv[t]   = vqsubq_u8(basev[t], tjbmv[t]);
+	  live[t]  = TRUE;
+	}
+
+      for (i = 1; i <= L && nlive > 0; i++)
+	for (t = 0; t < nb; t++)
+	  {
+	    if (! live[t]) continue;
+
+	    om  = oma[t0+t];
+	    dp  = ox->dpb[0] + t * Q;
+	    rsc = om->rbv[dsq[i]];
+	    xEv = vmovq_n_u8(0);
+
+	    mpv = vextq_u8(zerov, dp[Q-1], 15);
+	    for (q = 0; q < Q; q++)
+	      {
+		sv    = vmaxq_u8(mpv, xBv[t]);
+		sv    = vqaddq_u8(sv, biasv[t]);
+		sv    = vqsubq_u8(sv, *rsc);   rsc++;
+		xEv   = vmaxq_u8(xEv, sv);
+
+		mpv   = dp[q];
+		dp[q] = sv;
+	      }
+
+	    /* overflow test; an overflowed profile drops out of the sweep */
+	    tempv = vqaddq_u8(xEv, biasv[t]);
+	    tempv = vceqq_u8(tempv, ceilingv);
+	    if (esl_neon_hmax_u8((esl_neon_128i_t) tempv) != 0)
+	      {
+		ret_sc[t0+t] = eslINFINITY;
+		live[t]      = FALSE;
+		nlive--;
+		status       = eslERANGE;
+		continue;
+	      }
+
+	    /* horizontal max of xEv, broadcast to all elements */
+	    xEv    = vmovq_n_u8(esl_neon_hmax_u8((esl_neon_128i_t) xEv));
+
+	    xEv    = vqsubq_u8(xEv, tecv[t]);
+	    xJv[t] = vmaxq_u8(xJv[t], xEv);
+	    xBv[t] = vmaxq_u8(basev[t], xJv[t]);
+	    xBv[t] = vqsubq_u8(xBv[t], tjbmv[t]);
+	  } /* end loops over profiles t and residues 1..L */
+
+      for (t = 0; t < nb; t++)
+	{
+	  if (! live[t]) continue;
+	  om = oma[t0+t];
+	  xJ = (uint8_t) vgetq_lane_s16(vreinterpretq_s16_u8(xJv[t]), 0);
+	  ret_sc[t0+t]  = ((float) (xJ - om->tjb_b) - (float) om->base_b);
+	  ret_sc[t0+t] /= om->scale_b;
+	  ret_sc[t0+t] -= 3.0; /* that's ~ L \log \frac{L}{L+3}, for our NN,CC,JJ */
+	}
+    }
+  return status;
+}
+/*------------- end, p7_MSVFilter_multitime() -------------------*/
+
+
+
 /* Function:  p7_SSVFilter_longtarget()
  * Synopsis:  Finds windows with SSV scores above some threshold (vewy vewy fast, in limited precision)
  *
@@ -0,0 +1,352 @@
+/* NEON implementation of a checkpointed Forward/Backward matrix.
+ * Derived from P7_GMXCHK; see p7_gmxchk.[ch] for the layout of rows.
+ *
+ * Contents:
+ *   1. The P7_OMXCHK structure.
+ *   2. Internal (static) routines.
+ */
+#include <p7_config.h>
+
+#include <stdio.h>
+#include <math.h>
+
+#include <arm_neon.h>           /* NEON */
+
+#include "easel.h"
+
+#include "hmmer.h"
+#include "impl_neon.h"
+
+static void   set_row_layout  (P7_OMXCHK *ox, int allocL, int maxR);
+static void   set_full        (P7_OMXCHK *ox, int L);
+static void   set_checkpointed(P7_OMXCHK *ox, int L, int R);
+static void   set_redlined    (P7_OMXCHK *ox, int L, double minR);
+
+static double minimum_rows     (int L);
+static double checkpointed_rows(int L, int R);
+
+
+/*****************************************************************
+ * 1. The P7_OMXCHK structure.
+ *****************************************************************/
+
+/* Function:  p7_omxchk_Create()
+ * Synopsis:  Allocate a new checkpointed Forward/Backward matrix.
+ *
+ * Purpose:   Allocate a new <P7_OMXCHK> sufficient to hold the
+ *            checkpointed Forward and two-row Backward matrices for
+ *            a comparison of a model of length up to <allocM> to a
+ *            target sequence of length up to <allocL>.
+ *
+ *            Try to keep the main DP memory within <ramlimit> bytes,
+ *            as <p7_gmxchk_Create()> does: if a full matrix fits, no
+ *            rows are checkpointed at all; if even a fully
+ *            checkpointed matrix doesn't fit, the limit is exceeded
+ *            ("redlined") for this comparison, and a later
+ *            <p7_omxchk_GrowTo()> brings the allocation back down.
+ *            The special states (<xmx>) are always kept for all
+ *            <L+1> rows, outside the limit; they are $O(L)$.
+ *
+ *            Each thread has its own matrix, so choose <ramlimit>
+ *            with the number of threads in mind.
+ *
+ * Returns:   ptr to the new <P7_OMXCHK>.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+P7_OMXCHK *
+p7_omxchk_Create(int allocM, int allocL, int64_t ramlimit)
+{
+  P7_OMXCHK *ox = NULL;
+  int        maxR;
+  int        r;
+  int        status;
+
+  ESL_ALLOC(ox, sizeof(P7_OMXCHK));
+  ox->dpf    = NULL;
+  ox->dp_mem = NULL;
+  ox->x_mem  = NULL;
+  ox->xmx    = NULL;
+
+  ox->R0          = 3;	/* fwd[0]; bck[prv,cur] */
+  ox->allocQ4     = p7O_NQF(allocM);
+  ox->ncell_limit = ramlimit / (sizeof(float) * p7X_NSCELLS);
+  maxR            = (int) (ox->ncell_limit / (int64_t) (ox->allocQ4 * 4));
+  set_row_layout(ox, allocL, maxR);
+  ox->allocR      = ox->R0 + ox->Ra + ox->Rb + ox->Rc;
+  ox->validR      = ox->allocR;
+  ox->ncells      = (int64_t) ox->allocR * (int64_t) ox->allocQ4 * 4;
+
+  ESL_ALLOC(ox->dp_mem, sizeof(float32x4_t) * (int64_t) ox->allocR * (int64_t) ox->allocQ4 * p7X_NSCELLS + 15); /* +15 for alignment */
+  ESL_ALLOC(ox->dpf,    sizeof(float32x4_t *) * ox->allocR);
+  ox->dpf[0] = (float32x4_t *) ( ( (unsigned long int) ((char *) ox->dp_mem + 15) & (~0xf)));
+  for (r = 1; r < ox->allocR; r++)
+    ox->dpf[r] = ox->dpf[0] + (int64_t) r * (int64_t) ox->allocQ4 * p7X_NSCELLS;
+
+  ox->allocXR = allocL+1;
+  ESL_ALLOC(ox->x_mem, sizeof(float) * ox->allocXR * p7X_NXCELLS + 15);
+  ox->xmx = (float *) ( ( (unsigned long int) ((char *) ox->x_mem + 15) & (~0xf)));
+
+  ox->M        = 0;
+  ox->L        = 0;
+  ox->R        = 0;
+  ox->totscale = 0.0;
+  return ox;
+
+ ERROR:
+  p7_omxchk_Destroy(ox);
+  return NULL;
+}
+
+
+/* Function:  p7_omxchk_GrowTo()
+ * Synopsis:  Resize and lay out a checkpointed matrix for a new comparison.
+ *
+ * Purpose:   Given an existing checkpointed matrix <ox> and the
+ *            dimensions <M>, <L> of a new comparison, reallocate
+ *            <ox> if needed and lay out its rows: full if <L> rows
+ *            fit in the current allocation, else checkpointed. As in
+ *            <p7_gmxchk_GrowTo()>, a redlined matrix is shrunk back
+ *            to its recommended size when the new comparison fits in
+ *            it.
+ *
+ *            The caller must call <p7_omxchk_GrowTo()> before every
+ *            <p7_ForwardCheckpointed()>, even if <M> and <L> haven't
+ *            changed, because the Backward pass uses up the layout.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure. The state of <ox> is
+ *            then undefined, and the caller should not use it.
+ */
+int
+p7_omxchk_GrowTo(P7_OMXCHK *ox, int M, int L)
+{
+  int     W             = p7O_NQF(M) * 4;                       /* row width in cells needed */
+  int     minR_chk      = (int) ceil(minimum_rows(L)) + ox->R0; /* fewest rows that will do  */
+  int     reset_dp_ptrs = FALSE;
+  int     maxR;
+  int     r;
+  int     status;
+
+  /* The X rows are O(L); they only ever grow. */
+  if (L+1 > ox->allocXR)
+    {
+      ESL_REALLOC(ox->x_mem, sizeof(float) * (L+1) * p7X_NXCELLS + 15);
+      ox->allocXR = L+1;
+      ox->xmx     = (float *) ( ( (unsigned long int) ((char *) ox->x_mem + 15) & (~0xf)));
+    }
+
+  /* Are the current main allocations satisfactory? */
+  if (W <= ox->allocQ4*4 && ox->ncells <= ox->ncell_limit)
+    {
+      if      (L + ox->R0 <= ox->validR) { set_full        (ox, L);             goto DONE; }
+      else if (minR_chk   <= ox->validR) { set_checkpointed(ox, L, ox->validR); goto DONE; }
+    }
+
+  /* Do rows need to get wider? */
+  if (W > ox->allocQ4*4)
+    {
+      ox->allocQ4   = W / 4;
+      ox->validR    = (int) (ox->ncells / (int64_t) W);
+      reset_dp_ptrs = TRUE;
+    }
+
+  /* Does <dp_mem> need reallocation, either up or down? */
+  maxR = (int) (ox->ncell_limit / (int64_t) W);
+  if ( (ox->ncells > ox->ncell_limit && minR_chk <= maxR) || /* redlined, and the recommended size will do: shrink */
+       minR_chk > ox->validR)				     /* not enough rows: grow                                 */
+    {
+      set_row_layout(ox, L, maxR);
+      ox->validR = ox->R0 + ox->Ra + ox->Rb + ox->Rc;
+      ox->ncells = (int64_t) ox->validR * (int64_t) W;
+      ESL_REALLOC(ox->dp_mem, sizeof(float32x4_t) * (int64_t) ox->validR * (int64_t) ox->allocQ4 * p7X_NSCELLS + 15);
+      reset_dp_ptrs = TRUE;
+    }
+  else
+    {
+      if (L + ox->R0 <= ox->validR) set_full(ox, L);
+      else                          set_checkpointed(ox, L, ox->validR);
+    }
+
+  if (ox->validR > ox->allocR)
+    {
+      ESL_REALLOC(ox->dpf, sizeof(float32x4_t *) * ox->validR);
+      ox->allocR    = ox->validR;
+      reset_dp_ptrs = TRUE;
+    }
+
+  if (reset_dp_ptrs)
+    {
+      ox->dpf[0] = (float32x4_t *) ( ( (unsigned long int) ((char *) ox->dp_mem + 15) & (~0xf)));
+      for (r = 1; r < ox->validR; r++)
+	ox->dpf[r] = ox->dpf[0] + (int64_t) r * (int64_t) ox->allocQ4 * p7X_NSCELLS;
+    }
+
+ DONE:
+  ox->M = 0;
+  ox->L = 0;
+  ox->R = 0;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+/* Function:  p7_omxchk_FitsFull()
+ * Synopsis:  Does a comparison fit in a full matrix, within the RAM limit?
+ *
+ * Purpose:   Returns TRUE if a comparison of a model of length <M> to
+ *            a sequence of length <L> fits in full rows within <ox>'s
+ *            RAM limit, so that <p7_omxchk_GrowTo()> wouldn't need to
+ *            checkpoint; FALSE if it needs checkpointing. The same
+ *            goes for a full <P7_OMX> of that size.
+ *
+ *            Allocates nothing, so the caller can decide whether to
+ *            use <ox> at all before growing it.
+ */
+int
+p7_omxchk_FitsFull(const P7_OMXCHK *ox, int M, int L)
+{
+  return ( (int64_t) (L + ox->R0) * (int64_t) (p7O_NQF(M) * 4) <= ox->ncell_limit ? TRUE : FALSE);
+}
+
+
+/* Function:  p7_omxchk_Sizeof()
+ * Synopsis:  Returns the allocated size of a checkpointed matrix, in bytes.
+ */
+size_t
+p7_omxchk_Sizeof(const P7_OMXCHK *ox)
+{
+  size_t n = sizeof(P7_OMXCHK);
+
+  n += sizeof(float32x4_t)   * (size_t) ox->ncells / 4 * p7X_NSCELLS + 15; /* main DP cells */
+  n += sizeof(float32x4_t *) * ox->allocR;                                /* row ptrs      */
+  n += sizeof(float)    * ox->allocXR * p7X_NXCELLS + 15;            /* specials      */
+  return n;
+}
+
+
+/* Function:  p7_omxchk_Reuse()
+ * Synopsis:  Recycle a checkpointed matrix.
+ *
+ * Purpose:   Reset <ox> for reuse, keeping its allocations. The caller
+ *            still calls <p7_omxchk_GrowTo()> before the next DP
+ *            calculation, to lay out its rows.
+ *
+ * Returns:   <eslOK> on success.
+ */
+int
+p7_omxchk_Reuse(P7_OMXCHK *ox)
+{
+  ox->M        = 0;
+  ox->L        = 0;
+  ox->R        = 0;
+  ox->Ra       = 0;
+  ox->Rb       = 0;
+  ox->Rc       = 0;
+  ox->La       = 0;
+  ox->Lb       = 0;
+  ox->Lc       = 0;
+  ox->totscale = 0.0;
+  return eslOK;
+}
+
+
+/* Function:  p7_omxchk_Destroy()
+ * Synopsis:  Frees a checkpointed matrix.
+ *
+ * Purpose:   Free <ox>, which may be <NULL> or incompletely allocated.
+ */
+void
+p7_omxchk_Destroy(P7_OMXCHK *ox)
+{
+  if (ox)
+    {
+      if (ox->dp_mem) free(ox->dp_mem);
+      if (ox->dpf)    free(ox->dpf);
+      if (ox->x_mem)  free(ox->x_mem);
+      free(ox);
+    }
+}
+/*------------------- end, P7_OMXCHK ----------------------------*/
+
+
+
+/*****************************************************************
+ * 2. Internal routines.
+ *****************************************************************/
+
+/* These are the row layout calculations of p7_gmxchk.c, which has
+ * the full commentary; only the row width differs. <ox->R0> is set,
+ * and <maxR> is the number of rows that fit in the recommended
+ * allocation. The layout is full if all <allocL> rows fit;
+ * checkpointed, using every one of the <maxR> rows, if a
+ * checkpointed matrix fits; otherwise fully checkpointed, needing
+ * more than <maxR> rows ("redlined").
+ */
+static void
+set_row_layout(P7_OMXCHK *ox, int allocL, int maxR)
+{
+  double Rbc      = minimum_rows(allocL);
+  int    minR_chk = ox->R0 + (int) ceil(Rbc);
+  int    minR_all = ox->R0 + allocL;
+
+  if      (minR_all <= maxR) set_full        (ox, allocL);
+  else if (minR_chk <= maxR) set_checkpointed(ox, allocL, maxR);
+  else                       set_redlined    (ox, allocL, Rbc);
+}
+
+static void
+set_full(P7_OMXCHK *ox, int L)
+{
+  ox->Ra = L;
+  ox->Rb = 0;
+  ox->Rc = 0;
+  ox->La = L;
+  ox->Lb = 0;
+  ox->Lc = 0;
+}
+
+static void
+set_checkpointed(P7_OMXCHK *ox, int L, int R)
+{
+  double Rbc = checkpointed_rows(L, R - ox->R0);
+  double Rc  = floor(Rbc);
+
+  ox->Rc = (int) Rc;
+  ox->Rb = (Rbc > Rc ? 1 : 0);
+  ox->Ra = R - ox->Rb - ox->Rc - ox->R0;
+  ox->Lc = ((ox->Rc + 2) * (ox->Rc + 1)) / 2 - 1;
+  ox->La = ox->Ra;
+  ox->Lb = L - ox->La - ox->Lc;
+}
+
+static void
+set_redlined(P7_OMXCHK *ox, int L, double minR)
+{
+  double Rc = floor(minR);
+
+  ox->Rc = (int) Rc;
+  ox->Rb = (minR > Rc ? 1 : 0);
+  ox->Ra = 0;
+  ox->Lc = ((ox->Rc + 2) * (ox->Rc + 1)) / 2 - 1;
+  ox->La = 0;
+  ox->Lb = L - ox->La - ox->Lc;
+}
+
+/* Minimum number of rows to checkpoint <L> rows, excluding R0. */
+static double
+minimum_rows(int L)
+{
+  return (sqrt(9. + 8. * (double) L) - 3.) / 2.;
+}
+
+/* Number of checkpointed rows Rb+Rc needed for <L> rows in <R> rows. */
+static double
+checkpointed_rows(int L, int R)
+{
+  return (sqrt(1. + 8. * (double) (L - R)) - 1.) / 2.;
+}
+/*----------------- end, internals ------------------------------*/
@@ -17,6 +17,7 @@
 #include <pmmintrin.h>   /* DENORMAL_MODE */
 #endif
 #include "hmmer.h"
+#include "p7_gbands.h"
 
 /* In calculating Q, the number of vectors we need in a row, we have
  * to make sure there's at least 2, or a striped implementation fails.
@@ -25,8 +26,18 @@
 #define p7O_NQW(M)   ( ESL_MAX(2, ((((M)-1) / 8)  + 1)))   /*  8 words   */
 #define p7O_NQF(M)   ( ESL_MAX(2, ((((M)-1) / 4)  + 1)))   /*  4 floats  */
 
+/* Same, for the wide striping of the AVX2 (w=32) and AVX-512 (w=64)
+ * filters; <w> is the vector width in bytes.
+ */
+#define p7O_NQBW(M,w) ( ESL_MAX(2, ((((M)-1) / (w))     + 1)))   /* w uchars   */
+#define p7O_NQWW(M,w) ( ESL_MAX(2, ((((M)-1) / ((w)/2)) + 1)))   /* w/2 words  */
+
+#define p7O_MSVMAXT  16   /* max # of profiles p7_MSVFilter_multitime() sweeps together */
+
 #define p7O_EXTRA_SB 17    /* see ssvfilter.c for explanation */
 
+#define p7O_FILEALIGN 64   /* vector blocks in pressed .h3f/.h3p files start on 64-byte boundaries */
+
 
 /*****************************************************************
  * 1. P7_OPROFILE: an optimized score profile
@@ -92,6 +103,14 @@ typedef struct p7_oprofile_s {
   int16_t   ddbound_w;    /* threshold precalculated for lazy DD evaluation    */
   float     ncj_roundoff;  /* missing precision on NN,CC,JJ after rounding      */
 
+  /* AVX2/AVX-512 SSV and Viterbi filters: the same scores, restriped into
+   * vectors of 32 or 64 bytes by p7_oprofile_Widen*(); not written to disk   */
+  uint8_t  *sbw;         /* SSV scores [x][0..Q+p7O_EXTRA_SB-1], Q=p7O_NQBW(M,w) */
+  int16_t  *rww;         /* Viterbi match scores [x][0..Q-1], Q=p7O_NQWW(M,w) */
+  int16_t  *tww;         /* Viterbi transition score blocks [8*Q]             */
+  int       wide_b;      /* vector width in bytes of sbw; 0 if not built      */
+  int       wide_w;      /* vector width in bytes of rww, tww; 0 if not built */
+
   /* Forward, Backward use IEEE754 single-precision floats: 4x vectors               */
   __m128 **rfv;         /* [x][q]:  rf, rf[0] are allocated [Kp][Q4]         */
   __m128  *tfv;          /* transition probability blocks    [8*Q4]           */
@@ -104,6 +123,9 @@ typedef struct p7_oprofile_s {
   __m128i  *twv_mem;
   __m128   *tfv_mem;
   __m128   *rfv_mem;
+  void     *sbw_mem;
+  void     *rww_mem;
+  void     *tww_mem;
   
   /* Disk offset information for hmmpfam's fast model retrieval                      */
   off_t  offs[p7_NOFFSETS];     /* p7_{MFP}OFFSET, or -1                             */
@@ -139,6 +161,9 @@ typedef struct p7_oprofile_s {
   int    clone;                 /* this optimized profile structure is just a copy   */
                                 /* of another profile structre.  all pointers of     */
                                 /* this structure should not be freed.               */
+  P7_PRESSMAP *map;             /* if non-NULL, vector blocks and rf/mm/cs/consensus */
+                                /* point into this mapped pressed database, and the  */
+                                /* *_mem pointers are NULL                           */
 } P7_OPROFILE;
 
 typedef struct {
@@ -189,6 +214,9 @@ typedef struct p7_omx_s {
   __m128i **dpw;    /* striped DP matrix for [0,1..L][0..Q-1][MDI], sword vectors  */
   __m128i **dpb;    /* striped DP matrix for [0,1..L][0..Q-1] uchar vectors        */
   void     *dp_mem;    /* DP memory shared by <dpb>, <dpw>, <dpf>                     */
+  void     *dpwide;    /* one row [0..Q-1][MDI] of AVX2/AVX-512 sword vectors         */
+  void     *dpwide_mem;  /* <dpwide> memory before 64-byte alignment                    */
+  int       allocWB;   /* size of <dpwide> in bytes                                   */
   int       allocR;    /* current allocated # rows in dp{uf}. allocR >= validR >= L+1 */
   int       validR;    /* current # of rows actually pointing at DP memory            */
   int       allocQ4;    /* current set row width in <dpf> quads:   allocQ4*4 >= M      */
@@ -246,6 +274,46 @@ p7_omx_FSetMDI(const P7_OMX *ox, int s, int i, int k, float val)
   u.p[r]        = val;
   ox->dpf[i][q] = u.v;
 }
+
+
+/* P7_OMXCHK: checkpointed Forward/Backward matrix.
+ *
+ * The SIMD counterpart of <P7_GMXCHK> (see p7_gmxchk.h for the
+ * exegesis of the row layout). Rows dpf[0..R0-1] are reserved: two
+ * Backward rows (also used as temporary Forward rows) and the
+ * Forward row 0. Rows dpf[R0..R0+R-1] are the saved Forward rows of
+ * the "a", "b" and "c" regions. Each row is a striped P7_OMX float
+ * row, [0..Q-1][MDI].
+ *
+ * The specials are kept for every row 0..L in <xmx>, as in a full
+ * P7_OMX, so Forward rows can be recomputed from any saved row.
+ */
+typedef struct p7_omxchk_s {
+  int       M;		/* actual model dimension of current comparison                     */
+  int       L;		/* actual sequence dimension of current comparison                  */
+  int       R;		/* # of saved Forward rows currently in use, excluding R0           */
+
+  int       R0;		/* # of reserved rows: fwd[0], bck[prv,cur]                         */
+  int       Ra;		/* # of rows in "all" region (uncheckpointed)                       */
+  int       Rb;		/* # of rows in "between" region (one incomplete checkpoint block)  */
+  int       Rc;		/* # of rows in "checkpointed" region                               */
+  int       La;		/* residues 1..La are in "all" region                               */
+  int       Lb;		/* residues La+1..La+Lb are in "between" region                     */
+  int       Lc;		/* residues La+Lb+1..L are in "checkpointed" region                 */
+
+  __m128  **dpf;	/* row pointers, dpf[0..validR-1]                                  */
+  void     *dp_mem;	/* DP memory that <dpf> rows point into                             */
+  int       allocQ4;	/* row width in float quads: allocQ4*4 >= M                         */
+  int       allocR;	/* allocated size of <dpf>; allocR >= validR                        */
+  int       validR;	/* # of rows pointing at DP memory                                  */
+  int64_t   ncells;	/* allocation size of <dp_mem>, in cells (1 cell = MDI at one k)    */
+  int64_t   ncell_limit;/* recommended limit on <ncells>; may be exceeded ("redlined")      */
+
+  float    *xmx;	/* logically [0.1..L][ENJBCS]; indexed [i*p7X_NXCELLS+s]            */
+  void     *x_mem;	/* X memory before 16-byte alignment                                */
+  int       allocXR;	/* # of rows allocated in <xmx>; allocXR >= L+1                     */
+  float     totscale;	/* log of the product of all Forward scale factors                  */
+} P7_OMXCHK;
   
 
 
@@ -268,8 +336,17 @@ extern int          p7_omx_DumpFBRow(P7_OMX *ox, int logify, int rowi, int width
 
 
 
+/* p7_omxchk.c */
+extern P7_OMXCHK   *p7_omxchk_Create (int allocM, int allocL, int64_t ramlimit);
+extern int          p7_omxchk_GrowTo (P7_OMXCHK *ox, int M, int L);
+extern int          p7_omxchk_FitsFull(const P7_OMXCHK *ox, int M, int L);
+extern size_t       p7_omxchk_Sizeof (const P7_OMXCHK *ox);
+extern int          p7_omxchk_Reuse  (P7_OMXCHK *ox);
+extern void         p7_omxchk_Destroy(P7_OMXCHK *ox);
+
 /* p7_oprofile.c */
 extern P7_OPROFILE *p7_oprofile_Create(int M, const ESL_ALPHABET *abc);
+extern P7_OPROFILE *p7_oprofile_CreateMapped(int allocM, const ESL_ALPHABET *abc, P7_PRESSMAP *map);
 extern int          p7_oprofile_IsLocal(const P7_OPROFILE *om);
 extern void         p7_oprofile_Destroy(P7_OPROFILE *om);
 extern size_t       p7_oprofile_Sizeof(P7_OPROFILE *om);
@@ -281,6 +358,10 @@ extern int          p7_oprofile_UpdateMSVEmissionScores(P7_OPROFILE *om, P7_BG *
 
 
 extern int          p7_oprofile_Convert(const P7_PROFILE *gm, P7_OPROFILE *om);
+extern int          p7_simd_Width(void);
+extern int          p7_oprofile_Widen   (P7_OPROFILE *om, int width);
+extern int          p7_oprofile_WidenMSV(P7_OPROFILE *om, int width);
+extern int          p7_oprofile_WidenVF (P7_OPROFILE *om, int width);
 extern int          p7_oprofile_ReconfigLength    (P7_OPROFILE *om, int L);
 extern int          p7_oprofile_ReconfigMSVLength (P7_OPROFILE *om, int L);
 extern int          p7_oprofile_ReconfigRestLength(P7_OPROFILE *om, int L);
@@ -309,6 +390,12 @@ extern int p7_ForwardParser (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om,
 extern int p7_Backward      (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
 extern int p7_BackwardParser(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *fwd, P7_OMX *bck, float *opt_sc);
 
+/* fwdback_chk.c */
+extern int p7_ForwardCheckpointed        (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMXCHK *ox, float *opt_sc);
+extern int p7_BackwardCheckpointed       (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMXCHK *ox, P7_OMX *pp, P7_GBANDS *bnd, float *opt_sc);
+extern int p7_StochasticTraceCheckpointed(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMXCHK *ox,
+					  P7_TRACE **tr, int ntr);
+
 /* io.c */
 extern int p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om);
 extern int p7_oprofile_ReadMSV (P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_om);
@@ -320,11 +407,14 @@ extern int p7_oprofile_Position(P7_HMMFILE *hfp, off_t offset);
 extern P7_OM_BLOCK *p7_oprofile_CreateBlock(int size);
 extern void p7_oprofile_DestroyBlock(P7_OM_BLOCK *block);
 
-/* ssvfilter.c */
-extern int p7_SSVFilter    (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc);
+/* ssvfilter.c, ssvfilter_avx.c, ssvfilter_avx512.c */
+extern int     p7_SSVFilter    (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc);
+extern uint8_t p7_SSVFilter_xE_avx   (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om);
+extern uint8_t p7_SSVFilter_xE_avx512(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om);
 
 /* msvfilter.c */
 extern int p7_MSVFilter           (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+extern int p7_MSVFilter_multitime (const ESL_DSQ *dsq, int L, P7_OPROFILE **oma, int nt, P7_OMX *ox, float *ret_sc);
 extern int p7_SSVFilter_longtarget(const ESL_DSQ *dsq, int L, P7_OPROFILE *om, P7_OMX *ox, const P7_SCOREDATA *msvdata, P7_BG *bg, double P, P7_HMM_WINDOWLIST *windowlist);
 
 
@@ -333,14 +423,17 @@ extern int p7_Null2_ByExpectation(const P7_OPROFILE *om, const P7_OMX *pp, float
 extern int p7_Null2_ByTrace      (const P7_OPROFILE *om, const P7_TRACE *tr, int zstart, int zend, P7_OMX *wrk, float *null2);
 
 /* optacc.c */
-extern int p7_OptimalAccuracy(const P7_OPROFILE *om, const P7_OMX *pp,       P7_OMX *ox, float *ret_e);
-extern int p7_OATrace        (const P7_OPROFILE *om, const P7_OMX *pp, const P7_OMX *ox, P7_TRACE *tr);
+extern int p7_OptimalAccuracy      (const P7_OPROFILE *om, const P7_OMX *pp,                             P7_OMX *ox, float *ret_e);
+extern int p7_OptimalAccuracyBanded(const P7_OPROFILE *om, const P7_OMX *pp, const P7_GBANDS *bnd,       P7_OMX *ox, float *ret_e);
+extern int p7_OATrace              (const P7_OPROFILE *om, const P7_OMX *pp, const P7_OMX *ox,           P7_TRACE *tr);
 
 /* stotrace.c */
 extern int p7_StochasticTrace(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, const P7_OMX *ox, P7_TRACE *tr);
 
-/* vitfilter.c */
+/* vitfilter.c, vitfilter_avx.c, vitfilter_avx512.c */
 extern int p7_ViterbiFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+extern int p7_ViterbiFilter_avx   (const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
+extern int p7_ViterbiFilter_avx512(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc);
 extern int p7_ViterbiFilter_longtarget(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox,
                                         float filtersc, double P, P7_HMM_WINDOWLIST *windowlist);
 
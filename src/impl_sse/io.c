@@ -10,6 +10,14 @@
  * <hmmfile>.h3p, which nominally stand for "H3 filter" and "H3
  * profile".
  * 
+ * Since format 3/g, each block of striped score vectors (sbv, rbv,
+ * twv, rwv, tfv, rfv) starts on a p7O_FILEALIGN (64-byte) file offset
+ * and is stored contiguously, in the same row order as in memory.
+ * When <p7_hmmfile_Open()> has mapped the two files, the readers
+ * point a profile's vectors straight into the mapping instead of
+ * copying them; otherwise they fread() the blocks as before, skipping
+ * the padding.
+ * 
  * Contents:
  *    1. Writing optimized profiles to two files.
  *    2. Reading optimized profiles in two stages.
@@ -43,6 +51,9 @@
 #include "hmmer.h"
 #include "impl_sse.h"
 
+static uint32_t  v3g_fmagic = 0xb3e7e6f3; /* 3/g binary MSV file, SSE:     "3gfs" = 0x 33 67 66 73  + 0x80808080 */
+static uint32_t  v3g_pmagic = 0xb3e7f0f3; /* 3/g binary profile file, SSE: "3gps" = 0x 33 67 70 73  + 0x80808080 */
+
 static uint32_t  v3f_fmagic = 0xb3e6e6f3; /* 3/f binary MSV file, SSE:     "3ffs" = 0x 33 66 66 73  + 0x80808080 */
 static uint32_t  v3f_pmagic = 0xb3e6f0f3; /* 3/f binary profile file, SSE: "3fps" = 0x 33 66 70 73  + 0x80808080 */
 
@@ -60,6 +71,9 @@ static uint32_t  v3b_pmagic = 0xb3e2f0f3; /* 3/b binary profile file, SSE: "3bps
 
 static uint32_t  v3a_fmagic = 0xe8b3e6f3; /* 3/a binary MSV file, SSE:     "h3fs" = 0x 68 33 66 73  + 0x80808080 */
 static uint32_t  v3a_pmagic = 0xe8b3f0f3; /* 3/a binary profile file, SSE: "h3ps" = 0x 68 33 70 73  + 0x80808080 */
+static off_t aligned_offset(off_t offset);
+static int   write_pad (FILE *fp);
+static int   read_block(FILE *fp, char *map, off_t mapsize, int align, void *dest, size_t nbytes, void **ret_p);
 
 
 /*****************************************************************
@@ -94,7 +108,7 @@ p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
   int x;
 
   /* <ffp> is the part of the oprofile that MSVFilter() needs */
-  if (fwrite((char *) &(v3f_fmagic),    sizeof(uint32_t), 1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
+  if (fwrite((char *) &(v3g_fmagic),    sizeof(uint32_t), 1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->M),         sizeof(int),      1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->abc->type), sizeof(int),      1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &n,               sizeof(int),      1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
@@ -107,19 +121,21 @@ p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
   if (fwrite((char *) &(om->base_b),    sizeof(uint8_t),  1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");  
   if (fwrite((char *) &(om->bias_b),    sizeof(uint8_t),  1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");  
 
+  if (write_pad(ffp) != eslOK)                                                                ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   for (x = 0; x < om->abc->Kp; x++)
     if (fwrite( (char *) om->sbv[x],    sizeof(__m128i),  Q16x,        ffp) != Q16x)        ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   
+  if (write_pad(ffp) != eslOK)                                                                ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   for (x = 0; x < om->abc->Kp; x++)
     if (fwrite( (char *) om->rbv[x],    sizeof(__m128i),  Q16,         ffp) != Q16)         ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   
   if (fwrite((char *) om->evparam,      sizeof(float),    p7_NEVPARAM, ffp) != p7_NEVPARAM) ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) om->offs,         sizeof(off_t),    p7_NOFFSETS, ffp) != p7_NOFFSETS) ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) om->compo,        sizeof(float),    p7_MAXABET,  ffp) != p7_MAXABET)  ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
-  if (fwrite((char *) &(v3f_fmagic),    sizeof(uint32_t), 1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed"); /* sentinel */
+  if (fwrite((char *) &(v3g_fmagic),    sizeof(uint32_t), 1,           ffp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed"); /* sentinel */
 
   /* <pfp> gets the rest of the oprofile */
-  if (fwrite((char *) &(v3f_pmagic),    sizeof(uint32_t), 1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
+  if (fwrite((char *) &(v3g_pmagic),    sizeof(uint32_t), 1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->M),         sizeof(int),      1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->abc->type), sizeof(int),      1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &n,               sizeof(int),      1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
@@ -149,7 +165,9 @@ p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
   if (fwrite((char *) om->consensus,    sizeof(char),     om->M+2,     pfp) != om->M+2)     ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
 
   /* ViterbiFilter part */
+  if (write_pad(pfp) != eslOK)                                                                   ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) om->twv,             sizeof(__m128i),  8*Q8,        pfp) != 8*Q8)        ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
+  if (write_pad(pfp) != eslOK)                                                                   ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   for (x = 0; x < om->abc->Kp; x++)
     if (fwrite( (char *) om->rwv[x],       sizeof(__m128i),  Q8,          pfp) != Q8)          ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   for (x = 0; x < p7O_NXSTATES; x++)
@@ -160,7 +178,9 @@ p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
   if (fwrite((char *) &(om->ncj_roundoff), sizeof(float),    1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
 
   /* Forward/Backward part */
+  if (write_pad(pfp) != eslOK)                                                                ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) om->tfv,          sizeof(__m128),   8*Q4,        pfp) != 8*Q4)        ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
+  if (write_pad(pfp) != eslOK)                                                                ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   for (x = 0; x < om->abc->Kp; x++)
     if (fwrite( (char *) om->rfv[x],    sizeof(__m128),   Q4,          pfp) != Q4)          ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   for (x = 0; x < p7O_NXSTATES; x++)
@@ -170,7 +190,7 @@ p7_oprofile_Write(FILE *ffp, FILE *pfp, P7_OPROFILE *om)
   if (fwrite((char *) &(om->nj),        sizeof(float),    1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->mode),      sizeof(int),      1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
   if (fwrite((char *) &(om->L)   ,      sizeof(int),      1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed");
-  if (fwrite((char *) &(v3f_pmagic),    sizeof(uint32_t), 1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed"); /* sentinel */
+  if (fwrite((char *) &(v3g_pmagic),    sizeof(uint32_t), 1,           pfp) != 1)           ESL_EXCEPTION_SYS(eslEWRITE, "oprofile write failed"); /* sentinel */
   return eslOK;
 }
 /*---------------- end, writing oprofile ------------------------*/
@@ -237,6 +257,9 @@ p7_oprofile_ReadMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_o
   int           M, Q16, Q16x;
   int           x,n;
   int           alphatype;
+  char         *fmap  = (hfp->map != NULL ? hfp->map->fmap  : NULL);
+  off_t         fsize = (hfp->map != NULL ? hfp->map->fsize : 0);
+  void         *p;
   int           status;
 
   hfp->errbuf[0] = '\0';  // do NOT touch rr_errbuf[]. In thread parallelization, master is exclusively using ReadMSV, workers are using ReadRest
@@ -252,7 +275,8 @@ p7_oprofile_ReadMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_o
   if (magic == v3c_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/c); please hmmpress your HMM file again");
   if (magic == v3d_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/d); please hmmpress your HMM file again");
   if (magic == v3e_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/e); please hmmpress your HMM file again");
-  if (magic != v3f_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database?");
+  if (magic == v3f_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/f); please hmmpress your HMM file again");
+  if (magic != v3g_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database?");
 
   if (! fread( (char *) &M,         sizeof(int),      1, hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read model size M");
   if (! fread( (char *) &alphatype, sizeof(int),      1, hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read alphabet type");  
@@ -268,8 +292,12 @@ p7_oprofile_ReadMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_o
       ESL_XFAIL(eslEINCOMPAT, hfp->errbuf, "Alphabet type mismatch: was %s, but current profile says %s", 
 		esl_abc_DecodeType(abc->type), esl_abc_DecodeType(alphatype));
   }
-  /* Now we know the sizes of things, so we can allocate. */
-  if ((om = p7_oprofile_Create(M, abc)) == NULL)         ESL_XFAIL(eslEMEM, hfp->errbuf, "allocation failed: oprofile");
+  /* Now we know the sizes of things, so we can allocate. A mapped
+   * database only needs the shell; vectors will point into the map.
+   */
+  if (fmap != NULL) om = p7_oprofile_CreateMapped(M, abc, hfp->map);
+  else              om = p7_oprofile_Create(M, abc);
+  if (om == NULL)                                        ESL_XFAIL(eslEMEM, hfp->errbuf, "allocation failed: oprofile");
   om->M = M;
   om->roff = roff;
 
@@ -284,21 +312,24 @@ p7_oprofile_ReadMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **ret_o
   if (! fread((char *) &(om->scale_b),   sizeof(float),   1,           hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read scale");
   if (! fread((char *) &(om->base_b),    sizeof(uint8_t), 1,           hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read base");
   if (! fread((char *) &(om->bias_b),    sizeof(uint8_t), 1,           hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read bias");
-  for (x = 0; x < abc->Kp; x++)
-    if (! fread((char *) om->sbv[x],     sizeof(__m128i), Q16x,        hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read ssv scores at %d [residue %c]", x, abc->sym[x]); 
-  for (x = 0; x < abc->Kp; x++)
-    if (! fread((char *) om->rbv[x],     sizeof(__m128i), Q16,         hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read msv scores at %d [residue %c]", x, abc->sym[x]); 
+  if (read_block(hfp->ffp, fmap, fsize, TRUE, om->sbv[0], sizeof(__m128i) * Q16x * abc->Kp, &p) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read ssv scores");
+  for (x = 0; x < abc->Kp; x++) om->sbv[x] = (__m128i *) p + x * Q16x;
+  if (read_block(hfp->ffp, fmap, fsize, TRUE, om->rbv[0], sizeof(__m128i) * Q16  * abc->Kp, &p) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read msv scores");
+  for (x = 0; x < abc->Kp; x++) om->rbv[x] = (__m128i *) p + x * Q16;
   if (! fread((char *) om->evparam,      sizeof(float),   p7_NEVPARAM, hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read stat params");
   if (! fread((char *) om->offs,         sizeof(off_t),   p7_NOFFSETS, hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read hmmpfam offsets");
   if (! fread((char *) om->compo,        sizeof(float),   p7_MAXABET,  hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read model composition");
 
   /* record ends with magic sentinel, for detecting binary file corruption */
   if (! fread( (char *) &magic,     sizeof(uint32_t), 1, hfp->ffp))  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "no sentinel magic: .h3f file corrupted?");
-  if (magic != v3f_fmagic)                                           ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad sentinel magic; .h3f file corrupted?");
+  if (magic != v3g_fmagic)                                           ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad sentinel magic; .h3f file corrupted?");
 
   /* keep track of the ending offset of the MSV model */
   om->eoff = ftello(hfp->ffp) - 1;
 
+  /* restripe the SSV scores for the AVX2/AVX-512 filter, if this processor can run it */
+  if (p7_oprofile_WidenMSV(om, p7_simd_Width()) != eslOK) ESL_XFAIL(eslEMEM, hfp->errbuf, "allocation failed: wide ssv scores");
+
   if (byp_abc != NULL) *byp_abc = abc;  /* pass alphabet (whether new or not) back to caller, if caller wanted it */
   *ret_om = om;
   return eslOK;
@@ -373,7 +404,8 @@ p7_oprofile_ReadInfoMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **r
   if (magic == v3c_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/c); please hmmpress your HMM file again");
   if (magic == v3d_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/d); please hmmpress your HMM file again");
   if (magic == v3e_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/e); please hmmpress your HMM file again");
-  if (magic != v3f_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database?");
+  if (magic == v3f_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "binary auxfiles are in an outdated HMMER format (3/f); please hmmpress your HMM file again");
+  if (magic != v3g_fmagic)  ESL_XFAIL(eslEFORMAT, hfp->errbuf, "bad magic; not an HMM database?");
 
   if (! fread( (char *) &M,         sizeof(int),      1, hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read model size M");
   if (! fread( (char *) &alphatype, sizeof(int),      1, hfp->ffp)) ESL_XFAIL(eslEFORMAT, hfp->errbuf, "failed to read alphabet type");  
@@ -400,7 +432,9 @@ p7_oprofile_ReadInfoMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OPROFILE **r
   roff += (sizeof(int) * 5);                      /* magic, model size, alphabet type, max length, name length */
   roff += (sizeof(char) * (n + 1));               /* name string and terminator '\0'                           */
   roff += (sizeof(float) + sizeof(uint8_t) * 5);  /* transition  costs, bias, scale and base                   */
+  roff  = aligned_offset(roff);                   /* padding to the next vector block                         */
   roff += (sizeof(__m128i) * abc->Kp * Q16x);     /* ssv scores                                                */
+  roff  = aligned_offset(roff);                   /* padding to the next vector block                         */
   roff += (sizeof(__m128i) * abc->Kp * Q16);      /* msv scores                                                */
   roff += (sizeof(float) * p7_NEVPARAM);          /* stat params                                               */
   roff += (sizeof(off_t) * p7_NOFFSETS);          /* hmmscan offsets                                           */
@@ -466,7 +500,9 @@ p7_oprofile_ReadBlockMSV(P7_HMMFILE *hfp, ESL_ALPHABET **byp_abc, P7_OM_BLOCK *h
  *            This is the second part of a two-part calling sequence.
  *            The <om> here must be the result of a previous
  *            successful <p7_oprofile_ReadMSV()> call on the same
- *            open <hfp>.
+ *            open <hfp>. The pipeline calls it only once per <om>, for the
+ *            first query of a batched hmmscan that passes the MSV
+ *            filter; <om->base_w> is 0 until it has been called.
  *
  *            In thread-parallel hmmscan, the master is calling
  *            ReadMSV() and multiple workers are calling ReadRest().
@@ -502,6 +538,9 @@ p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
   int           x,n;
   char         *name = NULL;
   int           alphatype;
+  char         *pmap  = (om->map != NULL ? om->map->pmap  : NULL);
+  off_t         psize = (om->map != NULL ? om->map->psize : 0);
+  void         *p;
   int           status;
 
 #ifdef HMMER_THREADS
@@ -526,7 +565,8 @@ p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
   if (magic == v3c_pmagic) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "binary auxfiles are in an outdated HMMER format (3/c); please hmmpress your HMM file again");
   if (magic == v3d_pmagic) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "binary auxfiles are in an outdated HMMER format (3/d); please hmmpress your HMM file again");
   if (magic == v3e_pmagic) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "binary auxfiles are in an outdated HMMER format (3/e); please hmmpress your HMM file again");
-  if (magic != v3f_pmagic) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "bad magic; not an HMM database file?");
+  if (magic == v3f_pmagic) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "binary auxfiles are in an outdated HMMER format (3/f); please hmmpress your HMM file again");
+  if (magic != v3g_pmagic) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "bad magic; not an HMM database file?");
 
   if (! fread( (char *) &M,              sizeof(int),      1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read model size M");
   if (! fread( (char *) &alphatype,      sizeof(int),      1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read alphabet type");  
@@ -540,26 +580,27 @@ p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
   
   if (! fread((char *) &n,               sizeof(int),      1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read accession length");
   if (n > 0) {
-    ESL_ALLOC(om->acc, sizeof(char) * (n+1));
+    ESL_REALLOC(om->acc, sizeof(char) * (n+1));
     if (! fread( (char *) om->acc,       sizeof(char),     n+1,         hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read accession");      
   }
   if (! fread((char *) &n,               sizeof(int),      1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read description length");
   if (n > 0) {
-    ESL_ALLOC(om->desc, sizeof(char) * (n+1));
+    ESL_REALLOC(om->desc, sizeof(char) * (n+1));
     if (! fread( (char *) om->desc,      sizeof(char),     n+1,         hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read description");      
   }
 
-  if (! fread((char *) om->rf,           sizeof(char),     M+2,         hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read rf annotation");
-  if (! fread((char *) om->mm,           sizeof(char),     M+2,         hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read mm annotation");
-  if (! fread((char *) om->cs,           sizeof(char),     M+2,         hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read cs annotation");
-  if (! fread((char *) om->consensus,    sizeof(char),     M+2,         hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read consensus annotation");
+  if (read_block(hfp->pfp, pmap, psize, FALSE, om->rf,        M+2, &p) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read rf annotation");        om->rf        = p;
+  if (read_block(hfp->pfp, pmap, psize, FALSE, om->mm,        M+2, &p) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read mm annotation");        om->mm        = p;
+  if (read_block(hfp->pfp, pmap, psize, FALSE, om->cs,        M+2, &p) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read cs annotation");        om->cs        = p;
+  if (read_block(hfp->pfp, pmap, psize, FALSE, om->consensus, M+2, &p) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read consensus annotation"); om->consensus = p;
 
   Q4  = p7O_NQF(om->M);
   Q8  = p7O_NQW(om->M);
 
-  if (! fread((char *) om->twv,             sizeof(__m128i),  8*Q8,        hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read <tu>, vitfilter transitions");
-  for (x = 0; x < om->abc->Kp; x++)
-    if (! fread( (char *) om->rwv[x],       sizeof(__m128i),  Q8,          hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read <ru>[%d], vitfilter emissions for sym %c", x, om->abc->sym[x]);
+  if (read_block(hfp->pfp, pmap, psize, TRUE, om->twv,    sizeof(__m128i) * 8 * Q8,         &p) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read <tu>, vitfilter transitions");
+  om->twv = p;
+  if (read_block(hfp->pfp, pmap, psize, TRUE, om->rwv[0], sizeof(__m128i) * Q8 * om->abc->Kp, &p) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read <ru>, vitfilter emissions");
+  for (x = 0; x < om->abc->Kp; x++) om->rwv[x] = (__m128i *) p + x * Q8;
   for (x = 0; x < p7O_NXSTATES; x++)
     if (! fread( (char *) om->xw[x],        sizeof(int16_t),  p7O_NXTRANS, hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read <xu>[%d], vitfilter special transitions", x);
   if (! fread((char *) &(om->scale_w),      sizeof(float),    1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read scale_w");
@@ -567,9 +608,10 @@ p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
   if (! fread((char *) &(om->ddbound_w),    sizeof(int16_t),  1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read ddbound_w");
   if (! fread((char *) &(om->ncj_roundoff), sizeof(float),    1,           hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read ddbound_w");
 
-  if (! fread((char *) om->tfv,          sizeof(__m128),   8*Q4,        hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read <tf> transitions");
-  for (x = 0; x < om->abc->Kp; x++)
-    if (! fread( (char *) om->rfv[x],    sizeof(__m128),   Q4,          hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read <rf>[%d] emissions for sym %c", x, om->abc->sym[x]);
+  if (read_block(hfp->pfp, pmap, psize, TRUE, om->tfv,    sizeof(__m128) * 8 * Q4,         &p) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read <tf> transitions");
+  om->tfv = p;
+  if (read_block(hfp->pfp, pmap, psize, TRUE, om->rfv[0], sizeof(__m128) * Q4 * om->abc->Kp, &p) != eslOK) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read <rf> emissions");
+  for (x = 0; x < om->abc->Kp; x++) om->rfv[x] = (__m128 *) p + x * Q4;
   for (x = 0; x < p7O_NXSTATES; x++)
     if (! fread( (char *) om->xf[x],     sizeof(float),    p7O_NXTRANS, hfp->pfp)) ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "failed to read <xf>[%d] special transitions", x);
 
@@ -580,7 +622,10 @@ p7_oprofile_ReadRest(P7_HMMFILE *hfp, P7_OPROFILE *om)
 
   /* record ends with magic sentinel, for detecting binary file corruption */
   if (! fread( (char *) &magic,     sizeof(uint32_t), 1, hfp->pfp))  ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "no sentinel magic: .h3p file corrupted?");
-  if (magic != v3f_pmagic)                                           ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "bad sentinel magic; .h3p file corrupted?");
+  if (magic != v3g_pmagic)                                           ESL_XFAIL(eslEFORMAT, hfp->rr_errbuf, "bad sentinel magic; .h3p file corrupted?");
+
+  /* and the Viterbi filter scores likewise */
+  if (p7_oprofile_WidenVF(om, p7_simd_Width()) != eslOK)             ESL_XFAIL(eslEMEM, hfp->rr_errbuf, "allocation failed: wide vitfilter scores");
 
 #ifdef HMMER_THREADS
   if (hfp->syncRead)
@@ -706,6 +751,67 @@ p7_oprofile_Position(P7_HMMFILE *hfp, off_t offset)
   return eslOK;
 }
 
+/* aligned_offset()
+ * Return <offset> rounded up to the next multiple of p7O_FILEALIGN.
+ */
+static off_t
+aligned_offset(off_t offset)
+{
+  return ((offset + p7O_FILEALIGN - 1) / p7O_FILEALIGN) * p7O_FILEALIGN;
+}
+
+/* write_pad()
+ * Write zeros to binary stream <fp> up to the next p7O_FILEALIGN
+ * file offset, where the next block of score vectors will start.
+ * Returns <eslOK> on success, <eslEWRITE> on failure.
+ */
+static int
+write_pad(FILE *fp)
+{
+  static const char zeros[p7O_FILEALIGN] = { 0 };
+  off_t             here = ftello(fp);
+  size_t            npad;
+
+  if (here < 0) return eslEWRITE;
+  npad = aligned_offset(here) - here;
+  if (npad > 0 && fwrite(zeros, sizeof(char), npad, fp) != npad) return eslEWRITE;
+  return eslOK;
+}
+
+/* read_block()
+ * Read the next <nbytes> block from binary stream <fp>; if <align>
+ * is TRUE, the block starts at the next p7O_FILEALIGN offset, past
+ * the padding that <write_pad()> wrote. If <map> is non-NULL, it is
+ * the whole file mapped into memory (<mapsize> bytes): return a
+ * pointer into it in <*ret_p> and move <fp> past the block without
+ * copying anything. Otherwise fread() the block into <dest> and
+ * return <dest> in <*ret_p>.
+ * Returns <eslOK> on success, <eslEFORMAT> if the file is too short
+ * or can't be repositioned.
+ */
+static int
+read_block(FILE *fp, char *map, off_t mapsize, int align, void *dest, size_t nbytes, void **ret_p)
+{
+  off_t here = ftello(fp);
+
+  if (here < 0) return eslEFORMAT;
+  if (align) here = aligned_offset(here);
+
+  if (map != NULL)
+    {
+      if (here + (off_t) nbytes > mapsize)         return eslEFORMAT;
+      if (fseeko(fp, here + nbytes, SEEK_SET) != 0) return eslEFORMAT;
+      *ret_p = map + here;
+    }
+  else
+    {
+      if (align && fseeko(fp, here, SEEK_SET) != 0) return eslEFORMAT;
+      if (fread(dest, sizeof(char), nbytes, fp) != nbytes) return eslEFORMAT;
+      *ret_p = dest;
+    }
+  return eslOK;
+}
+
 /*-------------------- end, utility routines ---------------------*/
 
 
@@ -848,9 +954,28 @@ utest_ReadWrite(P7_HMM *hmm, P7_OPROFILE *om)
   if ( p7_oprofile_ReadMSV(hfp, &abc, &om2)        != eslOK) esl_fatal(msg);
   if ( p7_oprofile_ReadRest(hfp, om2)              != eslOK) esl_fatal(msg);
 
-  /* 3. it should be identical to the original  */
+  /* 3. it should be identical to the original; if the files were
+   *    mapped, its vectors are aligned in the map, and stay valid 
+   *    after the HMM file is closed.
+   */
+  if ( p7_oprofile_Compare(om, om2, tolerance, errbuf) != eslOK) esl_fatal("%s\n%s", msg, errbuf);
+  if ( hfp->map != NULL) {
+    if (om2->map != hfp->map)                                 esl_fatal(msg);
+    if (((uintptr_t) om2->rbv[0] % p7O_FILEALIGN) != 0)       esl_fatal(msg);
+    if (((uintptr_t) om2->rfv[0] % p7O_FILEALIGN) != 0)       esl_fatal(msg);
+  }
+  p7_hmmfile_Close(hfp);
+  if ( p7_oprofile_Compare(om, om2, tolerance, errbuf) != eslOK) esl_fatal("%s\n%s", msg, errbuf);
+  p7_oprofile_Destroy(om2);
+
+  /* 4. without the map, the same files are read with fread() */
+  if ( p7_hmmfile_Open(tmpfile, NULL, &hfp, NULL)  != eslOK) esl_fatal(msg);
+  p7_hmmfile_ReleaseMap(hfp->map);
+  hfp->map = NULL;
+  if ( p7_oprofile_ReadMSV(hfp, &abc, &om2)        != eslOK) esl_fatal(msg);
+  if ( p7_oprofile_ReadRest(hfp, om2)              != eslOK) esl_fatal(msg);
   if ( p7_oprofile_Compare(om, om2, tolerance, errbuf) != eslOK) esl_fatal("%s\n%s", msg, errbuf);
-       
+
   p7_oprofile_Destroy(om2);
   p7_hmmfile_Close(hfp);
   esl_alphabet_Destroy(abc);
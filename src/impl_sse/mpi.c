@@ -450,6 +450,9 @@ p7_oprofile_MPIUnpack(char *buf, int n, int *pos, MPI_Comm comm, ESL_ALPHABET **
   if (MPI_Unpack(buf, n, pos,  om->cutoff,       p7_NCUTOFFS,          MPI_FLOAT, comm) != 0) ESL_EXCEPTION(eslESYS, "mpi unpack failed");
   if (MPI_Unpack(buf, n, pos,  om->compo,        p7_MAXABET,           MPI_FLOAT, comm) != 0) ESL_EXCEPTION(eslESYS, "mpi unpack failed");
 
+  /* AVX2/AVX-512 filter scores are rebuilt here, not sent */
+  if ((status = p7_oprofile_Widen(om, p7_simd_Width())) != eslOK) goto ERROR;
+
   *ret_om = om;
   return eslOK;
 
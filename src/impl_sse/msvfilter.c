@@ -210,6 +210,160 @@ p7_MSVFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float
 
 
 
+/* Function:  p7_MSVFilter_multitime()
+ * Synopsis:  MSV scores of one target for several profiles, in one sweep.
+ *
+ * Purpose:   Calculates MSV filter scores for sequence <dsq> of length
+ *            <L> against each of <nt> optimized profiles <oma[0..nt-1]>,
+ *            streaming the sequence once rather than once per profile.
+ *            The profiles are typically the same query evolved to
+ *            different divergence times; they must all have the same
+ *            length <M>, and must each already be configured for
+ *            length <L>. Scores (in nats) are returned in
+ *            <ret_sc[0..nt-1]>; each is the score <p7_MSVFilter()>
+ *            returns for that profile.
+ *
+ *            Each profile needs its own <Q> vectors of DP row. As many
+ *            profiles as fit in the first row of <ox> (and at most
+ *            <p7O_MSVMAXT>) are swept together; larger sets take more
+ *            than one sweep.
+ *
+ * Args:      dsq     - digital target sequence, 1..L
+ *            L       - length of dsq in residues
+ *            oma     - optimized profiles, 0..nt-1
+ *            nt      - number of profiles
+ *            ox      - DP matrix
+ *            ret_sc  - RETURN: MSV scores (in nats), 0..nt-1
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score of at least one profile overflows
+ *            the limited range; that profile's score is <eslINFINITY>,
+ *            and the others are still valid.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, or if the
+ *            profiles differ in length.
+ */
+int
+p7_MSVFilter_multitime(const ESL_DSQ *dsq, int L, P7_OPROFILE **oma, int nt, P7_OMX *ox, float *ret_sc)
+{
+  __m128i  mpv;                    /* previous row values                                       */
+  __m128i  xEv;		           /* E state: keeps max for Mk->E as we go                     */
+  __m128i  sv;		           /* temp storage of 1 curr row value in progress              */
+  __m128i  ceilingv;               /* saturated simd value used to test for overflow            */
+  __m128i  tempv;                  /* work vector                                               */
+  __m128i  biasv[p7O_MSVMAXT];     /* emission bias, per profile                                */
+  __m128i  basev[p7O_MSVMAXT];     /* offset for scores, per profile                            */
+  __m128i  tjbmv[p7O_MSVMAXT];     /* J/N->B->Mk cost, per profile                              */
+  __m128i  tecv[p7O_MSVMAXT];      /* E->C cost, per profile                                    */
+  __m128i  xJv[p7O_MSVMAXT];       /* J state, per profile                                      */
+  __m128i  xBv[p7O_MSVMAXT];       /* B state, per profile                                      */
+  int      live[p7O_MSVMAXT];      /* TRUE until a profile's score overflows                    */
+  const P7_OPROFILE *om;
+  __m128i *dp;			   /* DP row of the current profile                             */
+  __m128i *rsc;			   /* will point at om->rbv[x] for residue x[i]                 */
+  uint8_t  xJ;
+  int      Q = p7O_NQB(oma[0]->M); /* segment length: # of vectors                              */
+  int      ntb;                    /* # of profiles per sweep                                   */
+  int      nb, nlive;
+  int      t0, t, i, q;
+  int      status = eslOK;
+
+  /* Check that the DP matrix is ok for us; we use its first row, Q vectors per profile. */
+  if (Q > ox->allocQ16)  ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small");
+  for (t = 1; t < nt; t++)
+    if (oma[t]->M != oma[0]->M) ESL_EXCEPTION(eslEINVAL, "profiles of different lengths");
+  ox->M = oma[0]->M;
+  ntb   = ESL_MIN(p7O_MSVMAXT, (ox->allocQ4 * p7X_NSCELLS) / Q);
+
+  ceilingv = _mm_cmpeq_epi8(_mm_setzero_si128(), _mm_setzero_si128());
+
+  for (t0 = 0; t0 < nt; t0 += ntb)
+    {
+      nb = nlive = ESL_MIN(ntb, nt - t0);
+
+      /* Initialization, as in p7_MSVFilter(), once per profile. */
+      for (t = 0; t < nb; t++)
+	{
+	  om       = oma[t0+t];
+	  dp       = ox->dpb[0] + t * Q;
+	  for (q = 0; q < Q; q++) dp[q] = _mm_setzero_si128();
+
+	  biasv[t] = _mm_set1_epi8((int8_t) om->bias_b);
+	  basev[t] = _mm_set1_epi8((int8_t) om->base_b);
+	  tjbmv[t] = _mm_set1_epi8((int8_t) om->tjb_b + (int8_t) om->tbm_b);
+	  tecv[t]  = _mm_set1_epi8((int8_t) om->tec_b);
+	  xJv[t]   = _mm_setzero_si128();
+	  xBv[t]   = _mm_subs_epu8(basev[t], tjbmv[t]);
+	  live[t]  = TRUE;
+	}
+
+      for (i = 1; i <= L && nlive > 0; i++)
+	for (t = 0; t < nb; t++)
+	  {
+	    if (! live[t]) continue;
+
+	    om  = oma[t0+t];
+	    dp  = ox->dpb[0] + t * Q;
+	    rsc = om->rbv[dsq[i]];
+	    xEv = _mm_setzero_si128();
+
+	    mpv = _mm_slli_si128(dp[Q-1], 1);
+	    for (q = 0; q < Q; q++)
+	      {
+		sv    = _mm_max_epu8(mpv, xBv[t]);
+		sv    = _mm_adds_epu8(sv, biasv[t]);
+		sv    = _mm_subs_epu8(sv, *rsc);   rsc++;
+		xEv   = _mm_max_epu8(xEv, sv);
+
+		mpv   = dp[q];
+		dp[q] = sv;
+	      }
+
+	    /* overflow test; an overflowed profile drops out of the sweep */
+	    tempv = _mm_adds_epu8(xEv, biasv[t]);
+	    tempv = _mm_cmpeq_epi8(tempv, ceilingv);
+	    if (_mm_movemask_epi8(tempv) != 0x0000)
+	      {
+		ret_sc[t0+t] = eslINFINITY;
+		live[t]      = FALSE;
+		nlive--;
+		status       = eslERANGE;
+		continue;
+	      }
+
+	    /* horizontal max of xEv, broadcast to all elements */
+	    tempv = _mm_shuffle_epi32(xEv, _MM_SHUFFLE(2, 3, 0, 1));
+	    xEv   = _mm_max_epu8(xEv, tempv);
+	    tempv = _mm_shuffle_epi32(xEv, _MM_SHUFFLE(0, 1, 2, 3));
+	    xEv   = _mm_max_epu8(xEv, tempv);
+	    tempv = _mm_shufflelo_epi16(xEv, _MM_SHUFFLE(2, 3, 0, 1));
+	    xEv   = _mm_max_epu8(xEv, tempv);
+	    tempv = _mm_srli_si128(xEv, 1);
+	    xEv   = _mm_max_epu8(xEv, tempv);
+	    xEv   = _mm_shuffle_epi32(xEv, _MM_SHUFFLE(0, 0, 0, 0));
+
+	    xEv    = _mm_subs_epu8(xEv, tecv[t]);
+	    xJv[t] = _mm_max_epu8(xJv[t], xEv);
+	    xBv[t] = _mm_max_epu8(basev[t], xJv[t]);
+	    xBv[t] = _mm_subs_epu8(xBv[t], tjbmv[t]);
+	  } /* end loops over profiles t and residues 1..L */
+
+      for (t = 0; t < nb; t++)
+	{
+	  if (! live[t]) continue;
+	  om = oma[t0+t];
+	  xJ = (uint8_t) _mm_extract_epi16(xJv[t], 0);
+	  ret_sc[t0+t]  = ((float) (xJ - om->tjb_b) - (float) om->base_b);
+	  ret_sc[t0+t] /= om->scale_b;
+	  ret_sc[t0+t] -= 3.0; /* that's ~ L \log \frac{L}{L+3}, for our NN,CC,JJ */
+	}
+    }
+  return status;
+}
+/*------------- end, p7_MSVFilter_multitime() -------------------*/
+
+
+
 /* Function:  p7_SSVFilter_longtarget()
  * Synopsis:  Finds windows with SSV scores above some threshold (vewy vewy fast, in limited precision)
  *
@@ -649,6 +803,95 @@ utest_msv_filter(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L,
   p7_profile_Destroy(gm);
   p7_oprofile_Destroy(om);
 }
+
+/* 
+ * p7_MSVFilter_multitime() must give each of <nt> profiles the score
+ * p7_MSVFilter() gives it alone, also when the profiles take more
+ * than one sweep.
+ */
+static void
+utest_msv_multitime(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N, int nt)
+{
+  P7_HMM      *hmm = NULL;
+  P7_PROFILE  *gm  = NULL;
+  P7_OPROFILE **oma = malloc(sizeof(P7_OPROFILE *) * nt);
+  float        *sc  = malloc(sizeof(float) * nt);
+  ESL_DSQ      *dsq = malloc(sizeof(ESL_DSQ) * (L+2));
+  P7_OMX       *ox  = p7_omx_Create(M, 0, 0);
+  float         sc1;
+  int           t;
+
+  for (t = 0; t < nt; t++)
+    {
+      p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &(oma[t]));
+      p7_hmm_Destroy(hmm);
+      p7_profile_Destroy(gm);
+    }
+
+  while (N--)
+    {
+      esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+      p7_MSVFilter_multitime(dsq, L, oma, nt, ox, sc);
+      for (t = 0; t < nt; t++)
+	{
+	  p7_MSVFilter(dsq, L, oma[t], ox, &sc1);
+	  if (sc1 != sc[t]) esl_fatal("msv multitime unit test failed: scores differ (%.2f, %.2f)", sc1, sc[t]);
+	}
+    }
+
+  for (t = 0; t < nt; t++) p7_oprofile_Destroy(oma[t]);
+  free(oma);
+  free(sc);
+  free(dsq);
+  p7_omx_Destroy(ox);
+}
+/* 
+ * The AVX2 and AVX-512 SSV calculation in p7_SSVFilter() must give
+ * exactly what the SSE one does, for each width this processor can
+ * run. Half the targets are emitted by the model, so high scores and
+ * overflows get tested too.
+ */
+static void
+utest_ssv_wide(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  P7_HMM      *hmm  = NULL;
+  P7_PROFILE  *gm   = NULL;
+  P7_OPROFILE *om   = NULL;
+  ESL_SQ      *sq   = esl_sq_CreateDigital(abc);
+  int          width[2] = { 32, 64 };
+  float        sc1, sc2;
+  int          status1, status2;
+  int          w;
+
+  p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om);
+  while (N--)
+    {
+      if (N % 2) p7_ProfileEmit(r, hmm, gm, bg, sq, NULL);
+      else 
+	{
+	  esl_sq_GrowTo(sq, L);
+	  sq->n = 1 + esl_rnd_Roll(r, L);
+	  esl_rsq_xfIID(r, bg->f, abc->K, sq->n, sq->dsq);
+	}
+
+      p7_oprofile_WidenMSV(om, 0);
+      status1 = p7_SSVFilter(sq->dsq, sq->n, om, &sc1);
+      for (w = 0; w < 2; w++)
+	{
+	  if (width[w] > p7_simd_Width()) continue;
+	  p7_oprofile_WidenMSV(om, width[w]);
+	  status2 = p7_SSVFilter(sq->dsq, sq->n, om, &sc2);
+	  if (status1 != status2) esl_fatal("wide ssv unit test failed: %d-byte status %d, SSE %d", width[w], status2, status1);
+	  if (status1 == eslOK && sc1 != sc2) esl_fatal("wide ssv unit test failed: scores differ (%.2f, %.2f)", sc1, sc2);
+	}
+      esl_sq_Reuse(sq);
+    }
+
+  esl_sq_Destroy(sq);
+  p7_hmm_Destroy(hmm);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
 #endif /*p7MSVFILTER_TESTDRIVE*/
 /*-------------------- end, unit tests --------------------------*/
 
@@ -704,6 +947,11 @@ main(int argc, char **argv)
   utest_msv_filter(r, abc, bg, M, L, N);   /* normal sized models */
   utest_msv_filter(r, abc, bg, 1, L, 10);  /* size 1 models       */
   utest_msv_filter(r, abc, bg, M, 1, 10);  /* size 1 sequences    */
+  utest_msv_multitime(r, abc, bg, M, L, N, 5);
+  utest_msv_multitime(r, abc, bg, M, L, 10, 2*p7O_MSVMAXT+1); /* more than one sweep */
+  utest_ssv_wide(r, abc, bg, M,   L, N);   /* AVX2, AVX-512 vs. SSE */
+  utest_ssv_wide(r, abc, bg, 1,   L, 10);
+  utest_ssv_wide(r, abc, bg, 700, L, 10);  /* more than one band    */
 
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
@@ -715,6 +963,11 @@ main(int argc, char **argv)
   utest_msv_filter(r, abc, bg, M, L, N);   
   utest_msv_filter(r, abc, bg, 1, L, 10);  
   utest_msv_filter(r, abc, bg, M, 1, 10);  
+  utest_msv_multitime(r, abc, bg, M, L, N, 5);
+  utest_msv_multitime(r, abc, bg, M, L, 10, 2*p7O_MSVMAXT+1);
+  utest_ssv_wide(r, abc, bg, M,   L, N);
+  utest_ssv_wide(r, abc, bg, 1,   L, 10);
+  utest_ssv_wide(r, abc, bg, 700, L, 10);
 
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
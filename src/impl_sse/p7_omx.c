@@ -26,6 +26,8 @@
 #include "hmmer.h"
 #include "impl_sse.h"
 
+static int omx_wide_size(int allocM);
+
 /*****************************************************************
  * 1. The P7_OMX structure: a dynamic programming matrix
  *****************************************************************/
@@ -72,6 +74,8 @@ p7_omx_Create(int allocM, int allocL, int allocXL)
   ox->dpf    = NULL;
   ox->xmx    = NULL;
   ox->x_mem  = NULL;
+  ox->dpwide     = NULL;
+  ox->dpwide_mem = NULL;
 
   /* DP matrix will be allocated for allocL+1 rows 0,1..L; allocQ4*p7X_NSCELLS columns */
   ox->allocR   = allocL+1;
@@ -100,6 +104,13 @@ p7_omx_Create(int allocM, int allocL, int allocXL)
   ESL_ALLOC(ox->x_mem,  sizeof(float) * ox->allocXR * p7X_NXCELLS + 15); 
   ox->xmx = (float *) ( ( (unsigned long int) ((char *) ox->x_mem  + 15) & (~0xf)));
 
+  /* One row for the AVX2/AVX-512 ViterbiFilter, if this processor can run it */
+  ox->allocWB = omx_wide_size(ox->allocQ4 * 4);
+  if (ox->allocWB > 0) {
+    ESL_ALLOC(ox->dpwide_mem, ox->allocWB + 63);
+    ox->dpwide = (void *) ( ( (unsigned long int) ((char *) ox->dpwide_mem + 63) & (~0x3f)));
+  }
+
   ox->M              = 0;
   ox->L              = 0;
   ox->totscale       = 0.0;
@@ -179,9 +190,17 @@ p7_omx_GrowTo(P7_OMX *ox, int allocM, int allocL, int allocXL)
       reset_row_pointers = TRUE;
     }
 
-  /* must we widen the rows? */
+  /* must we widen the rows? (and the AVX2/AVX-512 ViterbiFilter row with them) */
   if (allocM > ox->allocQ4*4)
-    reset_row_pointers = TRUE;
+    {
+      if (omx_wide_size(nqf * 4) > ox->allocWB)
+	{
+	  ESL_RALLOC(ox->dpwide_mem, p, omx_wide_size(nqf * 4) + 63);
+	  ox->allocWB = omx_wide_size(nqf * 4);
+	  ox->dpwide  = (void *) ( ( (unsigned long int) ((char *) ox->dpwide_mem + 63) & (~0x3f)));
+	}
+      reset_row_pointers = TRUE;
+    }
 
   /* must we set some more valid row pointers? */
   if (allocL >= ox->validR)
@@ -299,9 +318,22 @@ p7_omx_Destroy(P7_OMX *ox)
   if (ox->dpf     != NULL) free(ox->dpf);
   if (ox->dpw     != NULL) free(ox->dpw);
   if (ox->dpb     != NULL) free(ox->dpb);
+  if (ox->dpwide_mem != NULL) free(ox->dpwide_mem);
   free(ox);
   return;
 }
+
+/* omx_wide_size()
+ * Bytes in the one-row DP matrix of the AVX2/AVX-512 ViterbiFilter
+ * for models up to <allocM>, at the widest vectors this processor
+ * runs (see p7_simd_Width()); 0 if it only runs the SSE filters.
+ */
+static int
+omx_wide_size(int allocM)
+{
+  int width = p7_simd_Width();
+  return (width ? p7O_NQWW(allocM, width) * width * p7X_NSCELLS : 0);
+}
 /*------------------- end, P7_OMX structure ---------------------*/
 
 
@@ -32,6 +32,10 @@ static uint8_t unbiased_byteify(P7_OPROFILE *om, float sc);
 static uint8_t biased_byteify(P7_OPROFILE *om, float sc);
 static int16_t wordify(P7_OPROFILE *om, float sc);
 static int     sf_conversion(P7_OPROFILE *om);
+static void    oprofile_init(P7_OPROFILE *om, int allocM, const ESL_ALPHABET *abc);
+static size_t  sbw_size(int allocM, int Kp);
+static size_t  rww_size(int allocM, int Kp);
+static size_t  tww_size(int allocM);
 
 /*****************************************************************
  * 1. The P7_OPROFILE structure: a score profile.
@@ -64,13 +68,20 @@ p7_oprofile_Create(int allocM, const ESL_ALPHABET *abc)
   om->twv_mem = NULL;
   om->rfv_mem = NULL;
   om->tfv_mem = NULL;
+  om->sbw_mem = NULL;
+  om->rww_mem = NULL;
+  om->tww_mem = NULL;
   om->rbv     = NULL;
   om->sbv     = NULL;
   om->rwv     = NULL;
   om->twv     = NULL;
   om->rfv     = NULL;
   om->tfv     = NULL;
+  om->sbw     = NULL;
+  om->rww     = NULL;
+  om->tww     = NULL;
   om->clone   = 0;
+  om->map     = NULL;
 
   /* level 1 */
   ESL_ALLOC(om->rbv_mem, sizeof(__m128i) * nqb  * abc->Kp          +15); /* +15 is for manual 16-byte alignment */
@@ -100,9 +111,104 @@ p7_oprofile_Create(int allocM, const ESL_ALPHABET *abc)
     om->rwv[x] = om->rwv[0] + (x * nqw);
     om->rfv[x] = om->rfv[0] + (x * nqf);
   }
-  om->allocQ16  = nqb;
-  om->allocQ8   = nqw;
-  om->allocQ4   = nqf;
+  /* in a P7_OPROFILE, we always allocate for the optional RF, CS annotation.  
+   * we only rely on the leading \0 to signal that it's unused, but 
+   * we initialize all this memory to zeros to shut valgrind up about 
+   * fwrite'ing uninitialized memory in the io functions.
+   */
+  ESL_ALLOC(om->rf,          sizeof(char) * (allocM+2));
+  ESL_ALLOC(om->mm,          sizeof(char) * (allocM+2));
+  ESL_ALLOC(om->cs,          sizeof(char) * (allocM+2));
+  ESL_ALLOC(om->consensus,   sizeof(char) * (allocM+2));
+  memset(om->rf,       '\0', sizeof(char) * (allocM+2));
+  memset(om->mm,       '\0', sizeof(char) * (allocM+2));
+  memset(om->cs,       '\0', sizeof(char) * (allocM+2));
+  memset(om->consensus,'\0', sizeof(char) * (allocM+2));
+
+  oprofile_init(om, allocM, abc);
+  return om;
+
+ ERROR:
+  p7_oprofile_Destroy(om);
+  return NULL;
+}
+
+/* Function:  p7_oprofile_CreateMapped()
+ * Synopsis:  Allocate an optimized profile shell for a mapped pressed database.
+ *
+ * Purpose:   Allocate an optimized profile of up to <allocM> nodes for
+ *            digital alphabet <abc>, whose score vectors and RF, MM,
+ *            CS, and consensus annotation will be set to point into
+ *            <map>, the mapped binary files of a pressed HMM database,
+ *            rather than being allocated here. Only the structure and
+ *            its arrays of row pointers are allocated. The new profile
+ *            holds a reference to <map>, released by
+ *            <p7_oprofile_Destroy()>.
+ *            
+ *            Used by <p7_oprofile_ReadMSV()>, which fills in the
+ *            pointers.
+ *
+ * Throws:    <NULL> on allocation error.
+ */
+P7_OPROFILE *
+p7_oprofile_CreateMapped(int allocM, const ESL_ALPHABET *abc, P7_PRESSMAP *map)
+{
+  int          status;
+  P7_OPROFILE *om  = NULL;
+
+  ESL_ALLOC(om, sizeof(P7_OPROFILE));
+  om->rbv_mem   = NULL;
+  om->sbv_mem   = NULL;
+  om->rwv_mem   = NULL;
+  om->twv_mem   = NULL;
+  om->rfv_mem   = NULL;
+  om->tfv_mem   = NULL;
+  om->sbw_mem   = NULL;
+  om->rww_mem   = NULL;
+  om->tww_mem   = NULL;
+  om->rbv       = NULL;
+  om->sbv       = NULL;
+  om->rwv       = NULL;
+  om->twv       = NULL;
+  om->rfv       = NULL;
+  om->tfv       = NULL;
+  om->sbw       = NULL;
+  om->rww       = NULL;
+  om->tww       = NULL;
+  om->rf        = NULL;
+  om->mm        = NULL;
+  om->cs        = NULL;
+  om->consensus = NULL;
+  om->clone     = 0;
+  om->map       = NULL;
+
+  ESL_ALLOC(om->rbv, sizeof(__m128i *) * abc->Kp); 
+  ESL_ALLOC(om->sbv, sizeof(__m128i *) * abc->Kp); 
+  ESL_ALLOC(om->rwv, sizeof(__m128i *) * abc->Kp); 
+  ESL_ALLOC(om->rfv, sizeof(__m128  *) * abc->Kp); 
+
+  oprofile_init(om, allocM, abc);
+
+  om->map = map;
+  __atomic_add_fetch(&(map->nref), 1, __ATOMIC_ACQ_REL);
+  return om;
+
+ ERROR:
+  p7_oprofile_Destroy(om);
+  return NULL;
+}
+
+/* oprofile_init()
+ * Initialize the sizes and non-vector fields of a newly allocated <om>.
+ */
+static void
+oprofile_init(P7_OPROFILE *om, int allocM, const ESL_ALPHABET *abc)
+{
+  int x;
+
+  om->allocQ16  = p7O_NQB(allocM);
+  om->allocQ8   = p7O_NQW(allocM);
+  om->allocQ4   = p7O_NQF(allocM);
 
   /* Remaining initializations */
   om->tbm_b     = 0;
@@ -117,6 +223,9 @@ p7_oprofile_Create(int allocM, const ESL_ALPHABET *abc)
   om->ddbound_w    = 0;
   om->ncj_roundoff = 0.0f;	
 
+  om->wide_b       = 0;
+  om->wide_w       = 0;
+
   for (x = 0; x < p7_NOFFSETS; x++) om->offs[x]    = -1;
   for (x = 0; x < p7_NEVPARAM; x++) om->evparam[x] = p7_EVPARAM_UNSET;
   for (x = 0; x < p7_NCUTOFFS; x++) om->cutoff[x]  = p7_CUTOFF_UNSET;
@@ -126,20 +235,6 @@ p7_oprofile_Create(int allocM, const ESL_ALPHABET *abc)
   om->acc       = NULL;
   om->desc      = NULL;
 
-  /* in a P7_OPROFILE, we always allocate for the optional RF, CS annotation.  
-   * we only rely on the leading \0 to signal that it's unused, but 
-   * we initialize all this memory to zeros to shut valgrind up about 
-   * fwrite'ing uninitialized memory in the io functions.
-   */
-  ESL_ALLOC(om->rf,          sizeof(char) * (allocM+2));
-  ESL_ALLOC(om->mm,          sizeof(char) * (allocM+2));
-  ESL_ALLOC(om->cs,          sizeof(char) * (allocM+2));
-  ESL_ALLOC(om->consensus,   sizeof(char) * (allocM+2));
-  memset(om->rf,       '\0', sizeof(char) * (allocM+2));
-  memset(om->mm,       '\0', sizeof(char) * (allocM+2));
-  memset(om->cs,       '\0', sizeof(char) * (allocM+2));
-  memset(om->consensus,'\0', sizeof(char) * (allocM+2));
-
   om->abc        = abc;
   om->L          = 0;
   om->M          = 0;
@@ -147,11 +242,6 @@ p7_oprofile_Create(int allocM, const ESL_ALPHABET *abc)
   om->allocM     = allocM;
   om->mode       = p7_NO_MODE;
   om->nj         = 0.0f;
-  return om;
-
- ERROR:
-  p7_oprofile_Destroy(om);
-  return NULL;
 }
 
 /* Function:  p7_oprofile_IsLocal()
@@ -184,6 +274,9 @@ p7_oprofile_Destroy(P7_OPROFILE *om)
       if (om->twv_mem   != NULL) free(om->twv_mem);
       if (om->rfv_mem   != NULL) free(om->rfv_mem);
       if (om->tfv_mem   != NULL) free(om->tfv_mem);
+      if (om->sbw_mem   != NULL) free(om->sbw_mem);
+      if (om->rww_mem   != NULL) free(om->rww_mem);
+      if (om->tww_mem   != NULL) free(om->tww_mem);
       if (om->rbv       != NULL) free(om->rbv);
       if (om->sbv       != NULL) free(om->sbv);
       if (om->rwv       != NULL) free(om->rwv);
@@ -191,10 +284,15 @@ p7_oprofile_Destroy(P7_OPROFILE *om)
       if (om->name      != NULL) free(om->name);
       if (om->acc       != NULL) free(om->acc);
       if (om->desc      != NULL) free(om->desc);
-      if (om->rf        != NULL) free(om->rf);
-      if (om->mm        != NULL) free(om->mm);
-      if (om->cs        != NULL) free(om->cs);
-      if (om->consensus != NULL) free(om->consensus);
+      if (om->map != NULL)	/* annotation and vectors point into the mapped database */
+	p7_hmmfile_ReleaseMap(om->map);
+      else
+	{
+	  if (om->rf        != NULL) free(om->rf);
+	  if (om->mm        != NULL) free(om->mm);
+	  if (om->cs        != NULL) free(om->cs);
+	  if (om->consensus != NULL) free(om->consensus);
+	}
     }
 
   free(om);
@@ -223,22 +321,29 @@ p7_oprofile_Sizeof(P7_OPROFILE *om)
    * maintainability and clarity.
    */
   n  += sizeof(P7_OPROFILE);
+  if (om->map == NULL) {	/* vectors of a mapped profile are in the mapped file, not the heap */
   n  += sizeof(__m128i) * nqb  * om->abc->Kp +15; /* om->rbv_mem   */
   n  += sizeof(__m128i) * nqs  * om->abc->Kp +15; /* om->sbv_mem   */
   n  += sizeof(__m128i) * nqw  * om->abc->Kp +15; /* om->rwv_mem   */
   n  += sizeof(__m128i) * nqw  * p7O_NTRANS  +15; /* om->twv_mem   */
   n  += sizeof(__m128)  * nqf  * om->abc->Kp +15; /* om->rfv_mem   */
   n  += sizeof(__m128)  * nqf  * p7O_NTRANS  +15; /* om->tfv_mem   */
+  }
+  if (om->sbw_mem != NULL) n += sbw_size(om->allocM, om->abc->Kp) +63; /* om->sbw_mem */
+  if (om->rww_mem != NULL) n += rww_size(om->allocM, om->abc->Kp) +63; /* om->rww_mem */
+  if (om->tww_mem != NULL) n += tww_size(om->allocM)              +63; /* om->tww_mem */
   
   n  += sizeof(__m128i *) * om->abc->Kp;          /* om->rbv       */
   n  += sizeof(__m128i *) * om->abc->Kp;          /* om->sbv       */
   n  += sizeof(__m128i *) * om->abc->Kp;          /* om->rwv       */
   n  += sizeof(__m128  *) * om->abc->Kp;          /* om->rfv       */
   
+  if (om->map == NULL) {
   n  += sizeof(char) * (om->allocM+2);            /* om->rf        */
   n  += sizeof(char) * (om->allocM+2);            /* om->mm        */
   n  += sizeof(char) * (om->allocM+2);            /* om->cs        */
   n  += sizeof(char) * (om->allocM+2);            /* om->consensus */
+  }
 
   return n;
 }
@@ -279,12 +384,19 @@ p7_oprofile_Copy(P7_OPROFILE *om1)
   om2->twv_mem = NULL;
   om2->rfv_mem = NULL;
   om2->tfv_mem = NULL;
+  om2->sbw_mem = NULL;
+  om2->rww_mem = NULL;
+  om2->tww_mem = NULL;
   om2->rbv     = NULL;
   om2->sbv     = NULL;
   om2->rwv     = NULL;
   om2->twv     = NULL;
   om2->rfv     = NULL;
   om2->tfv     = NULL;
+  om2->sbw     = NULL;
+  om2->rww     = NULL;
+  om2->tww     = NULL;
+  om2->map     = NULL;
 
   /* level 1 */
   ESL_ALLOC(om2->rbv_mem, sizeof(__m128i) * nqb  * abc->Kp    +15);	/* +15 is for manual 16-byte alignment */
@@ -381,6 +493,12 @@ p7_oprofile_Copy(P7_OPROFILE *om1)
 
   om2->clone     = om1->clone;
 
+  /* rebuild the AVX2/AVX-512 striping, if <om1> has one */
+  om2->wide_b    = 0;
+  om2->wide_w    = 0;
+  if (p7_oprofile_WidenMSV(om2, om1->wide_b) != eslOK) goto ERROR;
+  if (p7_oprofile_WidenVF (om2, om1->wide_w) != eslOK) goto ERROR;
+
   return om2;
 
  ERROR:
@@ -550,6 +668,7 @@ p7_oprofile_UpdateVitEmissionScores(P7_OPROFILE *om, P7_BG *bg, float *fwd_emiss
     }
   }
 
+  if (om->wide_w) return p7_oprofile_WidenVF(om, om->wide_w);
   return eslOK;
 }
 
@@ -643,6 +762,7 @@ p7_oprofile_UpdateMSVEmissionScores(P7_OPROFILE *om, P7_BG *bg, float *fwd_emiss
 
   sf_conversion(om);
 
+  if (om->wide_b) return p7_oprofile_WidenMSV(om, om->wide_b);
   return eslOK;
 }
 
@@ -1028,6 +1148,7 @@ p7_oprofile_Convert(const P7_PROFILE *gm, P7_OPROFILE *om)
   if ((status =  mf_conversion(gm, om)) != eslOK) return status;   /* MSVFilter()'s information     */
   if ((status =  vf_conversion(gm, om)) != eslOK) return status;   /* ViterbiFilter()'s information */
   if ((status =  fb_conversion(gm, om)) != eslOK) return status;   /* ForwardFilter()'s information */
+  if ((status =  p7_oprofile_Widen(om, p7_simd_Width())) != eslOK) return status; /* AVX2/AVX-512 filters */
 
   if (om->name != NULL) free(om->name);
   if (om->acc  != NULL) free(om->acc); 
@@ -1049,6 +1170,177 @@ p7_oprofile_Convert(const P7_PROFILE *gm, P7_OPROFILE *om)
   return status;
 }
 
+/* Function:  p7_simd_Width()
+ * Synopsis:  Widest filter vectors this build and processor can run.
+ *
+ * Purpose:   Returns the vector width in bytes of the widest SSV and
+ *            Viterbi filter implementation that was compiled in and
+ *            that the processor we're running on supports: 64 for
+ *            AVX-512, 32 for AVX2, or 0 if only the SSE filters can
+ *            be used. <p7_oprofile_Convert()> and the profile input
+ *            routines widen profiles to this width.
+ */
+int
+p7_simd_Width(void)
+{
+  int width = 0;
+
+#ifdef p7ENABLE_AVX
+  if (__builtin_cpu_supports("avx2"))     width = 32;
+#endif
+#ifdef p7ENABLE_AVX512
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) width = 64;
+#endif
+  return width;
+}
+
+/* Function:  p7_oprofile_Widen()
+ * Synopsis:  Build the AVX2/AVX-512 striping of the filter scores.
+ *
+ * Purpose:   Restripe the SSV and ViterbiFilter scores of <om> into
+ *            vectors of <width> bytes: 32 for the AVX2 filters, 64
+ *            for AVX-512, or 0 to use the SSE filters only.
+ *            <p7_SSVFilter()> and <p7_ViterbiFilter()> use the wide
+ *            striping whenever <om> has one.
+ *
+ *            The wide scores are copied from the SSE ones, so this
+ *            must be called again whenever those change; the
+ *            <p7_oprofile_Update*EmissionScores()> functions do so
+ *            themselves. <p7_oprofile_WidenMSV()> and
+ *            <p7_oprofile_WidenVF()> do the two halves separately,
+ *            for profiles that are read in two steps.
+ *
+ *            Caller must be sure the processor supports <width>; see
+ *            <p7_simd_Width()>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <width> isn't 0, 32, or 64.
+ *            <eslEMEM> on allocation failure.
+ */
+int
+p7_oprofile_Widen(P7_OPROFILE *om, int width)
+{
+  int status;
+
+  if ((status = p7_oprofile_WidenMSV(om, width)) != eslOK) return status;
+  if ((status = p7_oprofile_WidenVF (om, width)) != eslOK) return status;
+  return eslOK;
+}
+
+int
+p7_oprofile_WidenMSV(P7_OPROFILE *om, int width)
+{
+  int      Qs = p7O_NQB(om->M);	/* # of SSE vectors in om->sbv[x], before the extra ones */
+  int      Q;			/* # of wide vectors */
+  size_t   stride;		/* bytes per residue in om->sbw */
+  uint8_t *sb;
+  int      x, q, z, k;
+  int      status;
+
+  if (width != 0 && width != 32 && width != 64) ESL_EXCEPTION(eslEINVAL, "no %d-byte filter vectors", width);
+  om->wide_b = 0;
+  if (width == 0) return eslOK;
+  Q = p7O_NQBW(om->M, width);
+
+  if (om->sbw_mem == NULL)
+    {
+      ESL_ALLOC(om->sbw_mem, sbw_size(om->allocM, om->abc->Kp) + 63);
+      om->sbw = (uint8_t *) (((unsigned long int) om->sbw_mem + 63) & (~0x3f));
+    }
+
+  /* Node k+1 goes to byte z of vector q, k = z*Q + q, as in the SSE striping.
+   * Nodes past M get the sbv value of a prohibited (255) cost.
+   */
+  stride = (size_t) (Q + p7O_EXTRA_SB) * width;
+  for (x = 0; x < om->abc->Kp; x++)
+    {
+      sb = om->sbw + x * stride;
+      for (q = 0; q < Q; q++)
+	for (z = 0; z < width; z++)
+	  {
+	    k = z * Q + q;
+	    sb[q*width + z] = (k < om->M) ? ((uint8_t *) om->sbv[x])[(k % Qs) * 16 + k / Qs] : 127;
+	  }
+      for (q = Q; q < Q + p7O_EXTRA_SB; q++)
+	memcpy(sb + q*width, sb + (q % Q) * width, width);
+    }
+  om->wide_b = width;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+int
+p7_oprofile_WidenVF(P7_OPROFILE *om, int width)
+{
+  int      Qs = p7O_NQW(om->M);	/* # of SSE vectors in om->rwv[x] */
+  int      Q;			/* # of wide vectors */
+  int      n  = width / 2;	/* words per vector */
+  int16_t *tsc;
+  int      x, q, z, k, t;
+  int      status;
+
+  if (width != 0 && width != 32 && width != 64) ESL_EXCEPTION(eslEINVAL, "no %d-byte filter vectors", width);
+  om->wide_w = 0;
+  if (width == 0) return eslOK;
+  Q = p7O_NQWW(om->M, width);
+
+  if (om->rww_mem == NULL)
+    {
+      ESL_ALLOC(om->rww_mem, rww_size(om->allocM, om->abc->Kp) + 63);
+      ESL_ALLOC(om->tww_mem, tww_size(om->allocM)              + 63);
+      om->rww = (int16_t *) (((unsigned long int) om->rww_mem + 63) & (~0x3f));
+      om->tww = (int16_t *) (((unsigned long int) om->tww_mem + 63) & (~0x3f));
+    }
+
+  /* Node k+1 goes to word z of vector q, k = z*Q + q. Each entry of twv
+   * already sits in the slot of the node whose DP cell uses it (tBM,
+   * tMM, tIM, tDM are rotated), so all 8 transition blocks restripe
+   * the same way as the emissions. Nodes past M are -32768.
+   */
+  tsc = (int16_t *) om->twv;
+  for (q = 0; q < Q; q++)
+    for (z = 0; z < n; z++)
+      {
+	k = z * Q + q;
+	for (x = 0; x < om->abc->Kp; x++)
+	  om->rww[(x*Q + q) * n + z] = (k < om->M) ? ((int16_t *) om->rwv[x])[(k % Qs) * 8 + k / Qs] : -32768;
+	for (t = 0; t < 7; t++)
+	  om->tww[(q*7 + t) * n + z]   = (k < om->M) ? tsc[((k % Qs) * 7 + t) * 8 + k / Qs]         : -32768;
+	om->tww[(7*Q + q) * n + z]     = (k < om->M) ? tsc[(7*Qs + k % Qs) * 8 + k / Qs]            : -32768;
+      }
+  om->wide_w = width;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+/* sbw_size(), rww_size(), tww_size()
+ * Bytes needed for the wide striping of a profile of up to <allocM>
+ * nodes, at any of the widths; the 64-byte striping is the largest.
+ */
+static size_t
+sbw_size(int allocM, int Kp)
+{
+  return (size_t) (p7O_NQBW(allocM, 64) + p7O_EXTRA_SB) * 64 * Kp;
+}
+
+static size_t
+rww_size(int allocM, int Kp)
+{
+  return (size_t) p7O_NQWW(allocM, 64) * 64 * Kp;
+}
+
+static size_t
+tww_size(int allocM)
+{
+  return (size_t) p7O_NQWW(allocM, 64) * 64 * p7O_NTRANS;
+}
+
+
 /* Function:  p7_oprofile_ReconfigLength()
  * Synopsis:  Set the target sequence length of a model.
  * Incept:    SRE, Thu Dec 20 09:56:40 2007 [Janelia]
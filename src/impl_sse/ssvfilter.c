@@ -885,7 +885,18 @@ p7_SSVFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, float *ret_sc)
     return eslENORESULT;
   }
 
-  xE = get_xE(dsq, L, om);
+  /* Profiles widened for AVX2/AVX-512 (see p7_oprofile_WidenMSV())
+   * compute the same xE with 32 or 64 diagonals per vector.
+   */
+  switch (om->wide_b) {
+#ifdef p7ENABLE_AVX512
+  case 64: xE = p7_SSVFilter_xE_avx512(dsq, L, om); break;
+#endif
+#ifdef p7ENABLE_AVX
+  case 32: xE = p7_SSVFilter_xE_avx   (dsq, L, om); break;
+#endif
+  default: xE = get_xE(dsq, L, om);                  break;
+  }
 
   if (xE >= 255 - om->bias_b)
     {
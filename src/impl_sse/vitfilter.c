@@ -99,6 +99,14 @@ p7_ViterbiFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, f
 
   __m128i negInfv;
 
+  /* Profiles widened for AVX2/AVX-512 (see p7_oprofile_WidenVF()) use the wide versions */
+#ifdef p7ENABLE_AVX512
+  if (om->wide_w == 64) return p7_ViterbiFilter_avx512(dsq, L, om, ox, ret_sc);
+#endif
+#ifdef p7ENABLE_AVX
+  if (om->wide_w == 32) return p7_ViterbiFilter_avx   (dsq, L, om, ox, ret_sc);
+#endif
+
   /* Check that the DP matrix is ok for us. */
   if (Q > ox->allocQ8)                                 ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small");
   if (om->mode != p7_LOCAL && om->mode != p7_UNILOCAL) ESL_EXCEPTION(eslEINVAL, "Fast filter only works for local alignment");
@@ -692,6 +700,55 @@ utest_viterbi_filter(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int
   p7_profile_Destroy(gm);
   p7_oprofile_Destroy(om);
 }
+
+/* The AVX2 and AVX-512 ViterbiFilter() must give exactly the SSE
+ * scores, for each width this processor can run. Half the targets
+ * are emitted by the model, to exercise the lazy F loop and the
+ * overflow check.
+ */
+static void
+utest_viterbi_wide(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  P7_HMM      *hmm = NULL;
+  P7_PROFILE  *gm  = NULL;
+  P7_OPROFILE *om  = NULL;
+  ESL_SQ      *sq  = esl_sq_CreateDigital(abc);
+  P7_OMX      *ox  = p7_omx_Create(M, 0, 0);
+  int          width[2] = { 32, 64 };
+  float        sc1, sc2;
+  int          status1, status2;
+  int          w;
+
+  p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om);
+  while (N--)
+    {
+      if (N % 2) p7_ProfileEmit(r, hmm, gm, bg, sq, NULL);
+      else 
+	{
+	  esl_sq_GrowTo(sq, L);
+	  sq->n = 1 + esl_rnd_Roll(r, L);
+	  esl_rsq_xfIID(r, bg->f, abc->K, sq->n, sq->dsq);
+	}
+
+      p7_oprofile_WidenVF(om, 0);
+      status1 = p7_ViterbiFilter(sq->dsq, sq->n, om, ox, &sc1);
+      for (w = 0; w < 2; w++)
+	{
+	  if (width[w] > p7_simd_Width()) continue;
+	  p7_oprofile_WidenVF(om, width[w]);
+	  status2 = p7_ViterbiFilter(sq->dsq, sq->n, om, ox, &sc2);
+	  if (status1 != status2) esl_fatal("wide viterbi filter unit test failed: %d-byte status %d, SSE %d", width[w], status2, status1);
+	  if (sc1 != sc2)         esl_fatal("wide viterbi filter unit test failed: scores differ (%.2f, %.2f)", sc1, sc2);
+	}
+      esl_sq_Reuse(sq);
+    }
+
+  esl_sq_Destroy(sq);
+  p7_hmm_Destroy(hmm);
+  p7_omx_Destroy(ox);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
 #endif /*p7VITFILTER_TESTDRIVE*/
 
 
@@ -746,6 +803,8 @@ main(int argc, char **argv)
   utest_viterbi_filter(r, abc, bg, M, L, N);   
   utest_viterbi_filter(r, abc, bg, 1, L, 10);  
   utest_viterbi_filter(r, abc, bg, M, 1, 10);  
+  utest_viterbi_wide  (r, abc, bg, M, L, N);   /* AVX2, AVX-512 vs. SSE */
+  utest_viterbi_wide  (r, abc, bg, 1, L, 10);
 
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
@@ -758,6 +817,8 @@ main(int argc, char **argv)
   utest_viterbi_filter(r, abc, bg, M, L, N); 
   utest_viterbi_filter(r, abc, bg, 1, L, 10);
   utest_viterbi_filter(r, abc, bg, M, 1, 10);
+  utest_viterbi_wide  (r, abc, bg, M, L, N);
+  utest_viterbi_wide  (r, abc, bg, 1, L, 10);
 
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
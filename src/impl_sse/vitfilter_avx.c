@@ -0,0 +1,202 @@
+/* Viterbi filter implementation; AVX2 version.
+ * 
+ * This is the SSE ViterbiFilter() of vitfilter.c, widened to 256-bit
+ * vectors of 16 words, with the profile's wide striping (om->rww,
+ * om->tww; see p7_oprofile_Widen()) and the one-row wide DP matrix
+ * in ox->dpwide. The recursion, the lazy F loop and the limited
+ * precision scoring are the same as in vitfilter.c, so the scores
+ * are identical; see there for comments on the algorithm.
+ * 
+ * This file is compiled with AVX2 code generation; its function is
+ * only called when the CPU has AVX2, as decided by
+ * p7_ViterbiFilter().
+ */
+#include <p7_config.h>
+#ifdef p7ENABLE_AVX
+
+#include <math.h>
+
+#include <immintrin.h>		/* AVX2 */
+
+#include "easel.h"
+
+#include "hmmer.h"
+#include "impl_sse.h"
+
+/* Shift a vector of words up by one word, across the 128-bit lanes, and
+ * put -32768 in word 0. (The SSE code does _mm_slli_si128(v, 2) then
+ * ORs in -32768.)
+ */
+static inline __m256i
+avx_lshiftw_neginf(__m256i v, __m256i negInfv)
+{
+  v = _mm256_alignr_epi8(v, _mm256_permute2x128_si256(v, v, 0x08), 14);
+  return _mm256_or_si256(v, negInfv);
+}
+
+static inline int16_t
+avx_hmax_epi16(__m256i v)
+{
+  __m128i x = _mm_max_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  x = _mm_max_epi16(x, _mm_srli_si128(x, 8));
+  x = _mm_max_epi16(x, _mm_srli_si128(x, 4));
+  x = _mm_max_epi16(x, _mm_srli_si128(x, 2));
+  return (int16_t) _mm_extract_epi16(x, 0);
+}
+
+static inline int
+avx_any_gt_epi16(__m256i a, __m256i b)
+{
+  return (_mm256_movemask_epi8(_mm256_cmpgt_epi16(a, b)) != 0);
+}
+
+#define MMXw(q) (dp[(q) * p7X_NSCELLS + p7X_M])
+#define DMXw(q) (dp[(q) * p7X_NSCELLS + p7X_D])
+#define IMXw(q) (dp[(q) * p7X_NSCELLS + p7X_I])
+
+/* Function:  p7_ViterbiFilter_avx()
+ * Synopsis:  Calculates Viterbi score, vewy vewy fast, in limited precision; AVX2 version.
+ *
+ * Purpose:   As <p7_ViterbiFilter()>, for an <om> with the 32-byte
+ *            wide striping (<om->wide_w == 32>). <ox> needs a wide
+ *            row of at least 32 * 3 * <p7O_NQWW(om->M, 32)> bytes.
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score overflows the limited range; in
+ *            this case, this is a high-scoring hit.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, or if
+ *            profile isn't in a local alignment mode. (Must be in local
+ *            alignment mode because that's what helps us guarantee 
+ *            limited dynamic range.)
+ */
+int
+p7_ViterbiFilter_avx(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float *ret_sc)
+{
+  register __m256i mpv, dpv, ipv;  /* previous row values                                       */
+  register __m256i sv;		   /* temp storage of 1 curr row value in progress              */
+  register __m256i dcv;		   /* delayed storage of D(i,q+1)                               */
+  register __m256i xEv;		   /* E state: keeps max for Mk->E as we go                     */
+  register __m256i xBv;		   /* B state: splatted vector of B[i-1] for B->Mk calculations */
+  register __m256i Dmaxv;          /* keeps track of maximum D cell on row                      */
+  int16_t  xE, xB, xC, xJ, xN;	   /* special states' scores                                    */
+  int16_t  Dmax;		   /* maximum D cell score on row                               */
+  int i;			   /* counter over sequence positions 1..L                      */
+  int q;			   /* counter over vectors 0..nq-1                              */
+  int Q        = p7O_NQWW(om->M, 32); /* segment length: # of vectors                          */
+  __m256i *dp  = (__m256i *) ox->dpwide;  /* one row: [0..Q-1][MDI]                                 */
+  const __m256i *rsc;		   /* will point at om->rww for residue x[i]                    */
+  const __m256i *tsc;		   /* will point into (and step thru) om->tww                   */
+  __m256i negInfv;                 /* -32768 in word 0, 0 elsewhere, for an OR after a shift    */
+
+  /* Check that the DP matrix is ok for us. */
+  if (Q * p7X_NSCELLS * 32 > ox->allocWB)              ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small");
+  if (om->mode != p7_LOCAL && om->mode != p7_UNILOCAL) ESL_EXCEPTION(eslEINVAL, "Fast filter only works for local alignment");
+  ox->M   = om->M;
+
+  negInfv = _mm256_setr_epi16(-32768, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+  /* Initialization. In unsigned arithmetic, -infinity is -32768
+   */
+  for (q = 0; q < Q; q++)
+    MMXw(q) = IMXw(q) = DMXw(q) = _mm256_set1_epi16(-32768);
+  xN   = om->base_w;
+  xB   = xN + om->xw[p7O_N][p7O_MOVE];
+  xJ   = -32768;
+  xC   = -32768;
+  xE   = -32768;
+
+  for (i = 1; i <= L; i++)
+    {
+      rsc   = (const __m256i *) om->rww + dsq[i] * Q;
+      tsc   = (const __m256i *) om->tww;
+      dcv   = _mm256_set1_epi16(-32768);      /* "-infinity" */
+      xEv   = _mm256_set1_epi16(-32768);     
+      Dmaxv = _mm256_set1_epi16(-32768);     
+      xBv   = _mm256_set1_epi16(xB);
+
+      mpv = avx_lshiftw_neginf(MMXw(Q-1), negInfv);
+      dpv = avx_lshiftw_neginf(DMXw(Q-1), negInfv);
+      ipv = avx_lshiftw_neginf(IMXw(Q-1), negInfv);
+
+      for (q = 0; q < Q; q++)
+      {
+        /* Calculate new MMXw(i,q); don't store it yet, hold it in sv. */
+        sv   =                    _mm256_adds_epi16(xBv, *tsc);  tsc++;
+        sv   = _mm256_max_epi16 (sv, _mm256_adds_epi16(mpv, *tsc)); tsc++;
+        sv   = _mm256_max_epi16 (sv, _mm256_adds_epi16(ipv, *tsc)); tsc++;
+        sv   = _mm256_max_epi16 (sv, _mm256_adds_epi16(dpv, *tsc)); tsc++;
+        sv   = _mm256_adds_epi16(sv, *rsc);                      rsc++;
+        xEv  = _mm256_max_epi16(xEv, sv);
+
+        /* Load {MDI}(i-1,q) into mpv, dpv, ipv */
+        mpv = MMXw(q);
+        dpv = DMXw(q);
+        ipv = IMXw(q);
+
+        /* Do the delayed stores of {MD}(i,q) now that memory is usable */
+        MMXw(q) = sv;
+        DMXw(q) = dcv;
+
+        /* Calculate the next D(i,q+1) partially: M->D only; delay storage, holding it in dcv */
+        dcv   = _mm256_adds_epi16(sv, *tsc);  tsc++;
+        Dmaxv = _mm256_max_epi16(dcv, Dmaxv);
+
+        /* Calculate and store I(i,q) */
+        sv     =                    _mm256_adds_epi16(mpv, *tsc);  tsc++;
+        IMXw(q)= _mm256_max_epi16 (sv, _mm256_adds_epi16(ipv, *tsc)); tsc++;
+      }
+
+      /* Now the "special" states, which start from Mk->E (->C, ->J->B) */
+      xE = avx_hmax_epi16(xEv);
+      if (xE >= 32767) { *ret_sc = eslINFINITY; return eslERANGE; }	/* immediately detect overflow */
+      xN = xN + om->xw[p7O_N][p7O_LOOP];
+      xC = ESL_MAX(xC + om->xw[p7O_C][p7O_LOOP], xE + om->xw[p7O_E][p7O_MOVE]);
+      xJ = ESL_MAX(xJ + om->xw[p7O_J][p7O_LOOP], xE + om->xw[p7O_E][p7O_LOOP]);
+      xB = ESL_MAX(xJ + om->xw[p7O_J][p7O_MOVE], xN + om->xw[p7O_N][p7O_MOVE]);
+
+      /* Finally the "lazy F" loop (sensu [Farrar07]); see vitfilter.c. */
+      Dmax = avx_hmax_epi16(Dmaxv);
+      if (Dmax + om->ddbound_w > xB) 
+	{
+	  /* Now we're obligated to do at least one complete DD path to be sure. */
+	  /* dcv has carried through from end of q loop above */
+	  dcv = avx_lshiftw_neginf(dcv, negInfv);
+	  tsc = (const __m256i *) om->tww + 7*Q;	/* set tsc to start of the DD's */
+	  for (q = 0; q < Q; q++) 
+	    {
+	      DMXw(q) = _mm256_max_epi16(dcv, DMXw(q));	
+	      dcv     = _mm256_adds_epi16(DMXw(q), *tsc); tsc++;
+	    }
+
+	  /* We may have to do more passes; the check
+	   * is for whether crossing a segment boundary can improve
+	   * our score. 
+	   */
+	  do {
+	    dcv = avx_lshiftw_neginf(dcv, negInfv);
+	    tsc = (const __m256i *) om->tww + 7*Q;	/* set tsc to start of the DD's */
+	    for (q = 0; q < Q; q++) 
+	      {
+		if (! avx_any_gt_epi16(dcv, DMXw(q))) break;
+		DMXw(q) = _mm256_max_epi16(dcv, DMXw(q));	
+		dcv     = _mm256_adds_epi16(DMXw(q), *tsc);   tsc++;
+	      }	    
+	  } while (q == Q);
+	}
+      else  /* not calculating DD? then just store the last M->D vector calc'ed.*/
+	DMXw(0) = avx_lshiftw_neginf(dcv, negInfv);
+    } /* end loop over sequence residues 1..L */
+
+  /* finally C->T */
+  if (xC > -32768)
+    {
+      *ret_sc = (float) xC + (float) om->xw[p7O_C][p7O_MOVE] - (float) om->base_w;
+      *ret_sc /= om->scale_w;
+      *ret_sc -= 3.0; /* the NN/CC/JJ=0,-3nat approximation: see J5/36. */
+    }
+  else  *ret_sc = -eslINFINITY;
+  return eslOK;
+}
+
+#endif /*p7ENABLE_AVX*/
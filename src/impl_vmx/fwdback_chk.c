@@ -0,0 +1,1446 @@
+/* VMX implementation of checkpointed Forward and Backward.
+ *
+ * The same striped, scaled probability-space calculation as
+ * fwdback.c, in a checkpointed matrix (P7_OMXCHK) that takes
+ * O(M \sqrt L) memory instead of O(ML). See generic_fwdback_chk.c
+ * for the generic version, and p7_gmxchk.h for how the rows are laid
+ * out.
+ *
+ * The Forward pass saves checkpointed rows. A linear-memory Backward
+ * pass then recomputes the missing Forward rows one block at a time,
+ * and decodes each row as it goes, into posterior bands and (if
+ * asked) a full posterior decoding matrix; or, instead of the
+ * Backward pass, an ensemble of stochastic traces can be sampled from
+ * the rows in the same order.
+ *
+ * Contents:
+ *   1. Forward: checkpointed fill, Forward score.
+ *   2. Backward: linear-memory back pass, posterior-decoded bands.
+ *   3. Stochastic traceback of an ensemble, from a checkpointed Forward matrix.
+ *   4. Benchmark driver.
+ *   5. Unit tests.
+ *   6. Test driver.
+ */
+#include <p7_config.h>
+
+#include <stdio.h>
+#include <math.h>
+
+#ifndef __APPLE_ALTIVEC__
+#include <altivec.h>
+#endif
+
+#include "easel.h"
+#include "esl_random.h"
+#include "esl_vmx.h"
+#include "esl_vectorops.h"
+
+#include "hmmer.h"
+#include "impl_vmx.h"
+
+static void        forward_row (const ESL_DSQ *dsq, const P7_OPROFILE *om, P7_OMXCHK *ox, const vector float *dpp, vector float *dpc, int i);
+static inline void backward_row(const ESL_DSQ *dsq, const P7_OPROFILE *om, const vector float *dpp, vector float *dpc, int i, float *bx);
+static inline int  posterior_decode_row(const P7_OPROFILE *om, const P7_OMXCHK *ox, const vector float *fwd, const vector float *bck, int i,
+					const float *bx, float scaleproduct, P7_OMX *pp, P7_GBANDS *bnd);
+static int         sample_row  (ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMXCHK *ox, const vector float *dpc, int i,
+				P7_TRACE **tr, int *ti, int ntr);
+
+
+/*****************************************************************
+ * 1. Forward: checkpointed fill, Forward score.
+ *****************************************************************/
+
+/* forward_row()
+ *
+ * Calculates Forward row <i> into <dpc>, from the previous row <dpp>
+ * and the specials of row i-1 in <ox->xmx>; stores the specials
+ * and the scale factor of row <i> in <ox->xmx>. This is one
+ * iteration of the main loop of forward_engine() in fwdback.c.
+ *
+ * Deliberately not inlined: rows are recomputed during the back
+ * pass, and must come out bit-identical to the first time, scaling
+ * decision included, so all callers share the one compiled copy.
+ */
+static void
+forward_row(const ESL_DSQ *dsq, const P7_OPROFILE *om, P7_OMXCHK *ox, const vector float *dpp, vector float *dpc, int i)
+{
+  register vector float mpv, dpv, ipv;     /* previous row values                                       */
+  register vector float sv;                /* temp storage of 1 curr row value in progress              */
+  register vector float dcv;               /* delayed storage of D(i,q+1)                               */
+  register vector float xEv;               /* E state: keeps max for Mk->E as we go                     */
+  register vector float xBv;               /* B state: splatted vector of B[i-1] for B->Mk calculations */
+  vector float  zerov = (vector float) vec_splat_u32(0);
+  float         xN, xE, xB, xC, xJ;        /* special states' scores                                    */
+  int           q;                         /* counter over quads 0..nq-1                                */
+  int           j;                         /* counter over DD iterations (4 is full serialization)      */
+  int           Q     = p7O_NQF(om->M);    /* segment length: # of vectors                              */
+  vector float *rp    = om->rfv[dsq[i]];
+  vector float *tp    = om->tfv;
+  float        *xp    = ox->xmx + (i-1)*p7X_NXCELLS; /* specials of row i-1 */
+
+  xN  = xp[p7X_N];
+  xJ  = xp[p7X_J];
+  xC  = xp[p7X_C];
+  xB  = xp[p7X_B];
+  dcv = (vector float) vec_splat_u32(0);
+  xEv = (vector float) vec_splat_u32(0);
+  xBv = esl_vmx_set_float(xB);
+
+  mpv = vec_sld(zerov, MMO(dpp,Q-1), 12);
+  dpv = vec_sld(zerov, DMO(dpp,Q-1), 12);
+  ipv = vec_sld(zerov, IMO(dpp,Q-1), 12);
+
+  for (q = 0; q < Q; q++)
+    {
+      sv   = (vector float) vec_splat_u32(0);
+      sv   = vec_madd(xBv, *tp, sv);     tp++;
+      sv   = vec_madd(mpv, *tp, sv);     tp++;
+      sv   = vec_madd(ipv, *tp, sv);     tp++;
+      sv   = vec_madd(dpv, *tp, sv);     tp++;
+      sv   = vec_madd(sv,  *rp, zerov);  rp++;
+      xEv  = vec_add(xEv, sv);
+
+      mpv = MMO(dpp,q);
+      dpv = DMO(dpp,q);
+      ipv = IMO(dpp,q);
+
+      MMO(dpc,q) = sv;
+      DMO(dpc,q) = dcv;
+
+      dcv   = vec_madd(sv, *tp, zerov); tp++;
+
+      sv         = vec_madd(mpv, *tp, zerov);  tp++;
+      IMO(dpc,q) = vec_madd(ipv, *tp, sv);     tp++;
+    }
+
+  /* DD paths, as in forward_engine() */
+  dcv        = vec_sld(zerov, dcv, 12);
+  DMO(dpc,0) = zerov;
+  tp         = om->tfv + 7*Q;
+  for (q = 0; q < Q; q++)
+    {
+      DMO(dpc,q) = vec_add(dcv, DMO(dpc,q));
+      dcv        = vec_madd(DMO(dpc,q), *tp, zerov); tp++;
+    }
+
+  if (om->M < 100)
+    {
+      for (j = 1; j < 4; j++)
+	{
+	  dcv = vec_sld(zerov, dcv, 12);
+	  tp  = om->tfv + 7*Q;
+	  for (q = 0; q < Q; q++)
+	    {
+	      DMO(dpc,q) = vec_add(dcv, DMO(dpc,q));
+	      dcv        = vec_madd(dcv, *tp, zerov);   tp++;
+	    }
+	}
+    }
+  else
+    {
+      for (j = 1; j < 4; j++)
+	{
+	  vector bool int cv;
+
+	  dcv = vec_sld(zerov, dcv, 12);
+	  tp  = om->tfv + 7*Q;
+	  cv  = (vector bool int) vec_splat_u32(0);
+	  for (q = 0; q < Q; q++)
+	    {
+	      sv         = vec_add(dcv, DMO(dpc,q));
+	      cv         = vec_or(cv, vec_cmpgt(sv, DMO(dpc,q)));
+	      DMO(dpc,q) = sv;
+	      dcv        = vec_madd(dcv, *tp, zerov);   tp++;
+	    }
+	  if (vec_all_eq(cv, (vector bool int)zerov)) break;
+	}
+    }
+
+  for (q = 0; q < Q; q++) xEv = vec_add(DMO(dpc,q), xEv);
+
+  xE = esl_vmx_hsum_float(xEv);
+
+  xN =  xN * om->xf[p7O_N][p7O_LOOP];
+  xC = (xC * om->xf[p7O_C][p7O_LOOP]) +  (xE * om->xf[p7O_E][p7O_MOVE]);
+  xJ = (xJ * om->xf[p7O_J][p7O_LOOP]) +  (xE * om->xf[p7O_E][p7O_LOOP]);
+  xB = (xJ * om->xf[p7O_J][p7O_MOVE]) +  (xN * om->xf[p7O_N][p7O_MOVE]);
+
+  xp = ox->xmx + i*p7X_NXCELLS;
+  if (xE > 1.0e4)
+    {
+      xN  = xN / xE;
+      xC  = xC / xE;
+      xJ  = xJ / xE;
+      xB  = xB / xE;
+      xEv = esl_vmx_set_float(1.0 / xE);
+      for (q = 0; q < Q; q++)
+	{
+	  MMO(dpc,q) = vec_madd(MMO(dpc,q), xEv, zerov);
+	  DMO(dpc,q) = vec_madd(DMO(dpc,q), xEv, zerov);
+	  IMO(dpc,q) = vec_madd(IMO(dpc,q), xEv, zerov);
+	}
+      xp[p7X_SCALE] = xE;
+      xE = 1.0;
+    }
+  else xp[p7X_SCALE] = 1.0;
+
+  xp[p7X_E] = xE;
+  xp[p7X_N] = xN;
+  xp[p7X_J] = xJ;
+  xp[p7X_B] = xB;
+  xp[p7X_C] = xC;
+}
+
+
+/* Function:  p7_ForwardCheckpointed()
+ * Synopsis:  Forward pass in a checkpointed SIMD DP matrix.
+ *
+ * Purpose:   Compute the Forward pass of a comparison of model <om>
+ *            against digital sequence <dsq> of length <L>, leaving
+ *            a checkpointed Forward matrix in <ox>, and (optionally)
+ *            the Forward score in <opt_sc>, in nats. The score is
+ *            the same as <p7_Forward()>'s.
+ *
+ *            The caller has already laid out <ox> for the
+ *            <om->M> by <L> comparison with <p7_omxchk_Create()> or
+ *            <p7_omxchk_GrowTo()>; it must do so again before each
+ *            new Forward pass, because the Backward pass or the
+ *            stochastic traceback uses up the saved rows.
+ *
+ * Args:      dsq    - digital target sequence, 1..L
+ *            L      - length of dsq in residues
+ *            om     - optimized profile
+ *            ox     - checkpointed DP matrix, laid out for M,L
+ *            opt_sc - optRETURN: Forward lod score in nats
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEINVAL> if <ox> is laid out too small, or if the
+ *            profile isn't in local alignment mode.
+ *            <eslERANGE> if the score exceeds the limited range of
+ *            a probability-space odds ratio.
+ *            In either case, <*opt_sc> is undefined.
+ */
+int
+p7_ForwardCheckpointed(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMXCHK *ox, float *opt_sc)
+{
+  vector float *dpc;                    /* current row  */
+  vector float *dpp;                    /* previous row */
+  vector float  zerov = (vector float) vec_splat_u32(0);
+  float         xC;
+  int           Q     = p7O_NQF(om->M);
+  int           w;                      /* size of a segment of DP rows ended w/ one checkpointed row, inclusive */
+  int           b;                      /* counts down over segment number (Rb+Rc..1)                            */
+  int           i, q;
+
+#if eslDEBUGLEVEL > 0
+  if (om->M > ox->allocQ4*4)                            ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few columns)");
+  if (ox->R0 + ox->Ra + ox->Rb + ox->Rc > ox->validR)   ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few rows)");
+  if (ox->La + ox->Lb + ox->Lc != L)                    ESL_EXCEPTION(eslEINVAL, "DP matrix isn't laid out for length L");
+  if (L >= ox->allocXR)                                 ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small (too few X rows)");
+  if (! p7_oprofile_IsLocal(om))                        ESL_EXCEPTION(eslEINVAL, "Forward implementation makes assumptions that only work for local alignment");
+#endif
+
+  /* Initialization of the zero row, fwd[0], and its specials */
+  dpc = dpp = ox->dpf[ox->R0-1];
+  for (q = 0; q < Q; q++)
+    MMO(dpc,q) = IMO(dpc,q) = DMO(dpc,q) = zerov;
+  ox->xmx[p7X_E]     = 0.;
+  ox->xmx[p7X_N]     = 1.;
+  ox->xmx[p7X_J]     = 0.;
+  ox->xmx[p7X_B]     = om->xf[p7O_N][p7O_MOVE];
+  ox->xmx[p7X_C]     = 0.;
+  ox->xmx[p7X_SCALE] = 1.0;
+  ox->totscale       = 0.0;
+  ox->R              = 0;
+
+  /* "a" region: uncheckpointed rows */
+  for (i = 1; i <= ox->La; i++)
+    {
+      dpc = ox->dpf[ox->R0+ox->R]; ox->R++;
+      forward_row(dsq, om, ox, dpp, dpc, i);
+      if (ox->xmx[i*p7X_NXCELLS+p7X_SCALE] > 1.0) ox->totscale += log(ox->xmx[i*p7X_NXCELLS+p7X_SCALE]);
+      dpp = dpc;
+    }
+
+  /* "b" and "c" regions: partially and fully checkpointed */
+  for (b = ox->Rb + ox->Rc, w = (ox->Rb ? ox->Lb : ox->Rc+1); i <= L; i++)
+    {
+      if (! (--w))
+	{			/* last row in a segment is saved */
+	  dpc = ox->dpf[ox->R0+ox->R]; ox->R++;
+	  w   = b;
+	  b--;
+	}
+      else
+	dpc = ox->dpf[i%2];	/* temp row, 0 or 1 */
+
+      forward_row(dsq, om, ox, dpp, dpc, i);
+      if (ox->xmx[i*p7X_NXCELLS+p7X_SCALE] > 1.0) ox->totscale += log(ox->xmx[i*p7X_NXCELLS+p7X_SCALE]);
+      dpp = dpc;
+    }
+
+  ox->M = om->M;
+  ox->L = L;
+
+  /* see forward_engine() for the reasoning on these range checks */
+  xC = ox->xmx[L*p7X_NXCELLS+p7X_C];
+  if       (isnan(xC))        ESL_EXCEPTION(eslERANGE, "forward score is NaN");
+  else if  (L>0 && xC == 0.0) ESL_EXCEPTION(eslERANGE, "forward score underflow (is 0.0)");
+  else if  (isinf(xC) == 1)   ESL_EXCEPTION(eslERANGE, "forward score overflow (is infinity)");
+
+  if (opt_sc != NULL) *opt_sc = ox->totscale + log(xC * om->xf[p7O_C][p7O_MOVE]);
+  return eslOK;
+}
+/*-------------------- end, forward -----------------------------*/
+
+
+
+/*****************************************************************
+ * 2. Backward: linear-memory back pass, posterior-decoded bands.
+ *****************************************************************/
+
+/* backward_row()
+ *
+ * Calculates Backward row <i> into <dpc> from the next row <dpp>,
+ * and updates the running specials <bx[ENJBC]> from row i+1 to row
+ * i. The row is unscaled; the caller decides its scale factor.
+ * Phases 1-5 of the main loop of backward_engine() in fwdback.c.
+ */
+static inline void
+backward_row(const ESL_DSQ *dsq, const P7_OPROFILE *om, const vector float *dpp, vector float *dpc, int i, float *bx)
+{
+  register vector float mpv, ipv, dpv;
+  register vector float mcv, dcv;
+  register vector float tmmv, timv, tdmv;
+  register vector float xBv;
+  register vector float xEv;
+  vector float  zerov = (vector float) vec_splat_u32(0);
+  int           Q     = p7O_NQF(om->M);
+  int           q, j;
+  vector float *rp    = om->rfv[dsq[i+1]] + Q-1;
+  vector float *tp    = om->tfv + 7*Q - 1;
+  float         xB, xE;
+
+  /* phase 1: B(i) collected; I(i,k) complete, {MD}(i,k) partial */
+  tmmv = vec_sld(om->tfv[1], zerov, 4);
+  timv = vec_sld(om->tfv[2], zerov, 4);
+  tdmv = vec_sld(om->tfv[3], zerov, 4);
+
+  mpv = vec_madd(MMO(dpp,0), om->rfv[dsq[i+1]][0], zerov);
+  mpv = vec_sld(mpv, zerov, 4);
+
+  xBv = zerov;
+  for (q = Q-1; q >= 0; q--)
+    {
+      vector float t1;
+
+      ipv        = IMO(dpp,q);
+      t1         = vec_madd(mpv, timv, zerov);
+      IMO(dpc,q) = vec_madd(ipv, *tp,  t1);            tp--;
+      DMO(dpc,q) = vec_madd(mpv, tdmv, zerov);
+      t1         = vec_madd(mpv, tmmv, zerov);
+      mcv        = vec_madd(ipv, *tp,  t1);            tp -= 2;
+
+      mpv        = vec_madd(MMO(dpp,q), *rp, zerov);  rp--;
+      MMO(dpc,q) = mcv;
+
+      tdmv = *tp;   tp--;
+      timv = *tp;   tp--;
+      tmmv = *tp;   tp--;
+
+      xBv = vec_madd(mpv, *tp, xBv); tp--;
+    }
+
+  /* phase 2: the specials */
+  xB = esl_vmx_hsum_float(xBv);
+
+  bx[p7X_B] = xB;
+  bx[p7X_C] =  bx[p7X_C] * om->xf[p7O_C][p7O_LOOP];
+  bx[p7X_J] = (xB * om->xf[p7O_J][p7O_MOVE]) + (bx[p7X_J] * om->xf[p7O_J][p7O_LOOP]);
+  bx[p7X_N] = (xB * om->xf[p7O_N][p7O_MOVE]) + (bx[p7X_N] * om->xf[p7O_N][p7O_LOOP]);
+  bx[p7X_E] = xE = (bx[p7X_C] * om->xf[p7O_E][p7O_MOVE]) + (bx[p7X_J] * om->xf[p7O_E][p7O_LOOP]);
+  xEv = esl_vmx_set_float(xE);
+
+  /* phase 3: {MD}->E paths and one step of the D->D paths */
+  tp  = om->tfv + 8*Q - 1;
+  dpv = vec_add(DMO(dpc,0), xEv);
+  dpv = vec_sld(dpv, zerov, 4);
+  for (q = Q-1; q >= 1; q--)
+    {
+      dcv        = vec_madd(dpv, *tp, xEv);    tp--;
+      DMO(dpc,q) = vec_add(DMO(dpc,q), dcv);
+      dpv        = DMO(dpc,q);
+      MMO(dpc,q) = vec_add(MMO(dpc,q), xEv);
+    }
+  dcv        = vec_madd(dpv, *tp, zerov);   /* q=0: dcv goes on to phase 4 without xE */
+  DMO(dpc,q) = vec_add(DMO(dpc,q), vec_add(dcv, xEv));
+  MMO(dpc,q) = vec_add(MMO(dpc,q), xEv);
+
+  /* phase 4: finish extending the DD paths */
+  for (j = 1; j < 4; j++)
+    {
+      dcv = vec_sld(dcv, zerov, 4);
+      tp  = om->tfv + 8*Q - 1;
+      for (q = Q-1; q >= 0; q--)
+	{
+	  dcv        = vec_madd(dcv, *tp, zerov); tp--;
+	  DMO(dpc,q) = vec_add(DMO(dpc,q), dcv);
+	}
+    }
+
+  /* phase 5: add M->D paths */
+  dcv = vec_sld(DMO(dpc,0), zerov, 4);
+  tp  = om->tfv + 7*Q - 3;
+  for (q = Q-1; q >= 0; q--)
+    {
+      MMO(dpc,q) = vec_madd(dcv, *tp, MMO(dpc,q)); tp -= 7;
+      dcv        = DMO(dpc,q);
+    }
+}
+
+
+/* backward_row_L()
+ *
+ * Initializes Backward row <L> into <dpc>, and the specials <bx>, as
+ * backward_engine() does; unscaled.
+ */
+static inline void
+backward_row_L(const P7_OPROFILE *om, vector float *dpc, float *bx)
+{
+  vector float  dpv, dcv, xEv;
+  vector float  zerov = (vector float) vec_splat_u32(0);
+  vector float *tp;
+  int           Q     = p7O_NQF(om->M);
+  int           q, j;
+
+  bx[p7X_J] = 0.0;
+  bx[p7X_B] = 0.0;
+  bx[p7X_N] = 0.0;
+  bx[p7X_C] = om->xf[p7O_C][p7O_MOVE];             /* C<-T */
+  bx[p7X_E] = bx[p7X_C] * om->xf[p7O_E][p7O_MOVE]; /* E<-C, no tail */
+  xEv       = esl_vmx_set_float(bx[p7X_E]);
+  for (q = 0; q < Q; q++) MMO(dpc,q) = DMO(dpc,q) = xEv;
+  for (q = 0; q < Q; q++) IMO(dpc,q) = zerov;
+
+  /* DD paths: first segment includes xE, from DMO(q); then three more passes */
+  tp  = om->tfv + 8*Q - 1;
+  dpv = vec_sld(DMO(dpc,Q-1), zerov, 4);
+  for (q = Q-1; q >= 1; q--)
+    {
+      DMO(dpc,q) = vec_madd(dpv, *tp, DMO(dpc,q)); tp--;
+      dpv        = DMO(dpc,q);
+    }
+  dcv        = vec_madd(dpv, *tp, zerov);
+  DMO(dpc,q) = vec_add(DMO(dpc,q), dcv);
+  for (j = 1; j < 4; j++)
+    {
+      tp  = om->tfv + 8*Q - 1;
+      dcv = vec_sld(dcv, zerov, 4);
+      for (q = Q-1; q >= 0; q--)
+	{
+	  dcv        = vec_madd(dcv, *tp, zerov); tp--;
+	  DMO(dpc,q) = vec_add(DMO(dpc,q), dcv);
+	}
+    }
+
+  /* M->D paths */
+  tp  = om->tfv + 7*Q - 3;
+  dcv = vec_sld(DMO(dpc,0), zerov, 4);
+  for (q = Q-1; q >= 0; q--)
+    {
+      MMO(dpc,q) = vec_madd(dcv, *tp, MMO(dpc,q)); tp -= 7;
+      dcv        = DMO(dpc,q);
+    }
+}
+
+
+/* backward_rescale()
+ *
+ * Divides Backward row <dpc> and its specials <bx> by <scale>, if
+ * it's > 1.
+ */
+static inline void
+backward_rescale(const P7_OPROFILE *om, vector float *dpc, float *bx, float scale)
+{
+  vector float zerov = (vector float) vec_splat_u32(0);
+  vector float sv;
+  int          Q     = p7O_NQF(om->M);
+  int          q;
+
+  if (scale > 1.0)
+    {
+      bx[p7X_E] /= scale;
+      bx[p7X_N] /= scale;
+      bx[p7X_J] /= scale;
+      bx[p7X_B] /= scale;
+      bx[p7X_C] /= scale;
+      sv = esl_vmx_set_float(1.0 / scale);
+      for (q = 0; q < Q; q++) {
+	MMO(dpc,q) = vec_madd(MMO(dpc,q), sv, zerov);
+	DMO(dpc,q) = vec_madd(DMO(dpc,q), sv, zerov);
+	IMO(dpc,q) = vec_madd(IMO(dpc,q), sv, zerov);
+      }
+    }
+}
+
+
+/* Function:  p7_BackwardCheckpointed()
+ * Synopsis:  Backward pass in a checkpointed SIMD DP matrix, with posterior bands.
+ *
+ * Purpose:   Given a checkpointed Forward matrix <ox> just filled by
+ *            <p7_ForwardCheckpointed()> for model <om> and sequence
+ *            <dsq> of length <L>, compute the Backward pass in two
+ *            rows of memory, recomputing the missing Forward rows
+ *            one block at a time, and (optionally) return the
+ *            Backward score in <opt_sc>. The score is the same as
+ *            <p7_Backward()>'s, including its switch to its own
+ *            scale factors on the rare overflows of [J3/119].
+ *
+ *            If <bnd> is non-<NULL>, each row is posterior decoded as
+ *            it's finished, and <bnd> receives posterior bands, as
+ *            in <p7_GBackwardCheckpointed()>: rows where the
+ *            posterior probability of the N, J and C states is less
+ *            than 0.9 get a band <ka..kb> from the first to the last
+ *            <k> with posterior probability of M_k or I_k of at
+ *            least 0.02. <bnd> must be fresh (new or <_Reuse()>'d).
+ *
+ *            If <pp> is non-<NULL>, it receives the posterior
+ *            decoding of every row, as <p7_Decoding()> would leave
+ *            it, so that <p7_Decoding()>'s own pass over full
+ *            Forward and Backward matrices isn't needed. <pp> must
+ *            be allocated for a full <om->M> by <L> comparison.
+ *
+ *            The Forward rows are used up: call
+ *            <p7_omxchk_GrowTo()> and <p7_ForwardCheckpointed()>
+ *            again before another back pass.
+ *
+ * Args:      dsq    - digital target sequence, 1..L
+ *            L      - length of dsq in residues
+ *            om     - optimized profile
+ *            ox     - checkpointed Forward matrix
+ *            pp     - optRETURN: posterior decoding matrix; or <NULL>
+ *            bnd    - optRETURN: posterior bands; or <NULL>
+ *            opt_sc - optRETURN: Backward lod score in nats
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the posterior decoding in <pp> overflows,
+ *            as <p7_Decoding()> returns it; the score is still set.
+ *
+ * Throws:    <eslEINVAL> if <ox> doesn't hold a Forward matrix for <L>.
+ *            <eslERANGE> if the score exceeds the limited range of
+ *            a probability-space odds ratio.
+ *            <eslEMEM> on allocation failure in growing <bnd>.
+ */
+int
+p7_BackwardCheckpointed(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMXCHK *ox, P7_OMX *pp, P7_GBANDS *bnd, float *opt_sc)
+{
+  vector float *fwd;                    /* Forward row i                                    */
+  vector float *bck;                    /* Backward row i                                   */
+  vector float *dpp;                    /* Backward row i+1                                 */
+  vector float  xBv, mpv;
+  vector float  zerov = (vector float) vec_splat_u32(0);
+  vector float *tp, *rp;
+  float         bx[p7X_NXCELLS];        /* Backward specials of the current row             */
+  float         bscale;                 /* Backward scale factor of the current row         */
+  float         scaleproduct;           /* posterior decoding: see posterior_decode_row()   */
+  float         totscale = 0.0;
+  float         xB, xN;
+  int           has_own_scales = FALSE;
+  int           Q     = p7O_NQF(om->M);
+  int           i, i2, b, w, q;
+  int           status;
+
+  if (ox->L != L || ox->R != ox->Ra + ox->Rb + ox->Rc) ESL_EXCEPTION(eslEINVAL, "checkpointed matrix doesn't hold a Forward pass for this L");
+  if (pp && pp->validR < L+1)                          ESL_EXCEPTION(eslEINVAL, "posterior decoding matrix too small");
+
+  /* The Backward score is the same as the Forward score; so its scaled
+   * value, which is what posterior decoding divides by, is the scaled
+   * Forward one, xC(L) t_CT.
+   */
+  scaleproduct = 1.0 / (ox->xmx[L*p7X_NXCELLS+p7X_C] * om->xf[p7O_C][p7O_MOVE]);
+  dpp          = NULL;
+
+  /* One Backward row <i>, into <bck>, from <dpp> (or initialized, for
+   * row L); its scale factor, as in backward_engine(); and the
+   * decoding of Forward row <fwd>.
+   */
+#define BACKWARD_STEP(i)						\
+  do {									\
+    if ((i) == L) backward_row_L(om, bck, bx);				\
+    else          backward_row(dsq, om, dpp, bck, (i), bx);		\
+    if (bx[p7X_B] > 1.0e16) has_own_scales = TRUE;			\
+    if (has_own_scales) bscale = (bx[p7X_B] > 1.0e4 ? bx[p7X_B] : 1.0); \
+    else                bscale = ox->xmx[(i)*p7X_NXCELLS+p7X_SCALE];	\
+    backward_rescale(om, bck, bx, bscale);				\
+    if (bscale > 1.0) totscale += log(bscale);				\
+    if (has_own_scales) scaleproduct *= bscale / ox->xmx[(i)*p7X_NXCELLS+p7X_SCALE]; \
+    if ((pp || bnd) && (status = posterior_decode_row(om, ox, fwd, bck, (i), bx, scaleproduct, pp, bnd)) != eslOK) return status; \
+    dpp = bck;								\
+  } while (0)
+
+  /* Checkpointed regions (b,c), from the end: block b has w rows, the last one saved */
+  for (i = L, b = 1; b <= ox->Rb + ox->Rc; b++)
+    {
+      w = (b <= ox->Rc ? b+1 : ox->Lb);
+
+      /* row i ends the block and is saved: pop it off the "stack" */
+      ox->R--;
+      fwd = ox->dpf[ox->R0+ox->R];
+      bck = ox->dpf[i%2];
+      BACKWARD_STEP(i);
+
+      /* recompute Forward rows i-w+1..i-1 from the previous checkpoint, pushing them */
+      fwd = ox->dpf[ox->R0+ox->R-1];
+      for (i2 = i-w+1; i2 <= i-1; i2++)
+	{
+	  forward_row(dsq, om, ox, fwd, ox->dpf[ox->R0+ox->R], i2);
+	  fwd = ox->dpf[ox->R0+ox->R]; ox->R++;
+	}
+
+      /* and pop them again, for the Backward rows */
+      for (i2 = i-1; i2 >= i-w+1; i2--)
+	{
+	  ox->R--;
+	  fwd = ox->dpf[ox->R0+ox->R];
+	  bck = ox->dpf[i2%2];
+	  BACKWARD_STEP(i2);
+	}
+      i -= w;
+    }
+
+  /* The uncheckpointed "a" region */
+  for (; i >= 1; i--)
+    {
+      ox->R--;
+      fwd = ox->dpf[ox->R0+ox->R];
+      bck = ox->dpf[i%2];
+      BACKWARD_STEP(i);
+    }
+#undef BACKWARD_STEP
+
+  /* Termination at i=0, where we can only reach N,B states. */
+  tp  = om->tfv;
+  rp  = om->rfv[dsq[1]];
+  xBv = (vector float) vec_splat_u32(0);
+  for (q = 0; q < Q; q++)
+    {
+      mpv = vec_madd(MMO(dpp,q), *rp, zerov);  rp++;
+      xBv = vec_madd(mpv,        *tp, xBv);    tp += 7;
+    }
+  xB = esl_vmx_hsum_float(xBv);
+  xN = (xB * om->xf[p7O_N][p7O_MOVE]) + (bx[p7X_N] * om->xf[p7O_N][p7O_LOOP]);
+
+  if (bnd)
+    {
+      bnd->L = L;
+      bnd->M = om->M;
+      if ((status = p7_gbands_Reverse(bnd)) != eslOK) return status;
+    }
+
+  if       (isnan(xN))        ESL_EXCEPTION(eslERANGE, "backward score is NaN");
+  else if  (L>0 && xN == 0.0) ESL_EXCEPTION(eslERANGE, "backward score underflow (is 0.0)");
+  else if  (isinf(xN) == 1)   ESL_EXCEPTION(eslERANGE, "backward score overflow (is infinity)");
+
+  if (pp)
+    {
+      pp->M = om->M;
+      pp->L = L;
+      for (q = 0; q < Q; q++) MMO(pp->dpf[0],q) = DMO(pp->dpf[0],q) = IMO(pp->dpf[0],q) = zerov;
+      for (q = 0; q < p7X_NXCELLS; q++) pp->xmx[q] = 0.0;
+    }
+
+  if (opt_sc != NULL) *opt_sc = totscale + log(xN);
+  return ((pp && isinf(scaleproduct)) ? eslERANGE : eslOK);
+}
+
+
+/* posterior_decode_row()
+ *
+ * Posterior decoding of row <i>, from Forward row <fwd>, Backward
+ * row <bck> and its specials <bx>, storing it in row <i> of <pp>
+ * (if non-NULL) and appending the row's band (if any) to <bnd> (if
+ * non-NULL). Rows are decoded from L down to 1, so bands are
+ * prepended, and reversed at the end of the back pass. Returns
+ * <eslOK>, or <eslEMEM> if <bnd> can't grow.
+ *
+ * <scaleproduct> is the factor that p7_Decoding() calls by the same
+ * name, for row <i>: 1/(scaled Forward score), times the product of
+ * Backward/Forward scale ratios of rows i..L when the Backward pass
+ * has had to use its own scale factors. The M,I posteriors also
+ * take the Forward scale of row i; the N,J,C loop posteriors don't.
+ */
+static inline int
+posterior_decode_row(const P7_OPROFILE *om, const P7_OMXCHK *ox, const vector float *fwd, const vector float *bck, int i,
+		     const float *bx, float scaleproduct, P7_OMX *pp, P7_GBANDS *bnd)
+{
+  union { vector float v; float p[4]; } u;
+  const float  *xp  = ox->xmx + (i-1)*p7X_NXCELLS; /* Forward specials of row i-1 */
+  int           Q   = p7O_NQF(om->M);
+  int           ka  = om->M+1;
+  int           kb  = 0;
+  float         ppN, ppJ, ppC;
+  vector float  zerov = (vector float) vec_splat_u32(0);
+  vector float  totrv, mv, iv;
+  vector float *ppv;
+  int           q, r, k;
+
+  ppN = xp[p7X_N] * bx[p7X_N] * om->xf[p7O_N][p7O_LOOP] * scaleproduct;
+  ppJ = xp[p7X_J] * bx[p7X_J] * om->xf[p7O_J][p7O_LOOP] * scaleproduct;
+  ppC = xp[p7X_C] * bx[p7X_C] * om->xf[p7O_C][p7O_LOOP] * scaleproduct;
+  if (ppN + ppJ + ppC >= 0.9) bnd = NULL; /* no band on this row */
+  if (! pp && ! bnd) return eslOK;
+
+  totrv = esl_vmx_set_float(scaleproduct * ox->xmx[i*p7X_NXCELLS+p7X_SCALE]);
+  ppv   = (pp ? pp->dpf[i] : NULL);
+  for (q = 0; q < Q; q++)
+    {
+      mv = vec_madd(vec_madd(MMO(fwd,q), MMO(bck,q), zerov), totrv, zerov);
+      iv = vec_madd(vec_madd(IMO(fwd,q), IMO(bck,q), zerov), totrv, zerov);
+      if (ppv) {
+	MMO(ppv,q) = mv;
+	DMO(ppv,q) = zerov;
+	IMO(ppv,q) = iv;
+      }
+      if (! bnd) continue;
+
+      u.v = vec_add(mv, iv);
+      for (r = 0; r < 4; r++)
+	if (u.p[r] >= 0.02)
+	  {
+	    k = r*Q + q + 1;
+	    if (k > om->M) continue;
+	    if (k < ka) ka = k;
+	    if (k > kb) kb = k;
+	  }
+    }
+
+  if (pp) {
+    pp->xmx[i*p7X_NXCELLS+p7X_E] = 0.0;
+    pp->xmx[i*p7X_NXCELLS+p7X_N] = ppN;
+    pp->xmx[i*p7X_NXCELLS+p7X_J] = ppJ;
+    pp->xmx[i*p7X_NXCELLS+p7X_C] = ppC;
+    pp->xmx[i*p7X_NXCELLS+p7X_B] = 0.0;
+  }
+  if (! bnd || kb == 0) return eslOK;
+  return p7_gbands_Prepend(bnd, i, ka, kb);
+}
+/*--------------------- end, backward ---------------------------*/
+
+
+
+/*****************************************************************
+ * 3. Stochastic traceback of an ensemble, from a checkpointed Forward matrix.
+ *****************************************************************/
+
+/* The select_*() functions are those of stotrace.c, taking the
+ * Forward row they need as an argument: <dpp> is row i-1 for
+ * select_m() and select_i(), <dpc> is row i for select_d() and
+ * select_e().
+ */
+
+/* M(i,k) is reached from B(i-1), M(i-1,k-1), D(i-1,k-1), or I(i-1,k-1). */
+static inline int
+select_m(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMXCHK *ox, const vector float *dpp, int i, int k)
+{
+  int           Q     = p7O_NQF(om->M);
+  int           q     = (k-1) % Q;
+  int           r     = (k-1) / Q;
+  vector float *tp    = om->tfv + 7*q;
+  vector float  xBv   = esl_vmx_set_float(ox->xmx[(i-1)*p7X_NXCELLS+p7X_B]);
+  vector float  zerov = (vector float) vec_splat_u32(0);
+  vector float  mpv, dpv, ipv;
+  union { vector float v; float p[4]; } u;
+  float         path[4];
+  int           state[4] = { p7T_B, p7T_M, p7T_I, p7T_D };
+
+  if (q > 0) {
+    mpv = dpp[(q-1)*3 + p7X_M];
+    dpv = dpp[(q-1)*3 + p7X_D];
+    ipv = dpp[(q-1)*3 + p7X_I];
+  } else {
+    mpv = vec_sld(zerov, dpp[(Q-1)*3 + p7X_M], 12);
+    dpv = vec_sld(zerov, dpp[(Q-1)*3 + p7X_D], 12);
+    ipv = vec_sld(zerov, dpp[(Q-1)*3 + p7X_I], 12);
+  }
+
+  u.v = vec_madd(xBv, *tp, zerov); tp++;  path[0] = u.p[r];
+  u.v = vec_madd(mpv, *tp, zerov); tp++;  path[1] = u.p[r];
+  u.v = vec_madd(ipv, *tp, zerov); tp++;  path[2] = u.p[r];
+  u.v = vec_madd(dpv, *tp, zerov);        path[3] = u.p[r];
+  esl_vec_FNorm(path, 4);
+  return state[esl_rnd_FChoose(rng, path, 4)];
+}
+
+/* D(i,k) is reached from M(i, k-1) or D(i,k-1). */
+static inline int
+select_d(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const vector float *dpc, int k)
+{
+  int          Q     = p7O_NQF(om->M);
+  int          q     = (k-1) % Q;
+  int          r     = (k-1) / Q;
+  vector float zerov = (vector float) vec_splat_u32(0);
+  vector float mpv, dpv;
+  vector float tmdv, tddv;
+  union { vector float v; float p[4]; } u;
+  float        path[2];
+  int          state[2] = { p7T_M, p7T_D };
+
+  if (q > 0) {
+    mpv  = dpc[(q-1)*3 + p7X_M];
+    dpv  = dpc[(q-1)*3 + p7X_D];
+    tmdv = om->tfv[7*(q-1) + p7O_MD];
+    tddv = om->tfv[7*Q + (q-1)];
+  } else {
+    mpv  = vec_sld(zerov, dpc[(Q-1)*3 + p7X_M], 12);
+    dpv  = vec_sld(zerov, dpc[(Q-1)*3 + p7X_D], 12);
+    tmdv = vec_sld(zerov, om->tfv[7*(Q-1) + p7O_MD], 12);
+    tddv = vec_sld(zerov, om->tfv[8*Q-1], 12);
+  }
+
+  u.v = vec_madd(mpv, tmdv, zerov); path[0] = u.p[r];
+  u.v = vec_madd(dpv, tddv, zerov); path[1] = u.p[r];
+  esl_vec_FNorm(path, 2);
+  return state[esl_rnd_FChoose(rng, path, 2)];
+}
+
+/* I(i,k) is reached from M(i-1, k) or I(i-1,k). */
+static inline int
+select_i(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const vector float *dpp, int k)
+{
+  int           Q    = p7O_NQF(om->M);
+  int           q    = (k-1) % Q;
+  int           r    = (k-1) / Q;
+  vector float  mpv  = dpp[q*3 + p7X_M];
+  vector float  ipv  = dpp[q*3 + p7X_I];
+  vector float  zerov = (vector float) vec_splat_u32(0);
+  vector float *tp   = om->tfv + 7*q + p7O_MI;
+  union { vector float v; float p[4]; } u;
+  float         path[2];
+  int           state[2] = { p7T_M, p7T_I };
+
+  u.v = vec_madd(mpv, *tp, zerov); tp++;  path[0] = u.p[r];
+  u.v = vec_madd(ipv, *tp, zerov);        path[1] = u.p[r];
+  esl_vec_FNorm(path, 2);
+  return state[esl_rnd_FChoose(rng, path, 2)];
+}
+
+/* C(i) is reached from E(i) or C(i-1). */
+static inline int
+select_c(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMXCHK *ox, int i)
+{
+  float path[2];
+  int   state[2] = { p7T_C, p7T_E };
+
+  path[0] = ox->xmx[(i-1)*p7X_NXCELLS+p7X_C] * om->xf[p7O_C][p7O_LOOP];
+  path[1] = ox->xmx[    i*p7X_NXCELLS+p7X_E] * om->xf[p7O_E][p7O_MOVE] * ox->xmx[i*p7X_NXCELLS+p7X_SCALE];
+  esl_vec_FNorm(path, 2);
+  return state[esl_rnd_FChoose(rng, path, 2)];
+}
+
+/* J(i) is reached from E(i) or J(i-1). */
+static inline int
+select_j(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMXCHK *ox, int i)
+{
+  float path[2];
+  int   state[2] = { p7T_J, p7T_E };
+
+  path[0] = ox->xmx[(i-1)*p7X_NXCELLS+p7X_J] * om->xf[p7O_J][p7O_LOOP];
+  path[1] = ox->xmx[    i*p7X_NXCELLS+p7X_E] * om->xf[p7O_E][p7O_LOOP] * ox->xmx[i*p7X_NXCELLS+p7X_SCALE];
+  esl_vec_FNorm(path, 2);
+  return state[esl_rnd_FChoose(rng, path, 2)];
+}
+
+/* E(i) is reached from any M(i, k=1..M) or D(i, k=2..M); see stotrace.c. */
+static inline int
+select_e(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMXCHK *ox, const vector float *dpc, int i, int *ret_k)
+{
+  int          Q     = p7O_NQF(om->M);
+  double       sum   = 0.0;
+  double       roll  = esl_random(rng);
+  double       norm  = 1.0 / ox->xmx[i*p7X_NXCELLS+p7X_E];
+  vector float xEv   = esl_vmx_set_float(norm);
+  vector float zerov = (vector float) vec_splat_u32(0);
+  union { vector float v; float p[4]; } u;
+  int          q,r;
+
+  while (1) {
+    for (q = 0; q < Q; q++)
+      {
+	u.v = vec_madd(dpc[q*3 + p7X_M], xEv, zerov);
+	for (r = 0; r < 4; r++) {
+	  sum += u.p[r];
+	  if (roll < sum) { *ret_k = r*Q + q + 1; return p7T_M;}
+	}
+
+	u.v = vec_madd(dpc[q*3 + p7X_D], xEv, zerov);
+	for (r = 0; r < 4; r++) {
+	  sum += u.p[r];
+	  if (roll < sum) { *ret_k = r*Q + q + 1; return p7T_D;}
+	}
+      }
+    ESL_DASSERT1((sum > 0.99));
+  }
+  /*UNREACHED*/
+  ESL_EXCEPTION(-1, "unreached code was reached. universe collapses.");
+}
+
+/* B(i) is reached from N(i) or J(i). */
+static inline int
+select_b(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMXCHK *ox, int i)
+{
+  float path[2];
+  int   state[2] = { p7T_N, p7T_J };
+
+  path[0] = ox->xmx[i*p7X_NXCELLS+p7X_N] * om->xf[p7O_N][p7O_MOVE];
+  path[1] = ox->xmx[i*p7X_NXCELLS+p7X_J] * om->xf[p7O_J][p7O_MOVE];
+  esl_vec_FNorm(path, 2);
+  return state[esl_rnd_FChoose(rng, path, 2)];
+}
+
+
+/* sample_row()
+ *
+ * Advance every trace in <tr[0..ntr-1]> that's waiting on Forward
+ * row <i>, given that row in <dpc>. Trace <t> is at sequence
+ * position <ti[t]>, in the state (and model position) of its last
+ * element. Those at i+1 in an M or I state take their step into row
+ * i; then those at i take all the steps they can within row i,
+ * stopping when they reach an M or I state, which needs row i-1, or
+ * when they leave row i on an N, J or C loop, or at S.
+ *
+ * Runs of N, J, C loops are collapsed to their first state.
+ */
+static int
+sample_row(ESL_RANDOMNESS *rng, const P7_OPROFILE *om, const P7_OMXCHK *ox, const vector float *dpc, int i,
+	   P7_TRACE **tr, int *ti, int ntr)
+{
+  int t;
+  int s0, s1;
+  int k;
+  int status;
+
+  for (t = 0; t < ntr; t++)
+    {
+      s0 = tr[t]->st[tr[t]->N-1];
+      k  = tr[t]->k [tr[t]->N-1];
+
+      if (ti[t] == i+1 && (s0 == p7T_M || s0 == p7T_I))
+	{
+	  if (s0 == p7T_M) { s1 = select_m(rng, om, ox, dpc, i+1, k); k--; }
+	  else               s1 = select_i(rng, om, dpc, k);
+	  ti[t] = i;
+	  if ((status = p7_trace_Append(tr[t], s1, k, i)) != eslOK) return status;
+	  s0 = s1;
+	}
+
+      while (ti[t] == i && s0 != p7T_M && s0 != p7T_I && s0 != p7T_S)
+	{
+	  switch (s0) {
+	  case p7T_D: s1 = select_d(rng, om, dpc, k);       k--; break;
+	  case p7T_N: s1 = (i == 0 ? p7T_S : p7T_N);             break;
+	  case p7T_C: s1 = select_c(rng, om, ox, i);             break;
+	  case p7T_J: s1 = select_j(rng, om, ox, i);             break;
+	  case p7T_E: s1 = select_e(rng, om, ox, dpc, i, &k);    break;
+	  case p7T_B: s1 = select_b(rng, om, ox, i);             break;
+	  default: ESL_EXCEPTION(eslEINVAL, "bogus state in traceback");
+	  }
+	  if (s1 == -1) ESL_EXCEPTION(eslEINVAL, "Stochastic traceback choice failed");
+
+	  if ( (s1 == p7T_N || s1 == p7T_J || s1 == p7T_C) && s1 == s0) { ti[t]--; continue; }
+	  if ((status = p7_trace_Append(tr[t], s1, k, i)) != eslOK) return status;
+	  s0 = s1;
+	}
+    }
+  return eslOK;
+}
+
+
+/* Function:  p7_StochasticTraceCheckpointed()
+ * Synopsis:  Sample an ensemble of traces from a checkpointed Forward matrix.
+ *
+ * Purpose:   Sample <ntr> alignments of model <om> to digital
+ *            sequence <dsq> of length <L> from the checkpointed
+ *            Forward matrix <ox> just filled by
+ *            <p7_ForwardCheckpointed()>, using random number
+ *            generator <rng>, into the caller's traces
+ *            <tr[0..ntr-1]>, which must be empty (new or
+ *            <_Reuse()>'d).
+ *
+ *            All the traces are sampled together, in one pass from
+ *            row L to row 0, recomputing the missing Forward rows
+ *            one block at a time as <p7_BackwardCheckpointed()>
+ *            does. The choice at each step is made as in
+ *            <p7_StochasticTrace()>, and a single sample (<ntr>=1)
+ *            draws the same random numbers in the same order, but
+ *            an ensemble interleaves the samples' draws, so it's a
+ *            different (equally valid) sample than <ntr> calls to
+ *            <p7_StochasticTrace()>.
+ *
+ *            To keep the ensemble in O(ntr \times aligned residues)
+ *            memory rather than O(ntr L), runs of N, J and C
+ *            states are collapsed to their first state: the traces
+ *            have their domains intact and can be given to
+ *            <p7_trace_Index()> and <p7_Null2_ByTrace()>, but
+ *            don't account for the residues emitted by N, J, C,
+ *            so won't pass <p7_trace_Validate()>.
+ *
+ *            The Forward rows are used up, as by the Backward pass.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation error.
+ *            <eslEINVAL> if a trace isn't empty, if <ox> doesn't hold
+ *            a Forward matrix for <L>, or if a traceback fails.
+ */
+int
+p7_StochasticTraceCheckpointed(ESL_RANDOMNESS *rng, const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMXCHK *ox,
+			       P7_TRACE **tr, int ntr)
+{
+  vector float *dpc;
+  int          *ti = NULL;      /* ti[t]: current sequence position of trace t */
+  int           i, i2, b, w, t;
+  int           status;
+
+  if (ox->L != L || ox->R != ox->Ra + ox->Rb + ox->Rc) ESL_EXCEPTION(eslEINVAL, "checkpointed matrix doesn't hold a Forward pass for this L");
+
+  ESL_ALLOC(ti, sizeof(int) * ntr);
+  for (t = 0; t < ntr; t++)
+    {
+      if (tr[t]->N != 0) ESL_XEXCEPTION(eslEINVAL, "trace not empty; needs to be Reuse()'d?");
+      if ((status = p7_trace_Append(tr[t], p7T_T, 0, L)) != eslOK) goto ERROR;
+      if ((status = p7_trace_Append(tr[t], p7T_C, 0, L)) != eslOK) goto ERROR;
+      ti[t] = L;
+    }
+
+  /* Forward rows come off the matrix in the order of the Backward pass */
+  for (i = L, b = 1; b <= ox->Rb + ox->Rc; b++)
+    {
+      w = (b <= ox->Rc ? b+1 : ox->Lb);
+
+      ox->R--;
+      dpc = ox->dpf[ox->R0+ox->R];
+      if ((status = sample_row(rng, om, ox, dpc, i, tr, ti, ntr)) != eslOK) goto ERROR;
+
+      dpc = ox->dpf[ox->R0+ox->R-1];
+      for (i2 = i-w+1; i2 <= i-1; i2++)
+	{
+	  forward_row(dsq, om, ox, dpc, ox->dpf[ox->R0+ox->R], i2);
+	  dpc = ox->dpf[ox->R0+ox->R]; ox->R++;
+	}
+
+      for (i2 = i-1; i2 >= i-w+1; i2--)
+	{
+	  ox->R--;
+	  dpc = ox->dpf[ox->R0+ox->R];
+	  if ((status = sample_row(rng, om, ox, dpc, i2, tr, ti, ntr)) != eslOK) goto ERROR;
+	}
+      i -= w;
+    }
+
+  for (; i >= 1; i--)
+    {
+      ox->R--;
+      dpc = ox->dpf[ox->R0+ox->R];
+      if ((status = sample_row(rng, om, ox, dpc, i, tr, ti, ntr)) != eslOK) goto ERROR;
+    }
+
+  /* row 0: remaining M,I steps (to B), then B->N->S */
+  if ((status = sample_row(rng, om, ox, ox->dpf[ox->R0-1], 0, tr, ti, ntr)) != eslOK) goto ERROR;
+
+  for (t = 0; t < ntr; t++)
+    {
+      if (tr[t]->st[tr[t]->N-1] != p7T_S) ESL_XEXCEPTION(eslEINVAL, "stochastic traceback didn't reach S");
+      tr[t]->M = om->M;
+      tr[t]->L = L;
+      if ((status = p7_trace_Reverse(tr[t])) != eslOK) goto ERROR;
+    }
+  free(ti);
+  return eslOK;
+
+ ERROR:
+  if (ti) free(ti);
+  return status;
+}
+/*------------------ end, stochastic traceback ------------------*/
+
+
+
+/*****************************************************************
+ * 4. Benchmark driver.
+ *****************************************************************/
+#ifdef p7FWDBACK_CHK_BENCHMARK
+/*
+   gcc -O3 -maltivec -std=gnu99 -o fwdback_chk_benchmark -I.. -L.. -I../../easel -L../../easel -Dp7FWDBACK_CHK_BENCHMARK fwdback_chk.c -lhmmer -leasel -lm
+   ./fwdback_chk_benchmark <hmmfile>         runs checkpointed Forward, Backward (with bands)
+   ./fwdback_chk_benchmark -f <hmmfile>      runs full-matrix p7_Forward(), p7_Backward(), for comparison
+ */
+#include <p7_config.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+#include "esl_randomseq.h"
+#include "esl_stopwatch.h"
+
+#include "hmmer.h"
+#include "impl_vmx.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                            docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",                0 },
+  { "-f",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "run full-matrix Forward/Backward instead",            0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                       0 },
+  { "-L",        eslARG_INT,   "2000", NULL, "n>0", NULL,  NULL, NULL, "length of random target seqs",                        0 },
+  { "-N",        eslARG_INT,    "100", NULL, "n>0", NULL,  NULL, NULL, "number of random target seqs",                        0 },
+  { "-R",        eslARG_INT,     "32", NULL, "n>0", NULL,  NULL, NULL, "RAM limit for the checkpointed matrix, in MB",        0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options] <hmmfile>";
+static char banner[] = "benchmark driver for checkpointed Forward/Backward, VMX version";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go      = p7_CreateDefaultApp(options, 1, argc, argv, banner, usage);
+  char           *hmmfile = esl_opt_GetArg(go, 1);
+  ESL_STOPWATCH  *w       = esl_stopwatch_Create();
+  ESL_RANDOMNESS *r       = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc     = NULL;
+  P7_HMMFILE     *hfp     = NULL;
+  P7_HMM         *hmm     = NULL;
+  P7_BG          *bg      = NULL;
+  P7_PROFILE     *gm      = NULL;
+  P7_OPROFILE    *om      = NULL;
+  P7_OMX         *fwd     = NULL;
+  P7_OMX         *bck     = NULL;
+  P7_OMXCHK      *ox      = NULL;
+  P7_GBANDS      *bnd     = p7_gbands_Create();
+  int             L       = esl_opt_GetInteger(go, "-L");
+  int             N       = esl_opt_GetInteger(go, "-N");
+  ESL_DSQ        *dsq     = malloc(sizeof(ESL_DSQ) * (L+2));
+  int             i;
+  float           fsc, bsc;
+  double          base_time, bench_time, Mcs;
+
+  if (p7_hmmfile_Open(hmmfile, NULL, &hfp, NULL) != eslOK) p7_Fail("Failed to open HMM file %s", hmmfile);
+  if (p7_hmmfile_Read(hfp, &abc, &hmm)           != eslOK) p7_Fail("Failed to read HMM");
+
+  bg = p7_bg_Create(abc);                p7_bg_SetLength(bg, L);
+  gm = p7_profile_Create(hmm->M, abc);   p7_ProfileConfig(hmm, bg, gm, L, p7_LOCAL);
+  om = p7_oprofile_Create(gm->M, abc);   p7_oprofile_Convert(gm, om);
+
+  if (esl_opt_GetBoolean(go, "-f")) {
+    fwd = p7_omx_Create(gm->M, L, L);
+    bck = p7_omx_Create(gm->M, L, L);
+  } else 
+    ox  = p7_omxchk_Create(gm->M, L, ESL_MBYTES(esl_opt_GetInteger(go, "-R")));
+
+  esl_stopwatch_Start(w);
+  for (i = 0; i < N; i++) esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+  esl_stopwatch_Stop(w);
+  base_time = w->user;
+
+  esl_stopwatch_Start(w);
+  for (i = 0; i < N; i++)
+    {
+      esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+      if (esl_opt_GetBoolean(go, "-f")) {
+	p7_Forward (dsq, L, om,      fwd, &fsc);
+	p7_Backward(dsq, L, om, fwd, bck, &bsc);
+      } else {
+	p7_omxchk_GrowTo(ox, om->M, L);
+	p7_ForwardCheckpointed (dsq, L, om, ox,      &fsc);
+	p7_BackwardCheckpointed(dsq, L, om, ox, NULL, bnd, &bsc);
+	p7_gbands_Reuse(bnd);
+      }
+    }
+  esl_stopwatch_Stop(w);
+  bench_time = w->user - base_time;
+  Mcs        = (double) N * (double) L * (double) gm->M * 1e-6 / (double) bench_time;
+  esl_stopwatch_Display(stdout, w, "# CPU time: ");
+  printf("# M    = %d\n",   gm->M);
+  printf("# %.1f Mc/s\n", Mcs);
+  if (ox) printf("# matrix size: %.2f MB (checkpointed: Ra=%d Rb=%d Rc=%d)\n", (double) p7_omxchk_Sizeof(ox) / 1048576., ox->Ra, ox->Rb, ox->Rc);
+  else    printf("# matrix size: %.2f MB (two full matrices)\n",             (double) (p7_omx_Sizeof(fwd) + p7_omx_Sizeof(bck)) / 1048576.);
+
+  free(dsq);
+  p7_gbands_Destroy(bnd);
+  p7_omxchk_Destroy(ox);
+  p7_omx_Destroy(bck);
+  p7_omx_Destroy(fwd);
+  p7_oprofile_Destroy(om);
+  p7_profile_Destroy(gm);
+  p7_bg_Destroy(bg);
+  p7_hmm_Destroy(hmm);
+  p7_hmmfile_Close(hfp);
+  esl_alphabet_Destroy(abc);
+  esl_stopwatch_Destroy(w);
+  esl_randomness_Destroy(r);
+  esl_getopts_Destroy(go);
+  return 0;
+}
+#endif /*p7FWDBACK_CHK_BENCHMARK*/
+/*------------------- end, benchmark driver ---------------------*/
+
+
+
+/*****************************************************************
+ * 5. Unit tests.
+ *****************************************************************/
+#ifdef p7FWDBACK_CHK_TESTDRIVE
+#include "esl_random.h"
+#include "esl_randomseq.h"
+
+/* utest_scores()
+ *
+ * Checkpointed Forward and Backward scores agree with p7_Forward()
+ * and p7_Backward(), whatever the layout <ramlimit> forces: full,
+ * checkpointed, or redlined. The bands are the same in every
+ * layout, and are sane; the posterior decoding matrix is that of
+ * p7_Decoding().
+ */
+static void
+utest_scores(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char        *msg     = "checkpointed forward/backward scores unit test failed";
+  P7_HMM      *hmm     = NULL;
+  P7_PROFILE  *gm      = NULL;
+  P7_OPROFILE *om      = NULL;
+  ESL_DSQ     *dsq     = malloc(sizeof(ESL_DSQ) * (L+2));
+  P7_OMX      *fwd     = p7_omx_Create(M, L, L);
+  P7_OMX      *bck     = p7_omx_Create(M, L, L);
+  P7_OMX      *pp1     = p7_omx_Create(M, L, L);
+  P7_OMX      *pp2     = p7_omx_Create(M, L, L);
+  int64_t      ramlimit[3] = { ESL_MBYTES(128), 16 * 1024, 0 }; /* full; checkpointed (for M,L of a few hundred); redlined */
+  P7_OMXCHK   *ox[3];
+  P7_GBANDS   *bnd[3];
+  int          i, j, z, g;
+  float        fsc1, bsc1;
+  float        fsc2, bsc2;
+
+  for (j = 0; j < 3; j++)
+    {
+      ox[j]  = p7_omxchk_Create(M, L, ramlimit[j]);
+      bnd[j] = p7_gbands_Create();
+    }
+
+  p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om);
+  while (N--)
+    {
+      esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+      p7_Forward (dsq, L, om, fwd,      &fsc1);
+      p7_Backward(dsq, L, om, fwd, bck, &bsc1);
+      p7_Decoding(om, fwd, bck, pp1);
+
+      for (j = 0; j < 3; j++)
+	{
+	  if (p7_omxchk_GrowTo(ox[j], om->M, L)                          != eslOK) esl_fatal(msg);
+	  if (p7_ForwardCheckpointed (dsq, L, om, ox[j], &fsc2)          != eslOK) esl_fatal(msg);
+	  if (p7_BackwardCheckpointed(dsq, L, om, ox[j], pp2, bnd[j], &bsc2) != eslOK) esl_fatal(msg);
+
+	  if (fabs(fsc1-fsc2) > 0.0001) esl_fatal(msg);
+	  if (fabs(bsc1-bsc2) > 0.0001) esl_fatal(msg);
+	  if (fabs(fsc2-bsc2) > 0.0001) esl_fatal(msg);
+	  if (ox[j]->R != 0)            esl_fatal(msg);
+
+	  if (pp2->M != om->M || pp2->L != L) esl_fatal(msg);
+	  for (i = 0; i <= L; i++)
+	    {
+	      for (z = 0; z < p7X_NSCELLS * 4 * p7O_NQF(om->M); z++)
+		if (fabs(((float *) pp1->dpf[i])[z] - ((float *) pp2->dpf[i])[z]) > 0.0001) esl_fatal(msg);
+	      for (z = p7X_E; z <= p7X_C; z++)
+		if (fabs(pp1->xmx[i*p7X_NXCELLS+z] - pp2->xmx[i*p7X_NXCELLS+z]) > 0.0001) esl_fatal(msg);
+	    }
+
+	  if (bnd[j]->L != L || bnd[j]->M != om->M) esl_fatal(msg);
+	  for (z = 0; z < bnd[j]->nrow; z++)
+	    if (bnd[j]->kmem[z*p7_GBANDS_NK] < 1 || bnd[j]->kmem[z*p7_GBANDS_NK] > bnd[j]->kmem[z*p7_GBANDS_NK+1] || bnd[j]->kmem[z*p7_GBANDS_NK+1] > om->M) esl_fatal(msg);
+	  for (g = 0; g < bnd[j]->nseg; g++)
+	    if (bnd[j]->imem[g*2] < 1 || bnd[j]->imem[g*2] > bnd[j]->imem[g*2+1] || bnd[j]->imem[g*2+1] > L ||
+		(g > 0 && bnd[j]->imem[g*2] <= bnd[j]->imem[g*2-1]+1)) esl_fatal(msg);
+	}
+
+      /* bands don't depend on the layout */
+      for (j = 1; j < 3; j++)
+	{
+	  if (bnd[j]->nseg != bnd[0]->nseg || bnd[j]->nrow != bnd[0]->nrow) esl_fatal(msg);
+	  for (z = 0; z < 2*bnd[0]->nseg; z++)            if (bnd[j]->imem[z] != bnd[0]->imem[z]) esl_fatal(msg);
+	  for (z = 0; z < p7_GBANDS_NK*bnd[0]->nrow; z++) if (bnd[j]->kmem[z] != bnd[0]->kmem[z]) esl_fatal(msg);
+	}
+      for (j = 0; j < 3; j++) p7_gbands_Reuse(bnd[j]);
+    }
+
+  for (j = 0; j < 3; j++)
+    {
+      p7_omxchk_Destroy(ox[j]);
+      p7_gbands_Destroy(bnd[j]);
+    }
+  free(dsq);
+  p7_omx_Destroy(fwd);
+  p7_omx_Destroy(bck);
+  p7_omx_Destroy(pp1);
+  p7_omx_Destroy(pp2);
+  p7_hmm_Destroy(hmm);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
+
+/* utest_stotrace()
+ *
+ * A single checkpointed stochastic trace makes the same choices as
+ * p7_StochasticTrace() with the same RNG seed, so it finds the same
+ * domains. An ensemble comes out the same whether the matrix is
+ * full or checkpointed, and every trace in it is S..T.
+ */
+static void
+utest_stotrace(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char           *msg   = "checkpointed stochastic traceback unit test failed";
+  P7_HMM         *hmm   = NULL;
+  P7_PROFILE     *gm    = NULL;
+  P7_OPROFILE    *om    = NULL;
+  ESL_DSQ        *dsq   = malloc(sizeof(ESL_DSQ) * (L+2));
+  P7_OMX         *fwd   = p7_omx_Create(M, L, L);
+  P7_OMXCHK      *oxc   = p7_omxchk_Create(M, L, 16 * 1024);       /* checkpointed */
+  P7_OMXCHK      *oxf   = p7_omxchk_Create(M, L, ESL_MBYTES(128)); /* full         */
+  P7_TRACE       *tr0   = p7_trace_Create();
+  P7_TRACE       *tr1[8];
+  P7_TRACE       *tr2[8];
+  ESL_RANDOMNESS *rng1  = NULL;
+  ESL_RANDOMNESS *rng2  = NULL;
+  uint32_t        seed;
+  int             ntr   = 8;
+  int             t, d;
+
+  for (t = 0; t < ntr; t++) { tr1[t] = p7_trace_Create(); tr2[t] = p7_trace_Create(); }
+
+  p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om);
+  while (N--)
+    {
+      seed = esl_random_uint32(r) | 1;   /* nonzero: 0 would mean an arbitrary seed */
+      esl_rsq_xfIID(r, bg->f, abc->K, L, dsq);
+
+      /* One trace: same as p7_StochasticTrace() */
+      rng1 = esl_randomness_CreateFast(seed);
+      rng2 = esl_randomness_CreateFast(seed);
+      p7_Forward(dsq, L, om, fwd, NULL);
+      if (p7_StochasticTrace(rng1, dsq, L, om, fwd, tr0)                 != eslOK) esl_fatal(msg);
+      p7_omxchk_GrowTo(oxc, om->M, L);
+      p7_ForwardCheckpointed(dsq, L, om, oxc, NULL);
+      if (p7_StochasticTraceCheckpointed(rng2, dsq, L, om, oxc, tr1, 1)  != eslOK) esl_fatal(msg);
+      p7_trace_Index(tr0);
+      p7_trace_Index(tr1[0]);
+      if (tr0->ndom != tr1[0]->ndom) esl_fatal(msg);
+      for (d = 0; d < tr0->ndom; d++)
+	if (tr0->sqfrom[d]  != tr1[0]->sqfrom[d]  || tr0->sqto[d]  != tr1[0]->sqto[d] ||
+	    tr0->hmmfrom[d] != tr1[0]->hmmfrom[d] || tr0->hmmto[d] != tr1[0]->hmmto[d]) esl_fatal(msg);
+      p7_trace_Reuse(tr0);
+      p7_trace_Reuse(tr1[0]);
+      esl_randomness_Destroy(rng1);
+      esl_randomness_Destroy(rng2);
+
+      /* An ensemble: same in checkpointed and full layouts */
+      rng1 = esl_randomness_CreateFast(seed);
+      rng2 = esl_randomness_CreateFast(seed);
+      p7_omxchk_GrowTo(oxc, om->M, L);
+      p7_ForwardCheckpointed(dsq, L, om, oxc, NULL);
+      if (p7_StochasticTraceCheckpointed(rng1, dsq, L, om, oxc, tr1, ntr) != eslOK) esl_fatal(msg);
+
+      if (! p7_omxchk_FitsFull(oxf, om->M, L)) esl_fatal(msg);
+
+      p7_omxchk_GrowTo(oxf, om->M, L);
+      if (oxf->Rb + oxf->Rc != 0) esl_fatal(msg);
+      p7_ForwardCheckpointed(dsq, L, om, oxf, NULL);
+      if (p7_StochasticTraceCheckpointed(rng2, dsq, L, om, oxf, tr2, ntr) != eslOK) esl_fatal(msg);
+
+      for (t = 0; t < ntr; t++)
+	{
+	  if (p7_trace_Compare(tr1[t], tr2[t], 0.0) != eslOK) esl_fatal(msg);
+	  if (tr1[t]->st[0] != p7T_S || tr1[t]->st[tr1[t]->N-1] != p7T_T) esl_fatal(msg);
+	  p7_trace_Index(tr1[t]);
+	  if (tr1[t]->ndom < 1) esl_fatal(msg);
+	  for (d = 0; d < tr1[t]->ndom; d++)
+	    if (tr1[t]->sqfrom[d] < 1 || tr1[t]->sqto[d] > L || tr1[t]->sqfrom[d] > tr1[t]->sqto[d]) esl_fatal(msg);
+	  p7_trace_Reuse(tr1[t]);
+	  p7_trace_Reuse(tr2[t]);
+	}
+      esl_randomness_Destroy(rng1);
+      esl_randomness_Destroy(rng2);
+    }
+
+  for (t = 0; t < ntr; t++) { p7_trace_Destroy(tr1[t]); p7_trace_Destroy(tr2[t]); }
+  p7_trace_Destroy(tr0);
+  free(dsq);
+  p7_omxchk_Destroy(oxc);
+  p7_omxchk_Destroy(oxf);
+  p7_omx_Destroy(fwd);
+  p7_hmm_Destroy(hmm);
+  p7_profile_Destroy(gm);
+  p7_oprofile_Destroy(om);
+}
+#endif /*p7FWDBACK_CHK_TESTDRIVE*/
+/*---------------------- end, unit tests ------------------------*/
+
+
+
+
+/*****************************************************************
+ * 6. Test driver
+ *****************************************************************/
+#ifdef p7FWDBACK_CHK_TESTDRIVE
+/*
+   gcc -g -Wall -maltivec -std=gnu99 -o fwdback_chk_utest -I.. -L.. -I../../easel -L../../easel -Dp7FWDBACK_CHK_TESTDRIVE fwdback_chk.c -lhmmer -leasel -lm
+   ./fwdback_chk_utest
+ */
+#include <p7_config.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_getopts.h"
+#include "esl_random.h"
+
+#include "hmmer.h"
+#include "impl_vmx.h"
+
+static ESL_OPTIONS options[] = {
+  /* name           type      default  env  range toggles reqs incomp  help                                       docgroup*/
+  { "-h",        eslARG_NONE,   FALSE, NULL, NULL,  NULL,  NULL, NULL, "show brief help on version and usage",           0 },
+  { "-s",        eslARG_INT,     "42", NULL, NULL,  NULL,  NULL, NULL, "set random number seed to <n>",                  0 },
+  { "-L",        eslARG_INT,    "200", NULL, NULL,  NULL,  NULL, NULL, "size of random sequences to sample",             0 },
+  { "-M",        eslARG_INT,    "145", NULL, NULL,  NULL,  NULL, NULL, "size of random models to sample",                0 },
+  { "-N",        eslARG_INT,     "20", NULL, NULL,  NULL,  NULL, NULL, "number of random sequences to sample",           0 },
+  {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for VMX checkpointed Forward, Backward implementations";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go   = p7_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *r    = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc  = NULL;
+  P7_BG          *bg   = NULL;
+  int             M    = esl_opt_GetInteger(go, "-M");
+  int             L    = esl_opt_GetInteger(go, "-L");
+  int             N    = esl_opt_GetInteger(go, "-N");
+
+  if ((abc = esl_alphabet_Create(eslAMINO)) == NULL)  esl_fatal("failed to create alphabet");
+  if ((bg = p7_bg_Create(abc))              == NULL)  esl_fatal("failed to create null model");
+
+  utest_scores  (r, abc, bg, M, L, N);   /* normal sized models */
+  utest_scores  (r, abc, bg, 1, L, 5);   /* size 1 models       */
+  utest_scores  (r, abc, bg, M, 1, 5);   /* size 1 sequences    */
+  utest_stotrace(r, abc, bg, M, L, N);
+  utest_stotrace(r, abc, bg, M, 1, 5);
+
+  esl_alphabet_Destroy(abc);
+  p7_bg_Destroy(bg);
+  esl_getopts_Destroy(go);
+  esl_randomness_Destroy(r);
+  return eslOK;
+}
+#endif /*p7FWDBACK_CHK_TESTDRIVE*/
+/*--------------------- end, test driver ------------------------*/
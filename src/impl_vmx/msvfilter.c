@@ -202,6 +202,161 @@ p7_MSVFilter(const ESL_DSQ *dsq, int L, const P7_OPROFILE *om, P7_OMX *ox, float
 /*------------------ end, p7_MSVFilter() ------------------------*/
 
 
+
+/* Function:  p7_MSVFilter_multitime()
+ * Synopsis:  MSV scores of one target for several profiles, in one sweep.
+ *
+ * Purpose:   Calculates MSV filter scores for sequence <dsq> of length
+ *            <L> against each of <nt> optimized profiles <oma[0..nt-1]>,
+ *            streaming the sequence once rather than once per profile.
+ *            The profiles are typically the same query evolved to
+ *            different divergence times; they must all have the same
+ *            length <M>, and must each already be configured for
+ *            length <L>. Scores (in nats) are returned in
+ *            <ret_sc[0..nt-1]>; each is the score <p7_MSVFilter()>
+ *            returns for that profile.
+ *
+ *            Each profile needs its own <Q> vectors of DP row. As many
+ *            profiles as fit in the first row of <ox> (and at most
+ *            <p7O_MSVMAXT>) are swept together; larger sets take more
+ *            than one sweep.
+ *
+ * Args:      dsq     - digital target sequence, 1..L
+ *            L       - length of dsq in residues
+ *            oma     - optimized profiles, 0..nt-1
+ *            nt      - number of profiles
+ *            ox      - DP matrix
+ *            ret_sc  - RETURN: MSV scores (in nats), 0..nt-1
+ *
+ * Returns:   <eslOK> on success.
+ *            <eslERANGE> if the score of at least one profile overflows
+ *            the limited range; that profile's score is <eslINFINITY>,
+ *            and the others are still valid.
+ *
+ * Throws:    <eslEINVAL> if <ox> allocation is too small, or if the
+ *            profiles differ in length.
+ */
+int
+p7_MSVFilter_multitime(const ESL_DSQ *dsq, int L, P7_OPROFILE **oma, int nt, P7_OMX *ox, float *ret_sc)
+{
+  vector unsigned char mpv;                    /* previous row values                                       */
+  vector unsigned char xEv;		           /* E state: keeps max for Mk->E as we go                     */
+  vector unsigned char sv;		           /* temp storage of 1 curr row value in progress              */
+  vector unsigned char zerov;                  /* vector of zeros                                           */
+  vector unsigned char tempv;                  /* work vector                                               */
+  vector unsigned char biasv[p7O_MSVMAXT];     /* emission bias, per profile                                */
+  vector unsigned char basev[p7O_MSVMAXT];     /* offset for scores, per profile                            */
+  vector unsigned char tjbmv[p7O_MSVMAXT];     /* J/N->B->Mk cost, per profile                              */
+  vector unsigned char tecv[p7O_MSVMAXT];      /* E->C cost, per profile                                    */
+  vector unsigned char ceilv[p7O_MSVMAXT];     /* overflow threshold, per profile                           */
+  vector unsigned char xJv[p7O_MSVMAXT];       /* J state, per profile                                      */
+  vector unsigned char xBv[p7O_MSVMAXT];       /* B state, per profile                                      */
+  int      live[p7O_MSVMAXT];      /* TRUE until a profile's score overflows                    */
+  const P7_OPROFILE *om;
+  vector unsigned char *dp;			   /* DP row of the current profile                             */
+  vector unsigned char *rsc;			   /* will point at om->rbv[x] for residue x[i]                 */
+  uint8_t  xJ;
+  int      Q = p7O_NQB(oma[0]->M); /* segment length: # of vectors                              */
+  int      ntb;                    /* # of profiles per sweep                                   */
+  int      nb, nlive;
+  int      t0, t, i, q;
+  int      status = eslOK;
+
+  /* Check that the DP matrix is ok for us; we use its first row, Q vectors per profile. */
+  if (Q > ox->allocQ16)  ESL_EXCEPTION(eslEINVAL, "DP matrix allocated too small");
+  for (t = 1; t < nt; t++)
+    if (oma[t]->M != oma[0]->M) ESL_EXCEPTION(eslEINVAL, "profiles of different lengths");
+  ox->M = oma[0]->M;
+  ntb   = ESL_MIN(p7O_MSVMAXT, (ox->allocQ4 * p7X_NSCELLS) / Q);
+
+  zerov = vec_splat_u8(0);
+
+  for (t0 = 0; t0 < nt; t0 += ntb)
+    {
+      nb = nlive = ESL_MIN(ntb, nt - t0);
+
+      /* Initialization, as in p7_MSVFilter(), once per profile. */
+      for (t = 0; t < nb; t++)
+	{
+	  om       = oma[t0+t];
+	  dp       = ox->dpb[0] + t * Q;
+	  for (q = 0; q < Q; q++) dp[q] = vec_splat_u8(0);
+
+	  biasv[t] = esl_vmx_set_u8(om->bias_b);
+	  basev[t] = esl_vmx_set_u8((int8_t) om->base_b);
+	  tjbmv[t] = esl_vmx_set_u8((int8_t) om->tjb_b + (int8_t) om->tbm_b);
+	  tecv[t]  = esl_vmx_set_u8((int8_t) om->tec_b);
+	  ceilv[t] = (vector unsigned char) vec_cmpeq(biasv[t], biasv[t]);
+	  ceilv[t] = vec_subs(ceilv[t], biasv[t]);
+	  ceilv[t] = vec_subs(ceilv[t], vec_splat_u8(1));
+	  xJv[t]   = vec_splat_u8(0);
+	  xBv[t]   = vec_subs(basev[t], tjbmv[t]);
+	  live[t]  = TRUE;
+	}
+
+      for (i = 1; i <= L && nlive > 0; i++)
+	for (t = 0; t < nb; t++)
+	  {
+	    if (! live[t]) continue;
+
+	    om  = oma[t0+t];
+	    dp  = ox->dpb[0] + t * Q;
+	    rsc = om->rbv[dsq[i]];
+	    xEv = vec_splat_u8(0);
+
+	    mpv = vec_sld(zerov, dp[Q-1], 15);
+	    for (q = 0; q < Q; q++)
+	      {
+		sv    = vec_max(mpv, xBv[t]);
+		sv    = vec_adds(sv, biasv[t]);
+		sv    = vec_subs(sv, *rsc);   rsc++;
+		xEv   = vec_max(xEv, sv);
+
+		mpv   = dp[q];
+		dp[q] = sv;
+	      }
+
+	    /* horizontal max of xEv, in all elements by rotates */
+	    tempv = vec_sld(xEv, xEv, 1);
+	    xEv   = vec_max(xEv, tempv);
+	    tempv = vec_sld(xEv, xEv, 2);
+	    xEv   = vec_max(xEv, tempv);
+	    tempv = vec_sld(xEv, xEv, 4);
+	    xEv   = vec_max(xEv, tempv);
+	    tempv = vec_sld(xEv, xEv, 8);
+	    xEv   = vec_max(xEv, tempv);
+
+	    /* overflow test; an overflowed profile drops out of the sweep */
+	    if (vec_any_gt(xEv, ceilv[t]))
+	      {
+		ret_sc[t0+t] = eslINFINITY;
+		live[t]      = FALSE;
+		nlive--;
+		status       = eslERANGE;
+		continue;
+	      }
+
+	    xEv    = vec_subs(xEv, tecv[t]);
+	    xJv[t] = vec_max(xJv[t], xEv);
+	    xBv[t] = vec_max(basev[t], xJv[t]);
+	    xBv[t] = vec_subs(xBv[t], tjbmv[t]);
+	  } /* end loops over profiles t and residues 1..L */
+
+      for (t = 0; t < nb; t++)
+	{
+	  if (! live[t]) continue;
+	  om = oma[t0+t];
+	  vec_ste(xJv[t], 0, &xJ);
+	  ret_sc[t0+t]  = ((float) (xJ - om->tjb_b) - (float) om->base_b);
+	  ret_sc[t0+t] /= om->scale_b;
+	  ret_sc[t0+t] -= 3.0; /* that's ~ L \log \frac{L}{L+3}, for our NN,CC,JJ */
+	}
+    }
+  return status;
+}
+/*------------- end, p7_MSVFilter_multitime() -------------------*/
+
+
 /* Function:  p7_SSVFilter_longtarget()
  * Synopsis:  Finds windows with SSV scores above some threshold (vewy vewy fast, in limited precision)
  *
@@ -1,7 +1,7 @@
 /* Optimal accuracy alignment; VMX version.
  * 
  * Contents:
- *   1. Optimal accuracy alignment, DP fill
+ *   1. Optimal accuracy alignment, DP fill; full and banded
  *   2. OA traceback
  *   3. Benchmark driver
  *   4. Unit tests
@@ -172,6 +172,211 @@ p7_OptimalAccuracy(const P7_OPROFILE *om, const P7_OMX *pp, P7_OMX *ox, float *r
   *ret_e = ox->xmx[pp->L*p7X_NXCELLS+p7X_C];
   return eslOK;
 }
+
+
+/* band_vectors()
+ *
+ * The striped vectors <qa..qb> that a row's band <ka..kb> needs. Cell
+ * k is in vector (k-1)%Q, so a band narrower than Q that doesn't wrap
+ * around the end of the stripe needs only its own vectors (in all
+ * four of their slots); any other band needs all of them.
+ */
+static inline void
+band_vectors(int Q, int ka, int kb, int *ret_qa, int *ret_qb)
+{
+  int qa = (ka-1) % Q;
+  int qb = (kb-1) % Q;
+
+  if (kb-ka+1 >= Q || qa > qb) { qa = 0; qb = Q-1; }
+  *ret_qa = qa;
+  *ret_qb = qb;
+}
+
+
+/* Function:  p7_OptimalAccuracyBanded()
+ * Synopsis:  DP fill of an optimal accuracy alignment, within posterior bands.
+ *
+ * Purpose:   The same as <p7_OptimalAccuracy()>, but computing only
+ *            the cells in posterior bands <bnd>, as given by
+ *            <p7_BackwardCheckpointed()> along with <pp>. Each row's
+ *            band is widened to the striped vectors that hold it
+ *            (see <band_vectors()>); rows outside the bands are
+ *            only in the N, J, C states. Cells outside the bands
+ *            that <p7_OATrace()> can look at are set to $-\infty$,
+ *            so the result is traced back as usual. The row vectors
+ *            outside a band are only stored to, so the fill costs
+ *            about as much as the band's fraction of the matrix.
+ *
+ *            With bands covering every row and every <k>, the
+ *            result is the same as <p7_OptimalAccuracy()>'s.
+ *
+ * Args:      om    - query profile
+ *            pp    - posterior decoding matrix
+ *            bnd   - posterior bands for <pp->L> rows, <om->M> columns
+ *            ox    - RESULT: caller provided DP matrix for <om->M> by <pp->L>
+ *            ret_e - RETURN: expected number of correctly decoded positions
+ *
+ * Returns:   <eslOK> on success, and <*ret_e> contains the final OA
+ *            score, the expected number of correctly decoded
+ *            positions within the bands.
+ *
+ * Throws:    <eslEINVAL> if <bnd> isn't for an <om->M> by <pp->L> comparison.
+ */
+int
+p7_OptimalAccuracyBanded(const P7_OPROFILE *om, const P7_OMX *pp, const P7_GBANDS *bnd, P7_OMX *ox, float *ret_e)
+{
+  vector float mpv, dpv, ipv;   /* previous row values                                       */
+  vector float sv;              /* temp storage of 1 curr row value in progress              */
+  vector float xEv;             /* E state: keeps max for Mk->E as we go                     */
+  vector float xBv;             /* B state: splatted vector of B[i-1] for B->Mk calculations */
+  vector float dcv;
+  float        *xmx    = ox->xmx;
+  vector float *dpc    = ox->dpf[0];   /* current row, for use in {MDI}MO(dpp,q) access macro       */
+  vector float *dpp;                   /* previous row, for use in {MDI}MO(dpp,q) access macro      */
+  vector float *ppp;                   /* quads in the <pp> posterior probability matrix            */
+  vector float *tp;                    /* quads in the <om->tfv> transition scores                  */
+  vector float  zerov  = (vector float) vec_splat_u32(0);
+  vector float  infv   = esl_vmx_set_float(-eslINFINITY);
+  int          *bnd_ip = bnd->imem;  /* ptr to current ia, ib segment band                        */
+  int          *bnd_kp = bnd->kmem;  /* ptr to current ka, kb row band                            */
+  int           M      = om->M;
+  int           L      = pp->L;
+  int           Q      = p7O_NQF(M);
+  int           ia, ib;              /* current band segment is rows ia..ib                       */
+  int           qa, qb;              /* current row's band is in vectors qa..qb                   */
+  int           g, q, j, i;
+  float         t1, t2;
+
+  if (bnd->L != L || bnd->M != M) ESL_EXCEPTION(eslEINVAL, "bands aren't for this comparison");
+
+  ox->M = om->M;
+  ox->L = pp->L;
+  for (q = 0; q < Q; q++) MMO(dpc, q) = IMO(dpc,q) = DMO(dpc,q) = infv;
+  XMXo(0, p7X_E)    = -eslINFINITY;
+  XMXo(0, p7X_N)    = 0.;
+  XMXo(0, p7X_J)    = -eslINFINITY;
+  XMXo(0, p7X_B)    = 0.;
+  XMXo(0, p7X_C)    = -eslINFINITY;
+
+  g  = 0;
+  ia = (bnd->nseg > 0 ? bnd_ip[0] : L+1);
+  ib = (bnd->nseg > 0 ? bnd_ip[1] : L);
+  for (i = 1; i <= L; i++)
+    {
+      if (i < ia) 
+	XMXo(i, p7X_E) = -eslINFINITY;	/* outside the bands: no M, D, I, E */
+      else
+	{
+	  dpp = ox->dpf[i-1];
+	  dpc = ox->dpf[i];
+	  if (i == ia && i > 1)	/* row before a segment: a boundary of -inf */
+	    for (q = 0; q < Q; q++) MMO(dpp, q) = IMO(dpp,q) = DMO(dpp,q) = infv;
+
+	  band_vectors(Q, bnd_kp[0], bnd_kp[1], &qa, &qb);
+	  bnd_kp += 2;
+
+	  ppp = pp->dpf[i] + qa*p7X_NSCELLS;
+	  tp  = om->tfv    + qa*7;
+	  dcv = infv;
+	  xEv = infv;
+	  xBv = esl_vmx_set_float(XMXo(i-1, p7X_B));
+
+	  if (qa == 0) {
+	    mpv = vec_sld(infv, MMO(dpp,Q-1), 12);
+	    dpv = vec_sld(infv, DMO(dpp,Q-1), 12);
+	    ipv = vec_sld(infv, IMO(dpp,Q-1), 12);
+	  } else {
+	    mpv = MMO(dpp,qa-1);
+	    dpv = DMO(dpp,qa-1);
+	    ipv = IMO(dpp,qa-1);
+	  }
+	  for (q = 0;    q < qa; q++) MMO(dpc, q) = IMO(dpc,q) = DMO(dpc,q) = infv;
+	  for (q = qb+1; q < Q;  q++) MMO(dpc, q) = IMO(dpc,q) = DMO(dpc,q) = infv;
+
+	  for (q = qa; q <= qb; q++)
+	    {
+	      sv  =                vec_and(vec_cmpgt(*tp, zerov), xBv);  tp++;
+	      sv  = vec_max(sv, vec_and(vec_cmpgt(*tp, zerov), mpv)); tp++;
+	      sv  = vec_max(sv, vec_and(vec_cmpgt(*tp, zerov), ipv)); tp++;
+	      sv  = vec_max(sv, vec_and(vec_cmpgt(*tp, zerov), dpv)); tp++;
+	      sv  = vec_add(sv, *ppp);                                      ppp += 2;
+	      xEv = vec_max(xEv, sv);
+
+	      mpv = MMO(dpp,q);
+	      dpv = DMO(dpp,q);
+	      ipv = IMO(dpp,q);
+
+	      MMO(dpc,q) = sv;
+	      DMO(dpc,q) = dcv;
+
+	      dcv = vec_and(vec_cmpgt(*tp, zerov), sv); tp++;
+
+	      sv         =                vec_and(vec_cmpgt(*tp, zerov), mpv);   tp++;
+	      sv         = vec_max(sv, vec_and(vec_cmpgt(*tp, zerov), ipv));  tp++;
+	      IMO(dpc,q) = vec_add(sv, *ppp);                                       ppp++;
+	    }
+
+	  /* D->D paths. A whole row wraps around the stripe as in
+	   * p7_OptimalAccuracy(); a narrower band doesn't wrap, so one
+	   * pass along it is complete.
+	   */
+	  tp = om->tfv + 7*Q + qa;
+	  if (qa == 0 && qb == Q-1)
+	    {
+	      dcv = vec_sld(infv, dcv, 12);
+	      for (q = 0; q < Q; q++)
+		{
+		  DMO(dpc, q) = vec_max(dcv, DMO(dpc, q));
+		  dcv         = vec_and(vec_cmpgt(*tp, zerov), DMO(dpc,q));   tp++;
+		}
+	      for (j = 1; j < 4; j++)
+		{
+		  dcv = vec_sld(infv, dcv, 12);
+		  tp  = om->tfv + 7*Q;
+		  for (q = 0; q < Q; q++)
+		    {
+		      DMO(dpc, q) = vec_max(dcv, DMO(dpc, q));
+		      dcv         = vec_and(vec_cmpgt(*tp, zerov), dcv);   tp++;
+		    }
+		}
+	    }
+	  else
+	    {
+	      dcv = infv;
+	      for (q = qa; q <= qb; q++)
+		{
+		  DMO(dpc, q) = vec_max(dcv, DMO(dpc, q));
+		  dcv         = vec_and(vec_cmpgt(*tp, zerov), DMO(dpc,q));   tp++;
+		}
+	    }
+
+	  /* D->E paths */
+	  for (q = qa; q <= qb; q++) xEv = vec_max(xEv, DMO(dpc,q));
+	  XMXo(i,p7X_E) = esl_vmx_hmax_float(xEv);
+
+	  if (i == ib && ++g < bnd->nseg) { ia = bnd_ip[2*g]; ib = bnd_ip[2*g+1]; }
+	  else if (i == ib)               { ia = L+1; }
+	}
+
+      /* Specials, as in p7_OptimalAccuracy() */
+      t1 = ( (om->xf[p7O_J][p7O_LOOP] == 0.0) ? 0.0 : ox->xmx[(i-1)*p7X_NXCELLS+p7X_J] + pp->xmx[i*p7X_NXCELLS+p7X_J]);
+      t2 = ( (om->xf[p7O_E][p7O_LOOP] == 0.0) ? 0.0 : ox->xmx[   i *p7X_NXCELLS+p7X_E]);
+      ox->xmx[i*p7X_NXCELLS+p7X_J] = ESL_MAX(t1, t2);
+
+      t1 = ( (om->xf[p7O_C][p7O_LOOP] == 0.0) ? 0.0 : ox->xmx[(i-1)*p7X_NXCELLS+p7X_C] + pp->xmx[i*p7X_NXCELLS+p7X_C]);
+      t2 = ( (om->xf[p7O_E][p7O_MOVE] == 0.0) ? 0.0 : ox->xmx[   i *p7X_NXCELLS+p7X_E]);
+      ox->xmx[i*p7X_NXCELLS+p7X_C] = ESL_MAX(t1, t2);
+      
+      ox->xmx[i*p7X_NXCELLS+p7X_N] = ((om->xf[p7O_N][p7O_LOOP] == 0.0) ? 0.0 : ox->xmx[(i-1)*p7X_NXCELLS+p7X_N] + pp->xmx[i*p7X_NXCELLS+p7X_N]);
+      
+      t1 = ( (om->xf[p7O_N][p7O_MOVE] == 0.0) ? 0.0 : ox->xmx[i*p7X_NXCELLS+p7X_N]);
+      t2 = ( (om->xf[p7O_J][p7O_MOVE] == 0.0) ? 0.0 : ox->xmx[i*p7X_NXCELLS+p7X_J]);
+      ox->xmx[i*p7X_NXCELLS+p7X_B] = ESL_MAX(t1, t2);
+    }
+
+  *ret_e = ox->xmx[pp->L*p7X_NXCELLS+p7X_C];
+  return eslOK;
+}
 /*------------------- end, OA DP fill ---------------------------*/
 
 
@@ -737,6 +942,82 @@ utest_optacc(ESL_GETOPTS *go, ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, i
   p7_hmm_Destroy(hmm);
 }
 
+/* utest_banded()
+ * 
+ * With bands that cover the whole matrix, p7_OptimalAccuracyBanded()
+ * finds the same score and trace as p7_OptimalAccuracy(). With the
+ * posterior bands from p7_BackwardCheckpointed(), its trace is valid
+ * and its score no better than the unbanded one.
+ */
+static void
+utest_banded(ESL_RANDOMNESS *r, ESL_ALPHABET *abc, P7_BG *bg, int M, int L, int N)
+{
+  char        *msg = "banded optimal accuracy unit test failed";
+  P7_HMM      *hmm = NULL;
+  P7_PROFILE  *gm  = NULL;
+  P7_OPROFILE *om  = NULL;
+  ESL_SQ      *sq  = esl_sq_CreateDigital(abc);
+  P7_OMX      *ox1 = p7_omx_Create(M, L, L);
+  P7_OMX      *ox2 = p7_omx_Create(M, L, L);
+  P7_OMXCHK   *chk = p7_omxchk_Create(M, L, ESL_MBYTES(32));
+  P7_GBANDS   *bnd = p7_gbands_Create();
+  P7_GBANDS   *all = p7_gbands_Create();
+  P7_TRACE    *tr1 = p7_trace_CreateWithPP();
+  P7_TRACE    *tr2 = p7_trace_CreateWithPP();
+  float        fsc, accscore1, accscore2;
+  int          i;
+
+  if (p7_oprofile_Sample(r, abc, bg, M, L, &hmm, &gm, &om)!= eslOK) esl_fatal(msg);
+  while (N--)
+    {
+      if (p7_ProfileEmit(r, hmm, gm, bg, sq, NULL)       != eslOK) esl_fatal(msg);
+
+      if (p7_omx_GrowTo(ox1, M, sq->n, sq->n)            != eslOK) esl_fatal(msg);
+      if (p7_omx_GrowTo(ox2, M, sq->n, sq->n)            != eslOK) esl_fatal(msg);
+      if (p7_omxchk_GrowTo(chk, M, sq->n)                != eslOK) esl_fatal(msg);
+
+      if (p7_ForwardCheckpointed (sq->dsq, sq->n, om, chk, &fsc)           != eslOK) esl_fatal(msg);
+      if (p7_BackwardCheckpointed(sq->dsq, sq->n, om, chk, ox2, bnd, NULL) != eslOK) esl_fatal(msg);
+      if (p7_OptimalAccuracy(om, ox2, ox1, &accscore1)   != eslOK) esl_fatal(msg);
+      if (p7_OATrace(om, ox2, ox1, tr1)                  != eslOK) esl_fatal(msg);
+
+      for (i = 1; i <= sq->n; i++) 
+	if (p7_gbands_Append(all, i, 1, M)               != eslOK) esl_fatal(msg);
+      all->L = sq->n;
+      all->M = M;
+      if (p7_OptimalAccuracyBanded(om, ox2, all, ox1, &accscore2) != eslOK) esl_fatal(msg);
+      if (p7_OATrace(om, ox2, ox1, tr2)                  != eslOK) esl_fatal(msg);
+      if (accscore1 != accscore2)                                  esl_fatal(msg);
+      if (p7_trace_Compare(tr1, tr2, 0.0)                != eslOK) esl_fatal(msg);
+      p7_trace_Reuse(tr2);
+
+      if (bnd->nrow > 0)
+	{
+	  if (p7_OptimalAccuracyBanded(om, ox2, bnd, ox1, &accscore2) != eslOK) esl_fatal(msg);
+	  if (p7_OATrace(om, ox2, ox1, tr2)                  != eslOK) esl_fatal(msg);
+	  if (p7_trace_Validate(tr2, abc, sq->dsq, NULL)     != eslOK) esl_fatal(msg);
+	  if (accscore2 > accscore1 + 0.0001)                          esl_fatal(msg);
+	}
+
+      esl_sq_Reuse(sq);
+      p7_gbands_Reuse(bnd);
+      p7_gbands_Reuse(all);
+      p7_trace_Reuse(tr1);
+      p7_trace_Reuse(tr2);
+    }
+
+  p7_trace_Destroy(tr1);
+  p7_trace_Destroy(tr2);
+  p7_gbands_Destroy(all);
+  p7_gbands_Destroy(bnd);
+  p7_omxchk_Destroy(chk);
+  p7_omx_Destroy(ox2);
+  p7_omx_Destroy(ox1);
+  esl_sq_Destroy(sq);
+  p7_oprofile_Destroy(om);
+  p7_profile_Destroy(gm);
+  p7_hmm_Destroy(hmm);
+}
 #endif /*p7OPTACC_TESTDRIVE*/
 /*------------------- end, unit tests ---------------------------*/
 
@@ -820,6 +1101,10 @@ main(int argc, char **argv)
   utest_optacc(go, r, abc, bg, 1, L, 10);  
   utest_optacc(go, r, abc, bg, M, 1, 10);  
 
+  utest_banded(r, abc, bg, M,   L, N);
+  utest_banded(r, abc, bg, 200, L, N);	/* longer stripes: more bands narrower than one */
+  utest_banded(r, abc, bg, 1,   L, 10);
+
   esl_alphabet_Destroy(abc);
   p7_bg_Destroy(bg);
 
@@ -52,7 +52,7 @@ typedef struct {
 
 #if defined (HMMER_THREADS) && defined (HMMER_MPI)
 #define CPUOPTS     "--mpi"
-#define MPIOPTS     "--cpu"
+#define MPIOPTS     "--cpu,--tcache"
 #else
 #define CPUOPTS     NULL
 #define MPIOPTS     NULL
@@ -137,6 +137,7 @@ static ESL_OPTIONS options[] = {
   { "--seed",       eslARG_INT,          "42", NULL, "n>=0",    NULL,    NULL,  NULL,            "set RNG seed to <n> (if 0: one-time arbitrary seed)",         12 },
   { "--qformat",    eslARG_STRING,       NULL, NULL, NULL,      NULL,    NULL,  NULL,            "assert query <seqfile> is in format <s>: no autodetection",   12 },
   { "--tformat",    eslARG_STRING,       NULL, NULL, NULL,      NULL,    NULL,  NULL,            "assert target <seqdb> is in format <s>>: no autodetection",   12 },
+  { "--tcache",     eslARG_NONE,        FALSE, NULL, NULL,      NULL,    NULL,  NULL,            "read <seqdb> into memory once, for all rounds and queries",   12 },
 
 #ifdef HMMER_THREADS
   { "--cpu",        eslARG_INT,      p7_NCPU,"HMMER_NCPU","n>=0", NULL,    NULL,  CPUOPTS,       "number of parallel CPU workers to use for multithreads",      12 },
@@ -168,11 +169,11 @@ struct cfg_s {
 
 
 static int  serial_master(ESL_GETOPTS *go, struct cfg_s *cfg);
-static int  serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp);
+static int  serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, P7_TARGETCACHE *tcache);
 #ifdef HMMER_THREADS
 #define BLOCK_SIZE 1000
 
-static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp);
+static int  thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, P7_TARGETCACHE *tcache);
 static void pipeline_thread(void *arg);
 #endif 
 
@@ -353,6 +354,7 @@ output_header(FILE *ofp, ESL_GETOPTS *go, char *qfile, char *dbfile)
     }
   if (esl_opt_IsUsed(go, "--qformat")    && fprintf(ofp, "# query <seqfile> format asserted: %s\n",             esl_opt_GetString(go, "--qformat"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
   if (esl_opt_IsUsed(go, "--tformat")    && fprintf(ofp, "# target <seqdb> format asserted:  %s\n",             esl_opt_GetString(go, "--tformat"))   < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
+  if (esl_opt_IsUsed(go, "--tcache")     && fprintf(ofp, "# target seqs cached in memory:    yes\n")                                                  < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #ifdef HMMER_THREADS
   if (esl_opt_IsUsed(go, "--cpu")        && fprintf(ofp, "# number of worker threads:        %d\n",             esl_opt_GetInteger(go, "--cpu"))      < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed");
 #endif
@@ -435,6 +437,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   int              dbformat = eslSQFILE_UNKNOWN;  /* format of dbfile                                */
   ESL_SQFILE      *qfp      = NULL;		  /* open qfile                                      */
   ESL_SQFILE      *dbfp     = NULL;               /* open dbfile                                     */
+  P7_TARGETCACHE  *tcache   = NULL;               /* <dbfp> held in memory (--tcache)                */
   ESL_ALPHABET    *abc      = NULL;               /* sequence alphabet                               */
   P7_BG           *bg       = NULL;		  /* null model                                      */
   P7_BUILDER      *bld      = NULL;               /* HMM construction configuration                  */
@@ -512,7 +515,14 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   else if (status == eslEINVAL)    p7_Fail("Can't autodetect format of a stdin or .gz seqfile");
   else if (status != eslOK)        p7_Fail("Unexpected error %d opening target sequence database file %s\n", status, cfg->dbfile);
   
-  if (! esl_sqfile_IsRewindable(dbfp)) 
+  /* With --tcache, the target db is read once, here; otherwise it's reread in each round */
+  if (esl_opt_GetBoolean(go, "--tcache"))
+    {
+      status = p7_targetcache_Read(dbfp, -1, &tcache);
+      if      (status == eslEFORMAT) p7_Fail("Parse failed (sequence file %s):\n%s\n", dbfp->filename, esl_sqfile_GetErrorBuf(dbfp));
+      else if (status != eslOK)      p7_Fail("Unexpected error %d caching sequence file %s", status, dbfp->filename);
+    }
+  else if (! esl_sqfile_IsRewindable(dbfp)) 
     p7_Fail("Target sequence file %s isn't rewindable; jackhmmer requires that it is", cfg->dbfile);
 
   /* Open the query sequence file  */
@@ -644,10 +654,10 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	    }
 
 #ifdef HMMER_THREADS
-	  if (ncpus > 0) sstatus = thread_loop(threadObj, queue, dbfp);
-	  else           sstatus = serial_loop(info, dbfp);
+	  if (ncpus > 0) sstatus = thread_loop(threadObj, queue, dbfp, tcache);
+	  else           sstatus = serial_loop(info, dbfp, tcache);
 #else
-	  sstatus = serial_loop(info, dbfp);
+	  sstatus = serial_loop(info, dbfp, tcache);
 #endif
 	  switch(sstatus)
 	    {
@@ -712,7 +722,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
 	  else if (iteration < maxiterations)
 	    { if (fprintf(ofp, "@@ Continuing to next round.\n\n")           < 0) ESL_EXCEPTION_SYS(eslEWRITE, "write failed"); }
 
-	  esl_sqfile_Position(dbfp, 0);
+	  if (! tcache) esl_sqfile_Position(dbfp, 0);
 	} /* end iteration loop */
 
       /* Because we destroy/create the hitlist, om, pipeline, and msa above, rather than create/destroy,
@@ -743,7 +753,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
       p7_trace_Destroy(qtr);
       esl_sq_Reuse(qsq);
       esl_keyhash_Reuse(kh);
-      esl_sqfile_Position(dbfp, 0);
+      if (! tcache) esl_sqfile_Position(dbfp, 0);
     }
   if      (qstatus == eslEFORMAT) p7_Fail("Parse failed (sequence file %s):\n%s\n",
 					    qfp->filename, esl_sqfile_GetErrorBuf(qfp));
@@ -775,6 +785,7 @@ serial_master(ESL_GETOPTS *go, struct cfg_s *cfg)
   free(info);
 
   esl_keyhash_Destroy(kh);
+  p7_targetcache_Destroy(tcache);
   esl_sqfile_Close(qfp);
   esl_sqfile_Close(dbfp);
   esl_sq_Destroy(qsq);  
@@ -1600,17 +1611,27 @@ checkpoint_msa(int nquery, ESL_MSA *msa, char *basename, int iteration)
 
 }
 
+/* serial_loop()
+ * Search the target seqs, read from <dbfp> or, if <tcache> isn't NULL,
+ * copied out of the cache.
+ */
 static int
-serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp)
+serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp, P7_TARGETCACHE *tcache)
 {
   int      sstatus;
   ESL_SQ   *dbsq     = NULL;   /* one target sequence (digital)  */
+  int64_t  seq_cnt   = 0;
 
   dbsq = esl_sq_CreateDigital(info->om->abc);
 
   /* Main loop: */
-  while ((sstatus = esl_sqio_Read(dbfp, dbsq)) == eslOK)
+  while (TRUE)
     {
+      if (tcache) sstatus = (seq_cnt < tcache->nseq) ? p7_targetcache_GetSeq(tcache, seq_cnt, dbsq) : eslEOF;
+      else        sstatus = esl_sqio_Read(dbfp, dbsq);
+      if (sstatus != eslOK) break;
+      seq_cnt++;
+
       p7_pli_NewSeq(info->pli, dbsq);
       p7_bg_SetLength(info->bg, dbsq->n);
       p7_oprofile_ReconfigLength(info->om, dbsq->n);
@@ -1628,11 +1649,12 @@ serial_loop(WORKER_INFO *info, ESL_SQFILE *dbfp)
 
 #ifdef HMMER_THREADS
 static int
-thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp)
+thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp, P7_TARGETCACHE *tcache)
 {
   int  status  = eslOK;
   int  sstatus = eslOK;
   int  eofCount = 0;
+  int64_t       tpos = 0;      /* next cached target seq, with <tcache> */
   ESL_SQ_BLOCK *block;
   void         *newBlock;
 
@@ -1646,7 +1668,8 @@ thread_loop(ESL_THREADS *obj, ESL_WORK_QUEUE *queue, ESL_SQFILE *dbfp)
   while (sstatus == eslOK)
     {
       block = (ESL_SQ_BLOCK *) newBlock;
-      sstatus = esl_sqio_ReadBlock(dbfp, block, -1, -1, /*max_init_window=*/FALSE, FALSE);
+      if (tcache) sstatus = p7_targetcache_GetBlock(tcache, &tpos, block);
+      else        sstatus = esl_sqio_ReadBlock(dbfp, block, -1, -1, /*max_init_window=*/FALSE, FALSE);
       if (sstatus == eslEOF)
 	{
 	  if (eofCount < esl_threads_GetWorkerCount(obj)) sstatus = eslOK;
@@ -25,6 +25,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
+#include <math.h>
 
 #ifndef HMMER_THREADS
 #error "Program requires pthreads be enabled."
@@ -107,6 +108,13 @@ typedef struct {
   int                 errors;
 } SEARCH_RESULTS;
 
+// Wall-clock time in seconds, used to timestamp queued commands
+static double queue_clock(){
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (double) now.tv_sec + (double) now.tv_usec / 1000000.0;
+}
+
 static P7_SERVER_QUEUE_DATA * p7_server_queue_data_Create(){
   P7_SERVER_QUEUE_DATA *query;
   int status;
@@ -124,6 +132,11 @@ static P7_SERVER_QUEUE_DATA * p7_server_queue_data_Create(){
   query->dbx = 0;
   query->inx = 0;
   query->cnt = 0;
+  query->key = NULL;
+  query->key_length = 0;
+  query->queued = queue_clock();
+  query->cost = 0.0;
+  query->next = NULL;
 
   return query;
 
@@ -149,9 +162,179 @@ static void p7_server_queue_data_Destroy(P7_SERVER_QUEUE_DATA *query){
   if(query->optsstring != NULL){
     free(query->optsstring);
   }
+  if(query->key != NULL){
+    free(query->key);
+  }
   free(query);
 }
 
+// p7_server_cache_Create
+/*! \brief Creates an empty result cache
+ *  \param [in] max_size The most memory, in bytes, that the cached keys and responses may take up
+ *  \returns The new cache.  Calls p7_Die() if unable to allocate memory
+ */
+static P7_SERVER_CACHE *p7_server_cache_Create(uint64_t max_size){
+  P7_SERVER_CACHE *cache = NULL;
+  int status;
+
+  ESL_ALLOC(cache, sizeof(P7_SERVER_CACHE));
+  cache->nbuckets = 1024;
+  ESL_ALLOC(cache->bucket, cache->nbuckets * sizeof(P7_SERVER_CACHE_ENTRY *));
+  for(int i = 0; i < cache->nbuckets; i++){
+    cache->bucket[i] = NULL;
+  }
+  cache->newest = cache->oldest = NULL;
+  cache->num_entries = 0;
+  cache->size = 0;
+  cache->max_size = max_size;
+  cache->hits = 0;
+  cache->misses = 0;
+  return cache;
+
+ERROR:
+  p7_Die("Unable to allocate memory in p7_server_cache_Create()\n");
+  return NULL; // Never get here, but silences compiler warning
+}
+
+// cache_hash
+// 64-bit FNV-1a hash of a cache key
+static uint64_t cache_hash(const char *key, uint32_t key_length){
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for(uint32_t i = 0; i < key_length; i++){
+    h ^= (uint8_t) key[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+// cache_Evict
+// Removes the least recently used entry from the cache and frees it
+static void cache_Evict(P7_SERVER_CACHE *cache){
+  P7_SERVER_CACHE_ENTRY *entry = cache->oldest;
+  P7_SERVER_CACHE_ENTRY **link = &(cache->bucket[entry->hash % cache->nbuckets]);
+
+  while(*link != entry){
+    link = &((*link)->bucket_next);
+  }
+  *link = entry->bucket_next;
+
+  cache->oldest = entry->newer;
+  if(cache->oldest != NULL) cache->oldest->older = NULL;
+  else                      cache->newest = NULL;
+
+  cache->size -= entry->key_length + entry->response_length;
+  cache->num_entries--;
+  free(entry->key);
+  free(entry->response);
+  free(entry);
+}
+
+// p7_server_cache_Destroy
+/*! \brief Frees a result cache and all of its entries
+ *  \param [in,out] cache The cache to be destroyed, which may be NULL
+ */
+static void p7_server_cache_Destroy(P7_SERVER_CACHE *cache){
+  if(cache == NULL) return;
+  while(cache->oldest != NULL){
+    cache_Evict(cache);
+  }
+  free(cache->bucket);
+  free(cache);
+}
+
+// p7_server_cache_Find
+/*! \brief Looks up the cached results of a search
+ *  \details Doesn't change the cache, so it can be used to check whether a queued search will be cheap to answer.  Use
+ *  p7_server_cache_Touch() on an entry that is used to answer a search.
+ *  \param [in] cache The cache
+ *  \param [in] key The search's cache key
+ *  \param [in] key_length The length of key, in bytes
+ *  \returns The matching entry, or NULL if the search's results aren't in the cache
+ */
+static P7_SERVER_CACHE_ENTRY *p7_server_cache_Find(P7_SERVER_CACHE *cache, const char *key, uint32_t key_length){
+  uint64_t h = cache_hash(key, key_length);
+  P7_SERVER_CACHE_ENTRY *entry;
+
+  for(entry = cache->bucket[h % cache->nbuckets]; entry != NULL; entry = entry->bucket_next){
+    if(entry->hash == h && entry->key_length == key_length && memcmp(entry->key, key, key_length) == 0){
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+// p7_server_cache_Touch
+// Makes <entry> the most recently used entry in the cache
+static void p7_server_cache_Touch(P7_SERVER_CACHE *cache, P7_SERVER_CACHE_ENTRY *entry){
+  if(entry == cache->newest) return;
+
+  // unlink, then put at the front of the list
+  entry->newer->older = entry->older;
+  if(entry->older != NULL) entry->older->newer = entry->newer;
+  else                     cache->oldest = entry->newer;
+
+  entry->older = cache->newest;
+  entry->newer = NULL;
+  cache->newest->newer = entry;
+  cache->newest = entry;
+}
+
+// p7_server_cache_Insert
+/*! \brief Adds the response to a search to the cache, evicting least recently used entries to make room
+ *  \details The response is the three buffers that forward_results() sends, in the order they're sent.  Takes ownership of
+ *  the query's key, setting query->key to NULL.  Does nothing if the search is already cached (two copies of it were queued
+ *  before either had run) or if the response alone would fill the cache.
+ *  \param [in,out] cache The cache
+ *  \param [in,out] query The search that was run
+ *  \param [in] status_buf,stats_buf,hits_buf Serialized HMMD_SEARCH_STATUS, HMMD_SEARCH_STATS and hits
+ *  \param [in] status_length,stats_length,hits_length Their lengths, in bytes
+ */
+static void p7_server_cache_Insert(P7_SERVER_CACHE *cache, P7_SERVER_QUEUE_DATA *query, const uint8_t *status_buf, uint32_t status_length,
+                                   const uint8_t *stats_buf, uint32_t stats_length, const uint8_t *hits_buf, uint32_t hits_length){
+  P7_SERVER_CACHE_ENTRY *entry = NULL;
+  uint64_t response_length = (uint64_t) status_length + stats_length + hits_length;
+  int status;
+
+  if(query->key_length + response_length > cache->max_size) return;
+  if(p7_server_cache_Find(cache, query->key, query->key_length) != NULL) return;
+
+  while(cache->size + query->key_length + response_length > cache->max_size){
+    cache_Evict(cache);
+  }
+
+  ESL_ALLOC(entry, sizeof(P7_SERVER_CACHE_ENTRY));
+  ESL_ALLOC(entry->response, response_length);
+  memcpy(entry->response, status_buf, status_length);
+  memcpy(entry->response + status_length, stats_buf, stats_length);
+  if(hits_length > 0){
+    memcpy(entry->response + status_length + stats_length, hits_buf, hits_length);
+  }
+  entry->response_length = response_length;
+  entry->key = query->key;
+  entry->key_length = query->key_length;
+  entry->hash = cache_hash(entry->key, entry->key_length);
+  query->key = NULL;
+  query->key_length = 0;
+
+  entry->bucket_next = cache->bucket[entry->hash % cache->nbuckets];
+  cache->bucket[entry->hash % cache->nbuckets] = entry;
+
+  entry->newer = NULL;
+  entry->older = cache->newest;
+  if(cache->newest != NULL) cache->newest->newer = entry;
+  else                      cache->oldest = entry;
+  cache->newest = entry;
+
+  cache->size += entry->key_length + entry->response_length;
+  cache->num_entries++;
+  return;
+
+ERROR:
+  // Not being able to cache a result isn't fatal
+  if(entry != NULL) free(entry);
+  return;
+}
+
 static void
 init_results(SEARCH_RESULTS *results)
 {
@@ -180,23 +363,96 @@ init_results(SEARCH_RESULTS *results)
   results->errors            = 0;
 }
 
-// Qsort comparison function to sort a list of pointers to P7_HITs
-static int
-hit_sorter2(const void *p1, const void *p2)
+/* Returns the lowest sortkey a hit can have and still be reported by
+ * a search with pipeline thresholds <pli> and search space <Z> (0 if
+ * not known yet), or -infinity if the reporting threshold isn't on
+ * the quantity hits are sorted by: -lnP when inclusion is by E-value,
+ * bit score otherwise (see p7_Pipeline()). The cutoff is a little
+ * generous; p7_tophits_Threshold() still makes the exact call on the
+ * hits that are kept. Domains are only reported in reported targets,
+ * so domZ doesn't enter into it.
+ */
+static double
+hit_sortkey_floor(const P7_PIPELINE *pli, double Z)
 {
-  int cmp;
+  if (pli->use_bit_cutoffs || pli->long_targets) return -eslINFINITY;
 
-  const P7_HIT *h1 = *((P7_HIT **) p1);
-  const P7_HIT *h2 = *((P7_HIT **) p2);
+  if ( pli->by_E &&  pli->inc_by_E) return (Z > 0.) ? log(Z / pli->E) - 1e-4 : -eslINFINITY; // exp(lnP) * Z <= E
+  if (!pli->by_E && !pli->inc_by_E) return pli->T - 1e-4;
+  return -eslINFINITY;
+}
 
-  cmp  = (h1->sortkey < h2->sortkey);
-  cmp -= (h1->sortkey > h2->sortkey);
+// close_client
+/*! \brief Closes the connection to a client that we've sent results to
+ *  \details Signals the client that we're done writing, then waits for it to close the socket from its end, indicating that it's
+ *  read the data, or for CLIENT_TIMEOUT to expire, before closing the socket from ours.
+ *  \param [in] query The command whose client we're done with
+ */
+static void
+close_client(P7_SERVER_QUEUE_DATA *query)
+{
+  int fd = query->sock;
+  char buf[256];
+  int n;
+  ESL_STOPWATCH *timeout;  // want to timeout if client doesn't close socket connection
+  timeout = esl_stopwatch_Create();
+  esl_stopwatch_Start(timeout);
+  shutdown(fd, SHUT_WR); // signal the client that we're closing the socket
+  // wait for client to close socket from its end, indicating that it's read the data
+  // probably should have a timeout to thwart malicious clients
+  for(;;){
+    n = read(fd, buf, sizeof(buf));  // see if the client has closed the socket
+    if (n<0){ // something went wrong
+      p7_syslog(LOG_ERR,"[%s:%d] - closing %s error %d - %s\n", __FILE__, __LINE__, query->ip_addr, errno, strerror(errno));
+      break;
+    }
+    esl_stopwatch_Stop(timeout); // Looks like we should be able to call this many times on the same stopwatch
+    // to re-compute time since start call
+    if((n == 0) || esl_stopwatch_GetElapsed(timeout) > CLIENT_TIMEOUT){  // client closed socket or timeout 
+    //  elapsed
+      if(esl_stopwatch_GetElapsed(timeout) > CLIENT_TIMEOUT){
+        p7_syslog(LOG_ERR,"[%s:%d] - closing %s error due to timeout expiration\n", __FILE__, __LINE__, query->ip_addr);
+        printf("Closing socket due to client timeout");
+      }
+      break;
+    }
+  }
+  esl_stopwatch_Destroy(timeout);
+  close(fd); //terminate socket from our end
+}
+
+// send_cached_results
+/*! \brief Answers a search from the result cache, if its results are there
+ *  \param [in,out] cache The result cache, or NULL if caching is turned off
+ *  \param [in] query The search
+ *  \returns eslOK if the search was answered from the cache; eslFAIL if it has to be run
+ */
+static int
+send_cached_results(P7_SERVER_CACHE *cache, P7_SERVER_QUEUE_DATA *query)
+{
+  P7_SERVER_CACHE_ENTRY *entry;
 
-  return cmp;
+  if(cache == NULL || query->key == NULL) return eslFAIL;
+  if((entry = p7_server_cache_Find(cache, query->key, query->key_length)) == NULL){
+    cache->misses++;
+    return eslFAIL;
+  }
+  cache->hits++;
+  p7_server_cache_Touch(cache, entry);
+
+  if (writen(query->sock, entry->response, entry->response_length) != entry->response_length) {
+    p7_syslog(LOG_ERR,"[%s:%d] - writing %s error %d - %s\n", __FILE__, __LINE__, query->ip_addr, errno, strerror(errno));
+  }
+  else{
+    printf("Cached results for %s (%d) sent %" PRIu64 " bytes\n", query->ip_addr, query->sock, entry->response_length);
+    fflush(stdout);
+  }
+  close_client(query);
+  return eslOK;
 }
 
 static void
-forward_results(P7_SERVER_QUEUE_DATA *query, SEARCH_RESULTS *results)
+forward_results(P7_SERVER_CACHE *cache, P7_SERVER_QUEUE_DATA *query, SEARCH_RESULTS *results)
 {
   P7_TOPHITS         th;
   P7_PIPELINE        *pli   = NULL;
@@ -229,9 +485,7 @@ forward_results(P7_SERVER_QUEUE_DATA *query, SEARCH_RESULTS *results)
       if ((results->stats.hit_offsets = malloc(results->stats.nhits * sizeof(uint64_t))) == NULL) LOG_FATAL_MSG("malloc", errno);
     }
 
-    // sort the hits 
-    qsort(results->hits, results->stats.nhits, sizeof(P7_HIT *), hit_sorter2);
-
+    // the hits arrive sorted, from the k-way merge in process_search()
     th.unsrt     = NULL;
     th.N         = results->stats.nhits;
     th.nreported = 0;
@@ -277,9 +531,15 @@ forward_results(P7_SERVER_QUEUE_DATA *query, SEARCH_RESULTS *results)
   nalloc = 0;
   buf_offset = 0;
 
-  // First, the buffer of hits
+  // First, the buffer of hits.  Size it exactly before serializing, so it's allocated once rather than grown hit by hit
+  for(int i =0; i< results->stats.nhits; i++){
+    results->stats.hit_offsets[i] = nalloc;
+    nalloc += p7_hit_SerializedSize(results->hits[i]);
+  }
+  if(nalloc > 0){
+    if ((buf_ptr = malloc(nalloc)) == NULL) LOG_FATAL_MSG("malloc", errno);
+  }
   for(int i =0; i< results->stats.nhits; i++){
-    results->stats.hit_offsets[i] = buf_offset;
     if(p7_hit_Serialize(results->hits[i], buf, &buf_offset, &nalloc) != eslOK){
       LOG_FATAL_MSG("Serializing P7_HIT failed", errno);
     }
@@ -306,6 +566,11 @@ forward_results(P7_SERVER_QUEUE_DATA *query, SEARCH_RESULTS *results)
     LOG_FATAL_MSG("Serializing HMMD_SEARCH_STATUS failed", errno);
   }
 
+  // Keep a copy of the response so that repeats of this search can be answered without running it
+  if(cache != NULL && query->key != NULL){
+    p7_server_cache_Insert(cache, query, buf3_ptr, buf_offset3, buf2_ptr, buf_offset2, buf_ptr, buf_offset);
+  }
+
   // Now, send the buffers in the reverse of the order they were built
   /* send back a successful status message */
   n = buf_offset3;
@@ -334,33 +599,10 @@ forward_results(P7_SERVER_QUEUE_DATA *query, SEARCH_RESULTS *results)
   fflush(stdout);
 
  CLEAR:
-  // don't need to free the actual hits -- they'll get cleaned up when the tophits object they came from
-  // gets destroyed
+  // don't need to free the actual hits -- they live in the hit blocks of the runs they came from,
+  // which process_search() recycles
   if(results->nhits)  free(results->hits);  // init_results will set hits = NULL
-  ESL_STOPWATCH *timeout;  // want to timeout if client doesn't close socket connection
-  timeout = esl_stopwatch_Create();
-  esl_stopwatch_Start(timeout);
-  shutdown(fd, SHUT_WR); // signal the client that we're closing the socket
-  // wait for client to close socket from its end, indicating that it's read the data
-  // probably should have a timeout to thwart malicious clients
-  for(;;){
-    n = read(fd, buf2_ptr, buf_offset2);  // see if the client has closed the socket
-    if (n<0){ // something went wrong
-      p7_syslog(LOG_ERR,"[%s:%d] - closing %s error %d - %s\n", __FILE__, __LINE__, query->ip_addr, errno, strerror(errno));
-      break;
-    }
-    esl_stopwatch_Stop(timeout); // Looks like we should be able to call this many times on the same stopwatch
-    // to re-compute time since start call
-    if((n == 0) || esl_stopwatch_GetElapsed(timeout) > CLIENT_TIMEOUT){  // client closed socket or timeout 
-    //  elapsed
-      if(esl_stopwatch_GetElapsed(timeout) > CLIENT_TIMEOUT){
-        p7_syslog(LOG_ERR,"[%s:%d] - closing %s error due to timeout expiration\n", __FILE__, __LINE__, query->ip_addr);
-        printf("Closing socket due to client timeout");
-      }
-      break;
-    }
-  }
-  close(fd); //terminate socket from our end
+  close_client(query);
   if (pli)  p7_pipeline_Destroy(pli);
   if (hits) free(hits);
   if (dcl)  free(dcl);
@@ -542,6 +784,7 @@ process_ServerCmd(char *ptr, CLIENTSIDE_ARGS *data, ESL_GETOPTS *opts)
   parms->abc  = NULL;
   parms->opts = NULL;
   parms->dbx  = -1;
+  parms->queued = queue_clock();
 
   strcpy(parms->ip_addr, data->ip_addr);
   parms->sock       = fd;
@@ -561,6 +804,65 @@ process_ServerCmd(char *ptr, CLIENTSIDE_ARGS *data, ESL_GETOPTS *opts)
   free(cmd);
 }
 
+// cache_key
+/*! \brief Builds a search's result cache key: its options string, including the terminating NUL, followed by the query object
+ *  \details Query HMMs are keyed by the bytes the client sent.  Query sequences are keyed by sq_cache_key().
+ *  \param [in] opt_str The search's options string
+ *  \param [in] query_obj The query object's bytes
+ *  \param [in] query_length The length of query_obj, in bytes
+ *  \param [out] ret_length Returns the length of the key, in bytes
+ *  \returns The key, which the caller must free.  Calls p7_Die() if unable to allocate memory
+ */
+static char *cache_key(const char *opt_str, const void *query_obj, uint32_t query_length, uint32_t *ret_length){
+  uint32_t opt_length = strlen(opt_str) + 1;
+  char *key = NULL;
+  int status;
+
+  ESL_ALLOC(key, opt_length + query_length);
+  memcpy(key, opt_str, opt_length);
+  memcpy(key + opt_length, query_obj, query_length);
+  *ret_length = opt_length + query_length;
+  return key;
+
+ERROR:
+  p7_Die("Unable to allocate memory in cache_key()\n");
+  return NULL; // Never get here, but silences compiler warning
+}
+
+// sq_cache_key
+/*! \brief Builds the result cache key for a query sequence: its options string, then the sequence's name, accession and
+ *  description, each with its terminating NUL, then its digital residues
+ *  \details The cached results carry the query's name, accession and description, so two queries hit the same entry only
+ *  if all of these match as well as the residues.  Keying on digital residues still lets a query submitted in a different
+ *  case match.
+ *  \param [in] opt_str The search's options string
+ *  \param [in] sq The query sequence, in digital mode
+ *  \param [out] ret_length Returns the length of the key, in bytes
+ *  \returns The key, which the caller must free.  Calls p7_Die() if unable to allocate memory
+ */
+static char *sq_cache_key(const char *opt_str, const ESL_SQ *sq, uint32_t *ret_length){
+  uint32_t opt_length  = strlen(opt_str) + 1;
+  uint32_t name_length = strlen(sq->name) + 1;
+  uint32_t acc_length  = strlen(sq->acc)  + 1;
+  uint32_t desc_length = strlen(sq->desc) + 1;
+  uint32_t n           = 0;
+  char *key = NULL;
+  int status;
+
+  ESL_ALLOC(key, opt_length + name_length + acc_length + desc_length + sq->n);
+  memcpy(key + n, opt_str,    opt_length);  n += opt_length;
+  memcpy(key + n, sq->name,   name_length); n += name_length;
+  memcpy(key + n, sq->acc,    acc_length);  n += acc_length;
+  memcpy(key + n, sq->desc,   desc_length); n += desc_length;
+  memcpy(key + n, sq->dsq+1,  sq->n);       n += sq->n;
+  *ret_length = n;
+  return key;
+
+ERROR:
+  p7_Die("Unable to allocate memory in sq_cache_key()\n");
+  return NULL; // Never get here, but silences compiler warning
+}
+
 
 
 static void *clientside_thread(void *arg)  // new version that reads exactly one command from a client
@@ -595,6 +897,8 @@ static void *clientside_thread(void *arg)  // new version that reads exactly one
   int slen;
   uint64_t search_length=0;
   uint32_t command_length, serialized_command_length;
+  char              *key = NULL;         /* result cache key               */
+  uint32_t           key_length = 0;
 
  /* Future Nick: if you're ever tempted to switch this back to the old plan of reading until you see the "//" pattern, remmember that 
     that plan breaks on some serialized HMMs because the right set of bytes to be "//" appears in mid-structure.*/
@@ -731,6 +1035,7 @@ static void *clientside_thread(void *arg)  // new version that reads exactly one
       status = esl_sqio_Parse(ptr, strlen(ptr), seq, eslSQFILE_DAEMON);
       if (status != eslOK) client_msg_longjmp(data->sock_fd, status, &jmp_env, "Error parsing FASTA sequence");
       if (seq->n < 1) client_msg_longjmp(data->sock_fd, eslEFORMAT, &jmp_env, "Error: zero length FASTA sequence");
+      key = sq_cache_key(opt_str, seq, &key_length);
 
       if(data->masternode->database_shards[dbx-1]->data_type == AMINO){
         bg = p7_bg_Create(abc); // need this to build the HMM
@@ -789,6 +1094,7 @@ static void *clientside_thread(void *arg)  // new version that reads exactly one
         if (status != eslOK) client_msg_longjmp(data->sock_fd, status, &jmp_env, "Error deserializing query sequence");
         if (seq->n < 1) client_msg_longjmp(data->sock_fd, eslEFORMAT, &jmp_env, "Error: zero length FASTA sequence");
       }
+      key = sq_cache_key(opt_str, seq, &key_length);
       if(data->masternode->database_shards[dbx-1]->data_type == AMINO){
         bg = p7_bg_Create(abc); // need this to build the HMM
         search_type = HMMD_CMD_SEARCH;
@@ -871,6 +1177,7 @@ static void *clientside_thread(void *arg)  // new version that reads exactly one
       /* no idea what we are trying to parse */
       client_msg_longjmp(data->sock_fd, eslEFORMAT, &jmp_env, "Unknown query sequence/hmm format");
     }
+    if (key == NULL) key = cache_key(opt_str, ptr, command_length - (ptr - buffer), &key_length);  // query is an HMM
 
   } else {
     /* an error occured some where, so try to clean up */
@@ -879,6 +1186,7 @@ static void *clientside_thread(void *arg)  // new version that reads exactly one
     if (hmm  != NULL) p7_hmm_Destroy(hmm);
     if (seq  != NULL) esl_sq_Destroy(seq);
     if (sco  != NULL) esl_scorematrix_Destroy(sco);
+    if (key  != NULL) free(key);
 
     free(buffer);
     close(data->sock_fd);
@@ -893,6 +1201,8 @@ static void *clientside_thread(void *arg)  // new version that reads exactly one
   parms->opts = opts;
   parms->dbx  = dbx - 1;
   parms->optsstring = opt_str;
+  parms->key = key;
+  parms->key_length = key_length;
   parms->cnt = search_length;
   strcpy(parms->ip_addr, data->ip_addr);
   parms->sock       = data->sock_fd;
@@ -1030,7 +1340,15 @@ P7_SERVER_MASTERNODE_STATE *p7_server_masternode_Create(uint32_t num_shards, int
   }
 
   // We start off with no hits reported
-  the_node->tophits = p7_tophits_Create();
+  the_node->hit_run_pool = NULL;
+  the_node->num_hit_runs = 0;
+  the_node->hit_sortkey_floor = -eslINFINITY;
+
+  // Result caching is turned on by p7_server_master_node_main(), if requested
+  the_node->result_cache = NULL;
+
+  // A guess at search throughput until the first search has been timed
+  the_node->cells_per_second = 1.0e9;
 
   the_node->num_worker_nodes = num_worker_nodes;
 
@@ -1068,7 +1386,7 @@ P7_SERVER_MASTERNODE_STATE *p7_server_masternode_Create(uint32_t num_shards, int
   if(pthread_mutex_init(&(the_node->hit_thread_start_lock), &mutex_type)){
       p7_Fail("Unable to create mutex in p7_server_masternode_Create");
   }
-  if(pthread_mutex_init(&(the_node->master_tophits_lock), &mutex_type)){
+  if(pthread_mutex_init(&(the_node->hit_run_pool_lock), &mutex_type)){
       p7_Fail("Unable to create mutex in p7_server_masternode_Create");
   }
  if(pthread_mutex_init(&(the_node->worker_nodes_done_lock), &mutex_type)){
@@ -1117,6 +1435,15 @@ void p7_server_masternode_Destroy(P7_SERVER_MASTERNODE_STATE *masternode){
     p7_server_message_Destroy(current);
     current = next;
   }
+
+  current = (P7_SERVER_MESSAGE *) masternode->hit_run_pool;
+  while(current != NULL){
+    next = current->next;
+    p7_server_message_Destroy(current);
+    current = next;
+  }
+
+  p7_server_cache_Destroy(masternode->result_cache);
   
   // clean up the pthread mutexes
   pthread_mutex_destroy(&(masternode->empty_hit_message_pool_lock));
@@ -1128,7 +1455,6 @@ void p7_server_masternode_Destroy(P7_SERVER_MASTERNODE_STATE *masternode){
   }
   free(masternode->work_queues);
   
-  p7_tophits_Destroy(masternode->tophits);
   // and finally, the base object
   free(masternode);
 }
@@ -1178,6 +1504,13 @@ void p7_server_masternode_Setup(uint32_t num_shards, uint32_t num_databases, cha
         p7_Fail("Unable to allocate memory in p7_server_masternode_Create\n");
       }
     }
+    else if(!strncmp(id_string, p7_SHARD_PREPARED_MAGIC, strlen(p7_SHARD_PREPARED_MAGIC))){
+      // its a prepared shard file
+      current_shard = p7_shard_Open_prepared(database_names[i], 1, 0, 1);
+      if(current_shard == NULL){
+        p7_Fail("Unable to allocate memory in p7_server_masternode_Create\n");
+      }
+    }
     else{
       p7_Fail("Couldn't determine type of datafile for database %s in p7_server_masternode_setup\n", database_names[i]);
     }
@@ -1207,10 +1540,12 @@ P7_SERVER_MESSAGE *p7_server_message_Create(){
 
     // Allocatte the base structure
     ESL_ALLOC(the_message, sizeof(P7_SERVER_MESSAGE));
-    the_message->tophits = NULL;
     the_message->next = NULL;
     the_message->buffer_alloc = 1024;
     ESL_ALLOC(the_message->buffer, the_message->buffer_alloc);
+    if((the_message->hitblock = p7_hitblock_Create()) == NULL){
+      goto ERROR;
+    }
     return the_message;
 ERROR:
   p7_Fail("Unable to allocate memory in p7_server_message_Create");  
@@ -1220,9 +1555,7 @@ ERROR:
 // p7_server_message_Destroy()
 // Frees the memory in a p7_server_message object
 void p7_server_message_Destroy(P7_SERVER_MESSAGE *message){
-  if(message->tophits){
-    p7_tophits_Destroy(message->tophits);
-  }
+  p7_hitblock_Destroy(message->hitblock);
   if(message->buffer){
     free(message->buffer);
   }
@@ -1297,7 +1630,7 @@ int process_search(P7_SERVER_MASTERNODE_STATE *masternode, P7_SERVER_QUEUE_DATA
   masternode->hit_messages_received = 0;
   gettimeofday(&start, NULL);
   
-  uint64_t search_length;
+  uint64_t search_length = 0; // only known up front when we search the whole database
   if (esl_opt_IsUsed(query->opts, "--db_ranges")){
     for(int which_shard = 0; which_shard< masternode->num_shards; which_shard++){ // create work queue for each shard
       char *orig_range_string = esl_opt_GetString(query->opts, "--db_ranges");
@@ -1466,6 +1799,14 @@ int process_search(P7_SERVER_MASTERNODE_STATE *masternode, P7_SERVER_QUEUE_DATA
     parse_lock_errors(lock_retval);
   #endif
   masternode->worker_stats_received = 0; // and none have sent pipeline statistics
+
+  // Every target in the search is counted once, so when we search the whole database, Z is known before any hits arrive
+  if(masternode->pipeline->Z_setby == p7_ZSETBY_OPTION){
+    masternode->hit_sortkey_floor = hit_sortkey_floor(masternode->pipeline, masternode->pipeline->Z);
+  }
+  else{
+    masternode->hit_sortkey_floor = hit_sortkey_floor(masternode->pipeline, (double) search_length);
+  }
   pthread_cond_broadcast(&(masternode->start)); // signal hit processing thread to start
   lock_retval = pthread_mutex_unlock(&(masternode->hit_wait_lock));
   #ifdef CHECK_MUTEXES
@@ -1511,6 +1852,11 @@ int process_search(P7_SERVER_MASTERNODE_STATE *masternode, P7_SERVER_QUEUE_DATA
 
   double elapsed_time = ((double)((end.tv_sec * 1000000 + (end.tv_usec)) - (start.tv_sec * 1000000 + start.tv_usec)))/1000000.0;
 
+  // Fold this search's throughput into the running estimate that the scheduler uses to predict run times
+  if(query->cost > 0.0 && elapsed_time > 0.0){
+    masternode->cells_per_second = 0.75 * masternode->cells_per_second + 0.25 * (query->cost / elapsed_time);
+  }
+
 #ifdef PRINT_PERF
   double ncells;
   if(query->cmd_type == HMMD_CMD_SEARCH){
@@ -1527,17 +1873,41 @@ int process_search(P7_SERVER_MASTERNODE_STATE *masternode, P7_SERVER_QUEUE_DATA
     printf("%s, %lf, %ld, %lf\n", query->seq->name, elapsed_time, query->seq->L, gcups);
   }
 #endif
-  //Send results back to client
-  results.nhits = masternode->tophits->N;
-  results.stats.nhits = masternode->tophits->N;
-  results.stats.hit_offsets = NULL;
-  if (results.nhits > 0){
-    ESL_ALLOC(results.hits, results.nhits *sizeof(P7_HIT *));
+  //Merge the workers' sorted runs of hits, which the hit thread has finished with, now that we know Z.
+  lock_retval = pthread_mutex_lock(&(masternode->hit_run_pool_lock));
+  #ifdef CHECK_MUTEXES
+    parse_lock_errors(lock_retval);
+  #endif
+  P7_HITBLOCK **runs = NULL;
+  P7_SERVER_MESSAGE *run_message;
+  uint64_t run_hits = 0, merged_hits = 0;
+  int which_run = 0;
+  ESL_ALLOC(runs, (masternode->num_hit_runs + 1) * sizeof(P7_HITBLOCK *));
+  for(run_message = masternode->hit_run_pool; run_message != NULL; run_message = run_message->next){
+    runs[which_run++] = run_message->hitblock;
+    run_hits += run_message->hitblock->N;
+  }
+  lock_retval = pthread_mutex_unlock(&(masternode->hit_run_pool_lock));
+  #ifdef CHECK_MUTEXES
+    parse_lock_errors(lock_retval);
+  #endif
+  results.hits = NULL;
+  if (run_hits > 0){
+    ESL_ALLOC(results.hits, run_hits *sizeof(P7_HIT *));
   }
-  int counter;
-  for(counter = 0; counter <results.nhits; counter++){
-    results.hits[counter] =masternode->tophits->unsrt + counter;
+  if(p7_hitblock_MergeRuns(runs, which_run, hit_sortkey_floor(masternode->pipeline, masternode->pipeline->Z), results.hits, &merged_hits) != eslOK){
+    p7_Fail("Unable to merge hits in process_search\n");
   }
+  free(runs);
+  if(merged_hits == 0 && results.hits != NULL){
+    free(results.hits);
+    results.hits = NULL;
+  }
+
+  //Send results back to client
+  results.nhits = merged_hits;
+  results.stats.nhits = merged_hits;
+  results.stats.hit_offsets = NULL;
 
   //Put pipeline statistics in results
   results.stats.elapsed = elapsed_time;
@@ -1563,18 +1933,36 @@ int process_search(P7_SERVER_MASTERNODE_STATE *masternode, P7_SERVER_QUEUE_DATA
   results.stats.n_past_bias = masternode->pipeline->n_past_bias;
   results.stats.n_past_vit = masternode->pipeline->n_past_vit;
   results.stats.n_past_fwd = masternode->pipeline->n_past_fwd;
-  results.stats.nreported = masternode->tophits->nreported;
-  results.stats.nincluded = masternode->tophits->nincluded;
+  results.stats.nreported = 0; // set by forward_results()
+  results.stats.nincluded = 0;
 
-  forward_results(query, &results); 
+  forward_results(masternode->result_cache, query, &results); 
   p7_pipeline_Destroy(masternode->pipeline);
-  lock_retval = pthread_mutex_lock(&(masternode->master_tophits_lock));
+
+  // The results have been sent, so the runs' hit blocks can be reused
+  lock_retval = pthread_mutex_lock(&(masternode->hit_run_pool_lock));
+  #ifdef CHECK_MUTEXES
+    parse_lock_errors(lock_retval);
+  #endif
+  if(masternode->hit_run_pool != NULL){
+    P7_SERVER_MESSAGE *last = (P7_SERVER_MESSAGE *) masternode->hit_run_pool;
+    while(last->next != NULL){
+      last = last->next;
+    }
+    lock_retval = pthread_mutex_lock(&(masternode->empty_hit_message_pool_lock));
   #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval);
   #endif
-  p7_tophits_Destroy(masternode->tophits);
-  masternode->tophits = p7_tophits_Create();
-  lock_retval = pthread_mutex_unlock(&(masternode->master_tophits_lock));
+    last->next = (P7_SERVER_MESSAGE *) masternode->empty_hit_message_pool;
+    masternode->empty_hit_message_pool = masternode->hit_run_pool;
+    masternode->hit_run_pool = NULL;
+    lock_retval = pthread_mutex_unlock(&(masternode->empty_hit_message_pool_lock));
+  #ifdef CHECK_MUTEXES
+    parse_lock_errors(lock_retval);
+  #endif
+  }
+  masternode->num_hit_runs = 0;
+  lock_retval = pthread_mutex_unlock(&(masternode->hit_run_pool_lock));
     #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval);
   #endif
@@ -1711,6 +2099,17 @@ void process_contents(P7_SERVER_MASTERNODE_STATE *masternode, P7_SERVER_QUEUE_DA
     strcat(header, nextline);
     free(nextline);
   }
+  char cacheline[256];
+  if(masternode->result_cache != NULL){
+    snprintf(cacheline, 256, "Result cache: %d entries, %" PRIu64 " bytes, %" PRIu64 " hits, %" PRIu64 " misses\n", masternode->result_cache->num_entries,
+      masternode->result_cache->size, masternode->result_cache->hits, masternode->result_cache->misses);
+  }
+  else{
+    snprintf(cacheline, 256, "Result cache: off\n");
+  }
+  headlength += strlen(cacheline);
+  ESL_REALLOC(header, headlength);
+  strcat(header, cacheline);
   HMMD_SEARCH_STATUS sstatus;
   sstatus.status = eslOK;
   sstatus.type = HMMD_CMD_CONTENTS;
@@ -1763,6 +2162,98 @@ void process_contents(P7_SERVER_MASTERNODE_STATE *masternode, P7_SERVER_QUEUE_DA
     }
 #endif
 }
+
+// queue_command
+/*! \brief Adds a command that a clientside thread queued to the master node's list of pending commands, in arrival order
+ *  \details The command stack is LIFO, and commands can be pushed onto it while the master drains it, so commands are placed by
+ *  the time they arrived rather than the order they come off the stack.  For searches, also estimates the work the search will take, in DP cells: the query length times the residues (for a search)
+ *  or model positions (for a scan) in the part of the database it covers.
+ *  \param [in] masternode The master node's state object
+ *  \param [in,out] pending The list of pending commands, in arrival order
+ *  \param [in] query The command to add
+ */
+static void queue_command(P7_SERVER_MASTERNODE_STATE *masternode, P7_SERVER_QUEUE_DATA **pending, P7_SERVER_QUEUE_DATA *query){
+  if(query->cmd_type == HMMD_CMD_SEARCH || query->cmd_type == HMMD_CMD_SCAN){
+    P7_SHARD *shard = masternode->database_shards[query->dbx];
+    double query_length = (query->hmm != NULL) ? (double) query->hmm->M : (double) query->seq->L;
+    double fraction = (shard->num_objects > 0) ? (double) query->cnt / (double) shard->num_objects : 1.0;
+    query->cost = query_length * (double) shard->total_length * fraction;
+    if(masternode->result_cache != NULL && query->key != NULL &&
+       p7_server_cache_Find(masternode->result_cache, query->key, query->key_length) != NULL){
+      query->cost = 0.0; // will be answered from the result cache, unless it's evicted first
+    }
+  }
+  while(*pending != NULL && (*pending)->queued <= query->queued){
+    pending = &((*pending)->next);
+  }
+  query->next = *pending;
+  *pending = query;
+}
+
+// next_command
+/*! \brief Removes the command the master node should run next from its list of pending commands
+ *  \details Only commands that arrived before any pending shutdown are eligible, so a shutdown waits for the searches queued ahead of
+ *  it; it runs once none are left.  Contents commands are cheap, so they go first, in arrival order.  Searches are chosen highest
+ *  response ratio next: (time waiting + expected run time) / expected run time, with the run time predicted from the search's cost and
+ *  the throughput of recent searches.  A short search soon overtakes a long one that arrived before it, but a long search's ratio
+ *  keeps growing while it waits, so it is never starved.  This only orders the queue: searches still run one at a time.
+ *  \param [in] masternode The master node's state object
+ *  \param [in,out] pending The list of pending commands, which must not be empty
+ *  \returns The command to run next
+ */
+static P7_SERVER_QUEUE_DATA *next_command(P7_SERVER_MASTERNODE_STATE *masternode, P7_SERVER_QUEUE_DATA **pending){
+  P7_SERVER_QUEUE_DATA **link, **best = NULL;
+  P7_SERVER_QUEUE_DATA *query;
+  double now = queue_clock();
+  double best_ratio = 0.0;
+
+  for(link = pending; *link != NULL && (*link)->cmd_type != HMMD_CMD_SHUTDOWN; link = &((*link)->next)){
+    if((*link)->cmd_type != HMMD_CMD_SEARCH && (*link)->cmd_type != HMMD_CMD_SCAN){
+      best = link;
+      break;
+    }
+  }
+  if(best == NULL){
+    for(link = pending; *link != NULL && (*link)->cmd_type != HMMD_CMD_SHUTDOWN; link = &((*link)->next)){
+      double run_time = (*link)->cost / masternode->cells_per_second + 0.001; // never zero, even for an empty query
+      double ratio = (now - (*link)->queued + run_time) / run_time;
+      if(best == NULL || ratio > best_ratio){
+        best = link;
+        best_ratio = ratio;
+      }
+    }
+  }
+  if(best == NULL){ // a shutdown is at the head of the list
+    best = pending;
+  }
+  query = *best;
+  *best = query->next;
+  query->next = NULL;
+  return query;
+}
+
+// refuse_pending
+/*! \brief Tells the clients of every command still waiting at shutdown that it won't be run, and frees the commands
+ *  \details These commands arrived after the shutdown; everything that arrived before it has already run.
+ *  \param [in,out] pending The list of pending commands; empty on return
+ *  \param [in] cmdstack The stack that clientside threads push commands onto
+ */
+static void refuse_pending(P7_SERVER_QUEUE_DATA **pending, ESL_STACK *cmdstack){
+  P7_SERVER_QUEUE_DATA *query;
+
+  while(esl_stack_ObjectCount(cmdstack) > 0 && esl_stack_PPop(cmdstack, (void **) &query) == eslOK){
+    query->next = *pending;
+    *pending = query;
+  }
+  while(*pending != NULL){
+    query = *pending;
+    *pending = query->next;
+    client_msg(query->sock, eslFAIL, "Server is shutting down; command not run\n");
+    close(query->sock);
+    p7_server_queue_data_Destroy(query);
+  }
+}
+
 // p7_master_node_main
 /*! \brief Top-level function run on each master node
  *  \details Creates and initializes the main P7_MASTERNODE_STATE object for the master node, then enters a loop
@@ -1835,6 +2326,11 @@ void p7_server_master_node_main(int argc, char ** argv, MPI_Datatype *server_mpi
 
   free(database_names);
 
+  // The databases are only loaded at startup, so cached results stay valid for as long as the server runs
+  if(esl_opt_GetInteger(go, "--cache_mb") > 0){
+    masternode->result_cache = p7_server_cache_Create((uint64_t) esl_opt_GetInteger(go, "--cache_mb") * 1024 * 1024);
+  }
+
   // Create hit processing thread
   P7_SERVER_MASTERNODE_HIT_THREAD_ARGUMENT hit_argument;
   hit_argument.masternode = masternode;
@@ -1885,36 +2381,50 @@ void p7_server_master_node_main(int argc, char ** argv, MPI_Datatype *server_mpi
 
   int shutdown = 0;
   P7_SERVER_QUEUE_DATA     *query      = NULL;
+  P7_SERVER_QUEUE_DATA     *pending    = NULL;  // commands taken off cmdstack but not yet run
   while (!shutdown){
 
-    if(esl_stack_PPop(cmdstack, (void **) &query) == eslOK) {
+    // Wait for a command if none are pending, then take everything else that has arrived so the scheduler can choose among them
+    if(pending == NULL){
+      if(esl_stack_PPop(cmdstack, (void **) &query) != eslOK) break;
+      queue_command(masternode, &pending, query);
+    }
+    while(esl_stack_ObjectCount(cmdstack) > 0 && esl_stack_PPop(cmdstack, (void **) &query) == eslOK){
+      queue_command(masternode, &pending, query);
+    }
+
+    query = next_command(masternode, &pending);
 #ifdef DEBUG_COMMANDS
-      printf("Processing command %d from %s\n", query->cmd_type, query->ip_addr);
+    printf("Processing command %d from %s\n", query->cmd_type, query->ip_addr);
 #endif
-      fflush(stdout);
+    fflush(stdout);
 
 
-      switch(query->cmd_type) {
-      case HMMD_CMD_SEARCH:
+    switch(query->cmd_type) {
+    case HMMD_CMD_SEARCH:
+      if(send_cached_results(masternode->result_cache, query) != eslOK){
         process_search(masternode, query, server_mpitypes); 
-        break;
-      case HMMD_CMD_SCAN:        
+      }
+      break;
+    case HMMD_CMD_SCAN:        
+      if(send_cached_results(masternode->result_cache, query) != eslOK){
         process_search(masternode, query, server_mpitypes);
-        break;
-      case HMMD_CMD_SHUTDOWN:    
-        process_shutdown(masternode, query, server_mpitypes);
-        p7_syslog(LOG_ERR,"[%s:%d] - shutting down...\n", __FILE__, __LINE__);
-        shutdown = 1;
-        break;
-      case HMMD_CMD_CONTENTS:
-        process_contents(masternode, query, server_mpitypes);
-        break;
-      default:
-        p7_syslog(LOG_ERR,"[%s:%d] - unknown command %d from %s\n", __FILE__, __LINE__, query->cmd_type, query->ip_addr);
-        break;
       }
-      p7_server_queue_data_Destroy(query);
+      break;
+    case HMMD_CMD_SHUTDOWN:    
+      refuse_pending(&pending, cmdstack);
+      process_shutdown(masternode, query, server_mpitypes);
+      p7_syslog(LOG_ERR,"[%s:%d] - shutting down...\n", __FILE__, __LINE__);
+      shutdown = 1;
+      break;
+    case HMMD_CMD_CONTENTS:
+      process_contents(masternode, query, server_mpitypes);
+      break;
+    default:
+      p7_syslog(LOG_ERR,"[%s:%d] - unknown command %d from %s\n", __FILE__, __LINE__, query->cmd_type, query->ip_addr);
+      break;
     }
+    p7_server_queue_data_Destroy(query);
   }
   if(shutdown == 0){
     p7_Die("Bad result from esl_stack_PPop\n");
@@ -2008,18 +2518,40 @@ void *p7_server_master_hit_thread(void *argument){
           #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval);
   #endif
-	      lock_retval = pthread_mutex_lock(&(masternode->master_tophits_lock));
+        // Workers send their hits sorted, so each message is a sorted run.  Drop the end of the run that
+        // can't be reported, and keep the rest until the search is done and process_search() merges the runs
+        int final_message = (the_message->status.MPI_TAG == HMMER_HIT_FINAL_MPI_TAG);
+        if(p7_hitblock_Inflate(the_message->hitblock) != eslOK){
+          p7_Fail("Unable to inflate hits received from worker node %d\n", the_message->status.MPI_SOURCE);
+        }
+        p7_hitblock_Truncate(the_message->hitblock, masternode->hit_sortkey_floor);
+        if(the_message->hitblock->N > 0){
+	        lock_retval = pthread_mutex_lock(&(masternode->hit_run_pool_lock));
     #ifdef CHECK_MUTEXES
-        parse_lock_errors(lock_retval);
+          parse_lock_errors(lock_retval);
   #endif
-        p7_tophits_Merge(masternode->tophits, the_message->tophits);
-	      lock_retval = pthread_mutex_unlock(&(masternode->master_tophits_lock));
+          the_message->next = (P7_SERVER_MESSAGE *) masternode->hit_run_pool;
+          masternode->hit_run_pool = the_message;
+          masternode->num_hit_runs++;
+	        lock_retval = pthread_mutex_unlock(&(masternode->hit_run_pool_lock));
           #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval);
   #endif
-        p7_tophits_Destroy(the_message->tophits);
-        the_message->tophits = NULL;
-        if(the_message->status.MPI_TAG == HMMER_HIT_FINAL_MPI_TAG){
+        }
+        else{
+          // Nothing in this message can be reported, so put it straight back on the empty list
+          lock_retval = pthread_mutex_lock(&(masternode->empty_hit_message_pool_lock));
+      #ifdef CHECK_MUTEXES
+          parse_lock_errors(lock_retval);
+      #endif
+          the_message->next = (P7_SERVER_MESSAGE *) masternode->empty_hit_message_pool;
+          masternode->empty_hit_message_pool = the_message;
+          lock_retval = pthread_mutex_unlock(&(masternode->empty_hit_message_pool_lock));
+      #ifdef CHECK_MUTEXES
+          parse_lock_errors(lock_retval);
+      #endif
+        }
+        if(final_message){
           //this hit message was the last one from a thread, so increment the number of threads that have finished
           lock_retval = pthread_mutex_lock(&(masternode->worker_nodes_done_lock));
       #ifdef CHECK_MUTEXES
@@ -2032,18 +2564,6 @@ void *p7_server_master_hit_thread(void *argument){
   #endif
         }
 
-        // Put the message back on the empty list now that we've dealt with it.
-        lock_retval = pthread_mutex_lock(&(masternode->empty_hit_message_pool_lock));
-      #ifdef CHECK_MUTEXES
-        parse_lock_errors(lock_retval);
-      #endif
-        the_message->next = (P7_SERVER_MESSAGE *) masternode->empty_hit_message_pool;
-        masternode->empty_hit_message_pool = the_message;
-
-        lock_retval = pthread_mutex_unlock(&(masternode->empty_hit_message_pool_lock));
-          #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval);
-  #endif
       }
       else{
         lock_retval = pthread_mutex_unlock(&(masternode->full_hit_message_pool_lock));
@@ -2152,7 +2672,9 @@ void p7_masternode_message_handler(P7_SERVER_MASTERNODE_STATE *masternode, P7_SE
 #endif
       // The message was a set of hits from a worker node, so copy it into the buffer and queue the buffer for processing by the hit thread
       masternode->hit_messages_received++;
-      p7_tophits_MPIRecv((*buffer_handle)->status.MPI_SOURCE, (*buffer_handle)->status.MPI_TAG, MPI_COMM_WORLD, &((*buffer_handle)->buffer), &((*buffer_handle)->buffer_alloc), &((*buffer_handle)->tophits));
+      if(p7_hitblock_MPIRecv((*buffer_handle)->status.MPI_SOURCE, (*buffer_handle)->status.MPI_TAG, MPI_COMM_WORLD, (*buffer_handle)->hitblock) != eslOK){
+        p7_Die("Unable to receive hits in p7_masternode_message_handler\n");
+      }
 
       // Put the message in the list for the hit thread to process
       int lock_retval = pthread_mutex_lock(&(masternode->full_hit_message_pool_lock));
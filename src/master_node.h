@@ -27,6 +27,13 @@ typedef struct p7_server_queue_data_s {
   int            inx;         /* sequence index to start search */
   uint64_t            cnt;         /* number of sequences to search  */
   char           *optsstring; /* Options string used to create the search-specific options*/
+
+  char          *key;         /* result cache key: options string, then query object */
+  uint32_t       key_length;  /* length of key, in bytes                    */
+
+  double         queued;      /* time the command arrived, in seconds       */
+  double         cost;        /* estimated work of a search, in DP cells    */
+  struct p7_server_queue_data_s *next; /* next command waiting to be scheduled */
 } P7_SERVER_QUEUE_DATA;
 
 //! Data structure that the main thread uses to receive messages and pass them to the hit processing thread
@@ -34,8 +41,8 @@ typedef struct p7_server_message{
   //! Status returned by MPI_Probe/Recv
   MPI_Status status;
 
-  // structure containing hits returned by a worker
-  P7_TOPHITS *tophits;
+  // hits returned by a worker, received as one serialized block and inflated in place
+  P7_HITBLOCK *hitblock;
 
   int buffer_alloc;
   char *buffer;
@@ -44,6 +51,48 @@ typedef struct p7_server_message{
 } P7_SERVER_MESSAGE;
 
 
+//! One search's results in the master node's result cache
+typedef struct p7_server_cache_entry{
+  //! Hash of key, to speed up lookups
+  uint64_t hash;
+
+  //! The options string and query object that the results were computed for
+  char *key;
+  uint32_t key_length;
+
+  //! Serialized HMMD_SEARCH_STATUS, HMMD_SEARCH_STATS and hits, exactly as they were sent to the client that ran the search
+  uint8_t *response;
+  uint64_t response_length;
+
+  //! Next entry in the same hash bucket
+  struct p7_server_cache_entry *bucket_next;
+
+  //! Neighbors in the list of entries ordered from most to least recently used
+  struct p7_server_cache_entry *newer, *older;
+} P7_SERVER_CACHE_ENTRY;
+
+//! LRU cache of search results on the master node, so that repeats of a search don't have to be recomputed
+typedef struct p7_server_cache{
+  //! Hash table of entries, nbuckets chains
+  P7_SERVER_CACHE_ENTRY **bucket;
+  int nbuckets;
+
+  //! Most and least recently used entries
+  P7_SERVER_CACHE_ENTRY *newest, *oldest;
+
+  //! Number of entries, and the memory their keys and responses take up
+  int num_entries;
+  uint64_t size;
+
+  //! Least recently used entries are evicted to keep size at or below this
+  uint64_t max_size;
+
+  //! Searches answered from the cache, and searches that had to be run
+  uint64_t hits;
+  uint64_t misses;
+} P7_SERVER_CACHE;
+
+
 //! Structure used in the master node's work queues, one structure per shard in the database being searched
 typedef struct p7_master_work_descriptor{
 
@@ -76,8 +125,14 @@ typedef struct p7_server_masternode_state{
   //! amount of work (unit = HMM-sequence comparisons) to send in response to each worker node request
   uint64_t chunk_size;
 
-  // Hits found by the current search
-  P7_TOPHITS *tophits;
+  //! Cache of recent search results, or NULL if caching is turned off
+  P7_SERVER_CACHE *result_cache;
+
+  //! Recent search throughput, in DP cells per second; used to turn a queued search's cost into an expected run time
+  double cells_per_second;
+
+  // Hits with a lower sortkey than this can't be reported by the current search, so they are dropped as they arrive
+  double hit_sortkey_floor;
   
   // Pipeline object to accumulate statistics from the workers
   P7_PIPELINE *pipeline;
@@ -117,8 +172,8 @@ typedef struct p7_server_masternode_state{
   //! Lock used to wait until the hit thread has started
   pthread_mutex_t hit_thread_start_lock;
 
-  //! Lock on the masternode's main tophits object
-  pthread_mutex_t master_tophits_lock;
+  //! Lock on the pool of hit runs
+  pthread_mutex_t hit_run_pool_lock;
 
   //! Linked list of empty P7_SERVER_MESSAGE structures, used to reduce malloc/free overhead
   P7_SERVER_MESSAGE *empty_hit_message_pool;  
@@ -126,6 +181,11 @@ typedef struct p7_server_masternode_state{
   //! Linked list (LIFO ordered) of P7_SERVER_MESSAGE structures containing messages of hits that have arrived but not been processed
   P7_SERVER_MESSAGE *full_hit_message_pool;
 
+  //! Linked list of P7_SERVER_MESSAGE structures whose hits have been inflated, each a sorted run of the current search's hits
+  P7_SERVER_MESSAGE *hit_run_pool;
+  //! Number of messages in hit_run_pool
+  int num_hit_runs;
+
  
   //! Signal used to tell the hit thread when to start processing hits
   pthread_cond_t start;
@@ -5,9 +5,10 @@
  *    2. Communicating P7_PROFILE, a score profile.
  *    3. Communicating P7_PIPELINE, pipeline stats.
  *    4. Communicating P7_TOPHITS, list of high scoring alignments.
- *    5. Benchmark driver.
- *    6. Unit tests.
- *    7. Test driver.
+ *    5. Communicating P7_HITBLOCK, a serialized list of hits.
+ *    6. Benchmark driver.
+ *    7. Unit tests.
+ *    8. Test driver.
  */
 #include <p7_config.h>		
 
@@ -1600,7 +1601,77 @@ p7_dcl_MPIRecv(int source, int tag, MPI_Comm comm, char **buf, int *nalloc, P7_D
 
 
 /*****************************************************************
- * 5. Benchmark driver.
+ * 5. Communicating P7_HITBLOCK
+ *****************************************************************/
+
+/* Function:  p7_hitblock_MPISend()
+ * Synopsis:  Send a hit block as one MPI message.
+ *
+ * Purpose:   Sends the <blk->n> bytes of hits written into <blk> by
+ *            <p7_hitblock_Write()> to MPI process <dest>, tagged with
+ *            MPI tag <tag>, for MPI communicator <comm>. The block is
+ *            already in network byte order, so it goes as one
+ *            <MPI_BYTE> message, however many hits it holds.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslESYS> if the MPI call fails.
+ */
+int
+p7_hitblock_MPISend(const P7_HITBLOCK *blk, int dest, int tag, MPI_Comm comm)
+{
+  if (MPI_Send(blk->data, blk->n, MPI_BYTE, dest, tag, comm) != 0) ESL_EXCEPTION(eslESYS, "mpi send failed");
+  return eslOK;
+}
+
+/* Function:  p7_hitblock_MPIRecv()
+ * Synopsis:  Receive a hit block sent by p7_hitblock_MPISend().
+ *
+ * Purpose:   Receive a hit block from <source> (where <source> is usually
+ *            a process number, but may also be <MPI_ANY_SOURCE>) tagged
+ *            with <tag> (which may be <MPI_ANY_TAG>) for MPI communicator
+ *            <comm>, directly into <blk->data>, which is reallocated
+ *            only if the message is larger than any it has held before.
+ *            The hits are not inflated; call <p7_hitblock_Inflate()>
+ *            for that.
+ *
+ * Returns:   <eslOK> on success; <blk->n> is the number of bytes
+ *            received.
+ *
+ * Throws:    <eslESYS> if an MPI call fails; <eslEMEM> if a realloc
+ *            fails. <eslFAIL> if the message has an unexpected source or tag.
+ */
+int
+p7_hitblock_MPIRecv(int source, int tag, MPI_Comm comm, P7_HITBLOCK *blk)
+{
+  int         n;
+  int         status;
+  MPI_Status  mpistatus;
+
+  /* Probe first, because we need to know if our buffer is big enough. */
+  if (MPI_Probe(source, tag, comm, &mpistatus)  != 0) ESL_XEXCEPTION(eslESYS, "mpi probe failed");
+  if (MPI_Get_count(&mpistatus, MPI_BYTE, &n)   != 0) ESL_XEXCEPTION(eslESYS, "mpi get count failed");
+
+  if (tag    != MPI_ANY_TAG    && mpistatus.MPI_TAG    != tag)    { status = eslFAIL; goto ERROR; }
+  if (source != MPI_ANY_SOURCE && mpistatus.MPI_SOURCE != source) { status = eslFAIL; goto ERROR; }
+
+  if (n > blk->nalloc) {
+    ESL_REALLOC(blk->data, sizeof(uint8_t) * n);
+    blk->nalloc = n;
+  }
+
+  if (MPI_Recv(blk->data, n, MPI_BYTE, mpistatus.MPI_SOURCE, mpistatus.MPI_TAG, comm, &mpistatus) != 0) ESL_XEXCEPTION(eslESYS, "mpi recv failed");
+  blk->n = n;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+/*----------------- end, P7_HITBLOCK communication -------------------*/
+
+
+/*****************************************************************
+ * 6. Benchmark driver.
  *****************************************************************/
 
 #ifdef p7MPISUPPORT_BENCHMARK
@@ -1710,7 +1781,7 @@ main(int argc, char **argv)
 
 
 /*****************************************************************
- * 6. Unit tests
+ * 7. Unit tests
  *****************************************************************/
 #ifdef p7MPISUPPORT_TESTDRIVE
 
@@ -1820,7 +1891,7 @@ utest_ProfileSendRecv(int my_rank, int nproc)
 
 
 /*****************************************************************
- * 7. Test driver.
+ * 8. Test driver.
  *****************************************************************/
 #ifdef p7MPISUPPORT_TESTDRIVE
 
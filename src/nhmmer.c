@@ -112,6 +112,7 @@ static ESL_OPTIONS options[] = {
   { "--seed_req_pos",      eslARG_INT,           "5", NULL, NULL,    NULL,  NULL, NULL,          "minimum number consecutive positive scores in seed" ,                 7 },
   { "--seed_consens_match",eslARG_INT,          "11", NULL, NULL,    NULL,  NULL, NULL,          "<n> consecutive matches to consensus will override score threshold" , 7 },
   { "--seed_ssv_length",   eslARG_INT,         "100", NULL, NULL,    NULL,  NULL, NULL,          "length of window around FM seed to get full SSV diagonal",            7 },
+  { "--qbatch",            eslARG_INT,           "1", NULL, "n>=1",  NULL,"--fmindex", NULL,     "seed <n> queries together in each pass over the FM-index",            7 },
 #endif
 
   /* Other options */
@@ -170,8 +171,8 @@ struct cfg_s {
 
   char            *dbfile;            // target sequence database file
   ESL_SQFILE      *dbfp;              // open dbfile (default); or NULL when using FM-index
-  FM_CFG          *fmdb;              // else for FM-index: FM-index config; or NULL 
-  fpos_t           fm_basepos;        //    ... position in FM-index dbfile; or undefined
+  FM_CFG          *fmdb;              // else for FM-index: FM-index config, with all blocks mapped if possible; or NULL 
+  fpos_t           fm_basepos;        //    ... position of first block in FM-index dbfile, if blocks are streamed; or undefined
   int              which_strand;      // p7_STRAND_BOTH | p7_STRAND_TOPONLY | p7_STRAND_BOTTOMONLY
   int              block_length;      // length of overlapping input sequence windows to read
   char            *firstseq_key;      // name of the first sequence in the restricted db range
@@ -191,6 +192,7 @@ struct cfg_s {
   double           window_beta;       // max length of an expected match is determined probabilistically: P(1 - window_beta) of probability mass
   int              window_length;     //  ... window_beta calculation can be overridden by an explicit max expected match length
   double           F1;                // default F1 MSV filter threshold differs for FM-index: 0.03 instead of 0.2.
+  int              qbatch;            // max # of queries searched together per FM-index block (--qbatch); 1 without an FM-index
 };
 
 
@@ -208,11 +210,15 @@ typedef struct {
   P7_OPROFILE      *om;          // optimized query profile
   FM_CFG           *fmdb;        // global data for FM-index for fast SSV
   P7_SCOREDATA     *scoredata;   // hmm-specific data used by nhmmer
+  float             sc_thresh_ratio; // FM seed score threshold ratio for this query
+  int               nq;          // number of queries in the batch; a worker's WORKER_INFOs for them are consecutive
 } WORKER_INFO;
 
 typedef struct {
-  FM_DATA  *fmf;
-  FM_DATA  *fmb;
+  FM_DATA  *fmf;      // forward and backward index of one block: shared and read-only from fm_FM_map(),
+  FM_DATA  *fmb;      //   or, if the index isn't mapped, <fmf_rd>,<fmb_rd>
+  FM_DATA   fmf_rd;   // one block read by the director when the index isn't mapped; the worker frees it
+  FM_DATA   fmb_rd;
   int       active;   // TRUE is worker is supposed to work on the contents, FALSE otherwise
 } FM_THREAD_INFO;
 
@@ -248,9 +254,11 @@ static void            destroy_id_length( ID_LENGTH_LIST *list );
 static int             add_id_length(ID_LENGTH_LIST *list, int id, int L);
 static int             assign_Lengths(P7_TOPHITS *th, ID_LENGTH_LIST *id_length_list);
 
+static int           read_query(struct cfg_s *cfg, int nquery, ESL_SQ **qsq, int *msas_named, P7_HMM **ret_hmm);
 static void          assign_msa_name(struct cfg_s *cfg, ESL_MSA *msa);
 #ifdef p7ENABLE_FMINDEX
-static P7_SCOREDATA *create_fm_scoredata(struct cfg_s *cfg, P7_PROFILE *gm, P7_OPROFILE *om);
+static P7_SCOREDATA *create_fm_scoredata(struct cfg_s *cfg, P7_PROFILE *gm, P7_OPROFILE *om, float *ret_ratio);
+static void          fm_search_block(WORKER_INFO *info, const FM_DATA *fmf, const FM_DATA *fmb);
 #endif
 static void          output_optional_msa(FILE *afp, P7_HMM *hmm, P7_TOPHITS *th);
 
@@ -264,19 +272,20 @@ main(int argc, char **argv)
 {
   struct cfg_s     cfg;         
   ESL_GETOPTS     *go         = NULL;  
-  P7_HMM          *hmm        = NULL;                    // current profile HMM query (default)
-  ESL_SQ          *qsq        = NULL;                    //     ... or sequence query (--qseq)
-  ESL_MSA         *qmsa       = NULL;                    //     ... or MSA query      (--qmsa)
-  P7_PROFILE      *gm         = NULL;                    // search profile 
-  P7_OPROFILE     *om         = NULL;                    // vectorized search profile
+  P7_HMM         **hmm        = NULL;                    // current batch of profile HMM queries [0..nbatch-1]
+  ESL_SQ          *qsq        = NULL;                    // sequence query (--qseq), reused for each one
+  P7_PROFILE     **gm         = NULL;                    // search profiles 
+  P7_OPROFILE    **om         = NULL;                    // vectorized search profiles
   ESL_STOPWATCH   *w          = esl_stopwatch_Create();
-  int              nquery     = 0;                       // which query we're on 
+  int              nquery     = 0;                       // how many queries we've read 
+  int              nbatch     = 0;                       // how many queries are in the current batch
   int              msas_named = 0;                       // how many input MSAs had no names, and we had to assign one. (max 1!)
   int64_t          resCnt     = 0;
-  P7_SCOREDATA    *scoredata  = NULL;
+  P7_SCOREDATA   **scoredata  = NULL;
+  float           *ratio      = NULL;                    // FM seed score threshold ratio of each query in the batch
   ID_LENGTH_LIST  *id_length_list = NULL;
 
-  int              i;
+  int              i, q;
   int              status;                               // overall exit status from nhmmer, back to shell. (ESL_ALLOC sets this on allocation failure.)
 
   int              infocnt   = 0;
@@ -306,7 +315,7 @@ main(int argc, char **argv)
 #endif
 
   infocnt = (cfg.ncpus == 0) ? 1 : cfg.ncpus;
-  ESL_ALLOC(info, (ptrdiff_t) sizeof(*info) * infocnt);
+  ESL_ALLOC(info, (ptrdiff_t) sizeof(*info) * infocnt * cfg.qbatch);
 
 #ifdef HMMER_THREADS
   for (i = 0; i < cfg.ncpus * 2; ++i)
@@ -320,8 +329,8 @@ main(int argc, char **argv)
       else
         {
           ESL_ALLOC(fminfo,      sizeof(FM_THREAD_INFO));
-          ESL_ALLOC(fminfo->fmf, sizeof(FM_DATA));
-          ESL_ALLOC(fminfo->fmb, sizeof(FM_DATA));
+          fminfo->fmf    = NULL;
+          fminfo->fmb    = NULL;
           fminfo->active = FALSE;
           if ( esl_workqueue_Init(queue, fminfo) != eslOK) p7_Fail("Failed to add FM info to work queue");
         }
@@ -329,79 +338,55 @@ main(int argc, char **argv)
     }
 #endif
 
-  /* Main outer loop over all queries from hfp|qseq_fp|qmsa_fp
+  ESL_ALLOC(hmm,       sizeof(P7_HMM *)       * cfg.qbatch);
+  ESL_ALLOC(gm,        sizeof(P7_PROFILE *)   * cfg.qbatch);
+  ESL_ALLOC(om,        sizeof(P7_OPROFILE *)  * cfg.qbatch);
+  ESL_ALLOC(scoredata, sizeof(P7_SCOREDATA *) * cfg.qbatch);
+  ESL_ALLOC(ratio,     sizeof(float)          * cfg.qbatch);
+
+  /* Main outer loop over batches of up to <cfg.qbatch> queries from hfp|qseq_fp|qmsa_fp.
+   * Without an FM-index, a batch is always one query. With one, each
+   * FM-index block is seeded once for the whole batch (--qbatch).
    */
-  while (1) // exit from the while is after EOF at reading next query, just below.
+  while (1) // exit from the while is after EOF at reading the first query of a batch, just below.
     {
-      /* Read the next query.
-       * If it's a sequence or MSA, build a profile HMM from it.
-       * If we EOF on this read, that's the normal end of the while loop.
+      /* Read the next batch of queries, building a profile HMM from each
+       * sequence or MSA query. If we EOF on the first read, that's the
+       * normal end of the while loop.
        */
-      if (cfg.hfp)
-        {
-          status = p7_hmmfile_Read(cfg.hfp, &(cfg.abc), &hmm);
-          if (nquery && status == eslEOF)  break;
-          else if (status == eslEFORMAT)   p7_Fail("Bad file format in profile HMM file %s:\n%s\n",          cfg.hfp->fname, cfg.hfp->errbuf);
-          else if (status == eslEINCOMPAT) p7_Fail("Profile HMM in %s is not in the expected %s alphabet\n", cfg.hfp->fname, esl_abc_DecodeType(cfg.abc->type));
-          else if (status == eslEOF)       p7_Fail("No profiles found - is file %s empty?\n",                cfg.hfp->fname); 
-          else if (status != eslOK)        p7_Fail("Unexpected error in reading profile HMMs from %s\n",     cfg.hfp->fname);
-        }
-      else if (cfg.qseq_fp)
-        {
-          if (!qsq) qsq = esl_sq_CreateDigital(cfg.abc);
-
-          status = esl_sqio_Read(cfg.qseq_fp, qsq);
-          if      (nquery && status == eslEOF) break;
-          else if (status == eslEFORMAT)       p7_Fail("Sequence file parsing failed\n  %s", esl_sqfile_GetErrorBuf(cfg.qseq_fp));
-          else if (status == eslEOF)           p7_Fail("No sequences found - is file %s empty?\n", cfg.queryfile); 
-          else if (status != eslOK)            p7_Fail("Unexpected error %d in reading sequence file %s", status, cfg.queryfile);
- 
-          status = p7_SingleBuilder(cfg.builder, qsq, cfg.bg, &hmm, /*opt_tr=*/NULL, /*opt_gm=*/NULL, /*opt_om*/NULL);
-          if (status != eslOK) p7_Fail("Single sequence profile construction failed for %s", qsq->name);
-        }
-      else if (cfg.qmsa_fp)
+      for (nbatch = 0; nbatch < cfg.qbatch; nbatch++)
         {
-          status = esl_msafile_Read(cfg.qmsa_fp, &qmsa);
-          if      (nquery && status == eslEOF) break;
-          else if (status != eslOK)            esl_msafile_ReadFailure(cfg.qmsa_fp, status);
-
-          if (! qmsa->name) {  // If one MSA lacks a name, we can name it using the filename. More than one, we fail out.
-            if (msas_named) p7_Fail("Name annotation is required for each alignment in a multi MSA file; failed on #%d", nquery);
-            assign_msa_name(&cfg, qmsa);
-            msas_named++;
-          }
-          
-          status = p7_Builder(cfg.builder, qmsa, cfg.bg, &hmm, /*opt_tr=*/NULL, /*opt_gm=*/NULL, /*opt_om*/NULL, /*opt_postmsa*/NULL);
-          if      (status == eslEFORMAT)    p7_Fail("MSA %s has a format problem - maybe no reference annotation line?", qmsa->name ? qmsa->name : "(unnamed)"); // shouldn't happen. nhmmer doesn't have --hand construction.
-          else if (status == eslENORESULT)  p7_Fail("No consensus columns found for some reason in input MSA");
-          else if (status != eslOK)         p7_Fail("Failed to build profile from input MSA - unexpected error %d", status);
-        }
-      nquery++;
-
-      /* Assign HMM max_length
-       */
-      if      (cfg.window_length > 0)   hmm->max_length = cfg.window_length;
-      else if (cfg.window_beta   > 0)   p7_Builder_MaxLength(hmm, cfg.window_beta);
-      else if (hmm->max_length == -1 )  p7_Builder_MaxLength(hmm, p7_DEFAULT_WINDOW_BETA);
-
-      /* Convert HMM to search profile, vectorize it, configure it
-       */
-      gm = p7_profile_Create (hmm->M, cfg.abc);
-      om = p7_oprofile_Create(hmm->M, cfg.abc);
-      p7_ProfileConfig(hmm, cfg.bg, gm, 100, p7_LOCAL);   // 100 is a dummy length for now; and MSVFilter requires local mode 
-      p7_oprofile_Convert(gm, om);                        // <om> is now p7_LOCAL, multihit 
-
-      /* Create scoredata
-       */
-      if (cfg.dbfp)  scoredata = p7_hmm_ScoreDataCreate(om, NULL);
+          if (read_query(&cfg, nquery, &qsq, &msas_named, &(hmm[nbatch])) == eslEOF) break;
+          nquery++;
+
+          /* Assign HMM max_length
+           */
+          if      (cfg.window_length > 0)             hmm[nbatch]->max_length = cfg.window_length;
+          else if (cfg.window_beta   > 0)             p7_Builder_MaxLength(hmm[nbatch], cfg.window_beta);
+          else if (hmm[nbatch]->max_length == -1 )    p7_Builder_MaxLength(hmm[nbatch], p7_DEFAULT_WINDOW_BETA);
+
+          /* Convert HMM to search profile, vectorize it, configure it
+           */
+          gm[nbatch] = p7_profile_Create (hmm[nbatch]->M, cfg.abc);
+          om[nbatch] = p7_oprofile_Create(hmm[nbatch]->M, cfg.abc);
+          p7_ProfileConfig(hmm[nbatch], cfg.bg, gm[nbatch], 100, p7_LOCAL);   // 100 is a dummy length for now; and MSVFilter requires local mode 
+          p7_oprofile_Convert(gm[nbatch], om[nbatch]);                        // <om> is now p7_LOCAL, multihit 
+
+          /* Create scoredata
+           */
+          ratio[nbatch] = 1.0;
+          if (cfg.dbfp)  scoredata[nbatch] = p7_hmm_ScoreDataCreate(om[nbatch], NULL);
 #ifdef p7ENABLE_FMINDEX
-      else           scoredata = create_fm_scoredata(&cfg, gm, om);
+          else           scoredata[nbatch] = create_fm_scoredata(&cfg, gm[nbatch], om[nbatch], &(ratio[nbatch]));
 #endif
+        }
+      if (nbatch == 0) break;
 
-      /* If this is query 2 or more, we need to rewind the target dbfile.
+      /* If this isn't the first batch, we need to rewind the target dbfile.
        * If it's a nonrewindable stream, we have to stop with an error.
+       * (A mapped FM-index is set up once, up front, and needs no rewinding.)
        */
-      if (nquery > 1) {
+      if (nquery > nbatch) {
         if (cfg.dbfp)
           {
             if (! esl_sqfile_IsRewindable(cfg.dbfp)) p7_Fail("Target sequence file %s isn't rewindable; can't search it with multiple queries", cfg.dbfile);
@@ -409,43 +394,47 @@ main(int argc, char **argv)
             else                  status = esl_sqfile_Position     (cfg.dbfp, 0);
           }
 #ifdef p7ENABLE_FMINDEX
-        else
+        else if (cfg.fmdb->meta->fmf == NULL)
           {
             if ( fsetpos(cfg.fmdb->meta->fp, &(cfg.fm_basepos)) != 0) p7_Fail("rewind via fsetpos() in FM-index dbfile failed");
           }
 #endif
       }
       
-      /* Create processing pipeline and hit list for each worker thread
+      /* Create processing pipeline and hit list for each query, for each worker thread.
+       * Worker <i>'s are info[i*cfg.qbatch .. i*cfg.qbatch+nbatch-1].
        */
       for (i = 0; i < infocnt; i++)
         {
-          info[i].th        = p7_tophits_Create();
-          info[i].om        = p7_oprofile_Copy(om);
-          info[i].bg        = p7_bg_Clone(cfg.bg);
-          info[i].scoredata = p7_hmm_ScoreDataClone(scoredata, om->abc->Kp);
-          info[i].fmdb      = cfg.fmdb;  // NULL if not using FM-indexing
-          info[i].pli       = p7_pipeline_Create(go, om->M, 100, TRUE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
-          info[i].pli->do_alignment_score_calc = (cfg.aliscoresfp ? TRUE : FALSE);
-          info[i].pli->block_length            = cfg.block_length;
-          info[i].pli->strands                 = cfg.which_strand;
-          info[i].pli->F1                      = cfg.F1;               // default for FM-index is different, 0.03 instead of 0.02.
+          for (q = 0; q < nbatch; q++)
+            {
+              WORKER_INFO *wi = &(info[i*cfg.qbatch + q]);
+
+              wi->th        = p7_tophits_Create();
+              wi->om        = p7_oprofile_Copy(om[q]);
+              wi->bg        = p7_bg_Clone(cfg.bg);
+              wi->scoredata = p7_hmm_ScoreDataClone(scoredata[q], om[q]->abc->Kp);
+              wi->fmdb      = cfg.fmdb;  // NULL if not using FM-indexing
+              wi->pli       = p7_pipeline_Create(go, om[q]->M, 100, TRUE, p7_SEARCH_SEQS); /* L_hint = 100 is just a dummy for now */
+              wi->pli->do_alignment_score_calc = (cfg.aliscoresfp ? TRUE : FALSE);
+              wi->pli->block_length            = cfg.block_length;
+              wi->pli->strands                 = cfg.which_strand;
+              wi->pli->F1                      = cfg.F1;               // default for FM-index is different, 0.03 instead of 0.02.
+              wi->sc_thresh_ratio              = ratio[q];
+              wi->nq                           = nbatch;
 #ifdef HMMER_THREADS
-          info[i].queue     = queue;
+              wi->queue     = queue;
 #endif        
-          status = p7_pli_NewModel(info[i].pli, info[i].om, info[i].bg);
-          if (status == eslEINVAL) p7_Fail(info->pli->errbuf);
+              status = p7_pli_NewModel(wi->pli, wi->om, wi->bg);
+              if (status == eslEINVAL) p7_Fail(wi->pli->errbuf);
+            }
 
 #ifdef HMMER_THREADS
-          if (cfg.ncpus > 0) esl_threads_AddThread(threadObj, &info[i]);
+          if (cfg.ncpus > 0) esl_threads_AddThread(threadObj, &info[i*cfg.qbatch]);
 #endif
         }
 
-      resCnt = 0;
       esl_stopwatch_Start(w);
-      esl_fprintf(cfg.ofp, "Query:       %s  [M=%d]\n", hmm->name, hmm->M);
-      if (hmm->acc)  esl_fprintf(cfg.ofp, "Accession:   %s\n", hmm->acc);
-      if (hmm->desc) esl_fprintf(cfg.ofp, "Description: %s\n", hmm->desc);
 
       id_length_list = init_id_length(cfg.fmdb, 1000);  
 
@@ -463,105 +452,119 @@ main(int argc, char **argv)
           else                serial_processor_FM(info);
         }
 
-      /* Set E-values for top hits
-       *  1. If user told us -Z, that's seqfile size in Mb (one strand). If we search both strands, mult by 2.
-       *  2. P7_PIPELINE pli->nres counter counts exactly what we searched (whether one or two strands).
-       *  3. FM-index meta->char_count is seqfile size (in residues, 1 strand); if we search both strands, mult by 2.
+      /* Output each query's results, in order. Worker 0's WORKER_INFO
+       * for query <q> is info[q]; the other workers' are merged into it.
        */
-      if (cfg.dbfp)
+      for (q = 0; q < nbatch; q++)
         {
-          if (cfg.Z > 0.)
-            resCnt = (int64_t) (1000000. * cfg.Z) * (cfg.which_strand == p7_STRAND_BOTH ? 2 : 1);
-          else
-            for (i = 0; i < infocnt; i++)
-              resCnt += info[i].pli->nres;
-        }
+          WORKER_INFO *qi = &(info[q]);
+
+          /* Set E-values for top hits
+           *  1. If user told us -Z, that's seqfile size in Mb (one strand). If we search both strands, mult by 2.
+           *  2. P7_PIPELINE pli->nres counter counts exactly what we searched (whether one or two strands).
+           *  3. FM-index meta->char_count is seqfile size (in residues, 1 strand); if we search both strands, mult by 2.
+           */
+          resCnt = 0;
+          if (cfg.dbfp)
+            {
+              if (cfg.Z > 0.)
+                resCnt = (int64_t) (1000000. * cfg.Z) * (cfg.which_strand == p7_STRAND_BOTH ? 2 : 1);
+              else
+                for (i = 0; i < infocnt; i++)
+                  resCnt += info[i*cfg.qbatch + q].pli->nres;
+            }
 #ifdef p7ENABLE_FMINDEX
-      else resCnt = cfg.fmdb->meta->char_count * (cfg.which_strand == p7_STRAND_BOTH ? 2 : 1);
+          else resCnt = cfg.fmdb->meta->char_count * (cfg.which_strand == p7_STRAND_BOTH ? 2 : 1);
 #endif
 
-      /* If we didn't search any target sequences, that's almost
-       * certainly a problem with the target seqfile. Our parsers are
-       * pretty tolerant of common variations in biosequence files, so
-       * it's possible (for example) for the user to erroneously
-       * assert Genbank format for a FASTA file, and our parser will
-       * EOF looking for a LOCUS line, rather than recognizing that
-       * it's not Genbank format at all. Detect that case now.
-       */
-      if (resCnt == 0)
-        p7_Fail("No target sequences found.\nEmpty <target_seqfile>? Or maybe a problem with parsing its format.");
-
-      for (i = 0; i < infocnt; ++i)
-        p7_tophits_ComputeNhmmerEvalues(info[i].th, resCnt, info[i].om->max_length);
+          /* If we didn't search any target sequences, that's almost
+           * certainly a problem with the target seqfile. Our parsers are
+           * pretty tolerant of common variations in biosequence files, so
+           * it's possible (for example) for the user to erroneously
+           * assert Genbank format for a FASTA file, and our parser will
+           * EOF looking for a LOCUS line, rather than recognizing that
+           * it's not Genbank format at all. Detect that case now.
+           */
+          if (resCnt == 0)
+            p7_Fail("No target sequences found.\nEmpty <target_seqfile>? Or maybe a problem with parsing its format.");
+
+          for (i = 0; i < infocnt; ++i)
+            p7_tophits_ComputeNhmmerEvalues(info[i*cfg.qbatch + q].th, resCnt, info[i*cfg.qbatch + q].om->max_length);
       
-      /* Merge the threaded processors
-       */
-      for (i = 1; i < infocnt; ++i)
-        {
-          p7_tophits_Merge (info[0].th,  info[i].th);
-          p7_pipeline_Merge(info[0].pli, info[i].pli);
-      }
+          /* Merge the threaded processors
+           */
+          for (i = 1; i < infocnt; ++i)
+            {
+              p7_tophits_Merge (qi->th,  info[i*cfg.qbatch + q].th);
+              p7_pipeline_Merge(qi->pli, info[i*cfg.qbatch + q].pli);
+            }
 #ifdef p7ENABLE_FMINDEX
-      if (cfg.fmdb)
-        {
-          info[0].pli->nseqs = cfg.fmdb->meta->seq_data[cfg.fmdb->meta->seq_count-1].target_id + 1;
-          info[0].pli->nres  = resCnt;
-        }
+          if (cfg.fmdb)
+            {
+              qi->pli->nseqs = cfg.fmdb->meta->seq_data[cfg.fmdb->meta->seq_count-1].target_id + 1;
+              qi->pli->nres  = resCnt;
+            }
 #endif
 
-      /* Sort the results, deduplicate (from threaded chunk overlaps), and threshold
-       */
-      p7_tophits_SortBySeqidxAndAlipos(info->th);
-      assign_Lengths(info->th, id_length_list);
-      p7_tophits_RemoveDuplicates(info->th, info->pli->use_bit_cutoffs);
-      p7_tophits_SortBySortkey(info->th);
-      p7_tophits_Threshold(info->th, info->pli);
-
-      /* Tally hits and target coverage
-       */
-      info->pli->n_output = info->pli->pos_output = 0;
-      for (i = 0; i < info->th->N; i++)
-        {
-          if ( (info->th->hit[i]->flags & p7_IS_REPORTED) || info->th->hit[i]->flags & p7_IS_INCLUDED)
+          /* Sort the results, deduplicate (from threaded chunk overlaps), and threshold
+           */
+          p7_tophits_SortBySeqidxAndAlipos(qi->th);
+          assign_Lengths(qi->th, id_length_list);
+          p7_tophits_RemoveDuplicates(qi->th, qi->pli->use_bit_cutoffs);
+          p7_tophits_SortBySortkey(qi->th);
+          p7_tophits_Threshold(qi->th, qi->pli);
+
+          /* Tally hits and target coverage
+           */
+          qi->pli->n_output = qi->pli->pos_output = 0;
+          for (i = 0; i < qi->th->N; i++)
             {
-              info->pli->n_output++;
-              info->pli->pos_output += 1 + (info->th->hit[i]->dcl[0].jali > info->th->hit[i]->dcl[0].iali ? info->th->hit[i]->dcl[0].jali - info->th->hit[i]->dcl[0].iali : info->th->hit[i]->dcl[0].iali - info->th->hit[i]->dcl[0].jali) ;
+              if ( (qi->th->hit[i]->flags & p7_IS_REPORTED) || qi->th->hit[i]->flags & p7_IS_INCLUDED)
+                {
+                  qi->pli->n_output++;
+                  qi->pli->pos_output += 1 + (qi->th->hit[i]->dcl[0].jali > qi->th->hit[i]->dcl[0].iali ? qi->th->hit[i]->dcl[0].jali - qi->th->hit[i]->dcl[0].iali : qi->th->hit[i]->dcl[0].iali - qi->th->hit[i]->dcl[0].jali) ;
+                }
             }
-        }
 
-      /* Search result outputs
-       */
-      p7_tophits_Targets(cfg.ofp, info->th, info->pli, cfg.textw); esl_fprintf(cfg.ofp, "\n\n");
-      p7_tophits_Domains(cfg.ofp, info->th, info->pli, cfg.textw); esl_fprintf(cfg.ofp, "\n\n");
+          /* Search result outputs
+           */
+          esl_fprintf(cfg.ofp, "Query:       %s  [M=%d]\n", hmm[q]->name, hmm[q]->M);
+          if (hmm[q]->acc)  esl_fprintf(cfg.ofp, "Accession:   %s\n", hmm[q]->acc);
+          if (hmm[q]->desc) esl_fprintf(cfg.ofp, "Description: %s\n", hmm[q]->desc);
 
-      if (cfg.tblfp)       p7_tophits_TabularTargets(cfg.tblfp,       hmm->name, hmm->acc, info->th, info->pli, (nquery == 1));
-      if (cfg.dfamtblfp)   p7_tophits_TabularXfam   (cfg.dfamtblfp,   hmm->name, hmm->acc, info->th, info->pli);
-      if (cfg.afp)         output_optional_msa      (cfg.afp,         hmm,       info->th); 
-      if (cfg.aliscoresfp) p7_tophits_AliScores     (cfg.aliscoresfp, hmm->name, info->th);
-      if (cfg.hmmoutfp)    p7_hmmfile_WriteASCII    (cfg.hmmoutfp, /*fmt=default*/-1, hmm);
+          p7_tophits_Targets(cfg.ofp, qi->th, qi->pli, cfg.textw); esl_fprintf(cfg.ofp, "\n\n");
+          p7_tophits_Domains(cfg.ofp, qi->th, qi->pli, cfg.textw); esl_fprintf(cfg.ofp, "\n\n");
 
-      esl_stopwatch_Stop(w);
-      p7_pli_Statistics(cfg.ofp, info->pli, w);
-      esl_fprintf(cfg.ofp, "//\n");
+          if (cfg.tblfp)       p7_tophits_TabularTargets(cfg.tblfp,       hmm[q]->name, hmm[q]->acc, qi->th, qi->pli, (nquery - nbatch + q == 0));
+          if (cfg.dfamtblfp)   p7_tophits_TabularXfam   (cfg.dfamtblfp,   hmm[q]->name, hmm[q]->acc, qi->th, qi->pli);
+          if (cfg.afp)         output_optional_msa      (cfg.afp,         hmm[q],       qi->th); 
+          if (cfg.aliscoresfp) p7_tophits_AliScores     (cfg.aliscoresfp, hmm[q]->name, qi->th);
+          if (cfg.hmmoutfp)    p7_hmmfile_WriteASCII    (cfg.hmmoutfp, /*fmt=default*/-1, hmm[q]);
 
+          esl_stopwatch_Stop(w);   // with --qbatch, times the whole batch up to this query's output
+          p7_pli_Statistics(cfg.ofp, qi->pli, w);
+          esl_fprintf(cfg.ofp, "//\n");
+        }
 
-      /* Clean up before next query. */
+      /* Clean up before next batch. */
       for (i = 0; i < infocnt; i++)
+        for (q = 0; q < nbatch; q++)
+          {
+            p7_pipeline_Destroy(info[i*cfg.qbatch + q].pli);
+            p7_tophits_Destroy (info[i*cfg.qbatch + q].th);
+            p7_oprofile_Destroy(info[i*cfg.qbatch + q].om);
+            p7_bg_Destroy      (info[i*cfg.qbatch + q].bg);
+            p7_hmm_ScoreDataDestroy(info[i*cfg.qbatch + q].scoredata);
+          }
+      for (q = 0; q < nbatch; q++)
         {
-          p7_pipeline_Destroy(info[i].pli);
-          p7_tophits_Destroy (info[i].th);
-          p7_oprofile_Destroy(info[i].om);
-          p7_bg_Destroy      (info[i].bg);
-          p7_hmm_ScoreDataDestroy(info[i].scoredata);
+          p7_hmm_ScoreDataDestroy(scoredata[q]);  scoredata[q] = NULL;
+          p7_oprofile_Destroy    (om[q]);         om[q]        = NULL;
+          p7_profile_Destroy     (gm[q]);         gm[q]        = NULL;
+          p7_hmm_Destroy         (hmm[q]);        hmm[q]       = NULL;
         }
-      p7_hmm_ScoreDataDestroy(scoredata);       scoredata      = NULL;
-      p7_oprofile_Destroy    (om);              om             = NULL;
-      p7_profile_Destroy     (gm);              gm             = NULL;
-      p7_hmm_Destroy         (hmm);             hmm            = NULL;
-      destroy_id_length      (id_length_list);  id_length_list = NULL;
-      if (qmsa) { esl_msa_Destroy(qmsa);        qmsa           = NULL; }
-      if (qsq)    esl_sq_Reuse(qsq);               
-    } // while (! done) loop over all queries
+      destroy_id_length(id_length_list);  id_length_list = NULL;
+    } // while (! done) loop over all query batches
 
 
   /* Terminate outputs - last words
@@ -602,11 +605,7 @@ main(int argc, char **argv)
         {
           while (esl_workqueue_Remove(queue, (void **) &fminfo) == eslOK)
             {
-              if (fminfo) {
-                if (fminfo->fmf) free(fminfo->fmf);
-                if (fminfo->fmb) free(fminfo->fmb);
-                free(fminfo);
-              }
+              if (fminfo) free(fminfo);
             }
         }
 #endif
@@ -619,10 +618,16 @@ main(int argc, char **argv)
   if (cfg.fmdb)
     {
       fclose(cfg.fmdb->meta->fp);
-      fm_configDestroy(cfg.fmdb);  // also destroys fm_meta and alphabet
+      fm_configDestroy(cfg.fmdb);  // also destroys fm_meta, alphabet, and the mapped blocks
     }
 #endif
 
+  if (qsq) esl_sq_Destroy(qsq);
+  free(hmm);
+  free(gm);
+  free(om);
+  free(scoredata);
+  free(ratio);
   free(info);
   esl_stopwatch_Destroy(w);
   esl_getopts_Destroy(go);
@@ -691,6 +696,7 @@ output_header(FILE *ofp, const ESL_GETOPTS *go, struct cfg_s *cfg)
   if (esl_opt_IsUsed(go, "--seed_req_pos"))       esl_fprintf(ofp, "# FM req positive run length:      %d\n", esl_opt_GetInteger(go, "--seed_req_pos"));
   if (esl_opt_IsUsed(go, "--seed_consens_match")) esl_fprintf(ofp, "# FM consec consensus match req:   %d\n", esl_opt_GetInteger(go, "--seed_consens_match"));
   if (esl_opt_IsUsed(go, "--seed_ssv_length"))    esl_fprintf(ofp, "# FM len used for Vit window:      %d\n", esl_opt_GetInteger(go, "--seed_ssv_length"));
+  if (esl_opt_IsUsed(go, "--qbatch"))             esl_fprintf(ofp, "# FM queries seeded per pass:      %d\n", esl_opt_GetInteger(go, "--qbatch"));
 #endif
 
   if (esl_opt_IsUsed(go, "--nonull2"))         esl_fprintf(ofp, "# null2 bias corrections:          off\n");
@@ -855,8 +861,15 @@ initialize_cfg(ESL_GETOPTS *go, struct cfg_s *cfg)
 
       if ( fm_configInit(cfg->fmdb, go)             != eslOK) p7_Fail("Failed to initialize FM configuration for target sequence database %s\n", cfg->dbfile);
       if ( fm_alphabetCreate(cfg->fmdb->meta, NULL) != eslOK) p7_Fail("Failed to create FM alphabet for target sequence database %s\n", cfg->dbfile);
+      if ( cfg->fmdb->meta->fwd_only)                         p7_Fail("FM-index %s was built with --fwd_only; nhmmer needs the backward index too\n", cfg->dbfile);
 
-      fgetpos( cfg->fmdb->meta->fp, &(cfg->fm_basepos));
+      /* Map every block once, for all queries and threads to share. If
+       * the index can't be mapped, its blocks are read one at a time for
+       * each query instead, so only one block is in memory at once.
+       */
+      status = fm_FM_map(cfg->fmdb->meta);
+      if      (status == eslENORESULT) fgetpos( cfg->fmdb->meta->fp, &(cfg->fm_basepos));
+      else if (status != eslOK)        p7_Fail("failed to map FM-index blocks from %s\n", cfg->dbfile);
       cfg->dbfp = NULL;
     }
   else
@@ -918,6 +931,11 @@ initialize_cfg(ESL_GETOPTS *go, struct cfg_s *cfg)
   cfg->F1 = esl_opt_GetReal(go, "--F1");
   if (cfg->fmdb && ! esl_opt_IsUsed(go, "--F1")) cfg->F1 = 0.03;  // default F1 MSV threshold for FM-index is a little looser, 0.03 instead of 0.02.
 
+  cfg->qbatch = 1;
+#ifdef p7ENABLE_FMINDEX
+  if (cfg->fmdb) cfg->qbatch = esl_opt_GetInteger(go, "--qbatch");
+#endif
+
   cfg->firstseq_key  = esl_opt_GetString (go, "--restrictdb_stkey");
   cfg->n_targetseq   = esl_opt_GetInteger(go, "--restrictdb_n");
 
@@ -1000,13 +1018,58 @@ serial_processor(ESL_SQFILE *dbfp, WORKER_INFO *info, ID_LENGTH_LIST *id_length_
  * with no thread parallelization, but with experimental FM-index
  * acceleration.
  *
- * This code is #ifdef'd under p7ENABLE_FMINDEX. The FM-index
- * implementation requires SSE vectorization (specifically).  When not
- * available, we provide an unused dummy function to satisfy the
- * compiler+linker.
+ * This code is #ifdef'd under p7ENABLE_FMINDEX. The FM-index no
+ * longer requires SSE (occurrence counting picks SSE, AVX2 or plain
+ * C at run time; see fm_occ.c), so p7ENABLE_FMINDEX is always
+ * on, but the dummy function for builds without it is kept.
  *****************************************************************/
 
 #ifdef p7ENABLE_FMINDEX
+/* fm_search_block()
+ *
+ * Search FM-index block <fmf>,<fmb> with one worker's batch of
+ * <info->nq> queries, whose WORKER_INFOs are <info[0..nq-1]>. The
+ * FM seed search walks the block once for the whole batch.
+ */
+static void
+fm_search_block(WORKER_INFO *info, const FM_DATA *fmf, const FM_DATA *fmb)
+{
+  P7_PIPELINE  **pli   = NULL;
+  P7_OPROFILE  **om    = NULL;
+  P7_SCOREDATA **data  = NULL;
+  P7_BG        **bg    = NULL;
+  P7_TOPHITS   **th    = NULL;
+  float         *ratio = NULL;
+  int            nq    = info->nq;
+  int            q;
+  int            status;
+
+  ESL_ALLOC(pli,   sizeof(P7_PIPELINE *)  * nq);
+  ESL_ALLOC(om,    sizeof(P7_OPROFILE *)  * nq);
+  ESL_ALLOC(data,  sizeof(P7_SCOREDATA *) * nq);
+  ESL_ALLOC(bg,    sizeof(P7_BG *)        * nq);
+  ESL_ALLOC(th,    sizeof(P7_TOPHITS *)   * nq);
+  ESL_ALLOC(ratio, sizeof(float)          * nq);
+  for (q = 0; q < nq; q++)
+    {
+      pli[q]   = info[q].pli;
+      om[q]    = info[q].om;
+      data[q]  = info[q].scoredata;
+      bg[q]    = info[q].bg;
+      th[q]    = info[q].th;
+      ratio[q] = info[q].sc_thresh_ratio;
+    }
+
+  if ( p7_Pipeline_LongTargetBatch(pli, om, data, bg, th, ratio, nq, fmf, fmb, info->fmdb) != eslOK)
+    p7_Fail("profile/sequence comparison pipeline failure");
+
+  free(pli); free(om); free(data); free(bg); free(th); free(ratio);
+  return;
+
+ ERROR:
+  p7_Fail("allocation failure in FM-index search");
+}
+
 static void
 serial_processor_FM(WORKER_INFO *info)
 {
@@ -1015,17 +1078,21 @@ serial_processor_FM(WORKER_INFO *info)
   FM_DATA      fmb;
   int          i;
 
-  for (i=0; i<info->fmdb->meta->block_count; i++ )
+  for (i=0; i<meta->block_count; i++ )
     {
+      if (meta->fmf)   // mapped: use the shared block
+        {
+          fm_search_block(info, meta->fmf+i, meta->fmb+i);
+          continue;
+        }
+
       if ( fm_FM_read( &fmf, meta, TRUE ) != eslOK) p7_Fail("FM index f read failed");
       if ( fm_FM_read( &fmb, meta, FALSE) != eslOK) p7_Fail("FM index b read failed");
 
       fmb.SA = fmf.SA;
       fmb.T  = fmf.T;
 
-      if ( p7_Pipeline_LongTarget(info->pli, info->om, info->scoredata, info->bg,
-                                  info->th, -1, NULL, -1,  &fmf, &fmb, info->fmdb) != eslOK)
-        p7_Fail("profile/sequence comparison pipeline failure");
+      fm_search_block(info, &fmf, &fmb);
 
       fm_FM_destroy(&fmf, 1);
       fm_FM_destroy(&fmb, 0);
@@ -1261,14 +1328,24 @@ thread_director_FM(WORKER_INFO *info, ESL_THREADS *obj, ESL_WORK_QUEUE *queue)
   fminfo = (FM_THREAD_INFO *) workpacket;
 
   /* Main loop: */
-  for (i=0; i<info->fmdb->meta->block_count; i++ )
+  for (i=0; i<meta->block_count; i++ )
     {
-      if ( fm_FM_read( fminfo->fmf, meta, TRUE ) != eslOK) p7_Fail("FM index f read failed");
-      if ( fm_FM_read( fminfo->fmb, meta, FALSE) != eslOK) p7_Fail("FM index b read failed");
+      if (meta->fmf)   // mapped: hand out the shared block
+        {
+          fminfo->fmf = meta->fmf+i;
+          fminfo->fmb = meta->fmb+i;
+        }
+      else
+        {
+          fminfo->fmf = &(fminfo->fmf_rd);
+          fminfo->fmb = &(fminfo->fmb_rd);
+          if ( fm_FM_read( fminfo->fmf, meta, TRUE ) != eslOK) p7_Fail("FM index f read failed");
+          if ( fm_FM_read( fminfo->fmb, meta, FALSE) != eslOK) p7_Fail("FM index b read failed");
 
-      fminfo->fmb->SA = fminfo->fmf->SA;
-      fminfo->fmb->T  = fminfo->fmf->T;
-      fminfo->active  = TRUE;
+          fminfo->fmb->SA = fminfo->fmf->SA;
+          fminfo->fmb->T  = fminfo->fmf->T;
+        }
+      fminfo->active = TRUE;
 
       if (esl_workqueue_ReaderUpdate(queue, fminfo, &workpacket) != eslOK) p7_Fail("workqueue reader update failure");
       fminfo = (FM_THREAD_INFO *) workpacket;
@@ -1310,11 +1387,13 @@ thread_worker_FM(void *arg)
 
   while (fmwork->active)
     {
-      if (p7_Pipeline_LongTarget(info->pli, info->om, info->scoredata, info->bg, info->th, -1, NULL, -1, fmwork->fmf, fmwork->fmb, info->fmdb) != eslOK)
-        p7_Fail("pipeline failed in FM worker thread");
+      fm_search_block(info, fmwork->fmf, fmwork->fmb);
 
-      fm_FM_destroy(fmwork->fmf, 1);
-      fm_FM_destroy(fmwork->fmb, 0);
+      if (fmwork->fmf == &(fmwork->fmf_rd))   // a streamed block, not a shared one
+        {
+          fm_FM_destroy(fmwork->fmf, 1);
+          fm_FM_destroy(fmwork->fmb, 0);
+        }
 
       if (esl_workqueue_WorkerUpdate(info->queue, fmwork, &workpacket) != eslOK) p7_Fail("work queue update failed");
       fmwork = (FM_THREAD_INFO *) workpacket;
@@ -1415,6 +1494,65 @@ assign_Lengths(P7_TOPHITS *th, ID_LENGTH_LIST *id_length_list) {
  * 12. Other misc local functions
  *****************************************************************/
 
+/* read_query()
+ *
+ * Read the next query from <cfg>'s query file into <*ret_hmm>. If
+ * it's a sequence (--qseq, read into <*qsq>, created here on first
+ * use) or an MSA (--qmsa), build a profile HMM from it. <nquery> is
+ * how many queries have been read so far. Returns <eslOK>, or
+ * <eslEOF> when there are no more queries; fails with an error
+ * message on anything else, including an empty query file.
+ */
+static int
+read_query(struct cfg_s *cfg, int nquery, ESL_SQ **qsq, int *msas_named, P7_HMM **ret_hmm)
+{
+  ESL_MSA *qmsa = NULL;
+  int      status;
+
+  if (cfg->hfp)
+    {
+      status = p7_hmmfile_Read(cfg->hfp, &(cfg->abc), ret_hmm);
+      if (nquery && status == eslEOF)  return eslEOF;
+      else if (status == eslEFORMAT)   p7_Fail("Bad file format in profile HMM file %s:\n%s\n",          cfg->hfp->fname, cfg->hfp->errbuf);
+      else if (status == eslEINCOMPAT) p7_Fail("Profile HMM in %s is not in the expected %s alphabet\n", cfg->hfp->fname, esl_abc_DecodeType(cfg->abc->type));
+      else if (status == eslEOF)       p7_Fail("No profiles found - is file %s empty?\n",                cfg->hfp->fname); 
+      else if (status != eslOK)        p7_Fail("Unexpected error in reading profile HMMs from %s\n",     cfg->hfp->fname);
+    }
+  else if (cfg->qseq_fp)
+    {
+      if (! *qsq) *qsq = esl_sq_CreateDigital(cfg->abc);
+
+      status = esl_sqio_Read(cfg->qseq_fp, *qsq);
+      if      (nquery && status == eslEOF) return eslEOF;
+      else if (status == eslEFORMAT)       p7_Fail("Sequence file parsing failed\n  %s", esl_sqfile_GetErrorBuf(cfg->qseq_fp));
+      else if (status == eslEOF)           p7_Fail("No sequences found - is file %s empty?\n", cfg->queryfile); 
+      else if (status != eslOK)            p7_Fail("Unexpected error %d in reading sequence file %s", status, cfg->queryfile);
+ 
+      status = p7_SingleBuilder(cfg->builder, *qsq, cfg->bg, ret_hmm, /*opt_tr=*/NULL, /*opt_gm=*/NULL, /*opt_om*/NULL);
+      if (status != eslOK) p7_Fail("Single sequence profile construction failed for %s", (*qsq)->name);
+      esl_sq_Reuse(*qsq);
+    }
+  else if (cfg->qmsa_fp)
+    {
+      status = esl_msafile_Read(cfg->qmsa_fp, &qmsa);
+      if      (nquery && status == eslEOF) return eslEOF;
+      else if (status != eslOK)            esl_msafile_ReadFailure(cfg->qmsa_fp, status);
+
+      if (! qmsa->name) {  // If one MSA lacks a name, we can name it using the filename. More than one, we fail out.
+        if (*msas_named) p7_Fail("Name annotation is required for each alignment in a multi MSA file; failed on #%d", nquery);
+        assign_msa_name(cfg, qmsa);
+        (*msas_named)++;
+      }
+          
+      status = p7_Builder(cfg->builder, qmsa, cfg->bg, ret_hmm, /*opt_tr=*/NULL, /*opt_gm=*/NULL, /*opt_om*/NULL, /*opt_postmsa*/NULL);
+      if      (status == eslEFORMAT)    p7_Fail("MSA %s has a format problem - maybe no reference annotation line?", qmsa->name ? qmsa->name : "(unnamed)"); // shouldn't happen. nhmmer doesn't have --hand construction.
+      else if (status == eslENORESULT)  p7_Fail("No consensus columns found for some reason in input MSA");
+      else if (status != eslOK)         p7_Fail("Failed to build profile from input MSA - unexpected error %d", status);
+      esl_msa_Destroy(qmsa);
+    }
+  return eslOK;
+}
+
 
 static void
 assign_msa_name(struct cfg_s *cfg, ESL_MSA *msa)
@@ -1438,9 +1576,12 @@ assign_msa_name(struct cfg_s *cfg, ESL_MSA *msa)
  * then the requested score threshold will be shifted down according
  * to this ratio.  
  * xref: ~wheelert/notebook/2014/03-04-FM-time-v-len/00NOTES -- Thu Mar 6 14:40:48 EST 2014
+ *
+ * The ratio is returned in <*ret_ratio>; each query in a --qbatch
+ * batch has its own.
  */
 static P7_SCOREDATA *
-create_fm_scoredata(struct cfg_s *cfg, P7_PROFILE *gm, P7_OPROFILE *om)
+create_fm_scoredata(struct cfg_s *cfg, P7_PROFILE *gm, P7_OPROFILE *om, float *ret_ratio)
 {
   float best_sc_avg = 0.;
   float max_score;
@@ -1457,7 +1598,7 @@ create_fm_scoredata(struct cfg_s *cfg, P7_PROFILE *gm, P7_OPROFILE *om)
   best_sc_avg /= sqrt((double) gm->M);    // divide by M to get score density; multiply by sqrt(M) as estimate for expected LCS
   best_sc_avg = ESL_MAX(5.0,best_sc_avg); // don't let it get too low, or run time will dramatically suffer
 
-  cfg->fmdb->sc_thresh_ratio = ESL_MIN(best_sc_avg/7.0, 1.0); // (SRE: 7.0 is mysterious here)
+  *ret_ratio = ESL_MIN(best_sc_avg/7.0, 1.0); // (SRE: 7.0 is mysterious here)
   return p7_hmm_ScoreDataCreate(om, gm);
 }  
 #endif
@@ -436,6 +436,34 @@ p7_alidisplay_Sizeof(const P7_ALIDISPLAY *ad)
 #define SER_BASE_SIZE ((5 * sizeof(int)) + (3 * sizeof(int64_t)) +1) // Total size of the fixed-length fields in a 
 // serialized P7_ALIDISPLAY 
 
+/* Function:  p7_alidisplay_SerializedSize()
+ * Synopsis:  Returns the size of a serialized P7_ALIDISPLAY, in bytes.
+ *
+ * Purpose:   Return the number of bytes that <p7_alidisplay_Serialize()>
+ *            will write for <obj>, so that a caller serializing many
+ *            objects can size its buffer once.
+ */
+uint32_t
+p7_alidisplay_SerializedSize(const P7_ALIDISPLAY *obj)
+{
+  uint32_t ser_size = SER_BASE_SIZE;
+
+  if (obj->rfline) ser_size += obj->N+1; /* +1 for \0 */
+  if (obj->mmline) ser_size += obj->N+1;
+  if (obj->csline) ser_size += obj->N+1;
+  ser_size += 2 * (obj->N+1);           /* model, mline */
+  if (obj->aseq)   ser_size += obj->N+1;
+  if (obj->ntseq)  ser_size += (3 * obj->N) + 1;
+  if (obj->ppline) ser_size += obj->N+1;
+  ser_size += 1 + strlen(obj->hmmname);
+  ser_size += 1 + strlen(obj->hmmacc);
+  ser_size += 1 + strlen(obj->hmmdesc);
+  ser_size += 1 + strlen(obj->sqname);
+  ser_size += 1 + strlen(obj->sqacc);
+  ser_size += 1 + strlen(obj->sqdesc);
+  return ser_size;
+}
+
 /* Function:  p7_alidisplay_Serialize
  * Synopsis:  Serializes a HMMD_SEARCH_STATS object into a stream of bytes
  *.           that can be reliably transmitted over internet sockets
@@ -680,206 +708,208 @@ int p7_alidisplay_Serialize(const P7_ALIDISPLAY *obj, uint8_t **buf, uint32_t *n
     return eslEMEM;
 }
 
-/* Function:  p7_alidisplay_Deserialize
- * Synopsis:  Derializes a P7_ALIDISPLAY object from a stream of bytes in network order into
- *            a valid data structure
- *
- * Purpose:   Deserializes a serialized P7_ALIDISPLAY object from
- *.           buf starting at position position *pos.  
- *
- * Inputs:    buf: the buffer that the object should be de-serialized from
- *            pos: a pointer to the offset from the start of buf to the beginning of the object
- *            ret_obj: a P7_ALIDISPLAY structure to deserialize the object into.  May not be NULL. May either be an 
- *            "empty" object created with p7_alidisplay_Create_empty, or a P7_ALIDISPLAY object containing valid data
- *
- * Returns:   On success: returns eslOK, deserializes the P7_ALIDISPLAY object into ret_object, and updates 
- *.           pos to point to the position after the end of the P7_ALIDISPLAY object.
- *
- * Throws:    Returns eslEINVAL if ret_obj == NULL, buf == NULL, or N == NULL.  Returns eslEMEM if unable to increase
- *            the buffer in ret_obj to match the size of the deserialized object. Returns eslFAIL if one of the
- *            internal calculations fails a consistency check.
+/* deserialize_header()
+ * Decodes the fixed-length fields of the serialized P7_ALIDISPLAY at
+ * <ptr> into <ad>; returns the object's serialized size in <*ret_size>,
+ * its presence flags in <*ret_flags>, and a pointer to its strings.
  */
-extern int p7_alidisplay_Deserialize(const uint8_t *buf, uint32_t *n, P7_ALIDISPLAY *ret_obj){
-  int status;  // Standard Easel error code variable
-
-  uint8_t *ptr;
-  char *mem_ptr;
+static const uint8_t *
+deserialize_header(const uint8_t *ptr, P7_ALIDISPLAY *ad, uint32_t *ret_size, uint8_t *ret_flags)
+{
   uint64_t network_64bit; // holds 64-bit values in network order 
-  uint32_t network_32bit; // holds 64-bit values in network order 
-  uint32_t obj_size; // How much space does the variable-length portion of the serialized object take up?
-  uint8_t presence_flags; // bit-vector that tells us which strings are present in the object
-  int string_length; // used to hold the length of strings copied out of serialized object
-
-  if ((buf == NULL) || (ret_obj == NULL) || (n == NULL)){ // check to make sure we've been passed valid objects
-      return(eslEINVAL);
-  }
+  uint32_t network_32bit; // holds 32-bit values in network order 
 
-  mem_ptr = NULL; // set this for safety
-  ptr = (uint8_t *) buf + *n; // Get pointer to start of the object
   //First field: Size of the serialized object.  Copy out of buffer into scalar variable to deal with memory alignment, convert to 
   // host machine order
   memcpy(&network_32bit, ptr, sizeof(uint32_t)); // Grab the bytes out of the buffer
-  obj_size = esl_ntoh32(network_32bit);
+  *ret_size = esl_ntoh32(network_32bit);
   ptr += sizeof(uint32_t);
 
-  if(ret_obj->memsize < (obj_size - SER_BASE_SIZE)){  // ret_obj doesn't have enough space for this P7_ALIDISPLAY
-    if(ret_obj->mem != NULL){
-      ESL_REALLOC(ret_obj->mem, (obj_size - SER_BASE_SIZE));
-    }
-    else{
-      ESL_ALLOC(ret_obj->mem, (obj_size - SER_BASE_SIZE));
-    }
-    ret_obj->memsize = obj_size - SER_BASE_SIZE;
-  }
-
   // Second field: N
   memcpy(&network_32bit, ptr, sizeof(uint32_t)); // Grab the bytes out of the buffer
-  ret_obj->N = esl_ntoh32(network_32bit);
+  ad->N = esl_ntoh32(network_32bit);
   ptr += sizeof(uint32_t);
 
   // Third field: Hmmfrom
   memcpy(&network_32bit, ptr, sizeof(uint32_t)); 
-  ret_obj->hmmfrom = esl_ntoh32(network_32bit);
+  ad->hmmfrom = esl_ntoh32(network_32bit);
   ptr += sizeof(uint32_t);
 
   // Fourth field: Hmmto
   memcpy(&network_32bit, ptr, sizeof(uint32_t)); 
-  ret_obj->hmmto = esl_ntoh32(network_32bit);
+  ad->hmmto = esl_ntoh32(network_32bit);
   ptr += sizeof(uint32_t);
 
   // Fifth field: M 
   memcpy(&network_32bit, ptr, sizeof(uint32_t)); 
-  ret_obj->M = esl_ntoh32(network_32bit);
+  ad->M = esl_ntoh32(network_32bit);
   ptr += sizeof(uint32_t);
 
   // Sixth field: sqfrom
   memcpy(&network_64bit, ptr, sizeof(uint64_t)); 
-  ret_obj->sqfrom = esl_ntoh64(network_64bit);
+  ad->sqfrom = esl_ntoh64(network_64bit);
   ptr += sizeof(uint64_t);
 
   // Seventh field: sqto
   memcpy(&network_64bit, ptr, sizeof(uint64_t)); 
-  ret_obj->sqto = esl_ntoh64(network_64bit);
+  ad->sqto = esl_ntoh64(network_64bit);
   ptr += sizeof(uint64_t);
 
   // Eighth field: L
   memcpy(&network_64bit, ptr, sizeof(uint64_t)); 
-  ret_obj->L = esl_ntoh64(network_64bit);
+  ad->L = esl_ntoh64(network_64bit);
   ptr += sizeof(uint64_t);
 
   // Ninth field: presence flags
-  presence_flags = *ptr; // no need for memcpy with one-byte field
+  *ret_flags = *ptr; // no need for memcpy with one-byte field
   ptr += sizeof(uint8_t);
 
-  // Bulk copy the strings into the alidisplay's mem field
-  memcpy(ret_obj->mem, ptr, (obj_size - SER_BASE_SIZE)); 
-  mem_ptr = ret_obj->mem;
-  ptr += (obj_size - SER_BASE_SIZE);
-  // Tenth field: rfline, if present
-
-  if(ptr != buf + *n + obj_size){
-    ESL_EXCEPTION(eslFAIL, "In p7_alidisplay_Deserialize, found object (ptr) to be of size %ld, expected %u.\n", (long int) (ptr - (buf + *n)), obj_size);
-  }
+  return ptr;
+}
 
+/* point_strings()
+ * Sets the string pointers of <ad> to the consecutive \0-terminated
+ * strings starting at <mem_ptr>, as laid out by p7_alidisplay_Serialize();
+ * returns a pointer just past the last one.
+ */
+static char *
+point_strings(P7_ALIDISPLAY *ad, char *mem_ptr, uint8_t presence_flags)
+{
+  // Tenth field: rfline, if present
   if(presence_flags & RFLINE_PRESENT){
-    ret_obj->rfline = mem_ptr;
-    string_length = strlen(ret_obj->rfline);
-    mem_ptr+= string_length +1; // + 1 to account for end-of-string character
+    ad->rfline = mem_ptr;
+    mem_ptr+= strlen(ad->rfline) +1; // + 1 to account for end-of-string character
   }
   else{ // not present
-    ret_obj->rfline = NULL; 
+    ad->rfline = NULL; 
   }
 
   // Eleventh field: mmline, if present
   if(presence_flags & MMLINE_PRESENT){
-    ret_obj->mmline = mem_ptr;
-    string_length = strlen(ret_obj->mmline);
-    mem_ptr+= string_length + 1;
+    ad->mmline = mem_ptr;
+    mem_ptr+= strlen(ad->mmline) + 1;
   }
   else{ // not present
-    ret_obj->mmline = NULL; 
+    ad->mmline = NULL; 
   }
 
   // Twelfth field: csline, if present
   if(presence_flags & CSLINE_PRESENT){
-    ret_obj->csline = mem_ptr;
-    string_length = strlen(ret_obj->csline);
-    mem_ptr+= string_length + 1;
+    ad->csline = mem_ptr;
+    mem_ptr+= strlen(ad->csline) + 1;
   }
   else{ // not present
-    ret_obj->csline = NULL; 
+    ad->csline = NULL; 
   }
 
-
   // Thirteenth field: model
-  ret_obj->model = mem_ptr;
-  string_length = strlen(ret_obj->model);
-  mem_ptr+= string_length + 1;
+  ad->model = mem_ptr;
+  mem_ptr+= strlen(ad->model) + 1;
 
  // Thirteenth field: mline
-  ret_obj->mline = mem_ptr;
-  string_length = strlen(ret_obj->mline);
-  mem_ptr+= string_length + 1;
+  ad->mline = mem_ptr;
+  mem_ptr+= strlen(ad->mline) + 1;
 
   // Fourteenth field: aseq, if present
   if(presence_flags & ASEQ_PRESENT){
-    ret_obj->aseq = mem_ptr;
-    string_length = strlen(ret_obj->aseq);
-    mem_ptr+= string_length + 1;
+    ad->aseq = mem_ptr;
+    mem_ptr+= strlen(ad->aseq) + 1;
   }
   else{ // not present
-    ret_obj->aseq = NULL; 
+    ad->aseq = NULL; 
   }
 
   // Fifteenth field: ntseq, if present
   if(presence_flags & NTSEQ_PRESENT){
-    ret_obj->ntseq = mem_ptr;
-    string_length = strlen(ret_obj->ntseq);
-    mem_ptr+= string_length + 1;
+    ad->ntseq = mem_ptr;
+    mem_ptr+= strlen(ad->ntseq) + 1;
   }
   else{ // not present
-    ret_obj->ntseq = NULL; 
+    ad->ntseq = NULL; 
   }
 
   // Sixteenth field: ppline, if present
   if(presence_flags & PPLINE_PRESENT){
-    ret_obj->ppline = mem_ptr;
-    string_length = strlen(ret_obj->ppline);
-    mem_ptr+= string_length + 1;
+    ad->ppline = mem_ptr;
+    mem_ptr+= strlen(ad->ppline) + 1;
   }
   else{ // not present
-    ret_obj->ppline = NULL; 
+    ad->ppline = NULL; 
   }
 
   // Seventeenth field: hmmname
-  ret_obj->hmmname = mem_ptr;
-  string_length = strlen(ret_obj->hmmname);
-  mem_ptr+= string_length + 1;
+  ad->hmmname = mem_ptr;
+  mem_ptr+= strlen(ad->hmmname) + 1;
 
   // Eighteenth field: hmmacc
-  ret_obj->hmmacc = mem_ptr;
-  string_length = strlen(ret_obj->hmmacc);
-  mem_ptr+= string_length + 1;
+  ad->hmmacc = mem_ptr;
+  mem_ptr+= strlen(ad->hmmacc) + 1;
 
   // Nineteenth field: hmmdesc 
-  ret_obj->hmmdesc = mem_ptr;
-  string_length = strlen(ret_obj->hmmdesc);
-  mem_ptr+= string_length + 1;
+  ad->hmmdesc = mem_ptr;
+  mem_ptr+= strlen(ad->hmmdesc) + 1;
 
   // Twentyith field: sqname
-  ret_obj->sqname = mem_ptr;
-  string_length = strlen(ret_obj->sqname);
-  mem_ptr+= string_length + 1;
+  ad->sqname = mem_ptr;
+  mem_ptr+= strlen(ad->sqname) + 1;
 
   // Twentyfirst field: sqacc
-  ret_obj->sqacc = mem_ptr;
-  string_length = strlen(ret_obj->sqacc);
-  mem_ptr+= string_length + 1;
+  ad->sqacc = mem_ptr;
+  mem_ptr+= strlen(ad->sqacc) + 1;
 
   // Twentysecond field: sqdesc
-  ret_obj->sqdesc = mem_ptr;
-  string_length = strlen(ret_obj->sqdesc);
-  mem_ptr+= string_length +1;
+  ad->sqdesc = mem_ptr;
+  mem_ptr+= strlen(ad->sqdesc) +1;
+
+  return mem_ptr;
+}
+
+/* Function:  p7_alidisplay_Deserialize
+ * Synopsis:  Derializes a P7_ALIDISPLAY object from a stream of bytes in network order into
+ *            a valid data structure
+ *
+ * Purpose:   Deserializes a serialized P7_ALIDISPLAY object from
+ *.           buf starting at position position *pos.  
+ *
+ * Inputs:    buf: the buffer that the object should be de-serialized from
+ *            pos: a pointer to the offset from the start of buf to the beginning of the object
+ *            ret_obj: a P7_ALIDISPLAY structure to deserialize the object into.  May not be NULL. May either be an 
+ *            "empty" object created with p7_alidisplay_Create_empty, or a P7_ALIDISPLAY object containing valid data
+ *
+ * Returns:   On success: returns eslOK, deserializes the P7_ALIDISPLAY object into ret_object, and updates 
+ *.           pos to point to the position after the end of the P7_ALIDISPLAY object.
+ *
+ * Throws:    Returns eslEINVAL if ret_obj == NULL, buf == NULL, or N == NULL.  Returns eslEMEM if unable to increase
+ *            the buffer in ret_obj to match the size of the deserialized object. Returns eslFAIL if one of the
+ *            internal calculations fails a consistency check.
+ */
+extern int p7_alidisplay_Deserialize(const uint8_t *buf, uint32_t *n, P7_ALIDISPLAY *ret_obj){
+  int status;  // Standard Easel error code variable
+
+  const uint8_t *ptr;
+  char *mem_ptr;
+  uint32_t obj_size; // How much space does the variable-length portion of the serialized object take up?
+  uint8_t presence_flags; // bit-vector that tells us which strings are present in the object
+
+  if ((buf == NULL) || (ret_obj == NULL) || (n == NULL)){ // check to make sure we've been passed valid objects
+      return(eslEINVAL);
+  }
+
+  ptr = deserialize_header(buf + *n, ret_obj, &obj_size, &presence_flags);
+
+  if(ret_obj->memsize < (obj_size - SER_BASE_SIZE)){  // ret_obj doesn't have enough space for this P7_ALIDISPLAY
+    if(ret_obj->mem != NULL){
+      ESL_REALLOC(ret_obj->mem, (obj_size - SER_BASE_SIZE));
+    }
+    else{
+      ESL_ALLOC(ret_obj->mem, (obj_size - SER_BASE_SIZE));
+    }
+    ret_obj->memsize = obj_size - SER_BASE_SIZE;
+  }
+
+  // Bulk copy the strings into the alidisplay's mem field
+  memcpy(ret_obj->mem, ptr, (obj_size - SER_BASE_SIZE)); 
+  mem_ptr = point_strings(ret_obj, ret_obj->mem, presence_flags);
 
   // Sanity-check that we got the length right
   if(mem_ptr - ret_obj->mem != (obj_size - SER_BASE_SIZE)){
@@ -892,6 +922,49 @@ extern int p7_alidisplay_Deserialize(const uint8_t *buf, uint32_t *n, P7_ALIDISP
     return eslEMEM;
 }
 
+
+/* Function:  p7_alidisplay_DeserializeShared()
+ * Synopsis:  Deserializes a P7_ALIDISPLAY without copying its strings.
+ *
+ * Purpose:   Same as <p7_alidisplay_Deserialize()>, except that the
+ *            strings of <ret_obj> are left where they are in <buf>
+ *            instead of being copied into <ret_obj->mem>; nothing is
+ *            allocated. <ret_obj->mem> is set to <NULL>.
+ *
+ *            <buf> must stay allocated, and unchanged, for as long as
+ *            <ret_obj> is in use, and <ret_obj> must not be passed to
+ *            <p7_alidisplay_Destroy()>. This is for the server's flat
+ *            hit blocks (see p7_hitblock.c), which own both.
+ *
+ * Returns:   <eslOK> on success, and updates <*n> to point just past the
+ *            object.
+ *
+ * Throws:    <eslEINVAL> if <buf>, <n> or <ret_obj> is <NULL>.
+ *            <eslFAIL> if the object's strings don't add up to its
+ *            recorded size.
+ */
+int
+p7_alidisplay_DeserializeShared(uint8_t *buf, uint32_t *n, P7_ALIDISPLAY *ret_obj)
+{
+  char     *mem_ptr;
+  char     *end_ptr;
+  uint32_t  obj_size;
+  uint8_t   presence_flags;
+
+  if (buf == NULL || ret_obj == NULL || n == NULL) return eslEINVAL;
+
+  deserialize_header(buf + *n, ret_obj, &obj_size, &presence_flags);
+  mem_ptr = (char *) buf + *n + SER_BASE_SIZE;
+  end_ptr = point_strings(ret_obj, mem_ptr, presence_flags);
+  if (end_ptr - mem_ptr != (obj_size - SER_BASE_SIZE))
+    ESL_EXCEPTION(eslFAIL, "p7_alidisplay_DeserializeShared found strings of size %ld, expected %ld.\n", (long)(end_ptr - mem_ptr), (long)(obj_size - SER_BASE_SIZE));
+
+  ret_obj->mem     = NULL;
+  ret_obj->memsize = 0;
+  *n += obj_size;
+  return eslOK;
+}
+
 /* Function:  p7_alidisplay_Serialize()
  * Synopsis:  Serialize a P7_ALIDISPLAY, using internal memory.
  *
@@ -467,18 +467,49 @@ p7_bg_SetFilter(P7_BG *bg, int M, const float *compo)
  *            The filter null model has no length distribution of its
  *            own; the same geometric length distribution (controlled
  *            by <bg->p1>) that the null1 model uses is imposed.
+ *
+ *            This is the scaled Forward of <esl_hmm_Forward()>,
+ *            specialized to the two states of <bg->fhmm>: it keeps
+ *            just the current pair of cells, so it allocates nothing,
+ *            and it works in double precision so that it only has to
+ *            rescale (and take a log) every 32 residues, not every
+ *            residue. Emission odds per state can't be more than
+ *            1/f_min for the smallest background frequency, nor less
+ *            than the smallest composition value, so 32 steps stay
+ *            well inside double range.
  */
 int
 p7_bg_FilterScore(P7_BG *bg, const ESL_DSQ *dsq, int L, float *ret_sc)
 {
-  ESL_HMX *hmx = esl_hmx_Create(L, bg->fhmm->M); /* optimization target: this can be a 2-row matrix, and it can be stored in <bg>. */
-  float nullsc;		                  	 /* (or it could be passed in as an arg, but for sure it shouldn't be alloc'ed here */
-  
-  esl_hmm_Forward(dsq, L, bg->fhmm, hmx, &nullsc);
+  float  **t     = bg->fhmm->t;
+  float  **eo    = bg->fhmm->eo;
+  double   logsc = 0.;
+  double   f0, f1, nf0;
+  int      i;
+
+  if (L == 0) logsc = log(bg->fhmm->pi[2]);   /* the filter HMM can't generate an empty sequence; same as esl_hmm_Forward() */
+  else
+    {
+      f0 = bg->fhmm->pi[0] * eo[dsq[1]][0];
+      f1 = bg->fhmm->pi[1] * eo[dsq[1]][1];
+      for (i = 2; i <= L; i++)
+	{
+	  nf0 = (f0 * t[0][0] + f1 * t[1][0]) * eo[dsq[i]][0];
+	  f1  = (f0 * t[0][1] + f1 * t[1][1]) * eo[dsq[i]][1];
+	  f0  = nf0;
+
+	  if ((i & 31) == 0) {
+	    nf0    = f0 + f1;
+	    f0    /= nf0;
+	    f1    /= nf0;
+	    logsc += log(nf0);
+	  }
+	}
+      logsc += log(f0 * t[0][2] + f1 * t[1][2]);
+    }
 
   /* impose the length distribution */
-  *ret_sc = nullsc + (float) L * logf(bg->p1) + logf(1.-bg->p1);
-  esl_hmx_Destroy(hmx);
+  *ret_sc = (float) logsc + (float) L * logf(bg->p1) + logf(1.-bg->p1);
   return eslOK;
 }
 
@@ -556,6 +587,7 @@ main(int argc, char **argv)
 #ifdef p7BG_TESTDRIVE
 #include "esl_dirichlet.h"
 #include "esl_random.h"
+#include "esl_randomseq.h"
 
 static void
 utest_ReadWrite(ESL_RANDOMNESS *rng)
@@ -588,6 +620,54 @@ utest_ReadWrite(ESL_RANDOMNESS *rng)
   free(fq);
   remove(tmpfile);
 }
+
+/* utest_FilterScore()
+ * 
+ * p7_bg_FilterScore() is a specialized Forward; check it against the
+ * general one, esl_hmm_Forward(), on random sequences of random lengths
+ * (including 0 and lengths that do and don't end on a rescaling
+ * boundary), with random model compositions.
+ */
+static void
+utest_FilterScore(ESL_RANDOMNESS *rng)
+{
+  char          msg[]  = "bg FilterScore unit test failed";
+  ESL_ALPHABET *abc    = esl_alphabet_Create(eslAMINO);
+  P7_BG        *bg     = p7_bg_Create(abc);
+  float        *compo  = malloc(sizeof(float) * abc->K);
+  ESL_DSQ      *dsq    = malloc(sizeof(ESL_DSQ) * 1002);
+  ESL_HMX      *hmx    = esl_hmx_Create(1000, bg->fhmm->M);
+  int           ntrials = 50;
+  float         sc, sc0;
+  int           L, trial;
+
+  if (abc == NULL || bg == NULL || compo == NULL || dsq == NULL || hmx == NULL) esl_fatal(msg);
+
+  for (trial = 0; trial < ntrials; trial++)
+    {
+      L = (trial == 0 ? 0 : (trial == 1 ? 64 : esl_rnd_Roll(rng, 1000) + 1));
+      if (esl_dirichlet_FSampleUniform(rng, abc->K, compo)  != eslOK) esl_fatal(msg);
+      esl_vec_FScale(compo, abc->K, 0.5);        /* keep compositions away from 0, as real ones are */
+      esl_vec_FIncrement(compo, abc->K, 0.5 / (float) abc->K);
+      if (p7_bg_SetFilter(bg, esl_rnd_Roll(rng, 400) + 1, compo) != eslOK) esl_fatal(msg);
+      if (p7_bg_SetLength(bg, L)                          != eslOK) esl_fatal(msg);
+      if (esl_rsq_xfIID(rng, bg->f, abc->K, L, dsq)       != eslOK) esl_fatal(msg);
+      if (L > 0) dsq[esl_rnd_Roll(rng, L) + 1] = esl_abc_XGetUnknown(abc);  /* a degenerate residue */
+
+      if (p7_bg_FilterScore(bg, dsq, L, &sc)              != eslOK) esl_fatal(msg);
+      if (esl_hmm_Forward(dsq, L, bg->fhmm, hmx, &sc0)    != eslOK) esl_fatal(msg);
+      sc0 += (float) L * logf(bg->p1) + logf(1.-bg->p1);
+
+      if (L == 0) { if (sc != sc0) esl_fatal(msg); }
+      else if (esl_FCompare(sc, sc0, 1e-4, 1e-3)          != eslOK) esl_fatal(msg);
+    }
+
+  esl_hmx_Destroy(hmx);
+  free(dsq);
+  free(compo);
+  p7_bg_Destroy(bg);
+  esl_alphabet_Destroy(abc);
+}
 #endif /*p7BG_TESTDRIVE*/
 
 
@@ -626,6 +706,7 @@ main(int argc, char **argv)
   if (be_verbose) printf("p7_bg unit test: rng seed %" PRIu32 "\n", esl_randomness_GetSeed(rng));
 
   utest_ReadWrite(rng);
+  utest_FilterScore(rng);
 
   esl_randomness_Destroy(rng);
   esl_getopts_Destroy(go);
@@ -122,6 +122,25 @@ ERROR:
   return status;
 }
 
+// base size is 2 ints bigger than required for the fixed-length members of the strucuture, one int for the serialized length,
+// one int for the length of the scores_per_pos array (in floats)
+#define SER_BASE_SIZE (4 * sizeof(int)) + (6 * sizeof(int64_t)) + (5 * sizeof(float)) + (sizeof(double))
+
+/* Function:  p7_domain_SerializedSize
+ * Synopsis:  Returns the size of a serialized P7_DOMAIN, in bytes.
+ *
+ * Purpose:   Return the number of bytes that <p7_domain_Serialize()> will
+ *            write for <obj>, including its enclosed P7_ALIDISPLAY.
+ */
+extern uint32_t p7_domain_SerializedSize(const P7_DOMAIN *obj){
+  uint32_t ser_size = SER_BASE_SIZE;
+
+  if(obj->scores_per_pos != NULL){
+    ser_size += obj->ad->N * sizeof(float);
+  }
+  return ser_size + p7_alidisplay_SerializedSize(obj->ad);
+}
+
 /* Function:  p7_domain_Serialize
  * Synopsis:  Serializes a P7_DOMAIN object into a stream of bytes
  *.           that can be reliably transmitted over internet sockets
@@ -148,11 +167,6 @@ ERROR:
  *            or if *buf = NULL and either *n != 0 or *nalloc != 0
  *            Returns eslFAIL if a calculation fails a consistency check.   
  */
-
-// base size is 2 ints bigger than required for the fixed-length members of the strucuture, one int for the serialized length,
-// one int for the length of the scores_per_pos array (in floats)
-#define SER_BASE_SIZE (4 * sizeof(int)) + (6 * sizeof(int64_t)) + (5 * sizeof(float)) + (sizeof(double))
-
 extern int p7_domain_Serialize(const P7_DOMAIN *obj, uint8_t **buf, uint32_t *n, uint32_t *nalloc){
 
   int status; // error variable used by ESL_ALLOC
@@ -302,45 +316,23 @@ ERROR:
   return eslEMEM;
 }
 
-/* Function:  p7_domain_Deserialize
- * Synopsis:  Derializes a P7_DOMAIN object from a stream of bytes in network order into
- *            a valid data structure
- *
- * Purpose:   Deserializes a serialized P7_DOMAIN object from
- *.           buf starting at position position *pos.  
- *
- * Inputs:    buf: the buffer that the object should be de-serialized from
- *            pos: a pointer to the offset from the start of buf to the beginning of the object
- *            ret_obj: a P7_DOMAIN structure to deserialize the object into.  May not be NULL. May either be an 
- *            "empty" object created with p7_domain_Create_empty, or a P7_DOMAIN object containing valid data
- *
- * Returns:   On success: returns eslOK, deserializes the P7_DOMAIN object into ret_object, and updates 
- *.           pos to point to the position after the end of the P7_DOMAIN object.
- *
- * Throws:    Returns eslEINVAL if ret_obj == NULL, buf == NULL, or N == NULL.  Returnts eslEMEM if unable to allocate
- *            required memory in ret_obj. Returns eslFAIL if a calculation fails a consistency check.         
+/* deserialize_fixed()
+ * Decodes the fixed-length fields of the serialized P7_DOMAIN at <ptr>
+ * into <obj>; returns the object's serialized size (not counting its
+ * P7_ALIDISPLAY) in <*ret_size>, the length of its scores_per_pos
+ * array in <*ret_nspp>, and a pointer to that array.
  */
-extern int p7_domain_Deserialize(const uint8_t *buf, uint32_t *n, P7_DOMAIN *ret_obj){
-
-  uint8_t *ptr;
+static const uint8_t *
+deserialize_fixed(const uint8_t *ptr, P7_DOMAIN *ret_obj, uint32_t *ret_size, int *ret_nspp){
   uint64_t network_64bit; // holds 64-bit values in network order 
   uint64_t host_64bit; //variable to hold 64-bit values after conversion to host order
-  uint32_t network_32bit; // holds 64-bit values in network order 
-  uint32_t host_32bit; //variable to hold 64-bit values after conversion to host order
-  uint32_t obj_size; // How much space does the variable-length portion of the serialized object take up?
-  int status; 
-  int i;
-
-  if(ret_obj == NULL || buf == NULL || n == NULL){
-    return eslEINVAL;
-  }   
-
-  ptr = (uint8_t *) buf + *n;
+  uint32_t network_32bit; // holds 32-bit values in network order 
+  uint32_t host_32bit; //variable to hold 32-bit values after conversion to host order
 
   //First field: Size of the serialized object.  Copy out of buffer into scalar variable to deal with memory alignment, convert to 
   // host machine order
   memcpy(&network_32bit, ptr, sizeof(uint32_t)); // Grab the bytes out of the buffer
-  obj_size = esl_ntoh32(network_32bit);
+  *ret_size = esl_ntoh32(network_32bit);
   ptr += sizeof(uint32_t);
 
   // Second field: ienv
@@ -421,9 +413,46 @@ extern int p7_domain_Deserialize(const uint8_t *buf, uint32_t *n, P7_DOMAIN *ret
 
   // Thirteenth field: length of scores_per_pos array
   memcpy(&network_32bit, ptr, sizeof(uint32_t)); 
-  int scores_per_pos_length = esl_ntoh32(network_32bit);
+  *ret_nspp = esl_ntoh32(network_32bit);
   ptr += sizeof(uint32_t);
 
+  return ptr;
+}
+
+/* Function:  p7_domain_Deserialize
+ * Synopsis:  Derializes a P7_DOMAIN object from a stream of bytes in network order into
+ *            a valid data structure
+ *
+ * Purpose:   Deserializes a serialized P7_DOMAIN object from
+ *.           buf starting at position position *pos.  
+ *
+ * Inputs:    buf: the buffer that the object should be de-serialized from
+ *            pos: a pointer to the offset from the start of buf to the beginning of the object
+ *            ret_obj: a P7_DOMAIN structure to deserialize the object into.  May not be NULL. May either be an 
+ *            "empty" object created with p7_domain_Create_empty, or a P7_DOMAIN object containing valid data
+ *
+ * Returns:   On success: returns eslOK, deserializes the P7_DOMAIN object into ret_object, and updates 
+ *.           pos to point to the position after the end of the P7_DOMAIN object.
+ *
+ * Throws:    Returns eslEINVAL if ret_obj == NULL, buf == NULL, or N == NULL.  Returnts eslEMEM if unable to allocate
+ *            required memory in ret_obj. Returns eslFAIL if a calculation fails a consistency check.         
+ */
+extern int p7_domain_Deserialize(const uint8_t *buf, uint32_t *n, P7_DOMAIN *ret_obj){
+
+  const uint8_t *ptr;
+  uint32_t network_32bit; // holds 32-bit values in network order 
+  uint32_t host_32bit; //variable to hold 32-bit values after conversion to host order
+  uint32_t obj_size; // How much space does the variable-length portion of the serialized object take up?
+  int scores_per_pos_length;
+  int status; 
+  int i;
+
+  if(ret_obj == NULL || buf == NULL || n == NULL){
+    return eslEINVAL;
+  }   
+
+  ptr = deserialize_fixed(buf + *n, ret_obj, &obj_size, &scores_per_pos_length);
+
   if(scores_per_pos_length > 0){ // there is a scores_per_pos array, so handle it
     if(ret_obj->scores_per_pos != NULL){ // clear out any prevous scores_per_pos array, since we don't know how big it is
       free(ret_obj->scores_per_pos);
@@ -455,6 +484,67 @@ extern int p7_domain_Deserialize(const uint8_t *buf, uint32_t *n, P7_DOMAIN *ret
 ERROR:
   return eslEMEM;
 }
+
+/* Function:  p7_domain_DeserializeShared
+ * Synopsis:  Deserializes a P7_DOMAIN into caller-provided storage.
+ *
+ * Purpose:   Same as <p7_domain_Deserialize()>, except that nothing is
+ *            allocated: the domain's alidisplay is deserialized into
+ *            <ad> with <p7_alidisplay_DeserializeShared()>, so its
+ *            strings stay in <buf>, and its scores_per_pos array (if
+ *            any) is decoded into the <*nspp> floats available at
+ *            <*spp>; <*spp> is advanced past the ones used, and
+ *            <*nspp> decreased.
+ *
+ *            <buf>, <ad> and the floats must outlive <ret_obj>, which
+ *            must not be freed with <p7_domain_Destroy()>.
+ *
+ * Returns:   <eslOK> on success, and updates <*n> to point just past
+ *            the domain and its alidisplay.
+ *
+ * Throws:    <eslEINVAL> if an argument is <NULL>; <eslFAIL> if a
+ *            consistency check fails, or the domain has more scores
+ *            than <*nspp>.
+ */
+extern int p7_domain_DeserializeShared(uint8_t *buf, uint32_t *n, P7_DOMAIN *ret_obj, P7_ALIDISPLAY *ad, float **spp, uint64_t *nspp){
+  const uint8_t *ptr;
+  uint32_t       network_32bit;
+  uint32_t       host_32bit;
+  uint32_t       obj_size;
+  int            scores_per_pos_length;
+  int            i;
+
+  if(ret_obj == NULL || buf == NULL || n == NULL || ad == NULL || spp == NULL || nspp == NULL){
+    return eslEINVAL;
+  }
+
+  ptr = deserialize_fixed(buf + *n, ret_obj, &obj_size, &scores_per_pos_length);
+
+  ret_obj->scores_per_pos = NULL;
+  if(scores_per_pos_length > 0){
+    if(scores_per_pos_length > *nspp){
+      ESL_EXCEPTION(eslFAIL, "p7_domain_DeserializeShared ran out of space for scores_per_pos\n");
+    }
+    ret_obj->scores_per_pos = *spp;
+    for(i = 0; i < scores_per_pos_length; i++){
+      memcpy(&network_32bit, ptr, sizeof(uint32_t));
+      host_32bit = esl_ntoh32(network_32bit);
+      ret_obj->scores_per_pos[i] = *((float *) &host_32bit);
+      ptr += sizeof(uint32_t);
+    }
+    *spp  += scores_per_pos_length;
+    *nspp -= scores_per_pos_length;
+  }
+
+  if(ptr - (buf + *n) != obj_size){
+    ESL_EXCEPTION(eslFAIL, "Deserialized object size didn't match expected length in p7_domain_DeserializeShared\n");
+  }
+  *n = ptr - buf;
+
+  ret_obj->ad = ad;
+  return p7_alidisplay_DeserializeShared(buf, n, ad);
+}
+
 /*****************************************************************
  * 2. Debugging Functions
  *****************************************************************/    
@@ -45,9 +45,12 @@
 #include "hmmer.h"
 
 static int is_multidomain_region  (P7_DOMAINDEF *ddef, int i, int j);
-static int region_trace_ensemble  (P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *dsq, int ireg, int jreg, const P7_OMX *fwd, P7_OMX *wrk, int *ret_nc);
-static int rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OMX *ox1, P7_OMX *ox2,
+static int region_trace_ensemble  (P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *dsq, int ireg, int jreg, const P7_OMX *fwd, P7_OMXCHK *chk,
+				   P7_OMX *wrk, int *ret_nc);
+static int rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OMX *ox1, P7_OMX *ox2, P7_OMXCHK *chk,
 				   int i, int j, int null2_is_done, P7_BG *bg, int long_target, P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr);
+static int envelope_oa_trace      (P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *dsq, int Ld, P7_OMX *ox1, P7_OMX *ox2, P7_OMXCHK *chk,
+				   float *ret_envsc, float *ret_oasc);
 
 
 /*****************************************************************
@@ -80,6 +83,10 @@ p7_domaindef_Create(ESL_RANDOMNESS *r)
   ddef->n2sc = NULL;
   ddef->sp   = NULL;
   ddef->tr   = NULL;
+  ddef->gtr  = NULL;
+  ddef->trs  = NULL;
+  ddef->ntrs = 0;
+  ddef->bnd  = NULL;
   ddef->dcl  = NULL;
 
   /* level 2 alloc: posterior prob arrays */
@@ -118,10 +125,12 @@ p7_domaindef_Create(ESL_RANDOMNESS *r)
   ddef->sp  = p7_spensemble_Create(1024, 64, 32); /* init allocs = # sampled pairs; max endpoint range; # of domains */
   ddef->tr  = p7_trace_CreateWithPP();
   ddef->gtr = p7_trace_Create();
+  ddef->bnd = p7_gbands_Create();
 
   /* keep a copy of ptr to the RNG */
   ddef->r            = r;  
   ddef->do_reseeding = TRUE;
+  ddef->do_oaband    = FALSE;
   return ddef;
   
  ERROR:
@@ -213,6 +222,7 @@ p7_domaindef_Reuse(P7_DOMAINDEF *ddef)
   p7_spensemble_Reuse(ddef->sp);
   p7_trace_Reuse(ddef->tr);	/* probable overkill; should already have been called */
   p7_trace_Reuse(ddef->gtr);	/* likewise */
+  p7_gbands_Reuse(ddef->bnd);
   return eslOK;
 
  ERROR:
@@ -301,6 +311,11 @@ p7_domaindef_Destroy(P7_DOMAINDEF *ddef)
   p7_spensemble_Destroy(ddef->sp);
   p7_trace_Destroy(ddef->tr);
   p7_trace_Destroy(ddef->gtr);
+  if (ddef->trs != NULL) {
+    for (d = 0; d < ddef->ntrs; d++) p7_trace_Destroy(ddef->trs[d]);
+    free(ddef->trs);
+  }
+  p7_gbands_Destroy(ddef->bnd);
   free(ddef);
   return;
 }
@@ -364,6 +379,14 @@ p7_domaindef_ByViterbi(P7_PROFILE *gm, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_
  *            using <fwd> and <bck> matrices as workspace for the
  *            necessary full-matrix DP calculations. Caller provides a
  *            new or reused <ddef> object to hold these results.
+ *
+ *            If <chk> is non-<NULL>, multidomain regions too long for
+ *            a full Forward matrix within <chk>'s RAM limit are
+ *            sampled from a checkpointed Forward matrix in <chk>
+ *            instead, in $O(M \sqrt L)$ memory; <fwd> and <bck> are
+ *            then only grown to the size of the envelopes found in
+ *            the region. With <chk> <NULL>, every region is sampled
+ *            from a full matrix in <fwd>.
  *            A <bg> is provided for (possible) use in biased-composition
  *            score correction (used in nhmmer), and a boolean
  *            <long_target> argument is provided to allow nhmmer-
@@ -382,7 +405,7 @@ p7_domaindef_ByViterbi(P7_PROFILE *gm, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_
  */
 int
 p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPROFILE *om,
-				   P7_OMX *oxf, P7_OMX *oxb, P7_OMX *fwd, P7_OMX *bck, 
+				   P7_OMX *oxf, P7_OMX *oxb, P7_OMX *fwd, P7_OMX *bck, P7_OMXCHK *chk,
 				   P7_DOMAINDEF *ddef, P7_BG *bg, int long_target,
 				   P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr)
 {
@@ -418,8 +441,6 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
     else if (ddef->mocc[j] - (ddef->etot[j] - ddef->etot[j-1])  <  ddef->rt2)
     {
         /* We have a region i..j to evaluate. */
-        p7_omx_GrowTo(fwd, om->M, j-i+1, j-i+1);
-        p7_omx_GrowTo(bck, om->M, j-i+1, j-i+1);
         ddef->nregions++;
         if (is_multidomain_region(ddef, i, j))
         {
@@ -436,9 +457,27 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
              * works
              */
             p7_oprofile_ReconfigMultihit(om, saveL);
-            p7_Forward(sq->dsq+i-1, j-i+1, om, fwd, NULL);
-
-            region_trace_ensemble(ddef, om, sq->dsq, i, j, fwd, bck, &nc);
+            if (chk != NULL && ! p7_omxchk_FitsFull(chk, om->M, j-i+1))
+            {
+                /* Too long for a full matrix: sample from a checkpointed one,
+                 * with one row of <bck> as null2 workspace. Only now is <chk>
+                 * grown; regions that fit never touch it.
+                 */
+                if ((status = p7_omxchk_GrowTo(chk, om->M, j-i+1)) != eslOK) {
+                  p7_oprofile_ReconfigUnihit(om, saveL);
+                  return status;
+                }
+                p7_omx_GrowTo(bck, om->M, 0, 0);
+                p7_ForwardCheckpointed(sq->dsq+i-1, j-i+1, om, chk, NULL);
+                region_trace_ensemble(ddef, om, sq->dsq, i, j, NULL, chk, bck, &nc);
+            }
+            else
+            {
+                p7_omx_GrowTo(fwd, om->M, j-i+1, j-i+1);
+                p7_omx_GrowTo(bck, om->M, j-i+1, j-i+1);
+                p7_Forward(sq->dsq+i-1, j-i+1, om, fwd, NULL);
+                region_trace_ensemble(ddef, om, sq->dsq, i, j, fwd, NULL, bck, &nc);
+            }
             p7_oprofile_ReconfigUnihit(om, saveL);
             /* ddef->n2sc is now set on i..j by the traceback-dependent method */
 
@@ -466,9 +505,13 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
                   */
                   ddef->nenvelopes++;
 
+                  /* a no-op, unless the region was sampled from <chk> */
+                  p7_omx_GrowTo(fwd, om->M, j2-i2+1, j2-i2+1);
+                  p7_omx_GrowTo(bck, om->M, j2-i2+1, j2-i2+1);
+
                   /*the !long_target argument will cause the function to recompute null2
                    * scores if this is part of a long_target (nhmmer) pipeline */
-                  if (rescore_isolated_domain(ddef, om, sq, ntsq, fwd, bck, i2, j2, TRUE, bg, long_target, bg_tmp, scores_arr, fwd_emissions_arr) == eslOK)
+                  if (rescore_isolated_domain(ddef, om, sq, ntsq, fwd, bck, chk, i2, j2, TRUE, bg, long_target, bg_tmp, scores_arr, fwd_emissions_arr) == eslOK)
                        last_j2 = j2;
             }
             p7_spensemble_Reuse(ddef->sp);
@@ -478,7 +521,9 @@ p7_domaindef_ByPosteriorHeuristics(const ESL_SQ *sq, const ESL_SQ *ntsq, P7_OPRO
         {
             /* The region looks simple, single domain; convert the region to an envelope. */
             ddef->nenvelopes++;
-            rescore_isolated_domain(ddef, om, sq, ntsq, fwd, bck, i, j, FALSE, bg, long_target, bg_tmp, scores_arr, fwd_emissions_arr);
+            p7_omx_GrowTo(fwd, om->M, j-i+1, j-i+1);
+            p7_omx_GrowTo(bck, om->M, j-i+1, j-i+1);
+            rescore_isolated_domain(ddef, om, sq, ntsq, fwd, bck, chk, i, j, FALSE, bg, long_target, bg_tmp, scores_arr, fwd_emissions_arr);
         }
         i     = -1;
         triggered = FALSE;
@@ -559,6 +604,13 @@ is_multidomain_region(P7_DOMAINDEF *ddef, int i, int j)
  * configuration used to score the complete sequence (if it weren't
  * multihit, we wouldn't be worried about multiple domains).
  * 
+ * Alternatively, the caller provides a checkpointed Forward matrix
+ * in <chk>, just filled for the same region by
+ * <p7_ForwardCheckpointed()>, and <fwd> is <NULL>. The whole ensemble
+ * is then sampled in a single pass, into <ddef->trs>, by
+ * <p7_StochasticTraceCheckpointed()>. Its samples are as valid as
+ * the full-matrix ones, but they aren't the same samples.
+ * 
  * Caller also provides a DP matrix in <wrk> containing at least one
  * row, for use as temporary workspace. (This will typically be the
  * caller's Backwards matrix, which we haven't yet used at this point
@@ -589,20 +641,23 @@ is_multidomain_region(P7_DOMAINDEF *ddef, int i, int j)
  *    answers, it needs to <esl_spensemble_Reuse()> it before calling
  *    <region_trace_ensemble()> again.
  *    
- * <ddef->tr> is used as working memory for sampled traces.
+ * <ddef->tr> (or with <chk>, <ddef->trs>) is used as working memory
+ *    for sampled traces.
  *    
  * <wrk> has had its zero row clobbered as working space for a null2 calculation.
  */
 static int
 region_trace_ensemble(P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *dsq, int ireg, int jreg, 
-		      const P7_OMX *fwd, P7_OMX *wrk, int *ret_nc)
+		      const P7_OMX *fwd, P7_OMXCHK *chk, P7_OMX *wrk, int *ret_nc)
 {
+  P7_TRACE *tr;
   int    Lr  = jreg-ireg+1;
   int    t, d, d2;
   int    nov, n;
   int    nc;
   int    pos;
   float  null2[p7_MAXCODE];
+  int    status;
 
   esl_vec_FSet(ddef->n2sc+ireg, Lr, 0.0); /* zero the null2 scores in region */
 
@@ -612,29 +667,45 @@ region_trace_ensemble(P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *
   if (ddef->do_reseeding) 
     esl_randomness_Init(ddef->r, esl_randomness_GetSeed(ddef->r));
 
+  /* From a checkpointed matrix, the ensemble is sampled all at once */
+  if (chk != NULL)
+    {
+      if (ddef->ntrs < ddef->nsamples)
+	{
+	  ESL_REALLOC(ddef->trs, sizeof(P7_TRACE *) * ddef->nsamples);
+	  for ( ; ddef->ntrs < ddef->nsamples; ddef->ntrs++)
+	    if ((ddef->trs[ddef->ntrs] = p7_trace_Create()) == NULL) { status = eslEMEM; goto ERROR; }
+	}
+      if ((status = p7_StochasticTraceCheckpointed(ddef->r, dsq+ireg-1, Lr, om, chk, ddef->trs, ddef->nsamples)) != eslOK) goto ERROR;
+    }
+
   /* Collect an ensemble of sampled traces; calculate null2 odds ratios from these */
   for (t = 0; t < ddef->nsamples; t++)
     {
-      p7_StochasticTrace(ddef->r, dsq+ireg-1, Lr, om, fwd, ddef->tr);
-      p7_trace_Index(ddef->tr);
+      if (chk != NULL) tr = ddef->trs[t];
+      else { 
+	tr = ddef->tr;
+	p7_StochasticTrace(ddef->r, dsq+ireg-1, Lr, om, fwd, tr);
+      }
+      p7_trace_Index(tr);
 
       pos = 1;
-      for (d = 0; d < ddef->tr->ndom; d++)
+      for (d = 0; d < tr->ndom; d++)
 	{
-	  p7_spensemble_Add(ddef->sp, t, ddef->tr->sqfrom[d]+ireg-1, ddef->tr->sqto[d]+ireg-1, ddef->tr->hmmfrom[d], ddef->tr->hmmto[d]);
+	  p7_spensemble_Add(ddef->sp, t, tr->sqfrom[d]+ireg-1, tr->sqto[d]+ireg-1, tr->hmmfrom[d], tr->hmmto[d]);
 
-	  p7_Null2_ByTrace(om, ddef->tr, ddef->tr->tfrom[d], ddef->tr->tto[d], wrk, null2);
+	  p7_Null2_ByTrace(om, tr, tr->tfrom[d], tr->tto[d], wrk, null2);
 	  
 	  /* residues outside domains get bumped +1: because f'(x) = f(x), so f'(x)/f(x) = 1 in these segments */
-	  for (; pos <= ddef->tr->sqfrom[d]; pos++) ddef->n2sc[ireg+pos-1] += 1.0;
+	  for (; pos <= tr->sqfrom[d]; pos++) ddef->n2sc[ireg+pos-1] += 1.0;
 
 	  /* Residues inside domains get bumped by their null2 ratio */
-	  for (; pos <= ddef->tr->sqto[d];   pos++) ddef->n2sc[ireg+pos-1] += null2[dsq[ireg+pos-1]];
+	  for (; pos <= tr->sqto[d];   pos++) ddef->n2sc[ireg+pos-1] += null2[dsq[ireg+pos-1]];
 	}
       /* the remaining residues in the region outside any domains get +1 */
       for (; pos <= Lr; pos++)  ddef->n2sc[ireg+pos-1] += 1.0;
 
-      p7_trace_Reuse(ddef->tr);        
+      p7_trace_Reuse(tr);        
     }
 
   /* Convert the accumulated n2sc[] ratios in this region to log odds null2 scores on each residue. */
@@ -675,6 +746,11 @@ region_trace_ensemble(P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *
   ddef->sp->nc = d;
   *ret_nc = d;
   return eslOK;
+
+ ERROR:
+  for (t = 0; t < ddef->ntrs; t++) p7_trace_Reuse(ddef->trs[t]);
+  *ret_nc = 0;
+  return status;
 }
 
 
@@ -776,6 +852,11 @@ reparameterize_model (P7_BG *bg, P7_OPROFILE *om, const ESL_SQ *sq, int start, i
  * which is (efficiently, we trust) managing any necessary temporary
  * working space and heuristic thresholds.
  *
+ * If the caller provides a checkpointed matrix <chk> (else <NULL>)
+ * and has set <ddef->do_oaband>, it's used to decode the domain in
+ * one Forward/Backward pass, and to limit the OA alignment to its
+ * posterior bands; see envelope_oa_trace().
+ *
  * If <long_target> is TRUE, the calling function  optionally
  * passes in three allocated arrays (bg_tmp, scores_arr,
  * fwd_emissions_arr) used for temporary storage in
@@ -791,7 +872,8 @@ reparameterize_model (P7_BG *bg, P7_OPROFILE *om, const ESL_SQ *sq, int start, i
  * 
  * <ddef>: <ddef->tr> has been used, and possibly reallocated, for
  *         the OA trace of the domain. Before exit, we called
- *         <Reuse()> on it.
+ *         <Reuse()> on it. <ddef->bnd> may hold the domain's
+ *         posterior bands.
  * 
  * <ox1> : happens to be holding OA score matrix for the domain
  *         upon return, but that's not part of the spec; officially
@@ -812,7 +894,7 @@ reparameterize_model (P7_BG *bg, P7_OPROFILE *om, const ESL_SQ *sq, int start, i
  */
 static int
 rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, const ESL_SQ *ntsq,
-			P7_OMX *ox1, P7_OMX *ox2, int i, int j, int null2_is_done, P7_BG *bg, int long_target,
+			P7_OMX *ox1, P7_OMX *ox2, P7_OMXCHK *chk, int i, int j, int null2_is_done, P7_BG *bg, int long_target,
 			P7_BG *bg_tmp, float *scores_arr, float *fwd_emissions_arr)
 {
   P7_DOMAIN     *dom           = NULL;
@@ -840,10 +922,8 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
     reparameterize_model (bg, om, sq, i, j-i+1, fwd_emissions_arr, bg_tmp->f, scores_arr);
   }
 
-  p7_Forward (sq->dsq + i-1, Ld, om,      ox1, &envsc);
-  p7_Backward(sq->dsq + i-1, Ld, om, ox1, ox2, NULL);
-
-  status = p7_Decoding(om, ox1, ox2, ox2);      /* <ox2> is now overwritten with post probabilities     */
+  /* Score and decode the envelope; find an optimal accuracy alignment */
+  status = envelope_oa_trace(ddef, om, sq->dsq + i-1, Ld, ox1, ox2, chk, &envsc, &oasc);
   if (status == eslERANGE) { /* rare: numeric overflow; domain is assumed to be repetitive garbage [J3/119-121] */
     if (long_target && scores_arr) 
       reparameterize_model(bg, om, NULL, 0, 0, fwd_emissions_arr, bg_tmp->f, scores_arr); /* revert to original bg model */
@@ -851,10 +931,6 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
     goto ERROR;
   }
 
-  /* Find an optimal accuracy alignment */
-  p7_OptimalAccuracy(om, ox2, ox1, &oasc);      /* <ox1> is now overwritten with OA scores              */
-  p7_OATrace        (om, ox2, ox1, ddef->tr);   /* <tr>'s seq coords are offset by i-1, rel to orig dsq */
-
   /* hack the trace's sq coords to be correct w.r.t. original dsq */
   for (z = 0; z < ddef->tr->N; z++)
     if (ddef->tr->i[z] > 0) ddef->tr->i[z] += i-1;
@@ -895,21 +971,14 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
         reparameterize_model (bg, om, sq, i, Ld, fwd_emissions_arr, bg_tmp->f, scores_arr);
       }
 
-      p7_Forward (sq->dsq + i-1, Ld, om,      ox1, &envsc);
-      p7_Backward(sq->dsq + i-1, Ld, om, ox1, ox2, NULL);
-
-      status = p7_Decoding(om, ox1, ox2, ox2);      /* <ox2> is now overwritten with post probabilities     */
+      p7_trace_Reuse(ddef->tr);
+      status = envelope_oa_trace(ddef, om, sq->dsq + i-1, Ld, ox1, ox2, chk, &envsc, &oasc);
       if (status == eslERANGE) { /* rare: numeric overflow; domain is assumed to be repetitive garbage [J3/119-121] */
           reparameterize_model(bg, om, NULL, 0, 0, fwd_emissions_arr, bg_tmp->f, scores_arr); /* revert to original bg model */
           status = eslFAIL;
           goto ERROR;
       }
 
-      /* Find an optimal accuracy alignment */
-      p7_OptimalAccuracy(om, ox2, ox1, &oasc);      /* <ox1> is now overwritten with OA scores              */
-      p7_trace_Reuse(ddef->tr);
-      p7_OATrace        (om, ox2, ox1, ddef->tr);   /* <tr>'s seq coords are offset by i-1, rel to orig dsq */
-
       /* re-hack the trace's sq coords to be correct w.r.t. original dsq */
        for (z = 0; z < ddef->tr->N; z++)
          if (ddef->tr->i[z] > 0) ddef->tr->i[z] += i-1;
@@ -980,6 +1049,63 @@ rescore_isolated_domain(P7_DOMAINDEF *ddef, P7_OPROFILE *om, const ESL_SQ *sq, c
   p7_trace_Reuse(ddef->tr);
   return status;
 }
+
+
+/* envelope_oa_trace()
+ *
+ * For rescore_isolated_domain(): the Forward score of envelope <dsq>
+ * (i.e. sq->dsq+i-1) of length <Ld> in <*ret_envsc>; its posterior
+ * decoding in <ox2>; and an optimal accuracy alignment, its OA score
+ * in <*ret_oasc> and its trace (offset by i-1, rel to orig dsq) in
+ * the fresh <ddef->tr>.
+ *
+ * By default, that takes full Forward, Backward and decoding
+ * passes, with <ox1> and <ox2> as the matrices, then a full OA fill
+ * in <ox1>. If <ddef->do_oaband> is set and a <chk> is provided, a
+ * checkpointed Forward pass and a Backward pass that decodes as it
+ * goes replace the first three; the Backward pass also leaves the
+ * posterior bands in <ddef->bnd>, and the OA fill is only done within
+ * them. The scores and the decoding are the same either way, but the
+ * OA alignment is not guaranteed to be: it can differ wherever the
+ * optimal path leaves the bands, and rows the bands skip (mostly
+ * N/J/C) get no band at all. That's why banding is opt-in (hmmsearch
+ * and hmmscan --oaband). It saves little: only the OA fill is
+ * banded, the checkpointed Backward pass recomputes Forward rows, and
+ * in benchmarks the whole routine is only 1.0-1.3x faster for
+ * M=100..3000. It saves no memory either: <ox1> and <ox2> are still
+ * envelope-sized, and <chk> (within its RAM limit) comes on top.
+ *
+ * Returns <eslOK> on success; <eslERANGE> if the posterior decoding
+ * overflows.
+ */
+static int
+envelope_oa_trace(P7_DOMAINDEF *ddef, const P7_OPROFILE *om, const ESL_DSQ *dsq, int Ld, P7_OMX *ox1, P7_OMX *ox2, P7_OMXCHK *chk,
+		  float *ret_envsc, float *ret_oasc)
+{
+  int status;
+
+  if (ddef->do_oaband && chk != NULL)
+    {
+      if ((status = p7_omxchk_GrowTo(chk, om->M, Ld)) != eslOK) return status;
+      p7_gbands_Reuse(ddef->bnd);
+      p7_ForwardCheckpointed(dsq, Ld, om, chk, ret_envsc);
+      status = p7_BackwardCheckpointed(dsq, Ld, om, chk, ox2, ddef->bnd, NULL); /* <ox2> is now overwritten with post probabilities */
+      if (status != eslOK) return status;
+
+      if (ddef->bnd->nrow > 0) p7_OptimalAccuracyBanded(om, ox2, ddef->bnd, ox1, ret_oasc);
+      else                     p7_OptimalAccuracy      (om, ox2,            ox1, ret_oasc);
+    }
+  else
+    {
+      p7_Forward (dsq, Ld, om,      ox1, ret_envsc);
+      p7_Backward(dsq, Ld, om, ox1, ox2, NULL);
+      status = p7_Decoding(om, ox1, ox2, ox2);          /* <ox2> is now overwritten with post probabilities     */
+      if (status != eslOK) return status;
+
+      p7_OptimalAccuracy(om, ox2, ox1, ret_oasc);       /* <ox1> is now overwritten with OA scores              */
+    }
+  return p7_OATrace(om, ox2, ox1, ddef->tr);
+}
   
     
 /*****************************************************************
@@ -1085,7 +1211,7 @@ main(int argc, char **argv)
 
   p7_Forward (sq->dsq, sq->n, om,      fwd, &overall_sc); 
   p7_Backward(sq->dsq, sq->n, om, fwd, bck, &sc);       
-  p7_domaindef_ByPosteriorHeuristics(sq, NULL, om, oxf, oxb, fwd, bck, ddef, NULL, FALSE, NULL, NULL, NULL);
+  p7_domaindef_ByPosteriorHeuristics(sq, NULL, om, oxf, oxb, fwd, bck, NULL, ddef, NULL, FALSE, NULL, NULL, NULL);
 
 
   printf("Overall raw likelihood score: %.2f nats\n", overall_sc);
@@ -28,6 +28,7 @@
 
 #define OPT_TIME_STEP 0.5
 #define TMAX          5.0
+#define NTMSV         8     /* grid times scored in one MSV sweep by the cached optimizer */
 
 /* Struct used to pass a collection of useful temporary objects around
  * within the LongTarget functions
@@ -46,16 +47,17 @@ static inline void   optimize_unpack_paramvector      (double *p, struct optimiz
 static inline double optimize_msvfilter_func          (double *p, int np, void *dptr);
 static inline double optimize_viterbifilter_func      (double *p, int np, void *dptr);
 static inline double optimize_forwardparser_func      (double *p, int np, void *dptr);
-static inline double func_msvfilter    (ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf,
+static inline double func_msvfilter    (ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, const P7_EVOCACHE *ec, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf,
 					float time, int hmm_evolve, int calibrate);
-static inline double func_viterbifilter(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf,
+static inline void   func_msvfilter_multitime(ESL_DSQ *dsq, int n, const P7_EVOCACHE *ec, float *time, int nt, P7_OMX *oxf, float *usc);
+static inline double func_viterbifilter(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, const P7_EVOCACHE *ec, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf,
 					float time, int hmm_evolve, int calibrate);
-static inline double func_forwardparser(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf,
+static inline double func_forwardparser(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, const P7_EVOCACHE *ec, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf,
 					float time, int hmm_evolve, int calibrate);
-static inline void workaround_evolve_profile(ESL_RANDOMNESS *r, double time, int n, const P7_RATE *R, P7_BG *bg, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om,
-					     int calibrate);
+static inline void workaround_evolve_profile(ESL_RANDOMNESS *r, double time, int n, const P7_RATE *R, const P7_EVOCACHE *ec, P7_BG *bg, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om,
+					     float *om_time, int calibrate);
 static inline void workaround_calibrate_profile(ESL_RANDOMNESS *r, int len, P7_BG *bg, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om);
-static inline void workaround_restore_profile(float *evparam_star, int len, const P7_RATE *R, P7_BG *bg, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om);
+static inline void workaround_restore_profile(float *evparam_star, int len, const P7_RATE *R, const P7_EVOCACHE *ec, P7_BG *bg, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om);
 
 
 
@@ -89,6 +91,11 @@ static inline void workaround_restore_profile(float *evparam_star, int len, cons
  *
  * Xref:      J4/25.
  *
+ *            <*ret_hmm_restore> is the caller's per-thread state: on
+ *            return it is TRUE if <om> was left evolved away from t*,
+ *            so the next target starts by restoring it. Staying at
+ *            t* costs no profile rebuild at all.
+ *
  * Note:      Error handling needs improvement. The <eslETYPE> exception
  *            was added as a late bugfix. It really should be an <eslEINVAL>
  *            normal error (because it's a user error). But then we need
@@ -97,7 +104,7 @@ static inline void workaround_restore_profile(float *evparam_star, int len, cons
  *            been careful enough about. [SRE H9/4]
  */
 extern int p7_EvoPipeline_Overthruster(P7_PIPELINE *pli, ESL_RANDOMNESS *r, float *evparam_star, EVOPIPE_OPT evopipe_opt,
-				       P7_RATE *R, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, 
+				       P7_RATE *R, const P7_EVOCACHE *ec, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, 
 				       int *ret_hmm_restore, float *ret_fwdsc, float *ret_nullsc)
 {
   float            time_star = 1.0;
@@ -110,6 +117,7 @@ extern int p7_EvoPipeline_Overthruster(P7_PIPELINE *pli, ESL_RANDOMNESS *r, floa
   float            spvtime;                  /* sparse viterbi time */
   float            spftime;                  /* sparse forward time */
   float            tol = 0.1;
+  float            om_time = time_star;      /* time the profile <om> is evolved to     */
   int              hmm_restore = *ret_hmm_restore; // do we need to restore the HMM to tstar? 
   int              be_verbose  = FALSE;
   int              hmm_evolve;
@@ -140,19 +148,19 @@ extern int p7_EvoPipeline_Overthruster(P7_PIPELINE *pli, ESL_RANDOMNESS *r, floa
   if (pli->do_biasfilter) p7_bg_FilterScore(bg, sq->dsq, sq->n, &filtersc);
  
   if (hmm_restore) 
-    workaround_restore_profile(evparam_star, sq->n, R, bg, hmm, gm, om);
+    workaround_restore_profile(evparam_star, sq->n, R, ec, bg, hmm, gm, om);
     
   /* First level filter: the MSV filter, multihit with <om> */
   time = time_star;
   hmm_evolve = FALSE;
-  if ((status = p7_OptimizeMSVFilter(r, cfg, stats, evopipe_opt, sq->dsq, sq->n, &time, R, hmm, gm, om, bg, pli->oxf, &usc, nullsc, filtersc, pli->F1, hmm_evolve, tol)) != eslOK)      
+  if ((status = p7_OptimizeMSVFilter(r, cfg, stats, evopipe_opt, sq->dsq, sq->n, &time, R, ec, hmm, gm, om, &om_time, bg, pli->oxf, &usc, nullsc, filtersc, pli->F1, hmm_evolve, tol)) != eslOK)      
     printf("\nsequence %s msvfilter did not optimize\n", sq->name);  
 
   seq_score = (usc - nullsc) / eslCONST_LOG2;
   P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
   //printf("^^MSV %s evolve? %d time %f usc %f nullsc %f seq_score %f\n", sq->name, hmm_evolve, time, usc, nullsc, seq_score);
   if (P > pli->F1) {
-    *ret_hmm_restore = (evopipe_opt.MSV_topt != TIMEOPT_NONE && time != time_star)? TRUE : FALSE;
+    *ret_hmm_restore = (om_time != time_star)? TRUE : FALSE;
     goto ERROR;
   }
   pli->n_past_msv++;
@@ -164,7 +172,7 @@ extern int p7_EvoPipeline_Overthruster(P7_PIPELINE *pli, ESL_RANDOMNESS *r, floa
       P = esl_gumbel_surv(seq_score,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
       //printf("^^BIAS %s P %f F1 %f usc %f filtersc %f score %f\n", sq->name, P, pli->F1, usc, filtersc, seq_score);
       if (P > pli->F1) {
-	*ret_hmm_restore = (evopipe_opt.MSV_topt != TIMEOPT_NONE && time != time_star)? TRUE : FALSE;
+	*ret_hmm_restore = (om_time != time_star)? TRUE : FALSE;
 	goto ERROR;
       }
     }
@@ -186,7 +194,7 @@ extern int p7_EvoPipeline_Overthruster(P7_PIPELINE *pli, ESL_RANDOMNESS *r, floa
   if (P > pli->F2)
     {
       hmm_evolve = (evopipe_opt.MSV_topt != TIMEOPT_NONE)? TRUE:FALSE;
-      if ((status = p7_OptimizeViterbiFilter(r, cfg, stats, evopipe_opt, sq->dsq, sq->n, &time, R, hmm, gm, om, bg, pli->oxf, &vfsc, filtersc, pli->F2, hmm_evolve, tol)) != eslOK) 
+      if ((status = p7_OptimizeViterbiFilter(r, cfg, stats, evopipe_opt, sq->dsq, sq->n, &time, R, ec, hmm, gm, om, &om_time, bg, pli->oxf, &vfsc, filtersc, pli->F2, hmm_evolve, tol)) != eslOK) 
 	printf("\nsequence %s vitfilter did not optimize\n", sq->name);
       if (evopipe_opt.VIT_topt != TIMEOPT_NONE) {
 	vfsc_optimized = TRUE;
@@ -197,7 +205,7 @@ extern int p7_EvoPipeline_Overthruster(P7_PIPELINE *pli, ESL_RANDOMNESS *r, floa
       seq_score = (vfsc-filtersc) / eslCONST_LOG2;
       P  = esl_gumbel_surv(seq_score,  om->evparam[p7_VMU],  om->evparam[p7_VLAMBDA]);
       if (P > pli->F2) {
-	*ret_hmm_restore = (evopipe_opt.VIT_topt != TIMEOPT_NONE && time != time_star)? TRUE : FALSE;
+	*ret_hmm_restore = (om_time != time_star)? TRUE : FALSE;
 	goto ERROR;
       }
     }
@@ -207,12 +215,12 @@ extern int p7_EvoPipeline_Overthruster(P7_PIPELINE *pli, ESL_RANDOMNESS *r, floa
   /* Parse it with Forward and obtain its real Forward score. */
   if (vfsc_optimized) {
     hmm_evolve = FALSE;
-    fwdsc = func_forwardparser(NULL, sq->dsq, sq->n, hmm, R, gm, om, bg, pli->oxf, time, hmm_evolve, FALSE);
+    fwdsc = func_forwardparser(NULL, sq->dsq, sq->n, hmm, R, ec, gm, om, &om_time, bg, pli->oxf, time, hmm_evolve, FALSE);
     //printf("^^FWD %s len %d time %f fwdsc %f\n", sq->name, sq->n, time, fwdsc);
   }
   else {
     hmm_evolve = (evopipe_opt.FWD_topt != TIMEOPT_NONE)? TRUE:FALSE;
-    if ((status = p7_OptimizeForwardParser(r, cfg, stats, evopipe_opt, sq->dsq, sq->n, &time, R, hmm, gm, om, bg, pli->oxf, &fwdsc, filtersc, pli->F3, hmm_evolve, tol)) != eslOK)      
+    if ((status = p7_OptimizeForwardParser(r, cfg, stats, evopipe_opt, sq->dsq, sq->n, &time, R, ec, hmm, gm, om, &om_time, bg, pli->oxf, &fwdsc, filtersc, pli->F3, hmm_evolve, tol)) != eslOK)      
       printf("\nsequence %s forwardparser did not optimize\n", sq->name);
     //printf("^^FWD OPT %s updated? %d time %f fwdsc %f filter %f score %f\n", sq->name, hmm_restore, time, fwdsc, filtersc, (fwdsc-filtersc) / eslCONST_LOG2);
   }
@@ -222,12 +230,12 @@ extern int p7_EvoPipeline_Overthruster(P7_PIPELINE *pli, ESL_RANDOMNESS *r, floa
   //printf("^^FWD %s P %f time %f fwdsc %f filter %f score %f tau %f lambda %f\n", sq->name, P, time, fwdsc, filtersc, (fwdsc-filtersc) / eslCONST_LOG2, om->evparam[p7_FTAU],  om->evparam[p7_FLAMBDA]);
 
   if (P > pli->F3)  {
-    *ret_hmm_restore = (time != time_star)? TRUE:FALSE;
+    *ret_hmm_restore = (om_time != time_star)? TRUE : FALSE;
     goto ERROR;
   }
   pli->n_past_fwd++;
 
-  *ret_hmm_restore = TRUE;
+  *ret_hmm_restore = (om_time != time_star)? TRUE : FALSE;
   *ret_fwdsc       = fwdsc;
   *ret_nullsc      = nullsc;
   
@@ -253,15 +261,23 @@ extern int p7_EvoPipeline_Overthruster(P7_PIPELINE *pli, ESL_RANDOMNESS *r, floa
  *            filters score highly enough that the main stage should be run, it
  *            calls p7_pipeline_Mainstage for final hit/miss determination and hitlist
  *            insertion.
+ *
+ *            If <ec> is non-NULL, the evolved profiles are taken from
+ *            that per-query cache instead of being rebuilt for every
+ *            target; <om> must then be a clone (see p7_EvoCacheSelect()),
+ *            and <hmm>, <gm> are left untouched. With
+ *            <evopipe_opt.recalibrate>, the E-value parameters are then
+ *            those interpolated by p7_EvoCacheCalibrate() at query
+ *            setup, and p7_Calibrate() is not called per target.
  */
-extern int p7_EvoPipeline(P7_PIPELINE *pli, ESL_RANDOMNESS *r, float *evparam_star, EVOPIPE_OPT evopipe_opt, P7_RATE *R, P7_HMM *hmm, P7_PROFILE *gm,
+extern int p7_EvoPipeline(P7_PIPELINE *pli, ESL_RANDOMNESS *r, float *evparam_star, EVOPIPE_OPT evopipe_opt, P7_RATE *R, const P7_EVOCACHE *ec, P7_HMM *hmm, P7_PROFILE *gm,
 			  P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist, int *ret_hmm_restore)
 {
   int status;
   float fwdsc;
   float nullsc;
 
-  status = p7_EvoPipeline_Overthruster(pli, r, evparam_star, evopipe_opt, R, hmm, gm, om, bg, sq, ntsq, ret_hmm_restore, &fwdsc, &nullsc);
+  status = p7_EvoPipeline_Overthruster(pli, r, evparam_star, evopipe_opt, R, ec, hmm, gm, om, bg, sq, ntsq, ret_hmm_restore, &fwdsc, &nullsc);
   if (status == eslOK){ //run the main stage
     return (p7_Pipeline_Mainstage(pli, om, bg, sq, ntsq, hitlist, fwdsc, nullsc));
   }
@@ -279,8 +295,8 @@ extern int p7_EvoPipeline(P7_PIPELINE *pli, ESL_RANDOMNESS *r, float *evparam_st
 
 extern int
 p7_OptimizeMSVFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EVOPIPE_OPT evopipe_opt,
-		     const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R,
-		     P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf, float *ret_usc,
+		     const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R, const P7_EVOCACHE *ec,
+		     P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf, float *ret_usc,
 		     float nullsc, float filtersc, float F1, int hmm_evolve, float tol)
 {
   struct optimize_data   data;
@@ -296,13 +312,16 @@ p7_OptimizeMSVFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EV
   float                  F1_grad = 1.5*F1;
   float                  time_init;
   float                  time;
+  float                  tv[NTMSV];            /* candidate times, for one multi-time sweep */
+  float                  uv[NTMSV];            /* their MSV scores                          */
+  int                    c;
   enum timeopt_e         MSV_topt = evopipe_opt.MSV_topt;
   int                    isfixtime = (evopipe_opt.fixtime >= 0.0)? TRUE : FALSE;
   int                    np = 1;
   int                    status;
 
   time_init = (isfixtime)? evopipe_opt.fixtime : *ret_time;
-  usc_init  = func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time_init, hmm_evolve, evopipe_opt.recalibrate);
+  usc_init  = func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time_init, hmm_evolve, evopipe_opt.recalibrate);
   if (usc_init == eslINFINITY) MSV_topt = TIMEOPT_NONE;
 
   // this is a filter; if the score is already good enough, we don't need to optimize
@@ -323,20 +342,32 @@ p7_OptimizeMSVFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EV
       *ret_time = time_init;
       break;
     }
+
+    // with a cache, score both bracketing times in one sweep of the target
+    if (ec) {
+      tv[0] = time_init - cfg->deriv_step;
+      tv[1] = time_init + cfg->deriv_step;
+      func_msvfilter_multitime((ESL_DSQ *)dsq, n, ec, tv, 2, oxf, uv);
+      c = (uv[0] > usc_init)? 0 : ((uv[1] > usc_init)? 1 : -1);
+      *ret_usc  = (c >= 0)? uv[c] : usc_init;
+      *ret_time = (c >= 0)? tv[c] : time_init;
+      workaround_evolve_profile(r, (double)*ret_time, n, R, ec, bg, hmm, gm, om, om_time, evopipe_opt.recalibrate);
+      break;
+    }
     
     // check if the Rate need to be calculated
     p7_RateCalculate(hmm, bg, R, NULL, FALSE);
 
     // first time < tstar
     time = time_init - cfg->deriv_step;
-    usc = func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
+    usc = func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
     if (usc > usc_init) {
       *ret_usc  = usc;
       *ret_time = time;
     }
     else {
       time = time_init + cfg->deriv_step;
-      usc = func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
+      usc = func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
       if (usc > usc_init) {
 	*ret_usc  = usc;
 	*ret_time = time;
@@ -344,7 +375,7 @@ p7_OptimizeMSVFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EV
       else {
 	*ret_usc  = usc_init;
 	*ret_time = time_init;
-	func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
+	func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
       }
     }
     break;
@@ -356,6 +387,19 @@ p7_OptimizeMSVFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EV
       *ret_time = time_init;
       break;
     }
+
+    // with a cache, the score only changes at grid times; instead of
+    // a line search, score NTMSV grid times in one sweep and take the best
+    if (ec) {
+      for (c = 0; c < NTMSV; c++)
+	tv[c] = exp(log(ec->dtval[0]) + (log(ec->dtval[ec->ndt-1]) - log(ec->dtval[0])) * (double) c / (double) (NTMSV-1));
+      func_msvfilter_multitime((ESL_DSQ *)dsq, n, ec, tv, NTMSV, oxf, uv);
+      c = esl_vec_FArgMax(uv, NTMSV);
+      *ret_usc  = (uv[c] > usc_init)? uv[c] : usc_init;
+      *ret_time = (uv[c] > usc_init)? tv[c] : time_init;
+      workaround_evolve_profile(r, (double)*ret_time, n, R, ec, bg, hmm, gm, om, om_time, evopipe_opt.recalibrate);
+      break;
+    }
     
     // check if the Rate need to be calculated
     p7_RateCalculate(hmm, bg, R, NULL, FALSE);
@@ -370,9 +414,11 @@ p7_OptimizeMSVFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EV
     data.dsq        = (ESL_DSQ *)dsq;
     data.n          = n;
     data.R          = (P7_RATE *)R;
+    data.ec         = ec;
     data.hmm        = (P7_HMM *)hmm;
     data.gm         = (P7_PROFILE *)gm;
     data.om         = (P7_OPROFILE *)om;
+    data.om_time    = om_time;
     
     data.bg         = bg;
     data.oxf        = oxf;
@@ -396,13 +442,13 @@ p7_OptimizeMSVFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EV
     
     /* unpack the final parameter vector */
     optimize_unpack_paramvector(p, &data);
-    data.usc = func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, data.time, TRUE, evopipe_opt.recalibrate);
+    data.usc = func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, data.time, TRUE, evopipe_opt.recalibrate);
     //printf("END MSV OPTIMIZATION: time %f usc %f --> %f\n", data.time, usc_init, data.usc);
     
     if (usc_init > data.usc || data.usc == eslINFINITY) {
       *ret_usc  = usc_init;
       *ret_time = time_init;
-      func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
+      func_msvfilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
     }
     else {
       *ret_usc  = data.usc;
@@ -431,8 +477,8 @@ p7_OptimizeMSVFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EV
 
 extern int
 p7_OptimizeViterbiFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EVOPIPE_OPT evopipe_opt,
-			 const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R,
-			 P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf, float *ret_vfsc,
+			 const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R, const P7_EVOCACHE *ec,
+			 P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf, float *ret_vfsc,
 			 float filtersc, float F2, int hmm_evolve, float tol)
 {
   struct optimize_data   data;
@@ -453,7 +499,7 @@ p7_OptimizeViterbiFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
   int                    status;
 
   time_init = (isfixtime)? evopipe_opt.fixtime : *ret_time;
-  vfsc_init = func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time_init, hmm_evolve, FALSE);
+  vfsc_init = func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time_init, hmm_evolve, FALSE);
   if (vfsc_init == eslINFINITY) VIT_topt = TIMEOPT_NONE;
 
   // this is a filter; if the score is already good enough, we don't need to optimize
@@ -478,7 +524,7 @@ p7_OptimizeViterbiFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
     p7_RateCalculate(hmm, bg, R, NULL, FALSE);
 
     time = time_init - cfg->deriv_step;
-    vfsc = func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
+    vfsc = func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
 
     if (vfsc > vfsc_init) {
       *ret_vfsc = vfsc;
@@ -486,7 +532,7 @@ p7_OptimizeViterbiFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
     }
     else {
       time = time_init + cfg->deriv_step;
-      vfsc = func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
+      vfsc = func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
       if (vfsc > vfsc_init) {
 	*ret_vfsc = vfsc;
 	*ret_time = time;
@@ -494,7 +540,7 @@ p7_OptimizeViterbiFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
       else {
 	*ret_vfsc = vfsc_init;
 	*ret_time = time_init;
-	func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
+	func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
       }
     }
     break;
@@ -520,9 +566,11 @@ p7_OptimizeViterbiFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
     data.dsq        = (ESL_DSQ *)dsq;
     data.n          = n;
     data.R          = (P7_RATE *)R;
+    data.ec         = ec;
     data.hmm        = (P7_HMM *)hmm;
     data.gm         = (P7_PROFILE *)gm;
     data.om         = (P7_OPROFILE *)om;
+    data.om_time    = om_time;
     data.bg         = bg;
     data.oxf        = oxf;
     data.tol        = tol;
@@ -545,13 +593,13 @@ p7_OptimizeViterbiFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
     
     /* unpack the final parameter vector */
     optimize_unpack_paramvector(p, &data);
-    data.vfsc = func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, data.time, TRUE, evopipe_opt.recalibrate);
+    data.vfsc = func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, data.time, TRUE, evopipe_opt.recalibrate);
     //printf("END VIT OPTIMIZATION: time %f vfsc %f --> %f\n", data.time, vfsc_init, data.vfsc);
     
     if (vfsc_init > data.vfsc || data.vfsc == eslINFINITY) {
       *ret_vfsc = vfsc_init;
       *ret_time = time_init;
-      func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
+      func_viterbifilter(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
     }
     else {
       *ret_vfsc = data.vfsc;
@@ -581,8 +629,8 @@ p7_OptimizeViterbiFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
 
 int
 p7_OptimizeForwardParser(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EVOPIPE_OPT evopipe_opt,
-			 const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R,
-			 P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf, float *ret_fwdsc,
+			 const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R, const P7_EVOCACHE *ec,
+			 P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf, float *ret_fwdsc,
 			 float filtersc, float F3, int hmm_evolve, float tol)
 {
   struct optimize_data   data;
@@ -603,7 +651,7 @@ p7_OptimizeForwardParser(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
   int                    status;
 
   time_init = (isfixtime)? evopipe_opt.fixtime : *ret_time;
-  fwdsc_init = func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time_init, hmm_evolve, FALSE);
+  fwdsc_init = func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time_init, hmm_evolve, FALSE);
   if (fwdsc_init == eslINFINITY) FWD_topt = TIMEOPT_NONE;
 
   // this is NOT a filter; if the score is already good enough, we don't need to optimize
@@ -627,14 +675,14 @@ p7_OptimizeForwardParser(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
     p7_RateCalculate(hmm, bg, R, NULL, FALSE);
 	
     time = time_init - cfg->deriv_step;
-    fwdsc = func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
+    fwdsc = func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
     if (fwdsc > fwdsc_init) {
       *ret_fwdsc = fwdsc;
       *ret_time  = time;
     }
     else {
       time = time_init + cfg->deriv_step;
-      fwdsc = func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
+      fwdsc = func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time, TRUE, evopipe_opt.recalibrate);
       if (fwdsc > fwdsc_init) {
 	*ret_fwdsc = fwdsc;
 	*ret_time  = time;
@@ -642,7 +690,7 @@ p7_OptimizeForwardParser(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
       else {
 	*ret_fwdsc = fwdsc_init;
 	*ret_time  = time_init;
-	func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
+	func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
      }
     }
     break;
@@ -667,9 +715,11 @@ p7_OptimizeForwardParser(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
     data.dsq        = (ESL_DSQ *)dsq;
     data.n          = n;
     data.R          = (P7_RATE *)R;
+    data.ec         = ec;
     data.hmm        = (P7_HMM *)hmm;
     data.gm         = (P7_PROFILE *)gm;
     data.om         = (P7_OPROFILE *)om;
+    data.om_time    = om_time;
     data.bg         = bg;
     data.oxf        = oxf;
     data.tol        = tol;
@@ -693,13 +743,13 @@ p7_OptimizeForwardParser(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats
     
     /* unpack the final parameter vector */
     optimize_unpack_paramvector(p, &data);
-    data.fwdsc = func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, data.time, TRUE, evopipe_opt.recalibrate);
+    data.fwdsc = func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, data.time, TRUE, evopipe_opt.recalibrate);
     //printf("END FWD OPTIMIZATION: time %f fwdsc %f --> %f\n", data.time, fwdsc_init, data.fwdsc);
     
     if (fwdsc_init > data.fwdsc || data.fwdsc == eslINFINITY) {
       *ret_fwdsc = fwdsc_init;
       *ret_time  = time_init;
-      func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, gm, om, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
+      func_forwardparser(r, (ESL_DSQ *)dsq, n, hmm, R, ec, gm, om, om_time, bg, oxf, time_init, TRUE, evopipe_opt.recalibrate);
     }
     else {
       *ret_fwdsc = data.fwdsc;
@@ -744,7 +794,7 @@ optimize_msvfilter_func(double *p, int np, void *dptr)
   
   optimize_unpack_paramvector(p, data);
   
-  data->usc = func_msvfilter(NULL, dsq, data->n, data->hmm, data->R, data->gm, data->om, data->bg, data->oxf, data->time, TRUE, FALSE);
+  data->usc = func_msvfilter(NULL, dsq, data->n, data->hmm, data->R, data->ec, data->gm, data->om, data->om_time, data->bg, data->oxf, data->time, TRUE, FALSE);
   
   if (data->usc == eslINFINITY) data->usc = 1000.;
   return -(double)data->usc;
@@ -758,7 +808,7 @@ optimize_viterbifilter_func(double *p, int np, void *dptr)
   
   optimize_unpack_paramvector(p, data);
   
-  data->vfsc = func_viterbifilter(NULL, dsq, data->n, data->hmm, data->R, data->gm, data->om, data->bg, data->oxf, data->time, TRUE, FALSE);
+  data->vfsc = func_viterbifilter(NULL, dsq, data->n, data->hmm, data->R, data->ec, data->gm, data->om, data->om_time, data->bg, data->oxf, data->time, TRUE, FALSE);
   
   if (data->vfsc == eslINFINITY) data->vfsc = 1000.;
   return -(double)data->vfsc;
@@ -772,7 +822,7 @@ optimize_forwardparser_func(double *p, int np, void *dptr)
   
   optimize_unpack_paramvector(p, data);
 
-  data->fwdsc = func_forwardparser(NULL, dsq, data->n, data->hmm, data->R, data->gm, data->om, data->bg, data->oxf, data->time, TRUE, FALSE);
+  data->fwdsc = func_forwardparser(NULL, dsq, data->n, data->hmm, data->R, data->ec, data->gm, data->om, data->om_time, data->bg, data->oxf, data->time, TRUE, FALSE);
   
   return -(double)data->fwdsc;
 }
@@ -780,13 +830,13 @@ optimize_forwardparser_func(double *p, int np, void *dptr)
 
 
 static inline double
-func_msvfilter(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf,
+func_msvfilter(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, const P7_EVOCACHE *ec, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf,
 	       float time, int hmm_evolve, int calibrate)
 {
   float  usc;
   
   /* Construct the evolved profile */
-  if (hmm_evolve) workaround_evolve_profile(r, (double)time, n, R, bg, hmm, gm, om, calibrate);
+  if (hmm_evolve) workaround_evolve_profile(r, (double)time, n, R, ec, bg, hmm, gm, om, om_time, calibrate);
   
   p7_MSVFilter(dsq, n, om, oxf, &(usc));
   
@@ -797,14 +847,34 @@ func_msvfilter(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R,
   return (double)usc;
  }
 
+/* func_msvfilter_multitime()
+ * MSV scores of the target at <nt> <= NTMSV times, from one sweep of
+ * p7_MSVFilter_multitime() over length-<n> views of the cached
+ * profiles. <om> is left as it is.
+ */
+static inline void
+func_msvfilter_multitime(ESL_DSQ *dsq, int n, const P7_EVOCACHE *ec, float *time, int nt, P7_OMX *oxf, float *usc)
+{
+  P7_OPROFILE  omv[NTMSV];
+  P7_OPROFILE *oma[NTMSV];
+  int          t;
+
+  for (t = 0; t < nt; t++) {
+    omv[t].clone = 1;
+    p7_EvoCacheSelect(ec, time[t], n, &omv[t]);
+    oma[t] = &omv[t];
+  }
+  p7_MSVFilter_multitime(dsq, n, oma, nt, oxf, usc);
+}
+
 static inline double
-func_viterbifilter(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf,
+func_viterbifilter(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, const P7_EVOCACHE *ec, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf,
 		   float time, int hmm_evolve, int calibrate)
 {
   float  vfsc;
   
   /* Construct the evolved profile */
-  if (hmm_evolve) workaround_evolve_profile(r, (double)time, n, R, bg, hmm, gm, om, calibrate);
+  if (hmm_evolve) workaround_evolve_profile(r, (double)time, n, R, ec, bg, hmm, gm, om, om_time, calibrate);
 
   p7_ViterbiFilter(dsq, n, om, oxf, &(vfsc));
   
@@ -816,13 +886,13 @@ func_viterbifilter(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE
  }
 
 static inline double
-func_forwardparser(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf,
+func_forwardparser(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE *R, const P7_EVOCACHE *ec, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf,
 		   float time, int hmm_evolve, int calibrate)
 {
   float   fwdsc;
 
   /* Construct the evolved profile */
-  if (hmm_evolve) workaround_evolve_profile(r, (double)time, n, R, bg, hmm, gm, om, calibrate);
+  if (hmm_evolve) workaround_evolve_profile(r, (double)time, n, R, ec, bg, hmm, gm, om, om_time, calibrate);
   
   p7_ForwardParser(dsq, n, om, oxf, &(fwdsc));
 
@@ -833,20 +903,43 @@ func_forwardparser(ESL_RANDOMNESS *r, ESL_DSQ *dsq, int n, P7_HMM *hmm, P7_RATE
   return (double)fwdsc;
  }
 
+/* workaround_evolve_profile()
+ * Set <om> to the profile evolved to <time>, configured for length <len>.
+ *
+ * The work is split in two. The time-dependent part (emissions and
+ * transitions) is only redone when <time> differs from <*om_time>, the
+ * time <om> is currently evolved to; with an evolved-profile cache <ec>,
+ * <om> is a clone that just becomes a view of the cached profile,
+ * otherwise the hmm is evolved and <gm>, <om> are rebuilt from it.
+ * The length-dependent part (N/C/J costs) is patched in place. Staying
+ * at the same time therefore costs O(1) per target.
+ */
 static inline void
-workaround_evolve_profile(ESL_RANDOMNESS *r, double time, int len, const P7_RATE *R, P7_BG *bg, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, int calibrate)
+workaround_evolve_profile(ESL_RANDOMNESS *r, double time, int len, const P7_RATE *R, const P7_EVOCACHE *ec, P7_BG *bg, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, int calibrate)
 {  
   if (R == NULL) return;
-  
-  /* evolved HMM */
-  p7_EvolveFromRate(NULL, hmm, R, bg, time, NULL, FALSE); 
 
-  if (calibrate) p7_Calibrate(hmm, NULL, &r, NULL, NULL, NULL);
-  
-  /* evolved profiles gm and om */
-  p7_ProfileConfig(hmm, bg, gm, len, p7_LOCAL);
-  p7_oprofile_Convert(gm, om);
+  if ((float)time != *om_time) {
+    if (ec != NULL) 
+      p7_EvoCacheSelect(ec, (float)time, len, om);
+    else {
+      /* evolved HMM */
+      p7_EvolveFromRate(NULL, hmm, R, bg, time, NULL, FALSE); 
+
+      if (calibrate) p7_Calibrate(hmm, NULL, &r, NULL, NULL, NULL);
   
+      /* evolved profiles gm and om */
+      p7_ProfileConfig(hmm, bg, gm, len, p7_LOCAL);
+      p7_oprofile_Convert(gm, om);
+    }
+    *om_time = (float)time;
+  }
+
+  /* length-dependent part only */
+  if (om->L != len) {
+    if (ec == NULL) p7_ReconfigLength(gm, len);
+    p7_oprofile_ReconfigLength(om, len);
+  }
 }
 
 static inline void
@@ -873,9 +966,21 @@ workaround_calibrate_profile(ESL_RANDOMNESS *r, int len, P7_BG *bg, P7_HMM *hmm,
 }
 
 static inline void
-workaround_restore_profile(float *evparam_star, int len, const P7_RATE *R, P7_BG *bg, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om)
+workaround_restore_profile(float *evparam_star, int len, const P7_RATE *R, const P7_EVOCACHE *ec, P7_BG *bg, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om)
 {  
   if (R == NULL) return;
+
+  if (ec != NULL) {
+    p7_EvoCacheSelect(ec, 1.0, len, om);
+
+    om->evparam[p7_MLAMBDA] = evparam_star[p7_MLAMBDA];
+    om->evparam[p7_VLAMBDA] = evparam_star[p7_VLAMBDA];
+    om->evparam[p7_FLAMBDA] = evparam_star[p7_FLAMBDA];
+    om->evparam[p7_MMU]     = evparam_star[p7_MMU];
+    om->evparam[p7_VMU]     = evparam_star[p7_VMU];
+    om->evparam[p7_FTAU]    = evparam_star[p7_FTAU];
+    return;
+  }
   
   /* evolved HMM */
   p7_EvolveFromRate(NULL, hmm, R, bg, 1.0, NULL, FALSE); 
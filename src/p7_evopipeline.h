@@ -41,9 +41,11 @@ struct optimize_data {
   ESL_DSQ         *dsq;
   int              n;
   P7_RATE         *R;
+  const P7_EVOCACHE *ec;
   P7_HMM          *hmm;
   P7_PROFILE      *gm;
   P7_OPROFILE     *om;
+  float           *om_time;
   P7_BG           *bg;
   P7_OMX          *oxf;
   float            usc;
@@ -55,22 +57,22 @@ struct optimize_data {
 };
 
 extern int p7_OptimizeMSVFilter    (ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EVOPIPE_OPT evopipe_opt,
-				    const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R,
-				    P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf, float *ret_usc,
+				    const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R, const P7_EVOCACHE *ec,
+				    P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf, float *ret_usc,
 				    float nullsc, float filtersc, float F1, int hmm_evolve, float tol);
 extern int p7_OptimizeViterbiFilter(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EVOPIPE_OPT evopipe_opt,
-				    const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R,
-				    P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf, float *ret_vfsc,
+				    const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R, const P7_EVOCACHE *ec,
+				    P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf, float *ret_vfsc,
 				    float filtersc, float F2, int hmm_evolve, float tol);
 extern int p7_OptimizeForwardParser(ESL_RANDOMNESS *r, ESL_MIN_CFG *cfg, ESL_MIN_DAT *stats, EVOPIPE_OPT evopipe_opt,
-				    const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R,
-				    P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, P7_OMX *oxf, float *ret_fwdsc,
+				    const ESL_DSQ *dsq, int n, float *ret_time, P7_RATE *R, const P7_EVOCACHE *ec,
+				    P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, float *om_time, P7_BG *bg, P7_OMX *oxf, float *ret_fwdsc,
 				    float filtersc, float F3, int hmm_evolve, float tol);
 extern int p7_EvoPipeline_Overthruster(P7_PIPELINE *pli, ESL_RANDOMNESS *r, float *evparam_star, EVOPIPE_OPT evopipe_opt,
-				       P7_RATE *R, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, 
+				       P7_RATE *R, const P7_EVOCACHE *ec, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg, const ESL_SQ *sq, const ESL_SQ *ntsq, 
 				       int *ret_hmm_restore, float *ret_fwdsc, float *ret_nullsc);
 extern int p7_EvoPipeline(P7_PIPELINE *pli, ESL_RANDOMNESS *r, float *evparam_star, EVOPIPE_OPT evopipe_opt,
-			  P7_RATE *R, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg,
+			  P7_RATE *R, const P7_EVOCACHE *ec, P7_HMM *hmm, P7_PROFILE *gm, P7_OPROFILE *om, P7_BG *bg,
 			  const ESL_SQ *sq, const ESL_SQ *ntsq, P7_TOPHITS *hitlist, int *ret_hmm_restore);
 
 #endif /*P7_EVOPIPELINE_INCLUDED*/
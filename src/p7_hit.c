@@ -186,6 +186,32 @@ ERROR:
 }
 
 
+// base size is 1 int (serialized size) + 1 byte (presence flags) longer than the sum of the fixed-width elements in the structure
+#define SER_BASE_SIZE (10 * sizeof(int)) + (5 * sizeof(double)) + (4 * sizeof(float)) + sizeof(uint32_t) + (2 * sizeof(int64_t)) + 1 
+#define ACC_PRESENT (1 << 0)
+#define DESC_PRESENT (1 << 1)
+
+/* Function:  p7_hit_SerializedSize
+ * Synopsis:  Returns the size of a serialized P7_HIT, in bytes.
+ *
+ * Purpose:   Return the number of bytes that <p7_hit_Serialize()> will
+ *            write for <obj>, including all its domains and their
+ *            alignments, so that a caller serializing a list of hits
+ *            can size its buffer once instead of growing it hit by hit.
+ */
+extern uint32_t p7_hit_SerializedSize(const P7_HIT *obj){
+  uint32_t ser_size = SER_BASE_SIZE;
+  int      i;
+
+  ser_size += strlen(obj->name) + 1;
+  if(obj->acc  != NULL) ser_size += strlen(obj->acc)  + 1;
+  if(obj->desc != NULL) ser_size += strlen(obj->desc) + 1;
+  for(i = 0; i < obj->ndom; i++){
+    ser_size += p7_domain_SerializedSize(&(obj->dcl[i]));
+  }
+  return ser_size;
+}
+
 /* Function:  p7_HIT_Serialize
  * Synopsis:  Serializes a P7_HIT object into a stream of bytes
  *.           that can be reliably transmitted over internet sockets
@@ -211,12 +237,6 @@ ERROR:
  * Throws:    Returns eslEMEM if unable to allocate or re-allocate memory.  Returns eslEINVAL if obj == NULL, n == NULL, buf == NULL,
  *.           or if *buf = NULL and either *n != 0 or *nalloc != 0. Returns eslFAIL if a consistency check fails.
  */
-
-// base size is 1 int (serialized size) + 1 byte (presence flags) longer than the sum of the fixed-width elements in the structure
-#define SER_BASE_SIZE (10 * sizeof(int)) + (4 * sizeof(double)) + (4 * sizeof(float)) + sizeof(uint32_t) + (2 * sizeof(int64_t)) + 1 
-#define ACC_PRESENT (1 << 0)
-#define DESC_PRESENT (1 << 1)
-
 extern int p7_hit_Serialize(const P7_HIT *obj, uint8_t **buf, uint32_t *n, uint32_t *nalloc){
 
   int status; // error variable used by ESL_ALLOC
@@ -424,46 +444,23 @@ ERROR:
   return eslEMEM;
 }
 
-/* Function:  p7_hit_Deserialize
- * Synopsis:  Derializes a P7_HIT object from a stream of bytes in network order into
- *            a valid data structure
- *
- * Purpose:   Deserializes a serialized P7_HIT object from
- *.           buf starting at position *n.  
- *
- * Inputs:    buf: the buffer that the object should be de-serialized from
- *            pos: a pointer to the offset from the start of buf to the beginning of the object
- *            ret_obj: a P7_HIT structure to deserialize the object into.  May not be NULL. May either be an 
- *            "empty" object created with p7_hit_Create_empty, or a P7_HIT object containing valid data
- *
- * Returns:   On success: returns eslOK, deserializes the P7_HIT object into ret_object, and updates 
- *.           n to point to the position after the end of the P7_HIT object.
- *
- * Throws:    Returns eslEINVAL if ret_obj == NULL, buf == NULL, or n == NULL.  Returnts eslEMEM if unable to allocate
- *            required memory in ret_obj. Returns eslFAIL if an consistency check fails.         
+/* deserialize_fixed()
+ * Decodes the fixed-length fields of the serialized P7_HIT at <ptr>
+ * into <ret_obj>; returns the base object's serialized size in
+ * <*ret_size>, its presence flags in <*ret_flags>, and a pointer to
+ * its name string.
  */
-extern int p7_hit_Deserialize(const uint8_t *buf, uint32_t *n, P7_HIT *ret_obj){
-
-  uint8_t *ptr;
+static const uint8_t *
+deserialize_fixed(const uint8_t *ptr, P7_HIT *ret_obj, uint32_t *ret_size, uint8_t *ret_flags){
   uint64_t network_64bit; // holds 64-bit values in network order 
   uint64_t host_64bit; //variable to hold 64-bit values after conversion to host order
-  uint32_t network_32bit; // holds 64-bit values in network order 
-  uint32_t host_32bit; //variable to hold 64-bit values after conversion to host order
-  uint32_t obj_size; // How much space does the variable-length portion of the serialized object take up?
-  int status, string_length; 
-  uint8_t presence_flags;
-  int i;
-  if (ret_obj == NULL || buf == NULL || n == NULL)
-  {
-    return eslEINVAL;
-  }
+  uint32_t network_32bit; // holds 32-bit values in network order 
+  uint32_t host_32bit; //variable to hold 32-bit values after conversion to host order
 
-  ptr = (uint8_t *) buf + *n;
-  
   //First field: Size of the serialized object.  Copy out of buffer into scalar variable to deal with memory alignment, convert to 
   // host machine order
   memcpy(&network_32bit, ptr, sizeof(uint32_t)); // Grab the bytes out of the buffer
-  obj_size = esl_ntoh32(network_32bit);
+  *ret_size = esl_ntoh32(network_32bit);
   ptr += sizeof(uint32_t);
 
   //Field 2: window_length
@@ -581,9 +578,44 @@ extern int p7_hit_Deserialize(const uint8_t *buf, uint32_t *n, P7_HIT *ret_obj){
   ptr += sizeof(uint64_t);
 
   //Field 22: presence flags
-  memcpy(&presence_flags, ptr, 1); // Grab the bytes out of the buffer
+  memcpy(ret_flags, ptr, 1); // Grab the bytes out of the buffer
   ptr += 1;
 
+  return ptr;
+}
+
+/* Function:  p7_hit_Deserialize
+ * Synopsis:  Derializes a P7_HIT object from a stream of bytes in network order into
+ *            a valid data structure
+ *
+ * Purpose:   Deserializes a serialized P7_HIT object from
+ *.           buf starting at position *n.  
+ *
+ * Inputs:    buf: the buffer that the object should be de-serialized from
+ *            pos: a pointer to the offset from the start of buf to the beginning of the object
+ *            ret_obj: a P7_HIT structure to deserialize the object into.  May not be NULL. May either be an 
+ *            "empty" object created with p7_hit_Create_empty, or a P7_HIT object containing valid data
+ *
+ * Returns:   On success: returns eslOK, deserializes the P7_HIT object into ret_object, and updates 
+ *.           n to point to the position after the end of the P7_HIT object.
+ *
+ * Throws:    Returns eslEINVAL if ret_obj == NULL, buf == NULL, or n == NULL.  Returnts eslEMEM if unable to allocate
+ *            required memory in ret_obj. Returns eslFAIL if an consistency check fails.         
+ */
+extern int p7_hit_Deserialize(const uint8_t *buf, uint32_t *n, P7_HIT *ret_obj){
+
+  const uint8_t *ptr;
+  uint32_t obj_size; // How much space does the variable-length portion of the serialized object take up?
+  int status, string_length; 
+  uint8_t presence_flags;
+  int i;
+  if (ret_obj == NULL || buf == NULL || n == NULL)
+  {
+    return eslEINVAL;
+  }
+
+  ptr = deserialize_fixed(buf + *n, ret_obj, &obj_size, &presence_flags);
+
   //Field 23: name string
   string_length = strlen((char *) ptr) +1;
   
@@ -652,6 +684,59 @@ ERROR:
   return eslEMEM;
 }
 
+/* Function:  p7_hit_DeserializeShared
+ * Synopsis:  Deserializes a P7_HIT without copying its strings.
+ *
+ * Purpose:   Deserializes the base P7_HIT object at <buf> + <*n> into
+ *            <ret_obj>, leaving its name, accession and description
+ *            where they are in <buf> instead of allocating copies.
+ *            Nothing is allocated. The hit's <ndom> domains follow it
+ *            in <buf>; they are not read, and <ret_obj->dcl> is set to
+ *            <NULL>. The caller deserializes them with
+ *            <p7_domain_DeserializeShared()> into storage of its own.
+ *
+ *            <buf> must outlive <ret_obj>, which must not be freed
+ *            with <p7_hit_Destroy()>. See p7_hitblock.c.
+ *
+ * Returns:   <eslOK> on success, and updates <*n> to point to the
+ *            hit's first domain.
+ *
+ * Throws:    <eslEINVAL> if <ret_obj>, <buf> or <n> is <NULL>.
+ *            <eslFAIL> if the strings don't add up to the recorded size.
+ */
+extern int p7_hit_DeserializeShared(uint8_t *buf, uint32_t *n, P7_HIT *ret_obj){
+  uint8_t *ptr;
+  uint32_t obj_size;
+  uint8_t  presence_flags;
+
+  if (ret_obj == NULL || buf == NULL || n == NULL) return eslEINVAL;
+
+  ptr = buf + (deserialize_fixed(buf + *n, ret_obj, &obj_size, &presence_flags) - buf);
+
+  ret_obj->name = (char *) ptr;
+  ptr += strlen(ret_obj->name) + 1;
+
+  ret_obj->acc = NULL;
+  if(presence_flags & ACC_PRESENT){
+    ret_obj->acc = (char *) ptr;
+    ptr += strlen(ret_obj->acc) + 1;
+  }
+
+  ret_obj->desc = NULL;
+  if(presence_flags & DESC_PRESENT){
+    ret_obj->desc = (char *) ptr;
+    ptr += strlen(ret_obj->desc) + 1;
+  }
+
+  if((ptr - (buf + *n)) != obj_size){
+    ESL_EXCEPTION(eslFAIL, "Error: Size of serialized object did not match expected in p7_hit_DeserializeShared\n");
+  }
+
+  ret_obj->dcl = NULL;
+  *n = ptr - buf;
+  return eslOK;
+}
+
 /*****************************************************************
  * 2. Debugging Functions
  *****************************************************************/      
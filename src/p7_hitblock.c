@@ -0,0 +1,558 @@
+/* P7_HITBLOCK: flat, serialized hit lists for the server.
+ *
+ * A worker node writes its hits into a P7_HITBLOCK in one pass, in
+ * sortkey order, and sends the block to the master as a single
+ * message; the master inflates the block in place without allocating
+ * anything per hit. Each block is then a sorted run of hits, and the
+ * master merges the runs of a search k ways when it's done. The hits
+ * in the block use the same p7_hit_Serialize() format that the master
+ * sends on to the client.
+ *
+ * Layout of <blk->data>:
+ *     uint64_t N, nreported, nincluded, ndom, nspp   (network byte order)
+ *     N hits, each a p7_hit_Serialize()'d P7_HIT followed by its domains,
+ *       best first
+ *
+ * Contents:
+ *    1. The P7_HITBLOCK object.
+ *    2. Merging sorted runs of hits.
+ *    3. Unit tests.
+ *    4. Test driver.
+ */
+#include <p7_config.h>
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "easel.h"
+#include "esl_rand64.h"
+
+#include "hmmer.h"
+
+#define HDR_SIZE (5 * sizeof(uint64_t))
+
+/*****************************************************************
+ * 1. The P7_HITBLOCK object.
+ *****************************************************************/
+
+/* Function:  p7_hitblock_Create()
+ * Synopsis:  Create an empty hit block.
+ *
+ * Purpose:   Allocate a new, empty <P7_HITBLOCK>. Its buffers are
+ *            allocated when it's first written, received or inflated,
+ *            and reused after that.
+ *
+ * Throws:    <NULL> on allocation failure.
+ */
+P7_HITBLOCK *
+p7_hitblock_Create(void)
+{
+  P7_HITBLOCK *blk = NULL;
+  int          status;
+
+  ESL_ALLOC(blk, sizeof(P7_HITBLOCK));
+  blk->data      = NULL;
+  blk->n         = 0;
+  blk->nalloc    = 0;
+  blk->N         = 0;
+  blk->nreported = 0;
+  blk->nincluded = 0;
+  blk->ndom      = 0;
+  blk->nspp      = 0;
+  blk->unsrt     = NULL;
+  blk->hit       = NULL;
+  blk->dcl       = NULL;
+  blk->ad        = NULL;
+  blk->spp       = NULL;
+  blk->Nalloc    = 0;
+  blk->domalloc  = 0;
+  blk->sppalloc  = 0;
+  return blk;
+
+ ERROR:
+  return NULL;
+}
+
+
+/* Function:  p7_hitblock_Write()
+ * Synopsis:  Serialize a top hits list into a hit block.
+ *
+ * Purpose:   Sort <th> by sortkey, and write all its hits into <blk> in
+ *            that order, replacing whatever <blk> held; the block is a
+ *            sorted run. The exact size of the serialized list is
+ *            computed first, so <blk->data> is reallocated at most
+ *            once, and only if it's too small.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure. <eslERANGE> if the
+ *            serialized hits would be larger than a single message can
+ *            be (2GB). <eslFAIL> if a hit's serialized size doesn't match
+ *            what was computed for it.
+ */
+int
+p7_hitblock_Write(P7_HITBLOCK *blk, P7_TOPHITS *th)
+{
+  uint64_t size = HDR_SIZE;
+  uint64_t ndom = 0;
+  uint64_t nspp = 0;
+  uint64_t hdr[5];
+  uint64_t i;
+  int      d;
+  int      status;
+
+  if ((status = p7_tophits_SortBySortkey(th)) != eslOK) return status;
+
+  for (i = 0; i < th->N; i++)
+    {
+      size += p7_hit_SerializedSize(&(th->unsrt[i]));
+      ndom += th->unsrt[i].ndom;
+      for (d = 0; d < th->unsrt[i].ndom; d++)
+        if (th->unsrt[i].dcl[d].scores_per_pos != NULL) nspp += th->unsrt[i].dcl[d].ad->N;
+    }
+  if (size > INT_MAX) ESL_EXCEPTION(eslERANGE, "hit block of %" PRIu64 " bytes is too large to send", size);
+
+  if (size > blk->nalloc)
+    {
+      ESL_REALLOC(blk->data, size);
+      blk->nalloc = size;
+    }
+
+  blk->N         = th->N;
+  blk->nreported = th->nreported;
+  blk->nincluded = th->nincluded;
+  blk->ndom      = ndom;
+  blk->nspp      = nspp;
+
+  hdr[0] = esl_hton64(blk->N);
+  hdr[1] = esl_hton64(blk->nreported);
+  hdr[2] = esl_hton64(blk->nincluded);
+  hdr[3] = esl_hton64(blk->ndom);
+  hdr[4] = esl_hton64(blk->nspp);
+  memcpy(blk->data, hdr, HDR_SIZE);
+  blk->n = HDR_SIZE;
+
+  /* the buffer is already big enough, so p7_hit_Serialize() never reallocates it */
+  for (i = 0; i < th->N; i++)
+    if ((status = p7_hit_Serialize(th->hit[i], &(blk->data), &(blk->n), &(blk->nalloc))) != eslOK) return status;
+
+  if (blk->n != size) ESL_EXCEPTION(eslFAIL, "hit block is %u bytes, expected %" PRIu64, blk->n, size);
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+/* Function:  p7_hitblock_Inflate()
+ * Synopsis:  Turn the serialized hits in a block into P7_HITs.
+ *
+ * Purpose:   Deserialize the <blk->n> bytes of hits in <blk->data> (as
+ *            written by <p7_hitblock_Write()>, and received by
+ *            <p7_hitblock_MPIRecv()>) into <blk->unsrt[0..N-1]>, which
+ *            is then in sortkey order, as is <blk->hit>.
+ *
+ *            Nothing is allocated per hit. Hit names, accessions and
+ *            descriptions, and the alignment display strings, are left
+ *            in <blk->data>; domains, alignment displays and
+ *            per-position scores go in the block's <dcl>, <ad> and
+ *            <spp> arrays, which are only reallocated if a block
+ *            needs more than they already hold. All of these stay
+ *            valid until <blk> is written, received into, inflated
+ *            again or destroyed.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure. <eslEFORMAT> if the data
+ *            are truncated or inconsistent with their header.
+ */
+int
+p7_hitblock_Inflate(P7_HITBLOCK *blk)
+{
+  uint64_t hdr[5];
+  uint32_t pos;
+  uint64_t i, d;
+  uint64_t nspp_left;
+  float   *spp;
+  int      j;
+  int      status;
+
+  if (blk->n < HDR_SIZE) ESL_EXCEPTION(eslEFORMAT, "hit block is too short to have a header");
+  memcpy(hdr, blk->data, HDR_SIZE);
+  blk->N         = esl_ntoh64(hdr[0]);
+  blk->nreported = esl_ntoh64(hdr[1]);
+  blk->nincluded = esl_ntoh64(hdr[2]);
+  blk->ndom      = esl_ntoh64(hdr[3]);
+  blk->nspp      = esl_ntoh64(hdr[4]);
+
+  if (blk->N > blk->Nalloc)
+    {
+      ESL_REALLOC(blk->unsrt, sizeof(P7_HIT)   * blk->N);
+      ESL_REALLOC(blk->hit,   sizeof(P7_HIT *) * blk->N);
+      blk->Nalloc = blk->N;
+    }
+  if (blk->ndom > blk->domalloc)
+    {
+      ESL_REALLOC(blk->dcl, sizeof(P7_DOMAIN)     * blk->ndom);
+      ESL_REALLOC(blk->ad,  sizeof(P7_ALIDISPLAY) * blk->ndom);
+      blk->domalloc = blk->ndom;
+    }
+  if (blk->nspp > blk->sppalloc)
+    {
+      ESL_REALLOC(blk->spp, sizeof(float) * blk->nspp);
+      blk->sppalloc = blk->nspp;
+    }
+
+  pos       = HDR_SIZE;
+  d         = 0;
+  spp       = blk->spp;
+  nspp_left = blk->nspp;
+  for (i = 0; i < blk->N; i++)
+    {
+      if (pos >= blk->n) ESL_EXCEPTION(eslEFORMAT, "hit block ends after %" PRIu64 " of %" PRIu64 " hits", i, blk->N);
+      if (p7_hit_DeserializeShared(blk->data, &pos, &(blk->unsrt[i])) != eslOK) ESL_EXCEPTION(eslEFORMAT, "bad hit in hit block");
+      if (blk->unsrt[i].ndom < 0 || d + blk->unsrt[i].ndom > blk->ndom) ESL_EXCEPTION(eslEFORMAT, "hit block has more domains than its header says");
+
+      blk->unsrt[i].dcl = (blk->unsrt[i].ndom > 0 ? blk->dcl + d : NULL);
+      for (j = 0; j < blk->unsrt[i].ndom; j++, d++)
+        if (p7_domain_DeserializeShared(blk->data, &pos, &(blk->dcl[d]), &(blk->ad[d]), &spp, &nspp_left) != eslOK)
+          ESL_EXCEPTION(eslEFORMAT, "bad domain in hit block");
+
+      blk->hit[i] = &(blk->unsrt[i]);
+    }
+  if (pos != blk->n) ESL_EXCEPTION(eslEFORMAT, "hit block has %u bytes, its hits used %u", blk->n, pos);
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+/* Function:  p7_hitblock_Truncate()
+ * Synopsis:  Drop the hits of a run below a sortkey.
+ *
+ * Purpose:   Drop the hits whose sortkey is less than <min_sortkey>
+ *            from the end of the inflated, sorted block <blk>. This is
+ *            how hits that can no longer be reported are dropped as
+ *            they arrive; their bytes stay in <blk->data>, but they are
+ *            no longer part of the run.
+ */
+void
+p7_hitblock_Truncate(P7_HITBLOCK *blk, double min_sortkey)
+{
+  uint64_t lo = 0;
+  uint64_t hi = blk->N;
+  uint64_t mid;
+
+  /* binary search for the first hit below the cutoff */
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      if (blk->unsrt[mid].sortkey >= min_sortkey) lo = mid + 1;
+      else                                        hi = mid;
+    }
+  blk->N = lo;
+}
+
+
+/* Function:  p7_hitblock_Destroy()
+ * Synopsis:  Free a hit block.
+ */
+void
+p7_hitblock_Destroy(P7_HITBLOCK *blk)
+{
+  if (blk == NULL) return;
+  if (blk->data)  free(blk->data);
+  if (blk->unsrt) free(blk->unsrt);
+  if (blk->hit)   free(blk->hit);
+  if (blk->dcl)   free(blk->dcl);
+  if (blk->ad)    free(blk->ad);
+  if (blk->spp)   free(blk->spp);
+  free(blk);
+}
+/*------------------- end, P7_HITBLOCK object -------------------*/
+
+
+
+/*****************************************************************
+ * 2. Merging sorted runs of hits.
+ *****************************************************************/
+
+/* The k-way merge keeps a binary heap of runs, ordered by the hit at
+ * the head of each run: heap[0] is the run whose next hit is the best.
+ */
+static void
+heap_sift_down(P7_HITBLOCK **run, uint64_t *head, int *heap, int nheap, int i)
+{
+  int c, tmp;
+
+  while ((c = 2*i + 1) < nheap)
+    {
+      if (c+1 < nheap &&
+          p7_tophits_CompareBySortkey(&(run[heap[c+1]]->unsrt[head[heap[c+1]]]), &(run[heap[c]]->unsrt[head[heap[c]]])) < 0) c++;
+      if (p7_tophits_CompareBySortkey(&(run[heap[c]]->unsrt[head[heap[c]]]), &(run[heap[i]]->unsrt[head[heap[i]]])) >= 0) break;
+      tmp = heap[i]; heap[i] = heap[c]; heap[c] = tmp;
+      i = c;
+    }
+}
+
+/* Function:  p7_hitblock_MergeRuns()
+ * Synopsis:  Merge sorted runs of hits k ways.
+ *
+ * Purpose:   Merge the hits of the <nrun> inflated hit blocks <run>,
+ *            each of them a sorted run, into <hit>, in the order
+ *            <p7_tophits_SortBySortkey()> would put them in, stopping
+ *            at the first hit whose sortkey is less than
+ *            <min_sortkey>. Pass <-eslINFINITY> to keep all of them.
+ *            Caller provides <hit>, with room for all the runs' hits.
+ *
+ *            The hits are not copied; <hit> points into the blocks,
+ *            which must outlive it. The merge takes O(N log nrun) time
+ *            for N hits.
+ *
+ * Returns:   <eslOK> on success, and <*ret_N> is the number of hits in
+ *            <hit>.
+ *
+ * Throws:    <eslEMEM> on allocation failure, and <*ret_N> is 0.
+ */
+int
+p7_hitblock_MergeRuns(P7_HITBLOCK **run, int nrun, double min_sortkey, P7_HIT **hit, uint64_t *ret_N)
+{
+  uint64_t *head  = NULL;   /* head[r]: index of the next hit in run[r] */
+  int      *heap  = NULL;
+  int       nheap = 0;
+  uint64_t  N     = 0;
+  P7_HIT   *best;
+  int       r;
+  int       status;
+
+  *ret_N = 0;
+  if (nrun == 0) return eslOK;
+
+  ESL_ALLOC(head, sizeof(uint64_t) * nrun);
+  ESL_ALLOC(heap, sizeof(int)      * nrun);
+  for (r = 0; r < nrun; r++)
+    {
+      head[r] = 0;
+      if (run[r]->N > 0) heap[nheap++] = r;
+    }
+  for (r = nheap/2 - 1; r >= 0; r--)
+    heap_sift_down(run, head, heap, nheap, r);
+
+  while (nheap > 0)
+    {
+      r    = heap[0];
+      best = &(run[r]->unsrt[head[r]]);
+      if (best->sortkey < min_sortkey) break;  /* every hit left is worse */
+
+      hit[N++] = best;
+      if (++head[r] == run[r]->N) heap[0] = heap[--nheap];
+      heap_sift_down(run, head, heap, nheap, 0);
+    }
+
+  free(head);
+  free(heap);
+  *ret_N = N;
+  return eslOK;
+
+ ERROR:
+  if (head) free(head);
+  if (heap) free(heap);
+  return status;
+}
+/*------------------ end, merging sorted runs -------------------*/
+
+
+
+/*****************************************************************
+ * 3. Unit tests.
+ *****************************************************************/
+#ifdef p7HITBLOCK_TESTDRIVE
+
+/* sample_tophits()
+ * Fills a new top hits list with <nhits> random hits from p7_hit_TestSample().
+ */
+static P7_TOPHITS *
+sample_tophits(ESL_RAND64 *rng, int nhits)
+{
+  char        msg[] = "sample_tophits failed";
+  P7_TOPHITS *th    = p7_tophits_Create();
+  P7_HIT     *hit   = NULL;
+  P7_HIT     *slot;
+  int         i;
+
+  if (th == NULL) esl_fatal(msg);
+  for (i = 0; i < nhits; i++)
+    {
+      if (p7_hit_TestSample(rng, &hit)            != eslOK) esl_fatal(msg);
+      if (p7_tophits_CreateNextHit(th, &slot)     != eslOK) esl_fatal(msg);
+      memcpy(slot, hit, sizeof(P7_HIT));          /* th takes over the hit's strings and domains */
+      free(hit);
+      hit = NULL;
+    }
+  th->nreported = esl_rand64_Roll(rng, nhits+1);
+  th->nincluded = esl_rand64_Roll(rng, th->nreported+1);
+  return th;
+}
+
+/* utest_roundtrip()
+ * Write a top hits list into a block, copy the bytes into a second block as
+ * p7_hitblock_MPIRecv() would, inflate that, and check that every hit matches;
+ * then do the same with a second, shorter list, to exercise reuse.
+ */
+static void
+utest_roundtrip(ESL_RAND64 *rng, int nhits)
+{
+  char         msg[] = "utest_roundtrip failed";
+  P7_HITBLOCK *out   = p7_hitblock_Create();
+  P7_HITBLOCK *in    = p7_hitblock_Create();
+  P7_TOPHITS  *th;
+  int          trial, i;
+
+  if (out == NULL || in == NULL) esl_fatal(msg);
+
+  for (trial = 0; trial < 2; trial++)
+    {
+      th = sample_tophits(rng, trial == 0 ? nhits : nhits/2);
+      if (p7_hitblock_Write(out, th) != eslOK) esl_fatal(msg);
+
+      if (in->nalloc < out->n) {
+        if ((in->data = realloc(in->data, out->n)) == NULL) esl_fatal(msg);
+        in->nalloc = out->n;
+      }
+      memcpy(in->data, out->data, out->n);
+      in->n = out->n;
+
+      if (p7_hitblock_Inflate(in)  != eslOK)         esl_fatal(msg);
+      if (in->N         != th->N)                    esl_fatal(msg);
+      if (in->nreported != th->nreported)            esl_fatal(msg);
+      if (in->nincluded != th->nincluded)            esl_fatal(msg);
+      for (i = 0; i < th->N; i++)  /* the block is in sortkey order */
+        if (p7_hit_Compare(th->hit[i], &(in->unsrt[i]), 1e-4, 1e-4) != eslOK) esl_fatal(msg);
+
+      p7_tophits_Destroy(th);
+    }
+
+  p7_hitblock_Destroy(out);
+  p7_hitblock_Destroy(in);
+}
+
+static int
+hit_sorter(const void *vh1, const void *vh2)
+{
+  return p7_tophits_CompareBySortkey(*((const P7_HIT **) vh1), *((const P7_HIT **) vh2));
+}
+
+/* utest_mergeruns()
+ * Merge the runs of several inflated blocks, one of them empty, as the
+ * server master does at the end of a search, and check the result
+ * against a qsort() of all the hits; then check that a sortkey cutoff,
+ * applied either by the merge or to each run with p7_hitblock_Truncate(),
+ * keeps exactly the hits at or above it.
+ */
+static void
+utest_mergeruns(ESL_RAND64 *rng, int nhits)
+{
+  char          msg[] = "utest_mergeruns failed";
+  int           nrun  = 4;
+  P7_TOPHITS   *th[4];
+  P7_HITBLOCK  *blk[4];
+  P7_HIT      **ref   = NULL;
+  P7_HIT      **hit   = NULL;
+  uint64_t      nref  = 0;
+  uint64_t      N, nabove;
+  double        cutoff;
+  int           r, i;
+
+  for (r = 0; r < nrun; r++)
+    {
+      th[r]  = sample_tophits(rng, r == 2 ? 0 : nhits / (r+1));
+      blk[r] = p7_hitblock_Create();
+      if (blk[r] == NULL)                         esl_fatal(msg);
+      if (p7_hitblock_Write(blk[r], th[r]) != eslOK) esl_fatal(msg);
+      if (p7_hitblock_Inflate(blk[r])      != eslOK) esl_fatal(msg);
+      nref += th[r]->N;
+    }
+
+  if ((ref = malloc(sizeof(P7_HIT *) * nref)) == NULL) esl_fatal(msg);
+  if ((hit = malloc(sizeof(P7_HIT *) * nref)) == NULL) esl_fatal(msg);
+  for (nref = 0, r = 0; r < nrun; r++)
+    for (i = 0; i < th[r]->N; i++) ref[nref++] = &(th[r]->unsrt[i]);
+  qsort(ref, nref, sizeof(P7_HIT *), hit_sorter);
+
+  if (p7_hitblock_MergeRuns(blk, nrun, -eslINFINITY, hit, &N) != eslOK) esl_fatal(msg);
+  if (N != nref)                                                        esl_fatal(msg);
+  for (i = 0; i < N; i++)
+    if (p7_hit_Compare(ref[i], hit[i], 1e-4, 1e-4) != eslOK)            esl_fatal(msg);
+
+  cutoff = ref[nref/2]->sortkey;
+  for (nabove = 0; nabove < nref && ref[nabove]->sortkey >= cutoff; nabove++) ;
+
+  if (p7_hitblock_MergeRuns(blk, nrun, cutoff, hit, &N) != eslOK)       esl_fatal(msg);
+  if (N != nabove)                                                      esl_fatal(msg);
+
+  for (r = 0; r < nrun; r++) p7_hitblock_Truncate(blk[r], cutoff);
+  if (p7_hitblock_MergeRuns(blk, nrun, -eslINFINITY, hit, &N) != eslOK) esl_fatal(msg);
+  if (N != nabove)                                                      esl_fatal(msg);
+  for (i = 0; i < N; i++)
+    if (p7_hit_Compare(ref[i], hit[i], 1e-4, 1e-4) != eslOK)            esl_fatal(msg);
+
+  for (r = 0; r < nrun; r++)
+    {
+      p7_tophits_Destroy(th[r]);
+      p7_hitblock_Destroy(blk[r]);
+    }
+  free(ref);
+  free(hit);
+}
+
+/* utest_corrupt()
+ * Inflating a block that has lost its last bytes fails cleanly.
+ */
+static void
+utest_corrupt(ESL_RAND64 *rng)
+{
+  char         msg[] = "utest_corrupt failed";
+  P7_TOPHITS  *th    = sample_tophits(rng, 5);
+  P7_HITBLOCK *blk   = p7_hitblock_Create();
+
+  if (p7_hitblock_Write(blk, th) != eslOK)  esl_fatal(msg);
+  blk->n -= 1;
+  if (p7_hitblock_Inflate(blk) != eslEFORMAT) esl_fatal(msg);
+  blk->n = 3;
+  if (p7_hitblock_Inflate(blk) != eslEFORMAT) esl_fatal(msg);
+
+  p7_tophits_Destroy(th);
+  p7_hitblock_Destroy(blk);
+}
+#endif /*p7HITBLOCK_TESTDRIVE*/
+/*---------------------- end, unit tests ------------------------*/
+
+
+
+
+/*****************************************************************
+ * 4. Test driver.
+ *****************************************************************/
+#ifdef p7HITBLOCK_TESTDRIVE
+
+int
+main(int argc, char **argv)
+{
+  ESL_RAND64 *rng = esl_rand64_Create(0);
+
+  esl_exception_SetHandler(&esl_nonfatal_handler);  /* utest_corrupt() provokes exceptions */
+
+  utest_roundtrip(rng, 100);
+  utest_mergeruns(rng, 60);
+  utest_corrupt  (rng);
+
+  esl_rand64_Destroy(rng);
+  fprintf(stderr, "#  status = ok\n");
+  return eslOK;
+}
+#endif /*p7HITBLOCK_TESTDRIVE*/
+/*--------------------- end, test driver ------------------------*/
@@ -21,6 +21,11 @@
 #include <pthread.h>
 #endif
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "easel.h"
 #include "esl_alphabet.h"
 #include "esl_ssi.h"     /* this gives us esl_byteswap */
@@ -56,6 +61,8 @@ static int read_asc30hmm(P7_HMMFILE *hfp, ESL_ALPHABET **ret_abc, P7_HMM **opt_h
 static int read_bin30hmm(P7_HMMFILE *hfp, ESL_ALPHABET **ret_abc, P7_HMM **opt_hmm);
 static int read_asc20hmm(P7_HMMFILE *hfp, ESL_ALPHABET **ret_abc, P7_HMM **opt_hmm);
 
+static int   map_pressed(P7_HMMFILE *hfp);
+
 static int   write_bin_string(FILE *fp, char *s);
 static int   read_bin_string (FILE *fp, char **ret_s);
 static float h2ascii2prob(char *s, float null);
@@ -179,6 +186,7 @@ p7_hmmfile_OpenBuffer(const char *buffer, int size, P7_HMMFILE **ret_hfp)
   hfp->efp          = NULL;
   hfp->ffp          = NULL;
   hfp->pfp          = NULL;
+  hfp->map          = NULL;
   hfp->ssi          = NULL;
   hfp->errbuf[0]    = '\0';
   hfp->rr_errbuf[0] = '\0';
@@ -249,6 +257,7 @@ open_engine(const char *filename, char *env, P7_HMMFILE **ret_hfp, int do_ascii_
   hfp->efp          = NULL;
   hfp->ffp          = NULL;
   hfp->pfp          = NULL;
+  hfp->map          = NULL;
   hfp->ssi          = NULL;
   hfp->errbuf[0]    = '\0';
   hfp->rr_errbuf[0] = '\0';
@@ -355,6 +364,9 @@ open_engine(const char *filename, char *env, P7_HMMFILE **ret_hfp, int do_ascii_
     dbfile[n-1] = 'p';  /* the remainder of the optimized profiles */
     if ((hfp->pfp = fopen(dbfile, "rb")) == NULL) ESL_XFAIL(eslENOTFOUND, errbuf, "Opened %s, a pressed HMM file; but no .h3p file found", hfp->fname);
 
+    /* map .h3f and .h3p into memory if we can, so optimized profiles can point into them; else they're read with fread() */
+    if ((status = map_pressed(hfp)) != eslOK) ESL_XFAIL(status, errbuf, "allocation failed: pressed file map");
+
     dbfile[n-1] = 'i';  /* the SSI index for the .h3m file */
     status = esl_ssi_Open(dbfile, &(hfp->ssi));
     if      (status == eslENOTFOUND) ESL_XFAIL(eslENOTFOUND, errbuf, "Opened %s, a pressed HMM file; but no .h3i file found", hfp->fname);
@@ -438,6 +450,7 @@ p7_hmmfile_Close(P7_HMMFILE *hfp)
   if (!hfp->do_gzip && !hfp->do_stdin && hfp->f != NULL) fclose(hfp->f);
   if (hfp->ffp   != NULL) fclose(hfp->ffp);
   if (hfp->pfp   != NULL) fclose(hfp->pfp);
+  if (hfp->map   != NULL) p7_hmmfile_ReleaseMap(hfp->map);
   if (hfp->fname != NULL) free(hfp->fname);
   if (hfp->efp   != NULL) esl_fileparser_Destroy(hfp->efp);
   if (hfp->ssi   != NULL) esl_ssi_Close(hfp->ssi);
@@ -447,6 +460,81 @@ p7_hmmfile_Close(P7_HMMFILE *hfp)
   free(hfp);
 }
 
+/* Function:  p7_hmmfile_ReleaseMap()
+ * Synopsis:  Drop a reference to a mapped pressed database.
+ *
+ * Purpose:   Decrement the reference count of the mapped binary
+ *            files of a pressed HMM database <map>, and unmap them
+ *            when the last reference is dropped. Both the <P7_HMMFILE>
+ *            that mapped them and each optimized profile that points
+ *            into them hold a reference, so profiles read from a 
+ *            mapped database remain valid after the file is closed.
+ *            
+ *            Thread-safe: profiles may be destroyed in any thread.
+ *
+ * Returns:   (void)
+ */
+void
+p7_hmmfile_ReleaseMap(P7_PRESSMAP *map)
+{
+  if (map == NULL) return;
+  if (__atomic_sub_fetch(&(map->nref), 1, __ATOMIC_ACQ_REL) > 0) return;
+
+#ifdef HAVE_MMAP
+  if (map->fmap != NULL) munmap(map->fmap, map->fsize);
+  if (map->pmap != NULL) munmap(map->pmap, map->psize);
+#endif
+  free(map);
+}
+
+/* map_pressed()
+ *
+ * Map the open .h3f and .h3p streams of a pressed database <hfp>
+ * into memory, and set <hfp->map>. The mapping is private and
+ * copy-on-write: profiles point straight into it, and the few
+ * routines that modify a profile's scores in place (e.g. bias
+ * composition updates) get their own copy of just the pages they
+ * touch. If the system doesn't support mmap(), or either mapping
+ * fails, leave <hfp->map> NULL; profiles are then read the usual
+ * way.
+ *
+ * Returns <eslOK> on success, including when the files aren't mapped.
+ * Throws  <eslEMEM> on allocation failure.
+ */
+static int
+map_pressed(P7_HMMFILE *hfp)
+{
+#ifdef HAVE_MMAP
+  P7_PRESSMAP *map = NULL;
+  struct stat  fst, pst;
+  int          status;
+
+  if (fstat(fileno(hfp->ffp), &fst) != 0 || fst.st_size == 0) return eslOK;
+  if (fstat(fileno(hfp->pfp), &pst) != 0 || pst.st_size == 0) return eslOK;
+
+  ESL_ALLOC(map, sizeof(P7_PRESSMAP));
+  map->fsize = fst.st_size;
+  map->psize = pst.st_size;
+  map->nref  = 1;		/* the <hfp>'s reference */
+  map->fmap  = mmap(NULL, map->fsize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(hfp->ffp), 0);
+  map->pmap  = mmap(NULL, map->psize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(hfp->pfp), 0);
+  if (map->fmap == MAP_FAILED || map->pmap == MAP_FAILED)
+    {
+      if (map->fmap != MAP_FAILED) munmap(map->fmap, map->fsize);
+      if (map->pmap != MAP_FAILED) munmap(map->pmap, map->psize);
+      free(map);
+      return eslOK;
+    }
+  hfp->map = map;
+  return eslOK;
+
+ ERROR:
+  return status;
+#else
+  return eslOK;
+#endif
+}
+
 #ifdef HMMER_THREADS
 /* Function:  p7_hmmfile_CreateLock()
  *
@@ -109,6 +109,7 @@ p7_pipeline_Create(const ESL_GETOPTS *go, int M_hint, int L_hint, int long_targe
 
   if ((pli->fwd = p7_omx_Create(M_hint, L_hint, L_hint)) == NULL) goto ERROR;
   if ((pli->bck = p7_omx_Create(M_hint, L_hint, L_hint)) == NULL) goto ERROR;
+  if ((pli->chk = p7_omxchk_Create(M_hint, L_hint, ESL_MBYTES(p7_RAMLIMIT))) == NULL) goto ERROR;
   if ((pli->oxf = p7_omx_Create(M_hint, 0,      L_hint)) == NULL) goto ERROR;
   if ((pli->oxb = p7_omx_Create(M_hint, 0,      L_hint)) == NULL) goto ERROR;     
 
@@ -275,6 +276,7 @@ p7_pipeline_Reuse(P7_PIPELINE *pli)
   p7_omx_Reuse(pli->oxb);
   p7_omx_Reuse(pli->fwd);
   p7_omx_Reuse(pli->bck);
+  p7_omxchk_Reuse(pli->chk);
   p7_domaindef_Reuse(pli->ddef);
   return eslOK;
 }
@@ -295,6 +297,7 @@ p7_pipeline_Destroy(P7_PIPELINE *pli)
   p7_omx_Destroy(pli->oxb);
   p7_omx_Destroy(pli->fwd);
   p7_omx_Destroy(pli->bck);
+  p7_omxchk_Destroy(pli->chk);
   esl_randomness_Destroy(pli->r);
   p7_domaindef_Destroy(pli->ddef);
   free(pli);
@@ -743,7 +746,7 @@ extern int p7_Pipeline_Overthruster(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg
   /* In scan mode, if it passes the MSV filter, read the rest of the profile */
   if (pli->mode == p7_SCAN_MODELS)
   {
-    if (pli->hfp)
+    if (pli->hfp && om->base_w == 0 && om->scale_w == 0) /* not already read, for an earlier query in an hmmscan --qbatch batch */
       p7_oprofile_ReadRest(pli->hfp, om);
     p7_oprofile_ReconfigRestLength(om, sq->n);
     if ((status = p7_pli_NewModelThresholds(pli, om)) != eslOK)
@@ -841,7 +844,7 @@ extern int p7_Pipeline_Overthruster(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg
   p7_omx_GrowTo(pli->oxb, om->M, 0, sq->n);
   p7_BackwardParser(sq->dsq, sq->n, om, pli->oxf, pli->oxb, NULL);
  
-  status = p7_domaindef_ByPosteriorHeuristics(sq, ntsq, om, pli->oxf, pli->oxb, pli->fwd, pli->bck, pli->ddef, bg, FALSE, NULL, NULL, NULL);
+  status = p7_domaindef_ByPosteriorHeuristics(sq, ntsq, om, pli->oxf, pli->oxb, pli->fwd, pli->bck, pli->chk, pli->ddef, bg, FALSE, NULL, NULL, NULL);
   if (status != eslOK) ESL_FAIL(status, pli->errbuf, "domain definition workflow failure"); /* eslERANGE can happen  */
   if (pli->ddef->nregions   == 0) return eslOK; /* score passed threshold but there's no discrete domains here       */
   if (pli->ddef->nenvelopes == 0) return eslOK; /* rarer: region was found, stochastic clustered, no envelopes found */
@@ -1231,7 +1234,7 @@ p7_pli_postViterbi_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_T
   p7_BackwardParser(subseq, window_len, om, pli->oxf, pli->oxb, NULL);
 
   //if we're asked to not do null correction, pass a NULL instead of a temp scores variable - domaindef knows what to do
-  status = p7_domaindef_ByPosteriorHeuristics(pli_tmp->tmpseq, NULL, om, pli->oxf, pli->oxb, pli->fwd, pli->bck, pli->ddef, bg, TRUE,
+  status = p7_domaindef_ByPosteriorHeuristics(pli_tmp->tmpseq, NULL, om, pli->oxf, pli->oxb, pli->fwd, pli->bck, pli->chk, pli->ddef, bg, TRUE,
                                               pli_tmp->bg, (pli->do_null2?pli_tmp->scores:NULL), pli_tmp->fwd_emissions_arr);
 
   pli_tmp->tmpseq->dsq = dsq_holder;
@@ -1543,6 +1546,209 @@ p7_pli_postSSV_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_TOPHI
 
 
 
+/* longtarget_windows()
+ *
+ * The part of <p7_Pipeline_LongTarget()> after the SSV filter: merge
+ * the SSV-passing windows in <msv_windowlist>, and pass each one that
+ * survives MSV on to the rest of the pipeline. Arguments are as for
+ * <p7_Pipeline_LongTarget()>. The caller still owns <msv_windowlist>.
+ */
+static int
+longtarget_windows(P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
+                   P7_BG *bg, P7_TOPHITS *hitlist,
+                   int64_t seqidx, const ESL_SQ *sq, int complementarity,
+                   const FM_DATA *fmf, FM_CFG *fm_cfg, P7_HMM_WINDOWLIST *msv_windowlist)
+{
+  float            nullsc;   // null model score
+  float            usc;      // msv score
+  float            P;
+  //  float            bias_filtersc;  // SRE: see comment below on TJW's non-use of this
+  ESL_DSQ          *subseq;
+  uint64_t         seq_start;
+  int              i;
+  int              status;
+
+  P7_HMM_WINDOWLIST vit_windowlist;
+  P7_HMM_WINDOW    *window;
+  FM_SEQDATA        seq_data;
+
+  P7_PIPELINE_LONGTARGET_OBJS *pli_tmp = NULL;
+
+  vit_windowlist.windows = NULL;
+  if (msv_windowlist->count == 0) return eslOK;
+
+  ESL_ALLOC(pli_tmp, sizeof(P7_PIPELINE_LONGTARGET_OBJS));
+  pli_tmp->tmpseq = NULL;
+  pli_tmp->bg = p7_bg_Clone(bg);
+  pli_tmp->om = p7_oprofile_Create(om->M, om->abc);
+  ESL_ALLOC(pli_tmp->scores, sizeof(float) * om->abc->Kp * 4); //allocation of space to store scores that will be used in p7_oprofile_Update(Fwd|Vit|MSV)EmissionScores
+  ESL_ALLOC(pli_tmp->fwd_emissions_arr, sizeof(float) *  om->abc->Kp * (om->M+1));
+
+  memset(pli_tmp->fwd_emissions_arr, 0, sizeof(float) *  om->abc->Kp * (om->M+1));
+  // ^^ note on why the memset() is there:
+  // p7_oprofile_GetFwdEmissionsScoreArray() appears problematic.
+  // iss #320 detected use of uninitialized memory and I'm not surprised; probably not the only thing wrong.
+  // the memset() above is added to patch iss #320, but I expect other more subtle problems. See note on the function.
+  // [SRE 2024/0107-h3-iss320]
+
+  /* convert hits to windows, merging neighboring windows
+   */
+
+  /* In scan mode, if it passes the MSV filter, read the rest of the profile */
+  if (!fmf && pli->hfp)
+    {
+      if (om->base_w == 0 &&  om->scale_w == 0) { // we haven't already read this hmm (if we're on the second strand, we would've)
+        p7_oprofile_ReadRest(pli->hfp, om);
+        if ((status = p7_pli_NewModelThresholds(pli, om)) != eslOK) goto ERROR;
+      }
+    }
+
+  p7_oprofile_GetFwdEmissionArray(om, bg, pli_tmp->fwd_emissions_arr);
+
+  if (data->prefix_lengths == NULL)  // otherwise, already filled in
+    p7_hmm_ScoreDataComputeRest(om, data);
+
+  p7_pli_ExtendAndMergeWindows (om, data, msv_windowlist, 0);
+
+  /*  If using FM, it's possible for a seed we just created to span more than one segment
+   *  in the target. Check for this, and resolve it, by trimming an over-extended
+   *  segment, and tacking it on as a new window (to be dealt with in a later pass)
+   */
+  if (fmf) {
+    for (i=0; i<msv_windowlist->count; i++) {
+      int again = TRUE;
+      window = msv_windowlist->windows + i;
+
+      while (again) {
+        uint32_t seg_id;
+        uint64_t seg_pos;
+        again = FALSE;
+
+        status = fm_getOriginalPosition (fmf, fm_cfg->meta, 0, window->length, window->complementarity, window->fm_n, &seg_id, &seg_pos);
+
+        if (status == eslERANGE) {
+          int overext;
+          int use_length;
+          int is_compl = (window->complementarity == p7_COMPLEMENT);
+
+          overext = (seg_pos + window->length) - (fm_cfg->meta->seq_data[ seg_id ].target_start + fm_cfg->meta->seq_data[ seg_id ].length - 1) ;
+
+          use_length = window->length - overext + 1;
+
+          if (use_length >= 8 && window->length >= 8) { // if both halves are kinda long, split the first half off as a new window
+            p7_hmmwindow_new(msv_windowlist, seg_id + (is_compl?-1:1), window->n, window->fm_n, window->k+use_length-1, use_length, window->score, window->complementarity, fm_cfg->meta->seq_data[seg_id].length);
+            window = msv_windowlist->windows + i; // it may have moved due a a realloc
+            window->k      +=  use_length;
+            window->length  =  overext;
+            again         = TRUE;
+          } else if (window->length >= 8) { //if just the right half is long enough, shift numbers over
+            window->k      +=  use_length;
+            window->length  =  overext;
+          } else { //just limit the length of the left half
+            window->length  =  use_length;
+          }
+
+        }
+      }
+    }
+  }
+
+  /* Pass each remaining window on to the remaining pipeline */
+  p7_hmmwindow_init(&vit_windowlist);
+  pli_tmp->tmpseq = esl_sq_CreateDigital(om->abc);
+  if (!fmf )
+    free (pli_tmp->tmpseq->dsq);  //this ESL_SQ object is just a container that'll point to a series of other DSQs, so free the one we just created inside the larger SQ object
+
+
+  for (i=0; i<msv_windowlist->count; i++){
+    window =  msv_windowlist->windows + i ;
+
+    if (fmf) {
+      fm_convertRange2DSQ( fmf, fm_cfg->meta, window->fm_n, window->length, window->complementarity, pli_tmp->tmpseq, TRUE );
+      subseq = pli_tmp->tmpseq->dsq;
+    } else {
+      subseq = sq->dsq + window->n - 1;
+    }
+
+    p7_bg_SetLength(bg, window->length);
+    p7_bg_NullOne  (bg, subseq, window->length, &nullsc);
+
+    /* SRE: Unclear what TJW's intent here is.
+     * He was calling p7_bg_FilterScore() without checking pli->do_biasfilter,
+     * which is a bug: p7_pli_NewModel only initializes the filter HMM when
+     * pli->do_biasfilter is TRUE, so memory sanitizers will see uninitialized
+     * memory being used. But he doesn't use bias_filtersc for anything,
+     * so it's a no-op anyway. I'm going to:
+     *    1. fix the code by checking for pli->do_biasfilter
+     *    2. then comment it out because he isn't using the result anyway.
+     */
+    // if (pli->do_biasfilter)
+    //   p7_bg_FilterScore(bg, subseq, window->length, &bias_filtersc);
+
+    // Compute standard MSV to ensure that bias doesn't overcome SSV score when MSV
+    // would have survived it
+    p7_oprofile_ReconfigMSVLength(om, window->length);
+    p7_MSVFilter(subseq, window->length, om, pli->oxf, &usc);
+    P = esl_gumbel_surv( (usc-nullsc)/eslCONST_LOG2,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
+
+    if (P > pli->F1 ) continue;
+    pli->pos_past_msv += window->length;
+
+    if (fmf) {
+      seq_data = fm_cfg->meta->seq_data[window->id];
+      seq_start =  seq_data.target_start;
+      if (window->complementarity == p7_COMPLEMENT)
+        seq_start += seq_data.length - 2;
+    }
+
+    status = p7_pli_postSSV_LongTarget(pli, om, bg, hitlist, data,
+          (fmf != NULL ? seq_data.target_id     : seqidx),
+          window->n, window->length, subseq,
+          (fmf != NULL ? seq_start       : sq->start),
+          (fmf != NULL ? seq_data.name   : sq->name),
+          (fmf != NULL ? seq_data.source : sq->source),
+          (fmf != NULL ? seq_data.acc    : sq->acc),
+          (fmf != NULL ? seq_data.desc   : sq->desc),
+          (fmf != NULL ? seq_data.length : -1),
+          nullsc,
+          usc,
+          (fmf != NULL ? window->complementarity : complementarity),
+          &vit_windowlist,
+          pli_tmp
+      );
+      if (status != eslOK) goto ERROR;
+
+  }
+
+  if (fmf)  free (pli_tmp->tmpseq->dsq);
+
+  pli_tmp->tmpseq->dsq = NULL;  //it's a pointer to a dsq object belonging to another sequence
+
+  esl_sq_Destroy(pli_tmp->tmpseq);
+  free (vit_windowlist.windows);
+
+  p7_bg_Destroy(pli_tmp->bg);
+  p7_oprofile_Destroy(pli_tmp->om);
+  free (pli_tmp->scores);
+  free (pli_tmp->fwd_emissions_arr);
+  free(pli_tmp);
+  return eslOK;
+
+ERROR:
+  if (vit_windowlist.windows != NULL) free (vit_windowlist.windows);
+
+  if (pli_tmp != NULL) {
+    if (pli_tmp->tmpseq != NULL) esl_sq_Destroy(pli_tmp->tmpseq);
+    if (pli_tmp->bg != NULL)     p7_bg_Destroy(pli_tmp->bg);
+    if (pli_tmp->om != NULL)     p7_oprofile_Destroy(pli_tmp->om);
+    if (pli_tmp->scores != NULL)        free (pli_tmp->scores);
+    if (pli_tmp->fwd_emissions_arr != NULL) free (pli_tmp->fwd_emissions_arr);
+    free(pli_tmp);
+  }
+  return status;
+}
+
+
 /* Function:  p7_Pipeline_LongTarget()
  * Synopsis:  Accelerated seq/profile comparison pipeline for long target sequences.
  *
@@ -1562,6 +1768,9 @@ p7_pli_postSSV_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_BG *bg, P7_TOPHI
  *            bean counting information about how many comparisons and
  *            residues flow through the pipeline while it's active.
  *
+ *            To search one FM-index block with several queries at
+ *            once, see <p7_Pipeline_LongTargetBatch()>.
+ *
  * Returns:   <eslOK> on success. If a significant hit is obtained,
  *            its information is added to the growing <hitlist>.
  *
@@ -1602,41 +1811,12 @@ p7_Pipeline_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
                         const FM_DATA *fmf, const FM_DATA *fmb, FM_CFG *fm_cfg
                         )
 {
-  float            nullsc;   // null model score
-  float            usc;      // msv score
-  float            P;
-  //  float            bias_filtersc;  // SRE: see comment below on TJW's non-use of this
-  ESL_DSQ          *subseq;
-  uint64_t         seq_start;
-  int              i;
-  int              status;
-
   P7_HMM_WINDOWLIST msv_windowlist;
-  P7_HMM_WINDOWLIST vit_windowlist;
-  P7_HMM_WINDOW    *window;
-  FM_SEQDATA        seq_data;
-
-  P7_PIPELINE_LONGTARGET_OBJS *pli_tmp;
+  int               status;
 
   if ((sq && (sq->n == 0)) || (fmf && (fmf->N == 0))) return eslOK;    /* silently skip length 0 seqs; they'd cause us all sorts of weird problems */
 
-
-  ESL_ALLOC(pli_tmp, sizeof(P7_PIPELINE_LONGTARGET_OBJS));
-  pli_tmp->tmpseq = NULL;
-  pli_tmp->bg = p7_bg_Clone(bg);
-  pli_tmp->om = p7_oprofile_Create(om->M, om->abc);
-  ESL_ALLOC(pli_tmp->scores, sizeof(float) * om->abc->Kp * 4); //allocation of space to store scores that will be used in p7_oprofile_Update(Fwd|Vit|MSV)EmissionScores
-  ESL_ALLOC(pli_tmp->fwd_emissions_arr, sizeof(float) *  om->abc->Kp * (om->M+1));
-
-  memset(pli_tmp->fwd_emissions_arr, 0, sizeof(float) *  om->abc->Kp * (om->M+1));
-  // ^^ note on why the memset() is there:
-  // p7_oprofile_GetFwdEmissionsScoreArray() appears problematic.
-  // iss #320 detected use of uninitialized memory and I'm not surprised; probably not the only thing wrong.
-  // the memset() above is added to patch iss #320, but I expect other more subtle problems. See note on the function.
-  // [SRE 2024/0107-h3-iss320]
-
   msv_windowlist.windows = NULL;
-  vit_windowlist.windows = NULL;
   p7_hmmwindow_init(&msv_windowlist);
 
   p7_omx_GrowTo(pli->oxf, om->M, 0, om->max_length);    /* expand the one-row omx if needed */
@@ -1656,172 +1836,80 @@ p7_Pipeline_LongTarget(P7_PIPELINE *pli, P7_OPROFILE *om, P7_SCOREDATA *data,
   else // compare directly to sequence
     p7_SSVFilter_longtarget(sq->dsq, sq->n, om, pli->oxf, data, bg, pli->F1, &msv_windowlist);
 
+  status = longtarget_windows(pli, om, data, bg, hitlist, seqidx, sq, complementarity, fmf, fm_cfg, &msv_windowlist);
 
-  /* convert hits to windows, merging neighboring windows
-   */
-  if ( msv_windowlist.count > 0 ) {
-
-    /* In scan mode, if it passes the MSV filter, read the rest of the profile */
-    if (!fmf && pli->hfp)
-      {
-	if (om->base_w == 0 &&  om->scale_w == 0) { // we haven't already read this hmm (if we're on the second strand, we would've)
-	  p7_oprofile_ReadRest(pli->hfp, om);
-	  if ((status = p7_pli_NewModelThresholds(pli, om)) != eslOK) goto ERROR;
-	}
-      }
-
-    p7_oprofile_GetFwdEmissionArray(om, bg, pli_tmp->fwd_emissions_arr);
-
-    if (data->prefix_lengths == NULL)  // otherwise, already filled in
-      p7_hmm_ScoreDataComputeRest(om, data);
-
-    p7_pli_ExtendAndMergeWindows (om, data, &msv_windowlist, 0);
-
-    /*  If using FM, it's possible for a seed we just created to span more than one segment
-     *  in the target. Check for this, and resolve it, by trimming an over-extended
-     *  segment, and tacking it on as a new window (to be dealt with in a later pass)
-     */
-    if (fmf) {
-      for (i=0; i<msv_windowlist.count; i++) {
-        int again = TRUE;
-        window = msv_windowlist.windows + i;
-
-        while (again) {
-          uint32_t seg_id;
-          uint64_t seg_pos;
-          again = FALSE;
-
-          status = fm_getOriginalPosition (fmf, fm_cfg->meta, 0, window->length, window->complementarity, window->fm_n, &seg_id, &seg_pos);
-
-          if (status == eslERANGE) {
-            int overext;
-            int use_length;
-            int is_compl = (window->complementarity == p7_COMPLEMENT);
-
-            overext = (seg_pos + window->length) - (fm_cfg->meta->seq_data[ seg_id ].target_start + fm_cfg->meta->seq_data[ seg_id ].length - 1) ;
-
-            use_length = window->length - overext + 1;
-
-            if (use_length >= 8 && window->length >= 8) { // if both halves are kinda long, split the first half off as a new window
-              p7_hmmwindow_new(&msv_windowlist, seg_id + (is_compl?-1:1), window->n, window->fm_n, window->k+use_length-1, use_length, window->score, window->complementarity, fm_cfg->meta->seq_data[seg_id].length);
-              window = msv_windowlist.windows + i; // it may have moved due a a realloc
-              window->k      +=  use_length;
-              window->length  =  overext;
-              again         = TRUE;
-            } else if (window->length >= 8) { //if just the right half is long enough, shift numbers over
-              window->k      +=  use_length;
-              window->length  =  overext;
-            } else { //just limit the length of the left half
-              window->length  =  use_length;
-            }
-
-          }
-        }
-      }
-    }
-
-  /* Pass each remaining window on to the remaining pipeline */
-    p7_hmmwindow_init(&vit_windowlist);
-    pli_tmp->tmpseq = esl_sq_CreateDigital(om->abc);
-    if (!fmf )
-      free (pli_tmp->tmpseq->dsq);  //this ESL_SQ object is just a container that'll point to a series of other DSQs, so free the one we just created inside the larger SQ object
-
+  if (msv_windowlist.windows != NULL) free (msv_windowlist.windows);
+  return status;
+}
 
-    for (i=0; i<msv_windowlist.count; i++){
-      window =  msv_windowlist.windows + i ;
 
-      if (fmf) {
-        fm_convertRange2DSQ( fmf, fm_cfg->meta, window->fm_n, window->length, window->complementarity, pli_tmp->tmpseq, TRUE );
-        subseq = pli_tmp->tmpseq->dsq;
-      } else {
-        subseq = sq->dsq + window->n - 1;
-      }
+/* Function:  p7_Pipeline_LongTargetBatch()
+ * Synopsis:  FM-index pipeline for a batch of queries against one block.
+ *
+ * Purpose:   Run <p7_Pipeline_LongTarget()> on FM-index block
+ *            <fmf>,<fmb> for each of the <nq> queries <om[q]>, with
+ *            their own pipeline <pli[q]>, scoring data <data[q]>,
+ *            background <bg[q]> and hit list <hitlist[q]>. Query
+ *            <q>'s seed score threshold is scaled by
+ *            <sc_thresh_ratio[q]>, instead of by
+ *            <fm_cfg->sc_thresh_ratio>.
+ *
+ *            The FM seed search for the whole batch is done by one
+ *            <p7_SSVFM_longlarget_batch()> call, which walks the
+ *            FM-index once however many queries there are. The
+ *            windows each query finds then go through the rest of its
+ *            own pipeline, exactly as in <p7_Pipeline_LongTarget()>.
+ *            Every query sees the same windows and hits as it would
+ *            if searched alone.
+ *
+ *            The seed search uses the strands and random number
+ *            generator of <pli[0]>, and the background <bg[0]>;
+ *            every pipeline in a batch must be configured with the
+ *            same strands.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure. Other errors as for
+ *            <p7_Pipeline_LongTarget()>.
+ */
+int
+p7_Pipeline_LongTargetBatch(P7_PIPELINE **pli, P7_OPROFILE **om, P7_SCOREDATA **data,
+                            P7_BG **bg, P7_TOPHITS **hitlist, const float *sc_thresh_ratio, int nq,
+                            const FM_DATA *fmf, const FM_DATA *fmb, FM_CFG *fm_cfg)
+{
+  P7_HMM_WINDOWLIST *msv_windowlist = NULL;
+  int                q;
+  int                status;
 
-      p7_bg_SetLength(bg, window->length);
-      p7_bg_NullOne  (bg, subseq, window->length, &nullsc);
-
-      /* SRE: Unclear what TJW's intent here is.
-       * He was calling p7_bg_FilterScore() without checking pli->do_biasfilter,
-       * which is a bug: p7_pli_NewModel only initializes the filter HMM when
-       * pli->do_biasfilter is TRUE, so memory sanitizers will see uninitialized
-       * memory being used. But he doesn't use bias_filtersc for anything,
-       * so it's a no-op anyway. I'm going to:
-       *    1. fix the code by checking for pli->do_biasfilter
-       *    2. then comment it out because he isn't using the result anyway.
-       */
-      // if (pli->do_biasfilter)
-      //   p7_bg_FilterScore(bg, subseq, window->length, &bias_filtersc);
-
-      // Compute standard MSV to ensure that bias doesn't overcome SSV score when MSV
-      // would have survived it
-      p7_oprofile_ReconfigMSVLength(om, window->length);
-      p7_MSVFilter(subseq, window->length, om, pli->oxf, &usc);
-      P = esl_gumbel_surv( (usc-nullsc)/eslCONST_LOG2,  om->evparam[p7_MMU],  om->evparam[p7_MLAMBDA]);
-
-      if (P > pli->F1 ) continue;
-      pli->pos_past_msv += window->length;
-
-      if (fmf) {
-        seq_data = fm_cfg->meta->seq_data[window->id];
-        seq_start =  seq_data.target_start;
-        if (window->complementarity == p7_COMPLEMENT)
-          seq_start += seq_data.length - 2;
-      }
+  if (fmf->N == 0) return eslOK;
 
-      status = p7_pli_postSSV_LongTarget(pli, om, bg, hitlist, data,
-            (fmf != NULL ? seq_data.target_id     : seqidx),
-            window->n, window->length, subseq,
-            (fmf != NULL ? seq_start       : sq->start),
-            (fmf != NULL ? seq_data.name   : sq->name),
-            (fmf != NULL ? seq_data.source : sq->source),
-            (fmf != NULL ? seq_data.acc    : sq->acc),
-            (fmf != NULL ? seq_data.desc   : sq->desc),
-            (fmf != NULL ? seq_data.length : -1),
-            nullsc,
-            usc,
-            (fmf != NULL ? window->complementarity : complementarity),
-            &vit_windowlist,
-            pli_tmp
-        );
-        if (status != eslOK) goto ERROR;
+  ESL_ALLOC(msv_windowlist, sizeof(P7_HMM_WINDOWLIST) * nq);
+  for (q = 0; q < nq; q++) msv_windowlist[q].windows = NULL;
 
+  for (q = 0; q < nq; q++)
+    {
+      if ((status = p7_hmmwindow_init(&(msv_windowlist[q]))) != eslOK) goto ERROR;
+      p7_omx_GrowTo(pli[q]->oxf, om[q]->M, 0, om[q]->max_length);
     }
 
-    if (fmf)  free (pli_tmp->tmpseq->dsq);
-
-    pli_tmp->tmpseq->dsq = NULL;  //it's a pointer to a dsq object belonging to another sequence
-
-    esl_sq_Destroy(pli_tmp->tmpseq);
-    free (vit_windowlist.windows);
-  }
-
-  if (msv_windowlist.windows != NULL) free (msv_windowlist.windows);
+  /* The seed search, for all queries in one pass */
+  status = p7_SSVFM_longlarget_batch(om, (const P7_SCOREDATA **) data, sc_thresh_ratio, nq, 2.0, bg[0], pli[0]->F1,
+                                     fmf, fmb, fm_cfg, pli[0]->strands, pli[0]->r, msv_windowlist);
+  if (status != eslEOF) goto ERROR;
 
-  if (pli_tmp != NULL) {
-    if (pli_tmp->bg != NULL)     p7_bg_Destroy(pli_tmp->bg);
-    if (pli_tmp->om != NULL)     p7_oprofile_Destroy(pli_tmp->om);
-    if (pli_tmp->scores != NULL)        free (pli_tmp->scores);
-    if (pli_tmp->fwd_emissions_arr != NULL) free (pli_tmp->fwd_emissions_arr);
-    free(pli_tmp);
-  }
+  for (q = 0; q < nq; q++)
+    if ((status = longtarget_windows(pli[q], om[q], data[q], bg[q], hitlist[q], -1, NULL, -1, fmf, fm_cfg, &(msv_windowlist[q]))) != eslOK) goto ERROR;
 
+  for (q = 0; q < nq; q++) free(msv_windowlist[q].windows);
+  free(msv_windowlist);
   return eslOK;
 
-ERROR:
-  if (msv_windowlist.windows != NULL) free (msv_windowlist.windows);
-  if (vit_windowlist.windows != NULL) free (vit_windowlist.windows);
-
-  if (pli_tmp != NULL) {
-    if (pli_tmp->tmpseq != NULL) esl_sq_Destroy(pli_tmp->tmpseq);
-    if (pli_tmp->bg != NULL)     p7_bg_Destroy(pli_tmp->bg);
-    if (pli_tmp->om != NULL)     p7_oprofile_Destroy(pli_tmp->om);
-    if (pli_tmp->scores != NULL)        free (pli_tmp->scores);
-    if (pli_tmp->fwd_emissions_arr != NULL) free (pli_tmp->fwd_emissions_arr);
-    free(pli_tmp);
+ ERROR:
+  if (msv_windowlist) {
+    for (q = 0; q < nq; q++) if (msv_windowlist[q].windows) free(msv_windowlist[q].windows);
+    free(msv_windowlist);
   }
-
   return status;
-
 }
 
 
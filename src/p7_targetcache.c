@@ -0,0 +1,394 @@
+/* P7_TARGETCACHE: a target sequence database held in memory.
+ *
+ * hmmsearch --tcache reads and digitizes the target database once,
+ * into a P7_TARGETCACHE, and then feeds every query from memory
+ * instead of rewinding and re-parsing the sequence file. Residues of
+ * all sequences are packed back to back in one buffer, and their
+ * names, accessions and descriptions in another. Sequences are handed
+ * out by copying into an ESL_SQ (or an ESL_SQ_BLOCK of them), so the
+ * search code downstream sees the same objects it gets from a file.
+ *
+ * Contents:
+ *    1. The P7_TARGETCACHE object.
+ *    2. Unit tests.
+ *    3. Test driver.
+ */
+#include <p7_config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "easel.h"
+#include "esl_alphabet.h"
+#include "esl_sq.h"
+#include "esl_sqio.h"
+
+#include "hmmer.h"
+
+static int targetcache_Add(P7_TARGETCACHE *cache, const ESL_SQ *sq);
+
+/*****************************************************************
+ * 1. The P7_TARGETCACHE object.
+ *****************************************************************/
+
+/* Function:  p7_targetcache_Read()
+ * Synopsis:  Read a target sequence database into memory.
+ *
+ * Purpose:   Read sequences from the open digital-mode sequence file
+ *            <sqfp>, starting at its current position, until the end
+ *            of the file or until <max_nseq> sequences have been read
+ *            (<max_nseq> = -1 means no limit). Store them in a new
+ *            <P7_TARGETCACHE>, returned in <*ret_cache>.
+ *
+ *            The cache refers to <sqfp>'s alphabet, which must stay
+ *            valid as long as the cache is used.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ *            <eslEFORMAT> on a parse error; <esl_sqfile_GetErrorBuf(sqfp)>
+ *            has the message. <*ret_cache> is <NULL>.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ *            <eslEINVAL> if <sqfp> isn't in digital mode.
+ *            <*ret_cache> is <NULL>.
+ */
+int
+p7_targetcache_Read(ESL_SQFILE *sqfp, int64_t max_nseq, P7_TARGETCACHE **ret_cache)
+{
+  P7_TARGETCACHE *cache  = NULL;
+  ESL_SQ         *sq     = NULL;
+  int             status = eslOK;
+
+  *ret_cache = NULL;
+  if (sqfp->abc == NULL) ESL_EXCEPTION(eslEINVAL, "sequence file must be in digital mode");
+
+  ESL_ALLOC(cache, sizeof(P7_TARGETCACHE));
+  cache->abc      = sqfp->abc;
+  cache->residues = NULL;
+  cache->text     = NULL;
+  cache->seq      = NULL;
+  cache->nres     = cache->ntext  = cache->nseq   = 0;
+  cache->ralloc   = 1 << 20;
+  cache->talloc   = 1 << 16;
+  cache->salloc   = 1024;
+  ESL_ALLOC(cache->residues, sizeof(ESL_DSQ)            * cache->ralloc);
+  ESL_ALLOC(cache->text,     sizeof(char)               * cache->talloc);
+  ESL_ALLOC(cache->seq,      sizeof(P7_TARGETCACHE_SEQ) * cache->salloc);
+
+  if ((sq = esl_sq_CreateDigital(sqfp->abc)) == NULL) { status = eslEMEM; goto ERROR; }
+
+  while ((max_nseq == -1 || cache->nseq < max_nseq) && (status = esl_sqio_Read(sqfp, sq)) == eslOK)
+    {
+      if ((status = targetcache_Add(cache, sq)) != eslOK) goto ERROR;
+      esl_sq_Reuse(sq);
+    }
+  if (status == eslEOF) status = eslOK;
+  if (status != eslOK)  goto ERROR;
+
+  esl_sq_Destroy(sq);
+  *ret_cache = cache;
+  return eslOK;
+
+ ERROR:
+  esl_sq_Destroy(sq);
+  p7_targetcache_Destroy(cache);
+  return status;
+}
+
+/* targetcache_Add()
+ *
+ * Append digital sequence <sq>, with its sentinels, to <cache>,
+ * doubling the buffers as needed.
+ */
+static int
+targetcache_Add(P7_TARGETCACHE *cache, const ESL_SQ *sq)
+{
+  int64_t nname = strlen(sq->name) + 1;
+  int64_t nacc  = strlen(sq->acc)  + 1;
+  int64_t ndesc = strlen(sq->desc) + 1;
+  int     status;
+
+  while (cache->nres + sq->n + 2 > cache->ralloc) {
+    ESL_REALLOC(cache->residues, sizeof(ESL_DSQ) * cache->ralloc * 2);
+    cache->ralloc *= 2;
+  }
+  while (cache->ntext + nname + nacc + ndesc > cache->talloc) {
+    ESL_REALLOC(cache->text, sizeof(char) * cache->talloc * 2);
+    cache->talloc *= 2;
+  }
+  if (cache->nseq == cache->salloc) {
+    ESL_REALLOC(cache->seq, sizeof(P7_TARGETCACHE_SEQ) * cache->salloc * 2);
+    cache->salloc *= 2;
+  }
+
+  cache->seq[cache->nseq].roff = cache->nres;
+  cache->seq[cache->nseq].n    = sq->n;
+  cache->seq[cache->nseq].toff = cache->ntext;
+  cache->nseq++;
+
+  memcpy(cache->residues + cache->nres, sq->dsq, sizeof(ESL_DSQ) * (sq->n + 2));  /* dsq[0..n+1], sentinels included */
+  cache->nres += sq->n + 2;
+
+  memcpy(cache->text + cache->ntext, sq->name, nname);  cache->ntext += nname;
+  memcpy(cache->text + cache->ntext, sq->acc,  nacc);   cache->ntext += nacc;
+  memcpy(cache->text + cache->ntext, sq->desc, ndesc);  cache->ntext += ndesc;
+  return eslOK;
+
+ ERROR:
+  return status;
+}
+
+
+/* Function:  p7_targetcache_GetSeq()
+ * Synopsis:  Copy one cached sequence into an <ESL_SQ>.
+ *
+ * Purpose:   Set digital sequence <sq> to sequence <idx> (0..nseq-1)
+ *            of <cache>: its residues, name, accession and
+ *            description. <sq> must be in the cache's alphabet and
+ *            is typically reused from one call to the next; its
+ *            <idx> is set to <idx>.
+ *
+ * Returns:   <eslOK> on success.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_targetcache_GetSeq(const P7_TARGETCACHE *cache, int64_t idx, ESL_SQ *sq)
+{
+  const P7_TARGETCACHE_SEQ *s    = cache->seq + idx;
+  const char               *name = cache->text + s->toff;
+  const char               *acc  = name + strlen(name) + 1;
+  const char               *desc = acc  + strlen(acc)  + 1;
+  int                       status;
+
+  if ((status = esl_sq_GrowTo(sq, s->n))       != eslOK) return status;
+  memcpy(sq->dsq, cache->residues + s->roff, sizeof(ESL_DSQ) * (s->n + 2));
+
+  if ((status = esl_sq_SetName     (sq, name)) != eslOK) return status;
+  if ((status = esl_sq_SetAccession(sq, acc))  != eslOK) return status;
+  if ((status = esl_sq_SetDesc     (sq, desc)) != eslOK) return status;
+
+  sq->n     = s->n;
+  sq->start = 1;
+  sq->end   = s->n;
+  sq->C     = 0;
+  sq->W     = s->n;
+  sq->L     = s->n;
+  sq->idx   = idx;
+  return eslOK;
+}
+
+
+/* Function:  p7_targetcache_GetBlock()
+ * Synopsis:  Fill a sequence block from the cache.
+ *
+ * Purpose:   Copy up to <block->listSize> sequences of <cache> into
+ *            <block>, starting at sequence <*pos>, and advance <*pos>
+ *            past them. This is the cached counterpart of
+ *            <esl_sqio_ReadBlock()>, for the same worker threads.
+ *
+ * Returns:   <eslOK> if at least one sequence was copied;
+ *            <eslEOF> if <*pos> was already past the last sequence,
+ *            with <block->count> = 0.
+ *
+ * Throws:    <eslEMEM> on allocation failure.
+ */
+int
+p7_targetcache_GetBlock(const P7_TARGETCACHE *cache, int64_t *pos, ESL_SQ_BLOCK *block)
+{
+  int status;
+
+  block->count        = 0;
+  block->first_seqidx = *pos;
+  block->complete     = TRUE;
+  while (block->count < block->listSize && *pos < cache->nseq)
+    {
+      if ((status = p7_targetcache_GetSeq(cache, *pos, block->list + block->count)) != eslOK) return status;
+      block->count++;
+      (*pos)++;
+    }
+  return (block->count > 0 ? eslOK : eslEOF);
+}
+
+
+/* Function:  p7_targetcache_Sizeof()
+ * Synopsis:  Return the allocated size of a cache, in bytes.
+ */
+size_t
+p7_targetcache_Sizeof(const P7_TARGETCACHE *cache)
+{
+  size_t n = sizeof(P7_TARGETCACHE);
+
+  n += sizeof(ESL_DSQ)            * cache->ralloc;
+  n += sizeof(char)               * cache->talloc;
+  n += sizeof(P7_TARGETCACHE_SEQ) * cache->salloc;
+  return n;
+}
+
+
+/* Function:  p7_targetcache_Destroy()
+ * Synopsis:  Free a <P7_TARGETCACHE>.
+ */
+void
+p7_targetcache_Destroy(P7_TARGETCACHE *cache)
+{
+  if (cache)
+    {
+      if (cache->residues) free(cache->residues);
+      if (cache->text)     free(cache->text);
+      if (cache->seq)      free(cache->seq);
+      free(cache);
+    }
+}
+/*------------------ end, P7_TARGETCACHE object -----------------*/
+
+
+
+/*****************************************************************
+ * 2. Unit tests.
+ *****************************************************************/
+#ifdef p7TARGETCACHE_TESTDRIVE
+#include "esl_random.h"
+#include "esl_randomseq.h"
+#include "esl_vectorops.h"
+
+/* write_testseqs()
+ * Write <nseq> random sequences of length 1..<maxL> to an open FASTA
+ * file, and return them in <*ret_sq>. Every third one has a description.
+ */
+static void
+write_testseqs(ESL_RANDOMNESS *rng, const ESL_ALPHABET *abc, FILE *fp, int nseq, int maxL, ESL_SQ ***ret_sq)
+{
+  char     msg[] = "p7_targetcache write_testseqs failed";
+  ESL_SQ **sq    = malloc(sizeof(ESL_SQ *) * nseq);
+  float    f[64];
+  char     name[32];
+  int      i, L;
+
+  if (sq == NULL) esl_fatal(msg);
+  esl_vec_FSet(f, abc->K, 1.0 / (float) abc->K);
+  for (i = 0; i < nseq; i++)
+    {
+      L = 1 + esl_rnd_Roll(rng, maxL);
+      if ((sq[i] = esl_sq_CreateDigital(abc))                  == NULL)  esl_fatal(msg);
+      if (esl_sq_GrowTo(sq[i], L)                              != eslOK) esl_fatal(msg);
+      if (esl_rsq_xfIID(rng, f, abc->K, L, sq[i]->dsq)         != eslOK) esl_fatal(msg);
+      sq[i]->n = L;
+      snprintf(name, 32, "seq%d", i);
+      if (esl_sq_SetName(sq[i], name)                          != eslOK) esl_fatal(msg);
+      if (i % 3 == 0 && esl_sq_SetDesc(sq[i], "a description") != eslOK) esl_fatal(msg);
+      if (esl_sqio_Write(fp, sq[i], eslSQFILE_FASTA, FALSE)    != eslOK) esl_fatal(msg);
+    }
+  *ret_sq = sq;
+}
+
+/* utest_readback()
+ * Sequences read into a cache come back out of it unchanged, one by
+ * one and in blocks, and <max_nseq> limits how many are read.
+ */
+static void
+utest_readback(ESL_RANDOMNESS *rng, const ESL_ALPHABET *abc, int nseq, int maxL)
+{
+  char            msg[]  = "p7_targetcache readback unit test failed";
+  char            tmpfile[32] = "p7tcacheXXXXXX";
+  FILE           *fp     = NULL;
+  ESL_SQ        **sq     = NULL;
+  ESL_SQFILE     *sqfp   = NULL;
+  P7_TARGETCACHE *cache  = NULL;
+  ESL_SQ         *sq2    = esl_sq_CreateDigital(abc);
+  ESL_SQ_BLOCK   *block  = esl_sq_CreateDigitalBlock(7, abc);
+  int64_t         pos    = 0;
+  int             i, j;
+
+  if (esl_tmpfile_named(tmpfile, &fp) != eslOK) esl_fatal(msg);
+  write_testseqs(rng, abc, fp, nseq, maxL, &sq);
+  fclose(fp);
+
+  if (esl_sqfile_OpenDigital(abc, tmpfile, eslSQFILE_FASTA, NULL, &sqfp) != eslOK) esl_fatal(msg);
+  if (p7_targetcache_Read(sqfp, -1, &cache)                             != eslOK) esl_fatal(msg);
+  if (cache->nseq != nseq)                                                         esl_fatal(msg);
+  if (p7_targetcache_Sizeof(cache) < (size_t) cache->nres)                         esl_fatal(msg);
+
+  for (i = nseq-1; i >= 0; i--)   /* out of order, reusing one <sq2> */
+    {
+      if (p7_targetcache_GetSeq(cache, i, sq2)                        != eslOK) esl_fatal(msg);
+      if (sq2->n != sq[i]->n || sq2->idx != i)                                  esl_fatal(msg);
+      if (memcmp(sq2->dsq, sq[i]->dsq, sizeof(ESL_DSQ) * (sq2->n + 2)) != 0)    esl_fatal(msg);
+      if (strcmp(sq2->name, sq[i]->name) != 0 || strcmp(sq2->desc, sq[i]->desc) != 0) esl_fatal(msg);
+      esl_sq_Reuse(sq2);
+    }
+
+  for (i = 0; p7_targetcache_GetBlock(cache, &pos, block) == eslOK; )
+    {
+      if (block->first_seqidx != i) esl_fatal(msg);
+      for (j = 0; j < block->count; j++, i++)
+        {
+          if (block->list[j].n != sq[i]->n || strcmp(block->list[j].name, sq[i]->name) != 0) esl_fatal(msg);
+          if (memcmp(block->list[j].dsq + 1, sq[i]->dsq + 1, sq[i]->n) != 0)                 esl_fatal(msg);
+          esl_sq_Reuse(block->list + j);
+        }
+    }
+  if (i != nseq || block->count != 0 || pos != nseq) esl_fatal(msg);
+  p7_targetcache_Destroy(cache);
+
+  /* a limited read, from the middle of the file */
+  if (esl_sqfile_Position(sqfp, 0)                   != eslOK) esl_fatal(msg);
+  if (esl_sqio_Read(sqfp, sq2)                       != eslOK) esl_fatal(msg);
+  if (p7_targetcache_Read(sqfp, nseq / 2, &cache)    != eslOK) esl_fatal(msg);
+  if (cache->nseq != ESL_MIN(nseq / 2, nseq - 1))              esl_fatal(msg);
+  if (cache->nseq > 0) {
+    if (p7_targetcache_GetSeq(cache, 0, sq2)         != eslOK) esl_fatal(msg);
+    if (strcmp(sq2->name, sq[1]->name) != 0)                   esl_fatal(msg);
+  }
+
+  for (i = 0; i < nseq; i++) esl_sq_Destroy(sq[i]);
+  free(sq);
+  p7_targetcache_Destroy(cache);
+  esl_sqfile_Close(sqfp);
+  esl_sq_DestroyBlock(block);
+  esl_sq_Destroy(sq2);
+  remove(tmpfile);
+}
+#endif /*p7TARGETCACHE_TESTDRIVE*/
+/*---------------------- end, unit tests ------------------------*/
+
+
+
+/*****************************************************************
+ * 3. Test driver.
+ *****************************************************************/
+#ifdef p7TARGETCACHE_TESTDRIVE
+#include "esl_getopts.h"
+
+static ESL_OPTIONS options[] = {
+   /* name  type         default  env   range togs  reqs  incomp  help                docgrp */
+  {"-h",  eslARG_NONE,    FALSE, NULL, NULL, NULL, NULL, NULL, "show help and usage",                            0},
+  {"-s",  eslARG_INT,       "0", NULL, NULL, NULL, NULL, NULL, "set random number seed to <n>",                  0},
+  {"-v",  eslARG_NONE,    FALSE, NULL, NULL, NULL, NULL, NULL, "show verbose commentary/output",                 0},
+  { 0,0,0,0,0,0,0,0,0,0},
+};
+static char usage[]  = "[-options]";
+static char banner[] = "test driver for P7_TARGETCACHE";
+
+int
+main(int argc, char **argv)
+{
+  ESL_GETOPTS    *go         = esl_getopts_CreateDefaultApp(options, 0, argc, argv, banner, usage);
+  ESL_RANDOMNESS *rng        = esl_randomness_CreateFast(esl_opt_GetInteger(go, "-s"));
+  ESL_ALPHABET   *abc        = esl_alphabet_Create(eslAMINO);
+  int             be_verbose = esl_opt_GetBoolean(go, "-v");
+
+  if (be_verbose) printf("p7_targetcache unit test: rng seed %" PRIu32 "\n", esl_randomness_GetSeed(rng));
+
+  utest_readback(rng, abc, 100, 300);
+  utest_readback(rng, abc,   1,  10);
+  utest_readback(rng, abc,  50,   1);
+
+  esl_alphabet_Destroy(abc);
+  esl_randomness_Destroy(rng);
+  esl_getopts_Destroy(go);
+  fprintf(stderr, "#  status = ok\n");
+  return 0;
+}
+#endif /*p7TARGETCACHE_TESTDRIVE*/
+/*--------------------- end, test driver ------------------------*/
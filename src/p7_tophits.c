@@ -308,13 +308,19 @@ p7_tophits_Add(P7_TOPHITS *h,
   return eslOK;
 }
 
-/* hit_sorter(): qsort's pawn, below */
-static int
-hit_sorter_by_sortkey(const void *vh1, const void *vh2)
+/* Function:  p7_tophits_CompareBySortkey()
+ * Synopsis:  Compare two hits in sortkey order.
+ *
+ * Purpose:   Returns <0 if hit <h1> sorts before <h2> in
+ *            <p7_tophits_SortBySortkey()>'s order (higher sortkey
+ *            first, then by name, strand and position), >0 if it sorts
+ *            after, and 0 if they are tied. Lets callers that merge
+ *            sorted hit lists themselves keep the same order.
+ */
+int
+p7_tophits_CompareBySortkey(const P7_HIT *h1, const P7_HIT *h2)
 {
-  P7_HIT *h1 = *((P7_HIT **) vh1);  /* don't ask. don't change. Don't Panic. */
-  P7_HIT *h2 = *((P7_HIT **) vh2);
-  int     c;
+  int c;
 
   if      (h1->sortkey < h2->sortkey) return  1;
   else if (h1->sortkey > h2->sortkey) return -1;
@@ -333,6 +339,16 @@ hit_sorter_by_sortkey(const void *vh1, const void *vh2)
   }
 }
 
+/* hit_sorter(): qsort's pawn, below */
+static int
+hit_sorter_by_sortkey(const void *vh1, const void *vh2)
+{
+  P7_HIT *h1 = *((P7_HIT **) vh1);  /* don't ask. don't change. Don't Panic. */
+  P7_HIT *h2 = *((P7_HIT **) vh2);
+
+  return p7_tophits_CompareBySortkey(h1, h2);
+}
+
 /* used before duplicate hit removal in an nhmmer longtarget pipeline: */
 static int
 hit_sorter_by_seqidx_aliposition(const void *vh1, const void *vh2)
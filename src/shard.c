@@ -1,5 +1,9 @@
 //! \file Functions that implement database sharding
 #include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
 
 #include "easel.h"
 #include "esl_dsqdata.h"
@@ -22,6 +26,8 @@ P7_SHARD *p7_shard_Create_hmmfile(char *filename, uint32_t num_shards, uint32_t
   // allocate the base shard object
   P7_SHARD *the_shard;
   ESL_ALLOC(the_shard, sizeof(P7_SHARD));
+  the_shard->map = NULL; // data is read into the heap, not mapped
+  the_shard->map_size = 0;
 
   if(strcmp(filename, "_")){
     esl_FileTail(filename, FALSE, &(the_shard->sourcename)); // Get the name of the shard's source from the input file name
@@ -32,6 +38,7 @@ P7_SHARD *p7_shard_Create_hmmfile(char *filename, uint32_t num_shards, uint32_t
   }
 
   the_shard->data_type = HMM; // Only one possible data type for an HMM file
+  the_shard->total_length = 0; // sum of the model lengths, accumulated as we read the HMMs
 
   uint64_t num_hmms= 0; // Number of HMMs we've put in the database
   uint64_t hmms_in_file = 0; // Number of HMMs we've seen in the file
@@ -104,6 +111,7 @@ P7_SHARD *p7_shard_Create_hmmfile(char *filename, uint32_t num_shards, uint32_t
       the_shard->directory[num_hmms].index = num_hmms;
       the_shard->directory[num_hmms].contents_offset = contents_offset;
       the_shard->directory[num_hmms].descriptor_offset = descriptors_offset;
+      the_shard->total_length += hmm->M;
 
       // copying multi-level data structures into regions of memory that we might realloc is really hard, so instead
       // we store pointers to each HMM's oprofile and profile in the contents and descriptor structure, respectively
@@ -166,6 +174,8 @@ P7_SHARD *p7_shard_Create_sqdata(char *filename, uint32_t num_shards, uint32_t m
   // allocate the base shard object
   P7_SHARD *the_shard;
   ESL_ALLOC(the_shard, sizeof(P7_SHARD));
+  the_shard->map = NULL; // data is read into the heap, not mapped
+  the_shard->map_size = 0;
  if(strcmp(filename, "_")){
     esl_FileTail(filename, FALSE, &(the_shard->sourcename)); // Get the name of the shard's source from the input file name
   }
@@ -265,6 +275,247 @@ P7_SHARD *p7_shard_Create_sqdata(char *filename, uint32_t num_shards, uint32_t m
 
 
 
+// p7_shard_Open_prepared
+/*! \brief Maps a prepared shard file into memory and builds a shard of sequence data from it.
+ *  \details The file is mapped read-only and shared, so that all of the processes on a machine that load the same database use one copy of it
+ *  in the page cache.  The shard's ESL_SQ objects point into the mapped file rather than holding copies of the sequences, so this function 
+ *  only has to build the shard's directory and one ESL_SQ shell per sequence.  The objects in the shard are those whose ID modulo num_shards 
+ *  is my_shard, just as in p7_shard_Create_sqdata().
+ *  \param [in] filename The name of the prepared shard file, as written by p7_shard_Write_prepared().
+ *  \param [in] num_shards The number of shards the database will be divided into.
+ *  \param [in] my_shard Which shard of the database should be generated? Must be between 0 and num_shards.
+ *  \param [in] masternode Is this shard being loaded into the master node.  The master node only needs the directory, so its shard has no contents.
+ *  \returns The new shard.  Calls p7_Fail() to exit the program if unable to complete successfully.
+ */
+P7_SHARD *p7_shard_Open_prepared(char *filename, uint32_t num_shards, uint32_t my_shard, int masternode){
+  int status;
+  int fd;
+  struct stat file_stats;
+  P7_SHARD_PREPARED_HEADER *header;
+  P7_SHARD_DIRECTORY_ENTRY *file_directory;
+  char *contents_base, *descriptors_base;
+  ESL_SQ *sequences = NULL;
+  uint64_t i, my_sequences;
+
+  // allocate the base shard object
+  P7_SHARD *the_shard;
+  ESL_ALLOC(the_shard, sizeof(P7_SHARD));
+
+  // map the file
+  if((fd = open(filename, O_RDONLY)) == -1){
+    p7_Fail("Unable to open prepared shard file %s\n", filename);
+  }
+  if(fstat(fd, &file_stats) == -1){
+    p7_Fail("Unable to get the size of prepared shard file %s\n", filename);
+  }
+  if(file_stats.st_size < sizeof(P7_SHARD_PREPARED_HEADER)){
+    p7_Fail("Prepared shard file %s is too small to hold a header\n", filename);
+  }
+  the_shard->map_size = file_stats.st_size;
+  the_shard->map = mmap(NULL, the_shard->map_size, PROT_READ, MAP_SHARED, fd, 0);
+  if(the_shard->map == MAP_FAILED){
+    p7_Fail("Unable to map prepared shard file %s into memory\n", filename);
+  }
+  close(fd); // the mapping stays valid after the file is closed
+
+  // check the header
+  header = (P7_SHARD_PREPARED_HEADER *) the_shard->map;
+  if(strncmp(header->magic, p7_SHARD_PREPARED_MAGIC, 8)){
+    p7_Fail("%s is not a prepared shard file\n", filename);
+  }
+  if(header->byte_order != 1){
+    p7_Fail("Prepared shard file %s was written on a machine with a different byte order\n", filename);
+  }
+  if(header->version != p7_SHARD_PREPARED_VERSION){
+    p7_Fail("Prepared shard file %s has format version %u, expected version %u\n", filename, header->version, p7_SHARD_PREPARED_VERSION);
+  }
+  if(header->file_size != the_shard->map_size || header->sourcename_offset >= header->file_size){
+    p7_Fail("Prepared shard file %s is truncated or corrupt\n", filename);
+  }
+  if(header->data_type != AMINO){
+    p7_Fail("Prepared shard file %s holds an unsupported type of data\n", filename);
+  }
+
+  file_directory = (P7_SHARD_DIRECTORY_ENTRY *) ((char *) the_shard->map + header->directory_offset);
+  contents_base = (char *) the_shard->map + header->contents_offset;
+  descriptors_base = (char *) the_shard->map + header->descriptors_offset;
+
+  if((the_shard->sourcename = strdup((char *) the_shard->map + header->sourcename_offset)) == NULL){
+    goto ERROR;
+  }
+  the_shard->data_type = header->data_type;
+  the_shard->abc = esl_alphabet_Create(header->alphabet_type);
+  the_shard->contents = NULL;
+  the_shard->descriptors = NULL;
+  the_shard->directory = NULL;
+  the_shard->total_length = 0;
+
+  // count the sequences that go in this shard
+  my_sequences = header->num_objects / num_shards;
+  if(my_shard < header->num_objects % num_shards){
+    my_sequences++;
+  }
+  the_shard->num_objects = my_sequences;
+
+  if(my_sequences > 0){ // Check for probably-never-happens case where database has fewer sequences than there are shards
+    ESL_ALLOC(the_shard->directory, (my_sequences * sizeof(P7_SHARD_DIRECTORY_ENTRY)));
+    if(!masternode){
+      ESL_ALLOC(the_shard->contents, my_sequences * sizeof(ESL_SQ *));
+      ESL_ALLOC(sequences, my_sequences * sizeof(ESL_SQ));
+      memset(sequences, 0, my_sequences * sizeof(ESL_SQ));
+      the_shard->descriptors = sequences; // the ESL_SQ shells, which we have to free when the shard is destroyed
+    }
+  }
+
+  for(i = 0; i < my_sequences; i++){
+    uint64_t file_index = (i * num_shards) + my_shard;
+    char    *record     = contents_base + file_directory[file_index].contents_offset;
+    int64_t  L;
+
+    memcpy(&L, record + sizeof(uint64_t), sizeof(int64_t)); // records are packed, so the length may not be 8-byte aligned
+
+    the_shard->directory[i].index = file_index;
+    the_shard->directory[i].contents_offset = i * sizeof(ESL_SQ *);
+    the_shard->directory[i].descriptor_offset = 0; // descriptors are folded into sequences
+    the_shard->total_length += L;
+
+    if(!masternode){
+      // Point the sequence's fields into the mapped file.  Nothing frees these fields, because the ESL_SQ objects are never passed to esl_sq_Destroy().
+      ESL_SQ *sq = &(sequences[i]);
+      sq->name   = descriptors_base + file_directory[file_index].descriptor_offset;
+      sq->acc    = sq->name + strlen(sq->name) + 1;
+      sq->desc   = sq->acc + strlen(sq->acc) + 1;
+      memcpy(&(sq->tax_id), sq->desc + strlen(sq->desc) + 1, sizeof(int32_t));
+      sq->dsq    = (ESL_DSQ *) (record + 2*sizeof(int64_t));
+      sq->n      = L;
+      sq->L      = L;
+      sq->start  = 1;
+      sq->end    = L;
+      sq->C      = 0;
+      sq->W      = L;
+      sq->idx    = file_index;
+      sq->roff   = -1;
+      sq->hoff   = -1;
+      sq->doff   = -1;
+      sq->eoff   = -1;
+      sq->source = the_shard->sourcename;
+      sq->abc    = the_shard->abc;
+      the_shard->contents[i] = sq;
+    }
+  }
+
+  if(masternode){
+    // The master node only needs the directory, so let go of the mapping
+    munmap(the_shard->map, the_shard->map_size);
+    the_shard->map = NULL;
+    the_shard->map_size = 0;
+    esl_alphabet_Destroy(the_shard->abc);
+    the_shard->abc = NULL;
+  }
+  return(the_shard);
+
+  // GOTO target used to catch error cases from ESL_ALLOC
+  ERROR:
+    p7_Fail("Unable to allocate memory in p7_shard_Open_prepared");
+    return NULL; //silence compiler warning on Mac
+}
+
+
+// p7_shard_Write_prepared
+/*! \brief Writes the sequences in a shard out as a prepared shard file that p7_shard_Open_prepared() can map into memory.
+ *  \details The shard should hold an entire database (i.e., have been created with num_shards = 1 on a worker node), so that the prepared file
+ *  can be divided into any number of shards when it is loaded.  See P7_SHARD_PREPARED_HEADER for the file format.
+ *  \param [in] the_shard The shard to be written.  Must be a sequence shard that holds contents.
+ *  \param [in] filename The name of the file to write.
+ *  \returns eslOK on success.  Calls p7_Fail() to exit the program if unable to complete successfully.
+ */
+int p7_shard_Write_prepared(P7_SHARD *the_shard, char *filename){
+  P7_SHARD_PREPARED_HEADER  header;
+  P7_SHARD_DIRECTORY_ENTRY  entry;
+  FILE    *fp;
+  ESL_SQ  *sq;
+  uint64_t contents_size = 0, descriptors_size = 0;
+  uint64_t i;
+  int64_t  L;
+  int32_t  taxid;
+  int      status;
+
+  if(the_shard->data_type != AMINO || (the_shard->contents == NULL && the_shard->num_objects > 0)){
+    p7_Fail("p7_shard_Write_prepared can only write sequence shards that hold contents\n");
+  }
+
+  // size the regions of the file
+  for(i = 0; i < the_shard->num_objects; i++){
+    sq = (ESL_SQ *) the_shard->contents[i];
+    contents_size    += 2*sizeof(int64_t) + sq->n + 2;
+    descriptors_size += strlen(sq->name) + strlen(sq->acc) + strlen(sq->desc) + 3 + sizeof(int32_t);
+  }
+
+  memset(&header, 0, sizeof(P7_SHARD_PREPARED_HEADER));
+  strncpy(header.magic, p7_SHARD_PREPARED_MAGIC, 8);
+  header.version            = p7_SHARD_PREPARED_VERSION;
+  header.byte_order         = 1;
+  header.data_type          = the_shard->data_type;
+  header.alphabet_type      = the_shard->abc->type;
+  header.num_objects        = the_shard->num_objects;
+  header.total_length       = the_shard->total_length;
+  header.directory_offset   = sizeof(P7_SHARD_PREPARED_HEADER);
+  header.contents_offset    = header.directory_offset + the_shard->num_objects * sizeof(P7_SHARD_DIRECTORY_ENTRY);
+  header.descriptors_offset = header.contents_offset + contents_size;
+  header.sourcename_offset  = header.descriptors_offset + descriptors_size;
+  header.file_size          = header.sourcename_offset + strlen(the_shard->sourcename) + 1;
+
+  if((fp = fopen(filename, "wb")) == NULL){
+    p7_Fail("Unable to open %s for writing\n", filename);
+  }
+  if(fwrite(&header, sizeof(P7_SHARD_PREPARED_HEADER), 1, fp) != 1) goto ERROR;
+
+  // directory
+  contents_size = descriptors_size = 0;
+  for(i = 0; i < the_shard->num_objects; i++){
+    sq = (ESL_SQ *) the_shard->contents[i];
+    entry.index             = the_shard->directory[i].index;
+    entry.contents_offset   = contents_size;
+    entry.descriptor_offset = descriptors_size;
+    if(fwrite(&entry, sizeof(P7_SHARD_DIRECTORY_ENTRY), 1, fp) != 1) goto ERROR;
+    contents_size    += 2*sizeof(int64_t) + sq->n + 2;
+    descriptors_size += strlen(sq->name) + strlen(sq->acc) + strlen(sq->desc) + 3 + sizeof(int32_t);
+  }
+
+  // contents
+  for(i = 0; i < the_shard->num_objects; i++){
+    sq = (ESL_SQ *) the_shard->contents[i];
+    L  = sq->n;
+    if(fwrite(&(the_shard->directory[i].index), sizeof(uint64_t), 1, fp) != 1) goto ERROR;
+    if(fwrite(&L, sizeof(int64_t), 1, fp) != 1)                                 goto ERROR;
+    if(fwrite(sq->dsq, sizeof(ESL_DSQ), L+2, fp) != L+2)                        goto ERROR; // +2 for the sentinels
+  }
+
+  // descriptors
+  for(i = 0; i < the_shard->num_objects; i++){
+    sq    = (ESL_SQ *) the_shard->contents[i];
+    taxid = sq->tax_id;
+    if(fwrite(sq->name, 1, strlen(sq->name) + 1, fp) != strlen(sq->name) + 1) goto ERROR;
+    if(fwrite(sq->acc,  1, strlen(sq->acc)  + 1, fp) != strlen(sq->acc)  + 1) goto ERROR;
+    if(fwrite(sq->desc, 1, strlen(sq->desc) + 1, fp) != strlen(sq->desc) + 1) goto ERROR;
+    if(fwrite(&taxid, sizeof(int32_t), 1, fp) != 1)                           goto ERROR;
+  }
+
+  // and the name of the database
+  if(fwrite(the_shard->sourcename, 1, strlen(the_shard->sourcename) + 1, fp) != strlen(the_shard->sourcename) + 1) goto ERROR;
+
+  if(fclose(fp) != 0){
+    p7_Fail("Error closing prepared shard file %s\n", filename);
+  }
+  return eslOK;
+
+  // GOTO target used to catch write errors
+  ERROR:
+    p7_Fail("Error writing prepared shard file %s\n", filename);
+    return eslFAIL; //silence compiler warning on Mac
+}
+
+
 // p7_shard_Destroy
 /*! \brief Frees all memory allocated by the shard.
  *  \param [in] the_shard A pointer to the shard to be freed.
@@ -276,7 +527,13 @@ void p7_shard_Destroy(P7_SHARD *the_shard){
   esl_alphabet_Destroy(the_shard->abc);  // free the shard's alphabet
   }
   // free all of the heap-allocated sub-objects
-  if(the_shard->data_type == HMM && the_shard->contents != NULL){
+  if(the_shard->map != NULL){
+    // Sequences point into the mapped file, so only the ESL_SQ shells and the array of pointers to them are on the heap
+    free(the_shard->descriptors);
+    free(the_shard->contents);
+    munmap(the_shard->map, the_shard->map_size);
+  }
+  else if(the_shard->data_type == HMM && the_shard->contents != NULL){
     // Contents and descriptors are arrays of pointers to structures, need to free the pointed-to structures
     // For sequence shards, the contents and descriptors are flat arrays of bytes, so can just be freed
     int i;
@@ -3,6 +3,12 @@
 #ifndef SHARD_INCLUDED
 #define SHARD_INCLUDED
 
+//! First bytes of a prepared shard file, used to tell prepared shards from FASTA and HMM files
+#define p7_SHARD_PREPARED_MAGIC "P7SHARD"
+
+//! Version number of the prepared shard file format
+#define p7_SHARD_PREPARED_VERSION 1
+
 //! Enum that defines the type of data in the database
 typedef enum P7_shard_data_type {AMINO, DNA, RNA, HMM} P7_SHARD_DATA_TYPE;
 
@@ -44,6 +50,11 @@ typedef struct p7_shard_directory_entry{
  * 
  * An object's ID is its position in the original database, regardless of the number of shards the database is divided into.  Objects must be 
  * loaded into the database in ascending order of ID so that we can use binary search on the directory to locate a particular object.
+ *
+ * A sequence shard may also be loaded from a prepared shard file (see p7_shard_Write_prepared()), which is mapped read-only into memory
+ * rather than read.  In that case, the ESL_SQ objects in the shard point directly at the residues, names, accessions, and descriptions in 
+ * the mapped file, so starting up a worker node requires no parsing or copying, and processes on the same machine share one copy of the data
+ * through the page cache.
  */
 typedef struct p7_shard{
 
@@ -71,8 +82,54 @@ typedef struct p7_shard{
 
 	//! Total number of residues in the shard if a sequence shard, sum of the lengths of the HMMs in the shard if an HMM shard.
 	uint64_t total_length;  
+
+	//! Start of the memory-mapped prepared shard file that the shard's data points into, or NULL if the shard's data was read into the heap
+	void *map;
+
+	//! Size of the memory-mapped region, in bytes
+	uint64_t map_size;
 } P7_SHARD;
 
+/*! Header at the start of a prepared shard file.  
+ * \details A prepared shard file holds an entire sequence database, in this order: the header, a directory with one P7_SHARD_DIRECTORY_ENTRY
+ * per sequence, the contents region, the descriptors region, and the name of the database the file was prepared from.  
+ * Each sequence's record in the contents region is laid out as Sequence ID (8 bytes) : Sequence Length (8 bytes) : Sequence data (Sequence length + 2 bytes), 
+ * and its record in the descriptors region holds its name, accession, and description (each NUL-terminated) followed by its taxid (4 bytes).
+ * All offsets in the file's directory are relative to the start of the contents and descriptors regions.  The file is written in the byte order 
+ * of the machine that wrote it.
+ */
+typedef struct p7_shard_prepared_header{
+	//! p7_SHARD_PREPARED_MAGIC, NUL-padded
+	char magic[8];
+
+	//! p7_SHARD_PREPARED_VERSION
+	uint32_t version;
+
+	//! Always 1; used to detect files written on a machine with a different byte order
+	uint32_t byte_order;
+
+	//! Type of data in the file.  Only AMINO is supported at the moment
+	uint32_t data_type;
+
+	//! Easel alphabet type of the sequences
+	uint32_t alphabet_type;
+
+	//! Number of sequences in the file
+	uint64_t num_objects;
+
+	//! Total number of residues in the file
+	uint64_t total_length;
+
+	//! Offsets of the directory, contents, descriptors, and database name from the start of the file
+	uint64_t directory_offset;
+	uint64_t contents_offset;
+	uint64_t descriptors_offset;
+	uint64_t sourcename_offset;
+
+	//! Size of the file, in bytes
+	uint64_t file_size;
+} P7_SHARD_PREPARED_HEADER;
+
 // Creates a shard whose contents are the specified fraction of the dsqdata database specified in basename
 P7_SHARD *p7_shard_Create_sqdata(char *filename, uint32_t num_shards, uint32_t my_shard, int masternode);
 
@@ -80,6 +137,12 @@ P7_SHARD *p7_shard_Create_sqdata(char *filename, uint32_t num_shards, uint32_t m
 P7_SHARD *p7_shard_Create_hmmfile(char *filename, uint32_t num_shards, uint32_t my_shard, int masternode);
 
 
+// Maps the specified fraction of the prepared shard file specified in filename into memory and builds a shard from it
+P7_SHARD *p7_shard_Open_prepared(char *filename, uint32_t num_shards, uint32_t my_shard, int masternode);
+
+// Writes the sequences in a shard out as a prepared shard file
+int p7_shard_Write_prepared(P7_SHARD *the_shard, char *filename);
+
 // Frees the shard and its enclosed data structures
 void p7_shard_Destroy(P7_SHARD *the_shard);
 
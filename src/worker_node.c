@@ -70,6 +70,8 @@ static void workernode_put_backend_queue_entry_in_pool(P7_SERVER_WORKERNODE_STAT
 static void workernode_put_backend_queue_entry_in_queue(P7_SERVER_WORKERNODE_STATE *workernode, P7_BACKEND_QUEUE_ENTRY *the_entry);
 static uint64_t worker_thread_get_chunk(P7_SERVER_WORKERNODE_STATE *workernode, uint32_t my_id, volatile uint64_t *start, volatile uint64_t *end);
 static int32_t worker_thread_steal(P7_SERVER_WORKERNODE_STATE *workernode, uint32_t my_id);
+static int worker_thread_next_object(P7_SERVER_WORKERNODE_STATE *workernode, uint32_t my_id, uint64_t *ret_id);
+static int workernode_global_queue_has_work(P7_SERVER_WORKERNODE_STATE *workernode);
 static void workernode_request_Work(uint32_t my_shard);
 static void workernode_wait_for_Work(P7_SERVER_CHUNK_REPLY *the_reply, MPI_Datatype *server_mpitypes);
 static int server_set_shard(P7_SERVER_WORKERNODE_STATE *workernode, P7_SHARD *the_shard, uint32_t database_id);
@@ -160,7 +162,7 @@ P7_SERVER_WORKERNODE_STATE *p7_server_workernode_Create(uint32_t num_databases,
 
   //initialize each record to no work and initialize its lock
   for(i = 0; i < num_threads; i++){
-    workernode->work[i].start = 0;
+    workernode->work[i].start = -1;
     workernode->work[i].end = 0;
     if(pthread_mutex_init(&(workernode->work[i].lock), &mutex_type)){
       p7_Die("Unable to create mutex in p7_server_workernode_Create");
@@ -245,6 +247,9 @@ P7_SERVER_WORKERNODE_STATE *p7_server_workernode_Create(uint32_t num_databases,
   workernode->global_queue->end = 0;
   workernode->global_queue->next = NULL;
 
+  // no chunks have been used up yet
+  workernode->global_retired = NULL;
+
   if(pthread_mutex_init(&(workernode->global_queue_lock), &mutex_type)){
     p7_Die("Unable to create mutex in p7_server_workernode_Create");
   }
@@ -459,6 +464,13 @@ int p7_server_workernode_Setup(uint32_t num_databases, char **database_names, ui
         p7_Die("Unable to allocate memory in p7_servere_workernode_Setup\n");
       }
     }
+    else if(!strncmp(id_string, p7_SHARD_PREPARED_MAGIC, strlen(p7_SHARD_PREPARED_MAGIC))){
+      // its a prepared shard file, which we can map instead of reading
+      current_shard = p7_shard_Open_prepared(database_names[i], num_shards, my_shard, 0);
+      if(current_shard == NULL){
+        p7_Die("Unable to allocate memory in p7_server_workernode_Setup\n");
+      }
+    }
     else
     {
       p7_Die("Couldn't determine type of datafile for database %s in p7_server_workernode_setup.\n", database_names[i], id_string);
@@ -681,47 +693,40 @@ int p7_server_workernode_add_work(P7_SERVER_WORKERNODE_STATE *workernode, uint64
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
   // recompute the amount of work that each worker thread should grab at a time
-  workernode->chunk_size = ((end_object - start_object) / (workernode->num_threads) * 16);
-  if(workernode->chunk_size < 1){
-    workernode->chunk_size = 1; // handle cases that round down to 0
+  uint64_t chunk_size = ((end_object - start_object) / (workernode->num_threads) * 16);
+  if(chunk_size < 1){
+    chunk_size = 1; // handle cases that round down to 0
   }
+  __atomic_store_n(&(workernode->chunk_size), chunk_size, __ATOMIC_RELAXED);
 
-  // add the chunk to the global queue
-  if(workernode->global_queue->end <  workernode->global_queue->start){
-    // There's currently no work on the global queue
-    workernode->global_queue->end = end_object;
-    workernode->global_queue->start = start_object;
-  }
-  else{
-    // need to push a new work chunk onto the queue
-    P7_WORK_CHUNK *temp = workernode->global_chunk_pool; // grab an empty chunk if there is one
+  // add the chunk to the global queue.  Always push a fresh chunk, even if the one at the head of the queue is empty, because
+  // worker threads claim work from the head chunk without locking and may still be incrementing its start.
+  P7_WORK_CHUNK *temp = workernode->global_chunk_pool; // grab an empty chunk if there is one
     
-    if(temp == NULL){ // if not, allocate some more
-      workernode->global_chunk_pool = (P7_WORK_CHUNK *) malloc((workernode->num_threads +1) * sizeof(P7_WORK_CHUNK));
-
-      // init the new chunks
-      for(i = 0; i < (workernode->num_threads); i++){
-        workernode->global_chunk_pool[i].start = -1;
-        workernode->global_chunk_pool[i].end = 0;
-        workernode->global_chunk_pool[i].next = &(workernode->global_chunk_pool[i+1]);
-      }
-      // special-case the last entry
-      workernode->global_chunk_pool[workernode->num_threads].start = -1;
-      workernode->global_chunk_pool[workernode->num_threads].end = 0;
-      workernode->global_chunk_pool[workernode->num_threads].next = NULL;
-      temp = workernode->global_chunk_pool;        
+  if(temp == NULL){ // if not, allocate some more
+    workernode->global_chunk_pool = (P7_WORK_CHUNK *) malloc((workernode->num_threads +1) * sizeof(P7_WORK_CHUNK));
+
+    // init the new chunks
+    for(i = 0; i < (workernode->num_threads); i++){
+      workernode->global_chunk_pool[i].start = -1;
+      workernode->global_chunk_pool[i].end = 0;
+      workernode->global_chunk_pool[i].next = &(workernode->global_chunk_pool[i+1]);
     }
+    // special-case the last entry
+    workernode->global_chunk_pool[workernode->num_threads].start = -1;
+    workernode->global_chunk_pool[workernode->num_threads].end = 0;
+    workernode->global_chunk_pool[workernode->num_threads].next = NULL;
+    temp = workernode->global_chunk_pool;        
+  }
 
-    // pop the head of the free chunk pool now that we've guaranteed that there is one 
-    workernode->global_chunk_pool = workernode->global_chunk_pool->next;
-    // splice the new chunk onto the global work queue
-    temp->next = workernode->global_queue;
-    workernode->global_queue = temp;
+  // pop the head of the free chunk pool now that we've guaranteed that there is one 
+  workernode->global_chunk_pool = workernode->global_chunk_pool->next;
 
-    // Fill in the chunk's start, end pointers
-    workernode->global_queue->start = start_object;
-    workernode->global_queue->end = end_object;
-  }
+  // Fill in the chunk's start, end pointers, then publish it at the head of the global work queue
+  temp->start = start_object;
+  temp->end = end_object;
+  temp->next = workernode->global_queue;
+  __atomic_store_n(&(workernode->global_queue), temp, __ATOMIC_RELEASE);
   #ifdef DEBUG_MASTER_QUEUE
     printf("Workernode %d added chunk to work queue leaving state: ", workernode->my_rank);
     print_work_queue(workernode->global_queue);
@@ -980,6 +985,22 @@ void p7_server_workernode_end_search(P7_SERVER_WORKERNODE_STATE *workernode){
   #endif
   p7_tophits_Destroy(workernode->tophits);
   workernode->tophits = p7_tophits_Create(); // Create new tophits for next search
+
+  // No worker threads are running, so it's now safe to recycle the work chunks that were used up during the search
+  lock_retval = pthread_mutex_lock(&(workernode->global_queue_lock));
+     #ifdef CHECK_MUTEXES
+    parse_lock_errors(lock_retval, workernode->my_rank);
+  #endif
+  while(workernode->global_retired != NULL){
+    P7_WORK_CHUNK *temp = workernode->global_retired;
+    workernode->global_retired = temp->next;
+    temp->next = workernode->global_chunk_pool;
+    workernode->global_chunk_pool = temp;
+  }
+  lock_retval = pthread_mutex_unlock(&(workernode->global_queue_lock));
+     #ifdef CHECK_MUTEXES
+    parse_lock_errors(lock_retval, workernode->my_rank);
+  #endif
   lock_retval = pthread_mutex_unlock(&(workernode->wait_lock)); 
      #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
@@ -1352,31 +1373,27 @@ static int worker_thread_front_end_search_loop(P7_SERVER_WORKERNODE_STATE *worke
   #endif
   while(1){ // Iterate forever, we'll return from the function rather than exiting this loop
  
-
-    // Try to grab some work from the global queue
-    lock_retval = pthread_mutex_lock(&(workernode->work[my_id].lock));
-       #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-    workernode->work[my_id].start = -1; //Mark our local queue empty here so that stealing works correctly.
-    // Could do it at end of chunk, but that would require another lock-unlock sequence
-
+    // Our local queue is empty (start == -1) here, so thieves will pass us by while we look for more work.
     // try to get some work from the global queue
-    uint64_t work_on_global = worker_thread_get_chunk(workernode, my_id, &(workernode->work[my_id].start), &(workernode->work[my_id].end));
-    // grab the start and end pointers from our work queue
-    start = workernode->work[my_id].start;
-    end = workernode->work[my_id].end;
-#ifdef DEBUG_COMPARISONS
+    uint64_t work_on_global = worker_thread_get_chunk(workernode, my_id, &start, &end);
     if(work_on_global){
-      printf("Worker thread %d starting chunk from %ld to %ld\n", my_id, workernode->work[my_id].start, workernode->work[my_id].end);
-    } 
-#endif
-    lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock)); // release lock
+      // Publish the new range.  Thieves only look at a range while holding its lock, so they never see half of this update.
+      lock_retval = pthread_mutex_lock(&(workernode->work[my_id].lock));
    #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-    if(!work_on_global){
-    // there was no work on the global queue, so try to steal
+      workernode->work[my_id].end = end;
+      workernode->work[my_id].start = start;
+      lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock));
+   #ifdef CHECK_MUTEXES
+    parse_lock_errors(lock_retval, workernode->my_rank);
+  #endif
+#ifdef DEBUG_COMPARISONS
+      printf("Worker thread %d starting chunk from %ld to %ld\n", my_id, start, end);
+#endif
+    }
+    else{
+    // there was no work on the global queue, so try to steal.  A successful steal fills in our local queue.
       if(!worker_thread_steal(workernode, my_id)){
         // no more work, stop looping
         lock_retval = pthread_mutex_lock(&(workernode->backend_queue_lock));
@@ -1442,266 +1459,185 @@ static int worker_thread_front_end_search_loop(P7_SERVER_WORKERNODE_STATE *worke
           return 0;
         }
       }
-      else{
-        lock_retval = pthread_mutex_lock(&(workernode->work[my_id].lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-        // grab the start and end pointers from our work queue
-        start = workernode->work[my_id].start;
-        end = workernode->work[my_id].end;
-
-        lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock)); // release lock
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-      } 
     }
           
-    if((start != -1) && (start <= end)){
-      ESL_SQ *search_sequence=NULL;
-      P7_OPROFILE *search_om = NULL;
+    ESL_SQ *search_sequence=NULL;
+    P7_OPROFILE *search_om = NULL;
 
-      //printf("Worker %d from rank %d got chunk ranging from %lu to %lu\n", my_id, workernode->my_rank, start, end);
-      
-      lock_retval = pthread_mutex_lock(&(workernode->work[my_id].lock));
-         #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-      while(workernode->work[my_id].start<= workernode->work[my_id].end){
-
-        start = workernode->work[my_id].start;
-        workernode->work[my_id].start = start+1;
-        lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock));
-   #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-        if((search_type == SEQUENCE_SEARCH) || (search_type == SEQUENCE_SEARCH_CONTINUE)){
-          search_sequence = (ESL_SQ *) workernode->database_shards[compare_database]->contents[start];
-          p7_bg_SetLength(workernode->thread_state[my_id].bg, search_sequence->L);           
-          p7_oprofile_ReconfigLength(workernode->thread_state[my_id].om,search_sequence->L);
-          p7_pli_NewSeq(workernode->thread_state[my_id].pipeline, search_sequence);
+    // Claim objects off of the front of our local queue one at a time; no locking unless a thief is working on the same end of the queue
+    while(worker_thread_next_object(workernode, my_id, &start)){
+      if((search_type == SEQUENCE_SEARCH) || (search_type == SEQUENCE_SEARCH_CONTINUE)){
+        search_sequence = (ESL_SQ *) workernode->database_shards[compare_database]->contents[start];
+        p7_bg_SetLength(workernode->thread_state[my_id].bg, search_sequence->L);           
+        p7_oprofile_ReconfigLength(workernode->thread_state[my_id].om,search_sequence->L);
+        p7_pli_NewSeq(workernode->thread_state[my_id].pipeline, search_sequence);
 #ifdef DEBUG_COMPARISONS
-          printf("Worker %d from node %d front-end searched sequence %s with index %lu\n", my_id, workernode->my_rank, search_sequence->name, start);
+        printf("Worker %d from node %d front-end searched sequence %s with index %lu\n", my_id, workernode->my_rank, search_sequence->name, start);
 #endif
-          status = p7_Pipeline_Overthruster(workernode->thread_state[my_id].pipeline, workernode->thread_state[my_id].om, workernode->thread_state[my_id].bg, search_sequence, &fwdsc, &nullsc);
-        }
-        else{
-          search_om = (P7_OPROFILE *) workernode->database_shards[compare_database]->contents[start];
-          p7_pli_NewModel(workernode->thread_state[my_id].pipeline, search_om, workernode->thread_state[my_id].bg);
-          p7_oprofile_ReconfigLength(search_om, compare_L);
-          p7_bg_SetLength(workernode->thread_state[my_id].bg, compare_L);           
-          status = p7_Pipeline_Overthruster(workernode->thread_state[my_id].pipeline, search_om, workernode->thread_state[my_id].bg, compare_sequence, &fwdsc, &nullsc);
+        status = p7_Pipeline_Overthruster(workernode->thread_state[my_id].pipeline, workernode->thread_state[my_id].om, workernode->thread_state[my_id].bg, search_sequence, &fwdsc, &nullsc);
+      }
+      else{
+        search_om = (P7_OPROFILE *) workernode->database_shards[compare_database]->contents[start];
+        p7_pli_NewModel(workernode->thread_state[my_id].pipeline, search_om, workernode->thread_state[my_id].bg);
+        p7_oprofile_ReconfigLength(search_om, compare_L);
+        p7_bg_SetLength(workernode->thread_state[my_id].bg, compare_L);           
+        status = p7_Pipeline_Overthruster(workernode->thread_state[my_id].pipeline, search_om, workernode->thread_state[my_id].bg, compare_sequence, &fwdsc, &nullsc);
 #ifdef DEBUG_COMPARISONS
-          printf("Worker %d from node %d front-end searched HMM %s with index %lu\n", my_id, workernode->my_rank, search_om->name, start);
+        printf("Worker %d from node %d front-end searched HMM %s with index %lu\n", my_id, workernode->my_rank, search_om->name, start);
 #endif
-        }
+      }
 
-        if (status == eslFAIL)
-        {                                  // filters say no match, go on to next sequence
+      if (status == eslFAIL)
+      {                                  // filters say no match, go on to next sequence
 #ifdef TEST_SEQUENCES              // Record that we tested this sequence because we're checking to make sure all sequences get tested
-          workernode->sequences_processed[seq_id] = 1;
+        workernode->sequences_processed[seq_id] = 1;
 #endif               
-        }
-        else{ // push the current operation on the long comparison queue and go on to the next sequence
-
-          // First, check to make sure that someone else hasn't stolen the comparison
-          lock_retval = pthread_mutex_lock(&(workernode->work[my_id].lock));
-             #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-          // grab the start and end pointers from our work queue
-          end = workernode->work[my_id].end;
-          
-          
-
-          if(start <= end){ // sequence hadn't been stolen
-            lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock)); // release lock
-   #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-            // get an entry to put this comparison in
-            P7_BACKEND_QUEUE_ENTRY * the_entry = workernode_get_backend_queue_entry_from_pool(workernode);
+      }
+      else{ // push the current operation on the long comparison queue and go on to the next sequence
+        // An object we claimed can't be stolen, so there's no need to re-check our queue here.
+        // get an entry to put this comparison in
+        P7_BACKEND_QUEUE_ENTRY * the_entry = workernode_get_backend_queue_entry_from_pool(workernode);
 
 
-            // Merge our pipeline stats into the running total
-            p7_pipeline_Merge(workernode->thread_state[my_id].stats_pipeline, workernode->thread_state[my_id].pipeline);
-            //swap our pipeline with the one in the entry
-            the_entry->pipeline = workernode->thread_state[my_id].pipeline;
-            if((search_type == SEQUENCE_SEARCH) || (search_type == SEQUENCE_SEARCH_CONTINUE)){
-              workernode->thread_state[my_id].pipeline = p7_pipeline_Create(workernode->commandline_options, 100, 100, FALSE, p7_SEARCH_SEQS);
-              if(workernode->thread_state[my_id].pipeline == NULL){
-                p7_Die("Unable to allocate memory in worker_thread_front_end_sequence_search_loop.\n");
-              }
-              p7_pli_NewModel(workernode->thread_state[my_id].pipeline, workernode->thread_state[my_id].om, workernode->thread_state[my_id].bg);
+        // Merge our pipeline stats into the running total
+        p7_pipeline_Merge(workernode->thread_state[my_id].stats_pipeline, workernode->thread_state[my_id].pipeline);
+        //swap our pipeline with the one in the entry
+        the_entry->pipeline = workernode->thread_state[my_id].pipeline;
+        if((search_type == SEQUENCE_SEARCH) || (search_type == SEQUENCE_SEARCH_CONTINUE)){
+          workernode->thread_state[my_id].pipeline = p7_pipeline_Create(workernode->commandline_options, 100, 100, FALSE, p7_SEARCH_SEQS);
+          if(workernode->thread_state[my_id].pipeline == NULL){
+            p7_Die("Unable to allocate memory in worker_thread_front_end_sequence_search_loop.\n");
+          }
+          p7_pli_NewModel(workernode->thread_state[my_id].pipeline, workernode->thread_state[my_id].om, workernode->thread_state[my_id].bg);
 #ifdef DEBUG_COMPARISONS             
-              printf("Worker %d from node %d sending sequence %s to backend, index was %lu\n", my_id, workernode->my_rank, search_sequence->name, start);
+          printf("Worker %d from node %d sending sequence %s to backend, index was %lu\n", my_id, workernode->my_rank, search_sequence->name, start);
 #endif              
-              the_entry->sequence = search_sequence;
-              the_entry->om = workernode->thread_state[my_id].om;
-            }
-            else{
-              workernode->thread_state[my_id].pipeline = p7_pipeline_Create(workernode->commandline_options, 100, 100, FALSE, p7_SCAN_MODELS);
-              if(workernode->thread_state[my_id].pipeline == NULL){
-              p7_Die("Unable to allocate memory in worker_thread_front_end_sequence_search_loop.\n");
-              }
-              the_entry->sequence = compare_sequence;
-              the_entry->om = search_om;
+          the_entry->sequence = search_sequence;
+          the_entry->om = workernode->thread_state[my_id].om;
+        }
+        else{
+          workernode->thread_state[my_id].pipeline = p7_pipeline_Create(workernode->commandline_options, 100, 100, FALSE, p7_SCAN_MODELS);
+          if(workernode->thread_state[my_id].pipeline == NULL){
+          p7_Die("Unable to allocate memory in worker_thread_front_end_sequence_search_loop.\n");
+          }
+          the_entry->sequence = compare_sequence;
+          the_entry->om = search_om;
 #ifdef DEBUG_COMPARISONS             
-              printf("Worker %d from node %d sending HMM %s to backend, index was %lu\n", my_id, workernode->my_rank, search_om->name, start);
+          printf("Worker %d from node %d sending HMM %s to backend, index was %lu\n", my_id, workernode->my_rank, search_om->name, start);
 #endif   
-            }
+        }
 
-            // populate the fields
-            the_entry->next = NULL;
-            the_entry->fwdsc = fwdsc;
-            the_entry->nullsc = nullsc;
-            lock_retval = pthread_mutex_lock(&(workernode->thread_state[my_id].mode_lock));
-               #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-            workernode->thread_state[my_id].comparisons_queued += 1;
-            lock_retval = pthread_mutex_unlock(&(workernode->thread_state[my_id].mode_lock));
-               #ifdef CHECK_MUTEXES
+        // populate the fields
+        the_entry->next = NULL;
+        the_entry->fwdsc = fwdsc;
+        the_entry->nullsc = nullsc;
+        lock_retval = pthread_mutex_lock(&(workernode->thread_state[my_id].mode_lock));
+           #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-            // put the entry in the queue
-            workernode_put_backend_queue_entry_in_queue(workernode, the_entry);
-            lock_retval = pthread_mutex_lock(&(workernode->backend_threads_lock));
-               #ifdef CHECK_MUTEXES
+        workernode->thread_state[my_id].comparisons_queued += 1;
+        lock_retval = pthread_mutex_unlock(&(workernode->thread_state[my_id].mode_lock));
+           #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-            lock_retval = pthread_mutex_lock(&(workernode->backend_queue_lock));
-               #ifdef CHECK_MUTEXES
+        // put the entry in the queue
+        workernode_put_backend_queue_entry_in_queue(workernode, the_entry);
+        lock_retval = pthread_mutex_lock(&(workernode->backend_threads_lock));
+           #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-            if (workernode->backend_queue_depth > (workernode->num_backend_threads << BACKEND_INCREMENT_FACTOR)){
-              lock_retval = pthread_mutex_unlock(&(workernode->backend_queue_lock));
-                 #ifdef CHECK_MUTEXES
+        lock_retval = pthread_mutex_lock(&(workernode->backend_queue_lock));
+           #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-              lock_retval = pthread_mutex_unlock(&(workernode->backend_threads_lock));
-                 #ifdef CHECK_MUTEXES
+        if (workernode->backend_queue_depth > (workernode->num_backend_threads << BACKEND_INCREMENT_FACTOR)){
+          lock_retval = pthread_mutex_unlock(&(workernode->backend_queue_lock));
+             #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-              // There are too many back-end comparisons waiting in the queue, so switch a thread from frontend to backend
-              workernode_increase_backend_threads(workernode);
-            }
-            else{
-              lock_retval = pthread_mutex_unlock(&(workernode->backend_queue_lock));
-                 #ifdef CHECK_MUTEXES
+          lock_retval = pthread_mutex_unlock(&(workernode->backend_threads_lock));
+             #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-              lock_retval = pthread_mutex_unlock(&(workernode->backend_threads_lock));
-                 #ifdef CHECK_MUTEXES
+          // There are too many back-end comparisons waiting in the queue, so switch a thread from frontend to backend
+          workernode_increase_backend_threads(workernode);
+        }
+        else{
+          lock_retval = pthread_mutex_unlock(&(workernode->backend_queue_lock));
+             #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-            }
-          }
-          else{
-            lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock)); // release lock in two places to guarantee work not stolen before we make decision
-               #ifdef CHECK_MUTEXES
+          lock_retval = pthread_mutex_unlock(&(workernode->backend_threads_lock));
+             #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-          }
         }
-        lock_retval = pthread_mutex_lock(&(workernode->work[my_id].lock)); //Lock this here to preserve invariant that threads can't 
-        //acquire work[id].lock while holding thread_state[id].mode_lock
+      }
+
+      // Mode only changes under mode_lock, and only to BACKEND from other threads, so a plain atomic read is enough to notice the switch
+      if(__atomic_load_n(&(workernode->thread_state[my_id].mode), __ATOMIC_ACQUIRE) == BACKEND){
+      // need to switch modes.
+        //printf("Worker %d from node %d switching to back-end\n", my_id, workernode->my_rank);
+        // Put our current work chunk back on the work queue.  Lock our local queue so that no thief is in the middle of
+        // a steal while we empty it.
+        lock_retval = pthread_mutex_lock(&(workernode->work[my_id].lock));
            #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-        lock_retval = pthread_mutex_lock(&(workernode->thread_state[my_id].mode_lock));
+        end = workernode->work[my_id].end;
+        start = workernode->work[my_id].start;  // will be the first object after the one we're currently processing
+        workernode->work[my_id].start = -1;  // update this so other threads don't try to steal the work we're putting on the 
+        // global queue
+        lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock));
            #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-        if(workernode->thread_state[my_id].mode == BACKEND){
-        // need to switch modes.
-          //printf("Worker %d from node %d switching to back-end\n", my_id, workernode->my_rank);
-          // Put our current work chunk back on the work queue
-
-          // Synchronize so that we have the most up-to-date info on how much work is left on our local queue
-
-          end = workernode->work[my_id].end;
-          start = workernode->work[my_id].start;  // will be the first object after the one we're currently processing
-          workernode->work[my_id].start = -1;  // update this so other threads don't try to steal the work we're putting on the 
-          // global queue
 
-          if(start <= end){
-            // there was still work left on our queue, so push it back on the global queue
-            lock_retval = pthread_mutex_lock(&(workernode->global_queue_lock));
-   #ifdef CHECK_MUTEXES
+        if((start != -1) && (start <= end)){
+          // there was still work left on our queue, so push it back on the global queue
+          lock_retval = pthread_mutex_lock(&(workernode->global_queue_lock));
+ #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-            // Grab a work chunk to use
-            P7_WORK_CHUNK *temp = workernode->global_chunk_pool;
-            if(temp == NULL){ // allocate more chunks
-              workernode->global_chunk_pool = (P7_WORK_CHUNK *) malloc((workernode->num_threads +1) * sizeof(P7_WORK_CHUNK));
-              int i;
-              for(i = 0; i < (workernode->num_threads); i++){
-                workernode->global_chunk_pool[i].start = -1;
-                workernode->global_chunk_pool[i].end = 0;
-                workernode->global_chunk_pool[i].next = &(workernode->global_chunk_pool[i+1]);
-              }
-              // special-case the last entry
-              workernode->global_chunk_pool[workernode->num_threads].start = -1;
-              workernode->global_chunk_pool[workernode->num_threads].end = 0;
-              workernode->global_chunk_pool[workernode->num_threads].next = NULL;
-              temp = workernode->global_chunk_pool;        
+          // Grab a work chunk to use
+          P7_WORK_CHUNK *temp = workernode->global_chunk_pool;
+          if(temp == NULL){ // allocate more chunks
+            workernode->global_chunk_pool = (P7_WORK_CHUNK *) malloc((workernode->num_threads +1) * sizeof(P7_WORK_CHUNK));
+            int i;
+            for(i = 0; i < (workernode->num_threads); i++){
+              workernode->global_chunk_pool[i].start = -1;
+              workernode->global_chunk_pool[i].end = 0;
+              workernode->global_chunk_pool[i].next = &(workernode->global_chunk_pool[i+1]);
             }
+            // special-case the last entry
+            workernode->global_chunk_pool[workernode->num_threads].start = -1;
+            workernode->global_chunk_pool[workernode->num_threads].end = 0;
+            workernode->global_chunk_pool[workernode->num_threads].next = NULL;
+            temp = workernode->global_chunk_pool;        
+          }
 
-            // pop the head of the free chunk Pool
-            workernode->global_chunk_pool = workernode->global_chunk_pool->next;
-            // splice the new chunk onto the global work queue
-            temp->next = workernode->global_queue;
-            workernode->global_queue = temp;
-
-            // Fill in the chunk's start, end pointers
-            workernode->global_queue->start = start;
-            workernode->global_queue->end = end;
+          // pop the head of the free chunk Pool
+          workernode->global_chunk_pool = workernode->global_chunk_pool->next;
 
-            lock_retval = pthread_mutex_unlock(&(workernode->global_queue_lock)); // release lock  
+          // Fill in the chunk's start, end pointers, then splice it onto the global work queue
+          temp->start = start;
+          temp->end = end;
+          temp->next = workernode->global_queue;
+          __atomic_store_n(&(workernode->global_queue), temp, __ATOMIC_RELEASE);
 
-             
-          }
-          //Merge the current statistics into the running list
-          p7_pipeline_Merge(workernode->thread_state[my_id].stats_pipeline, workernode->thread_state[my_id].pipeline);
-          //and free the current pipeline
-          p7_pipeline_Destroy(workernode->thread_state[my_id].pipeline);
-          workernode->thread_state[my_id].pipeline = NULL;
-          lock_retval = pthread_mutex_unlock(&(workernode->thread_state[my_id].mode_lock));
-             #ifdef CHECK_MUTEXES
+          lock_retval = pthread_mutex_unlock(&(workernode->global_queue_lock)); // release lock  
+ #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-          lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock));
-             #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-          return(0);
         }
-        lock_retval = pthread_mutex_unlock(&(workernode->thread_state[my_id].mode_lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-        lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-      /* believe these are now redundant
-        // if we get this far, we weren't switched to the backend, so go on to the next sequence or back to look for more work
-        search_sequence = (ESL_SQ *) workernode->database_shards[compare_database]->contents[start];
-        search_om = (P7_OPROFILE *) search_sequence;  // set both of these, only use the one that's appropriate for the search 
-        // type because it's faster than a conditional to see which one we need to set
-      */
-        p7_pipeline_Reuse(workernode->thread_state[my_id].pipeline);
-        lock_retval = pthread_mutex_lock(&(workernode->work[my_id].lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
+        //Merge the current statistics into the running list
+        p7_pipeline_Merge(workernode->thread_state[my_id].stats_pipeline, workernode->thread_state[my_id].pipeline);
+        //and free the current pipeline
+        p7_pipeline_Destroy(workernode->thread_state[my_id].pipeline);
+        workernode->thread_state[my_id].pipeline = NULL;
+        return(0);
       }
-    lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock));
-       #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank); 
-  #endif 
+      p7_pipeline_Reuse(workernode->thread_state[my_id].pipeline);
     }
   }
 }
@@ -2007,9 +1943,31 @@ static void workernode_put_backend_queue_entry_in_queue(P7_SERVER_WORKERNODE_STA
 }
  
 
+// workernode_global_queue_has_work
+/*! \brief Checks whether the worker node's global work queue has work left, popping exhausted chunks off of its head
+ *  \details The caller must hold global_queue_lock.  Popped chunks go on the retired list rather than back in the free pool, because
+ *  worker threads that read the head of the queue before it was popped may still be looking at them.  p7_server_workernode_end_search() 
+ *  returns retired chunks to the pool once no thread is running.  The last chunk on the queue is never popped, even if it is empty.
+ *  \param [in,out] workernode The worker node's P7_SERVER_WORKERNODE_STATE object, which is modified during execution.
+ *  \returns 1 if the chunk at the head of the queue has work left, 0 otherwise.
+ */
+static int workernode_global_queue_has_work(P7_SERVER_WORKERNODE_STATE *workernode){
+  P7_WORK_CHUNK *head = workernode->global_queue;
+
+  while((__atomic_load_n(&(head->start), __ATOMIC_ACQUIRE) > head->end) && (head->next != NULL)){
+    __atomic_store_n(&(workernode->global_queue), head->next, __ATOMIC_RELEASE);
+    __atomic_store_n(&(head->next), workernode->global_retired, __ATOMIC_RELEASE);
+    workernode->global_retired = head;
+    head = workernode->global_queue;
+  }
+  return (__atomic_load_n(&(head->start), __ATOMIC_ACQUIRE) <= head->end);
+}
+
+
 // worker_thread_get_chunk
 /*! \brief Gets a chunk of work from the global work queue for the worker thread to work on, if possible.
- *  \details Searches the global work queue to determine if there's any work available.  If so, extracts a chunk.
+ *  \details Claims the next chunk_size+1 objects of the chunk at the head of the global work queue with one atomic fetch-and-add on 
+ *  the chunk's start, so threads only take global_queue_lock when the head chunk runs dry and has to be popped.  
  *  If the amount of work in the global queue is below the work request threshold, sets flags telling the main thread to request more work.
  *  \param [in,out] workernode The worker node's P7_SERVER_WORKERNODE_STATE object, which is modified during execution.
  *  \param [in] my_id The id (index into arrays of thread-specific state) of the thread that called this procedure.
@@ -2018,117 +1976,96 @@ static void workernode_put_backend_queue_entry_in_queue(P7_SERVER_WORKERNODE_STA
  *  \returns 1 if there was a chunk of work to get, 0 otherwise.  Calls p7_Die() to exit the program if unable to complete.
  */
 static uint64_t worker_thread_get_chunk(P7_SERVER_WORKERNODE_STATE *workernode, uint32_t my_id, volatile uint64_t *start, volatile uint64_t *end){
+  P7_WORK_CHUNK *head, *current;
+  uint64_t my_start, my_end, chunk_size;
+  int has_work;
   int lock_retval;
-  lock_retval = pthread_mutex_lock(&(workernode->global_queue_lock));
-       #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-  // sanity check
-  if(workernode->global_queue == NULL){
-    p7_Die("Found NULL global queue in worker_thread_get_chunk\n");
-  }
-
-  // See if there's any work in the queue
-  while(workernode->global_queue->end < workernode->global_queue->start){
-    // there's no work in the object at the front of the queue
-    if(workernode->global_queue->next != NULL){
-      //pop the head off of the list of work chunks
-      P7_WORK_CHUNK *temp = workernode->global_queue->next;
 
-      // put the empty entry back on the free list
-      workernode->global_queue->next = workernode->global_chunk_pool;
-      workernode->global_chunk_pool = workernode->global_queue;
+  while(1){
+    head = __atomic_load_n(&(workernode->global_queue), __ATOMIC_ACQUIRE);
+    // sanity check
+    if(head == NULL){
+      p7_Die("Found NULL global queue in worker_thread_get_chunk\n");
+    }
 
-      workernode->global_queue = temp;
+    // Claim the next piece of the head chunk.  Chunks are not recycled during a search, so <head> stays valid even if 
+    // another thread pops it off of the queue while we're looking at it.  Check that the chunk isn't empty before 
+    // claiming, because empty chunks have start = -1 and adding to that would wrap around.
+    chunk_size = __atomic_load_n(&(workernode->chunk_size), __ATOMIC_RELAXED);
+    my_start = __atomic_load_n(&(head->start), __ATOMIC_ACQUIRE);
+    if(my_start <= head->end){
+      my_start = __atomic_fetch_add(&(head->start), chunk_size+1, __ATOMIC_ACQ_REL);
     }
-    else{
-      // work queue is empty
-      lock_retval = pthread_mutex_unlock(&(workernode->global_queue_lock));
-             #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-      lock_retval = pthread_mutex_lock(&(workernode->work_request_lock));
+    if(my_start <= head->end){
+      // take chunk_size+1 objects, or whatever is left of the head chunk if that's less
+      my_end = (my_start + chunk_size < head->end) ? my_start + chunk_size : head->end;
+      break;
+    }
+
+    // There's no work in the object at the front of the queue.  Pop it if there's more behind it and try again
+    lock_retval = pthread_mutex_lock(&(workernode->global_queue_lock));
        #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-      if(!workernode->work_requested && !workernode->master_queue_empty && !workernode->request_work){
-        // We aren't waiting for the master node to send work, the master node hasn't told us it's out of work, and nobody else has set 
-        // the flag telling the main thread to request work, so we should set the work request flag.
-        workernode->request_work = 1;
-
-      }
-      lock_retval = pthread_mutex_unlock(&(workernode->work_request_lock));
-             #ifdef CHECK_MUTEXES
+    has_work = workernode_global_queue_has_work(workernode);
+    lock_retval = pthread_mutex_unlock(&(workernode->global_queue_lock));
+       #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-      return(0);
+    if(has_work){
+      continue;
     }
-  }
 
-  // if we get here, the head work chunk on the list has some work to do
-  uint64_t my_start, my_end;
-  my_start = workernode->global_queue->start;
-  if(my_start+ workernode->chunk_size < workernode->global_queue->end){
-    // there's more than one chunk of work left in the global queue, so grab one and advance the start pointer
-    lock_retval = pthread_mutex_lock(&(workernode->search_definition_lock));
-           #ifdef CHECK_MUTEXES
+    // work queue is empty
+    lock_retval = pthread_mutex_lock(&(workernode->work_request_lock));
+       #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-    my_end  = my_start+ workernode->chunk_size;
-    workernode->global_queue->start = my_end+1;
-    lock_retval = pthread_mutex_unlock(&(workernode->search_definition_lock));
-           #ifdef CHECK_MUTEXES
+    if(!workernode->work_requested && !workernode->master_queue_empty && !workernode->request_work){
+      // We aren't waiting for the master node to send work, the master node hasn't told us it's out of work, and nobody else has set 
+      // the flag telling the main thread to request work, so we should set the work request flag.
+      workernode->request_work = 1;
+    }
+    lock_retval = pthread_mutex_unlock(&(workernode->work_request_lock));
+       #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-  }
-  else{
-    // one chunk or less left to grab, so take all the work and pop the head work chunk off of the list;
-    // Note that there should always be a work chunk on the work queue, even if its an empty one, so never pop the last chunk
-    my_end = workernode->global_queue->end;
-    workernode->global_queue->start = -1;
-    if(workernode->global_queue->next != NULL){
-      P7_WORK_CHUNK *temp = workernode->global_queue->next;
-
-      // put the empty entry back on the free list
-      workernode->global_queue->next = workernode->global_chunk_pool;
-      workernode->global_chunk_pool = workernode->global_queue;
-
-      workernode->global_queue = temp;
-    }
+    return(0);
   }
 
-  // See if the amount of work left in the queue is below the request threshold
-  P7_WORK_CHUNK *current;
-  current = workernode->global_queue;
+  // See if the amount of work left in the queue is below the request threshold.  Exhausted chunks (including any 
+  // that have been retired since we read them) don't count.
   int need_more_work = 1;
   int queue_depth = 0;
-  while(current != NULL){
-    if(((current->start + WORK_REQUEST_THRESHOLD) < current->end)|| queue_depth >= WORK_REQUEST_THRESHOLD){
+  for(current = __atomic_load_n(&(workernode->global_queue), __ATOMIC_ACQUIRE); current != NULL; current = __atomic_load_n(&(current->next), __ATOMIC_ACQUIRE)){
+    uint64_t current_start = __atomic_load_n(&(current->start), __ATOMIC_RELAXED);
+    if(current_start > current->end){
+      continue;
+    }
+    if(((current_start + WORK_REQUEST_THRESHOLD) < current->end)|| queue_depth >= WORK_REQUEST_THRESHOLD){
       // There's enough work left in the queue that we don't need any more
       need_more_work = 0;
-      current = NULL;
-    }
-    else{
-      current = current->next;
-      queue_depth += 1;
+      break;
     }
+    queue_depth += 1;
   }
-  lock_retval = pthread_mutex_lock(&(workernode->work_request_lock));
-         #ifdef CHECK_MUTEXES
+
+  // Only lock the request flags if it looks like we need to set one; re-check them once we hold the lock to avoid race conditions
+  if(need_more_work && !__atomic_load_n(&(workernode->work_requested), __ATOMIC_RELAXED) && !__atomic_load_n(&(workernode->master_queue_empty), __ATOMIC_RELAXED) 
+     && !__atomic_load_n(&(workernode->request_work), __ATOMIC_RELAXED)){
+    lock_retval = pthread_mutex_lock(&(workernode->work_request_lock));
+       #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-  if(need_more_work && !workernode->work_requested && !workernode->master_queue_empty && !workernode->request_work){
-    // We need more work and nobody else has requested some
-  
     if(!workernode->work_requested && !workernode->master_queue_empty && !workernode->request_work){
-      // re-check whether we should send a request once we've locked the request variable lock to avoid race conditions
       workernode->request_work = 1;
     }
-  }
-  lock_retval = pthread_mutex_unlock(&(workernode->work_request_lock));
-         #ifdef CHECK_MUTEXES
+    lock_retval = pthread_mutex_unlock(&(workernode->work_request_lock));
+       #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
+  }
+
   // Return the start and end of the grabbed work chunk through start, end
   *start = my_start;
   *end = my_end;
@@ -2136,19 +2073,70 @@ static uint64_t worker_thread_get_chunk(P7_SERVER_WORKERNODE_STATE *workernode,
   printf("Worker %d on node %d just got work chunk from %lu to %lu off of master queue, leaving state: ", my_id, workernode->my_rank, *start, *end);
   print_work_queue(workernode->global_queue);
   #endif
-  lock_retval = pthread_mutex_unlock(&(workernode->global_queue_lock));
-         #ifdef CHECK_MUTEXES
+  return(1); // signal that we found work
+}
+
+
+// worker_thread_next_object
+/*! \brief Claims the next object on the worker thread's local work queue.
+ *  \details The local queue is a range of object ids that the owning thread consumes from the front (start), while thieves take work off of 
+ *  the back (end).  The owner claims an object by advancing start and then checking it against end, without locking; only when the two ends 
+ *  meet does it take the queue's lock, which thieves hold while they move end, to settle who gets the object. 
+ *  (This is the THE protocol of Frigo, Leiserson and Randall's Cilk-5 work-stealing scheduler.)  When the queue runs out, marks it empty
+ *  by setting start to -1.
+ *  \warning Only the thread that owns the queue may call this function.
+ *  \param [in,out] workernode The worker node's P7_SERVER_WORKERNODE_STATE object, which is modified during execution.
+ *  \param [in] my_id The id (index into arrays of thread-specific state) of the thread that called this procedure.
+ *  \param [out] ret_id The id of the claimed object, if there was one.
+ *  \returns 1 if an object was claimed, 0 if the local queue is empty.
+ */
+static int worker_thread_next_object(P7_SERVER_WORKERNODE_STATE *workernode, uint32_t my_id, uint64_t *ret_id){
+  P7_WORK_DESCRIPTOR *work = &(workernode->work[my_id]);
+  uint64_t next = work->start;  // only the owner moves start, so no need for an atomic read
+  int lock_retval;
+
+  if(next == (uint64_t) -1){
+    return 0; // queue is already empty
+  }
+
+  // Claim <next>, then make sure that no thief has moved end past it.
+  __atomic_store_n(&(work->start), next+1, __ATOMIC_SEQ_CST);
+  if(next <= __atomic_load_n(&(work->end), __ATOMIC_SEQ_CST)){
+    *ret_id = next;
+    return 1;
+  }
+
+  // Either the queue is empty or a thief is stealing its last objects.  Thieves back off if they see that we've claimed 
+  // something they wanted, so once we hold the lock end is settled.
+  lock_retval = pthread_mutex_lock(&(work->lock));
+     #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-  return(1); // signal that we found work
+  if(next <= work->end){
+    lock_retval = pthread_mutex_unlock(&(work->lock));
+       #ifdef CHECK_MUTEXES
+    parse_lock_errors(lock_retval, workernode->my_rank);
+  #endif
+    *ret_id = next;
+    return 1;
+  }
+  work->start = -1; //Mark our local queue empty so that stealing works correctly.
+  lock_retval = pthread_mutex_unlock(&(work->lock));
+     #ifdef CHECK_MUTEXES
+    parse_lock_errors(lock_retval, workernode->my_rank);
+  #endif
+  return 0;
 }
 
 
 // worker_thread_steal
 /*! \brief If any other thread has work available, steals half of it.
  *  \details Searches all of the worker threads to find the one with the most front-end work available.  If it finds a thread with front-end work 
- *  available, steals half or all of it depending on the amount of work in the victim's thread.  Updates the victim's and stealer's local work 
- *  queues to reflect the theft.
+ *  available, steals the back half of the work on that thread's local queue (or its last object, if it only has two).  Updates the victim's 
+ *  and stealer's local work queues to reflect the theft.
+ *  The search reads the other threads' queues without locking them, so it is only a hint; the theft itself happens under the victim's lock 
+ *  and backs off if the victim claimed any of the stolen objects in the meantime (see worker_thread_next_object()).  Each thread only ever 
+ *  holds one work descriptor lock at a time, so thieves don't need to be serialized.
  *  \warning This function should only be called by a worker thread that is in front-end mode.
  *  \param [in,out] workernode The worker node's P7_SERVER_WORKERNODE_STATE object, which is modified during execution.
  *  \param [in] my_id The id (index into arrays of thread-specific state) of the thread that called this procedure.
@@ -2157,92 +2145,56 @@ static uint64_t worker_thread_get_chunk(P7_SERVER_WORKERNODE_STATE *workernode,
 int32_t worker_thread_steal(P7_SERVER_WORKERNODE_STATE *workernode, uint32_t my_id){
   int victim_id = -1; // which thread are we going to steal from
   int i, lock_retval;
-  lock_retval = pthread_mutex_lock(&(workernode->steal_lock));  // Only let one thread try to steal at a time to prevent deadlocks in the
-   // workernode->work[x].lock s.
-          #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
+  uint64_t victim_start, victim_end;
   #ifdef DEBUG_STEAL
     printf("Worker %d on node %d starting steal.\n", my_id, workernode->my_rank);
   #endif
 
-  lock_retval = pthread_mutex_lock(&(workernode->work[my_id].lock));
-         #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-  if(workernode->work[my_id].start <= workernode->work[my_id].end){
+  if(workernode->work[my_id].start != -1){
     p7_Die("Thread %d tried to steal when it still had work on its queue\n", my_id);
   }
-  lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock));
-         #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-  if(workernode->no_steal){
-    lock_retval = pthread_mutex_unlock(&(workernode->steal_lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
+  if(__atomic_load_n(&(workernode->no_steal), __ATOMIC_RELAXED)){
     #ifdef DEBUG_STEAL
       printf("Worker %d on node %d ending steal because workernode->no_steal was set.\n", my_id, workernode->my_rank);
     #endif
-    return 0;  // check this and abort at start to avoid extra searches, locking, unlocking when many threads finish at same time
+    return 0;  // check this and abort at start to avoid extra searches when many threads finish at same time
   }
 
   int64_t most_work = 0;
   int64_t stealable_work = 0;
 
   for(i = 0; i < workernode->num_threads; i++){
-    lock_retval = pthread_mutex_lock(&(workernode->work[i].lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-    lock_retval = pthread_mutex_lock(&(workernode->thread_state[i].mode_lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-    if((workernode->work[i].start != -1) && (workernode->work[i].start < workernode->work[i].end) && (workernode->thread_state[i].mode == FRONTEND)){ 
+    victim_start = __atomic_load_n(&(workernode->work[i].start), __ATOMIC_RELAXED);
+    victim_end = __atomic_load_n(&(workernode->work[i].end), __ATOMIC_RELAXED);
+    if((victim_start != -1) && (victim_start < victim_end) && (__atomic_load_n(&(workernode->thread_state[i].mode), __ATOMIC_RELAXED) == FRONTEND)){ 
     // There's some stealable work in the potential victim's queue.
-      stealable_work = workernode->work[i].end - workernode->work[i].start;
+      stealable_work = victim_end - victim_start;
       if(stealable_work > most_work){
         most_work = stealable_work;
         victim_id = i;
       }
     }
-    lock_retval = pthread_mutex_unlock(&(workernode->thread_state[i].mode_lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-    lock_retval = pthread_mutex_unlock(&(workernode->work[i].lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
   }
 
   if(victim_id == -1){
     // we didn't find a good target to steal from
-    workernode->no_steal = 1;
+    __atomic_store_n(&(workernode->no_steal), 1, __ATOMIC_RELAXED);
     #ifdef DEBUG_STEAL
       printf("Worker %d on node %d ending steal and setting workernode->no_steal because it couldn't find work to steal.\n", my_id, workernode->my_rank);
     #endif
-    lock_retval = pthread_mutex_unlock(&(workernode->steal_lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
     return 0;
   }
 
-  // If we get this far, we found someone to steal from.
-  lock_retval = pthread_mutex_lock(&(workernode->work[my_id].lock));
-         #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
+  // If we get this far, we found someone to steal from.  Other thieves and the victim's end-of-queue check are locked out while we work.
   lock_retval = pthread_mutex_lock(&(workernode->work[victim_id].lock));
          #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
+  victim_start = __atomic_load_n(&(workernode->work[victim_id].start), __ATOMIC_SEQ_CST);
+  victim_end = workernode->work[victim_id].end;
 
-  // steal the lower half of the work from the victim's work queue if possible
-  if((workernode->work[victim_id].start >= workernode->work[victim_id].end) || (workernode->work[victim_id].start == (uint64_t) -1) || workernode->thread_state[victim_id].mode != FRONTEND){
+  // steal the upper half of the work from the victim's work queue if possible
+  if((victim_start == (uint64_t) -1) || (victim_start >= victim_end)){
     // there was no stealable work left by the time we decided who to steal from, so release the lock and try again
   #ifdef DEBUG_STEAL
       printf("Worker %d on node %d ending steal because someone had already stolen the work it planned to steal.\n", my_id, workernode->my_rank);
@@ -2250,48 +2202,43 @@ int32_t worker_thread_steal(P7_SERVER_WORKERNODE_STATE *workernode, uint32_t my_
     lock_retval = pthread_mutex_unlock(&(workernode->work[victim_id].lock));
            #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-    lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
-    lock_retval = pthread_mutex_unlock(&(workernode->steal_lock));
-           #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
     return(worker_thread_steal(workernode, my_id));  
   }
 
-  uint64_t work_available = workernode->work[victim_id].end - workernode->work[victim_id].start;
+  uint64_t work_available = victim_end - victim_start;
   uint64_t stolen_work, my_new_start, my_new_end, new_victim_end;
-  if(work_available > 1){
-    // there's enough work on the victim's queue to take half
-    stolen_work = work_available/2;
-
-    new_victim_end = workernode->work[victim_id].end - stolen_work;
-    my_new_start = new_victim_end +1;
-    my_new_end = workernode->work[victim_id].end;
-
-  }
-  else{ // take all of the work on the victim's queue
-    my_new_end = workernode->work[victim_id].end;
-    my_new_start = workernode->work[victim_id].start;
-    new_victim_end = workernode->work[victim_id].start-1;
-    stolen_work = work_available;
+  stolen_work = (work_available > 1) ? work_available/2 : 1;  // always leave the victim at least the object it may be working on
+  new_victim_end = victim_end - stolen_work;
+  my_new_start = new_victim_end +1;
+  my_new_end = victim_end;
+
+  // update the victim with its new end point, then check that it hasn't claimed any of the work we just took
+  __atomic_store_n(&(workernode->work[victim_id].end), new_victim_end, __ATOMIC_SEQ_CST);
+  victim_start = __atomic_load_n(&(workernode->work[victim_id].start), __ATOMIC_SEQ_CST);
+  if(victim_start > my_new_start){
+    // it has, so give the work back and try again
+    __atomic_store_n(&(workernode->work[victim_id].end), victim_end, __ATOMIC_SEQ_CST);
+    lock_retval = pthread_mutex_unlock(&(workernode->work[victim_id].lock));
+           #ifdef CHECK_MUTEXES
+    parse_lock_errors(lock_retval, workernode->my_rank);
+  #endif
+    return(worker_thread_steal(workernode, my_id));  
   }
-  // update the victim with its new end point
-  workernode->work[victim_id].end = new_victim_end;
-
-  // Now, update my work queue with the stolen work
-  workernode->work[my_id].start = my_new_start;
-  workernode->work[my_id].end = my_new_end;
 
   // unlock the victim's work queue so it can proceed
- lock_retval = pthread_mutex_unlock(&(workernode->work[victim_id].lock));
+  lock_retval = pthread_mutex_unlock(&(workernode->work[victim_id].lock));
        #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-  // release the lock on my local queue
+
+  // Now, update my work queue with the stolen work
+  lock_retval = pthread_mutex_lock(&(workernode->work[my_id].lock));
+         #ifdef CHECK_MUTEXES
+    parse_lock_errors(lock_retval, workernode->my_rank);
+  #endif
+  workernode->work[my_id].end = my_new_end;
+  workernode->work[my_id].start = my_new_start;
   lock_retval = pthread_mutex_unlock(&(workernode->work[my_id].lock));
          #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
@@ -2299,10 +2246,6 @@ int32_t worker_thread_steal(P7_SERVER_WORKERNODE_STATE *workernode, uint32_t my_
 #ifdef DEBUG_STEAL
   printf("Worker %d on node %d just stole work from %lu to %lu from worker %d\n", my_id, workernode->my_rank, my_new_start, my_new_end, victim_id);
 #endif
-  lock_retval = pthread_mutex_unlock(&(workernode->steal_lock));
-       #ifdef CHECK_MUTEXES
-    parse_lock_errors(lock_retval, workernode->my_rank);
-  #endif
   return 1;
 }
 
@@ -2386,6 +2329,8 @@ static int workernode_perform_search_or_scan(P7_SERVER_WORKERNODE_STATE *workern
   char *send_buf; // MPI buffer used to send hits to master
   int send_buf_length = 100 * 1024; // size of the send buffer. Default to 100kB, send code will resize as necessary
   ESL_ALLOC(send_buf, send_buf_length * sizeof(char));
+  P7_HITBLOCK *send_hits = p7_hitblock_Create(); // hits are sent to the master as one serialized block per message
+  if(send_hits == NULL) goto ERROR;
   ESL_ALLOC(compare_obj_buff, the_command->compare_obj_length);
   
   MPI_Bcast(compare_obj_buff, the_command->compare_obj_length, MPI_CHAR, 0, MPI_COMM_WORLD);
@@ -2590,8 +2535,8 @@ static int workernode_perform_search_or_scan(P7_SERVER_WORKERNODE_STATE *workern
 #ifdef DEBUG_HITS
           printf("Node %d copying hitlist to master node\n", workernode->my_rank);
 #endif
-        if(p7_tophits_MPISend(workernode->tophits, 0, HMMER_HIT_MPI_TAG, MPI_COMM_WORLD, &send_buf, &send_buf_length) 
-          != eslOK){
+        if(p7_hitblock_Write(send_hits, workernode->tophits) != eslOK ||
+           p7_hitblock_MPISend(send_hits, 0, HMMER_HIT_MPI_TAG, MPI_COMM_WORLD) != eslOK){
           p7_Die("Failed to send hit messages to master\n");
         }
         //printf("Sending HMMER_HIT_MPI_TAG message\n");
@@ -2663,7 +2608,7 @@ static int workernode_perform_search_or_scan(P7_SERVER_WORKERNODE_STATE *workern
 #ifdef DEBUG_MASTER_CHUNKS
         printf("Workernode %d received message that masternode was out of work during final request.  Top chunk on work queue had start = %lu and end = %lu\n", workernode->my_rank, workernode->global_queue->start, workernode->global_queue->end); 
 #endif
-        if(workernode->global_queue->start != -1){
+        if(workernode_global_queue_has_work(workernode)){
           lock_retval = pthread_mutex_unlock(&(workernode->global_queue_lock));
                  #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
@@ -2702,25 +2647,12 @@ static int workernode_perform_search_or_scan(P7_SERVER_WORKERNODE_STATE *workern
              #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
-      while((workernode->global_queue->end < workernode->global_queue->start) &&(workernode->global_queue->next != NULL)){
-        // there's no work in the object at the front of the queue, but there are more objects
-        //pop the head off of the list of work chunks
-        P7_WORK_CHUNK *temp = workernode->global_queue->next;
-
-        // put the empty entry back on the free list
-        workernode->global_queue->next = workernode->global_chunk_pool;
-        workernode->global_chunk_pool = workernode->global_queue;
-
-        workernode->global_queue = temp;
-      }
-      if(workernode->global_queue->end >= workernode->global_queue->start){
+      if(workernode_global_queue_has_work(workernode)){
         lock_retval = pthread_mutex_unlock(&(workernode->global_queue_lock));
                #ifdef CHECK_MUTEXES
     parse_lock_errors(lock_retval, workernode->my_rank);
   #endif
         // There is some work left in the master queue, so re-release the threads to complete it
-        // Yes, we may have just checked this but the loop above ends either when we find a work object with work left to do
-        // or when we run out of work objects
         #ifdef DEBUG_MASTER_CHUNKS
         printf("Workernode %d found work on its work queue after masternode sent out-of-work message, re-releasing worker threads\n", workernode->my_rank); 
         #endif
@@ -2807,8 +2739,8 @@ static int workernode_perform_search_or_scan(P7_SERVER_WORKERNODE_STATE *workern
   }
   
   p7_pipeline_Destroy(pli);
-  if(p7_tophits_MPISend(workernode->tophits, 0, HMMER_HIT_FINAL_MPI_TAG, MPI_COMM_WORLD, &send_buf, &send_buf_length) 
-    != eslOK){
+  if(p7_hitblock_Write(send_hits, workernode->tophits) != eslOK ||
+     p7_hitblock_MPISend(send_hits, 0, HMMER_HIT_FINAL_MPI_TAG, MPI_COMM_WORLD) != eslOK){
     p7_Die("Failed to send hit messages to master\n");
   }
 
@@ -2821,6 +2753,7 @@ static int workernode_perform_search_or_scan(P7_SERVER_WORKERNODE_STATE *workern
   
   free(compare_obj_buff);
   free(send_buf);
+  p7_hitblock_Destroy(send_hits);
   return eslOK;
 
 ERROR:
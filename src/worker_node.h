@@ -35,15 +35,18 @@ typedef enum p7_thread_mode{FRONTEND, BACKEND} P7_THREAD_MODE;
  */
 typedef enum p7_search_type{IDLE, SEQUENCE_SEARCH, SEQUENCE_SEARCH_CONTINUE, HMM_SEARCH, HMM_SEARCH_CONTINUE, SHUTDOWN} P7_SEARCH_TYPE;
 
-//! Structure that describes the region of the database that a worker thread is currently processing, consisting of sequences start--end (inclusive) in the database
+/*! Structure that describes the region of the database that a worker thread is currently processing, consisting of sequences start--end (inclusive) in the database
+ * \details The owning thread takes objects off of the front of the range without locking; other threads steal from the back.  See worker_thread_next_object()
+ * and worker_thread_steal() for the protocol.
+ */
 typedef struct p7_work_descriptor{
-	//! Database object id of the start of this block of work
+	//! Database object id of the next object the owning thread will process, or -1 if the descriptor is empty.  Only the owner advances it
 	uint64_t start;
 
-	//! Database object id of the end of this block of work
+	//! Database object id of the end of this block of work.  Only moved down by thieves, while holding lock
 	uint64_t end;
 
-	//! Lock for this descriptor, used for work-stealing
+	//! Lock for this descriptor, taken by thieves and by the owner when it and a thief contend for the last objects in the range
 	pthread_mutex_t lock;
 
 } P7_WORK_DESCRIPTOR;
@@ -54,7 +57,7 @@ typedef struct p7_work_descriptor{
  * The worker node's global work queue consists of a linked list of P7_WORK_CHUNK objects.
  */
 typedef struct p7_work_chunk{
-	//! Database object id of the start of the work chunk 
+	//! Database object id of the start of the work chunk.  Worker threads claim work by atomically adding to this, so it may exceed end once the chunk is used up
 	uint64_t start;
 	//! Database object ID of the end of the work chunk
 	uint64_t end;
@@ -197,9 +200,10 @@ typedef struct p7_server_workernode_state{
 	
 	// Flag that is used to coordinate startup
 	uint32_t ready_to_start;
-	//! Flag signaling that it's not worth stealing any more until the next block
+	//! Flag signaling that it's not worth stealing any more until the next block.  Worker threads read and set it atomically
 	uint32_t no_steal;
 
+	//! Lock held by the main thread when it clears no_steal because new work has arrived
 	pthread_mutex_t steal_lock;
 
 	//! flag that tells all the worker threads to exit when they finish what they're currently doing
@@ -238,8 +242,13 @@ typedef struct p7_server_workernode_state{
   	//! Pool of empty P7_WORK_CHUNK objects that can be used to add work to the global queue
   	P7_WORK_CHUNK *global_chunk_pool;
 
-  	//! Lock that controls access to the global queue
-  	/*! \warning Threads sometimes try to lock this lock when they hold a lock on a thread's local work queue.  Therefore, to prevent 
+  	//! Chunks that have been used up and popped off of the global queue during the current search
+  	/*! Worker threads may still be reading these, so they only go back on global_chunk_pool at the end of the search */
+  	P7_WORK_CHUNK *global_retired;
+
+  	//! Lock that controls changes to the structure of the global queue (pushing and popping chunks)
+  	/*! Worker threads claim work from the chunk at the head of the queue without taking this lock.
+  	 * \warning Threads sometimes try to lock this lock when they hold a lock on a thread's local work queue.  Therefore, to prevent 
   	 * deadlock, a thread that holds this lock must never try to lock a thread's local work queue */
   	pthread_mutex_t global_queue_lock;
 
@@ -0,0 +1,108 @@
+#! /usr/bin/perl
+
+# Test that hmmsearch --qbatch, which searches a batch of query
+# profiles in each pass over the target sequence database, produces
+# exactly the same results as searching the queries one at a time.
+#
+# Usage:   ./i24-qbatch.pl <builddir> <srcdir> <tmpfile prefix>
+# Example: ./i24-qbatch.pl ..         ..       tmpfoo
+#
+
+BEGIN {
+    $builddir  = shift;
+    $srcdir    = shift;
+    $tmppfx    = shift;
+    $verbose   = shift;  # if arg not given, defaults to false (zero)
+}
+
+# The test creates the following files:
+# $tmppfx.hmm         four query profiles: globins4, fn3, Pkinase, globins4 again
+# $tmppfx.fa          target seqs: globins45 plus 7LESS_DROME, which has fn3 and Pkinase domains
+# $tmppfx.out.<n>     hmmsearch output, for each set of options
+# $tmppfx.tbl.<n>     tabular per-seq output
+# $tmppfx.dtbl.<n>    tabular per-domain output
+#
+# If a previous test has generated a $tmppfx.hmm file and pressed it
+# to binary, the binary database would be silently read instead of
+# ours. Quietly remove any previous pressed indices.
+if (-e "$tmppfx.hmm.h3f") { unlink "$tmppfx.hmm.h3f"; }
+if (-e "$tmppfx.hmm.h3i") { unlink "$tmppfx.hmm.h3i"; }
+if (-e "$tmppfx.hmm.h3m") { unlink "$tmppfx.hmm.h3m"; }
+if (-e "$tmppfx.hmm.h3p") { unlink "$tmppfx.hmm.h3p"; }
+
+# Verify that we have all the executables we need for the test.
+@h3progs =  ( "hmmsearch");
+foreach $h3prog  (@h3progs)  { if (! -x "$builddir/src/$h3prog")          { die "FAIL: didn't find $h3prog executable in $builddir/src\n";              } }
+
+do_cmd("cat $srcdir/tutorial/globins4.hmm $srcdir/tutorial/fn3.hmm $srcdir/tutorial/Pkinase.hmm $srcdir/tutorial/globins4.hmm > $tmppfx.hmm");
+do_cmd("cat $srcdir/tutorial/globins45.fa $srcdir/tutorial/7LESS_DROME > $tmppfx.fa");
+
+# Batches of 1 (the default), 3 (a full batch then a partial one),
+# and 10 (all four queries in one partial batch); and with --tcache.
+# Serial runs must match the unbatched search exactly. With threads,
+# hits with tied scores may come out in a different order, so threaded
+# runs are compared after sorting the table lines.
+@serialopts = ("--qbatch 1", "--qbatch 3", "--qbatch 10", "--qbatch 3 --tcache");
+if (`$builddir/src/hmmsearch -h` =~ /--cpu/) {
+    @serialopts   = map { "$_ --cpu 0" } @serialopts;
+    @threadedopts = ("--qbatch 1 --cpu 2", "--qbatch 3 --cpu 2", "--qbatch 10 --cpu 2", "--qbatch 3 --tcache --cpu 2");
+} else {
+    @threadedopts = ();
+}
+@opts = (@serialopts, @threadedopts);
+
+for $i (0..$#opts) {
+    do_cmd("$builddir/src/hmmsearch $opts[$i] -o $tmppfx.out.$i --tblout $tmppfx.tbl.$i --domtblout $tmppfx.dtbl.$i $tmppfx.hmm $tmppfx.fa 2>&1");
+    if ($? != 0) { die "FAIL: hmmsearch $opts[$i] failed\n"; }
+
+    $out[$i]  = results("$tmppfx.out.$i");
+    $tbl[$i]  = results("$tmppfx.tbl.$i");
+    $dtbl[$i] = results("$tmppfx.dtbl.$i");
+}
+
+if ($tbl[0] !~ /^\S+\s+\S+\s+globins4/m) { die "FAIL: expected globin hits in reference search\n"; }
+if ($tbl[0] !~ /^\S+\s+\S+\s+fn3/m)      { die "FAIL: expected fn3 hit in reference search\n"; }
+
+for $i (1..$#serialopts) {
+    if ($out[$i]  ne $out[0])  { die "FAIL: hmmsearch $opts[$i] output differs from unbatched search\n"; }
+    if ($tbl[$i]  ne $tbl[0])  { die "FAIL: hmmsearch $opts[$i] --tblout differs from unbatched search\n"; }
+    if ($dtbl[$i] ne $dtbl[0]) { die "FAIL: hmmsearch $opts[$i] --domtblout differs from unbatched search\n"; }
+}
+for $i ($#serialopts+1..$#opts) {
+    if (sorted($tbl[$i])  ne sorted($tbl[0]))  { die "FAIL: hmmsearch $opts[$i] --tblout differs from unbatched search\n"; }
+    if (sorted($dtbl[$i]) ne sorted($dtbl[0])) { die "FAIL: hmmsearch $opts[$i] --domtblout differs from unbatched search\n"; }
+}
+
+print "ok\n";
+unlink "$tmppfx.hmm";
+unlink "$tmppfx.fa";
+for $i (0..$#opts) {
+    unlink "$tmppfx.out.$i";
+    unlink "$tmppfx.tbl.$i";
+    unlink "$tmppfx.dtbl.$i";
+}
+exit 0;
+
+
+# results(<file>):
+# Slurp an output file, dropping the '#' comment lines, which
+# carry the command line, options, timing, and date.
+sub results {
+    my $file = shift;
+    my $text = "";
+    open(RESULTS, $file) || die "FAIL: couldn't open $file\n";
+    while (<RESULTS>) { $text .= $_ unless /^\s*\#/; }
+    close RESULTS;
+    return $text;
+}
+
+sub sorted {
+    my $text = shift;
+    return join("", sort split(/^/, $text));
+}
+
+sub do_cmd {
+    $cmd = shift;
+    print "$cmd\n" if $verbose;
+    return `$cmd`;
+}
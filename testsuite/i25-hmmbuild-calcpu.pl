@@ -0,0 +1,75 @@
+#! /usr/bin/perl
+
+# Test that hmmbuild's E-value calibration is serial unless --calcpu
+# asks for threads: models built with the default options, with
+# --cpu 0, and with more worker threads must be identical. Models
+# calibrated with --calcpu depend on the seed but not on the number
+# of calibration threads.
+#
+# Usage:   ./i25-hmmbuild-calcpu.pl <builddir> <srcdir> <tmpfile prefix>
+# Example: ./i25-hmmbuild-calcpu.pl ..         ..       tmpfoo
+#
+
+BEGIN {
+    $builddir  = shift;
+    $srcdir    = shift;
+    $tmppfx    = shift;
+    $verbose   = shift;  # if arg not given, defaults to false (zero)
+}
+
+# The test creates the following files:
+# $tmppfx.sto         four alignments: globins4, fn3, Pkinase, MADE1
+# $tmppfx.hmm.<n>     hmmbuild output, one for each set of options
+#
+@h3progs =  ( "hmmbuild");
+foreach $h3prog  (@h3progs)  { if (! -x "$builddir/src/$h3prog")          { die "FAIL: didn't find $h3prog executable in $builddir/src\n";              } }
+
+do_cmd("cat $srcdir/tutorial/globins4.sto $srcdir/tutorial/fn3.sto $srcdir/tutorial/Pkinase.sto $srcdir/tutorial/MADE1.sto > $tmppfx.sto");
+
+# Without thread support, there's only the serial build to run.
+if (`$builddir/src/hmmbuild -h` =~ /--cpu/) {
+    @serialopts   = ("", "--cpu 0", "--cpu 1", "--cpu 4");
+    @threadedopts = ("--cpu 0 --calcpu 1", "--cpu 2 --calcpu 3");
+} else {
+    @serialopts   = ("");
+    @threadedopts = ();
+}
+@opts = (@serialopts, @threadedopts);
+
+for $i (0..$#opts) {
+    do_cmd("$builddir/src/hmmbuild $opts[$i] $tmppfx.hmm.$i $tmppfx.sto 2>&1");
+    if ($? != 0) { die "FAIL: hmmbuild $opts[$i] failed\n"; }
+    $hmm[$i] = models("$tmppfx.hmm.$i");
+}
+
+for $i (1..$#serialopts) {
+    if ($hmm[$i] ne $hmm[0]) { die "FAIL: hmmbuild $opts[$i] model differs from default build\n"; }
+}
+if (@threadedopts) {
+    $t = $#serialopts + 1;
+    if ($hmm[$t+1] ne $hmm[$t]) { die "FAIL: hmmbuild $opts[$t+1] model differs from $opts[$t]\n"; }
+}
+
+print "ok\n";
+unlink "$tmppfx.sto";
+for $i (0..$#opts) { unlink "$tmppfx.hmm.$i"; }
+exit 0;
+
+
+# models(<file>):
+# Slurp an HMM file, dropping the DATE and COM lines, which carry
+# the time and command line.
+sub models {
+    my $file = shift;
+    my $text = "";
+    open(MODELS, $file) || die "FAIL: couldn't open $file\n";
+    while (<MODELS>) { $text .= $_ unless /^(DATE|COM)\s/; }
+    close MODELS;
+    return $text;
+}
+
+sub do_cmd {
+    $cmd = shift;
+    print "$cmd\n" if $verbose;
+    return `$cmd`;
+}
@@ -0,0 +1,81 @@
+#! /usr/bin/perl
+
+# Test that hmmsearch handles a long protein target, close to the
+# comparison pipeline's 100K limit, with a multidomain region too
+# long for a full DP matrix within the RAM limit, which is sampled
+# from a checkpointed matrix instead.
+#
+# Usage:   ./i26-long-target.pl <builddir> <srcdir> <tmpfile prefix>
+# Example: ./i26-long-target.pl ..         ..       tmpfoo
+#
+
+BEGIN {
+    $builddir  = shift;
+    $srcdir    = shift;
+    $tmppfx    = shift;
+    $verbose   = shift;  # if arg not given, defaults to false (zero)
+}
+
+# The test creates the following files:
+# $tmppfx.emit        fn3 domains sampled by hmmemit
+# $tmppfx.fa          one target: random spacer, then the fn3 domains in tandem
+# $tmppfx.out         hmmsearch output
+# $tmppfx.dtbl        tabular per-domain output
+#
+@h3progs =  ( "hmmemit", "hmmsearch");
+foreach $h3prog  (@h3progs)  { if (! -x "$builddir/src/$h3prog")          { die "FAIL: didn't find $h3prog executable in $builddir/src\n";              } }
+
+# 500 tandem fn3 domains (~45K residues) make one multidomain region
+# more than the ~30K rows of a full fn3 matrix that fit in 32MB.
+# A 30K random spacer goes in front; the target stays under 100K.
+$ndom = 500;
+do_cmd("$builddir/src/hmmemit -N $ndom --seed 42 -o $tmppfx.emit $srcdir/tutorial/fn3.hmm");
+if ($? != 0) { die "FAIL: hmmemit failed\n"; }
+
+open(EMIT, "$tmppfx.emit") || die "FAIL: couldn't open $tmppfx.emit\n";
+$domains = "";
+while (<EMIT>) { next if /^>/; chomp; $domains .= $_; }
+close EMIT;
+
+srand(42);
+@aa     = split(//, "ACDEFGHIKLMNPQRSTVWY");
+$spacer = "";
+for $i (1..30000) { $spacer .= $aa[int(rand(20))]; }
+
+$seq = $spacer . $domains;
+$L   = length($seq);
+if ($L > 100000) { die "FAIL: test target is $L long, over the 100K limit\n"; }
+
+open(FA, ">$tmppfx.fa") || die "FAIL: couldn't write $tmppfx.fa\n";
+print FA ">longtarget\n";
+for ($i = 0; $i < $L; $i += 60) { print FA substr($seq, $i, 60), "\n"; }
+close FA;
+
+$cpuopt = (`$builddir/src/hmmsearch -h` =~ /--cpu/) ? "--cpu 0" : "";
+do_cmd("$builddir/src/hmmsearch $cpuopt -o $tmppfx.out --domtblout $tmppfx.dtbl $srcdir/tutorial/fn3.hmm $tmppfx.fa 2>&1");
+if ($? != 0) { die "FAIL: hmmsearch failed on a target of length $L\n"; }
+
+$n = 0;
+open(DTBL, "$tmppfx.dtbl") || die "FAIL: couldn't open $tmppfx.dtbl\n";
+while (<DTBL>) {
+    next if /^\#/;
+    @fields = split;
+    if ($fields[0] ne "longtarget" || $fields[2] != $L) { die "FAIL: unexpected domain line\n$_"; }
+    $n++;
+}
+close DTBL;
+if ($n < $ndom / 4) { die "FAIL: found only $n of $ndom fn3 domains\n"; }
+
+print "ok\n";
+unlink "$tmppfx.emit";
+unlink "$tmppfx.fa";
+unlink "$tmppfx.out";
+unlink "$tmppfx.dtbl";
+exit 0;
+
+
+sub do_cmd {
+    $cmd = shift;
+    print "$cmd\n" if $verbose;
+    return `$cmd`;
+}
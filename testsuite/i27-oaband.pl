@@ -0,0 +1,75 @@
+#! /usr/bin/perl
+
+# Test hmmsearch --oaband, which limits OA alignments to posterior
+# bands. Banding is opt-in: it may change alignments, but not the
+# hits, their scores, or the domain envelopes, which come from the
+# same Forward/Backward decoding with or without it.
+#
+# Usage:   ./i27-oaband.pl <builddir> <srcdir> <tmpfile prefix>
+# Example: ./i27-oaband.pl ..         ..       tmpfoo
+#
+
+BEGIN {
+    $builddir  = shift;
+    $srcdir    = shift;
+    $tmppfx    = shift;
+    $verbose   = shift;  # if arg not given, defaults to false (zero)
+}
+
+# The test creates the following files:
+# $tmppfx.fa          target seqs: globins45 plus 7LESS_DROME, which has fn3 and Pkinase domains
+# $tmppfx.tbl.<n>     tabular per-seq output, without and with --oaband
+# $tmppfx.dtbl.<n>    tabular per-domain output
+#
+@h3progs =  ( "hmmsearch");
+foreach $h3prog  (@h3progs)  { if (! -x "$builddir/src/$h3prog")          { die "FAIL: didn't find $h3prog executable in $builddir/src\n";              } }
+
+do_cmd("cat $srcdir/tutorial/globins45.fa $srcdir/tutorial/7LESS_DROME > $tmppfx.fa");
+
+@opts   = ("", "--oaband");
+$cpuopt = (`$builddir/src/hmmsearch -h` =~ /--cpu/) ? "--cpu 0" : "";
+
+for $i (0..$#opts) {
+    for $hmm ("globins4", "fn3", "Pkinase") {
+	do_cmd("$builddir/src/hmmsearch $opts[$i] $cpuopt -o /dev/null --tblout $tmppfx.tbl.$i --domtblout $tmppfx.dtbl.$i $srcdir/tutorial/$hmm.hmm $tmppfx.fa 2>&1");
+	if ($? != 0) { die "FAIL: hmmsearch $opts[$i] failed on $hmm\n"; }
+	$tbl[$i]  .= results("$tmppfx.tbl.$i",  0);
+	$dtbl[$i] .= results("$tmppfx.dtbl.$i", 1);
+    }
+}
+
+if ($tbl[0] !~ /^\S+\s+\S+\s+fn3/m) { die "FAIL: expected fn3 hit\n"; }
+if ($tbl[1]  ne $tbl[0])  { die "FAIL: --oaband changed per-sequence results\n"; }
+if ($dtbl[1] ne $dtbl[0]) { die "FAIL: --oaband changed domain scores or envelopes\n"; }
+
+print "ok\n";
+unlink "$tmppfx.fa";
+for $i (0..$#opts) {
+    unlink "$tmppfx.tbl.$i";
+    unlink "$tmppfx.dtbl.$i";
+}
+exit 0;
+
+
+# results(<file>, <is_domtbl>):
+# Slurp a tabular output file, dropping the '#' comment lines, which
+# carry the command line and options. For --domtblout, also drop the
+# columns that come from the OA alignment: hmm and ali from/to, and acc.
+sub results {
+    my ($file, $is_domtbl) = @_;
+    my $text = "";
+    open(RESULTS, $file) || die "FAIL: couldn't open $file\n";
+    while (<RESULTS>) {
+	next if /^\s*\#/;
+	if ($is_domtbl) { my @f = split; $_ = join(" ", @f[0..14], @f[19..20]) . "\n"; }
+	$text .= $_;
+    }
+    close RESULTS;
+    return $text;
+}
+
+sub do_cmd {
+    $cmd = shift;
+    print "$cmd\n" if $verbose;
+    return `$cmd`;
+}
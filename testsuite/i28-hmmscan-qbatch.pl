@@ -0,0 +1,109 @@
+#! /usr/bin/perl
+
+# Test that hmmscan --qbatch, which searches a batch of query
+# sequences in each pass over the pressed profile database, produces
+# exactly the same results as searching the queries one at a time.
+#
+# Usage:   ./i28-hmmscan-qbatch.pl <builddir> <srcdir> <tmpfile prefix>
+# Example: ./i28-hmmscan-qbatch.pl ..         ..       tmpfoo
+#
+
+BEGIN {
+    $builddir  = shift;
+    $srcdir    = shift;
+    $tmppfx    = shift;
+    $verbose   = shift;  # if arg not given, defaults to false (zero)
+}
+
+# The test creates the following files:
+# $tmppfx.hmm         three profiles: globins4, fn3, Pkinase; and its pressed .h3{fimp} files
+# $tmppfx.fa          47 query seqs: HBB_HUMAN, 7LESS_DROME (fn3 and Pkinase domains), globins45
+# $tmppfx.out.<n>     hmmscan output, for each set of options
+# $tmppfx.tbl.<n>     tabular per-target output
+# $tmppfx.dtbl.<n>    tabular per-domain output
+#
+@h3progs =  ( "hmmpress", "hmmscan");
+foreach $h3prog  (@h3progs)  { if (! -x "$builddir/src/$h3prog")          { die "FAIL: didn't find $h3prog executable in $builddir/src\n";              } }
+
+if (-e "$tmppfx.hmm.h3f") { unlink "$tmppfx.hmm.h3f"; }
+if (-e "$tmppfx.hmm.h3i") { unlink "$tmppfx.hmm.h3i"; }
+if (-e "$tmppfx.hmm.h3m") { unlink "$tmppfx.hmm.h3m"; }
+if (-e "$tmppfx.hmm.h3p") { unlink "$tmppfx.hmm.h3p"; }
+
+do_cmd("cat $srcdir/tutorial/globins4.hmm $srcdir/tutorial/fn3.hmm $srcdir/tutorial/Pkinase.hmm > $tmppfx.hmm");
+do_cmd("cat $srcdir/tutorial/HBB_HUMAN $srcdir/tutorial/7LESS_DROME $srcdir/tutorial/globins45.fa > $tmppfx.fa");
+do_cmd("$builddir/src/hmmpress $tmppfx.hmm 2>&1");
+if ($? != 0) { die "FAIL: hmmpress failed\n"; }
+
+# Serial runs must match the unbatched search exactly: batches of 1
+# (the default), 3 (full batches then a partial one), and 10.
+# With threads, hits with tied scores may come out in a different
+# order, so threaded runs are compared after sorting the table lines.
+@serialopts = ("--qbatch 1", "--qbatch 3", "--qbatch 10");
+if (`$builddir/src/hmmscan -h` =~ /--cpu/) {
+    @serialopts   = map { "$_ --cpu 0" } @serialopts;
+    @threadedopts = ("--qbatch 1 --cpu 2", "--qbatch 3 --cpu 2", "--qbatch 10 --cpu 2");
+} else {
+    @threadedopts = ();
+}
+@opts = (@serialopts, @threadedopts);
+
+for $i (0..$#opts) {
+    do_cmd("$builddir/src/hmmscan $opts[$i] -o $tmppfx.out.$i --tblout $tmppfx.tbl.$i --domtblout $tmppfx.dtbl.$i $tmppfx.hmm $tmppfx.fa 2>&1");
+    if ($? != 0) { die "FAIL: hmmscan $opts[$i] failed\n"; }
+
+    $out[$i]  = results("$tmppfx.out.$i");
+    $tbl[$i]  = results("$tmppfx.tbl.$i");
+    $dtbl[$i] = results("$tmppfx.dtbl.$i");
+}
+
+if ($tbl[0] !~ /^globins4\s+\S+\s+HBB_HUMAN/m) { die "FAIL: expected globins4 hit to HBB_HUMAN\n"; }
+if ($tbl[0] !~ /^fn3\s+\S+\s+7LESS_DROME/m)    { die "FAIL: expected fn3 hit to 7LESS_DROME\n"; }
+
+for $i (1..$#serialopts) {
+    if ($out[$i]  ne $out[0])  { die "FAIL: hmmscan $opts[$i] output differs from unbatched search\n"; }
+    if ($tbl[$i]  ne $tbl[0])  { die "FAIL: hmmscan $opts[$i] --tblout differs from unbatched search\n"; }
+    if ($dtbl[$i] ne $dtbl[0]) { die "FAIL: hmmscan $opts[$i] --domtblout differs from unbatched search\n"; }
+}
+for $i ($#serialopts+1..$#opts) {
+    if (sorted($tbl[$i])  ne sorted($tbl[0]))  { die "FAIL: hmmscan $opts[$i] --tblout differs from unbatched search\n"; }
+    if (sorted($dtbl[$i]) ne sorted($dtbl[0])) { die "FAIL: hmmscan $opts[$i] --domtblout differs from unbatched search\n"; }
+}
+
+print "ok\n";
+unlink "$tmppfx.hmm";
+unlink "$tmppfx.hmm.h3f";
+unlink "$tmppfx.hmm.h3i";
+unlink "$tmppfx.hmm.h3m";
+unlink "$tmppfx.hmm.h3p";
+unlink "$tmppfx.fa";
+for $i (0..$#opts) {
+    unlink "$tmppfx.out.$i";
+    unlink "$tmppfx.tbl.$i";
+    unlink "$tmppfx.dtbl.$i";
+}
+exit 0;
+
+
+# results(<file>):
+# Slurp an output file, dropping the '#' comment lines, which
+# carry the command line, options, timing, and date.
+sub results {
+    my $file = shift;
+    my $text = "";
+    open(RESULTS, $file) || die "FAIL: couldn't open $file\n";
+    while (<RESULTS>) { $text .= $_ unless /^\s*\#/; }
+    close RESULTS;
+    return $text;
+}
+
+sub sorted {
+    my $text = shift;
+    return join("", sort split(/^/, $text));
+}
+
+sub do_cmd {
+    $cmd = shift;
+    print "$cmd\n" if $verbose;
+    return `$cmd`;
+}
@@ -0,0 +1,95 @@
+#! /usr/bin/perl
+
+# Test that nhmmer --fmindex --qbatch, which seeds a batch of queries
+# in each pass over the FM-index, produces exactly the same results
+# as searching the queries one at a time.
+#
+# Usage:   ./i29-nhmmer-fm-qbatch.pl <builddir> <srcdir> <tmpfile prefix>
+# Example: ./i29-nhmmer-fm-qbatch.pl ..         ..       tmpfoo
+#
+
+BEGIN {
+    $builddir  = shift;
+    $srcdir    = shift;
+    $tmppfx    = shift;
+    $verbose   = shift;  # if arg not given, defaults to false (zero)
+}
+
+# The test creates the following files:
+# $tmppfx.hmm         three DNA profiles: MADE1, 3box, 2OG-FeII_Oxy_3-nt
+# $tmppfx.fm          FM-index of tutorial/dna_target.fa
+# $tmppfx.out.<n>     nhmmer output, for each set of options
+# $tmppfx.tbl.<n>     tabular per-hit output
+#
+@h3progs =  ( "hmmer-makefmdb", "nhmmer");
+foreach $h3prog  (@h3progs)  { if (! -x "$builddir/src/$h3prog")          { die "FAIL: didn't find $h3prog executable in $builddir/src\n";              } }
+
+if (`$builddir/src/nhmmer -h` !~ /--fmindex/) { print "ok\n"; exit 0; }   # built without FM-index support
+
+do_cmd("cat $srcdir/tutorial/MADE1.hmm $srcdir/testsuite/3box.hmm $srcdir/testsuite/2OG-FeII_Oxy_3-nt.hmm > $tmppfx.hmm");
+do_cmd("$builddir/src/hmmer-makefmdb $srcdir/tutorial/dna_target.fa $tmppfx.fm 2>&1");
+if ($? != 0) { die "FAIL: hmmer-makefmdb failed\n"; }
+
+# Serial runs must match the unbatched search exactly: batches of 1
+# (the default), 2 (a full batch then a partial one), and 10.
+# With threads, hits with tied scores may come out in a different
+# order, so threaded runs are compared after sorting the table lines.
+@serialopts = ("--qbatch 1", "--qbatch 2", "--qbatch 10");
+if (`$builddir/src/nhmmer -h` =~ /--cpu/) {
+    @serialopts   = map { "$_ --cpu 0" } @serialopts;
+    @threadedopts = ("--qbatch 2 --cpu 2", "--qbatch 10 --cpu 2");
+} else {
+    @threadedopts = ();
+}
+@opts = (@serialopts, @threadedopts);
+
+for $i (0..$#opts) {
+    do_cmd("$builddir/src/nhmmer --fmindex $opts[$i] -o $tmppfx.out.$i --tblout $tmppfx.tbl.$i $tmppfx.hmm $tmppfx.fm 2>&1");
+    if ($? != 0) { die "FAIL: nhmmer --fmindex $opts[$i] failed\n"; }
+
+    $out[$i] = results("$tmppfx.out.$i");
+    $tbl[$i] = results("$tmppfx.tbl.$i");
+}
+
+if ($tbl[0] !~ /^\S+\s+\S+\s+MADE1\s/m) { die "FAIL: expected MADE1 hits\n"; }
+
+for $i (1..$#serialopts) {
+    if ($out[$i] ne $out[0]) { die "FAIL: nhmmer --fmindex $opts[$i] output differs from unbatched search\n"; }
+    if ($tbl[$i] ne $tbl[0]) { die "FAIL: nhmmer --fmindex $opts[$i] --tblout differs from unbatched search\n"; }
+}
+for $i ($#serialopts+1..$#opts) {
+    if (sorted($tbl[$i]) ne sorted($tbl[0])) { die "FAIL: nhmmer --fmindex $opts[$i] --tblout differs from unbatched search\n"; }
+}
+
+print "ok\n";
+unlink "$tmppfx.hmm";
+unlink "$tmppfx.fm";
+for $i (0..$#opts) {
+    unlink "$tmppfx.out.$i";
+    unlink "$tmppfx.tbl.$i";
+}
+exit 0;
+
+
+# results(<file>):
+# Slurp an output file, dropping the '#' comment lines, which
+# carry the command line, options, timing, and date.
+sub results {
+    my $file = shift;
+    my $text = "";
+    open(RESULTS, $file) || die "FAIL: couldn't open $file\n";
+    while (<RESULTS>) { $text .= $_ unless /^\s*\#/; }
+    close RESULTS;
+    return $text;
+}
+
+sub sorted {
+    my $text = shift;
+    return join("", sort split(/^/, $text));
+}
+
+sub do_cmd {
+    $cmd = shift;
+    print "$cmd\n" if $verbose;
+    return `$cmd`;
+}